@@ -0,0 +1,140 @@
+#pragma once
+
+#include "ThreadPool.h"
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+// Every asset in one file, mapped into memory rather than opened and read one by one. The file is a Header,
+// an Entry per asset sorted by the hash of its name, a Chunk per chunk of every asset, the names, then the
+// chunks' data. Assets are split into chunks compressed independently with LZ4, so a large one decodes on
+// several threads at once and any range of it can be read without decoding the rest
+class AssetPack {
+public:
+	// "VPAK" read as a little endian integer
+	static const uint32_t MAGIC = 0x4b415056;
+	static const uint32_t VERSION = 1;
+	// Uncompressed bytes in every chunk of an asset but its last
+	static const uint32_t CHUNK_SIZE = 256 * 1024;
+
+	struct Header {
+		uint32_t magic;
+		uint32_t version;
+		uint32_t chunkSize;
+		uint32_t entryCount;
+		uint32_t chunkCount;
+		// Bytes of names, each stored without a terminator
+		uint32_t namesSize;
+	};
+
+	struct Entry {
+		uint64_t hash;
+		uint64_t size;
+		uint32_t firstChunk;
+		uint32_t chunkCount;
+		uint32_t nameOffset;
+		uint32_t nameLength;
+	};
+
+	struct Chunk {
+		// In bytes from the start of the file
+		uint64_t offset;
+		// Equal to size when the chunk did not compress and is stored as is
+		uint32_t compressedSize;
+		uint32_t size;
+	};
+
+	// Assets are named by their path relative to the root they were packed from, with forward slashes
+	static uint64_t hashName(const std::string& name);
+
+	// Pack the named files under root, compressing their chunks across the pool
+	static void write(const std::string& path, const std::string& root, const std::vector<std::string>& names, ThreadPool& pool);
+
+	// Map a pack, throws if it is missing or not a valid pack
+	explicit AssetPack(const std::string& path);
+	~AssetPack();
+	AssetPack(const AssetPack&) = delete;
+	AssetPack& operator=(const AssetPack&) = delete;
+
+	bool contains(const std::string& name) const { return find(name) != nullptr; }
+
+	// Uncompressed size of an asset, throws if the pack does not have it
+	uint64_t getSize(const std::string& name) const;
+
+	// Decompress size bytes of an asset from offset on into dst, staging memory for example. Only the chunks
+	// the range touches are decoded, across the pool when one is given. A pool must not be given from one of
+	// its own workers, they could all end up waiting on each other
+	void read(const std::string& name, uint64_t offset, uint64_t size, void* dst, ThreadPool* pool = nullptr) const;
+
+	uint32_t getAssetCount() const { return header.entryCount; }
+	const std::string& getPath() const { return path; }
+	// Bytes of the whole file, and of every asset uncompressed
+	uint64_t getFileSize() const { return fileSize; }
+	uint64_t getUncompressedSize() const;
+
+	// Name and uncompressed size of every asset, in the pack's order
+	std::vector<std::pair<std::string, uint64_t>> getAssets() const;
+
+private:
+	// The entry of the named asset, null if there is none
+	const Entry* find(const std::string& name) const;
+
+	// Check the tables against each other and the file size, throws if anything is out of place
+	void validate();
+	void unmap();
+
+	std::string path;
+	const uint8_t* data = nullptr;
+	uint64_t fileSize = 0;
+	Header header = {};
+	const Entry* entries = nullptr;
+	const Chunk* chunks = nullptr;
+	const char* names = nullptr;
+#ifdef _WIN32
+	void* fileHandle = nullptr;
+	void* mappingHandle = nullptr;
+#endif
+};
+
+// Where the renderer reads its files from. Assets the pack has come from it, anything else from the loose
+// file under the root, so a pack only needs to hold what benefits from being in one. A loose file written after
+// the pack or of another size than the pack's copy wins over it, so a recompiled shader or rebaked texture is
+// not hidden by a stale pack
+class AssetLoader {
+public:
+	// Pack the asset packer writes, relative to the root
+	static constexpr const char* PACK_NAME = "assets/assets.pak";
+
+	AssetLoader(const std::string& root, ThreadPool& pool);
+
+	// Read from the pack at path from now on. False if it cannot be mapped, the reason is then in getPackError
+	bool openPack(const std::string& path);
+	// Assets of the pack read from their loose files instead, for being newer
+	uint32_t getStaleCount() const { return static_cast<uint32_t>(stale.size()); }
+
+	// Every byte of an asset. Decodes across the pool, so must not be called from one of its workers
+	std::vector<char> load(const std::string& name) const;
+
+	// size bytes of an asset from offset on, decoded on the calling thread
+	void read(const std::string& name, uint64_t offset, uint64_t size, void* dst) const;
+
+	bool exists(const std::string& name) const;
+
+	const std::string& getRoot() const { return root; }
+	const AssetPack* getPack() const { return pack.get(); }
+	const std::string& getPackError() const { return packError; }
+
+private:
+	// Whether the pack has the asset and its copy is not stale
+	bool inPack(const std::string& name) const;
+
+	std::string root;
+	ThreadPool& threadPool;
+	std::unique_ptr<AssetPack> pack;
+	std::string packError;
+	std::unordered_set<std::string> stale;
+};
@@ -0,0 +1,10 @@
+#pragma once
+
+// Offline step writing the compiled shaders and baked textures into the asset pack the renderer maps. Every
+// asset is read back from the pack and compared against its file, then loading all of them is timed from the
+// pack and as loose files, both with the file cache dropped first and warm
+class AssetPacker {
+public:
+	// False if nothing was there to pack or an asset does not read back the same
+	static bool run();
+};
@@ -0,0 +1,66 @@
+#pragma once
+
+#include "AssetPack.h"
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Texture baked offline into the format the gpu samples it in. The file is a Header, a Level for
+// every mip, then the levels' data finest first, one after another. Any run of levels down to the
+// smallest is therefore a single read that can be copied to a buffer as is and uploaded level by level
+class BakedTexture {
+public:
+	// "BTEX" read as a little endian integer
+	static const uint32_t MAGIC = 0x58455442;
+	static const uint32_t VERSION = 1;
+
+	struct Header {
+		uint32_t magic;
+		uint32_t version;
+		// VkFormat of every level
+		uint32_t format;
+		uint32_t width;
+		uint32_t height;
+		uint32_t mipCount;
+	};
+
+	// Where a level's data is, in bytes from the start of the file
+	struct Level {
+		uint64_t offset;
+		uint64_t size;
+	};
+
+	// Write the levels of a texture, finest first
+	static void save(const std::string& path, VkFormat format, uint32_t width, uint32_t height, const std::vector<std::vector<uint8_t>>& levels);
+
+	// Read the header and level table of an asset, throws if it is missing or not a baked texture. The loader
+	// must outlive the texture, levels are read through it
+	static BakedTexture open(const AssetLoader& assets, const std::string& name);
+
+	// Data of the levels from firstMip down to the last, laid out as in the file
+	std::vector<uint8_t> loadLevels(uint32_t firstMip) const;
+	// The same written to dst, which must hold levelsBytes(firstMip). Staging memory for example
+	void loadLevels(uint32_t firstMip, void* dst) const;
+	uint64_t levelsBytes(uint32_t firstMip) const;
+
+	// Bytes of a width x height level in format. Covers RGBA8 and the block compressed formats textures are baked in
+	static uint64_t levelBytes(VkFormat format, uint32_t width, uint32_t height);
+	static const char* formatName(VkFormat format);
+
+	VkFormat getFormat() const { return format; }
+	uint32_t getWidth() const { return width; }
+	uint32_t getHeight() const { return height; }
+	uint32_t getMipCount() const { return static_cast<uint32_t>(levels.size()); }
+	const std::string& getName() const { return name; }
+
+private:
+	const AssetLoader* assets = nullptr;
+	std::string name;
+	VkFormat format = VK_FORMAT_UNDEFINED;
+	uint32_t width = 0;
+	uint32_t height = 0;
+	std::vector<Level> levels;
+};
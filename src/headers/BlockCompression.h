@@ -0,0 +1,89 @@
+#pragma once
+
+#include "ThreadPool.h"
+
+#include <cstdint>
+#include <vector>
+
+namespace bc {
+
+	// Block compressed formats the encoder writes. BC3 is BC1 color with a BC4 alpha block in front,
+	// BC5 two BC4 blocks for red and green, and BC7 only ever uses mode 6, one subset with alpha
+	enum class Format : uint32_t {
+		BC1,
+		BC3,
+		BC5,
+		BC7,
+	};
+
+	// Pixels of a 4x4 block in 0..255, one row of 16 values per channel so kernels load them straight into registers
+	struct Block {
+		alignas(32) float channels[4][16];
+	};
+
+	// Up to 16 values a block's pixels are snapped to, and how much each channel's error counts
+	struct Palette {
+		float entries[16][4];
+		uint32_t size;
+		float weights[4];
+	};
+
+	// Inner loops, implemented once per instruction set
+	struct Kernels {
+		// Nearest palette entry of every pixel and its weighted squared distance. Ties go to the lower index
+		void (*selectIndices)(const Block& block, const Palette& palette, uint8_t* indices, float* errors);
+	};
+
+	const Kernels& scalarKernels();
+	const Kernels* sseKernels();
+	const Kernels* avx2Kernels();
+
+	// Bytes of one encoded block
+	uint32_t blockBytes(Format format);
+	const char* formatName(Format format);
+
+	// Encode 16 RGBA8 pixels, four rows of four one after another
+	void encodeBlock(Format format, const Kernels& kernels, const uint8_t* pixels, uint8_t* output);
+
+	// Decode a block back to 16 RGBA8 pixels. Channels the format does not store are 0, or 255 for alpha
+	void decodeBlock(Format format, const uint8_t* input, uint8_t* pixels);
+
+}
+
+// Compresses images into BCn blocks on the cpu, the blocks spread across a thread pool
+class BlockCompressor {
+public:
+	enum class Implementation {
+		Scalar,
+		SSE,
+		AVX2,
+	};
+
+	// Tightly packed RGBA8 pixels
+	struct Image {
+		uint32_t width = 0;
+		uint32_t height = 0;
+		std::vector<uint8_t> pixels;
+	};
+
+	explicit BlockCompressor(ThreadPool& pool);
+
+	// Fastest implementation this cpu and build support
+	static Implementation bestImplementation();
+	static const char* implementationName(Implementation implementation);
+
+	void setImplementation(Implementation implementation);
+	Implementation getImplementation() const { return implementation; }
+
+	// Compress every level of a mip chain, the blocks of all levels encoded in parallel. Levels not
+	// a multiple of the block size are padded by repeating their last row and column
+	std::vector<std::vector<uint8_t>> compress(bc::Format format, const std::vector<Image>& levels) const;
+
+	// Decode a compressed level back to RGBA8, for measuring what the compression lost
+	static Image decompress(bc::Format format, const std::vector<uint8_t>& blocks, uint32_t width, uint32_t height);
+
+private:
+	Implementation implementation;
+	const bc::Kernels* kernels;
+	ThreadPool& threadPool;
+};
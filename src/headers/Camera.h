@@ -0,0 +1,53 @@
+#pragma once
+
+#include "ShaderTypes.h"
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <cmath>
+
+struct Camera {
+	glm::vec3 position = glm::vec3(0.0f, 2.0f, 5.0f);
+	glm::vec3 target = glm::vec3(0.0f);
+	float fovY = glm::radians(60.0f);
+	float nearPlane = 0.1f;
+	float farPlane = 500.0f;
+
+	// Street level orbit around the center of a scene, looking across it
+	void orbit(float angle, float radius) {
+		position = glm::vec3(std::cos(angle) * radius, 3.0f, std::sin(angle) * radius);
+		target = glm::vec3(0.0f, 1.5f, 0.0f);
+	}
+
+	// Build the matrices and frustum planes our shaders use for the given aspect ratio
+	CameraData getCameraData(float aspect) const {
+		CameraData data = {};
+		data.view = glm::lookAt(position, target, glm::vec3(0.0f, 1.0f, 0.0f));
+		data.proj = glm::perspective(fovY, aspect, nearPlane, farPlane);
+		// GLM was designed for OpenGL where the clip space y is flipped
+		data.proj[1][1] *= -1;
+		data.viewProj = data.proj * data.view;
+
+		// Gribb/Hartmann plane extraction, with a [0, 1] depth range the near plane is just the third row
+		const glm::mat4& m = data.viewProj;
+		glm::vec4 row0 = glm::vec4(m[0][0], m[1][0], m[2][0], m[3][0]);
+		glm::vec4 row1 = glm::vec4(m[0][1], m[1][1], m[2][1], m[3][1]);
+		glm::vec4 row2 = glm::vec4(m[0][2], m[1][2], m[2][2], m[3][2]);
+		glm::vec4 row3 = glm::vec4(m[0][3], m[1][3], m[2][3], m[3][3]);
+
+		data.frustumPlanes[0] = row3 + row0;
+		data.frustumPlanes[1] = row3 - row0;
+		data.frustumPlanes[2] = row3 + row1;
+		data.frustumPlanes[3] = row3 - row1;
+		data.frustumPlanes[4] = row2;
+		data.frustumPlanes[5] = row3 - row2;
+		for (auto& plane : data.frustumPlanes) {
+			plane /= glm::length(glm::vec3(plane));
+		}
+
+		data.position = glm::vec4(position, 1.0f);
+		data.projParams = glm::vec4(nearPlane, farPlane, 0.0f, 0.0f);
+
+		return data;
+	}
+};
@@ -0,0 +1,82 @@
+#pragma once
+
+#include "AssetPack.h"
+#include "VulkanUtil.h"
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <vector>
+
+// Builds a whole mip chain in a single compute dispatch rather than one blit or dispatch per level with a
+// barrier between each. Every workgroup reduces a 64x64 tile of the source down six levels in registers and
+// shared memory, the last workgroup to finish then reduces what all of them wrote down to the smallest level.
+// Neighbouring texels are combined with subgroup quad operations where the device has them
+class Downsampler {
+public:
+	enum class Reduction : uint32_t {
+		Average = 0,
+		Min = 1,
+		Max = 2,
+	};
+
+	// Levels one dispatch writes below its source, enough to take 4096x4096 down to 1x1
+	static const uint32_t MAX_LEVELS = 12;
+	// Source texels along each axis one workgroup reduces to a single texel
+	static const uint32_t TILE_SIZE = 64;
+
+	// Levels of one image the downsampler writes, and the descriptors and counter a dispatch on them uses
+	struct Target {
+		VkImage image = VK_NULL_HANDLE;
+		// Of the source level
+		VkExtent2D extent = { 0, 0 };
+		uint32_t levelCount = 0;
+		// The source level's view first, then one per level written
+		std::vector<VkImageView> views;
+		VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+		// Workgroups that finished their tile, the last one resets it
+		vkutil::Buffer counter;
+	};
+
+	// format is R32_SFLOAT or R8G8B8A8_UNORM. srgb averages the latter's contents in linear space, as the storage
+	// view cannot be sRGB itself. useSubgroups must only be set when subgroupQuadSupported says so
+	Downsampler(VkDevice device, VkPhysicalDevice physicalDevice, const AssetLoader& assets, VkFormat format,
+		Reduction reduction, bool srgb, bool useSubgroups, uint32_t maxTargets);
+	Downsampler(const Downsampler&) = delete;
+	Downsampler& operator=(const Downsampler&) = delete;
+
+	// The format must be a storage image and arrays of storage images dynamically indexed, a feature that then
+	// has to be enabled. Workgroups of 256 invocations are beyond what every device must support
+	static bool isSupported(VkPhysicalDevice physicalDevice, VkFormat format);
+
+	// Compute shaders can swap values within quads of a subgroup. Needs Vulkan 1.1 on both the device and the
+	// instance, getProperties2 is null when the instance does not have it
+	static bool subgroupQuadSupported(VkPhysicalDevice physicalDevice, PFN_vkGetPhysicalDeviceProperties2KHR getProperties2);
+
+	// Write levels sourceLevel + 1 to sourceLevel + levelCount of image from sourceLevel, at most MAX_LEVELS of them.
+	// extent is the source level's. Zeroes the counter, waiting for the queue to finish
+	Target createTarget(VkImage image, VkExtent2D extent, uint32_t sourceLevel, uint32_t levelCount,
+		VkCommandPool commandPool, VkQueue queue);
+	void destroyTarget(Target& target);
+
+	// Record the dispatch. Every level of the target must be in the general layout, with the source level's writes
+	// visible to compute shader reads. The counter is synchronized with earlier dispatches on the target here
+	void record(VkCommandBuffer commandBuffer, const Target& target) const;
+
+	void destroy();
+
+	bool usesSubgroups() const { return subgroups; }
+
+private:
+	VkDevice device;
+	VkPhysicalDevice physicalDevice;
+	VkFormat format;
+	bool subgroups;
+
+	VkDescriptorSetLayout setLayout = VK_NULL_HANDLE;
+	VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
+	VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+	VkPipeline pipeline = VK_NULL_HANDLE;
+	// Texel fetches only, but sampled images still need a sampler
+	VkSampler sampler = VK_NULL_HANDLE;
+};
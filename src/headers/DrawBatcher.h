@@ -0,0 +1,102 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <vector>
+
+// Collects draws recorded on the cpu as packets with a 64 bit sort key and turns them into as few commands as
+// possible. Keys order by pass, pipeline, material and mesh, then front to back by depth. They are radix sorted,
+// runs of packets sharing everything but their depth merge into one instanced draw, and recording only binds what
+// changed since the draw before. Each packet carries an instance, a draw's instances are contiguous in sorted order
+// starting at its firstInstance, for the shaders to look up through gl_InstanceIndex
+class DrawBatcher {
+public:
+	static const uint32_t PASS_BITS = 4;
+	static const uint32_t PIPELINE_BITS = 8;
+	static const uint32_t MATERIAL_BITS = 16;
+	static const uint32_t MESH_BITS = 20;
+	static const uint32_t DEPTH_BITS = 16;
+
+	// Bound through a descriptor set at materialSet of the layout every pipeline shares
+	struct Material {
+		VkDescriptorSet set;
+	};
+
+	// Indexed geometry drawn by a packet
+	struct Mesh {
+		VkBuffer vertexBuffer;
+		VkBuffer indexBuffer;
+		uint32_t indexCount;
+		uint32_t firstIndex;
+		int32_t vertexOffset;
+	};
+
+	// What the indices of a key refer to when recording
+	struct Tables {
+		std::vector<VkPipeline> pipelines;
+		VkPipelineLayout layout = VK_NULL_HANDLE;
+		uint32_t materialSet = 0;
+		std::vector<Material> materials;
+		std::vector<Mesh> meshes;
+	};
+
+	// Commands a recording emitted
+	struct Stats {
+		uint32_t draws = 0;
+		uint32_t pipelineBinds = 0;
+		uint32_t descriptorBinds = 0;
+		uint32_t vertexBufferBinds = 0;
+		uint32_t indexBufferBinds = 0;
+
+		uint32_t binds() const { return pipelineBinds + descriptorBinds + vertexBufferBinds + indexBufferBinds; }
+	};
+
+	// depth is a fraction of the depth range, clamped to [0, 1]. Indices past their bits are cut off
+	static uint64_t makeKey(uint32_t pass, uint32_t pipeline, uint32_t material, uint32_t mesh, float depth);
+
+	// Start collecting a new list of packets
+	void clear();
+	void add(uint64_t key, uint32_t instance);
+	size_t size() const { return keys.size(); }
+
+	// Sort the packets and merge them into draws
+	void build();
+	// Instances of every draw, for the caller to upload where the shaders read them
+	const std::vector<uint32_t>& getInstances() const { return instances; }
+
+	// Record the draws of a pass built, binding only what changes from one to the next. Nothing is assumed
+	// bound before
+	Stats record(VkCommandBuffer commandBuffer, const Tables& tables, uint32_t pass) const;
+	// Record every packet of a pass in the order added as its own draw, binding only what changed from the
+	// packet before. Its firstInstance is its index in that order. What sorting and merging save over
+	// submission order is measured against this
+	Stats recordUnsorted(VkCommandBuffer commandBuffer, const Tables& tables, uint32_t pass) const;
+
+private:
+	struct Batch {
+		uint64_t key;
+		uint32_t firstInstance;
+		uint32_t instanceCount;
+	};
+
+	// Least significant digit first, a byte at a time. Bytes every key shares are skipped
+	void sortPackets();
+
+	static uint32_t passOf(uint64_t key);
+	static uint32_t pipelineOf(uint64_t key);
+	static uint32_t materialOf(uint64_t key);
+	static uint32_t meshOf(uint64_t key);
+
+	// In the order added
+	std::vector<uint64_t> keys;
+	std::vector<uint32_t> packetInstances;
+	// Sorted by build, going back and forth with the scratch copies
+	std::vector<uint64_t> sortedKeys;
+	std::vector<uint32_t> sortedInstances;
+	std::vector<uint64_t> scratchKeys;
+	std::vector<uint32_t> scratchInstances;
+
+	std::vector<Batch> batches;
+	std::vector<uint32_t> instances;
+};
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+// Picks the fraction of the screen the scene is rendered at from measured gpu frame times. Targets stay
+// the size of the screen and the scene only renders into their top left corner, so a change of scale costs
+// nothing but a different viewport. Frame times are averaged, and the scale only drops once the average is
+// over the budget and only grows once it is clearly under, holding anywhere in between
+class DynamicResolution {
+public:
+	struct Config {
+		float targetMs = 16.6f;
+		float minScale = 0.5f;
+		float maxScale = 1.0f;
+		// Fraction under the target the average must fall to before the scale grows
+		float hysteresis = 0.15f;
+		// Weight of the newest frame in the running average
+		float smoothing = 0.1f;
+		// Largest change of one step, and the frames the scale then holds while the new times come in
+		float maxStep = 0.1f;
+		uint32_t cooldownFrames = 8;
+		// Rendered extents are rounded up to multiples of this many pixels
+		uint32_t granularity = 8;
+	};
+
+	explicit DynamicResolution(const Config& resolutionConfig) :
+		config(resolutionConfig),
+		scale(resolutionConfig.maxScale) {
+	}
+
+	// Feed the gpu time of a finished frame. Returns whether the scale changed
+	bool update(double gpuMs) {
+		if (gpuMs <= 0.0) {
+			return false;
+		}
+		averageMs = averageMs > 0.0 ? averageMs + (gpuMs - averageMs) * config.smoothing : gpuMs;
+		if (cooldown > 0) {
+			cooldown--;
+			return false;
+		}
+
+		// Frame time goes roughly with the pixels rendered, the square of the scale. Growing aims for the
+		// middle of the band the scale holds in, so it does not land right back over the budget
+		float target = config.targetMs;
+		float next = scale;
+		if (averageMs > target) {
+			next = std::max(scale * std::sqrt(target / static_cast<float>(averageMs)), scale - config.maxStep);
+		} else if (averageMs < target * (1.0f - config.hysteresis)) {
+			next = std::min(scale * std::sqrt(target * (1.0f - 0.5f * config.hysteresis) / static_cast<float>(averageMs)), scale + config.maxStep);
+		}
+		next = std::min(std::max(next, config.minScale), config.maxScale);
+		if (std::abs(next - scale) < 0.01f) {
+			return false;
+		}
+
+		// Expect the average to follow the pixel count until frames at the new scale replace it
+		averageMs *= (next * next) / (scale * scale);
+		scale = next;
+		cooldown = config.cooldownFrames;
+		changes++;
+		return true;
+	}
+
+	// Part of a screen of this size the scene is rendered into
+	VkExtent2D getRenderExtent(VkExtent2D screen) const {
+		auto axis = [&](uint32_t size) {
+			uint32_t scaled = static_cast<uint32_t>(std::ceil(size * scale / config.granularity)) * config.granularity;
+			return std::min(std::max(scaled, 1u), size);
+		};
+		return { axis(screen.width), axis(screen.height) };
+	}
+
+	float getScale() const { return scale; }
+	double getAverageMs() const { return averageMs; }
+	const Config& getConfig() const { return config; }
+	// Scale changes so far
+	uint32_t getChanges() const { return changes; }
+
+private:
+	Config config;
+	float scale;
+	double averageMs = 0.0;
+	uint32_t cooldown = 0;
+	uint32_t changes = 0;
+};
@@ -0,0 +1,101 @@
+#pragma once
+
+#include "Settings.h"
+#include "ThreadPool.h"
+#include "VulkanUtil.h"
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <future>
+#include <string>
+#include <vector>
+
+// Writes rendered frames to disk without stalling the gpu or the render loop. A frame's image is copied into
+// one of a ring of host visible buffers in its own command buffer, and the buffer is only looked at again once
+// the frame's fence has signaled, which the render loop waits on anyway. Its pixels are then encoded and written
+// on worker threads of the capture's own, so neither the culling workers nor the frame wait on the disk. A frame
+// that finds every buffer still being copied or encoded is dropped rather than waited for
+class FrameCapture {
+public:
+	struct Config {
+		// Created if it does not exist. Frames go in as frame_<number>.png, or frame_<number>_<width>x<height>.rgba raw
+		std::string directory = "captures";
+		CaptureFormat format = CaptureFormat::Png;
+		// Frames in flight plus the encodes that may be behind. At most this many frames are held at once
+		uint32_t ringSize = 6;
+		uint32_t threads = 2;
+	};
+
+	// Over the whole capture
+	struct Stats {
+		uint64_t captured = 0;
+		// Frames recorded while every buffer was busy
+		uint64_t dropped = 0;
+		uint64_t written = 0;
+		uint64_t writtenBytes = 0;
+		// Summed over the workers, so may exceed the time the capture ran for
+		double encodeMs = 0.0;
+	};
+
+	FrameCapture(VkDevice device, VkPhysicalDevice physicalDevice, const Config& config);
+	FrameCapture(const FrameCapture&) = delete;
+	FrameCapture& operator=(const FrameCapture&) = delete;
+
+	// 8 bit RGBA and BGRA images can be captured, in either color space
+	static bool isSupported(VkFormat format);
+
+	// Copy an image in the transfer source layout into a free buffer of the ring, or count the frame as dropped.
+	// Making the copy visible to the host is left to the caller, fence is the one the submission signals
+	void recordCopy(VkCommandBuffer commandBuffer, VkImage image, VkExtent2D extent, VkFormat format, VkFence fence, uint64_t frameNumber);
+
+	// Hand copies whose fence has signaled to the workers and free the buffers they are done with. Must run
+	// between waiting on a frame's fence and resetting it, so no copy misses its fence signaling
+	void poll();
+
+	// Wait for every copy and encode, once the device is idle
+	void flush();
+
+	void destroy();
+
+	const Stats& getStats() const { return stats; }
+	const Config& getConfig() const { return config; }
+
+private:
+	// What a worker reports back about the frame it wrote
+	struct Written {
+		uint64_t bytes = 0;
+		double encodeMs = 0.0;
+	};
+
+	enum class SlotState {
+		Free,
+		// Copy recorded, fence not yet seen signaled
+		Copying,
+		// With a worker
+		Encoding,
+	};
+
+	struct Slot {
+		vkutil::Buffer buffer;
+		SlotState state = SlotState::Free;
+		VkFence fence = VK_NULL_HANDLE;
+		uint64_t frameNumber = 0;
+		VkExtent2D extent = { 0, 0 };
+		bool bgra = false;
+		std::future<Written> written;
+	};
+
+	// Encodes and writes the frame held by a slot, on a worker
+	Written write(const Slot& slot) const;
+	void collect(Slot& slot);
+
+	VkDevice device;
+	VkPhysicalDevice physicalDevice;
+	Config config;
+	VkMemoryPropertyFlags memoryProperties = 0;
+
+	std::vector<Slot> slots;
+	ThreadPool workers;
+	Stats stats;
+};
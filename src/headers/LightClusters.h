@@ -0,0 +1,89 @@
+#pragma once
+
+#include "AssetPack.h"
+#include "ShaderTypes.h"
+#include "VulkanUtil.h"
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <vector>
+
+// Clustered forward lighting. A compute pass splits the view frustum into a grid of clusters, screen tiles
+// cut into slices spaced exponentially in depth, and lists the lights whose sphere touches each cluster's box.
+// The lists are packed one after another into a single index buffer, each cluster claiming its range with an
+// atomic counter. Fragments then only loop over the lights of the cluster they fall into
+class LightClusters {
+public:
+	// Clusters along x, y and z
+	static const uint32_t GRID_X = 16;
+	static const uint32_t GRID_Y = 9;
+	static const uint32_t GRID_Z = 24;
+	static const uint32_t CLUSTER_COUNT = GRID_X * GRID_Y * GRID_Z;
+	// Lights one cluster can hold. Keep in sync with lights.glsl
+	static const uint32_t MAX_CLUSTER_LIGHTS = 256;
+
+	struct Config {
+		// Lights update uploads at most, the rest are left out
+		uint32_t maxLights = 4096;
+		// Index list size as an average per cluster. Clusters binned once it is full get no lights
+		uint32_t averageClusterLights = 32;
+		uint32_t framesInFlight = 2;
+		// Families of the queues binning and shading, when those differ. Everything but the readbacks is shared between them
+		std::vector<uint32_t> queueFamilies;
+	};
+
+	// Of the last binning read back
+	struct Stats {
+		uint32_t indexCount = 0;
+		uint32_t maxClusterLights = 0;
+		uint32_t overflowClusters = 0;
+	};
+
+	LightClusters(VkDevice device, VkPhysicalDevice physicalDevice, const AssetLoader& assets, const Config& config);
+	LightClusters(const LightClusters&) = delete;
+	LightClusters& operator=(const LightClusters&) = delete;
+
+	// Call once the frame's previous submission is done. Reads back what that submission binned and uploads the
+	// frame's lights and grid. bruteForce has every fragment loop over every light and skips the binning
+	void update(uint32_t frame, const CameraData& camera, VkExtent2D screen, const std::vector<LightData>& lights, bool bruteForce);
+
+	// Zero the index counter ahead of the binning, which must see the transfer's writes
+	void recordReset(VkCommandBuffer commandBuffer, uint32_t frame);
+	void recordBinning(VkCommandBuffer commandBuffer, uint32_t frame);
+	// Both of the above and the readback on a queue of their own. The shading queue must wait for it with a semaphore
+	void recordAsync(VkCommandBuffer commandBuffer, uint32_t frame);
+	// Copy the counters to where update reads them, after the binning. recordAsync does so itself
+	void recordReadback(VkCommandBuffer commandBuffer, uint32_t frame);
+
+	void destroy();
+
+	// Grid, lights and clusters, set 1 of the scene shaders
+	VkDescriptorSetLayout getSetLayout() const { return setLayout; }
+	VkDescriptorSet getDescriptorSet(uint32_t frame) const { return descriptorSets[frame]; }
+
+	uint32_t getLightCount() const { return lightCount; }
+	uint32_t getIndexCapacity() const { return indexCapacity; }
+	const Stats& getStats() const { return stats; }
+
+private:
+	VkDevice device;
+	Config config;
+	uint32_t indexCapacity = 0;
+	uint32_t lightCount = 0;
+
+	// Per frame in flight. Grids, lights and readbacks are host visible
+	std::vector<vkutil::Buffer> gridBuffers;
+	std::vector<vkutil::Buffer> lightBuffers;
+	std::vector<vkutil::Buffer> clusterBuffers;
+	std::vector<vkutil::Buffer> indexBuffers;
+	std::vector<vkutil::Buffer> readbackBuffers;
+
+	VkDescriptorSetLayout setLayout = VK_NULL_HANDLE;
+	VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
+	std::vector<VkDescriptorSet> descriptorSets;
+	VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+	VkPipeline pipeline = VK_NULL_HANDLE;
+
+	Stats stats;
+};
@@ -0,0 +1,21 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// LZ4 block format: runs of literals each followed by a match at most 64 KiB back. Compression is a single
+// greedy pass over a hash table of four byte sequences, decompression is little more than copies, which
+// is what makes it worth decoding at load time rather than reading the bytes uncompressed
+namespace lz4 {
+
+	// Most bytes compressing size bytes can take, incompressible data grows slightly
+	size_t compressBound(size_t size);
+
+	// Compress into dst, which must hold compressBound(size) bytes. Returns the compressed size
+	size_t compress(const uint8_t* src, size_t size, uint8_t* dst);
+
+	// Decompress a block that must expand to exactly dstSize bytes. Throws on malformed input rather than
+	// reading or writing past either buffer
+	void decompress(const uint8_t* src, size_t srcSize, uint8_t* dst, size_t dstSize);
+
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include "Vertex.h"
+#include "Meshlet.h"
+
+#include <vector>
+
+// One level of detail, a range of the mesh's index list and the meshlets covering it
+struct MeshLod {
+	uint32_t firstIndex = 0;
+	uint32_t indexCount = 0;
+	uint32_t firstMeshlet = 0;
+	uint32_t meshletCount = 0;
+	// Largest distance between this level's surface and the full detail one, in mesh space
+	float error = 0.0f;
+};
+
+struct Mesh {
+	std::vector<Vertex> vertices;
+	std::vector<uint32_t> indices;
+
+	// Bounding sphere in mesh space, used for culling
+	glm::vec3 boundsCenter = glm::vec3(0.0f);
+	float boundsRadius = 0.0f;
+
+	// Levels of detail from finest to coarsest, filled in by simplifier::generateLods.
+	// The first level always covers the full detail mesh
+	std::vector<MeshLod> lods;
+
+	// Clusters covering every level, filled in by meshlet::build
+	std::vector<Meshlet> meshlets;
+
+	// Fit the bounding sphere around our vertices
+	void computeBounds();
+};
+
+// Procedural meshes used to build our scenes. All are centered on the origin with
+// counter clockwise front faces
+namespace mesh {
+
+	// Unit cube spanning [-0.5, 0.5] on every axis
+	Mesh createCube();
+
+	// Sphere of radius 0.5 built from latitude/longitude bands
+	Mesh createSphere(uint32_t segments, uint32_t rings);
+
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <vector>
+
+struct Mesh;
+
+// A small cluster of a mesh's triangles, drawn as one contiguous range of the mesh's index buffer
+struct Meshlet {
+	// Offset and length inside the mesh's index list
+	uint32_t firstIndex = 0;
+	uint32_t indexCount = 0;
+	uint32_t vertexCount = 0;
+
+	// Bounding sphere in mesh space
+	glm::vec3 center = glm::vec3(0.0f);
+	float radius = 0.0f;
+
+	// Normal cone. The cluster faces away from any viewer for which
+	// dot(normalize(coneApex - viewer), coneAxis) >= coneCutoff. A cutoff of 1 never culls
+	glm::vec3 coneApex = glm::vec3(0.0f);
+	glm::vec3 coneAxis = glm::vec3(0.0f, 0.0f, 1.0f);
+	float coneCutoff = 1.0f;
+};
+
+namespace meshlet {
+
+	// Sized to fit a 64 thread culling workgroup and the usual mesh shader limits
+	const uint32_t MAX_VERTICES = 64;
+	const uint32_t MAX_TRIANGLES = 124;
+
+	// Split a mesh into spatially compact clusters and compute their bounds and normal cones.
+	// Every level of detail is clustered on its own, a mesh without levels gets one covering all of it.
+	// The mesh's indices are reordered so every meshlet is a contiguous index range
+	void build(Mesh& mesh, uint32_t maxVertices = MAX_VERTICES, uint32_t maxTriangles = MAX_TRIANGLES);
+
+}
@@ -0,0 +1,113 @@
+#pragma once
+
+#include "AssetPack.h"
+#include "DrawBatcher.h"
+#include "ShaderTypes.h"
+#include "VulkanUtil.h"
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <vector>
+
+// Draws the scene from many cameras into the layers of one array target, a layer per camera. With
+// VK_KHR_multiview a render pass's view mask broadcasts every draw to a group of layers and the vertex shader
+// picks each layer's camera by gl_ViewIndex, so the draws are recorded once per group rather than once per
+// camera. The same target can also be drawn a layer at a time with a render pass per camera, which is what
+// the multiview path is measured against and what is left where the device does not have it
+class MultiviewRenderer {
+public:
+	static const VkFormat COLOR_FORMAT = VK_FORMAT_R8G8B8A8_UNORM;
+
+	struct Config {
+		// Cameras, up to MAX_MULTIVIEW_VIEWS. With multiview split into groups as even as the group size allows,
+		// the last of which may be smaller
+		uint32_t views = 16;
+		VkExtent2D extent = { 512, 512 };
+		VkFormat depthFormat = VK_FORMAT_D32_SFLOAT;
+		// Layers a multiview render pass may draw at once, 0 when the device cannot or multiview is not enabled
+		uint32_t maxGroupViews = 0;
+	};
+
+	// Commands of a recording
+	struct Stats {
+		uint32_t renderPasses = 0;
+		DrawBatcher::Stats draws;
+	};
+
+	MultiviewRenderer(VkDevice device, VkPhysicalDevice physicalDevice, const AssetLoader& assets, const Config& config);
+	MultiviewRenderer(const MultiviewRenderer&) = delete;
+	MultiviewRenderer& operator=(const MultiviewRenderer&) = delete;
+
+	// Whether the device can render multiview passes, and how many layers one of them can draw. The feature
+	// and VK_KHR_multiview must then be enabled on the device for multiview to be used. Both go through
+	// VK_KHR_get_physical_device_properties2, whose functions are null when the instance does not have it
+	static bool isSupported(VkPhysicalDevice physicalDevice, PFN_vkGetPhysicalDeviceFeatures2KHR getFeatures2);
+	static uint32_t maxViewCount(VkPhysicalDevice physicalDevice, PFN_vkGetPhysicalDeviceProperties2KHR getProperties2);
+
+	// Every object of the scene at full detail, sorted and merged into instanced draws. The buffers are the
+	// scene's and must outlive the renderer
+	void setScene(const std::vector<ObjectData>& objects, const std::vector<MeshData>& meshes, const std::vector<LodData>& lods,
+		VkBuffer objectBuffer, VkBuffer vertexBuffer, VkBuffer indexBuffer);
+
+	// The camera of every view, as many as getViewCount. Must not be called while a recording is in flight
+	void setViews(const std::vector<glm::mat4>& viewProj, glm::vec3 lightDirection);
+
+	// Every view, a multiview render pass per group of layers. Needs multiview
+	Stats recordMultiview(VkCommandBuffer commandBuffer) const;
+	// A view on its own, in a render pass on its layer alone
+	Stats recordView(VkCommandBuffer commandBuffer, uint32_t view) const;
+
+	void destroy();
+
+	bool usesMultiview() const { return groupViews > 0; }
+	uint32_t getViewCount() const { return viewCount; }
+	uint32_t getGroupViews() const { return groupViews; }
+	uint32_t getLastGroupViews() const { return lastGroupViews; }
+	// Leaves every layer in the transfer source layout
+	const vkutil::Image& getColor() const { return color; }
+
+private:
+	VkRenderPass createRenderPass(uint32_t viewMask) const;
+	// The render pass a group is drawn with, and whose framebuffer it has
+	VkRenderPass groupPass(uint32_t group) const;
+	VkPipeline createPipeline(const AssetLoader& assets, const char* vertexShader, VkRenderPass compatiblePass) const;
+	void beginRenderPass(VkCommandBuffer commandBuffer, VkRenderPass pass, VkFramebuffer framebuffer, uint32_t viewOffset) const;
+
+	VkDevice device;
+	VkPhysicalDevice physicalDevice;
+	Config config;
+	uint32_t viewCount = 0;
+	// Layers each multiview render pass draws, 0 without multiview. The last group draws what is left
+	uint32_t groupViews = 0;
+	uint32_t lastGroupViews = 0;
+
+	vkutil::Image color;
+	vkutil::Image depth;
+
+	// A render pass drawing one layer, with a framebuffer per layer on a color and a depth view of it
+	VkRenderPass viewPass = VK_NULL_HANDLE;
+	std::vector<VkImageView> layerViews;
+	std::vector<VkFramebuffer> viewFramebuffers;
+	// A render pass drawing groupViews layers, with a framebuffer per group on views of its layers. The last
+	// group has a pass of its own when it draws fewer
+	VkRenderPass multiviewPass = VK_NULL_HANDLE;
+	VkRenderPass lastGroupPass = VK_NULL_HANDLE;
+	std::vector<VkImageView> groupLayerViews;
+	std::vector<VkFramebuffer> groupFramebuffers;
+
+	vkutil::Buffer viewBuffer;
+	vkutil::Buffer instanceBuffer;
+	VkDescriptorSetLayout setLayout = VK_NULL_HANDLE;
+	VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
+	VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+	VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+	VkPipeline viewPipeline = VK_NULL_HANDLE;
+	VkPipeline multiviewPipeline = VK_NULL_HANDLE;
+	VkPipeline lastGroupPipeline = VK_NULL_HANDLE;
+
+	DrawBatcher batcher;
+	DrawBatcher::Tables viewTables;
+	DrawBatcher::Tables multiviewTables;
+	DrawBatcher::Tables lastGroupTables;
+};
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+
+// Hashes and noise for procedural content, such as the generated textures and the benchmark scenes. The same
+// on every run and every thread
+namespace noise {
+
+	inline uint32_t hash(uint32_t x) {
+		x ^= x >> 16;
+		x *= 0x7feb352du;
+		x ^= x >> 15;
+		x *= 0x846ca68bu;
+		x ^= x >> 16;
+		return x;
+	}
+
+	// In [0, 1)
+	inline float hashUnit(uint32_t x) {
+		return (hash(x) & 0xFFFFFF) / float(0x1000000);
+	}
+
+	// Smooth noise on a grid of cells * cells values over [0, 1], wrapping around so it tiles
+	inline float valueNoise(float u, float v, uint32_t cells, uint32_t seed) {
+		float x = u * cells;
+		float y = v * cells;
+		float fx = x - std::floor(x);
+		float fy = y - std::floor(y);
+		uint32_t x0 = static_cast<uint32_t>(std::floor(x)) % cells;
+		uint32_t y0 = static_cast<uint32_t>(std::floor(y)) % cells;
+		uint32_t x1 = (x0 + 1) % cells;
+		uint32_t y1 = (y0 + 1) % cells;
+
+		auto at = [&](uint32_t cx, uint32_t cy) {
+			return hashUnit(seed ^ hash(cy * 0x9E3779B1u + cx));
+		};
+
+		fx = fx * fx * (3.0f - 2.0f * fx);
+		fy = fy * fy * (3.0f - 2.0f * fy);
+		float top = at(x0, y0) + (at(x1, y0) - at(x0, y0)) * fx;
+		float bottom = at(x0, y1) + (at(x1, y1) - at(x0, y1)) * fx;
+		return top + (bottom - top) * fy;
+	}
+
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include "OcclusionRasterizer.h"
+#include "Scene.h"
+#include "Settings.h"
+#include "ShaderTypes.h"
+
+#include <cstdint>
+#include <vector>
+
+// Cpu side visibility for a scene. Objects flagged as occluders are rasterized into a software
+// depth buffer every frame and every object's bounding sphere is tested against it
+class OcclusionCuller {
+public:
+	// Resolution of the software depth buffer, independent of the window
+	static const uint32_t RASTER_WIDTH = 320;
+	static const uint32_t RASTER_HEIGHT = 192;
+
+	struct Stats {
+		uint32_t frustumVisible = 0;
+		uint32_t visible = 0;
+		double rasterMs = 0.0;
+		double testMs = 0.0;
+	};
+
+	OcclusionCuller(const Scene& scene, ThreadPool& pool);
+
+	// Set visible[i] to 1 for every object inside the frustum and not hidden by the occluders
+	Stats cull(const CameraData& camera, std::vector<uint8_t>& visible);
+
+	OcclusionRasterizer& getRasterizer() { return rasterizer; }
+
+	// Render a camera path with every available implementation and compare the depth buffers and
+	// visibility against the scalar reference. Prints timings and returns false on a mismatch
+	static bool runValidation(const AppSettings& settings);
+
+private:
+	ThreadPool& threadPool;
+	OcclusionRasterizer rasterizer;
+
+	// World space occluder triangles, built once since the scene is static
+	std::vector<glm::vec3> occluderTriangles;
+	std::vector<glm::vec4> boundingSpheres;
+};
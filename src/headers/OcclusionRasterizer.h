@@ -0,0 +1,96 @@
+#pragma once
+
+#include "ThreadPool.h"
+
+#include <glm/glm.hpp>
+
+#include <vector>
+
+namespace occlusion {
+
+	// Screen space triangle ready for rasterization. Edge functions are positive inside,
+	// evaluated at pixel centers as a * x + b * y + c
+	struct TriangleSetup {
+		float edgeA[3];
+		float edgeB[3];
+		float edgeC[3];
+		float depthA;
+		float depthB;
+		float depthC;
+		// Inclusive pixel bounds, clamped to the screen
+		int minX;
+		int minY;
+		int maxX;
+		int maxY;
+	};
+
+	// Inner loops, implemented once per instruction set
+	struct Kernels {
+		// Rasterize the rows [rowBegin, rowEnd) of a triangle, keeping the nearest depth
+		void (*rasterizeRows)(const TriangleSetup& triangle, float* depth, uint32_t width, int rowBegin, int rowEnd);
+		// Farthest depth of the TILE_SIZE x TILE_SIZE block starting at depth
+		float (*tileMax)(const float* depth, uint32_t width);
+		// True if any pixel of the inclusive rectangle is at or behind nearestDepth
+		bool (*anyFarther)(const float* depth, uint32_t width, int x0, int y0, int x1, int y1, float nearestDepth);
+	};
+
+	const Kernels& scalarKernels();
+	const Kernels* sseKernels();
+	const Kernels* avx2Kernels();
+
+}
+
+// Coarse software depth buffer for cpu occlusion culling. Large occluders are rasterized into a
+// low resolution depth buffer with a max depth per tile on top, and object bounds are tested
+// against the tiles first, then the pixels of the tiles that could not reject them
+class OcclusionRasterizer {
+public:
+	enum class Implementation {
+		Scalar,
+		SSE,
+		AVX2,
+	};
+
+	static const uint32_t TILE_SIZE = 8;
+
+	// Width and height are rounded up to whole tiles
+	OcclusionRasterizer(uint32_t targetWidth, uint32_t targetHeight, ThreadPool& pool);
+
+	// Fastest implementation this cpu and build support
+	static Implementation bestImplementation();
+	static const char* implementationName(Implementation implementation);
+
+	void setImplementation(Implementation implementation);
+	Implementation getImplementation() const { return implementation; }
+
+	// Rasterize world space triangles, three vertices each, seen through viewProj
+	// The depth buffer is cleared first and the tile hierarchy rebuilt afterwards
+	void renderOccluders(const std::vector<glm::vec3>& triangles, const glm::mat4& viewProj);
+
+	// True if the sphere lies behind the occluders everywhere it covers. view and proj must match
+	// the matrices the occluders were rendered with
+	bool isOccluded(const glm::vec4& sphere, const glm::mat4& view, const glm::mat4& proj, float nearPlane) const;
+
+	uint32_t getWidth() const { return width; }
+	uint32_t getHeight() const { return height; }
+	const std::vector<float>& getDepth() const { return depth; }
+
+private:
+	// Project, near clip and set up one triangle, appending the results to setups
+	void setupTriangle(const glm::vec4 clip[3], std::vector<occlusion::TriangleSetup>& setups) const;
+
+	uint32_t width;
+	uint32_t height;
+	uint32_t tilesX;
+	uint32_t tilesY;
+
+	std::vector<float> depth;
+	std::vector<float> tileMaxDepth;
+
+	// Per thread setup output, merged before rasterizing
+	std::vector<std::vector<occlusion::TriangleSetup>> setupChunks;
+
+	Implementation implementation;
+	const occlusion::Kernels* kernels;
+	ThreadPool& threadPool;
+};
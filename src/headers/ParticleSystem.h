@@ -0,0 +1,117 @@
+#pragma once
+
+#include "AssetPack.h"
+#include "ShaderTypes.h"
+#include "VulkanUtil.h"
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <vector>
+
+// Particles living entirely on the gpu. Free particles sit on a dead list, living ones on one of two alive
+// lists that swap every frame. The simulation reads last frame's list, dispatched indirectly from its count,
+// returns expired particles to the dead list and appends the survivors to this frame's list, which keeps it
+// compact. Emission takes from the dead list and appends to the same list, whose count then becomes the
+// instance count of an indirect draw of camera facing quads. The cpu only ever sees the counters
+class ParticleSystem {
+public:
+	struct Config {
+		// Particles that can be alive at once
+		uint32_t capacity = 1 << 20;
+		// Particles emitted per second, 0 emits as many as keep the capacity alive
+		float emitRate = 0.0f;
+		float lifetime = 4.0f;
+		// Center and radius of the disc particles are launched from, and how fast
+		glm::vec3 emitterCenter = glm::vec3(0.0f);
+		float emitterRadius = 0.5f;
+		float launchSpeed = 11.0f;
+		float launchSpeedVariation = 3.0f;
+		float sidewaysSpeed = 4.0f;
+		float gravity = -9.81f;
+		// Speed a collision keeps, and how far behind the depth buffer a particle still collides with it
+		float restitution = 0.4f;
+		float collisionThickness = 0.5f;
+		// Half the size of a particle's quad in world units
+		float size = 0.03f;
+		uint32_t framesInFlight = 2;
+	};
+
+	// Of the last frame read back
+	struct Stats {
+		uint32_t alive = 0;
+		uint32_t emitted = 0;
+	};
+
+	ParticleSystem(VkDevice device, VkPhysicalDevice physicalDevice, const AssetLoader& assets, const Config& config);
+	ParticleSystem(const ParticleSystem&) = delete;
+	ParticleSystem& operator=(const ParticleSystem&) = delete;
+
+	// The draw pipeline, for a render pass compatible with the one the scene is drawn in. Must not be
+	// called with frames in flight
+	void createRenderPipeline(const AssetLoader& assets, VkRenderPass renderPass, VkSampleCountFlagBits samples);
+	void destroyRenderPipeline();
+
+	// Point the simulation at the depth buffer it collides with. Must not be called with frames in flight
+	void setDepth(VkImageView depthView, bool multisampled);
+
+	// Call once the frame's previous submission is done. Reads back its counters and uploads the frame's
+	// camera and how many particles it emits. deltaTime is the time since the last frame in seconds
+	void update(uint32_t frame, const CameraData& camera, VkExtent2D screen, float deltaTime);
+
+	// Simulate, emit and size the draw, with the barriers between them. The depth buffer must be readable
+	void recordSimulation(VkCommandBuffer commandBuffer, uint32_t frame);
+	// Inside a render pass on the scene's color and depth, after the simulation's writes are visible to
+	// indirect draws and vertex shaders
+	void recordDraw(VkCommandBuffer commandBuffer, uint32_t frame, VkExtent2D screen);
+	// Copy the counters to where update reads them
+	void recordReadback(VkCommandBuffer commandBuffer, uint32_t frame);
+
+	void destroy();
+
+	uint32_t getCapacity() const { return config.capacity; }
+	float getEmitRate() const { return emitRate; }
+	VkDeviceSize getBytes() const;
+	const Stats& getStats() const { return stats; }
+
+private:
+	enum ArgsMode : uint32_t {
+		ARGS_RESET = 0,
+		ARGS_SIMULATE = 1,
+		ARGS_DRAW = 2,
+	};
+
+	void recordArgs(VkCommandBuffer commandBuffer, VkDescriptorSet set, ArgsMode mode, uint32_t groups);
+
+	VkDevice device;
+	Config config;
+	float emitRate = 0.0f;
+	float emitRemainder = 0.0f;
+	// Frames updated so far, which picks the alive list a frame fills and seeds its emission
+	uint32_t step = 0;
+	// Emitted by each frame in flight, known when it is updated
+	std::vector<uint32_t> emitCounts;
+	bool reset = false;
+	bool multisampledDepth = false;
+
+	vkutil::Buffer particleBuffer;
+	vkutil::Buffer deadListBuffer;
+	vkutil::Buffer aliveListBuffer;
+	vkutil::Buffer counterBuffer;
+	// Per frame in flight, host visible
+	std::vector<vkutil::Buffer> frameBuffers;
+	std::vector<vkutil::Buffer> readbackBuffers;
+
+	VkSampler depthSampler = VK_NULL_HANDLE;
+	VkDescriptorSetLayout setLayout = VK_NULL_HANDLE;
+	VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
+	std::vector<VkDescriptorSet> descriptorSets;
+	VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+	VkPipeline argsPipeline = VK_NULL_HANDLE;
+	VkPipeline simulatePipeline = VK_NULL_HANDLE;
+	VkPipeline simulateMultisampledPipeline = VK_NULL_HANDLE;
+	VkPipeline emitPipeline = VK_NULL_HANDLE;
+	VkPipeline renderPipeline = VK_NULL_HANDLE;
+
+	Stats stats;
+};
@@ -0,0 +1,19 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// PNG files of 8 bit RGB images. Each row gets the filter that leaves the smallest differences, then the rows
+// are deflated in one block of fixed Huffman codes, matching repeats greedily through a hash table of three
+// byte sequences like the LZ4 compressor does. Much less than a full deflate achieves on photos, but rendered
+// frames are mostly smooth gradients and flat colors, and it is quick enough to keep up with a frame rate
+namespace png {
+
+	// rgb holds height rows of width pixels, three bytes each, with rowPitch bytes from one row to the next
+	std::vector<uint8_t> encode(const uint8_t* rgb, uint32_t width, uint32_t height, size_t rowPitch);
+
+	// CRC-32 as PNG chunks and zip use it, continuing from a previous crc
+	uint32_t crc32(const uint8_t* data, size_t size, uint32_t crc = 0);
+
+}
@@ -0,0 +1,144 @@
+#pragma once
+
+#include "AssetPack.h"
+#include "ShaderTypes.h"
+#include "VulkanUtil.h"
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <vector>
+
+// Post processing of the HDR target as a chain of compute passes. A luminance histogram of the target drives an
+// auto exposure that adapts over time, bloom is built by downsampling the bright parts through a chain of ever
+// smaller levels and upsampling them back, and a single final pass adds the bloom, exposes, tonemaps, grades and
+// writes the output. Everything past the histogram and the bloom chain touches the full resolution target once,
+// where a fragment pass per effect would read and write it again for every one of them
+class PostProcess {
+public:
+	static const VkFormat HDR_FORMAT = VK_FORMAT_R16G16B16A16_SFLOAT;
+	static const VkFormat BLOOM_FORMAT = VK_FORMAT_R16G16B16A16_SFLOAT;
+	// Format the output must have unless it is written without one
+	static const VkFormat OUTPUT_FORMAT = VK_FORMAT_R8G8B8A8_UNORM;
+	static const uint32_t MAX_BLOOM_LEVELS = 8;
+
+	struct Config {
+		// Passes left out are not recorded and their results not read
+		bool bloom = true;
+		bool autoExposure = true;
+		// Levels of the bloom chain, the first at half the screen's resolution. Small screens get fewer
+		uint32_t bloomLevels = 6;
+		float bloomThreshold = 1.0f;
+		float bloomKnee = 0.5f;
+		float bloomIntensity = 0.05f;
+		float bloomRadius = 1.0f;
+		// Log2 luminance range the histogram covers, and how fast the exposure follows it, per second
+		float minLogLuminance = -8.0f;
+		float logLuminanceRange = 12.0f;
+		float adaptationRate = 1.5f;
+		float exposureCompensation = 0.0f;
+		float saturation = 1.05f;
+		float contrast = 1.05f;
+		glm::vec3 tint = glm::vec3(1.02f, 1.0f, 0.97f);
+		// Reduce the histogram and exposure with subgroup operations, which subgroupsSupported must allow
+		bool subgroups = false;
+		// Store the output without a format, which takes shaderStorageImageWriteWithoutFormat to be enabled.
+		// Otherwise outputs must be OUTPUT_FORMAT
+		bool outputWithoutFormat = false;
+	};
+
+	// Bytes a frame reads and writes, estimated from texel sizes and assuming every texel is fetched once.
+	// Passes left out count as nothing
+	struct Bandwidth {
+		VkDeviceSize histogram = 0;
+		VkDeviceSize bloom = 0;
+		VkDeviceSize tonemap = 0;
+		// The final pass as separate full screen passes instead: the bloom composited into the HDR target,
+		// exposure and tonemapping into an LDR target and grading from it into the output
+		VkDeviceSize unfusedTonemap = 0;
+	};
+
+	PostProcess(VkDevice device, VkPhysicalDevice physicalDevice, const AssetLoader& assets, const Config& config);
+	PostProcess(const PostProcess&) = delete;
+	PostProcess& operator=(const PostProcess&) = delete;
+
+	// Compute shaders can vote, ballot and add across subgroups. Needs Vulkan 1.1 on both the device and the
+	// instance, getProperties2 is null when the instance does not have it
+	static bool subgroupsSupported(VkPhysicalDevice physicalDevice, PFN_vkGetPhysicalDeviceProperties2KHR getProperties2);
+
+	// Size the bloom chain for a screen, nothing happens if it already is. Must not be called with frames in flight
+	void resize(VkExtent2D screen);
+
+	// Part of the HDR target the scene is rendered into this frame, from its top left corner. The histogram
+	// only counts it and the tonemap scales it up to the whole output. resize sets it to the whole screen
+	void setRenderExtent(VkExtent2D extent);
+
+	// Point the passes at the frame's HDR target and every image the final pass may write, a frame picks one of
+	// them by index. encodeSrgb has the final pass encode, for outputs whose format does not. Must not be called
+	// with frames in flight
+	void setTargets(VkImageView hdrView, const std::vector<VkImageView>& outputViews, bool encodeSrgb);
+
+	// Add up the HDR target's histogram, then adapt the exposure to it and clear it for the next frame.
+	// deltaTime is the time since the last frame in seconds
+	void recordHistogram(VkCommandBuffer commandBuffer);
+	void recordExposure(VkCommandBuffer commandBuffer, float deltaTime);
+	// Build the bloom chain down and back up, with the barriers between its levels. It must be in the general layout
+	void recordBloom(VkCommandBuffer commandBuffer);
+	// Write the output, which must be in the general layout. The bloom chain and HDR target are sampled
+	void recordTonemap(VkCommandBuffer commandBuffer, uint32_t outputIndex);
+
+	void destroy();
+
+	// Level views are made for the bloom passes, the default view covers every level
+	const vkutil::Image& getBloomChain() const { return bloom; }
+	uint32_t getBloomLevels() const { return bloom.mipLevels; }
+	// The histogram and adapted exposure, kept between frames
+	VkBuffer getExposureBuffer() const { return exposureBuffer.buffer; }
+	bool usesSubgroups() const { return config.subgroups; }
+	bool usesBloom() const { return config.bloom; }
+	bool usesAutoExposure() const { return config.autoExposure; }
+
+	Bandwidth getBandwidth(VkFormat outputFormat) const;
+
+private:
+	enum BloomMode : uint32_t {
+		BLOOM_PREFILTER = 0,
+		BLOOM_DOWNSAMPLE = 1,
+		BLOOM_UPSAMPLE = 2,
+	};
+
+	// Zero the histogram and exposure the first time either is recorded, with a barrier before the shaders use them
+	void clearExposure(VkCommandBuffer commandBuffer);
+	void destroyBloom();
+	VkExtent2D levelExtent(uint32_t level) const;
+	PostPushConstants getPushConstants() const;
+	void dispatch(VkCommandBuffer commandBuffer, VkPipeline pipeline, VkDescriptorSet set, const PostPushConstants& constants,
+		VkExtent2D size, uint32_t groupSize);
+
+	VkDevice device;
+	VkPhysicalDevice physicalDevice;
+	Config config;
+
+	VkExtent2D screen = { 0, 0 };
+	VkExtent2D renderExtent = { 0, 0 };
+	vkutil::Image bloom;
+	std::vector<VkImageView> bloomLevelViews;
+	vkutil::Buffer exposureBuffer;
+	bool exposureCleared = false;
+	bool encodeSrgb = true;
+
+	VkDescriptorSetLayout setLayout = VK_NULL_HANDLE;
+	VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+	VkPipeline histogramPipeline = VK_NULL_HANDLE;
+	VkPipeline exposurePipeline = VK_NULL_HANDLE;
+	VkPipeline bloomPipeline = VK_NULL_HANDLE;
+	VkPipeline tonemapPipeline = VK_NULL_HANDLE;
+	VkSampler sampler = VK_NULL_HANDLE;
+
+	// Remade with every setTargets. A set per output, which the histogram and exposure passes also use,
+	// then a set per bloom level going down and one per level but the last going up
+	VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
+	std::vector<VkDescriptorSet> outputSets;
+	std::vector<VkDescriptorSet> downsampleSets;
+	std::vector<VkDescriptorSet> upsampleSets;
+};
@@ -5,6 +5,8 @@
 struct QueueFamilyIndices {
 	std::optional<uint32_t> graphicsFamily;
 	std::optional<uint32_t> presentFamily;
+	// Compute without graphics, what is submitted to it runs alongside the graphics queue. Not every device has one
+	std::optional<uint32_t> computeFamily;
 
 	bool isComplete() {
 		return graphicsFamily.has_value() && presentFamily.has_value();;
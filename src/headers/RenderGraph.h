@@ -0,0 +1,267 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <deque>
+#include <functional>
+#include <string>
+#include <vector>
+
+// A frame described as a list of passes and the resources each of them reads and writes.
+// Compiling the graph culls the passes whose results nothing uses, creates the transient images,
+// render passes and framebuffers the remaining ones need, and works out every barrier and layout
+// transition between them. Transient images whose lifetimes do not overlap share memory, and those only
+// ever living inside one render pass get lazily allocated memory where the device has it.
+// The graph is recorded the same way every frame, so resources left in use at the end of one frame
+// are synchronized with their first use in the next
+class RenderGraph {
+public:
+	// Index of an image or buffer declared in the graph
+	typedef uint32_t Resource;
+
+	// Every way a pass can use a resource. Each one maps to a pipeline stage, access mask and image layout
+	enum class Usage : uint32_t {
+		ColorAttachment,
+		DepthAttachment,
+		// Depth sampled by a compute shader in the read only depth layout
+		ComputeSampledDepth,
+		ComputeSampled,
+		// Storage image read and written by a compute shader
+		ComputeStorageImage,
+		ComputeStorageRead,
+		// Storage buffer read and written by a compute shader
+		ComputeStorageWrite,
+		VertexStorageRead,
+		// Depth sampled by a fragment shader in the read only depth layout
+		FragmentSampledDepth,
+		FragmentStorageRead,
+		// Storage buffer written by a fragment shader
+		FragmentStorageWrite,
+		// Indirect draw or dispatch arguments
+		IndirectRead,
+		TransferRead,
+		TransferWrite,
+	};
+
+	// Transient images also get whatever usage flags their passes need
+	struct ImageDesc {
+		VkFormat format = VK_FORMAT_UNDEFINED;
+		VkExtent2D extent = { 0, 0 };
+		uint32_t mipLevels = 1;
+		VkSampleCountFlagBits samples = VK_SAMPLE_COUNT_1_BIT;
+		VkImageUsageFlags usage = 0;
+		VkImageAspectFlags aspect = VK_IMAGE_ASPECT_COLOR_BIT;
+	};
+
+	// Transient image memory with and without aliasing, and what compiling the graph produced
+	struct Stats {
+		uint32_t passes = 0;
+		uint32_t culledPasses = 0;
+		uint32_t barriers = 0;
+		uint32_t layoutTransitions = 0;
+		uint32_t transientImages = 0;
+		// Every transient image as if it had its own memory
+		VkDeviceSize transientMemory = 0;
+		// Memory actually allocated for the aliased transients, lazily allocated images excluded
+		VkDeviceSize aliasedMemory = 0;
+		// Transients in lazily allocated memory, which is only committed if the device needs it
+		uint32_t lazyImages = 0;
+		VkDeviceSize lazyMemory = 0;
+		// Attachment bytes written back to memory each frame, and those the store ops let the device skip
+		VkDeviceSize attachmentStoreBytes = 0;
+		VkDeviceSize attachmentDiscardBytes = 0;
+	};
+
+	class Pass {
+	public:
+		// Declare a use of a resource. Several uses of one resource in a pass must agree on the layout
+		Pass& use(Resource resource, Usage usage);
+
+		// Render to an image. A pass with attachments records inside a render pass made for it,
+		// colors are bound in the order they are declared
+		Pass& colorAttachment(Resource resource, VkAttachmentLoadOp loadOp, VkClearColorValue clear = {});
+		Pass& depthAttachment(Resource resource, VkAttachmentLoadOp loadOp, float clearDepth = 1.0f);
+
+		// Resolve the last declared, multisampled, color attachment into a single sampled image at the end of the pass
+		Pass& resolveAttachment(Resource resource);
+
+		// Keep the pass even if nothing reads what it writes
+		Pass& sideEffect();
+
+		// Render only the top left corner of the attachments that area points at. It is read every time the pass
+		// executes, so it can change between frames without compiling the graph again, and must fit the attachments
+		Pass& renderArea(const VkExtent2D* area);
+
+		// Record the pass. Barriers are already in place and the render pass, if any, has begun
+		Pass& execute(std::function<void(VkCommandBuffer)> callback);
+
+	private:
+		friend class RenderGraph;
+
+		struct ResourceUse {
+			Resource resource;
+			VkPipelineStageFlags stage;
+			VkAccessFlags access;
+			VkImageLayout layout;
+			VkImageUsageFlags imageUsage;
+			bool read;
+			bool write;
+			// The previous contents do not matter, the first transition may start from undefined
+			bool discard;
+		};
+
+		struct Attachment {
+			Resource resource;
+			VkAttachmentLoadOp loadOp;
+			VkClearValue clear;
+		};
+
+		Pass(RenderGraph& graph, const std::string& name);
+
+		ResourceUse& addUse(Resource resource, Usage usage);
+
+		RenderGraph& graph;
+		std::string name;
+		std::vector<ResourceUse> uses;
+		std::vector<Attachment> colorAttachments;
+		std::vector<Attachment> depthAttachments;
+		// Resolve target of each color attachment, or NO_RESOURCE
+		std::vector<Resource> resolveAttachments;
+		bool keep = false;
+		const VkExtent2D* area = nullptr;
+		std::function<void(VkCommandBuffer)> callback;
+
+		// Filled in by compile
+		bool culled = false;
+		uint32_t barrierBatch = 0;
+		VkRenderPass renderPass = VK_NULL_HANDLE;
+		std::vector<VkFramebuffer> framebuffers;
+		VkExtent2D extent = { 0, 0 };
+	};
+
+	RenderGraph() = default;
+	RenderGraph(const RenderGraph&) = delete;
+	RenderGraph& operator=(const RenderGraph&) = delete;
+
+	// Forget every declared pass and resource. Compiled objects live on until the next compile or destroy
+	void reset();
+
+	// Image owned by the graph, only valid during the passes using it
+	Resource createImage(const std::string& name, const ImageDesc& desc);
+
+	// Image owned by the application. It is in initialLayout when the graph starts and left in
+	// finalLayout. With several images, execute picks one by index, as for swap chain images.
+	// A non zero initialStage is waited on before the first use, otherwise the last use of the previous frame is
+	Resource importImage(const std::string& name, const ImageDesc& desc, const std::vector<VkImage>& images,
+		const std::vector<VkImageView>& views, VkImageLayout initialLayout, VkImageLayout finalLayout,
+		VkPipelineStageFlags initialStage = 0);
+
+	// Buffer owned by the application. Buffers are synchronized with memory barriers, so only their
+	// dependencies are tracked. finalStage and finalAccess make the last write visible after the graph, to the host for example
+	Resource importBuffer(const std::string& name, VkPipelineStageFlags finalStage = 0, VkAccessFlags finalAccess = 0);
+
+	Pass& addPass(const std::string& name);
+
+	// Cull passes, create transient images, render passes and framebuffers, and plan barriers.
+	// Destroys what the previous compile created, so the device must be idle
+	void compile(VkDevice device, VkPhysicalDevice physicalDevice);
+
+	// Record every pass that survived culling with its barriers. importIndex picks between imported images
+	void execute(VkCommandBuffer commandBuffer, uint32_t importIndex) const;
+
+	void destroy(VkDevice device);
+
+	VkImage getImage(Resource resource, uint32_t importIndex = 0) const;
+	VkImageView getImageView(Resource resource, uint32_t importIndex = 0) const;
+	const Stats& getStats() const { return stats; }
+
+	// Lazily allocated memory the device has actually committed so far
+	VkDeviceSize getCommittedLazyMemory(VkDevice device) const;
+
+	// Render pass compatible with the ones the graph creates for these attachments, for pipeline creation.
+	// Resolve attachments do not matter for the compatibility of single subpass render passes
+	static VkRenderPass createCompatibleRenderPass(VkDevice device, const std::vector<VkFormat>& colorFormats, VkFormat depthFormat,
+		VkSampleCountFlagBits samples = VK_SAMPLE_COUNT_1_BIT);
+
+private:
+	static constexpr Resource NO_RESOURCE = ~0u;
+
+	struct ResourceData {
+		std::string name;
+		bool isImage = false;
+		bool imported = false;
+		ImageDesc desc;
+
+		// Imported images, or the one transient image once compiled
+		std::vector<VkImage> images;
+		std::vector<VkImageView> views;
+		VkImageLayout initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		VkImageLayout finalLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		VkPipelineStageFlags initialStage = 0;
+		VkPipelineStageFlags finalStage = 0;
+		VkAccessFlags finalAccess = 0;
+
+		// Range of compiled passes using the resource, and the transient it shares memory with before it
+		uint32_t firstPass = 0;
+		uint32_t lastPass = 0;
+		bool used = false;
+		Resource aliasPredecessor = 0;
+		// Usage of every compiled pass together, and whether the image sits in lazily allocated memory
+		VkImageUsageFlags usage = 0;
+		bool lazy = false;
+	};
+
+	// How the last accesses to a resource left it
+	struct ResourceState {
+		VkImageLayout layout = VK_IMAGE_LAYOUT_UNDEFINED;
+		VkPipelineStageFlags writeStages = 0;
+		VkAccessFlags writeAccess = 0;
+		VkPipelineStageFlags readStages = 0;
+		// Stages and accesses the last write has already been made visible to
+		VkPipelineStageFlags visibleStages = 0;
+		VkAccessFlags visibleAccess = 0;
+	};
+
+	struct ImageTransition {
+		Resource resource;
+		VkImageLayout oldLayout;
+		VkImageLayout newLayout;
+		VkAccessFlags srcAccess;
+		VkAccessFlags dstAccess;
+	};
+
+	// Everything one vkCmdPipelineBarrier records
+	struct BarrierBatch {
+		VkPipelineStageFlags srcStages = 0;
+		VkPipelineStageFlags dstStages = 0;
+		VkAccessFlags srcAccess = 0;
+		VkAccessFlags dstAccess = 0;
+		std::vector<ImageTransition> transitions;
+	};
+
+	void cullPasses();
+	void createTransientImages(VkDevice device, VkPhysicalDevice physicalDevice);
+	void createRenderPasses(VkDevice device);
+
+	// Run every compiled pass over the given states, appending barriers to batches when they are given
+	void simulate(std::vector<ResourceState>& states, std::vector<BarrierBatch>* batches) const;
+	void applyUse(ResourceState& state, const ResourceData& resource, const Pass::ResourceUse& use, bool firstUse, BarrierBatch* batch) const;
+	void recordBarriers(VkCommandBuffer commandBuffer, const BarrierBatch& batch, uint32_t importIndex) const;
+
+	std::vector<ResourceData> resources;
+	// Passes hand out references to themselves, a deque keeps them stable
+	std::deque<Pass> passes;
+	std::vector<Pass*> compiledPasses;
+
+	// One batch before each compiled pass and one after the last
+	std::vector<BarrierBatch> barrierBatches;
+
+	std::vector<VkDeviceMemory> transientMemory;
+	std::vector<VkDeviceMemory> lazyMemory;
+	std::vector<VkImage> transientImages;
+	std::vector<VkImageView> transientViews;
+	std::vector<VkRenderPass> renderPasses;
+	std::vector<VkFramebuffer> framebuffers;
+
+	Stats stats;
+};
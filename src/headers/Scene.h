@@ -0,0 +1,55 @@
+#pragma once
+
+#include "Mesh.h"
+#include "ShaderTypes.h"
+
+#include <vector>
+
+struct SceneObject {
+	glm::mat4 model = glm::mat4(1.0f);
+	glm::vec4 color = glm::vec4(1.0f);
+	uint32_t meshIndex = 0;
+	// Large closed geometry the cpu occlusion culler rasterizes as an occluder
+	bool occluder = false;
+	// The ground plane, covered by the virtual texture when there is one
+	bool ground = false;
+	// Moves or may move, so its shadow is drawn every frame rather than cached with the static geometry
+	bool dynamic = false;
+};
+
+// Point light drifting around its home position
+struct PointLight {
+	glm::vec3 position = glm::vec3(0.0f);
+	float radius = 1.0f;
+	glm::vec3 color = glm::vec3(1.0f);
+	// Radius and angular speed of the circle it drifts on, and where on it the light starts
+	float driftRadius = 0.0f;
+	float driftSpeed = 0.0f;
+	float driftPhase = 0.0f;
+};
+
+struct Scene {
+	std::vector<Mesh> meshes;
+	std::vector<SceneObject> objects;
+	std::vector<PointLight> lights;
+
+	// Half the width of the scene on the ground plane, centered on the origin
+	float extent = 0.0f;
+
+	// World space bounding sphere of an object, center in xyz and radius in w
+	glm::vec4 getBoundingSphere(const SceneObject& object) const;
+
+	// Scatter count small colored lights just above the ground over the whole scene
+	void addLights(uint32_t count, uint32_t seed = 7331);
+
+	// Where every light is at a point in time, as the shaders take them
+	void getLights(float time, std::vector<LightData>& result) const;
+
+	// Dense city layout of gridSize * gridSize blocks. Buildings occlude the props placed
+	// in the streets between them, which is what our occlusion culling is tested against
+	static Scene createCity(uint32_t gridSize, uint32_t seed = 1337);
+
+	// gridSize * gridSize high poly spheres on a ground plane. Most of them are far enough away
+	// to be drawn with a coarse level of detail, which is what our lod selection is tested against
+	static Scene createDense(uint32_t gridSize, uint32_t seed = 1337);
+};
@@ -0,0 +1,412 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdlib>
+#include <stdexcept>
+#include <string>
+
+enum class CullingMode : uint32_t {
+	None = 0,
+	Frustum = 1,
+	HiZ = 2,
+	// Frustum and occlusion culling on the cpu against a software depth buffer
+	CpuOcclusion = 3,
+};
+
+static const uint32_t CULLING_MODE_COUNT = 4;
+
+enum class SceneType : uint32_t {
+	// Buildings hiding low poly props, made for occlusion culling
+	City = 0,
+	// Field of high poly spheres stretching into the distance, made for levels of detail
+	Dense = 1,
+};
+
+// Block compressed format the texture baker writes color in
+enum class TextureCompression : uint32_t {
+	BC1 = 0,
+	// BC1 color with separately compressed alpha
+	BC3 = 1,
+	BC7 = 2,
+};
+
+// How captured frames are written
+enum class CaptureFormat : uint32_t {
+	Png = 0,
+	// The frame's RGBA bytes as they are, its size in the file name
+	Raw = 1,
+};
+
+// Options that can be changed from the command line
+struct AppSettings {
+	// How objects are rejected before they are drawn
+	CullingMode cullingMode = CullingMode::HiZ;
+
+	SceneType scene = SceneType::City;
+
+	// Both scenes are laid out on a gridSize * gridSize grid
+	uint32_t gridSize = 32;
+
+	// Cull and draw meshes per cluster rather than per object when the device supports it
+	bool meshlets = true;
+
+	// Draw every object with the coarsest level of detail that stays within lodPixelError pixels
+	// of the full mesh on screen. A coarser level must get below (1 - lodHysteresis) of that before
+	// an object switches to it
+	bool lod = true;
+	float lodPixelError = 1.0f;
+	float lodHysteresis = 0.25f;
+
+	// Samples per pixel of the scene attachments, lowered to what the device supports. 1 disables multisampling
+	uint32_t msaaSamples = 4;
+
+	// Texture objects with a set of streamed textures, where the device can index them per object.
+	// Their mips are kept within textureBudgetMB, lowered further to what the device reports is left
+	bool textures = true;
+	uint32_t textureSize = 2048;
+	uint32_t textureBudgetMB = 128;
+
+	// Cover the ground with a virtual texture of virtualTexturePages * virtualTexturePages pages, only the
+	// pages on screen kept in a cache of virtualTextureCacheMB
+	bool virtualTexture = true;
+	uint32_t virtualTexturePages = 256;
+	uint32_t virtualTextureCacheMB = 64;
+
+	// Point lights scattered over the scene. Fragments loop over the lights binned into their cluster of the
+	// view frustum, or over every light without lightBinning
+	uint32_t lightCount = 1024;
+	bool lightBinning = true;
+
+	// Bin the lights on a compute queue of their own where the device has one, overlapping the shadow pass
+	// on the graphics queue, rather than ahead of it on the graphics queue
+	bool asyncCompute = true;
+
+	// Sun shadows from cascades of shadowMapSize texels a side, sharing one atlas, out to shadowDistance from
+	// the camera or its far plane when 0. With shadowCache the static geometry of the far cascades is kept
+	// between frames and only the dynamic one is drawn over it
+	uint32_t shadowMapSize = 1024;
+	float shadowDistance = 0.0f;
+	bool shadowCache = true;
+
+	// Build the depth pyramid below its first level in one dispatch where the device allows it, rather
+	// than one dispatch per level
+	bool singlePassHiZ = true;
+
+	// Time the single pass downsampler against blitting a mip chain and against building the depth
+	// pyramid level by level once at startup
+	bool downsampleBenchmark = false;
+
+	// Record the scene's objects as 10k to 100k cpu draws once at startup, in the order submitted against
+	// sorted and merged into instanced draws, printing the binds and recording time of both
+	bool batchBenchmark = false;
+
+	// Draw the scene from multiviewViews cameras around it into multiviewSize squared layers once at startup,
+	// with multiview where the device has it against a render pass and submission per camera, printing the
+	// views per second of both. 0 leaves it out
+	uint32_t multiviewViews = 0;
+	uint32_t multiviewSize = 512;
+
+	// Read shaders and baked textures from the asset pack when it has been written, loose files otherwise. Loose
+	// files changed since the pack was written are read instead of its copies
+	bool assetPack = true;
+
+	// Particles alive at once, emitted and simulated on the gpu and colliding with the depth buffer. 0 disables them
+	uint32_t particleCount = 1 << 20;
+
+	// Passes of the post processing ahead of its tonemap. Without auto exposure the scene is exposed as it is
+	bool bloom = true;
+	bool autoExposure = true;
+
+	// Render the scene into a fraction of the screen between minRenderScale and maxRenderScale, picked from gpu
+	// frame times to stay within targetFrameMs, and scale it up in the tonemap. Needs timestamp queries
+	bool dynamicResolution = true;
+	float targetFrameMs = 16.6f;
+	float minRenderScale = 0.5f;
+	float maxRenderScale = 1.0f;
+
+	// Record and submit frames on a thread of their own, leaving the main thread to the window's events. Off
+	// runs both on the main thread, polling events between frames
+	bool renderThread = true;
+
+	// Render into images of headlessWidth * headlessHeight instead of a window's swap chain, which needs no
+	// display. Stops after frames frames, which headless rendering must set. 0 keeps a window open until closed
+	bool headless = false;
+	uint32_t headlessWidth = 1280;
+	uint32_t headlessHeight = 720;
+	uint32_t frames = 0;
+
+	// Write every frame into captureDirectory, copied out and encoded in the background. Frames are dropped
+	// rather than waited for when the encoding falls behind. Empty captures nothing
+	std::string captureDirectory;
+	CaptureFormat captureFormat = CaptureFormat::Png;
+
+	// Trace the Vulkan calls of the first traceFrames frames into tracePath through the trace layer, for
+	// vulkanReplay to run again without the application. Empty traces nothing
+	std::string tracePath;
+	uint32_t traceFrames = 100;
+
+	// Print gpu timings and culling statistics every statsInterval frames, 0 disables it
+	uint32_t statsInterval = 240;
+
+	// Run the cpu occlusion rasterizer checks and exit without opening a window
+	bool occlusionCheck = false;
+
+	// Bake the textures into textureCompression and exit without opening a window. The renderer
+	// picks baked textures up on its next run
+	bool bakeTextures = false;
+	TextureCompression textureCompression = TextureCompression::BC7;
+
+	// Pack the compiled shaders and baked textures into the asset pack, time loading from it against
+	// loose files and exit without opening a window
+	bool packAssets = false;
+};
+
+namespace settings {
+
+	static const char* cullingModeName(CullingMode mode) {
+		switch (mode) {
+		case CullingMode::None:		return "none";
+		case CullingMode::Frustum:	return "frustum";
+		case CullingMode::HiZ:		return "hiz";
+		case CullingMode::CpuOcclusion:	return "cpu";
+		}
+		return "unknown";
+	}
+
+	// Arguments are of the form --name=value
+	static AppSettings parse(int argc, char** argv) {
+		AppSettings result;
+
+		for (int i = 1; i < argc; i++) {
+			std::string arg = argv[i];
+			size_t split = arg.find('=');
+			std::string name = arg.substr(0, split);
+			std::string value = split == std::string::npos ? "" : arg.substr(split + 1);
+
+			if (name == "--culling") {
+				if (value == "none") {
+					result.cullingMode = CullingMode::None;
+				} else if (value == "frustum") {
+					result.cullingMode = CullingMode::Frustum;
+				} else if (value == "hiz") {
+					result.cullingMode = CullingMode::HiZ;
+				} else if (value == "cpu") {
+					result.cullingMode = CullingMode::CpuOcclusion;
+				} else {
+					throw std::runtime_error("Unknown culling mode: " + value);
+				}
+			} else if (name == "--meshlets") {
+				if (value != "on" && value != "off") {
+					throw std::runtime_error("Expected --meshlets=on|off, got: " + value);
+				}
+				result.meshlets = value == "on";
+			} else if (name == "--lod") {
+				if (value != "on" && value != "off") {
+					throw std::runtime_error("Expected --lod=on|off, got: " + value);
+				}
+				result.lod = value == "on";
+			} else if (name == "--lod-error") {
+				result.lodPixelError = std::strtof(value.c_str(), nullptr);
+				if (!(result.lodPixelError > 0.0f)) {
+					throw std::runtime_error("Expected a positive pixel error, got: " + value);
+				}
+			} else if (name == "--scene") {
+				if (value == "city") {
+					result.scene = SceneType::City;
+				} else if (value == "dense") {
+					result.scene = SceneType::Dense;
+				} else {
+					throw std::runtime_error("Unknown scene: " + value);
+				}
+			} else if (name == "--msaa") {
+				result.msaaSamples = static_cast<uint32_t>(std::strtoul(value.c_str(), nullptr, 10));
+				if (result.msaaSamples == 0 || result.msaaSamples > 64 || (result.msaaSamples & (result.msaaSamples - 1)) != 0) {
+					throw std::runtime_error("Expected a power of two sample count, got: " + value);
+				}
+			} else if (name == "--textures") {
+				if (value != "on" && value != "off") {
+					throw std::runtime_error("Expected --textures=on|off, got: " + value);
+				}
+				result.textures = value == "on";
+			} else if (name == "--texture-size") {
+				result.textureSize = static_cast<uint32_t>(std::strtoul(value.c_str(), nullptr, 10));
+				if (result.textureSize == 0 || result.textureSize > 16384 || (result.textureSize & (result.textureSize - 1)) != 0) {
+					throw std::runtime_error("Expected a power of two texture size, got: " + value);
+				}
+			} else if (name == "--texture-budget") {
+				result.textureBudgetMB = static_cast<uint32_t>(std::strtoul(value.c_str(), nullptr, 10));
+				if (result.textureBudgetMB == 0) {
+					throw std::runtime_error("Expected a texture budget in MB, got: " + value);
+				}
+			} else if (name == "--virtual-texture") {
+				if (value != "on" && value != "off") {
+					throw std::runtime_error("Expected --virtual-texture=on|off, got: " + value);
+				}
+				result.virtualTexture = value == "on";
+			} else if (name == "--virtual-texture-pages") {
+				result.virtualTexturePages = static_cast<uint32_t>(std::strtoul(value.c_str(), nullptr, 10));
+				if (result.virtualTexturePages == 0 || result.virtualTexturePages > 1024 || (result.virtualTexturePages & (result.virtualTexturePages - 1)) != 0) {
+					throw std::runtime_error("Expected a power of two page count up to 1024, got: " + value);
+				}
+			} else if (name == "--virtual-texture-cache") {
+				result.virtualTextureCacheMB = static_cast<uint32_t>(std::strtoul(value.c_str(), nullptr, 10));
+				if (result.virtualTextureCacheMB == 0) {
+					throw std::runtime_error("Expected a virtual texture cache size in MB, got: " + value);
+				}
+			} else if (name == "--lights") {
+				result.lightCount = static_cast<uint32_t>(std::strtoul(value.c_str(), nullptr, 10));
+			} else if (name == "--lighting") {
+				if (value != "clustered" && value != "brute") {
+					throw std::runtime_error("Expected --lighting=clustered|brute, got: " + value);
+				}
+				result.lightBinning = value == "clustered";
+			} else if (name == "--async-compute") {
+				if (value != "on" && value != "off") {
+					throw std::runtime_error("Expected --async-compute=on|off, got: " + value);
+				}
+				result.asyncCompute = value == "on";
+			} else if (name == "--shadow-size") {
+				result.shadowMapSize = static_cast<uint32_t>(std::strtoul(value.c_str(), nullptr, 10));
+				if (result.shadowMapSize < 256 || result.shadowMapSize > 4096 || (result.shadowMapSize & (result.shadowMapSize - 1)) != 0) {
+					throw std::runtime_error("Expected a power of two shadow map size from 256 to 4096, got: " + value);
+				}
+			} else if (name == "--shadow-distance") {
+				result.shadowDistance = std::strtof(value.c_str(), nullptr);
+				if (!(result.shadowDistance >= 0.0f)) {
+					throw std::runtime_error("Expected a shadow distance of 0 or more, got: " + value);
+				}
+			} else if (name == "--shadow-cache") {
+				if (value != "on" && value != "off") {
+					throw std::runtime_error("Expected --shadow-cache=on|off, got: " + value);
+				}
+				result.shadowCache = value == "on";
+			} else if (name == "--hiz-build") {
+				if (value != "single-pass" && value != "chain") {
+					throw std::runtime_error("Expected --hiz-build=single-pass|chain, got: " + value);
+				}
+				result.singlePassHiZ = value == "single-pass";
+			} else if (name == "--downsample-bench") {
+				result.downsampleBenchmark = true;
+			} else if (name == "--batch-bench") {
+				result.batchBenchmark = true;
+			} else if (name == "--multiview") {
+				result.multiviewViews = static_cast<uint32_t>(std::strtoul(value.c_str(), nullptr, 10));
+				if (result.multiviewViews == 0 || result.multiviewViews > 64) {
+					throw std::runtime_error("Expected from 1 to 64 multiview cameras, got: " + value);
+				}
+			} else if (name == "--multiview-size") {
+				result.multiviewSize = static_cast<uint32_t>(std::strtoul(value.c_str(), nullptr, 10));
+				if (result.multiviewSize == 0 || result.multiviewSize > 4096) {
+					throw std::runtime_error("Expected a multiview layer size from 1 to 4096, got: " + value);
+				}
+			} else if (name == "--assets") {
+				if (value != "pack" && value != "loose") {
+					throw std::runtime_error("Expected --assets=pack|loose, got: " + value);
+				}
+				result.assetPack = value == "pack";
+			} else if (name == "--particles") {
+				result.particleCount = static_cast<uint32_t>(std::strtoul(value.c_str(), nullptr, 10));
+			} else if (name == "--bloom") {
+				if (value != "on" && value != "off") {
+					throw std::runtime_error("Expected --bloom=on|off, got: " + value);
+				}
+				result.bloom = value == "on";
+			} else if (name == "--auto-exposure") {
+				if (value != "on" && value != "off") {
+					throw std::runtime_error("Expected --auto-exposure=on|off, got: " + value);
+				}
+				result.autoExposure = value == "on";
+			} else if (name == "--dynamic-resolution") {
+				if (value != "on" && value != "off") {
+					throw std::runtime_error("Expected --dynamic-resolution=on|off, got: " + value);
+				}
+				result.dynamicResolution = value == "on";
+			} else if (name == "--target-ms") {
+				result.targetFrameMs = std::strtof(value.c_str(), nullptr);
+				if (!(result.targetFrameMs > 0.0f)) {
+					throw std::runtime_error("Expected a positive frame time in ms, got: " + value);
+				}
+			} else if (name == "--min-render-scale" || name == "--max-render-scale") {
+				float scale = std::strtof(value.c_str(), nullptr);
+				if (!(scale > 0.0f && scale <= 1.0f)) {
+					throw std::runtime_error("Expected a render scale above 0 and up to 1, got: " + value);
+				}
+				(name == "--min-render-scale" ? result.minRenderScale : result.maxRenderScale) = scale;
+			} else if (name == "--render-thread") {
+				if (value != "on" && value != "off") {
+					throw std::runtime_error("Expected --render-thread=on|off, got: " + value);
+				}
+				result.renderThread = value == "on";
+			} else if (name == "--headless") {
+				result.headless = true;
+				if (!value.empty()) {
+					size_t x = value.find('x');
+					result.headlessWidth = static_cast<uint32_t>(std::strtoul(value.substr(0, x).c_str(), nullptr, 10));
+					result.headlessHeight = x == std::string::npos ? 0 : static_cast<uint32_t>(std::strtoul(value.substr(x + 1).c_str(), nullptr, 10));
+					if (result.headlessWidth == 0 || result.headlessHeight == 0) {
+						throw std::runtime_error("Expected --headless or --headless=<width>x<height>, got: " + value);
+					}
+				}
+			} else if (name == "--frames") {
+				result.frames = static_cast<uint32_t>(std::strtoul(value.c_str(), nullptr, 10));
+			} else if (name == "--capture") {
+				if (value.empty()) {
+					throw std::runtime_error("Expected --capture=<directory>");
+				}
+				result.captureDirectory = value;
+			} else if (name == "--capture-format") {
+				if (value == "png") {
+					result.captureFormat = CaptureFormat::Png;
+				} else if (value == "raw") {
+					result.captureFormat = CaptureFormat::Raw;
+				} else {
+					throw std::runtime_error("Expected --capture-format=png|raw, got: " + value);
+				}
+			} else if (name == "--trace") {
+				if (value.empty()) {
+					throw std::runtime_error("Expected --trace=<file>");
+				}
+				result.tracePath = value;
+			} else if (name == "--trace-frames") {
+				result.traceFrames = static_cast<uint32_t>(std::strtoul(value.c_str(), nullptr, 10));
+				if (result.traceFrames == 0) {
+					throw std::runtime_error("Expected a positive count for --trace-frames, got: " + value);
+				}
+			} else if (name == "--grid") {
+				result.gridSize = static_cast<uint32_t>(std::strtoul(value.c_str(), nullptr, 10));
+			} else if (name == "--stats") {
+				result.statsInterval = static_cast<uint32_t>(std::strtoul(value.c_str(), nullptr, 10));
+			} else if (name == "--occlusion-check") {
+				result.occlusionCheck = true;
+			} else if (name == "--bake-textures") {
+				result.bakeTextures = true;
+			} else if (name == "--pack-assets") {
+				result.packAssets = true;
+			} else if (name == "--texture-compression") {
+				if (value == "bc1") {
+					result.textureCompression = TextureCompression::BC1;
+				} else if (value == "bc3") {
+					result.textureCompression = TextureCompression::BC3;
+				} else if (value == "bc7") {
+					result.textureCompression = TextureCompression::BC7;
+				} else {
+					throw std::runtime_error("Unknown texture compression: " + value);
+				}
+			} else {
+				throw std::runtime_error("Unknown argument: " + arg);
+			}
+		}
+
+		if (result.minRenderScale > result.maxRenderScale) {
+			throw std::runtime_error("The minimum render scale is above the maximum");
+		}
+
+		// Nothing else would ever end a headless run
+		if (result.headless && result.frames == 0) {
+			throw std::runtime_error("Headless rendering needs a frame count, --frames=<count>");
+		}
+
+		return result;
+	}
+
+}
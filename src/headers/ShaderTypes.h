@@ -0,0 +1,268 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+
+// Data layouts shared with our shaders. Uniform blocks follow std140, storage buffers and
+// push constants std430. Keep in sync with src/shaders/scene.glsl and culling.glsl
+
+struct CameraData {
+	glm::mat4 view;
+	glm::mat4 proj;
+	glm::mat4 viewProj;
+	// left, right, bottom, top, near, far. xyz is the normal, w the distance
+	glm::vec4 frustumPlanes[6];
+	glm::vec4 position;
+	// x = near plane, y = far plane, zw unused
+	glm::vec4 projParams;
+};
+
+struct ObjectData {
+	glm::mat4 model;
+	// World space center in xyz and radius in w
+	glm::vec4 boundingSphere;
+	glm::vec4 color;
+	uint32_t meshIndex;
+	// Streamed texture and how often it repeats over the mesh's uvs
+	uint32_t textureIndex;
+	float uvScale;
+	uint32_t pad;
+};
+
+struct MeshData {
+	int32_t vertexOffset;
+	// Range of this mesh's levels of detail in the lod buffer, finest first
+	uint32_t firstLod;
+	uint32_t lodCount;
+	uint32_t pad;
+};
+
+// Every level of detail gets its own draw command, indexed by its position in the lod buffer
+struct LodData {
+	// Absolute range in the scene index buffer
+	uint32_t indexCount;
+	uint32_t firstIndex;
+	// Range of this level's clusters in the meshlet buffer
+	uint32_t firstMeshlet;
+	uint32_t meshletCount;
+	// Where this level's visible object ids start inside one phase of the visible id buffer
+	uint32_t visibleBase;
+	// Largest deviation from the full detail surface, in mesh space
+	float error;
+	uint32_t pad[2];
+};
+
+struct MeshletData {
+	// Mesh space center in xyz and radius in w
+	glm::vec4 boundingSphere;
+	// Cone apex in xyz, w unused
+	glm::vec4 coneApex;
+	// Cone axis in xyz and cutoff in w, a cutoff of 1 disables cone culling
+	glm::vec4 coneAxis;
+	// Absolute range in the scene index buffer
+	uint32_t firstIndex;
+	uint32_t indexCount;
+	uint32_t pad[2];
+};
+
+// Header of the cluster culling work list, one indirect dispatch per phase with a workgroup per visible object.
+// x stops at CLUSTER_DISPATCH_WIDTH and the rest wraps into y, count is the length of the list
+struct ClusterDispatch {
+	uint32_t x;
+	uint32_t y;
+	uint32_t z;
+	uint32_t count;
+};
+
+// See culling.glsl, the workgroup count every device allows in x
+static const uint32_t CLUSTER_DISPATCH_WIDTH = 65535;
+
+// Pushed as visibleBase to tell the vertex shader the instance index is the object id itself
+static const uint32_t CLUSTER_DRAW = 0xFFFFFFFFu;
+
+struct CullPushConstants {
+	uint32_t objectCount;
+	// Draw commands per phase, one per level of detail
+	uint32_t drawCount;
+	// 0 draws objects visible last frame, 1 tests everything else against the depth pyramid
+	uint32_t phase;
+	uint32_t mode;
+	glm::vec2 hiZSize;
+	uint32_t hiZMipCount;
+	// Cluster draw commands available to each phase
+	uint32_t clusterCapacity;
+	// Visible ids available to each phase
+	uint32_t visibleStride;
+	// Turns a level's error over the distance to the camera into a fraction of the allowed error
+	// on screen. 0 always draws full detail
+	float lodScale;
+	// Fraction below the allowed error a coarser level must reach before we switch to it
+	float lodHysteresis;
+	uint32_t pad;
+	// Fraction of the screen the scene is rendered into, from its top left corner
+	glm::vec2 renderScale;
+};
+
+struct HiZPushConstants {
+	glm::ivec2 srcSize;
+	glm::ivec2 dstSize;
+};
+
+struct DownsamplePushConstants {
+	glm::ivec2 srcSize;
+	// Levels written below the source
+	uint32_t levelCount;
+	// Workgroups in the dispatch, the one that finishes last reduces the smallest levels
+	uint32_t groupCount;
+};
+
+// Texture index of objects sampling the virtual texture rather than a streamed one
+static const uint32_t VIRTUAL_TEXTURE_INDEX = 0xFFFFFFFFu;
+
+// Start of a virtual texture feedback buffer, followed by a page id per screen tile
+struct VirtualTextureFeedback {
+	// Screen tiles along each axis
+	glm::uvec2 size;
+	// Pixel within every tile that writes its feedback this frame
+	glm::uvec2 samplePixel;
+};
+
+struct LightData {
+	// World space position in xyz and the distance the light reaches in w
+	glm::vec4 positionRadius;
+	// Linear color times intensity in rgb, w unused
+	glm::vec4 color;
+};
+
+// Per frame parameters of the light clusters, a uniform block
+struct LightGridData {
+	glm::mat4 view;
+	// Clusters along x, y and z, and the number of lights
+	glm::uvec4 gridSize;
+	// Pixels a cluster covers along x and y. The z slice of a view depth d is log2(d) * z + w
+	glm::vec4 sliceParams;
+	// Tangents of half the field of view along x and y, near and far plane
+	glm::vec4 frustumParams;
+	// Light indices the clusters can hold together
+	uint32_t indexCapacity;
+	// Every fragment loops over every light rather than its cluster's, to compare against
+	uint32_t bruteForce;
+	uint32_t pad[2];
+};
+
+// Start of the cluster buffer, followed by the offset and count of every cluster's light indices
+struct LightClusterHeader {
+	uint32_t indexCount;
+	uint32_t maxClusterLights;
+	// Clusters that had lights cut off, for hitting either the per cluster or the total capacity
+	uint32_t overflowClusters;
+	uint32_t pad;
+};
+
+// Cascades of the sun's shadow, laid out two by two in the atlas. Keep in sync with shadows.glsl
+static const uint32_t SHADOW_CASCADES = 4;
+
+// Per frame parameters of the shadow cascades, a uniform block
+struct ShadowData {
+	// World to each cascade's clip space, depth 0 towards the sun
+	glm::mat4 viewProj[SHADOW_CASCADES];
+	// World units a texel of each cascade covers
+	glm::vec4 texelSizes;
+	// Direction towards the sun in xyz, w unused
+	glm::vec4 lightDirection;
+	// Size of a texel of the atlas in uv, and how far from its tile's edge a lookup must stay in tile uv
+	glm::vec4 atlasParams;
+};
+
+struct ShadowPushConstants {
+	uint32_t cascade;
+	// Where in the shadow id buffer the draw finds its objects
+	uint32_t idBase;
+};
+
+// Bins of the luminance histogram auto exposure is worked out from. Keep in sync with post.glsl
+static const uint32_t LUMINANCE_BINS = 256;
+
+// Exposure carried from frame to frame, followed by the histogram of the frame being exposed
+struct ExposureState {
+	// Adapted average luminance of the screen and the exposure scale that brings it to middle grey
+	float averageLuminance;
+	float exposure;
+	uint32_t pad[2];
+	uint32_t histogram[LUMINANCE_BINS];
+};
+
+struct PostPushConstants {
+	// Log2 luminance of the first counted bin, the log2 range the bins cover, how far the exposure
+	// adapts to this frame's and the exposure compensation in stops
+	glm::vec4 exposureParams;
+	// Bloom threshold, soft knee, intensity and upsampling filter radius in texels of the source
+	glm::vec4 bloomParams;
+	// Saturation, contrast, and whether the output is sRGB encoded by the shader rather than its format
+	glm::vec4 gradeParams;
+	// White balance the graded color is multiplied with, w unused
+	glm::vec4 tint;
+	// Source size in xy, destination size in zw
+	glm::uvec4 sizes;
+	// Bloom step: prefilter the HDR target into the first level, downsample a level, or upsample one into the level above
+	uint32_t mode;
+	uint32_t pad;
+	// Fraction of the HDR target the scene was rendered into, from its top left corner
+	glm::vec2 renderScale;
+};
+
+// Counters of the particle lists, followed by the indirect arguments the particle passes write from them.
+// Keep in sync with particles.glsl
+struct ParticleCounters {
+	// Free particles left on the dead list, signed so emission can overshoot and give back what it took
+	int32_t deadCount;
+	// Particles on each of the two alive lists, one filled by the frame the other was filled by the last
+	uint32_t aliveCount[2];
+	// Particles emitted this frame
+	uint32_t emitted;
+	// Simulation dispatch over last frame's alive list, xyz and a pad
+	uint32_t simulateArgs[4];
+	// VkDrawIndirectCommand of one quad instanced over this frame's alive list
+	uint32_t drawArgs[4];
+};
+
+// Per frame parameters of the particle passes, a uniform block
+struct ParticleFrameData {
+	glm::mat4 viewProj;
+	glm::mat4 invViewProj;
+	// Camera axes the quads are spanned by, the quad's half size in the right axis' w
+	glm::vec4 cameraRight;
+	glm::vec4 cameraUp;
+	// Center of the emitter disc in xyz and its radius in w
+	glm::vec4 emitter;
+	// Lifetime in seconds, upward launch speed, how much it varies and the most sideways speed
+	glm::vec4 emitParams;
+	// Seconds since the last frame, gravity, how much speed a collision keeps and how far behind the depth
+	// buffer a particle still collides with it
+	glm::vec4 simParams;
+	// Depth buffer size, near and far plane
+	glm::vec4 depthParams;
+	// Particles to emit, capacity, which alive list this frame fills, and a seed
+	glm::uvec4 counts;
+};
+
+struct ParticlePushConstants {
+	// Reset the lists, prepare the simulation or prepare the draw, see particle_args.comp
+	uint32_t mode;
+};
+
+// Cameras the multiview renderer can draw the scene from in one run. Keep in sync with multiview.vert
+static const uint32_t MAX_MULTIVIEW_VIEWS = 64;
+
+// Cameras of the multiview renderer, a uniform block
+struct MultiviewData {
+	glm::mat4 viewProj[MAX_MULTIVIEW_VIEWS];
+	// Direction towards the sun in xyz, w unused
+	glm::vec4 lightDirection;
+};
+
+struct MultiviewPushConstants {
+	// Camera of the render pass's first layer, multiview passes add gl_ViewIndex to it
+	uint32_t viewOffset;
+};
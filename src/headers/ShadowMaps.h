@@ -0,0 +1,162 @@
+#pragma once
+
+#include "AssetPack.h"
+#include "ShaderTypes.h"
+#include "VulkanUtil.h"
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <vector>
+
+// Cascaded shadow maps for the sun. The view frustum is split into cascades, each fitted with the bounding sphere of
+// its slice so its size never changes as the camera turns, and moved in whole texels so its edges do not shimmer.
+// Every cascade is a tile of one depth atlas the scene samples. The far cascades cover the most and move the least:
+// their static casters are drawn into a cache of their own, only again when the cascade moves a coarse step, the sun
+// turns or the static geometry changes, and copied into the atlas every frame under the dynamic casters
+class ShadowMaps {
+public:
+	static const uint32_t CASCADE_COUNT = SHADOW_CASCADES;
+	// Cascades from this one on keep their static casters cached
+	static const uint32_t FIRST_CACHED_CASCADE = 2;
+	static const uint32_t CACHED_CASCADES = CASCADE_COUNT - FIRST_CACHED_CASCADE;
+	static const VkFormat FORMAT = VK_FORMAT_D16_UNORM;
+
+	// How an object casts
+	enum class Caster : uint8_t {
+		None,
+		Static,
+		Dynamic
+	};
+
+	struct Config {
+		// Texels along a side of one cascade, the atlas is two cascades a side
+		uint32_t cascadeSize = 1024;
+		// Cascade splits between even (0) and logarithmic (1) spacing
+		float splitLambda = 0.8f;
+		// How far from the camera the last cascade ends, 0 at the camera's far plane. Fixed so the cascades
+		// keep their size, and with it their texel grid, while the camera moves
+		float distance = 0.0f;
+		// Towards the sun
+		glm::vec3 lightDirection = glm::vec3(0.4f, 1.0f, 0.3f);
+		bool caching = true;
+		uint32_t framesInFlight = 2;
+	};
+
+	struct Stats {
+		// Instances the last update drew into the atlas, and static ones it took from the cache instead
+		uint32_t drawnInstances = 0;
+		uint32_t cachedInstances = 0;
+		// Cached cascades drawn again since the last resetCounters
+		uint32_t cacheRedraws = 0;
+	};
+
+	ShadowMaps(VkDevice device, VkPhysicalDevice physicalDevice, const AssetLoader& assets, VkDescriptorSetLayout frameSetLayout, const Config& config);
+	ShadowMaps(const ShadowMaps&) = delete;
+	ShadowMaps& operator=(const ShadowMaps&) = delete;
+
+	// What casts shadows, per object, and the buffers their meshes are drawn from. Invalidates the cache
+	void setCasters(const std::vector<ObjectData>& objects, const std::vector<Caster>& casters, const std::vector<MeshData>& meshes,
+		const std::vector<LodData>& lods, VkBuffer vertexBuffer, VkBuffer indexBuffer);
+
+	// Both invalidate the cache. Must not be called between update and recording the frame
+	void setLightDirection(const glm::vec3& direction);
+	void setCaching(bool enabled);
+	bool isCaching() const { return config.caching; }
+
+	// Call once the frame's previous submission is done. Fits the cascades to the camera and picks what each draws
+	void update(uint32_t frame, const CameraData& camera);
+
+	// While caching, draw the cached cascades update found stale into the cache, then copy every cached cascade
+	// into the atlas, which must be in the transfer destination layout
+	void recordCache(VkCommandBuffer commandBuffer, uint32_t frame, VkDescriptorSet frameSet);
+	// Draw the cascades inside a render pass on the atlas. It clears the atlas unless caching, when the cascades
+	// not cached are cleared here and the cached ones only get their dynamic casters
+	void recordCascades(VkCommandBuffer commandBuffer, uint32_t frame, VkDescriptorSet frameSet);
+
+	void destroy();
+
+	// Cascades, atlas and shadow ids, set 2 of the scene shaders
+	VkDescriptorSetLayout getSetLayout() const { return setLayout; }
+	VkDescriptorSet getDescriptorSet(uint32_t frame) const { return descriptorSets[frame]; }
+
+	// Left in the read only depth layout by the graph
+	const vkutil::Image& getAtlas() const { return atlas; }
+	uint32_t getCascadeSize() const { return config.cascadeSize; }
+	VkDeviceSize getAtlasBytes() const;
+	VkDeviceSize getCacheBytes() const;
+
+	const Stats& getStats() const { return stats; }
+	void resetCounters() { stats.cacheRedraws = 0; }
+
+private:
+	// Instances of one level of detail drawn into one cascade
+	struct Draw {
+		uint32_t cascade;
+		uint32_t lod;
+		uint32_t idBase;
+		uint32_t count;
+	};
+
+	// Where a cached cascade was drawn from, it is drawn again once this changes. Version 0 was never drawn
+	struct CacheKey {
+		glm::vec3 window = glm::vec3(0.0f);
+		uint64_t version = 0;
+	};
+
+	void invalidateCache();
+
+	// Append a draw per non empty bucket, emptying them
+	void flushBuckets(uint32_t cascade, std::vector<std::vector<uint32_t>>& buckets, std::vector<Draw>& result, uint32_t* ids, uint32_t& idCount);
+
+	void bindPipeline(VkCommandBuffer commandBuffer, uint32_t frame, VkDescriptorSet frameSet);
+	void recordDraws(VkCommandBuffer commandBuffer, const std::vector<Draw>& list, uint32_t cascade);
+	void setTile(VkCommandBuffer commandBuffer, VkOffset2D offset);
+
+	VkDevice device;
+	VkPhysicalDevice physicalDevice;
+	Config config;
+
+	vkutil::Image atlas;
+	vkutil::Image cache;
+	VkSampler sampler = VK_NULL_HANDLE;
+	// Draws into the cache, keeping what it already holds. Also what the pipeline is created against
+	VkRenderPass cacheRenderPass = VK_NULL_HANDLE;
+	VkFramebuffer cacheFramebuffer = VK_NULL_HANDLE;
+	bool cacheInitialized = false;
+
+	// Per frame in flight, host visible
+	std::vector<vkutil::Buffer> shadowBuffers;
+	std::vector<vkutil::Buffer> idBuffers;
+	uint32_t idCapacity = 0;
+
+	VkDescriptorSetLayout setLayout = VK_NULL_HANDLE;
+	VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
+	std::vector<VkDescriptorSet> descriptorSets;
+	VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+	VkPipeline pipeline = VK_NULL_HANDLE;
+
+	// Casters as set, with the bounding sphere and levels of detail of every object
+	std::vector<Caster> casters;
+	std::vector<glm::vec4> spheres;
+	std::vector<uint32_t> firstLods;
+	std::vector<uint32_t> lodCounts;
+	std::vector<LodData> lodData;
+	std::vector<int32_t> lodVertexOffsets;
+	VkBuffer vertexBuffer = VK_NULL_HANDLE;
+	VkBuffer indexBuffer = VK_NULL_HANDLE;
+	// Bounding sphere of every caster together, which every cascade's depth range covers
+	glm::vec4 sceneSphere = glm::vec4(0.0f);
+
+	uint64_t staticVersion = 1;
+	CacheKey cacheKeys[CACHED_CASCADES];
+	bool staleCascades[CACHED_CASCADES] = {};
+
+	// Picked by the last update. Cache draws only hold static casters of stale cached cascades
+	std::vector<Draw> draws;
+	std::vector<Draw> cacheDraws;
+	std::vector<std::vector<uint32_t>> buckets;
+	std::vector<std::vector<uint32_t>> cacheBuckets;
+
+	Stats stats;
+};
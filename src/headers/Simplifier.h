@@ -0,0 +1,27 @@
+#pragma once
+
+#include "Vertex.h"
+
+#include <cstdint>
+#include <vector>
+
+struct Mesh;
+
+// Quadric error metric mesh simplification, used to build the LOD chains of our meshes
+namespace simplifier {
+
+	// Levels including the full detail mesh
+	const uint32_t MAX_LODS = 6;
+
+	// Collapse edges until at most targetIndexCount indices are left or the next collapse would
+	// move the surface by more than targetError. Vertices are never moved or created, so the result
+	// indexes the same vertex buffer. Attribute seams and open borders are kept intact.
+	// resultError receives the largest surface deviation introduced, in mesh space units
+	std::vector<uint32_t> simplify(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices,
+		size_t targetIndexCount, float targetError, float* resultError);
+
+	// Append successively halved levels of detail to the mesh's index list and describe them in
+	// mesh.lods. Stops early once a level no longer reduces the triangle count meaningfully
+	void generateLods(Mesh& mesh, uint32_t maxLods = MAX_LODS);
+
+}
@@ -0,0 +1,134 @@
+#pragma once
+
+#include "AssetPack.h"
+#include "ThreadPool.h"
+#include "VulkanUtil.h"
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <functional>
+#include <iosfwd>
+#include <string>
+#include <vector>
+
+// Benchmarks of synthetic scenes on a device of their own, with no window or display, so they run as well on a
+// software implementation such as lavapipe or SwiftShader (picked with VK_ICD_FILENAMES) as on a gpu. Each scene
+// stresses one thing the renderer does: many triangles in one draw, many draws, many pipelines, the swap chain
+// being recreated every frame and large uploads. A frame is recorded, submitted and waited for before the next,
+// so the frame times of a scene do not depend on how deep the driver queues. Results come out as CSV, which is
+// also what baselines are stored as and checked against
+class SyntheticBench {
+public:
+	struct Config {
+		VkExtent2D extent = { 1280, 720 };
+		// Frames timed per scene, after warmupFrames that are not
+		uint32_t frames = 200;
+		uint32_t warmupFrames = 10;
+		// Scenes to run by name, every scene when empty
+		std::vector<std::string> scenes;
+		// Parameters of the scenes
+		uint32_t triangles = 250000;
+		uint32_t draws = 10000;
+		uint32_t pipelines = 256;
+		// Sizes the resize scene cycles the target through, from a quarter of extent up to all of it
+		uint32_t resizeSteps = 8;
+		uint32_t uploadMB = 16;
+		// First device whose name contains this, the first device when empty
+		std::string deviceName;
+	};
+
+	// Timings of a scene, in ms, and what they were taken with. setupMs is what creating the scene took, its
+	// pipelines for example
+	struct Result {
+		std::string scene;
+		uint32_t parameter = 0;
+		VkExtent2D extent = { 0, 0 };
+		uint32_t frames = 0;
+		uint32_t warmupFrames = 0;
+		double setupMs = 0.0;
+		double meanMs = 0.0;
+		double p50Ms = 0.0;
+		double p95Ms = 0.0;
+		double maxMs = 0.0;
+		// Mean of the gpu timestamps around the frame's commands, negative without timestamps
+		double gpuMs = -1.0;
+	};
+
+	explicit SyntheticBench(const Config& config);
+	~SyntheticBench();
+	SyntheticBench(const SyntheticBench&) = delete;
+	SyntheticBench& operator=(const SyntheticBench&) = delete;
+
+	// Every scene the config asks for, in a fixed order
+	std::vector<Result> run();
+
+	const std::string& getDeviceName() const { return deviceName; }
+
+	// One line per result after a header line, the format baselines are stored in
+	static void writeCsv(std::ostream& out, const std::vector<Result>& results);
+	// Empty if the file cannot be opened. Throws on results written in another format
+	static std::vector<Result> readCsv(const std::string& path);
+
+	// Compare results against a baseline of the same scenes and parameters, printing every scene to log. A scene
+	// regresses when its median frame or its setup is slower than the baseline's by more than tolerance, a
+	// fraction. Scenes missing from the baseline are reported but never fail. Throws if a scene was measured at
+	// another extent or over other frame counts than its baseline, whose timings say nothing about these
+	static bool checkRegressions(const std::vector<Result>& results, const std::vector<Result>& baseline, double tolerance,
+		std::ostream& log);
+
+private:
+	struct Scene {
+		std::string name;
+		uint32_t parameter = 0;
+		// Creates what the scene needs, timed as its setup
+		std::function<void()> setup;
+		// Host side work ahead of recording a frame, timed with the frame
+		std::function<void(uint32_t frame)> prepare;
+		// Record a frame into a command buffer that has begun
+		std::function<void(VkCommandBuffer, uint32_t frame)> record;
+		std::function<void()> teardown;
+	};
+
+	void createDevice();
+	// The color target, its render pass and framebuffer, and the pipeline drawing into it, all for extent
+	void createTarget(VkExtent2D extent);
+	void destroyTarget();
+	VkPipeline createPipeline(VkExtent2D extent, float tint) const;
+
+	void beginRenderPass(VkCommandBuffer commands) const;
+	void pushDraw(VkCommandBuffer commands, float x, float y, float scale, uint32_t colorSeed) const;
+
+	std::vector<Scene> scenes();
+	Result runScene(const Scene& scene);
+
+	Config config;
+
+	VkInstance instance = VK_NULL_HANDLE;
+	VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;
+	VkDevice device = VK_NULL_HANDLE;
+	VkQueue queue = VK_NULL_HANDLE;
+	uint32_t queueFamily = 0;
+	std::string deviceName;
+
+	VkCommandPool commandPool = VK_NULL_HANDLE;
+	VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+	VkFence fence = VK_NULL_HANDLE;
+	VkQueryPool queryPool = VK_NULL_HANDLE;
+	float timestampPeriod = 1.0f;
+
+	ThreadPool threadPool;
+	AssetLoader assets;
+	VkShaderModule vertShaderModule = VK_NULL_HANDLE;
+	VkShaderModule fragShaderModule = VK_NULL_HANDLE;
+	VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+
+	VkExtent2D targetExtent = { 0, 0 };
+	vkutil::Image target;
+	VkRenderPass renderPass = VK_NULL_HANDLE;
+	VkFramebuffer framebuffer = VK_NULL_HANDLE;
+	VkPipeline pipeline = VK_NULL_HANDLE;
+
+	// A triangle around the origin, drawn moved and scaled by every scene but the triangle one
+	vkutil::Buffer triangleBuffer;
+};
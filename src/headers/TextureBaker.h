@@ -0,0 +1,18 @@
+#pragma once
+
+#include "Configuration.h"
+#include "Settings.h"
+
+// Offline step turning the streamed textures into files the renderer uploads as they are. Every mip
+// is built on the cpu, the color is compressed into the format the settings ask for and a normal map
+// derived from its relief into BC5. Reports encoding speed, what the compression lost and the memory it saves
+class TextureBaker {
+public:
+	// Where textures are baked to, and where the renderer looks for them relative to its asset root
+	static constexpr const char* OUTPUT_DIRECTORY = VK_ROOT_DIR "assets/textures/";
+	static constexpr const char* ASSET_DIRECTORY = "assets/textures/";
+
+	// Check every encoder implementation the cpu supports against the scalar one, then bake with the fastest.
+	// False if an implementation disagrees with the reference
+	static bool run(const AppSettings& settings);
+};
@@ -0,0 +1,199 @@
+#pragma once
+
+#include "BakedTexture.h"
+#include "ThreadPool.h"
+#include "VulkanUtil.h"
+
+#include <vulkan/vulkan.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <future>
+#include <string>
+#include <vector>
+
+// A set of textures too large to keep resident at full resolution. Each texture only holds the mips
+// from its finest resident level down, the coarse tail always being there. Finer levels are decoded on
+// worker threads of the streamer's own when the screen demands them, so the culling workers never queue behind
+// a decode, uploaded through a staging ring and the rest of the
+// chain is blitted down from them on the gpu. Textures baked offline are read from disk instead, every
+// level of the chain already compressed, and copied as is. Levels nothing needs any more are dropped by copying
+// the coarser ones into a smaller image. Demand is biased towards coarser mips until it fits the
+// memory budget, and the budget itself shrinks to what VK_EXT_memory_budget reports is left
+class TextureStreamer {
+public:
+	// Every texture is square. Generated ones are RGBA8 in sRGB, baked ones are in whatever format they were baked in
+	static const VkFormat GENERATED_FORMAT = VK_FORMAT_R8G8B8A8_SRGB;
+	// Levels this size and smaller are loaded once and never streamed out
+	static const uint32_t TAIL_SIZE = 64;
+	// Frames a level must go unused before it is dropped while the budget is not exceeded
+	static const uint32_t EVICT_DELAY = 120;
+
+	struct Config {
+		uint32_t textureCount = 16;
+		uint32_t textureSize = 2048;
+		VkDeviceSize budget = 128ull * 1024 * 1024;
+		uint32_t framesInFlight = 2;
+		// Textures baked into this directory of the assets are used when all of them are there and the device
+		// samples their format. Without assets or a directory they are always generated
+		const AssetLoader* assets = nullptr;
+		std::string bakedDirectory;
+		// textureCompressionBC is enabled, without it no block compressed format may be sampled
+		bool blockCompression = false;
+		// Set when VK_EXT_memory_budget is enabled, the budget is then clamped to what the heap has left
+		PFN_vkGetPhysicalDeviceMemoryProperties2KHR getMemoryProperties2 = nullptr;
+		uint32_t decodeThreads = 2;
+	};
+
+	struct Stats {
+		// Memory held by the texture images, and what the unbiased demand would need
+		VkDeviceSize residentBytes = 0;
+		VkDeviceSize requestedBytes = 0;
+		// Configured budget after clamping it to the heap budget
+		VkDeviceSize budget = 0;
+		// Levels every request was made coarser by to fit the budget
+		uint32_t mipBias = 0;
+		uint32_t pendingDecodes = 0;
+		// Since the last resetLatency, from requesting a level to the frame first sampling it
+		uint32_t streamedIn = 0;
+		uint32_t streamedOut = 0;
+		VkDeviceSize uploadedBytes = 0;
+		double latencyMsTotal = 0.0;
+		double latencyMsMax = 0.0;
+	};
+
+	TextureStreamer(VkDevice device, VkPhysicalDevice physicalDevice, const Config& config);
+	TextureStreamer(const TextureStreamer&) = delete;
+	TextureStreamer& operator=(const TextureStreamer&) = delete;
+
+	// The generated format must be sampled with linear filtering and blitted to generate mips, it is the
+	// fallback whenever the baked textures cannot be used
+	static bool isSupported(VkPhysicalDevice physicalDevice);
+
+	// Contents of one RGBA8 level of a texture. Stands in for decoding it from disk when nothing is baked,
+	// and is what the baker compresses
+	static std::vector<uint8_t> generateLevel(uint32_t texture, uint32_t size);
+
+	// File or asset a texture is baked to
+	static std::string bakedPath(const std::string& directory, uint32_t texture);
+
+	// Decode and upload the tail of every texture, waiting for the queue to finish
+	void loadTails(VkCommandPool commandPool, VkQueue queue);
+
+	// Call once the frame's previous submission is done. requestedMips holds the finest level each texture
+	// is seen at, or a level past the tail when it is not seen at all. New images are created here so the
+	// descriptors can be updated before recording, their contents are written by recordUploads
+	void update(uint32_t frame, const std::vector<uint32_t>& requestedMips);
+
+	// Record the uploads, mip generation and copies of the images update swapped in, leaving them ready
+	// for sampling in fragment shaders
+	void recordUploads(VkCommandBuffer commandBuffer);
+
+	void destroy();
+
+	uint32_t getTextureCount() const { return static_cast<uint32_t>(textures.size()); }
+	uint32_t getMipCount() const { return mipCount; }
+	uint32_t getTextureSize() const { return textureSize; }
+	VkFormat getFormat() const { return format; }
+	bool isBaked() const { return !bakedTextures.empty(); }
+	// Why the baked textures are not used, empty when they are or none were asked for
+	const std::string& getBakedFallbackReason() const { return bakedFallbackReason; }
+	VkImageView getView(uint32_t texture) const { return textures[texture].image.view; }
+	VkSampler getSampler() const { return sampler; }
+
+	// Changes whenever a view does, descriptors pointing at an older version must be rewritten
+	uint64_t getVersion() const { return version; }
+
+	const Stats& getStats() const { return stats; }
+	void resetLatency();
+
+private:
+	using Clock = std::chrono::high_resolution_clock;
+
+	struct Texture {
+		// Holds levels residentMip to the last one
+		vkutil::Image image;
+		VkDeviceSize memorySize = 0;
+		uint32_t residentMip = 0;
+		uint32_t wantedMip = 0;
+		// Last frame the finest resident level was wanted
+		uint64_t lastNeeded = 0;
+
+		// Level being decoded, if any
+		bool decoding = false;
+		uint32_t decodingMip = 0;
+		std::future<std::vector<uint8_t>> decoded;
+		Clock::time_point requested;
+	};
+
+	// Work recordUploads has to do for a new image
+	struct PendingUpload {
+		VkImage image;
+		uint32_t mipLevels;
+		uint32_t size;
+		// Either the first stagedLevels come from the staging ring one after another and the rest are
+		// blitted down from the last of them, or every level is copied from the image being replaced
+		bool fromStaging;
+		uint32_t stagedLevels;
+		VkDeviceSize stagingOffset;
+		VkImage source;
+		uint32_t sourceMipOffset;
+	};
+
+	struct RetiredImage {
+		vkutil::Image image;
+		uint64_t frame;
+	};
+
+	// Open the baked textures if every one of them can be used, otherwise leave the reason in bakedFallbackReason
+	void openBakedTextures();
+
+	VkDeviceSize levelBytes(uint32_t mip) const { return BakedTexture::levelBytes(format, levelSize(mip), levelSize(mip)); }
+	// Texel bytes of every level from mip down
+	VkDeviceSize chainBytes(uint32_t mip) const;
+	// Staging ring space streaming in mip takes
+	VkDeviceSize uploadBytes(uint32_t mip) const { return isBaked() ? chainBytes(mip) : levelBytes(mip); }
+	uint32_t levelSize(uint32_t mip) const { return std::max(textureSize >> mip, 1u); }
+
+	// Replace a texture's image by one starting at mip. Its contents come from the staging ring at
+	// stagingOffset, or from the current image when streaming out
+	void swapImage(uint32_t texture, uint32_t mip, bool fromStaging, VkDeviceSize stagingOffset);
+
+	// Space in the staging ring for this frame's uploads, released once the frame's fence has been waited on
+	bool allocateStaging(VkDeviceSize size, VkDeviceSize& offset);
+
+	// Clamp the configured budget to what the heap our textures live in has left
+	void updateBudget();
+
+	VkDevice device;
+	VkPhysicalDevice physicalDevice;
+	Config config;
+
+	uint32_t textureSize = 0;
+	uint32_t mipCount = 0;
+	uint32_t tailMip = 0;
+	VkFormat format = GENERATED_FORMAT;
+	std::vector<Texture> textures;
+	// One per texture when they are baked, empty when they are generated
+	std::vector<BakedTexture> bakedTextures;
+	std::string bakedFallbackReason;
+	VkSampler sampler = VK_NULL_HANDLE;
+	uint32_t memoryHeap = 0;
+
+	vkutil::Buffer staging;
+	VkDeviceSize stagingHead = 0;
+	VkDeviceSize stagingUsed = 0;
+	std::vector<VkDeviceSize> stagingFrameBytes;
+	uint32_t currentFrame = 0;
+
+	std::vector<PendingUpload> pendingUploads;
+	std::vector<RetiredImage> retiredImages;
+
+	uint64_t frameNumber = 0;
+	uint64_t version = 0;
+	Stats stats;
+
+	// Last, so the decodes still running finish before anything they might touch goes away
+	ThreadPool decodeWorkers;
+};
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+// Fixed set of worker threads for cpu side work (culling, decoding, encoding)
+class ThreadPool {
+public:
+	// 0 threads uses one less than the hardware concurrency, leaving a core for the render loop
+	explicit ThreadPool(uint32_t threadCount = 0);
+	~ThreadPool();
+
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool& operator=(const ThreadPool&) = delete;
+
+	// Queue a task for the workers
+	template<typename F>
+	auto submit(F&& task) -> std::future<decltype(task())> {
+		using Result = decltype(task());
+
+		auto packaged = std::make_shared<std::packaged_task<Result()>>(std::forward<F>(task));
+		std::future<Result> result = packaged->get_future();
+		{
+			std::lock_guard<std::mutex> lock(queueMutex);
+			tasks.push([packaged]() { (*packaged)(); });
+		}
+		condition.notify_one();
+
+		return result;
+	}
+
+	// Split [0, count) into chunks of at most grain elements and run them across the workers and
+	// the calling thread. Returns once every chunk is done
+	void parallelFor(uint32_t count, uint32_t grain, const std::function<void(uint32_t begin, uint32_t end)>& body);
+
+	uint32_t getThreadCount() const { return static_cast<uint32_t>(workers.size()); }
+
+private:
+	void workerLoop();
+
+	std::vector<std::thread> workers;
+	std::queue<std::function<void()>> tasks;
+	std::mutex queueMutex;
+	std::condition_variable condition;
+	bool stopping = false;
+};
@@ -0,0 +1,763 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+// Binary traces of the Vulkan calls an application makes, written by the trace layer and re-executed by
+// vulkanReplay. A trace is a magic followed by LZ4 blocks, each the size it expands to and its compressed size
+// ahead of the bytes. The calls in them are an id followed by the call's arguments, in the order the Writer and
+// the Reader transfer them. Both go through the same transfer functions below, so what is written and what is
+// read back cannot drift apart. Objects are named by the handles the application saw, which the replay maps
+// onto the objects it creates in their place
+namespace trace {
+
+	// Handles double as object ids, which needs dispatchable and non dispatchable handles of the same size
+	static_assert(sizeof(void*) == sizeof(uint64_t), "Traces are only written and read by 64 bit builds");
+
+	constexpr char MAGIC[8] = { 'V', 'K', 'T', 'R', 'A', 'C', 'E', '2' };
+
+	enum class Call : uint16_t {
+		// Last call of a complete trace, a trace cut short just runs out of blocks
+		End,
+		CreateInstance,
+		CreateDevice,
+		GetDeviceQueue,
+		DeviceWaitIdle,
+		QueueWaitIdle,
+		AllocateMemory,
+		// Bytes the host wrote to mapped memory since it was last looked at
+		WriteMemory,
+		BindBufferMemory,
+		BindImageMemory,
+		CreateBuffer,
+		CreateImage,
+		CreateImageView,
+		CreateSampler,
+		CreateShaderModule,
+		CreatePipelineLayout,
+		CreateDescriptorSetLayout,
+		CreateDescriptorPool,
+		CreateRenderPass,
+		CreateFramebuffer,
+		CreateQueryPool,
+		CreateFence,
+		CreateSemaphore,
+		CreateCommandPool,
+		CreateGraphicsPipelines,
+		CreateComputePipelines,
+		CreateSwapchain,
+		GetSwapchainImages,
+		// Any object going away, which is named by an Object
+		Destroy,
+		AllocateDescriptorSets,
+		FreeDescriptorSets,
+		UpdateDescriptorSets,
+		AllocateCommandBuffers,
+		FreeCommandBuffers,
+		ResetCommandBuffer,
+		BeginCommandBuffer,
+		EndCommandBuffer,
+		CmdBindPipeline,
+		CmdBindDescriptorSets,
+		CmdBindVertexBuffers,
+		CmdBindIndexBuffer,
+		CmdPushConstants,
+		CmdSetViewport,
+		CmdSetScissor,
+		CmdBeginRenderPass,
+		CmdEndRenderPass,
+		CmdDraw,
+		CmdDrawIndexed,
+		CmdDrawIndirect,
+		CmdDrawIndexedIndirect,
+		CmdDrawIndexedIndirectCount,
+		CmdDispatch,
+		CmdDispatchIndirect,
+		CmdPipelineBarrier,
+		CmdCopyBuffer,
+		CmdCopyImage,
+		CmdBlitImage,
+		CmdCopyBufferToImage,
+		CmdCopyImageToBuffer,
+		CmdFillBuffer,
+		CmdUpdateBuffer,
+		CmdClearColorImage,
+		CmdClearAttachments,
+		CmdResetQueryPool,
+		CmdWriteTimestamp,
+		QueueSubmit,
+		// Only waits that saw their fences signal, polling a fence that had signaled is one too
+		WaitForFences,
+		ResetFences,
+		AcquireNextImage,
+		QueuePresent,
+		// Time since the trace started, in ns, once a frame is presented or, without a swap chain, submitted
+		FrameEnd,
+	};
+
+	enum class Object : uint8_t {
+		Memory,
+		Buffer,
+		Image,
+		ImageView,
+		Sampler,
+		ShaderModule,
+		PipelineLayout,
+		DescriptorSetLayout,
+		DescriptorPool,
+		RenderPass,
+		Framebuffer,
+		QueryPool,
+		Fence,
+		Semaphore,
+		CommandPool,
+		Pipeline,
+		Swapchain,
+	};
+
+	// Separates the structures chained through a pNext from what follows them
+	constexpr VkStructureType CHAIN_END = VK_STRUCTURE_TYPE_APPLICATION_INFO;
+
+	class Writer {
+	public:
+		static constexpr bool reading = false;
+
+		// Throws if the file cannot be created
+		explicit Writer(const std::string& path);
+		~Writer();
+		Writer(const Writer&) = delete;
+		Writer& operator=(const Writer&) = delete;
+
+		// Starts the next call, after which its arguments are transferred
+		void call(Call id);
+
+		void bytes(const void* data, size_t size);
+
+		template <typename T>
+		void value(const T& data) { bytes(&data, sizeof(T)); }
+
+		template <typename T>
+		void handle(T object) { value(reinterpret_cast<uint64_t>(object)); }
+
+		// Handles inside a structure already transferred as bytes are written as they are
+		template <typename T>
+		void remap(T) {}
+
+		// Every argument, in order
+		template <typename... Args>
+		void fields(Args&... args);
+
+		// count elements, count itself is transferred separately
+		template <typename T>
+		void array(const T* data, uint32_t count);
+
+		// An array that may be null even with a count
+		template <typename T>
+		void optional(const T* data, uint32_t count);
+
+		// size bytes, size itself is transferred separately
+		template <typename T>
+		void data(const T* data, size_t size) { bytes(data, size); }
+
+		void string(const char* text);
+		void strings(const char* const* texts, uint32_t count);
+
+		// Known structures chained through next. Others are left out and counted in getSkippedStructures
+		template <typename Next>
+		void chain(Next* next);
+
+		// Writes the end of the trace and its last block
+		void close();
+
+		uint64_t getBytes() const { return bytesWritten; }
+		uint64_t getCompressedBytes() const { return compressedBytes; }
+		uint64_t getSkippedStructures() const { return skippedStructures; }
+
+	private:
+		void flushBlock();
+
+		std::ofstream file;
+		std::vector<uint8_t> block;
+		std::vector<uint8_t> compressed;
+		uint64_t bytesWritten = 0;
+		uint64_t compressedBytes = 0;
+		uint64_t skippedStructures = 0;
+	};
+
+	class Reader {
+	public:
+		static constexpr bool reading = true;
+
+		// Throws if the file cannot be opened or is not a trace
+		explicit Reader(const std::string& path);
+		Reader(const Reader&) = delete;
+		Reader& operator=(const Reader&) = delete;
+
+		// Starts the next call, false once the trace ends. Frees what the previous call's arguments were read into
+		bool next(Call& id);
+		// Whether the trace ended with Call::End, rather than running out where the application stopped
+		bool isComplete() const { return complete; }
+
+		void bytes(void* data, size_t size);
+		// size bytes out of the block itself, valid until the next call
+		const uint8_t* take(size_t size);
+
+		template <typename T>
+		void value(T& data) { bytes(&data, sizeof(T)); }
+
+		// The replay's object for a handle the trace names, null for null
+		template <typename T>
+		void handle(T& object) {
+			uint64_t id = 0;
+			value(id);
+			object = reinterpret_cast<T>(lookup(id));
+		}
+
+		// Maps a handle read as bytes inside a structure onto the replay's object
+		template <typename T>
+		void remap(T& object) { object = reinterpret_cast<T>(lookup(reinterpret_cast<uint64_t>(object))); }
+
+		// A handle the traced call created, to be bound to the replay's object
+		uint64_t id() {
+			uint64_t created = 0;
+			value(created);
+			return created;
+		}
+		template <typename T>
+		void bind(uint64_t traced, T object) { objects[traced] = reinterpret_cast<uint64_t>(object); }
+		void unbind(uint64_t traced) { objects.erase(traced); }
+		bool isBound(uint64_t traced) const { return objects.count(traced) != 0; }
+
+		template <typename... Args>
+		void fields(Args&... args);
+
+		template <typename T>
+		void array(const T*& data, uint32_t count);
+
+		template <typename T>
+		void optional(const T*& data, uint32_t count);
+
+		// Copied out of the block, which keeps no alignment
+		template <typename T>
+		void data(const T*& data, size_t size) {
+			uint8_t* copy = allocate<uint8_t>(size);
+			bytes(copy, size);
+			data = reinterpret_cast<const T*>(copy);
+		}
+
+		void string(const char*& text);
+		void strings(const char* const*& texts, uint32_t count);
+
+		template <typename Next>
+		void chain(Next*& next);
+
+		// Zeroed storage for count elements, valid until the next call
+		template <typename T>
+		T* allocate(size_t count) {
+			T* items = new T[count]();
+			arena.emplace_back(items, [](void* pointer) { delete[] static_cast<T*>(pointer); });
+			return items;
+		}
+
+	private:
+		uint64_t lookup(uint64_t id) const;
+		// Loads the next block, false at the end of the file
+		bool readBlock();
+
+		std::ifstream file;
+		std::vector<uint8_t> block;
+		std::vector<uint8_t> compressed;
+		size_t position = 0;
+		bool complete = false;
+		std::unordered_map<uint64_t, uint64_t> objects;
+		std::vector<std::unique_ptr<void, void (*)(void*)>> arena;
+	};
+
+	template <typename T, typename = void>
+	struct HasStructureType : std::false_type {};
+	template <typename T>
+	struct HasStructureType<T, std::void_t<decltype(T::sType)>> : std::true_type {};
+
+	// Handles go in as their 64 bit value, anything else as its bytes. Structures holding pointers or handles
+	// need a transfer of their own, below
+	template <typename Stream, typename T>
+	void transfer(Stream& stream, T& value) {
+		if constexpr (std::is_pointer_v<T>) {
+			stream.handle(value);
+		} else {
+			static_assert(!HasStructureType<T>::value, "Structures with a pNext need a transfer of their own");
+			static_assert(std::is_trivially_copyable_v<T>, "Only plain data can be transferred as bytes");
+			stream.value(value);
+		}
+	}
+
+	// A structure as its bytes followed by its chain. Pointers other than pNext, and handles, are fixed up after
+	template <typename Stream, typename T>
+	void plain(Stream& stream, T& info) {
+		if constexpr (Stream::reading) {
+			stream.value(info);
+			stream.chain(info.pNext);
+		} else {
+			T copy = info;
+			copy.pNext = nullptr;
+			stream.value(copy);
+			stream.chain(info.pNext);
+		}
+	}
+
+	template <typename Stream>
+	void transfer(Stream& stream, VkPhysicalDeviceFeatures2& info) { plain(stream, info); }
+	template <typename Stream>
+	void transfer(Stream& stream, VkPhysicalDeviceDescriptorIndexingFeaturesEXT& info) { plain(stream, info); }
+	template <typename Stream>
+	void transfer(Stream& stream, VkPhysicalDeviceMultiviewFeatures& info) { plain(stream, info); }
+	template <typename Stream>
+	void transfer(Stream& stream, VkMemoryAllocateInfo& info) { plain(stream, info); }
+	template <typename Stream>
+	void transfer(Stream& stream, VkSamplerCreateInfo& info) { plain(stream, info); }
+	template <typename Stream>
+	void transfer(Stream& stream, VkQueryPoolCreateInfo& info) { plain(stream, info); }
+	template <typename Stream>
+	void transfer(Stream& stream, VkFenceCreateInfo& info) { plain(stream, info); }
+	template <typename Stream>
+	void transfer(Stream& stream, VkSemaphoreCreateInfo& info) { plain(stream, info); }
+	template <typename Stream>
+	void transfer(Stream& stream, VkCommandPoolCreateInfo& info) { plain(stream, info); }
+	template <typename Stream>
+	void transfer(Stream& stream, VkMemoryBarrier& barrier) { plain(stream, barrier); }
+	template <typename Stream>
+	void transfer(Stream& stream, VkPipelineInputAssemblyStateCreateInfo& info) { plain(stream, info); }
+	template <typename Stream>
+	void transfer(Stream& stream, VkPipelineTessellationStateCreateInfo& info) { plain(stream, info); }
+	template <typename Stream>
+	void transfer(Stream& stream, VkPipelineRasterizationStateCreateInfo& info) { plain(stream, info); }
+	template <typename Stream>
+	void transfer(Stream& stream, VkPipelineDepthStencilStateCreateInfo& info) { plain(stream, info); }
+
+	template <typename Stream>
+	void transfer(Stream& stream, VkDeviceQueueCreateInfo& info) {
+		plain(stream, info);
+		stream.array(info.pQueuePriorities, info.queueCount);
+	}
+
+	// Layers are the capturing application's business, the replay runs without any
+	template <typename Stream>
+	void transfer(Stream& stream, VkDeviceCreateInfo& info) {
+		info.enabledLayerCount = 0;
+		info.ppEnabledLayerNames = nullptr;
+		plain(stream, info);
+		stream.array(info.pQueueCreateInfos, info.queueCreateInfoCount);
+		stream.optional(info.pEnabledFeatures, 1);
+		stream.strings(info.ppEnabledExtensionNames, info.enabledExtensionCount);
+	}
+
+	template <typename Stream>
+	void transfer(Stream& stream, VkBufferCreateInfo& info) {
+		plain(stream, info);
+		stream.array(info.pQueueFamilyIndices, info.sharingMode == VK_SHARING_MODE_CONCURRENT ? info.queueFamilyIndexCount : 0);
+	}
+
+	template <typename Stream>
+	void transfer(Stream& stream, VkImageCreateInfo& info) {
+		plain(stream, info);
+		stream.array(info.pQueueFamilyIndices, info.sharingMode == VK_SHARING_MODE_CONCURRENT ? info.queueFamilyIndexCount : 0);
+	}
+
+	template <typename Stream>
+	void transfer(Stream& stream, VkImageViewCreateInfo& info) {
+		plain(stream, info);
+		stream.remap(info.image);
+	}
+
+	template <typename Stream>
+	void transfer(Stream& stream, VkShaderModuleCreateInfo& info) {
+		plain(stream, info);
+		stream.data(info.pCode, info.codeSize);
+	}
+
+	template <typename Stream>
+	void transfer(Stream& stream, VkDescriptorSetLayoutBinding& binding) {
+		stream.value(binding);
+		stream.optional(binding.pImmutableSamplers, binding.descriptorCount);
+	}
+
+	template <typename Stream>
+	void transfer(Stream& stream, VkDescriptorSetLayoutCreateInfo& info) {
+		plain(stream, info);
+		stream.array(info.pBindings, info.bindingCount);
+	}
+
+	template <typename Stream>
+	void transfer(Stream& stream, VkPipelineLayoutCreateInfo& info) {
+		plain(stream, info);
+		stream.array(info.pSetLayouts, info.setLayoutCount);
+		stream.array(info.pPushConstantRanges, info.pushConstantRangeCount);
+	}
+
+	template <typename Stream>
+	void transfer(Stream& stream, VkDescriptorPoolCreateInfo& info) {
+		plain(stream, info);
+		stream.array(info.pPoolSizes, info.poolSizeCount);
+	}
+
+	template <typename Stream>
+	void transfer(Stream& stream, VkDescriptorSetAllocateInfo& info) {
+		plain(stream, info);
+		stream.remap(info.descriptorPool);
+		stream.array(info.pSetLayouts, info.descriptorSetCount);
+	}
+
+	template <typename Stream>
+	void transfer(Stream& stream, VkDescriptorImageInfo& info) {
+		stream.value(info);
+		stream.remap(info.sampler);
+		stream.remap(info.imageView);
+	}
+
+	template <typename Stream>
+	void transfer(Stream& stream, VkDescriptorBufferInfo& info) {
+		stream.value(info);
+		stream.remap(info.buffer);
+	}
+
+	// Only the array the descriptor type reads is valid, the others may point anywhere
+	template <typename Stream>
+	void transfer(Stream& stream, VkWriteDescriptorSet& write) {
+		plain(stream, write);
+		stream.remap(write.dstSet);
+
+		const VkDescriptorImageInfo* images = nullptr;
+		const VkDescriptorBufferInfo* buffers = nullptr;
+		const VkBufferView* texelBuffers = nullptr;
+		switch (write.descriptorType) {
+		case VK_DESCRIPTOR_TYPE_SAMPLER:
+		case VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER:
+		case VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE:
+		case VK_DESCRIPTOR_TYPE_STORAGE_IMAGE:
+		case VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT:
+			images = write.pImageInfo;
+			stream.array(images, write.descriptorCount);
+			break;
+		case VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER:
+		case VK_DESCRIPTOR_TYPE_STORAGE_BUFFER:
+		case VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC:
+		case VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC:
+			buffers = write.pBufferInfo;
+			stream.array(buffers, write.descriptorCount);
+			break;
+		default:
+			texelBuffers = write.pTexelBufferView;
+			stream.array(texelBuffers, write.descriptorCount);
+			break;
+		}
+		write.pImageInfo = images;
+		write.pBufferInfo = buffers;
+		write.pTexelBufferView = texelBuffers;
+	}
+
+	template <typename Stream>
+	void transfer(Stream& stream, VkCopyDescriptorSet& copy) {
+		plain(stream, copy);
+		stream.remap(copy.srcSet);
+		stream.remap(copy.dstSet);
+	}
+
+	template <typename Stream>
+	void transfer(Stream& stream, VkSpecializationInfo& info) {
+		stream.value(info);
+		stream.array(info.pMapEntries, info.mapEntryCount);
+		stream.data(info.pData, info.dataSize);
+	}
+
+	template <typename Stream>
+	void transfer(Stream& stream, VkPipelineShaderStageCreateInfo& info) {
+		plain(stream, info);
+		stream.remap(info.module);
+		stream.string(info.pName);
+		stream.optional(info.pSpecializationInfo, 1);
+	}
+
+	template <typename Stream>
+	void transfer(Stream& stream, VkComputePipelineCreateInfo& info) {
+		plain(stream, info);
+		transfer(stream, info.stage);
+		stream.remap(info.layout);
+		stream.remap(info.basePipelineHandle);
+	}
+
+	template <typename Stream>
+	void transfer(Stream& stream, VkPipelineVertexInputStateCreateInfo& info) {
+		plain(stream, info);
+		stream.array(info.pVertexBindingDescriptions, info.vertexBindingDescriptionCount);
+		stream.array(info.pVertexAttributeDescriptions, info.vertexAttributeDescriptionCount);
+	}
+
+	// Viewports and scissors are left out when they are dynamic
+	template <typename Stream>
+	void transfer(Stream& stream, VkPipelineViewportStateCreateInfo& info) {
+		plain(stream, info);
+		stream.optional(info.pViewports, info.viewportCount);
+		stream.optional(info.pScissors, info.scissorCount);
+	}
+
+	template <typename Stream>
+	void transfer(Stream& stream, VkPipelineMultisampleStateCreateInfo& info) {
+		plain(stream, info);
+		stream.optional(info.pSampleMask, (static_cast<uint32_t>(info.rasterizationSamples) + 31) / 32);
+	}
+
+	template <typename Stream>
+	void transfer(Stream& stream, VkPipelineColorBlendStateCreateInfo& info) {
+		plain(stream, info);
+		stream.array(info.pAttachments, info.attachmentCount);
+	}
+
+	template <typename Stream>
+	void transfer(Stream& stream, VkPipelineDynamicStateCreateInfo& info) {
+		plain(stream, info);
+		stream.array(info.pDynamicStates, info.dynamicStateCount);
+	}
+
+	template <typename Stream>
+	void transfer(Stream& stream, VkGraphicsPipelineCreateInfo& info) {
+		plain(stream, info);
+		stream.array(info.pStages, info.stageCount);
+		stream.optional(info.pVertexInputState, 1);
+		stream.optional(info.pInputAssemblyState, 1);
+		stream.optional(info.pTessellationState, 1);
+		stream.optional(info.pViewportState, 1);
+		stream.optional(info.pRasterizationState, 1);
+		stream.optional(info.pMultisampleState, 1);
+		stream.optional(info.pDepthStencilState, 1);
+		stream.optional(info.pColorBlendState, 1);
+		stream.optional(info.pDynamicState, 1);
+		stream.remap(info.layout);
+		stream.remap(info.renderPass);
+		stream.remap(info.basePipelineHandle);
+	}
+
+	template <typename Stream>
+	void transfer(Stream& stream, VkSubpassDescription& subpass) {
+		stream.value(subpass);
+		stream.array(subpass.pInputAttachments, subpass.inputAttachmentCount);
+		stream.array(subpass.pColorAttachments, subpass.colorAttachmentCount);
+		stream.optional(subpass.pResolveAttachments, subpass.colorAttachmentCount);
+		stream.optional(subpass.pDepthStencilAttachment, 1);
+		stream.array(subpass.pPreserveAttachments, subpass.preserveAttachmentCount);
+	}
+
+	template <typename Stream>
+	void transfer(Stream& stream, VkRenderPassMultiviewCreateInfo& info) {
+		plain(stream, info);
+		stream.array(info.pViewMasks, info.subpassCount);
+		stream.array(info.pViewOffsets, info.dependencyCount);
+		stream.array(info.pCorrelationMasks, info.correlationMaskCount);
+	}
+
+	template <typename Stream>
+	void transfer(Stream& stream, VkRenderPassCreateInfo& info) {
+		plain(stream, info);
+		stream.array(info.pAttachments, info.attachmentCount);
+		stream.array(info.pSubpasses, info.subpassCount);
+		stream.array(info.pDependencies, info.dependencyCount);
+	}
+
+	template <typename Stream>
+	void transfer(Stream& stream, VkFramebufferCreateInfo& info) {
+		plain(stream, info);
+		stream.remap(info.renderPass);
+		stream.array(info.pAttachments, info.attachmentCount);
+	}
+
+	// The surface is the capturing application's, the replay renders into images in place of the swap chain's
+	template <typename Stream>
+	void transfer(Stream& stream, VkSwapchainCreateInfoKHR& info) {
+		plain(stream, info);
+		stream.array(info.pQueueFamilyIndices, info.imageSharingMode == VK_SHARING_MODE_CONCURRENT ? info.queueFamilyIndexCount : 0);
+		info.surface = VK_NULL_HANDLE;
+		info.oldSwapchain = VK_NULL_HANDLE;
+	}
+
+	template <typename Stream>
+	void transfer(Stream& stream, VkCommandBufferAllocateInfo& info) {
+		plain(stream, info);
+		stream.remap(info.commandPool);
+	}
+
+	template <typename Stream>
+	void transfer(Stream& stream, VkCommandBufferInheritanceInfo& info) {
+		plain(stream, info);
+		stream.remap(info.renderPass);
+		stream.remap(info.framebuffer);
+	}
+
+	// Primary command buffers ignore what they would inherit, which the writer then leaves null
+	template <typename Stream>
+	void transfer(Stream& stream, VkCommandBufferBeginInfo& info) {
+		plain(stream, info);
+		stream.optional(info.pInheritanceInfo, 1);
+	}
+
+	template <typename Stream>
+	void transfer(Stream& stream, VkRenderPassBeginInfo& info) {
+		plain(stream, info);
+		stream.remap(info.renderPass);
+		stream.remap(info.framebuffer);
+		stream.array(info.pClearValues, info.clearValueCount);
+	}
+
+	template <typename Stream>
+	void transfer(Stream& stream, VkBufferMemoryBarrier& barrier) {
+		plain(stream, barrier);
+		stream.remap(barrier.buffer);
+	}
+
+	template <typename Stream>
+	void transfer(Stream& stream, VkImageMemoryBarrier& barrier) {
+		plain(stream, barrier);
+		stream.remap(barrier.image);
+	}
+
+	template <typename Stream>
+	void transfer(Stream& stream, VkSubmitInfo& submit) {
+		plain(stream, submit);
+		stream.array(submit.pWaitSemaphores, submit.waitSemaphoreCount);
+		stream.array(submit.pWaitDstStageMask, submit.waitSemaphoreCount);
+		stream.array(submit.pCommandBuffers, submit.commandBufferCount);
+		stream.array(submit.pSignalSemaphores, submit.signalSemaphoreCount);
+	}
+
+	// The structures a chain may hold, passed to visit as a null pointer of their type. False for any other
+	template <typename Visit>
+	bool visitChained(VkStructureType type, Visit&& visit) {
+		switch (type) {
+		case VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2:
+			visit(static_cast<VkPhysicalDeviceFeatures2*>(nullptr));
+			return true;
+		case VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT:
+			visit(static_cast<VkPhysicalDeviceDescriptorIndexingFeaturesEXT*>(nullptr));
+			return true;
+		case VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MULTIVIEW_FEATURES:
+			visit(static_cast<VkPhysicalDeviceMultiviewFeatures*>(nullptr));
+			return true;
+		case VK_STRUCTURE_TYPE_RENDER_PASS_MULTIVIEW_CREATE_INFO:
+			visit(static_cast<VkRenderPassMultiviewCreateInfo*>(nullptr));
+			return true;
+		default:
+			return false;
+		}
+	}
+
+	template <typename... Args>
+	void Writer::fields(Args&... args) {
+		(transfer(*this, args), ...);
+	}
+
+	template <typename T>
+	void Writer::array(const T* data, uint32_t count) {
+		for (uint32_t i = 0; i < count; i++) {
+			// Transfers may fix up what they write, never the application's own structures
+			T element = data[i];
+			transfer(*this, element);
+		}
+	}
+
+	template <typename T>
+	void Writer::optional(const T* data, uint32_t count) {
+		uint8_t present = data != nullptr ? 1 : 0;
+		value(present);
+		if (present) {
+			array(data, count);
+		}
+	}
+
+	template <typename Next>
+	void Writer::chain(Next* next) {
+		for (auto item = static_cast<const VkBaseInStructure*>(next); item != nullptr; item = item->pNext) {
+			bool known = visitChained(item->sType, [&](auto* type) {
+				using Structure = std::remove_pointer_t<decltype(type)>;
+				Structure copy = *reinterpret_cast<const Structure*>(item);
+				// The rest of the chain follows flat rather than nested in this structure's
+				copy.pNext = nullptr;
+				value(item->sType);
+				transfer(*this, copy);
+			});
+			if (!known) {
+				skippedStructures++;
+			}
+		}
+		value(CHAIN_END);
+	}
+
+	template <typename... Args>
+	void Reader::fields(Args&... args) {
+		(transfer(*this, args), ...);
+	}
+
+	template <typename T>
+	void Reader::array(const T*& data, uint32_t count) {
+		if (count == 0) {
+			data = nullptr;
+			return;
+		}
+		T* items = allocate<T>(count);
+		for (uint32_t i = 0; i < count; i++) {
+			transfer(*this, items[i]);
+		}
+		data = items;
+	}
+
+	template <typename T>
+	void Reader::optional(const T*& data, uint32_t count) {
+		uint8_t present = 0;
+		value(present);
+		if (present) {
+			array(data, count);
+		} else {
+			data = nullptr;
+		}
+	}
+
+	template <typename Next>
+	void Reader::chain(Next*& next) {
+		void* head = nullptr;
+		VkBaseOutStructure* tail = nullptr;
+		for (;;) {
+			VkStructureType type = CHAIN_END;
+			value(type);
+			if (type == CHAIN_END) {
+				break;
+			}
+
+			VkBaseOutStructure* item = nullptr;
+			bool known = visitChained(type, [&](auto* tag) {
+				using Structure = std::remove_pointer_t<decltype(tag)>;
+				Structure* structure = allocate<Structure>(1);
+				transfer(*this, *structure);
+				item = reinterpret_cast<VkBaseOutStructure*>(structure);
+			});
+			if (!known) {
+				throw std::runtime_error("Trace holds a structure of unknown type " + std::to_string(static_cast<int>(type)));
+			}
+
+			item->pNext = nullptr;
+			if (tail == nullptr) {
+				head = item;
+			} else {
+				tail->pNext = item;
+			}
+			tail = item;
+		}
+		next = head;
+	}
+
+}
@@ -0,0 +1,119 @@
+#pragma once
+
+#include "Trace.h"
+#include "VulkanUtil.h"
+
+#include <vulkan/vulkan.h>
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Re-executes a trace written by the trace layer on a device of its own, with no window or display, and times
+// its frames. Calls are made in the order they were traced, on one thread, with the arguments they were traced
+// with: the application's work and assets are not needed, only what it handed to Vulkan. Swap chain images are
+// replaced by images of the replay's, acquiring one signals what the swap chain would have and presenting one
+// waits for what the present would have. Waits that saw their fences signal when traced wait for them again,
+// so the replay keeps no more frames in flight than the application did
+class TraceReplay {
+public:
+	struct Config {
+		std::string path;
+		// Sleep so that no frame ends sooner after the first than it did when traced, as fast as possible otherwise
+		bool paced = false;
+		// First device whose name contains this. Otherwise the device traced on if there is one, else the first
+		std::string deviceName;
+	};
+
+	struct Result {
+		// Everything up to the end of the first frame, which is where the application creates most of what it uses
+		double setupMs = 0.0;
+		// Every frame after the first, ended by its present, or by its fenced submission when nothing is presented
+		std::vector<double> frameMs;
+		// The same frames as they were traced
+		std::vector<double> tracedFrameMs;
+		uint64_t calls = 0;
+		// Whether the trace reached its end, rather than stopping where the application did
+		bool complete = false;
+	};
+
+	explicit TraceReplay(const Config& config);
+	~TraceReplay();
+	TraceReplay(const TraceReplay&) = delete;
+	TraceReplay& operator=(const TraceReplay&) = delete;
+
+	Result run();
+
+	// Empty until the trace's device has been created
+	const std::string& getDeviceName() const { return deviceName; }
+	const std::string& getTracedDeviceName() const { return tracedDeviceName; }
+
+private:
+	// An object the replay created for the trace, by its traced handle
+	struct Live {
+		trace::Object type;
+		uint64_t object;
+	};
+
+	// An allocation is mapped the first time the trace writes to it, and stays mapped
+	struct Allocation {
+		VkDeviceSize size = 0;
+		bool coherent = true;
+		void* mapped = nullptr;
+	};
+
+	struct Swapchain {
+		VkSwapchainCreateInfoKHR info = {};
+		std::vector<vkutil::Image> images;
+	};
+
+	void execute(trace::Call call, Result& result);
+
+	// From the traced calls' arguments
+	void createInstance();
+	void createDevice();
+	// Creates an object with vkCreate from the traced create info and binds it to the traced handle
+	template <typename Info, typename T, typename Create>
+	void create(trace::Object type, Create vkCreate, const char* what);
+	uint32_t findMemoryType(uint32_t tracedIndex, VkMemoryPropertyFlags properties) const;
+
+	template <typename T>
+	void created(trace::Object type, uint64_t traced, T object) {
+		reader.bind(traced, object);
+		live[traced] = { type, reinterpret_cast<uint64_t>(object) };
+	}
+	void destroy(uint64_t traced);
+	void destroy(const Live& object);
+	void destroySwapchain(Swapchain& swapchain);
+
+	// An empty submission waiting for and signaling what it is given, standing in for the swap chain's own
+	void signal(VkQueue queue, const std::vector<VkSemaphore>& waits, VkSemaphore semaphore, VkFence fence);
+
+	Config config;
+	trace::Reader reader;
+
+	VkInstance instance = VK_NULL_HANDLE;
+	VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;
+	VkDevice device = VK_NULL_HANDLE;
+	VkPhysicalDeviceMemoryProperties memoryProperties = {};
+	std::string deviceName;
+	std::string tracedDeviceName;
+	PFN_vkCmdDrawIndexedIndirectCountKHR cmdDrawIndexedIndirectCount = nullptr;
+	// What acquiring an image signals on, the first queue the trace asked for
+	VkQueue acquireQueue = VK_NULL_HANDLE;
+
+	std::unordered_map<uint64_t, Live> live;
+	std::unordered_map<VkDeviceMemory, Allocation> allocations;
+	// By traced handle, which is also what the reader maps the swap chain's handle to
+	std::unordered_map<uint64_t, Swapchain> swapchains;
+
+	// When the first frame ended, when traced and when replayed, which later frames are paced against
+	std::chrono::steady_clock::time_point replayStart;
+	std::chrono::steady_clock::time_point lastFrameEnd;
+	std::chrono::steady_clock::time_point firstFrameEnd;
+	uint64_t firstTracedFrameEnd = 0;
+	uint64_t lastTracedFrameEnd = 0;
+	uint64_t frames = 0;
+};
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+// Hands the newest of a stream of values from one writer thread to one reader thread without either ever
+// waiting on the other. Each side owns one of three buffers and the third sits in between, publishing swaps
+// the writer's buffer into the middle and reading swaps the middle out when something new was put there.
+// Values the reader was too slow to see are skipped, so anything that must not be lost has to accumulate
+template<typename T>
+class TripleBuffer {
+public:
+	TripleBuffer() = default;
+	TripleBuffer(const TripleBuffer&) = delete;
+	TripleBuffer& operator=(const TripleBuffer&) = delete;
+
+	// Writer side. Fill in the buffer write returns, then publish it. The next write gets another buffer
+	// holding some older value, so write the whole of it every time
+	T& write() { return buffers[back]; }
+	void publish() {
+		back = middle.exchange(back | FRESH, std::memory_order_acq_rel) & INDEX;
+	}
+
+	// Reader side. Take the newest value published, if there was one since the last call, and return whether
+	// there was. read keeps returning the value taken until then
+	bool update() {
+		if ((middle.load(std::memory_order_relaxed) & FRESH) == 0) {
+			return false;
+		}
+		front = middle.exchange(front, std::memory_order_acq_rel) & INDEX;
+		return true;
+	}
+	const T& read() const { return buffers[front]; }
+
+private:
+	static const uint32_t INDEX = 3;
+	static const uint32_t FRESH = 4;
+
+	T buffers[3] = {};
+	// Index of the buffer in between, with FRESH set when the writer put it there and the reader has not
+	// taken it yet. On its own cache line, as both threads write it
+	alignas(64) std::atomic<uint32_t> middle{ 1 };
+	alignas(64) uint32_t back = 0;
+	alignas(64) uint32_t front = 2;
+};
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <glm/glm.hpp>
+
+#include <array>
+
+struct Vertex {
+	glm::vec3 pos;
+	glm::vec3 normal;
+	glm::vec2 uv;
+
+	// How vertices are laid out in our vertex buffer, one binding with all attributes interleaved
+	static VkVertexInputBindingDescription getBindingDescription() {
+		VkVertexInputBindingDescription bindingDescription = {};
+		bindingDescription.binding	 = 0;
+		bindingDescription.stride	 = sizeof(Vertex);
+		bindingDescription.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+
+		return bindingDescription;
+	}
+
+	// Where each attribute lives inside a vertex, matching the locations in vulkan.vert
+	static std::array<VkVertexInputAttributeDescription, 3> getAttributeDescriptions() {
+		std::array<VkVertexInputAttributeDescription, 3> attributeDescriptions = {};
+
+		attributeDescriptions[0].binding  = 0;
+		attributeDescriptions[0].location = 0;
+		attributeDescriptions[0].format	  = VK_FORMAT_R32G32B32_SFLOAT;
+		attributeDescriptions[0].offset	  = offsetof(Vertex, pos);
+
+		attributeDescriptions[1].binding  = 0;
+		attributeDescriptions[1].location = 1;
+		attributeDescriptions[1].format	  = VK_FORMAT_R32G32B32_SFLOAT;
+		attributeDescriptions[1].offset	  = offsetof(Vertex, normal);
+
+		attributeDescriptions[2].binding  = 0;
+		attributeDescriptions[2].location = 2;
+		attributeDescriptions[2].format	  = VK_FORMAT_R32G32_SFLOAT;
+		attributeDescriptions[2].offset	  = offsetof(Vertex, uv);
+
+		return attributeDescriptions;
+	}
+};
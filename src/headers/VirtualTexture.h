@@ -0,0 +1,191 @@
+#pragma once
+
+#include "ThreadPool.h"
+#include "VulkanUtil.h"
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <future>
+#include <vector>
+
+// A texture far larger than video memory, kept resident a page at a time without sparse binding. Only the pages
+// the screen asked for recently are kept, in a cache texture of fixed size. A page table with a texel per page on
+// every level points each page at its place in the cache or, while it is missing, at its closest resident ancestor.
+// The scene's fragment shader writes the page it sampled into a feedback buffer for one pixel of every screen tile,
+// which is copied back and read once the frame's fence has been waited on. Missing pages are generated on worker
+// threads of the texture's own, so the culling workers never queue behind them, coarser ones first, and replace the page that went longest without being asked for
+class VirtualTexture {
+public:
+	// Texels along a page side, PAGE_BORDER on each side repeating its neighbours for filtering.
+	// Keep in sync with vulkan.frag
+	static const uint32_t PAGE_SIZE = 128;
+	static const uint32_t PAGE_BORDER = 4;
+	static const uint32_t PAGE_CONTENT = PAGE_SIZE - 2 * PAGE_BORDER;
+	static const VkFormat FORMAT = VK_FORMAT_R8G8B8A8_SRGB;
+	// Screen tiles feedback is written for are this many pixels a side, a different pixel of each every frame
+	static const uint32_t FEEDBACK_TILE = 8;
+	// Feedback of a tile nothing virtually textured was drawn to
+	static const uint32_t NO_PAGE = 0xFFFFFFFFu;
+	// Pages along a side of the finest level at most. The page table grows with it, four bytes a page
+	static const uint32_t MAX_PAGES = 1024;
+	// Cache pages along a side at most, the page table stores their coordinates in a byte
+	static const uint32_t MAX_CACHE_PAGES = 256;
+
+	struct Config {
+		// Pages along a side of the finest level, a power of two
+		uint32_t pagesPerSide = 256;
+		// Memory the cache may take, rounded down to a square of pages
+		VkDeviceSize cacheBytes = 64ull * 1024 * 1024;
+		uint32_t framesInFlight = 2;
+		// Pages uploaded per frame at most, twice as many are generated at once
+		uint32_t uploadsPerFrame = 16;
+		uint32_t generateThreads = 2;
+	};
+
+	struct Stats {
+		uint32_t residentPages = 0;
+		// Distinct pages the last feedback asked for, and those of them that were not resident
+		uint32_t requestedPages = 0;
+		uint32_t missingPages = 0;
+		uint32_t pendingPages = 0;
+		// Since the last resetCounters
+		uint32_t loadedPages = 0;
+		uint32_t evictedPages = 0;
+		// Generated pages dropped because every page in the cache was asked for in the same frame
+		uint32_t droppedPages = 0;
+	};
+
+	VirtualTexture(VkDevice device, VkPhysicalDevice physicalDevice, const Config& config);
+	VirtualTexture(const VirtualTexture&) = delete;
+	VirtualTexture& operator=(const VirtualTexture&) = delete;
+
+	// The cache must be sampled with linear filtering and the page table fetched as unsigned integers. Writing
+	// feedback from fragment shaders takes fragmentStoresAndAtomics, which then has to be enabled
+	static bool isSupported(VkPhysicalDevice physicalDevice);
+
+	// Texels of a page, border included. Stands in for reading it from disk
+	static std::vector<uint8_t> generatePage(uint32_t page, uint32_t pagesPerSide);
+
+	// Pages are identified as the shaders write them to the feedback buffer
+	static uint32_t pageId(uint32_t mip, uint32_t x, uint32_t y) { return (mip << 24) | (y << 12) | x; }
+
+	// Load the single page of the coarsest level, which every other page falls back to and which is never evicted,
+	// and point the whole page table at it. Waits for the queue to finish
+	void loadRoot(VkCommandPool commandPool, VkQueue queue);
+
+	// Size the feedback for a screen, nothing happens if it already is. Must not be called with frames in flight
+	void resize(VkExtent2D screen);
+
+	// Call once the frame's previous submission is done. Reads the feedback that submission wrote and picks the
+	// pages and page table entries this frame uploads
+	void update(uint32_t frame);
+
+	// Record what update picked, leaving the cache and page table ready for fragment shaders
+	void recordUploads(VkCommandBuffer commandBuffer);
+
+	// Clear the frame's feedback ahead of the scene draws, and copy it to where update reads it after them
+	void recordFeedbackReset(VkCommandBuffer commandBuffer, uint32_t frame);
+	void recordFeedbackReadback(VkCommandBuffer commandBuffer, uint32_t frame);
+
+	void destroy();
+
+	// Cache, page table and the frame's feedback buffer, set 3 of the scene shaders
+	VkDescriptorSetLayout getSetLayout() const { return setLayout; }
+	VkDescriptorSet getDescriptorSet(uint32_t frame) const { return descriptorSets[frame]; }
+
+	uint32_t getPagesPerSide() const { return config.pagesPerSide; }
+	uint32_t getMipCount() const { return mipCount; }
+	uint32_t getCachePagesPerSide() const { return cachePages; }
+	// Texels along a side of the finest level
+	uint32_t getSize() const { return config.pagesPerSide * PAGE_CONTENT; }
+	// What the texture takes on the gpu, whatever its size
+	VkDeviceSize getCacheBytes() const;
+	VkDeviceSize getPageTableBytes() const;
+
+	const Stats& getStats() const { return stats; }
+	void resetCounters();
+
+private:
+	static const uint32_t NO_SLOT = 0xFFFFFFFFu;
+
+	// A page of the cache and the page it holds
+	struct Slot {
+		uint32_t page = NO_PAGE;
+		// Last frame the page was asked for. The root is pinned by never being older than the current frame
+		uint64_t lastUsed = 0;
+	};
+
+	struct PendingPage {
+		uint32_t page;
+		std::future<std::vector<uint8_t>> texels;
+	};
+
+	// Page table entries to recompute and upload on one level, empty when x0 == x1
+	struct Rect {
+		uint32_t x0 = 0;
+		uint32_t y0 = 0;
+		uint32_t x1 = 0;
+		uint32_t y1 = 0;
+	};
+
+	uint32_t levelPages(uint32_t mip) const { return config.pagesPerSide >> mip; }
+	VkDeviceSize frameStagingBytes() const;
+
+	// A free slot, otherwise the one asked for least recently after evicting its page. NO_SLOT if every
+	// page in the cache was asked for this frame
+	uint32_t acquireSlot();
+
+	// Point a page at a slot, or back at its ancestor with NO_SLOT, marking the entries under it for upload
+	void setResidency(uint32_t page, uint32_t slot);
+
+	// Recompute the marked page table entries, coarsest level first as finer ones copy theirs, and stage them
+	void stagePageTable(VkDeviceSize stagingOffset);
+
+	void recordCopies(VkCommandBuffer commandBuffer, bool initial);
+
+	VkDevice device;
+	VkPhysicalDevice physicalDevice;
+	Config config;
+
+	uint32_t mipCount = 0;
+	uint32_t cachePages = 0;
+
+	vkutil::Image cache;
+	vkutil::Image pageTable;
+	VkSampler cacheSampler = VK_NULL_HANDLE;
+	VkSampler tableSampler = VK_NULL_HANDLE;
+
+	// A region per frame in flight, page texels followed by page table entries
+	vkutil::Buffer staging;
+
+	VkExtent2D feedbackExtent = { 0, 0 };
+	std::vector<vkutil::Buffer> feedbackBuffers;
+	std::vector<vkutil::Buffer> readbackBuffers;
+
+	VkDescriptorSetLayout setLayout = VK_NULL_HANDLE;
+	VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
+	std::vector<VkDescriptorSet> descriptorSets;
+
+	std::vector<Slot> slots;
+	std::vector<uint32_t> freeSlots;
+	// Per level, the slot of every page or NO_SLOT, and the page table entry every page gets
+	std::vector<std::vector<uint32_t>> residency;
+	std::vector<std::vector<uint32_t>> table;
+	std::vector<Rect> dirty;
+
+	std::vector<PendingPage> pending;
+	std::vector<uint32_t> requests;
+	std::vector<uint32_t> missing;
+
+	// This frame's copies, out of its staging region
+	std::vector<VkBufferImageCopy> pageCopies;
+	std::vector<VkBufferImageCopy> tableCopies;
+
+	uint32_t currentFrame = 0;
+	uint64_t frameNumber = 0;
+	Stats stats;
+
+	// Last, so the pages still being generated finish before anything they might touch goes away
+	ThreadPool generateWorkers;
+};
@@ -6,11 +6,38 @@
 
 #include "QueueFamilyIndices.h"
 #include "SwapChainSupportDetails.h"
+#include "Settings.h"
+#include "Scene.h"
+#include "Camera.h"
+#include "ShaderTypes.h"
+#include "VulkanUtil.h"
+#include "ThreadPool.h"
+#include "AssetPack.h"
+#include "OcclusionCuller.h"
+#include "RenderGraph.h"
+#include "TextureStreamer.h"
+#include "VirtualTexture.h"
+#include "LightClusters.h"
+#include "ShadowMaps.h"
+#include "Downsampler.h"
+#include "PostProcess.h"
+#include "ParticleSystem.h"
+#include "DynamicResolution.h"
+#include "TripleBuffer.h"
+#include "DrawBatcher.h"
+#include "MultiviewRenderer.h"
+#include "FrameCapture.h"
+
+#include <atomic>
+#include <exception>
+#include <memory>
 
 class VulkanApplication {
 
 	/// * * * * * INITIALIZATION AND MAIN LOGIC * * * * * ///
 public:
+	explicit VulkanApplication(const AppSettings& settings);
+
 	// Run our HelloTriangle program
 	void run();
 
@@ -21,22 +48,52 @@ private:
 	// Initialize our handle to vulkan and setup graphics communication
 	void initVulkan();
 
-	// Our main game loop
+	// Our main game loop. With a window and a render thread this thread only waits on the window's events and
+	// passes them on, the render thread records and submits the frames
 	void mainLoop();
 
+	// Body of the render thread, drawing frames until the window closes, the frame count is reached or error
+	void renderLoop();
+
 	// Free up dynamic memory and allocated objects in Vulkan
 	void cleanup();
 
 	// Our main draw loop. Calls draw commands
 	void drawFrame();
 
+	// Seconds the scene has been running for. Headless runs step a fixed 60th of a second every frame instead,
+	// so a frame always shows the same scene however long it took
+	double frameTime() const;
+
 	// Our callback for resizing of window
 	static void framebufferResizeCallback(GLFWwindow* window, int width, int height);
 
+	// Our callback for key presses. C cycles through the culling modes
+	static void keyCallback(GLFWwindow* window, int key, int scancode, int action, int mods);
+
+	// Dragging with the left mouse button turns the camera's orbit
+	static void mouseButtonCallback(GLFWwindow* window, int button, int action, int mods);
+	static void cursorPosCallback(GLFWwindow* window, double x, double y);
+
+	// Hand the input gathered from the window's events so far to the renderer. Main thread only
+	void publishInput();
+
+	// Take the newest input published and act on the key presses since the last one taken. Renderer only
+	void sampleInput();
+
+	// Do what the key of an action does, once per press
+	void applyAction(uint32_t action);
+
+	// Block until the window has new events and take them. With a render thread it can only poll for them
+	void waitForInput();
+
 
 	
 	/// * * * * * VULKAN HANDLE CREATION AND MANAGEMENT* * * * * ///
 
+	// Shaders and baked textures come from the asset pack when there is one and it is enabled, loose files otherwise
+	void openAssets();
+
 	// Create our Vulkan instance. Connection between app and vulkan
 	void createInstance();
 
@@ -56,24 +113,45 @@ private:
 	// Create our handle to basic views of our swap chain images
 	void createImageViews();
 
+	// Device extensions that must be there, the swap chain's only when there is a window
+	std::vector<const char*> requiredDeviceExtensions() const;
+
 	// Create our grpahics pipeline, creating shaders and graphics pipeline settings
 	void createGraphicsPipeline();
 
 	// Create our shader module
 	VkShaderModule createShaderModule(const std::vector<char>& code);
 
-	// Set up our render pass
+	// Set up the render pass our pipelines are created against. The passes drawn with come from the render graph
 	void createRenderPass();
 
-	// Create our framebuffers for each image in our swapchain
-	void createFramebuffers();
+	// Find the first candidate format supporting the features we need
+	VkFormat findSupportedFormat(const std::vector<VkFormat>& candidates, VkImageTiling tiling, VkFormatFeatureFlags features);
+	VkFormat findDepthFormat();
+
+	// Highest sample count up to settings.msaaSamples that color and depth attachments support, and
+	// that the depth pyramid can sample
+	VkSampleCountFlagBits chooseSampleCount();
 
 	// Create our command pool
 	void createCommandPool();
 
-	// Create our command buffers to be used in our command pool
+	// Create our command buffers to be used in our command pool, one per frame in flight
 	void createCommandBuffers();
 
+	// Declare this frame's passes for the current culling mode and compile them
+	void buildRenderGraph();
+
+	// Record everything drawn this frame
+	void recordCommandBuffer(VkCommandBuffer commandBuffer, uint32_t imageIndex);
+
+	// Work of this frame run on the compute queue, the light binning, if it is run there at all
+	bool useAsyncCompute() const;
+	void recordAsyncCompute(VkCommandBuffer commandBuffer);
+
+	// Time the end of a part of the frame, if the device supports timestamps
+	void writeTimestamp(VkCommandBuffer commandBuffer, VkPipelineStageFlagBits stage, uint32_t timestamp);
+
 	// Set up our semaphores and fences
 	void createSyncObjects();
 	
@@ -82,6 +160,109 @@ private:
 
 
 
+	/// * * * * * SCENE AND CULLING * * * * * ///
+
+	// Upload our scene's geometry, object and mesh data to the gpu
+	void createSceneBuffers();
+
+	// Buffers written by the culling passes and read back for statistics
+	void createCullingBuffers();
+
+	// Depth pyramid built from the depth buffer for occlusion culling
+	void createHiZResources();
+
+	// Streamed textures, if the device can index them per object. Their tails are loaded with the scene
+	void createTextureStreamer();
+
+	// Light lists binned per cluster of the view frustum, and the scene's lights uploaded every frame
+	void createLightClusters();
+	void updateLights(uint32_t frame, const CameraData& cameraData);
+
+	// Sun shadow cascades, drawn with the frame's set so it must exist. Their casters are set with the scene
+	void createShadowMaps();
+
+	// Compute chain from the HDR scene to the swap chain image: auto exposure, bloom and the tonemap
+	void createPostProcess();
+
+	// Particles emitted, simulated and drawn on the gpu, unless the settings leave them out
+	void createParticleSystem();
+
+	// Scale controller of the scene's render resolution, which needs the frame's timestamps to steer by
+	void createDynamicResolution();
+
+	// Virtual texture covering the ground, if the device can write feedback from fragment shaders. Its root
+	// page is loaded with the scene
+	void createVirtualTexture();
+
+	// Readback and encoding of every frame into the capture directory, if the settings ask for one and the swap
+	// chain images can be copied from
+	void createFrameCapture();
+
+	// Descriptor layouts, pool and sets for our scene and compute passes
+	void createDescriptorSetLayouts();
+	void createDescriptorPool();
+	void createDescriptorSets();
+
+	// Culling and depth pyramid compute pipelines
+	void createComputePipelines();
+
+	// Timestamp queries used to time each part of the frame
+	void createQueryPools();
+
+	// Update the camera uniform buffer of a frame
+	void updateCamera(uint32_t frame);
+
+	// Cull on the cpu and write the resulting draw commands and ids into the frame's upload buffer
+	void runCpuCulling(uint32_t frame, const CameraData& cameraData);
+
+	// Work out the finest mip each texture is seen at and let the streamer act on it
+	void updateTextureStreaming(uint32_t frame, const CameraData& cameraData);
+
+	// Point a frame's texture array at the streamer's current views
+	void updateTextureDescriptors(uint32_t frame);
+
+	// Push constants shared by the object and cluster culling passes
+	CullPushConstants getCullConstants(uint32_t phase) const;
+
+	// Record the culling dispatch of a phase, leaving its draw commands ready for indirect drawing
+	void recordCulling(VkCommandBuffer commandBuffer, uint32_t phase);
+
+	// True if this frame culls and draws per cluster
+	bool useClusterCulling() const;
+
+	// Cull the clusters of the objects a culling phase let through, writing one draw per visible cluster
+	void recordClusterCulling(VkCommandBuffer commandBuffer, uint32_t phase);
+
+	// Record the indirect draws written by a culling phase
+	void recordSceneDraws(VkCommandBuffer commandBuffer, uint32_t phase);
+
+	// Reduce the depth buffer into every level of the depth pyramid
+	void recordHiZBuild(VkCommandBuffer commandBuffer);
+
+	// One dispatch per level from firstLevel up to endLevel, each reading the one before. Level 0 reads the depth buffer
+	void recordHiZLevels(VkCommandBuffer commandBuffer, uint32_t firstLevel, uint32_t endLevel);
+
+	// Time the single pass downsampler against a blit per level on a color image and against the depth
+	// pyramid's dispatch per level, printing both
+	void runDownsampleBenchmark();
+
+	// Record the scene's objects repeated into 10k to 100k draws through the draw batcher, once as submitted and
+	// once sorted and instanced, printing the binds and cpu recording time of both
+	void runBatchBenchmark();
+
+	// Draw the scene from settings.multiviewViews cameras around it, every camera in one submission with
+	// multiview and a submission per camera as separate frames would, printing the views per second of both
+	void runMultiviewBenchmark();
+
+	// Read back timings and draw counts of a finished frame, printing them every statsInterval frames
+	void collectFrameStats(uint32_t frame);
+
+	// Feed a finished frame's gpu time to the resolution controller and pick the part of the screen the next
+	// frame renders the scene into
+	void updateRenderExtent(uint32_t frame);
+
+
+
 	/// * * * * * GPU FOCUSED * * * * * ///
 
 	// Grab our graphics card
@@ -116,6 +297,8 @@ public:
 	const int windowHeight = 600;
 
 private:
+	AppSettings settings;
+
 	// Our window to draw to
 	GLFWwindow* window;
 	VkInstance instance;
@@ -131,6 +314,8 @@ private:
 	VkQueue graphicsQueue;
 	// Handle to interact with presentation queue in the logical device
 	VkQueue presentationQueue;
+	// Dedicated compute queue, if the device has one
+	VkQueue computeQueue = VK_NULL_HANDLE;
 
 	// Cached queue families supported on our physical device
 	QueueFamilyIndices indices;
@@ -144,13 +329,30 @@ private:
 	VkSwapchainKHR oldSwapChain = VK_NULL_HANDLE;
 	std::vector<VkImage> swapChainImages;
 	std::vector<VkImageView> swapChainImageViews;
-	std::vector<VkFramebuffer> swapChainFramebuffers;
 	VkFormat swapChainImageFormat;
 	VkExtent2D swapChainExtent;
 
+	// Format of the depth buffer, a transient image of the render graph
+	VkFormat depthFormat;
+	// Samples of the scene color and depth attachments. Multisampled color is resolved into the HDR target
+	VkSampleCountFlagBits msaaSamples = VK_SAMPLE_COUNT_1_BIT;
+
+	// Without a window, the images standing in for the swap chain's, one per frame in flight
+	std::vector<vkutil::Image> headlessImages;
+
+	// Passes of a frame and the resources they share. Rebuilt when the swap chain or culling mode changes
+	RenderGraph renderGraph;
+	RenderGraph::Resource depthResource = 0;
+	bool renderGraphDirty = false;
+	// Swap chain image the frame being recorded writes
+	uint32_t currentImageIndex = 0;
+
 	// Command pool and buffers for our graphics queue
 	VkCommandPool commandPool;
 	std::vector<VkCommandBuffer> commandBuffers;
+	// And for the compute queue, recorded every frame work runs on it
+	VkCommandPool computeCommandPool = VK_NULL_HANDLE;
+	std::vector<VkCommandBuffer> computeCommandBuffers;
 
 
 	// Frame variables
@@ -158,18 +360,235 @@ private:
 	int currentFrame = 0;
 	bool frameBufferResized = false;
 
+	// What the window's events add up to. The main thread gathers it, the renderer works from the copy it
+	// sampled last, so nothing the callbacks touch is shared but the triple buffer between the two
+	enum InputAction : uint32_t {
+		INPUT_CULLING_MODE = 0,
+		INPUT_LOD,
+		INPUT_MESHLETS,
+		INPUT_LIGHTING,
+		INPUT_ASYNC_COMPUTE,
+		INPUT_SHADOW_CACHE,
+		INPUT_DYNAMIC_RESOLUTION,
+		INPUT_ACTION_COUNT,
+	};
+	struct InputState {
+		// Of the window's framebuffer, 0 while it is minimized, and how often it changed size
+		int framebufferWidth = 0;
+		int framebufferHeight = 0;
+		uint32_t resizes = 0;
+		// Presses of each action's key so far. Never reset, the renderer acts on the difference to the last
+		// state it sampled so presses in states it skipped still count
+		uint32_t actions[INPUT_ACTION_COUNT] = {};
+		// Radians dragging has turned the camera's orbit so far
+		double orbitOffset = 0.0;
+		// Events so far and the time of the newest, on glfwGetTime's clock
+		uint64_t events = 0;
+		double eventTime = 0.0;
+	};
+	InputState pendingInput;
+	bool dragging = false;
+	double lastCursorX = 0.0;
+	TripleBuffer<InputState> inputBuffer;
+	InputState input;
+	// Time of the newest event the frame being recorded sampled, its submission measures the input latency
+	// from there. Negative when it sampled none
+	double sampledEventTime = -1.0;
+
+	// Cleared to stop the render thread, and by it when it stops on its own. An error it stops on is
+	// rethrown on the main thread
+	std::atomic<bool> running{ true };
+	std::exception_ptr renderError;
+	// Frames submitted so far, and the time between the last two
+	uint64_t frameNumber = 0;
+	double lastFrameTime = 0.0;
+	float frameDelta = 0.0f;
+
 	// Semaphores/fences to synchronize drawing operations on gpu
 	std::vector<VkSemaphore> imageAvailableSemaphores;
 	std::vector<VkSemaphore> renderFinishedSemaphores;
+	// Signaled by the compute queue's work of a frame, which its graphics work waits on
+	std::vector<VkSemaphore> computeFinishedSemaphores;
 	std::vector<VkFence> inFlightFences;
 
 	// Handle to our one graphics pipeline
 	VkPipeline graphicsPipeline;
-	// Our handle to our renderpass. Determines what happens during this render
+	// Copies of it differing in culling and blending, for the batch benchmark to switch between
+	std::vector<VkPipeline> batchPipelines;
+	// Our handle to our renderpass. Only describes the attachments, every pass of the render graph is compatible with it
 	VkRenderPass renderPass;
 	// Our shader layout. Need one for each shader combination / pipeline we want
 	VkPipelineLayout pipelineLayout;
 
+	// Scene we are drawing and the camera looking at it
+	Scene scene;
+	Camera camera;
+
+	// Scene geometry, every mesh packed into one vertex and one index buffer
+	vkutil::Buffer vertexBuffer;
+	vkutil::Buffer indexBuffer;
+	std::vector<MeshData> meshData;
+	vkutil::Buffer meshBuffer;
+	// Every level of detail of every mesh, each with its own draw command and visible id list
+	std::vector<LodData> lodData;
+	vkutil::Buffer lodBuffer;
+	uint32_t visibleStride = 0;
+	std::vector<ObjectData> objectData;
+	vkutil::Buffer objectBuffer;
+	std::vector<vkutil::Buffer> cameraBuffers;
+
+	// Indirect draws written by the culling passes, one command per level of detail and phase,
+	// reset from drawTemplateBuffer at the start of every frame
+	vkutil::Buffer drawTemplateBuffer;
+	vkutil::Buffer drawCommandBuffer;
+	// Ids of the objects each draw command instances
+	vkutil::Buffer visibleIdBuffer;
+	// Which objects were visible last frame
+	vkutil::Buffer visibilityBuffer;
+	// Level of detail each object was last drawn with, for hysteresis
+	vkutil::Buffer lodStateBuffer;
+
+	// Cluster culling. Objects surviving object culling are listed with an indirect dispatch per phase,
+	// the cluster pass then compacts one draw per visible cluster into clusterDrawBuffer
+	vkutil::Buffer meshletBuffer;
+	vkutil::Buffer clusterObjectBuffer;
+	vkutil::Buffer clusterDrawBuffer;
+	vkutil::Buffer clusterCountBuffer;
+	uint32_t clusterCapacity = 0;
+	uint32_t meshletCount = 0;
+
+	// Cluster draws need multiDrawIndirect and drawIndirectFirstInstance, the draw count extension is optional
+	bool meshletsSupported = false;
+	bool drawIndirectCountSupported = false;
+	PFN_vkCmdDrawIndexedIndirectCountKHR cmdDrawIndexedIndirectCount = nullptr;
+	// Host visible copies of the draw commands for statistics
+	std::vector<vkutil::Buffer> statsBuffers;
+
+	// Cpu occlusion culling. Draw commands for both phases followed by the visible ids, copied over
+	// the gpu culling results in its place
+	ThreadPool threadPool;
+	std::unique_ptr<OcclusionCuller> occlusionCuller;
+	std::vector<uint8_t> cpuVisible;
+	std::vector<vkutil::Buffer> cpuCullBuffers;
+
+	std::unique_ptr<AssetLoader> assets;
+
+	// Textures need non uniform indexing of sampled image arrays, the memory budget extension is optional.
+	// Both go through VK_KHR_get_physical_device_properties2 on the instance
+	bool texturesSupported = false;
+	bool memoryBudgetSupported = false;
+	// Baked textures in BCn formats can be sampled
+	bool blockCompressionSupported = false;
+	PFN_vkGetPhysicalDeviceFeatures2KHR getPhysicalDeviceFeatures2 = nullptr;
+	PFN_vkGetPhysicalDeviceMemoryProperties2KHR getPhysicalDeviceMemoryProperties2 = nullptr;
+	std::unique_ptr<TextureStreamer> textureStreamer;
+	// Streamer version each frame's descriptor set was last written with
+	std::vector<uint64_t> textureVersions;
+	std::vector<uint32_t> textureDemand;
+
+	std::unique_ptr<LightClusters> lightClusters;
+	std::vector<LightData> frameLights;
+
+	std::unique_ptr<ShadowMaps> shadowMaps;
+
+	// The tonemap writes the swap chain image itself where it can be a storage image of a format the shader
+	// can store, otherwise an image it is then blitted from. Both subgroup reductions and stores without a
+	// format are used where the device has them
+	std::unique_ptr<PostProcess> postProcess;
+	bool directPostOutput = false;
+	bool postSubgroupsSupported = false;
+	bool storageWithoutFormatSupported = false;
+	// Stage the swap chain image is first used at, which the frame waits to acquire it before
+	VkPipelineStageFlags backbufferStage = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+
+	std::unique_ptr<ParticleSystem> particleSystem;
+
+	// The swap chain images are transfer sources of a format the capture reads, when it is wanted at all
+	std::unique_ptr<FrameCapture> frameCapture;
+	bool captureSupported = false;
+
+	// The device can broadcast draws to several layers and it is enabled, for the multiview benchmark
+	bool multiviewSupported = false;
+
+	// The scene is drawn into the top left renderExtent of its targets, which stay the size of the swap chain
+	std::unique_ptr<DynamicResolution> dynamicResolution;
+	VkExtent2D renderExtent = { 0, 0 };
+
+	bool virtualTextureSupported = false;
+	std::unique_ptr<VirtualTexture> virtualTexture;
+
+	// Depth pyramid, with one view per mip for building it
+	vkutil::Image hiZImage;
+	std::vector<VkImageView> hiZMipViews;
+	VkSampler hiZSampler;
+
+	// Builds the pyramid below its first level in one dispatch. Null when the device cannot or the settings
+	// ask for a dispatch per level, the target is empty when the pyramid has more levels than it writes
+	std::unique_ptr<Downsampler> hiZDownsampler;
+	Downsampler::Target hiZDownsampleTarget;
+	// Storage image arrays can be dynamically indexed, which the single pass downsampler needs
+	bool downsamplerSupported = false;
+	// Compute shaders can swap values within subgroup quads. Takes Vulkan 1.1, which the instance is created
+	// with when the loader has it
+	bool subgroupQuadSupported = false;
+	uint32_t instanceApiVersion = VK_API_VERSION_1_0;
+	PFN_vkGetPhysicalDeviceProperties2KHR getPhysicalDeviceProperties2 = nullptr;
+
+	VkDescriptorSetLayout frameSetLayout;
+	VkDescriptorSetLayout hiZSetLayout;
+	VkDescriptorPool descriptorPool;
+	std::vector<VkDescriptorSet> frameDescriptorSets;
+	std::vector<VkDescriptorSet> hiZDescriptorSets;
+
+	VkPipelineLayout cullPipelineLayout;
+	VkPipeline cullPipeline;
+	VkPipeline clusterPipeline;
+	VkPipelineLayout hiZPipelineLayout;
+	VkPipeline hiZPipeline;
+	// Reduces a multisampled depth buffer into the first pyramid level
+	VkPipeline hiZMultisamplePipeline = VK_NULL_HANDLE;
+
+	// Timestamps for each part of the frame, one range of queries per frame in flight
+	VkQueryPool queryPool;
+	bool timestampsSupported = false;
+	bool computeTimestampsSupported = false;
+	float timestampPeriod = 1.0f;
+	std::vector<bool> frameSubmitted;
+
+	// Accumulated between two stats printouts
+	struct FrameStats {
+		uint32_t frames = 0;
+		uint64_t drawnEarly = 0;
+		uint64_t drawnLate = 0;
+		uint64_t clustersDrawn = 0;
+		uint64_t trianglesDrawn = 0;
+		double cullMs = 0.0;
+		double hiZMs = 0.0;
+		double drawMs = 0.0;
+		double frameMs = 0.0;
+		double lightBinningMs = 0.0;
+		double shadowMs = 0.0;
+		double exposureMs = 0.0;
+		double bloomMs = 0.0;
+		double tonemapMs = 0.0;
+		double particleSimMs = 0.0;
+		double particleDrawMs = 0.0;
+		uint32_t cpuFrames = 0;
+		uint64_t cpuFrustumVisible = 0;
+		double cpuRasterMs = 0.0;
+		double cpuTestMs = 0.0;
+		uint32_t inputEvents = 0;
+		double inputLatencyMs = 0.0;
+		double maxInputLatencyMs = 0.0;
+	} frameStats;
+
+	// Input to submit latency over the whole run, of frames that sampled new events
+	struct InputLatency {
+		uint64_t samples = 0;
+		double totalMs = 0.0;
+		double maxMs = 0.0;
+	} inputLatency;
+
 	// Which validation layers we want, which check for improper usage
 	// Validates what we are using
 	const std::vector<const char*> validationLayers = {
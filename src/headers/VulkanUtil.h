@@ -0,0 +1,83 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <string>
+#include <vector>
+
+// Small helpers shared by the application and the rendering subsystems built on top of it
+namespace vkutil {
+
+	// A buffer and the memory bound to it
+	// mapped is only set for host visible buffers that were created persistently mapped
+	struct Buffer {
+		VkBuffer buffer = VK_NULL_HANDLE;
+		VkDeviceMemory memory = VK_NULL_HANDLE;
+		VkDeviceSize size = 0;
+		void* mapped = nullptr;
+	};
+
+	// An image, its memory and a default view covering every mip level, or every layer of an array
+	struct Image {
+		VkImage image = VK_NULL_HANDLE;
+		VkDeviceMemory memory = VK_NULL_HANDLE;
+		VkImageView view = VK_NULL_HANDLE;
+		VkFormat format = VK_FORMAT_UNDEFINED;
+		VkExtent2D extent = { 0, 0 };
+		uint32_t mipLevels = 1;
+		uint32_t arrayLayers = 1;
+	};
+
+	// True if the device exposes the named extension
+	bool hasDeviceExtension(VkPhysicalDevice physicalDevice, const char* name);
+
+	// True if some memory type satisfies both the resource and our property requirements, lazily allocated memory for example
+	bool hasMemoryType(VkPhysicalDevice physicalDevice, uint32_t typeFilter, VkMemoryPropertyFlags properties);
+
+	// Find a memory type on the gpu that satisfies both the resource and our property requirements
+	uint32_t findMemoryType(VkPhysicalDevice physicalDevice, uint32_t typeFilter, VkMemoryPropertyFlags properties);
+
+	// Create a buffer and bind freshly allocated memory to it
+	// Host visible buffers are left persistently mapped. Buffers used by queues of several families
+	// are shared between them, rather than owned by one at a time
+	Buffer createBuffer(VkDevice device, VkPhysicalDevice physicalDevice, VkDeviceSize size,
+		VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, const std::vector<uint32_t>& sharedQueueFamilies = {});
+	void destroyBuffer(VkDevice device, Buffer& buffer);
+
+	// Create a 2D image with its memory and a view of all of its mips
+	Image createImage(VkDevice device, VkPhysicalDevice physicalDevice, VkExtent2D extent, uint32_t mipLevels,
+		VkFormat format, VkImageUsageFlags usage, VkImageAspectFlags aspect,
+		VkSampleCountFlagBits samples = VK_SAMPLE_COUNT_1_BIT, VkMemoryPropertyFlags properties = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+	// Create a 2D array image of a single mip with its memory and an array view of all of its layers
+	Image createImageArray(VkDevice device, VkPhysicalDevice physicalDevice, VkExtent2D extent, uint32_t arrayLayers,
+		VkFormat format, VkImageUsageFlags usage, VkImageAspectFlags aspect);
+	void destroyImage(VkDevice device, Image& image);
+
+	VkImageView createImageView(VkDevice device, VkImage image, VkFormat format, VkImageAspectFlags aspect,
+		uint32_t baseMipLevel = 0, uint32_t levelCount = 1);
+	// Array view of a range of an image's layers, at its first mip
+	VkImageView createLayerView(VkDevice device, VkImage image, VkFormat format, VkImageAspectFlags aspect,
+		uint32_t baseArrayLayer, uint32_t layerCount);
+
+	// Record and submit short lived command buffers, waiting for the queue to finish
+	VkCommandBuffer beginSingleTimeCommands(VkDevice device, VkCommandPool commandPool);
+	void endSingleTimeCommands(VkDevice device, VkCommandPool commandPool, VkQueue queue, VkCommandBuffer commandBuffer);
+
+	// Fill a device local buffer through a temporary staging buffer
+	void uploadBuffer(VkDevice device, VkPhysicalDevice physicalDevice, VkCommandPool commandPool, VkQueue queue,
+		const Buffer& dst, const void* data, VkDeviceSize size);
+
+	VkShaderModule createShaderModule(VkDevice device, const std::vector<char>& code);
+
+	// Build a pipeline with the given layout for a compiled compute shader
+	VkPipeline createComputePipeline(VkDevice device, const std::vector<char>& code, VkPipelineLayout layout,
+		const VkSpecializationInfo* specialization = nullptr);
+
+	// Convenience barriers. Sub resource ranges default to every mip level of a color image
+	void bufferBarrier(VkCommandBuffer commandBuffer, VkBuffer buffer,
+		VkPipelineStageFlags srcStage, VkAccessFlags srcAccess, VkPipelineStageFlags dstStage, VkAccessFlags dstAccess);
+	void imageBarrier(VkCommandBuffer commandBuffer, VkImage image, VkImageLayout oldLayout, VkImageLayout newLayout,
+		VkPipelineStageFlags srcStage, VkAccessFlags srcAccess, VkPipelineStageFlags dstStage, VkAccessFlags dstAccess,
+		VkImageAspectFlags aspect = VK_IMAGE_ASPECT_COLOR_BIT, uint32_t baseMipLevel = 0, uint32_t levelCount = VK_REMAINING_MIP_LEVELS);
+
+}
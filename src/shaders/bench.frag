@@ -0,0 +1,16 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+// Flat color. The tint is a specialization constant so that every pipeline of the pipeline scene is a distinct one
+layout(constant_id = 0) const float TINT = 0.0;
+
+layout(push_constant) uniform DrawParams {
+	vec4 offsetScale;
+	vec4 color;
+} params;
+
+layout(location = 0) out vec4 outColor;
+
+void main() {
+	outColor = vec4(fract(params.color.rgb + TINT), 1.0);
+}
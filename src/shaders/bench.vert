@@ -0,0 +1,14 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+// Synthetic geometry of the benchmark, already in clip space. Every draw moves and scales it by its push constants
+layout(push_constant) uniform DrawParams {
+	vec4 offsetScale;
+	vec4 color;
+} params;
+
+layout(location = 0) in vec2 inPosition;
+
+void main() {
+	gl_Position = vec4(inPosition * params.offsetScale.zw + params.offsetScale.xy, 0.0, 1.0);
+}
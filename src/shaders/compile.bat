@@ -2,4 +2,35 @@
 rem Windows
 %~dp0..\..\external\Vulkan\1.1.114.0\Bin\glslc.exe vulkan.vert -o vulkan_vert.spv
 %~dp0..\..\external\Vulkan\1.1.114.0\Bin\glslc.exe vulkan.frag -o vulkan_frag.spv
+%~dp0..\..\external\Vulkan\1.1.114.0\Bin\glslc.exe -DTEXTURED vulkan.frag -o vulkan_textured_frag.spv
+%~dp0..\..\external\Vulkan\1.1.114.0\Bin\glslc.exe -DVIRTUAL_TEXTURE vulkan.frag -o vulkan_virtual_frag.spv
+%~dp0..\..\external\Vulkan\1.1.114.0\Bin\glslc.exe -DTEXTURED -DVIRTUAL_TEXTURE vulkan.frag -o vulkan_textured_virtual_frag.spv
+%~dp0..\..\external\Vulkan\1.1.114.0\Bin\glslc.exe shadow.vert -o shadow_vert.spv
+%~dp0..\..\external\Vulkan\1.1.114.0\Bin\glslc.exe cull.comp -o cull_comp.spv
+%~dp0..\..\external\Vulkan\1.1.114.0\Bin\glslc.exe cluster.comp -o cluster_comp.spv
+%~dp0..\..\external\Vulkan\1.1.114.0\Bin\glslc.exe light_bin.comp -o light_bin_comp.spv
+%~dp0..\..\external\Vulkan\1.1.114.0\Bin\glslc.exe hiz.comp -o hiz_comp.spv
+%~dp0..\..\external\Vulkan\1.1.114.0\Bin\glslc.exe -DMULTISAMPLED hiz.comp -o hiz_ms_comp.spv
+%~dp0..\..\external\Vulkan\1.1.114.0\Bin\glslc.exe downsample.comp -o downsample_comp.spv
+%~dp0..\..\external\Vulkan\1.1.114.0\Bin\glslc.exe --target-env=vulkan1.1 -DSUBGROUPS downsample.comp -o downsample_subgroup_comp.spv
+%~dp0..\..\external\Vulkan\1.1.114.0\Bin\glslc.exe -DRGBA8 downsample.comp -o downsample_rgba8_comp.spv
+%~dp0..\..\external\Vulkan\1.1.114.0\Bin\glslc.exe --target-env=vulkan1.1 -DRGBA8 -DSUBGROUPS downsample.comp -o downsample_rgba8_subgroup_comp.spv
+%~dp0..\..\external\Vulkan\1.1.114.0\Bin\glslc.exe histogram.comp -o histogram_comp.spv
+%~dp0..\..\external\Vulkan\1.1.114.0\Bin\glslc.exe --target-env=vulkan1.1 -DSUBGROUPS histogram.comp -o histogram_subgroup_comp.spv
+%~dp0..\..\external\Vulkan\1.1.114.0\Bin\glslc.exe exposure.comp -o exposure_comp.spv
+%~dp0..\..\external\Vulkan\1.1.114.0\Bin\glslc.exe --target-env=vulkan1.1 -DSUBGROUPS exposure.comp -o exposure_subgroup_comp.spv
+%~dp0..\..\external\Vulkan\1.1.114.0\Bin\glslc.exe bloom.comp -o bloom_comp.spv
+%~dp0..\..\external\Vulkan\1.1.114.0\Bin\glslc.exe tonemap.comp -o tonemap_comp.spv
+%~dp0..\..\external\Vulkan\1.1.114.0\Bin\glslc.exe -DWITHOUT_FORMAT tonemap.comp -o tonemap_any_comp.spv
+%~dp0..\..\external\Vulkan\1.1.114.0\Bin\glslc.exe particle_args.comp -o particle_args_comp.spv
+%~dp0..\..\external\Vulkan\1.1.114.0\Bin\glslc.exe particle_simulate.comp -o particle_simulate_comp.spv
+%~dp0..\..\external\Vulkan\1.1.114.0\Bin\glslc.exe -DMULTISAMPLED particle_simulate.comp -o particle_simulate_ms_comp.spv
+%~dp0..\..\external\Vulkan\1.1.114.0\Bin\glslc.exe particle_emit.comp -o particle_emit_comp.spv
+%~dp0..\..\external\Vulkan\1.1.114.0\Bin\glslc.exe particle.vert -o particle_vert.spv
+%~dp0..\..\external\Vulkan\1.1.114.0\Bin\glslc.exe particle.frag -o particle_frag.spv
+%~dp0..\..\external\Vulkan\1.1.114.0\Bin\glslc.exe multiview.vert -o multiview_vert.spv
+%~dp0..\..\external\Vulkan\1.1.114.0\Bin\glslc.exe -DSINGLE_VIEW multiview.vert -o multiview_single_vert.spv
+%~dp0..\..\external\Vulkan\1.1.114.0\Bin\glslc.exe multiview.frag -o multiview_frag.spv
+%~dp0..\..\external\Vulkan\1.1.114.0\Bin\glslc.exe bench.vert -o bench_vert.spv
+%~dp0..\..\external\Vulkan\1.1.114.0\Bin\glslc.exe bench.frag -o bench_frag.spv
 pause
\ No newline at end of file
@@ -0,0 +1,129 @@
+// Buffers shared by the culling passes. Mirrors ShaderTypes.h
+
+struct MeshData {
+	int vertexOffset;
+	uint firstLod;
+	uint lodCount;
+	uint pad;
+};
+
+struct LodData {
+	uint indexCount;
+	uint firstIndex;
+	uint firstMeshlet;
+	uint meshletCount;
+	uint visibleBase;
+	float error;
+	uint pad0;
+	uint pad1;
+};
+
+struct MeshletData {
+	vec4 boundingSphere;
+	vec4 coneApex;
+	vec4 coneAxis;
+	uint firstIndex;
+	uint indexCount;
+	uint pad0;
+	uint pad1;
+};
+
+// Matches VkDrawIndexedIndirectCommand
+struct DrawCommand {
+	uint indexCount;
+	uint instanceCount;
+	uint firstIndex;
+	int vertexOffset;
+	uint firstInstance;
+};
+
+// Matches VkDispatchIndirectCommand, followed by the number of workgroups it stands for
+struct DispatchCommand {
+	uint x;
+	uint y;
+	uint z;
+	uint count;
+};
+
+layout(std430, set = 0, binding = 2) readonly buffer MeshBuffer {
+	MeshData meshes[];
+};
+
+// drawCount commands per phase, one per level of detail, instanceCount is reset to 0 before every frame
+layout(std430, set = 0, binding = 3) buffer DrawCommandBuffer {
+	DrawCommand drawCommands[];
+};
+
+// visibleStride ids per phase, split into one list per level of detail
+layout(std430, set = 0, binding = 4) writeonly buffer VisibleIdBuffer {
+	uint visibleIds[];
+};
+
+// 1 if an object passed every test last frame
+layout(std430, set = 0, binding = 5) buffer VisibilityBuffer {
+	uint visibility[];
+};
+
+layout(std430, set = 0, binding = 7) readonly buffer MeshletBuffer {
+	MeshletData meshlets[];
+};
+
+// Objects that survived object culling, objectCount per phase, with the dispatch that culls their clusters
+layout(std430, set = 0, binding = 8) buffer ClusterObjectBuffer {
+	DispatchCommand clusterDispatch[2];
+	uint clusterObjects[];
+};
+
+// clusterCapacity commands per phase, compacted to the front
+layout(std430, set = 0, binding = 9) writeonly buffer ClusterDrawBuffer {
+	DrawCommand clusterDraws[];
+};
+
+// Number of cluster commands written by each phase, then the triangles they draw
+layout(std430, set = 0, binding = 10) buffer ClusterCountBuffer {
+	uint clusterCounts[];
+};
+
+layout(std430, set = 0, binding = 11) readonly buffer LodBuffer {
+	LodData lods[];
+};
+
+// Level of detail each object was last drawn with
+layout(std430, set = 0, binding = 12) buffer LodStateBuffer {
+	uint lodState[];
+};
+
+layout(push_constant) uniform CullParams {
+	uint objectCount;
+	uint drawCount;
+	uint phase;
+	uint mode;
+	vec2 hiZSize;
+	uint hiZMipCount;
+	uint clusterCapacity;
+	uint visibleStride;
+	float lodScale;
+	float lodHysteresis;
+	uint pad;
+	vec2 renderScale;
+} params;
+
+const uint CULL_NONE = 0u;
+const uint CULL_FRUSTUM = 1u;
+const uint CULL_HIZ = 2u;
+
+// Widest indirect dispatch every device allows, longer work lists wrap into y
+const uint CLUSTER_DISPATCH_WIDTH = 65535u;
+
+float largestScale(mat4 model) {
+	return max(max(length(model[0].xyz), length(model[1].xyz)), length(model[2].xyz));
+}
+
+bool insideFrustum(vec4 sphere) {
+	for (int i = 0; i < 6; i++) {
+		if (dot(camera.frustumPlanes[i].xyz, sphere.xyz) + camera.frustumPlanes[i].w < -sphere.w) {
+			return false;
+		}
+	}
+	return true;
+}
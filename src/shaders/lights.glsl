@@ -0,0 +1,64 @@
+// Point lights and the clusters they are binned into. Mirrors ShaderTypes.h and LightClusters.h
+
+// Set the light clusters are bound to, the binning pass has nothing else bound
+#ifndef LIGHT_SET
+#define LIGHT_SET 1
+#endif
+
+// Only the binning pass writes the clusters
+#ifdef LIGHT_BINNING
+#define CLUSTER_ACCESS
+#else
+#define CLUSTER_ACCESS readonly
+#endif
+
+// Lights one cluster can hold, the rest are cut off
+const uint MAX_CLUSTER_LIGHTS = 256;
+
+struct LightData {
+	vec4 positionRadius;
+	vec4 color;
+};
+
+layout(set = LIGHT_SET, binding = 0) uniform LightGridBuffer {
+	mat4 view;
+	uvec4 gridSize;
+	vec4 sliceParams;
+	vec4 frustumParams;
+	uint indexCapacity;
+	uint bruteForce;
+	uint pad0;
+	uint pad1;
+} lightGrid;
+
+layout(std430, set = LIGHT_SET, binding = 1) readonly buffer LightBuffer {
+	LightData lights[];
+};
+
+// Offset into the index list and light count of every cluster, x fastest then y then z
+layout(std430, set = LIGHT_SET, binding = 2) CLUSTER_ACCESS buffer ClusterBuffer {
+	uint indexCount;
+	uint maxClusterLights;
+	uint overflowClusters;
+	uint pad2;
+	uvec2 clusterRanges[];
+};
+
+layout(std430, set = LIGHT_SET, binding = 3) CLUSTER_ACCESS buffer LightIndexBuffer {
+	uint lightIndices[];
+};
+
+// Slices are spaced exponentially in view depth, so clusters stay roughly cubic
+float sliceDepth(uint slice) {
+	float near = lightGrid.frustumParams.z;
+	float far = lightGrid.frustumParams.w;
+	return near * pow(far / near, float(slice) / float(lightGrid.gridSize.z));
+}
+
+uint clusterIndex(vec2 fragCoord, float viewDepth) {
+	uvec3 grid = lightGrid.gridSize.xyz;
+	uvec2 tile = min(uvec2(fragCoord / lightGrid.sliceParams.xy), grid.xy - 1u);
+	float slice = log2(max(viewDepth, lightGrid.frustumParams.z)) * lightGrid.sliceParams.z + lightGrid.sliceParams.w;
+	uint z = min(uint(max(slice, 0.0)), grid.z - 1u);
+	return (z * grid.y + tile.y) * grid.x + tile.x;
+}
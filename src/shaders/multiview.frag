@@ -0,0 +1,20 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+// Lit by the sun alone, every view costs the same wherever its camera is
+const uint MAX_VIEWS = 64;
+
+layout(set = 0, binding = 0) uniform ViewBuffer {
+	mat4 viewProj[MAX_VIEWS];
+	vec4 lightDirection;
+} views;
+
+layout(location = 0) in vec3 fragColor;
+layout(location = 1) in vec3 fragNormal;
+
+layout(location = 0) out vec4 outColor;
+
+void main() {
+	float diffuse = max(dot(normalize(fragNormal), views.lightDirection.xyz), 0.0);
+	outColor = vec4(fragColor * (0.2 + 0.8 * diffuse), 1.0);
+}
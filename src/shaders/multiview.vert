@@ -0,0 +1,58 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+#ifndef SINGLE_VIEW
+#extension GL_EXT_multiview : require
+#endif
+
+// The scene seen from one of many cameras. With multiview every draw is broadcast to the views of the render
+// pass and gl_ViewIndex picks the camera of the layer being drawn, a single view pass draws the camera at
+// viewOffset alone. Mirrors ShaderTypes.h
+#ifdef SINGLE_VIEW
+#define VIEW_INDEX 0
+#else
+#define VIEW_INDEX gl_ViewIndex
+#endif
+
+const uint MAX_VIEWS = 64;
+
+layout(set = 0, binding = 0) uniform ViewBuffer {
+	mat4 viewProj[MAX_VIEWS];
+	vec4 lightDirection;
+} views;
+
+struct ObjectData {
+	mat4 model;
+	vec4 boundingSphere;
+	vec4 color;
+	uint meshIndex;
+	uint textureIndex;
+	float uvScale;
+	uint pad0;
+};
+
+layout(std430, set = 0, binding = 1) readonly buffer ObjectBuffer {
+	ObjectData objects[];
+};
+
+// Object of every instance, in the order the draw batcher merged them
+layout(std430, set = 0, binding = 2) readonly buffer InstanceBuffer {
+	uint instanceObjects[];
+};
+
+layout(push_constant) uniform ViewParams {
+	uint viewOffset;
+} params;
+
+layout(location = 0) in vec3 inPosition;
+layout(location = 1) in vec3 inNormal;
+
+layout(location = 0) out vec3 fragColor;
+layout(location = 1) out vec3 fragNormal;
+
+void main() {
+	ObjectData object = objects[instanceObjects[gl_InstanceIndex]];
+	gl_Position = views.viewProj[params.viewOffset + VIEW_INDEX] * (object.model * vec4(inPosition, 1.0));
+
+	fragColor = object.color.rgb;
+	fragNormal = mat3(object.model) * inNormal;
+}
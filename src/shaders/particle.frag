@@ -0,0 +1,16 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+// A soft round sprite, added onto the HDR target
+layout(location = 0) in vec2 inCorner;
+layout(location = 1) in vec3 inColor;
+
+layout(location = 0) out vec4 outColor;
+
+void main() {
+	float falloff = 1.0 - dot(inCorner, inCorner);
+	if (falloff <= 0.0) {
+		discard;
+	}
+	outColor = vec4(inColor * falloff * falloff, 0.0);
+}
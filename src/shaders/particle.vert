@@ -0,0 +1,31 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+#extension GL_GOOGLE_include_directive : require
+
+// A camera facing quad per instance, one for every particle on this frame's alive list. The vertex index
+// picks the corner, there are no vertex buffers
+#include "particles.glsl"
+
+layout(location = 0) out vec2 outCorner;
+layout(location = 1) out vec3 outColor;
+
+const vec2 corners[6] = vec2[](
+	vec2(-1.0, -1.0), vec2(1.0, -1.0), vec2(1.0, 1.0),
+	vec2(-1.0, -1.0), vec2(1.0, 1.0), vec2(-1.0, 1.0));
+
+void main() {
+	Particle particle = particles[aliveList[aliveIndex(currentList(), uint(gl_InstanceIndex))]];
+	float life = clamp(particle.positionAge.w / particle.velocityLifetime.w, 0.0, 1.0);
+
+	// Sparks cool from white hot through orange to a dim red and shrink as they go
+	vec2 corner = corners[gl_VertexIndex];
+	float size = frame.cameraRight.w * (1.0 - 0.5 * life);
+	vec3 position = particle.positionAge.xyz + (frame.cameraRight.xyz * corner.x + frame.cameraUp.xyz * corner.y) * size;
+	gl_Position = frame.viewProj * vec4(position, 1.0);
+
+	vec3 hot = vec3(4.0, 3.2, 2.0);
+	vec3 warm = vec3(3.0, 0.9, 0.15);
+	vec3 cool = vec3(0.4, 0.04, 0.01);
+	outColor = life < 0.3 ? mix(hot, warm, life / 0.3) : mix(warm, cool, (life - 0.3) / 0.7);
+	outCorner = corner;
+}
@@ -0,0 +1,59 @@
+// Particles, the lists they are kept on and the per frame parameters. Mirrors ShaderTypes.h and ParticleSystem.h.
+// Every particle pass binds the same set and only touches the bindings it needs
+
+struct Particle {
+	// World space position in xyz and seconds lived in w
+	vec4 positionAge;
+	// Velocity in xyz and the seconds it lives for in w
+	vec4 velocityLifetime;
+};
+
+layout(set = 0, binding = 0) uniform ParticleFrameBuffer {
+	mat4 viewProj;
+	mat4 invViewProj;
+	vec4 cameraRight;
+	vec4 cameraUp;
+	vec4 emitter;
+	vec4 emitParams;
+	vec4 simParams;
+	vec4 depthParams;
+	uvec4 counts;
+} frame;
+
+layout(std430, set = 0, binding = 1) buffer ParticleBuffer {
+	Particle particles[];
+};
+
+// Indices of the free particles, the first deadCount of them valid
+layout(std430, set = 0, binding = 2) buffer DeadListBuffer {
+	uint deadList[];
+};
+
+// Two lists of the living particles' indices, each capacity long, one after the other
+layout(std430, set = 0, binding = 3) buffer AliveListBuffer {
+	uint aliveList[];
+};
+
+layout(std430, set = 0, binding = 4) buffer ParticleCounterBuffer {
+	int deadCount;
+	uint aliveCount[2];
+	uint emitted;
+	uvec4 simulateArgs;
+	uvec4 drawArgs;
+} counters;
+
+// Which alive list this frame fills, the other one holds what the last frame left alive
+uint currentList() {
+	return frame.counts.z;
+}
+
+uint aliveIndex(uint list, uint i) {
+	return list * frame.counts.y + i;
+}
+
+// Append a particle to this frame's alive list
+void pushAlive(uint index) {
+	uint list = currentList();
+	uint slot = atomicAdd(counters.aliveCount[list], 1u);
+	aliveList[aliveIndex(list, slot)] = index;
+}
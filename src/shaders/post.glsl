@@ -0,0 +1,48 @@
+// Bindings and parameters shared by the post processing passes. Mirrors ShaderTypes.h and PostProcess.h.
+// Every pass binds one set of the same layout and only touches the bindings it needs
+
+// Bins of the luminance histogram. Bin 0 holds the pixels too dark to count, the others split the log2 range evenly
+const uint LUMINANCE_BINS = 256;
+
+// The HDR target, or the bloom level a bloom step reads
+layout(set = 0, binding = 0) uniform sampler2D srcImage;
+// First bloom level, read by the tonemapping pass
+layout(set = 0, binding = 1) uniform sampler2D bloomImage;
+
+// Exposure carried from frame to frame, and the histogram of the frame being exposed
+layout(std430, set = 0, binding = 3) buffer ExposureBuffer {
+	float averageLuminance;
+	float exposure;
+	uint pad0;
+	uint pad1;
+	uint histogram[LUMINANCE_BINS];
+} exposureState;
+
+layout(push_constant) uniform PostParams {
+	// Log2 luminance of the first counted bin, the log2 range the bins cover, how far the exposure
+	// adapts to this frame's and the exposure compensation in stops
+	vec4 exposureParams;
+	// Bloom threshold, soft knee, intensity and upsampling filter radius in texels of the source
+	vec4 bloomParams;
+	// Saturation, contrast, and whether the output is sRGB encoded here
+	vec4 gradeParams;
+	vec4 tint;
+	// Source size in xy, destination size in zw
+	uvec4 sizes;
+	// Bloom step, see bloom.comp
+	uint mode;
+	uint pad;
+	// Fraction of the HDR target the scene was rendered into, from its top left corner
+	vec2 renderScale;
+} params;
+
+// Where a coordinate over the whole output falls in the rendered part of the HDR target, kept half a texel
+// inside it so filtering never reaches what was not rendered this frame
+vec2 renderUv(vec2 uv) {
+	vec2 halfTexel = 0.5 / vec2(textureSize(srcImage, 0));
+	return clamp(uv * params.renderScale, halfTexel, params.renderScale - halfTexel);
+}
+
+float luminance(vec3 color) {
+	return dot(color, vec3(0.2126, 0.7152, 0.0722));
+}
@@ -0,0 +1,24 @@
+// Layouts shared by the scene shaders. Mirrors ShaderTypes.h
+
+layout(set = 0, binding = 0) uniform CameraBuffer {
+	mat4 view;
+	mat4 proj;
+	mat4 viewProj;
+	vec4 frustumPlanes[6];
+	vec4 position;
+	vec4 projParams;
+} camera;
+
+struct ObjectData {
+	mat4 model;
+	vec4 boundingSphere;
+	vec4 color;
+	uint meshIndex;
+	uint textureIndex;
+	float uvScale;
+	uint pad0;
+};
+
+layout(std430, set = 0, binding = 1) readonly buffer ObjectBuffer {
+	ObjectData objects[];
+};
@@ -0,0 +1,22 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+#extension GL_KHR_vulkan_glsl : enable
+#extension GL_GOOGLE_include_directive : require
+
+#include "scene.glsl"
+
+#define SHADOW_SET 1
+#include "shadows.glsl"
+
+layout(push_constant) uniform ShadowDraw {
+	uint cascade;
+	uint idBase;
+} draw;
+
+// Only the position of the scene's vertices is read
+layout(location = 0) in vec3 inPosition;
+
+void main() {
+	ObjectData object = objects[shadowIds[draw.idBase + gl_InstanceIndex]];
+	gl_Position = shadow.viewProj[draw.cascade] * object.model * vec4(inPosition, 1.0);
+}
@@ -0,0 +1,53 @@
+// Sun shadow cascades and the atlas they are drawn into. Mirrors ShaderTypes.h and ShadowMaps.h
+
+// Set the shadow cascades are bound to, the shadow pass binds them right after the frame's set
+#ifndef SHADOW_SET
+#define SHADOW_SET 2
+#endif
+
+const uint SHADOW_CASCADES = 4;
+
+layout(set = SHADOW_SET, binding = 0) uniform ShadowBuffer {
+	mat4 viewProj[SHADOW_CASCADES];
+	vec4 texelSizes;
+	vec4 lightDirection;
+	vec4 atlasParams;
+} shadow;
+
+// Every cascade a quarter of it, compared against on lookup
+layout(set = SHADOW_SET, binding = 1) uniform sampler2DShadow shadowAtlas;
+
+// Objects each shadow draw instances, one list per cascade and level of detail
+layout(std430, set = SHADOW_SET, binding = 2) readonly buffer ShadowIdBuffer {
+	uint shadowIds[];
+};
+
+// Where a cascade sits in the atlas, in tiles
+vec2 shadowTile(uint cascade) {
+	return vec2(cascade % 2u, cascade / 2u);
+}
+
+// Fraction of the sun a world position sees, from the finest cascade covering it. Beyond the last one
+// everything is lit. The position is pushed out along the normal by about a texel against acne
+float sampleShadow(vec3 worldPos, vec3 normal) {
+	for (uint cascade = 0; cascade < SHADOW_CASCADES; cascade++) {
+		vec4 clip = shadow.viewProj[cascade] * vec4(worldPos + normal * (1.5 * shadow.texelSizes[cascade]), 1.0);
+		vec2 uv = clip.xy * 0.5 + 0.5;
+		float margin = shadow.atlasParams.y;
+		if (any(lessThan(uv, vec2(margin))) || any(greaterThan(uv, vec2(1.0 - margin))) || clip.z > 1.0) {
+			continue;
+		}
+
+		// Four bilinear comparisons over a 3x3 texel footprint
+		vec2 atlasUV = (shadowTile(cascade) + uv) * 0.5;
+		float texel = shadow.atlasParams.x;
+		float depth = max(clip.z, 0.0);
+		float lit = 0.0;
+		lit += texture(shadowAtlas, vec3(atlasUV + vec2(-0.5, -0.5) * texel, depth));
+		lit += texture(shadowAtlas, vec3(atlasUV + vec2( 0.5, -0.5) * texel, depth));
+		lit += texture(shadowAtlas, vec3(atlasUV + vec2(-0.5,  0.5) * texel, depth));
+		lit += texture(shadowAtlas, vec3(atlasUV + vec2( 0.5,  0.5) * texel, depth));
+		return lit * 0.25;
+	}
+	return 1.0;
+}
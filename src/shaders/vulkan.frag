@@ -1,11 +1,136 @@
-
 #version 450
 #extension GL_ARB_separate_shader_objects : enable
+#extension GL_GOOGLE_include_directive : require
+
+#include "lights.glsl"
+#include "shadows.glsl"
+
+#ifdef TEXTURED
+#extension GL_EXT_nonuniform_qualifier : require
+
+// Every streamed texture, each holding whichever of its mips are resident
+layout(constant_id = 0) const uint TEXTURE_COUNT = 1;
+layout(set = 0, binding = 13) uniform sampler2D textures[TEXTURE_COUNT];
+#endif
+
+#ifdef VIRTUAL_TEXTURE
+// Feedback writes must only come from fragments that passed the depth test
+layout(early_fragment_tests) in;
+
+// Objects whose texture index is this sample the virtual texture over their whole uv range instead
+const uint VIRTUAL_TEXTURE_INDEX = 0xFFFFFFFFu;
+
+// Page layout, keep in sync with VirtualTexture.h
+const uint PAGE_SIZE = 128;
+const uint PAGE_BORDER = 4;
+const uint PAGE_CONTENT = PAGE_SIZE - 2 * PAGE_BORDER;
+const uint FEEDBACK_TILE = 8;
+
+// Pages along a side of the finest level, the levels there are and pages along a side of the cache
+layout(constant_id = 1) const uint VIRTUAL_PAGES = 1;
+layout(constant_id = 2) const uint VIRTUAL_MIPS = 1;
+layout(constant_id = 3) const uint CACHE_PAGES = 1;
+
+layout(set = 3, binding = 0) uniform sampler2D pageCache;
+// Per page the cache page it is in, or its closest resident ancestor is in, and the level that page is on
+layout(set = 3, binding = 1) uniform usampler2D pageTable;
+// The page one pixel of every screen tile sampled, samplePixel picks the pixel
+layout(std430, set = 3, binding = 2) buffer FeedbackBuffer {
+	uvec2 size;
+	uvec2 samplePixel;
+	uint pages[];
+} feedback;
+
+vec3 sampleVirtualTexture(vec2 uv) {
+	uv = clamp(uv, vec2(0.0), vec2(0.99999));
+
+	// A texel per pixel is the finest level, every doubling of the texels a pixel covers a level coarser
+	vec2 texel = uv * float(VIRTUAL_PAGES * PAGE_CONTENT);
+	vec2 dx = dFdx(texel);
+	vec2 dy = dFdy(texel);
+	float lod = 0.5 * log2(max(max(dot(dx, dx), dot(dy, dy)), 1.0));
+	uint mip = min(uint(lod), VIRTUAL_MIPS - 1);
+
+	uint levelPages = VIRTUAL_PAGES >> mip;
+	uvec2 page = min(uvec2(uv * float(levelPages)), uvec2(levelPages - 1));
+
+	uvec2 pixel = uvec2(gl_FragCoord.xy);
+	if (all(equal(pixel % FEEDBACK_TILE, feedback.samplePixel))) {
+		uvec2 tile = pixel / FEEDBACK_TILE;
+		if (tile.x < feedback.size.x && tile.y < feedback.size.y) {
+			feedback.pages[tile.y * feedback.size.x + tile.x] = (mip << 24) | (page.y << 12) | page.x;
+		}
+	}
+
+	// The page, or the ancestor standing in for it, maps the same uv range onto its content
+	uvec3 entry = texelFetch(pageTable, ivec2(page), int(mip)).rgb;
+	vec2 inPage = fract(uv * float(VIRTUAL_PAGES >> entry.b));
+	vec2 cacheTexel = vec2(entry.rg * PAGE_SIZE) + float(PAGE_BORDER) + inPage * float(PAGE_CONTENT);
+	return textureLod(pageCache, cacheTexel / float(CACHE_PAGES * PAGE_SIZE), 0.0).rgb;
+}
+#endif
 
 layout(location = 0) in vec3 fragColor;
+layout(location = 1) in vec3 fragNormal;
+layout(location = 2) in vec3 fragWorldPos;
+layout(location = 3) in vec2 fragUV;
+layout(location = 4) flat in uint fragTexture;
 
 layout(location = 0) out vec4 outColor;
 
+vec3 textureColor() {
+#ifdef VIRTUAL_TEXTURE
+	if (fragTexture == VIRTUAL_TEXTURE_INDEX) {
+		return sampleVirtualTexture(fragUV);
+	}
+#endif
+#ifdef TEXTURED
+	// Instances of one draw use different textures, the index may differ within a subgroup
+	return texture(textures[nonuniformEXT(fragTexture)], fragUV).rgb;
+#else
+	return vec3(1.0);
+#endif
+}
+
+// Diffuse from a point light, fading out smoothly at its radius
+vec3 pointLight(uint index, vec3 normal) {
+	LightData light = lights[index];
+	vec3 toLight = light.positionRadius.xyz - fragWorldPos;
+	float distanceSquared = dot(toLight, toLight);
+	float falloff = clamp(1.0 - distanceSquared / (light.positionRadius.w * light.positionRadius.w), 0.0, 1.0);
+	float diffuse = max(dot(normal, toLight * inversesqrt(max(distanceSquared, 1e-4))), 0.0);
+	return light.color.rgb * (diffuse * falloff * falloff);
+}
+
+vec3 pointLights(vec3 normal) {
+	vec3 result = vec3(0.0);
+	if (lightGrid.bruteForce != 0u) {
+		for (uint i = 0; i < lightGrid.gridSize.w; i++) {
+			result += pointLight(i, normal);
+		}
+		return result;
+	}
+
+	float viewDepth = -(lightGrid.view * vec4(fragWorldPos, 1.0)).z;
+	uvec2 range = clusterRanges[clusterIndex(gl_FragCoord.xy, viewDepth)];
+	for (uint i = 0; i < range.y; i++) {
+		result += pointLight(lightIndices[range.x + i], normal);
+	}
+	return result;
+}
+
 void main() {
-	outColor = vec4(fragColor, 1.0);
-}
\ No newline at end of file
+	// Shadowed sun and sky lighting plus the point lights until we have real materials
+	vec3 normal = normalize(fragNormal);
+	vec3 lightDir = shadow.lightDirection.xyz;
+
+	float diffuse = 0.6 * max(dot(normal, lightDir), 0.0);
+	if (diffuse > 0.0) {
+		diffuse *= sampleShadow(fragWorldPos, normal);
+	}
+	float ambient = 0.2 + 0.1 * normal.y;
+
+	vec3 albedo = fragColor * textureColor();
+
+	outColor = vec4(albedo * (diffuse + ambient + pointLights(normal)), 1.0);
+}
@@ -1,23 +1,42 @@
-
 #version 450
 #extension GL_ARB_separate_shader_objects : enable
 #extension GL_KHR_vulkan_glsl : enable
+#extension GL_GOOGLE_include_directive : require
 
-layout(location = 0) out vec3 fragColor;
+#include "scene.glsl"
+
+// Object ids written by the culling pass, one list per mesh
+layout(std430, set = 0, binding = 4) readonly buffer VisibleIdBuffer {
+	uint visibleIds[];
+};
+
+// Cluster draws carry their object id in firstInstance instead
+const uint CLUSTER_DRAW = 0xFFFFFFFFu;
 
-vec2 positions[3] = vec2[] (
-	vec2(-0.5, 0.5),
-	vec2(0.5, 0.5),
-	vec2(0.0, -0.5)
-);
+layout(push_constant) uniform DrawParams {
+	uint visibleBase;
+} draw;
 
-vec3 colors[3] = vec3[] (
-	vec3(1.0, 0.0, 0.0),
-	vec3(0.0, 1.0, 0.0),
-	vec3(0.0, 0.0, 1.0)
-);
+layout(location = 0) in vec3 inPosition;
+layout(location = 1) in vec3 inNormal;
+layout(location = 2) in vec2 inUV;
+
+layout(location = 0) out vec3 fragColor;
+layout(location = 1) out vec3 fragNormal;
+layout(location = 2) out vec3 fragWorldPos;
+layout(location = 3) out vec2 fragUV;
+layout(location = 4) flat out uint fragTexture;
 
 void main() {
-	gl_Position = vec4(positions[gl_VertexIndex], 0.0, 1.0);
-	fragColor = colors[gl_VertexIndex];
-}
\ No newline at end of file
+	uint objectId = draw.visibleBase == CLUSTER_DRAW ? uint(gl_InstanceIndex) : visibleIds[draw.visibleBase + gl_InstanceIndex];
+	ObjectData object = objects[objectId];
+
+	vec4 worldPos = object.model * vec4(inPosition, 1.0);
+	gl_Position = camera.viewProj * worldPos;
+
+	fragColor = object.color.rgb;
+	fragNormal = mat3(object.model) * inNormal;
+	fragWorldPos = worldPos.xyz;
+	fragUV = inUV * object.uvScale;
+	fragTexture = object.textureIndex;
+}
@@ -0,0 +1,433 @@
+#include "AssetPack.h"
+
+#include "Lz4.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+	std::vector<char> readWholeFile(const std::string& path) {
+		std::ifstream file(path, std::ios::ate | std::ios::binary);
+		if (!file.is_open()) {
+			throw std::runtime_error("Failed to open asset: " + path);
+		}
+
+		std::vector<char> contents(static_cast<size_t>(file.tellg()));
+		file.seekg(0);
+		file.read(contents.data(), contents.size());
+		if (!file.good()) {
+			throw std::runtime_error("Failed to read asset: " + path);
+		}
+		return contents;
+	}
+
+}
+
+uint64_t AssetPack::hashName(const std::string& name) {
+	// 64 bit FNV-1a
+	uint64_t hash = 0xcbf29ce484222325ull;
+	for (char c : name) {
+		hash ^= static_cast<uint8_t>(c);
+		hash *= 0x100000001b3ull;
+	}
+	return hash;
+}
+
+void AssetPack::write(const std::string& path, const std::string& root, const std::vector<std::string>& names, ThreadPool& pool) {
+	struct Source {
+		std::string name;
+		uint64_t hash;
+		std::vector<char> contents;
+	};
+
+	std::vector<Source> sources;
+	for (const auto& name : names) {
+		sources.push_back({ name, hashName(name), readWholeFile(root + name) });
+	}
+
+	// Looked up by binary search over the hashes, names settle collisions
+	std::sort(sources.begin(), sources.end(), [](const Source& a, const Source& b) {
+		return a.hash != b.hash ? a.hash < b.hash : a.name < b.name;
+	});
+	for (size_t i = 1; i < sources.size(); i++) {
+		if (sources[i].name == sources[i - 1].name) {
+			throw std::runtime_error("Asset packed twice: " + sources[i].name);
+		}
+	}
+
+	Header header = {};
+	header.magic		= MAGIC;
+	header.version		= VERSION;
+	header.chunkSize	= CHUNK_SIZE;
+	header.entryCount	= static_cast<uint32_t>(sources.size());
+
+	std::vector<Entry> entries(sources.size());
+	std::string nameData;
+	for (size_t i = 0; i < sources.size(); i++) {
+		entries[i].hash			= sources[i].hash;
+		entries[i].size			= sources[i].contents.size();
+		entries[i].firstChunk	= header.chunkCount;
+		entries[i].chunkCount	= static_cast<uint32_t>((sources[i].contents.size() + CHUNK_SIZE - 1) / CHUNK_SIZE);
+		entries[i].nameOffset	= static_cast<uint32_t>(nameData.size());
+		entries[i].nameLength	= static_cast<uint32_t>(sources[i].name.size());
+		header.chunkCount += entries[i].chunkCount;
+		nameData += sources[i].name;
+	}
+	header.namesSize = static_cast<uint32_t>(nameData.size());
+
+	// Every chunk compresses on its own, which is also what lets them decompress in parallel
+	std::vector<Chunk> chunks(header.chunkCount);
+	std::vector<std::vector<uint8_t>> chunkData(header.chunkCount);
+	std::vector<std::pair<uint32_t, uint32_t>> chunkSources;
+	for (uint32_t i = 0; i < entries.size(); i++) {
+		for (uint32_t chunk = 0; chunk < entries[i].chunkCount; chunk++) {
+			chunkSources.emplace_back(i, chunk);
+		}
+	}
+
+	pool.parallelFor(header.chunkCount, 1, [&](uint32_t begin, uint32_t end) {
+		for (uint32_t index = begin; index < end; index++) {
+			const std::vector<char>& contents = sources[chunkSources[index].first].contents;
+			size_t start = static_cast<size_t>(chunkSources[index].second) * CHUNK_SIZE;
+			size_t size = std::min<size_t>(CHUNK_SIZE, contents.size() - start);
+
+			std::vector<uint8_t>& compressed = chunkData[index];
+			compressed.resize(lz4::compressBound(size));
+			compressed.resize(lz4::compress(reinterpret_cast<const uint8_t*>(&contents[start]), size, compressed.data()));
+
+			// Stored as is when compression does not pay off, reading it is then a copy
+			if (compressed.size() >= size) {
+				compressed.assign(contents.begin() + start, contents.begin() + start + size);
+			}
+			chunks[index].size = static_cast<uint32_t>(size);
+			chunks[index].compressedSize = static_cast<uint32_t>(compressed.size());
+		}
+	});
+
+	uint64_t offset = sizeof(Header) + sizeof(Entry) * entries.size() + sizeof(Chunk) * chunks.size() + nameData.size();
+	for (uint32_t i = 0; i < header.chunkCount; i++) {
+		chunks[i].offset = offset;
+		offset += chunkData[i].size();
+	}
+
+	std::ofstream file(path, std::ios::binary | std::ios::trunc);
+	if (!file.is_open()) {
+		throw std::runtime_error("Failed to create asset pack: " + path);
+	}
+
+	file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	file.write(reinterpret_cast<const char*>(entries.data()), sizeof(Entry) * entries.size());
+	file.write(reinterpret_cast<const char*>(chunks.data()), sizeof(Chunk) * chunks.size());
+	file.write(nameData.data(), nameData.size());
+	for (const auto& chunk : chunkData) {
+		file.write(reinterpret_cast<const char*>(chunk.data()), chunk.size());
+	}
+
+	if (!file.good()) {
+		throw std::runtime_error("Failed to write asset pack: " + path);
+	}
+}
+
+AssetPack::AssetPack(const std::string& packPath) :
+	path(packPath) {
+
+#ifdef _WIN32
+	fileHandle = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (fileHandle == INVALID_HANDLE_VALUE) {
+		fileHandle = nullptr;
+		throw std::runtime_error("Failed to open asset pack: " + path);
+	}
+
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(fileHandle, &size)) {
+		unmap();
+		throw std::runtime_error("Failed to read the size of asset pack: " + path);
+	}
+	fileSize = static_cast<uint64_t>(size.QuadPart);
+
+	mappingHandle = fileSize > 0 ? CreateFileMappingA(fileHandle, nullptr, PAGE_READONLY, 0, 0, nullptr) : nullptr;
+	data = mappingHandle != nullptr ? static_cast<const uint8_t*>(MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0)) : nullptr;
+	if (data == nullptr) {
+		unmap();
+		throw std::runtime_error("Failed to map asset pack: " + path);
+	}
+#else
+	int descriptor = open(path.c_str(), O_RDONLY);
+	if (descriptor < 0) {
+		throw std::runtime_error("Failed to open asset pack: " + path);
+	}
+
+	struct stat info;
+	if (fstat(descriptor, &info) != 0) {
+		close(descriptor);
+		throw std::runtime_error("Failed to read the size of asset pack: " + path);
+	}
+	fileSize = static_cast<uint64_t>(info.st_size);
+
+	// The mapping keeps the file alive on its own
+	void* mapped = fileSize > 0 ? mmap(nullptr, fileSize, PROT_READ, MAP_PRIVATE, descriptor, 0) : MAP_FAILED;
+	close(descriptor);
+	if (mapped == MAP_FAILED) {
+		throw std::runtime_error("Failed to map asset pack: " + path);
+	}
+	data = static_cast<const uint8_t*>(mapped);
+#endif
+
+	try {
+		validate();
+	} catch (...) {
+		unmap();
+		throw;
+	}
+}
+
+AssetPack::~AssetPack() {
+	unmap();
+}
+
+void AssetPack::unmap() {
+#ifdef _WIN32
+	if (data != nullptr) {
+		UnmapViewOfFile(data);
+	}
+	if (mappingHandle != nullptr) {
+		CloseHandle(mappingHandle);
+	}
+	if (fileHandle != nullptr) {
+		CloseHandle(fileHandle);
+	}
+	mappingHandle = nullptr;
+	fileHandle = nullptr;
+#else
+	if (data != nullptr) {
+		munmap(const_cast<uint8_t*>(data), fileSize);
+	}
+#endif
+	data = nullptr;
+}
+
+void AssetPack::validate() {
+	if (fileSize < sizeof(Header)) {
+		throw std::runtime_error("Not an asset pack: " + path);
+	}
+
+	memcpy(&header, data, sizeof(Header));
+	if (header.magic != MAGIC) {
+		throw std::runtime_error("Not an asset pack: " + path);
+	}
+	if (header.version != VERSION) {
+		throw std::runtime_error("Asset pack has version " + std::to_string(header.version) + ", expected " +
+			std::to_string(VERSION) + ": " + path);
+	}
+
+	uint64_t tablesEnd = sizeof(Header) + sizeof(Entry) * static_cast<uint64_t>(header.entryCount) +
+		sizeof(Chunk) * static_cast<uint64_t>(header.chunkCount) + header.namesSize;
+	if (header.chunkSize == 0 || tablesEnd > fileSize) {
+		throw std::runtime_error("Asset pack is truncated: " + path);
+	}
+
+	// Every table is read in place, sizeof(Header) keeps them aligned
+	entries = reinterpret_cast<const Entry*>(data + sizeof(Header));
+	chunks = reinterpret_cast<const Chunk*>(entries + header.entryCount);
+	names = reinterpret_cast<const char*>(chunks + header.chunkCount);
+
+	for (uint32_t i = 0; i < header.entryCount; i++) {
+		const Entry& entry = entries[i];
+		bool valid = (i == 0 || entries[i - 1].hash <= entry.hash) &&
+			static_cast<uint64_t>(entry.nameOffset) + entry.nameLength <= header.namesSize &&
+			static_cast<uint64_t>(entry.firstChunk) + entry.chunkCount <= header.chunkCount &&
+			entry.chunkCount == (entry.size + header.chunkSize - 1) / header.chunkSize &&
+			hashName(std::string(names + entry.nameOffset, entry.nameLength)) == entry.hash;
+
+		// Reads find a chunk by dividing by the chunk size, so only the last may be smaller
+		for (uint32_t c = 0; valid && c < entry.chunkCount; c++) {
+			const Chunk& chunk = chunks[entry.firstChunk + c];
+			uint64_t expected = std::min<uint64_t>(header.chunkSize, entry.size - static_cast<uint64_t>(c) * header.chunkSize);
+			valid = chunk.size == expected && chunk.compressedSize <= chunk.size && chunk.offset >= tablesEnd &&
+				chunk.offset + chunk.compressedSize <= fileSize;
+		}
+
+		if (!valid) {
+			throw std::runtime_error("Asset pack has an invalid table of contents: " + path);
+		}
+	}
+}
+
+const AssetPack::Entry* AssetPack::find(const std::string& name) const {
+	uint64_t hash = hashName(name);
+	const Entry* end = entries + header.entryCount;
+	const Entry* entry = std::lower_bound(entries, end, hash, [](const Entry& e, uint64_t value) { return e.hash < value; });
+
+	for (; entry != end && entry->hash == hash; entry++) {
+		if (name.compare(0, std::string::npos, names + entry->nameOffset, entry->nameLength) == 0) {
+			return entry;
+		}
+	}
+	return nullptr;
+}
+
+uint64_t AssetPack::getSize(const std::string& name) const {
+	const Entry* entry = find(name);
+	if (entry == nullptr) {
+		throw std::runtime_error("Asset pack has no " + name + ": " + path);
+	}
+	return entry->size;
+}
+
+uint64_t AssetPack::getUncompressedSize() const {
+	uint64_t total = 0;
+	for (uint32_t i = 0; i < header.entryCount; i++) {
+		total += entries[i].size;
+	}
+	return total;
+}
+
+std::vector<std::pair<std::string, uint64_t>> AssetPack::getAssets() const {
+	std::vector<std::pair<std::string, uint64_t>> assets;
+	assets.reserve(header.entryCount);
+	for (uint32_t i = 0; i < header.entryCount; i++) {
+		assets.emplace_back(std::string(names + entries[i].nameOffset, entries[i].nameLength), entries[i].size);
+	}
+	return assets;
+}
+
+void AssetPack::read(const std::string& name, uint64_t offset, uint64_t size, void* dst, ThreadPool* pool) const {
+	const Entry* entry = find(name);
+	if (entry == nullptr) {
+		throw std::runtime_error("Asset pack has no " + name + ": " + path);
+	}
+	if (offset > entry->size || size > entry->size - offset) {
+		throw std::runtime_error("Read past the end of " + name + " in " + path);
+	}
+	if (size == 0) {
+		return;
+	}
+
+	uint32_t firstChunk = static_cast<uint32_t>(offset / header.chunkSize);
+	uint32_t chunkCount = static_cast<uint32_t>((offset + size - 1) / header.chunkSize) - firstChunk + 1;
+	uint8_t* out = static_cast<uint8_t*>(dst);
+
+	// Failures are collected rather than thrown from inside the pool
+	std::atomic<bool> corrupt(false);
+	auto decodeChunks = [&](uint32_t begin, uint32_t end) {
+		std::vector<uint8_t> scratch;
+		for (uint32_t i = begin; i < end; i++) {
+			const Chunk& chunk = chunks[entry->firstChunk + firstChunk + i];
+			uint64_t chunkStart = static_cast<uint64_t>(firstChunk + i) * header.chunkSize;
+			uint64_t copyBegin = std::max(offset, chunkStart);
+			uint64_t copyEnd = std::min(offset + size, chunkStart + chunk.size);
+			uint8_t* target = out + (copyBegin - offset);
+			const uint8_t* source = data + chunk.offset;
+
+			if (chunk.compressedSize == chunk.size) {
+				memcpy(target, source + (copyBegin - chunkStart), static_cast<size_t>(copyEnd - copyBegin));
+				continue;
+			}
+
+			try {
+				// Whole chunks decode straight into the destination, partial ones through scratch memory
+				if (copyBegin == chunkStart && copyEnd == chunkStart + chunk.size) {
+					lz4::decompress(source, chunk.compressedSize, target, chunk.size);
+				} else {
+					scratch.resize(chunk.size);
+					lz4::decompress(source, chunk.compressedSize, scratch.data(), chunk.size);
+					memcpy(target, scratch.data() + (copyBegin - chunkStart), static_cast<size_t>(copyEnd - copyBegin));
+				}
+			} catch (const std::exception&) {
+				corrupt = true;
+			}
+		}
+	};
+
+	if (pool != nullptr && chunkCount > 1) {
+		pool->parallelFor(chunkCount, 1, decodeChunks);
+	} else {
+		decodeChunks(0, chunkCount);
+	}
+
+	if (corrupt) {
+		throw std::runtime_error("Asset pack has a corrupt chunk in " + name + ": " + path);
+	}
+}
+
+AssetLoader::AssetLoader(const std::string& assetRoot, ThreadPool& pool) :
+	root(assetRoot),
+	threadPool(pool) {
+}
+
+bool AssetLoader::openPack(const std::string& path) {
+	stale.clear();
+	try {
+		pack = std::make_unique<AssetPack>(path);
+		packError.clear();
+	} catch (const std::exception& e) {
+		pack.reset();
+		packError = e.what();
+		return false;
+	}
+
+	// Once here rather than on every read, the pack is written from the loose files so they are never newer
+	// unless they changed since
+	std::error_code error;
+	std::filesystem::file_time_type packTime = std::filesystem::last_write_time(path, error);
+	for (const auto& asset : pack->getAssets()) {
+		std::filesystem::path loose = root + asset.first;
+		std::filesystem::file_time_type looseTime = std::filesystem::last_write_time(loose, error);
+		if (error) {
+			continue;
+		}
+		uint64_t looseSize = std::filesystem::file_size(loose, error);
+		if (!error && (looseTime > packTime || looseSize != asset.second)) {
+			stale.insert(asset.first);
+		}
+	}
+	return true;
+}
+
+bool AssetLoader::inPack(const std::string& name) const {
+	return pack && pack->contains(name) && stale.count(name) == 0;
+}
+
+std::vector<char> AssetLoader::load(const std::string& name) const {
+	if (inPack(name)) {
+		std::vector<char> contents(static_cast<size_t>(pack->getSize(name)));
+		pack->read(name, 0, contents.size(), contents.data(), &threadPool);
+		return contents;
+	}
+
+	return readWholeFile(root + name);
+}
+
+void AssetLoader::read(const std::string& name, uint64_t offset, uint64_t size, void* dst) const {
+	if (inPack(name)) {
+		pack->read(name, offset, size, dst);
+		return;
+	}
+
+	std::ifstream file(root + name, std::ios::binary);
+	file.seekg(static_cast<std::streamoff>(offset));
+	file.read(static_cast<char*>(dst), static_cast<std::streamsize>(size));
+	if (!file.good()) {
+		throw std::runtime_error("Failed to read asset: " + root + name);
+	}
+}
+
+bool AssetLoader::exists(const std::string& name) const {
+	return (pack && pack->contains(name)) || std::filesystem::is_regular_file(root + name);
+}
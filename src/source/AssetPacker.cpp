@@ -0,0 +1,160 @@
+#include "AssetPacker.h"
+
+#include "AssetPack.h"
+#include "Configuration.h"
+#include "TextureBaker.h"
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <stdexcept>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+	const uint32_t WARM_RUNS = 5;
+
+	// Names relative to root of the files directly in directory with the given extension
+	void collect(const std::string& root, const std::string& directory, const std::string& extension, std::vector<std::string>& names) {
+		if (!std::filesystem::is_directory(root + directory)) {
+			return;
+		}
+		for (const auto& entry : std::filesystem::directory_iterator(root + directory)) {
+			if (entry.is_regular_file() && entry.path().extension() == extension) {
+				names.push_back(directory + entry.path().filename().string());
+			}
+		}
+	}
+
+	// Evict a file from the operating system's cache so the next read comes from the disk. False where that
+	// cannot be done without privileges
+	bool dropFromCache(const std::string& path) {
+#ifdef _WIN32
+		(void)path;
+		return false;
+#else
+		int fd = open(path.c_str(), O_RDONLY);
+		if (fd < 0) {
+			return false;
+		}
+		// Dirty pages are not dropped, the pack was only just written
+		fdatasync(fd);
+		bool dropped = posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED) == 0;
+		close(fd);
+		return dropped;
+#endif
+	}
+
+	double timeMs(const std::function<void()>& body) {
+		auto start = std::chrono::high_resolution_clock::now();
+		body();
+		return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+	}
+
+	double megabytesPerSecond(uint64_t bytes, double ms) {
+		return ms > 0.0 ? bytes / (1024.0 * 1024.0) / (ms / 1000.0) : 0.0;
+	}
+
+}
+
+bool AssetPacker::run() {
+	const std::string root = VK_ROOT_DIR;
+	const std::string packPath = root + AssetLoader::PACK_NAME;
+
+	std::vector<std::string> names;
+	collect(root, "src/shaders/", ".spv", names);
+	collect(root, TextureBaker::ASSET_DIRECTORY, ".btex", names);
+	std::sort(names.begin(), names.end());
+	if (names.empty()) {
+		std::cout << "Nothing to pack, compile the shaders and bake the textures first" << std::endl;
+		return false;
+	}
+
+	ThreadPool pool;
+	std::filesystem::create_directories(std::filesystem::path(packPath).parent_path());
+	double packMs = timeMs([&]() { AssetPack::write(packPath, root, names, pool); });
+
+	AssetLoader packed(root, pool);
+	if (!packed.openPack(packPath)) {
+		std::cout << "Asset pack FAILED to open: " << packed.getPackError() << std::endl;
+		return false;
+	}
+	const AssetPack& pack = *packed.getPack();
+	uint64_t totalBytes = pack.getUncompressedSize();
+
+	std::cout << std::fixed << std::setprecision(1);
+	std::cout << "Packed " << names.size() << " assets into " << packPath << " in " << packMs << " ms: "
+		<< totalBytes / (1024.0 * 1024.0) << " MB -> " << pack.getFileSize() / (1024.0 * 1024.0) << " MB ("
+		<< std::setprecision(2) << static_cast<double>(pack.getFileSize()) / totalBytes << "x)" << std::setprecision(1) << std::endl;
+
+	// Every asset must come back out of the pack exactly as it went in
+	AssetLoader loose(root, pool);
+	for (const auto& name : names) {
+		if (packed.load(name) != loose.load(name)) {
+			std::cout << "Asset pack FAILED, " << name << " does not match its file" << std::endl;
+			return false;
+		}
+	}
+
+	// Both ways of loading write every asset into one buffer, standing in for staging memory
+	std::vector<uint64_t> offsets(names.size());
+	uint64_t offset = 0;
+	for (size_t i = 0; i < names.size(); i++) {
+		offsets[i] = offset;
+		offset += pack.getSize(names[i]);
+	}
+	std::vector<char> staging(static_cast<size_t>(offset));
+
+	auto loadLoose = [&]() {
+		for (size_t i = 0; i < names.size(); i++) {
+			std::ifstream file(root + names[i], std::ios::binary);
+			file.read(staging.data() + offsets[i], static_cast<std::streamsize>(pack.getSize(names[i])));
+			if (!file.good()) {
+				throw std::runtime_error("Failed to read asset: " + root + names[i]);
+			}
+		}
+	};
+	// Mapping is part of the cost, so the pack is opened anew every time
+	auto loadPacked = [&]() {
+		AssetPack timed(packPath);
+		for (size_t i = 0; i < names.size(); i++) {
+			timed.read(names[i], 0, timed.getSize(names[i]), staging.data() + offsets[i], &pool);
+		}
+	};
+	auto dropAll = [&]() {
+		bool dropped = dropFromCache(packPath);
+		for (const auto& name : names) {
+			dropped = dropFromCache(root + name) && dropped;
+		}
+		return dropped;
+	};
+
+	bool cold = dropAll();
+	double coldLooseMs = timeMs(loadLoose);
+	dropAll();
+	double coldPackedMs = timeMs(loadPacked);
+
+	double warmLooseMs = 0.0;
+	double warmPackedMs = 0.0;
+	for (uint32_t run = 0; run < WARM_RUNS; run++) {
+		warmLooseMs += timeMs(loadLoose) / WARM_RUNS;
+		warmPackedMs += timeMs(loadPacked) / WARM_RUNS;
+	}
+
+	std::cout << "Loading every asset on " << pool.getThreadCount() + 1 << " threads:" << std::endl;
+	std::cout << "  " << (cold ? "cold" : "cold (file cache could not be dropped)") << ": loose " << coldLooseMs << " ms ("
+		<< megabytesPerSecond(totalBytes, coldLooseMs) << " MB/s), pack " << coldPackedMs << " ms ("
+		<< megabytesPerSecond(totalBytes, coldPackedMs) << " MB/s)" << std::endl;
+	std::cout << "  warm: loose " << warmLooseMs << " ms (" << megabytesPerSecond(totalBytes, warmLooseMs) << " MB/s), pack "
+		<< warmPackedMs << " ms (" << megabytesPerSecond(totalBytes, warmPackedMs) << " MB/s)" << std::endl;
+	return true;
+}
@@ -0,0 +1,138 @@
+#include "BakedTexture.h"
+
+#include <algorithm>
+#include <fstream>
+#include <stdexcept>
+
+void BakedTexture::save(const std::string& path, VkFormat format, uint32_t width, uint32_t height, const std::vector<std::vector<uint8_t>>& levels) {
+	Header header = {};
+	header.magic	= MAGIC;
+	header.version	= VERSION;
+	header.format	= static_cast<uint32_t>(format);
+	header.width	= width;
+	header.height	= height;
+	header.mipCount = static_cast<uint32_t>(levels.size());
+
+	std::vector<Level> table(levels.size());
+	uint64_t offset = sizeof(Header) + sizeof(Level) * levels.size();
+	for (size_t level = 0; level < levels.size(); level++) {
+		table[level].offset = offset;
+		table[level].size = levels[level].size();
+		offset += levels[level].size();
+	}
+
+	std::ofstream file(path, std::ios::binary | std::ios::trunc);
+	if (!file.is_open()) {
+		throw std::runtime_error("Failed to create baked texture: " + path);
+	}
+
+	file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	file.write(reinterpret_cast<const char*>(table.data()), sizeof(Level) * table.size());
+	for (const auto& level : levels) {
+		file.write(reinterpret_cast<const char*>(level.data()), level.size());
+	}
+
+	if (!file.good()) {
+		throw std::runtime_error("Failed to write baked texture: " + path);
+	}
+}
+
+BakedTexture BakedTexture::open(const AssetLoader& assets, const std::string& name) {
+	if (!assets.exists(name)) {
+		throw std::runtime_error("Failed to open baked texture: " + name);
+	}
+
+	Header header = {};
+	assets.read(name, 0, sizeof(header), &header);
+	if (header.magic != MAGIC) {
+		throw std::runtime_error("Not a baked texture: " + name);
+	}
+	if (header.version != VERSION) {
+		throw std::runtime_error("Baked texture has version " + std::to_string(header.version) + ", expected " +
+			std::to_string(VERSION) + ": " + name);
+	}
+	if (header.mipCount == 0 || header.mipCount > 32) {
+		throw std::runtime_error("Baked texture has an invalid level table: " + name);
+	}
+
+	BakedTexture texture;
+	texture.assets = &assets;
+	texture.name = name;
+	texture.format = static_cast<VkFormat>(header.format);
+	texture.width = header.width;
+	texture.height = header.height;
+	texture.levels.resize(header.mipCount);
+	assets.read(name, sizeof(header), sizeof(Level) * texture.levels.size(), texture.levels.data());
+
+	// Levels must be the size their format says and follow each other, loadLevels relies on both
+	for (uint32_t level = 0; level < header.mipCount; level++) {
+		uint32_t levelWidth = std::max(header.width >> level, 1u);
+		uint32_t levelHeight = std::max(header.height >> level, 1u);
+		bool contiguous = level == 0 || texture.levels[level].offset == texture.levels[level - 1].offset + texture.levels[level - 1].size;
+		if (!contiguous || texture.levels[level].size != levelBytes(texture.format, levelWidth, levelHeight)) {
+			throw std::runtime_error("Baked texture has an invalid level table: " + name);
+		}
+	}
+
+	return texture;
+}
+
+std::vector<uint8_t> BakedTexture::loadLevels(uint32_t firstMip) const {
+	std::vector<uint8_t> data(static_cast<size_t>(levelsBytes(firstMip)));
+	loadLevels(firstMip, data.data());
+	return data;
+}
+
+void BakedTexture::loadLevels(uint32_t firstMip, void* dst) const {
+	uint64_t bytes = levelsBytes(firstMip);
+	assets->read(name, levels[firstMip].offset, bytes, dst);
+}
+
+uint64_t BakedTexture::levelsBytes(uint32_t firstMip) const {
+	if (firstMip >= levels.size()) {
+		throw std::runtime_error("Baked texture has no mip " + std::to_string(firstMip) + ": " + name);
+	}
+	return levels.back().offset + levels.back().size - levels[firstMip].offset;
+}
+
+uint64_t BakedTexture::levelBytes(VkFormat format, uint32_t width, uint32_t height) {
+	uint64_t blocks = static_cast<uint64_t>((width + 3) / 4) * ((height + 3) / 4);
+
+	switch (format) {
+	case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+	case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+	case VK_FORMAT_BC1_RGBA_UNORM_BLOCK:
+	case VK_FORMAT_BC1_RGBA_SRGB_BLOCK:
+	case VK_FORMAT_BC4_UNORM_BLOCK:
+		return blocks * 8;
+	case VK_FORMAT_BC3_UNORM_BLOCK:
+	case VK_FORMAT_BC3_SRGB_BLOCK:
+	case VK_FORMAT_BC5_UNORM_BLOCK:
+	case VK_FORMAT_BC7_UNORM_BLOCK:
+	case VK_FORMAT_BC7_SRGB_BLOCK:
+		return blocks * 16;
+	case VK_FORMAT_R8G8B8A8_UNORM:
+	case VK_FORMAT_R8G8B8A8_SRGB:
+		return static_cast<uint64_t>(width) * height * 4;
+	default:
+		throw std::runtime_error("Unsupported baked texture format: " + std::to_string(static_cast<uint32_t>(format)));
+	}
+}
+
+const char* BakedTexture::formatName(VkFormat format) {
+	switch (format) {
+	case VK_FORMAT_BC1_RGB_UNORM_BLOCK:		return "bc1";
+	case VK_FORMAT_BC1_RGB_SRGB_BLOCK:		return "bc1 srgb";
+	case VK_FORMAT_BC1_RGBA_UNORM_BLOCK:	return "bc1 rgba";
+	case VK_FORMAT_BC1_RGBA_SRGB_BLOCK:		return "bc1 rgba srgb";
+	case VK_FORMAT_BC3_UNORM_BLOCK:			return "bc3";
+	case VK_FORMAT_BC3_SRGB_BLOCK:			return "bc3 srgb";
+	case VK_FORMAT_BC4_UNORM_BLOCK:			return "bc4";
+	case VK_FORMAT_BC5_UNORM_BLOCK:			return "bc5";
+	case VK_FORMAT_BC7_UNORM_BLOCK:			return "bc7";
+	case VK_FORMAT_BC7_SRGB_BLOCK:			return "bc7 srgb";
+	case VK_FORMAT_R8G8B8A8_UNORM:			return "rgba8";
+	case VK_FORMAT_R8G8B8A8_SRGB:			return "rgba8 srgb";
+	default:								return "unknown";
+	}
+}
@@ -0,0 +1,157 @@
+
+// Entry point of vulkanBench. Runs the synthetic scenes headlessly, prints their timings as CSV on stdout and
+// fails when they are slower than the baseline stored for the device, or when there is none to check against
+
+#include "Configuration.h"
+#include "SyntheticBench.h"
+
+#include <cctype>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+namespace {
+
+	struct BenchSettings {
+		SyntheticBench::Config bench;
+		// Where the baseline is read from, or written to with updateBaseline. Empty picks one per device
+		std::string baselinePath;
+		bool updateBaseline = false;
+		// Only print the timings, a missing baseline fails otherwise so a gate cannot pass by having nothing to check
+		bool noBaseline = false;
+		// Fraction a scene may be slower than its baseline by before it fails
+		double tolerance = 0.15;
+	};
+
+	uint32_t parseCount(const std::string& name, const std::string& value) {
+		uint32_t count = static_cast<uint32_t>(std::strtoul(value.c_str(), nullptr, 10));
+		if (count == 0) {
+			throw std::runtime_error("Expected a positive count for " + name + ", got: " + value);
+		}
+		return count;
+	}
+
+	// Arguments are of the form --name=value, as the application's
+	BenchSettings parse(int argc, char** argv) {
+		BenchSettings result;
+
+		for (int i = 1; i < argc; i++) {
+			std::string arg = argv[i];
+			size_t split = arg.find('=');
+			std::string name = arg.substr(0, split);
+			std::string value = split == std::string::npos ? "" : arg.substr(split + 1);
+
+			if (name == "--scenes") {
+				// Comma separated
+				size_t start = 0;
+				while (start <= value.size()) {
+					size_t end = value.find(',', start);
+					end = end == std::string::npos ? value.size() : end;
+					if (end > start) {
+						result.bench.scenes.push_back(value.substr(start, end - start));
+					}
+					start = end + 1;
+				}
+			} else if (name == "--frames") {
+				result.bench.frames = parseCount(name, value);
+			} else if (name == "--warmup") {
+				result.bench.warmupFrames = static_cast<uint32_t>(std::strtoul(value.c_str(), nullptr, 10));
+			} else if (name == "--size") {
+				size_t x = value.find('x');
+				result.bench.extent.width = static_cast<uint32_t>(std::strtoul(value.substr(0, x).c_str(), nullptr, 10));
+				result.bench.extent.height = x == std::string::npos ? 0 : static_cast<uint32_t>(std::strtoul(value.substr(x + 1).c_str(), nullptr, 10));
+				if (result.bench.extent.width == 0 || result.bench.extent.height == 0) {
+					throw std::runtime_error("Expected --size=<width>x<height>, got: " + value);
+				}
+			} else if (name == "--triangles") {
+				result.bench.triangles = parseCount(name, value);
+			} else if (name == "--draws") {
+				result.bench.draws = parseCount(name, value);
+			} else if (name == "--pipelines") {
+				result.bench.pipelines = parseCount(name, value);
+			} else if (name == "--resize-steps") {
+				result.bench.resizeSteps = parseCount(name, value);
+			} else if (name == "--upload-mb") {
+				result.bench.uploadMB = parseCount(name, value);
+			} else if (name == "--device") {
+				result.bench.deviceName = value;
+			} else if (name == "--baseline") {
+				result.baselinePath = value;
+			} else if (name == "--update-baseline") {
+				result.updateBaseline = true;
+			} else if (name == "--no-baseline") {
+				result.noBaseline = true;
+			} else if (name == "--tolerance") {
+				result.tolerance = std::strtod(value.c_str(), nullptr);
+				if (!(result.tolerance >= 0.0)) {
+					throw std::runtime_error("Expected a tolerance of 0 or more, got: " + value);
+				}
+			} else {
+				throw std::runtime_error("Unknown argument: " + arg);
+			}
+		}
+
+		return result;
+	}
+
+	// Timings only compare on the device they were taken on, so each gets a baseline of its own
+	std::string defaultBaselinePath(const std::string& deviceName) {
+		std::string file;
+		for (char c : deviceName) {
+			file += std::isalnum(static_cast<unsigned char>(c)) ? static_cast<char>(std::tolower(static_cast<unsigned char>(c))) : '_';
+		}
+		return std::string(VK_ROOT_DIR) + "bench/baselines/" + file + ".csv";
+	}
+
+}
+
+int main(int argc, char** argv) {
+	try {
+		BenchSettings benchSettings = parse(argc, argv);
+
+		SyntheticBench bench(benchSettings.bench);
+		std::cerr << "Device: " << bench.getDeviceName() << ", " << benchSettings.bench.frames << " frames of "
+			<< benchSettings.bench.extent.width << "x" << benchSettings.bench.extent.height << " per scene" << std::endl;
+
+		std::vector<SyntheticBench::Result> results = bench.run();
+		SyntheticBench::writeCsv(std::cout, results);
+
+		if (benchSettings.noBaseline && !benchSettings.updateBaseline) {
+			return EXIT_SUCCESS;
+		}
+
+		std::string baselinePath = benchSettings.baselinePath.empty() ? defaultBaselinePath(bench.getDeviceName()) : benchSettings.baselinePath;
+		if (benchSettings.updateBaseline) {
+			std::filesystem::path parent = std::filesystem::path(baselinePath).parent_path();
+			if (!parent.empty()) {
+				std::filesystem::create_directories(parent);
+			}
+			std::ofstream file(baselinePath, std::ios::trunc);
+			SyntheticBench::writeCsv(file, results);
+			if (!file) {
+				throw std::runtime_error("Failed to write baseline " + baselinePath);
+			}
+			std::cerr << "Baseline written to " << baselinePath << std::endl;
+			return EXIT_SUCCESS;
+		}
+
+		std::vector<SyntheticBench::Result> baseline = SyntheticBench::readCsv(baselinePath);
+		if (baseline.empty()) {
+			std::cerr << "No baseline at " << baselinePath << ", run with --update-baseline to store these results as one, or with "
+				"--no-baseline to only print them" << std::endl;
+			return EXIT_FAILURE;
+		}
+		if (!SyntheticBench::checkRegressions(results, baseline, benchSettings.tolerance, std::cerr)) {
+			std::cerr << "Slower than the baseline at " << baselinePath << " by more than " << benchSettings.tolerance * 100.0 << "%" << std::endl;
+			return EXIT_FAILURE;
+		}
+	} catch (const std::exception& e) {
+		std::cerr << e.what() << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,843 @@
+#include "BlockCompression.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define BC_HAS_SSE 1
+#include <emmintrin.h>
+#endif
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#endif
+
+namespace bc {
+
+	/// * * * * * SCALAR REFERENCE * * * * * ///
+
+	// Every other implementation must pick the same indices and compute the same errors, so the
+	// error is summed channel by channel in the same order with separate multiplies and adds
+
+	static void selectIndicesScalar(const Block& block, const Palette& palette, uint8_t* indices, float* errors) {
+		for (uint32_t i = 0; i < 16; i++) {
+			float best = FLT_MAX;
+			uint8_t bestIndex = 0;
+
+			for (uint32_t entry = 0; entry < palette.size; entry++) {
+				float d0 = block.channels[0][i] - palette.entries[entry][0];
+				float d1 = block.channels[1][i] - palette.entries[entry][1];
+				float d2 = block.channels[2][i] - palette.entries[entry][2];
+				float d3 = block.channels[3][i] - palette.entries[entry][3];
+
+				float error = palette.weights[0] * (d0 * d0);
+				error = error + palette.weights[1] * (d1 * d1);
+				error = error + palette.weights[2] * (d2 * d2);
+				error = error + palette.weights[3] * (d3 * d3);
+
+				if (error < best) {
+					best = error;
+					bestIndex = static_cast<uint8_t>(entry);
+				}
+			}
+
+			indices[i] = bestIndex;
+			errors[i] = best;
+		}
+	}
+
+	const Kernels& scalarKernels() {
+		static const Kernels kernels = { selectIndicesScalar };
+		return kernels;
+	}
+
+
+
+	/// * * * * * SSE2 * * * * * ///
+
+#ifdef BC_HAS_SSE
+
+	static void selectIndicesSSE(const Block& block, const Palette& palette, uint8_t* indices, float* errors) {
+		const __m128 w0 = _mm_set1_ps(palette.weights[0]);
+		const __m128 w1 = _mm_set1_ps(palette.weights[1]);
+		const __m128 w2 = _mm_set1_ps(palette.weights[2]);
+		const __m128 w3 = _mm_set1_ps(palette.weights[3]);
+
+		// Four pixels at a time
+		for (uint32_t i = 0; i < 16; i += 4) {
+			__m128 x0 = _mm_load_ps(block.channels[0] + i);
+			__m128 x1 = _mm_load_ps(block.channels[1] + i);
+			__m128 x2 = _mm_load_ps(block.channels[2] + i);
+			__m128 x3 = _mm_load_ps(block.channels[3] + i);
+
+			__m128 best = _mm_set1_ps(FLT_MAX);
+			__m128 bestIndex = _mm_setzero_ps();
+
+			for (uint32_t entry = 0; entry < palette.size; entry++) {
+				__m128 d0 = _mm_sub_ps(x0, _mm_set1_ps(palette.entries[entry][0]));
+				__m128 d1 = _mm_sub_ps(x1, _mm_set1_ps(palette.entries[entry][1]));
+				__m128 d2 = _mm_sub_ps(x2, _mm_set1_ps(palette.entries[entry][2]));
+				__m128 d3 = _mm_sub_ps(x3, _mm_set1_ps(palette.entries[entry][3]));
+
+				__m128 error = _mm_mul_ps(w0, _mm_mul_ps(d0, d0));
+				error = _mm_add_ps(error, _mm_mul_ps(w1, _mm_mul_ps(d1, d1)));
+				error = _mm_add_ps(error, _mm_mul_ps(w2, _mm_mul_ps(d2, d2)));
+				error = _mm_add_ps(error, _mm_mul_ps(w3, _mm_mul_ps(d3, d3)));
+
+				__m128 closer = _mm_cmplt_ps(error, best);
+				best = _mm_or_ps(_mm_and_ps(closer, error), _mm_andnot_ps(closer, best));
+				bestIndex = _mm_or_ps(_mm_and_ps(closer, _mm_set1_ps(static_cast<float>(entry))), _mm_andnot_ps(closer, bestIndex));
+			}
+
+			alignas(16) int32_t lanes[4];
+			_mm_store_si128(reinterpret_cast<__m128i*>(lanes), _mm_cvttps_epi32(bestIndex));
+			_mm_storeu_ps(errors + i, best);
+			for (uint32_t lane = 0; lane < 4; lane++) {
+				indices[i + lane] = static_cast<uint8_t>(lanes[lane]);
+			}
+		}
+	}
+
+	const Kernels* sseKernels() {
+		static const Kernels kernels = { selectIndicesSSE };
+		return &kernels;
+	}
+
+#else
+
+	const Kernels* sseKernels() {
+		return nullptr;
+	}
+
+#endif
+
+	static bool cpuSupportsAVX2() {
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+		int info[4];
+		__cpuid(info, 1);
+		bool osSavesYmm = (info[2] & (1 << 27)) && (_xgetbv(0) & 0x6) == 0x6;
+		__cpuidex(info, 7, 0);
+		return osSavesYmm && (info[1] & (1 << 5));
+#elif (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+		return __builtin_cpu_supports("avx2");
+#else
+		return false;
+#endif
+	}
+
+
+
+	/// * * * * * ENDPOINTS * * * * * ///
+
+	// Bits packed least significant first, as every BCn format stores them
+	struct BitWriter {
+		uint8_t* output;
+		uint32_t position = 0;
+
+		void write(uint32_t value, uint32_t bits) {
+			for (uint32_t bit = 0; bit < bits; bit++, position++) {
+				if ((value >> bit) & 1) {
+					output[position >> 3] |= static_cast<uint8_t>(1 << (position & 7));
+				}
+			}
+		}
+	};
+
+	struct BitReader {
+		const uint8_t* input;
+		uint32_t position = 0;
+
+		uint32_t read(uint32_t bits) {
+			uint32_t value = 0;
+			for (uint32_t bit = 0; bit < bits; bit++, position++) {
+				value |= ((input[position >> 3] >> (position & 7)) & 1u) << bit;
+			}
+			return value;
+		}
+	};
+
+	static void loadBlock(const uint8_t* pixels, Block& block) {
+		for (uint32_t i = 0; i < 16; i++) {
+			for (uint32_t c = 0; c < 4; c++) {
+				block.channels[c][i] = pixels[i * 4 + c];
+			}
+		}
+	}
+
+	static float sumErrors(const float* errors) {
+		float sum = 0.0f;
+		for (uint32_t i = 0; i < 16; i++) {
+			sum += errors[i];
+		}
+		return sum;
+	}
+
+	// Endpoints through the channels [first, first + count) along the direction they vary most in,
+	// spanning every pixel's projection onto it. Falls back to a single color for flat blocks
+	static void principalEndpoints(const Block& block, uint32_t first, uint32_t count, float e0[4], float e1[4]) {
+		float mean[4] = {};
+		for (uint32_t c = first; c < first + count; c++) {
+			for (uint32_t i = 0; i < 16; i++) {
+				mean[c] += block.channels[c][i];
+			}
+			mean[c] /= 16.0f;
+		}
+
+		float covariance[4][4] = {};
+		for (uint32_t i = 0; i < 16; i++) {
+			for (uint32_t a = first; a < first + count; a++) {
+				for (uint32_t b = first; b < first + count; b++) {
+					covariance[a][b] += (block.channels[a][i] - mean[a]) * (block.channels[b][i] - mean[b]);
+				}
+			}
+		}
+
+		// Power iteration, starting from the row of the channel that varies most
+		uint32_t widest = first;
+		for (uint32_t c = first; c < first + count; c++) {
+			widest = covariance[c][c] > covariance[widest][widest] ? c : widest;
+		}
+		float axis[4] = {};
+		for (uint32_t c = first; c < first + count; c++) {
+			axis[c] = covariance[widest][c];
+		}
+
+		for (int iteration = 0; iteration < 8; iteration++) {
+			float next[4] = {};
+			float length = 0.0f;
+			for (uint32_t a = first; a < first + count; a++) {
+				for (uint32_t b = first; b < first + count; b++) {
+					next[a] += covariance[a][b] * axis[b];
+				}
+				length += next[a] * next[a];
+			}
+			if (length < 1e-12f) {
+				break;
+			}
+			length = std::sqrt(length);
+			for (uint32_t c = first; c < first + count; c++) {
+				axis[c] = next[c] / length;
+			}
+		}
+
+		float length = 0.0f;
+		for (uint32_t c = first; c < first + count; c++) {
+			length += axis[c] * axis[c];
+		}
+		length = length > 1e-12f ? std::sqrt(length) : 1.0f;
+
+		float minT = 0.0f;
+		float maxT = 0.0f;
+		for (uint32_t i = 0; i < 16; i++) {
+			float t = 0.0f;
+			for (uint32_t c = first; c < first + count; c++) {
+				t += (block.channels[c][i] - mean[c]) * axis[c] / length;
+			}
+			minT = std::min(minT, t);
+			maxT = std::max(maxT, t);
+		}
+
+		for (uint32_t c = 0; c < 4; c++) {
+			float direction = axis[c] / length;
+			e0[c] = std::min(std::max(mean[c] + direction * maxT, 0.0f), 255.0f);
+			e1[c] = std::min(std::max(mean[c] + direction * minT, 0.0f), 255.0f);
+		}
+	}
+
+	// Least squares endpoints for the channels [first, first + count), given how far from the first endpoint
+	// towards the second each index lies. False when the indices all sit at the same spot and pin nothing down
+	static bool fitEndpoints(const Block& block, uint32_t first, uint32_t count, const uint8_t* indices, const float* fractions,
+		float e0[4], float e1[4]) {
+
+		float a = 0.0f, b = 0.0f, c = 0.0f;
+		float d0[4] = {}, d1[4] = {};
+		for (uint32_t i = 0; i < 16; i++) {
+			float t = fractions[indices[i]];
+			float s = 1.0f - t;
+			a += s * s;
+			b += s * t;
+			c += t * t;
+			for (uint32_t channel = first; channel < first + count; channel++) {
+				d0[channel] += s * block.channels[channel][i];
+				d1[channel] += t * block.channels[channel][i];
+			}
+		}
+
+		float determinant = a * c - b * b;
+		if (std::abs(determinant) < 1e-6f) {
+			return false;
+		}
+
+		for (uint32_t channel = first; channel < first + count; channel++) {
+			e0[channel] = std::min(std::max((c * d0[channel] - b * d1[channel]) / determinant, 0.0f), 255.0f);
+			e1[channel] = std::min(std::max((a * d1[channel] - b * d0[channel]) / determinant, 0.0f), 255.0f);
+		}
+		return true;
+	}
+
+
+
+	/// * * * * * BC1 COLOR * * * * * ///
+
+	static uint16_t pack565(const float color[4]) {
+		uint32_t r = static_cast<uint32_t>(color[0] * 31.0f / 255.0f + 0.5f);
+		uint32_t g = static_cast<uint32_t>(color[1] * 63.0f / 255.0f + 0.5f);
+		uint32_t b = static_cast<uint32_t>(color[2] * 31.0f / 255.0f + 0.5f);
+		return static_cast<uint16_t>((std::min(r, 31u) << 11) | (std::min(g, 63u) << 5) | std::min(b, 31u));
+	}
+
+	static void unpack565(uint16_t packed, uint32_t color[3]) {
+		uint32_t r = packed >> 11;
+		uint32_t g = (packed >> 5) & 63;
+		uint32_t b = packed & 31;
+		color[0] = (r << 3) | (r >> 2);
+		color[1] = (g << 2) | (g >> 4);
+		color[2] = (b << 3) | (b >> 2);
+	}
+
+	// Colors of a block in four color mode, rounded the way decodeColor rounds them
+	static void colorPalette(uint16_t c0, uint16_t c1, Palette& palette) {
+		uint32_t a[3], b[3];
+		unpack565(c0, a);
+		unpack565(c1, b);
+
+		for (uint32_t c = 0; c < 3; c++) {
+			palette.entries[0][c] = static_cast<float>(a[c]);
+			palette.entries[1][c] = static_cast<float>(b[c]);
+			palette.entries[2][c] = static_cast<float>((2 * a[c] + b[c] + 1) / 3);
+			palette.entries[3][c] = static_cast<float>((a[c] + 2 * b[c] + 1) / 3);
+		}
+		for (uint32_t entry = 0; entry < 4; entry++) {
+			palette.entries[entry][3] = 0.0f;
+		}
+		palette.size = 4;
+		palette.weights[0] = 1.0f;
+		palette.weights[1] = 1.0f;
+		palette.weights[2] = 1.0f;
+		palette.weights[3] = 0.0f;
+	}
+
+	static float evaluateColor(const Kernels& kernels, const Block& block, uint16_t c0, uint16_t c1, uint8_t* indices) {
+		Palette palette;
+		colorPalette(c0, c1, palette);
+		float errors[16];
+		kernels.selectIndices(block, palette, indices, errors);
+		return sumErrors(errors);
+	}
+
+	// RGB of a block as a BC1 block in four color mode, alpha is left to the caller
+	static void encodeColor(const Kernels& kernels, const Block& block, uint8_t* output) {
+		static const float fractions[4] = { 0.0f, 1.0f, 1.0f / 3.0f, 2.0f / 3.0f };
+
+		float e0[4], e1[4];
+		principalEndpoints(block, 0, 3, e0, e1);
+
+		uint16_t best0 = pack565(e0);
+		uint16_t best1 = pack565(e1);
+		uint8_t bestIndices[16];
+		float bestError = evaluateColor(kernels, block, best0, best1, bestIndices);
+
+		// Refit the endpoints to the pixels each index ended up with, for as long as that helps
+		for (int iteration = 0; iteration < 3; iteration++) {
+			if (!fitEndpoints(block, 0, 3, bestIndices, fractions, e0, e1)) {
+				break;
+			}
+			uint16_t c0 = pack565(e0);
+			uint16_t c1 = pack565(e1);
+			if (c0 == best0 && c1 == best1) {
+				break;
+			}
+
+			uint8_t indices[16];
+			float error = evaluateColor(kernels, block, c0, c1, indices);
+			if (error >= bestError) {
+				break;
+			}
+			best0 = c0;
+			best1 = c1;
+			bestError = error;
+			memcpy(bestIndices, indices, sizeof(indices));
+		}
+
+		// Four color mode needs the first endpoint to be the larger one. Swapping them swaps the
+		// interpolated colors as well, and equal endpoints decode to a single color
+		if (best0 < best1) {
+			std::swap(best0, best1);
+			for (auto& index : bestIndices) {
+				index ^= 1;
+			}
+		} else if (best0 == best1) {
+			memset(bestIndices, 0, sizeof(bestIndices));
+		}
+
+		output[0] = static_cast<uint8_t>(best0);
+		output[1] = static_cast<uint8_t>(best0 >> 8);
+		output[2] = static_cast<uint8_t>(best1);
+		output[3] = static_cast<uint8_t>(best1 >> 8);
+		uint32_t packed = 0;
+		for (uint32_t i = 0; i < 16; i++) {
+			packed |= static_cast<uint32_t>(bestIndices[i]) << (i * 2);
+		}
+		memcpy(output + 4, &packed, 4);
+	}
+
+	static void decodeColor(const uint8_t* input, bool alwaysFourColors, uint8_t* pixels) {
+		uint16_t c0 = static_cast<uint16_t>(input[0] | (input[1] << 8));
+		uint16_t c1 = static_cast<uint16_t>(input[2] | (input[3] << 8));
+		uint32_t a[3], b[3];
+		unpack565(c0, a);
+		unpack565(c1, b);
+
+		uint32_t palette[4][4];
+		for (uint32_t c = 0; c < 3; c++) {
+			palette[0][c] = a[c];
+			palette[1][c] = b[c];
+			if (c0 > c1 || alwaysFourColors) {
+				palette[2][c] = (2 * a[c] + b[c] + 1) / 3;
+				palette[3][c] = (a[c] + 2 * b[c] + 1) / 3;
+			} else {
+				palette[2][c] = (a[c] + b[c] + 1) / 2;
+				palette[3][c] = 0;
+			}
+		}
+		palette[0][3] = palette[1][3] = palette[2][3] = 255;
+		palette[3][3] = (c0 > c1 || alwaysFourColors) ? 255 : 0;
+
+		uint32_t packed;
+		memcpy(&packed, input + 4, 4);
+		for (uint32_t i = 0; i < 16; i++) {
+			uint32_t index = (packed >> (i * 2)) & 3;
+			for (uint32_t c = 0; c < 4; c++) {
+				pixels[i * 4 + c] = static_cast<uint8_t>(palette[index][c]);
+			}
+		}
+	}
+
+
+
+	/// * * * * * BC4 SINGLE CHANNEL * * * * * ///
+
+	// Values of a block in eight value mode, first > second, rounded the way decodeSingleChannel rounds them
+	static void singleChannelPalette(uint32_t first, uint32_t second, uint32_t channel, Palette& palette) {
+		memset(palette.entries, 0, sizeof(palette.entries));
+		palette.entries[0][channel] = static_cast<float>(first);
+		palette.entries[1][channel] = static_cast<float>(second);
+		for (uint32_t k = 2; k < 8; k++) {
+			palette.entries[k][channel] = static_cast<float>(((8 - k) * first + (k - 1) * second + 3) / 7);
+		}
+		palette.size = 8;
+		for (uint32_t c = 0; c < 4; c++) {
+			palette.weights[c] = c == channel ? 1.0f : 0.0f;
+		}
+	}
+
+	static void encodeSingleChannel(const Kernels& kernels, const Block& block, uint32_t channel, uint8_t* output) {
+		static const float fractions[8] = { 0.0f, 1.0f, 1.0f / 7.0f, 2.0f / 7.0f, 3.0f / 7.0f, 4.0f / 7.0f, 5.0f / 7.0f, 6.0f / 7.0f };
+
+		float low = 255.0f;
+		float high = 0.0f;
+		for (uint32_t i = 0; i < 16; i++) {
+			low = std::min(low, block.channels[channel][i]);
+			high = std::max(high, block.channels[channel][i]);
+		}
+
+		uint32_t best0 = static_cast<uint32_t>(high);
+		uint32_t best1 = static_cast<uint32_t>(low);
+		uint8_t bestIndices[16] = {};
+
+		// A flat block is its first endpoint everywhere
+		if (best0 > best1) {
+			Palette palette;
+			float errors[16];
+			singleChannelPalette(best0, best1, channel, palette);
+			kernels.selectIndices(block, palette, bestIndices, errors);
+			float bestError = sumErrors(errors);
+
+			float e0[4], e1[4];
+			if (fitEndpoints(block, channel, 1, bestIndices, fractions, e0, e1)) {
+				uint32_t first = static_cast<uint32_t>(std::max(e0[channel], e1[channel]) + 0.5f);
+				uint32_t second = static_cast<uint32_t>(std::min(e0[channel], e1[channel]) + 0.5f);
+
+				uint8_t indices[16];
+				if (first > second && (first != best0 || second != best1)) {
+					singleChannelPalette(first, second, channel, palette);
+					kernels.selectIndices(block, palette, indices, errors);
+					if (sumErrors(errors) < bestError) {
+						best0 = first;
+						best1 = second;
+						memcpy(bestIndices, indices, sizeof(indices));
+					}
+				}
+			}
+		}
+
+		output[0] = static_cast<uint8_t>(best0);
+		output[1] = static_cast<uint8_t>(best1);
+		uint64_t packed = 0;
+		for (uint32_t i = 0; i < 16; i++) {
+			packed |= static_cast<uint64_t>(bestIndices[i]) << (i * 3);
+		}
+		for (uint32_t byte = 0; byte < 6; byte++) {
+			output[2 + byte] = static_cast<uint8_t>(packed >> (byte * 8));
+		}
+	}
+
+	static void decodeSingleChannel(const uint8_t* input, uint32_t channel, uint8_t* pixels) {
+		uint32_t first = input[0];
+		uint32_t second = input[1];
+
+		uint32_t values[8] = { first, second };
+		if (first > second) {
+			for (uint32_t k = 2; k < 8; k++) {
+				values[k] = ((8 - k) * first + (k - 1) * second + 3) / 7;
+			}
+		} else {
+			for (uint32_t k = 2; k < 6; k++) {
+				values[k] = ((6 - k) * first + (k - 1) * second + 2) / 5;
+			}
+			values[6] = 0;
+			values[7] = 255;
+		}
+
+		uint64_t packed = 0;
+		for (uint32_t byte = 0; byte < 6; byte++) {
+			packed |= static_cast<uint64_t>(input[2 + byte]) << (byte * 8);
+		}
+		for (uint32_t i = 0; i < 16; i++) {
+			pixels[i * 4 + channel] = static_cast<uint8_t>(values[(packed >> (i * 3)) & 7]);
+		}
+	}
+
+
+
+	/// * * * * * BC7 MODE 6 * * * * * ///
+
+	static const uint32_t BC7_WEIGHTS[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+	// Mode 6 endpoints are 7 bits per channel and one low bit shared by the channels of each endpoint
+	struct BC7Endpoint {
+		uint32_t values[4];
+		uint32_t pBit;
+
+		uint32_t expanded(uint32_t channel) const { return (values[channel] << 1) | pBit; }
+	};
+
+	static BC7Endpoint quantizeBC7(const float endpoint[4]) {
+		BC7Endpoint best = {};
+		float bestError = FLT_MAX;
+
+		for (uint32_t pBit = 0; pBit < 2; pBit++) {
+			BC7Endpoint candidate = {};
+			candidate.pBit = pBit;
+			float error = 0.0f;
+			for (uint32_t c = 0; c < 4; c++) {
+				int32_t value = static_cast<int32_t>(std::floor((endpoint[c] - pBit) * 0.5f + 0.5f));
+				candidate.values[c] = static_cast<uint32_t>(std::min(std::max(value, 0), 127));
+				float difference = static_cast<float>(candidate.expanded(c)) - endpoint[c];
+				error += difference * difference;
+			}
+			if (error < bestError) {
+				best = candidate;
+				bestError = error;
+			}
+		}
+		return best;
+	}
+
+	static void bc7Palette(const BC7Endpoint& e0, const BC7Endpoint& e1, Palette& palette) {
+		for (uint32_t entry = 0; entry < 16; entry++) {
+			uint32_t weight = BC7_WEIGHTS[entry];
+			for (uint32_t c = 0; c < 4; c++) {
+				palette.entries[entry][c] = static_cast<float>(((64 - weight) * e0.expanded(c) + weight * e1.expanded(c) + 32) >> 6);
+			}
+		}
+		palette.size = 16;
+		for (uint32_t c = 0; c < 4; c++) {
+			palette.weights[c] = 1.0f;
+		}
+	}
+
+	static float evaluateBC7(const Kernels& kernels, const Block& block, const BC7Endpoint& e0, const BC7Endpoint& e1, uint8_t* indices) {
+		Palette palette;
+		bc7Palette(e0, e1, palette);
+		float errors[16];
+		kernels.selectIndices(block, palette, indices, errors);
+		return sumErrors(errors);
+	}
+
+	static bool sameEndpoint(const BC7Endpoint& a, const BC7Endpoint& b) {
+		return a.pBit == b.pBit && a.values[0] == b.values[0] && a.values[1] == b.values[1] &&
+			a.values[2] == b.values[2] && a.values[3] == b.values[3];
+	}
+
+	static void encodeBC7(const Kernels& kernels, const Block& block, uint8_t* output) {
+		float fractions[16];
+		for (uint32_t i = 0; i < 16; i++) {
+			fractions[i] = BC7_WEIGHTS[i] / 64.0f;
+		}
+
+		float e0[4], e1[4];
+		principalEndpoints(block, 0, 4, e0, e1);
+
+		BC7Endpoint best0 = quantizeBC7(e0);
+		BC7Endpoint best1 = quantizeBC7(e1);
+		uint8_t bestIndices[16];
+		float bestError = evaluateBC7(kernels, block, best0, best1, bestIndices);
+
+		for (int iteration = 0; iteration < 3; iteration++) {
+			if (!fitEndpoints(block, 0, 4, bestIndices, fractions, e0, e1)) {
+				break;
+			}
+			BC7Endpoint q0 = quantizeBC7(e0);
+			BC7Endpoint q1 = quantizeBC7(e1);
+			if (sameEndpoint(q0, best0) && sameEndpoint(q1, best1)) {
+				break;
+			}
+
+			uint8_t indices[16];
+			float error = evaluateBC7(kernels, block, q0, q1, indices);
+			if (error >= bestError) {
+				break;
+			}
+			best0 = q0;
+			best1 = q1;
+			bestError = error;
+			memcpy(bestIndices, indices, sizeof(indices));
+		}
+
+		// The first index is stored without its top bit, which must therefore be clear
+		if (bestIndices[0] & 8) {
+			std::swap(best0, best1);
+			for (auto& index : bestIndices) {
+				index = static_cast<uint8_t>(15 - index);
+			}
+		}
+
+		BitWriter writer = { output };
+		writer.write(1 << 6, 7);
+		for (uint32_t c = 0; c < 4; c++) {
+			writer.write(best0.values[c], 7);
+			writer.write(best1.values[c], 7);
+		}
+		writer.write(best0.pBit, 1);
+		writer.write(best1.pBit, 1);
+		for (uint32_t i = 0; i < 16; i++) {
+			writer.write(bestIndices[i], i == 0 ? 3 : 4);
+		}
+	}
+
+	// Only mode 6, the one encodeBC7 writes, blocks in any other mode decode to zero
+	static void decodeBC7(const uint8_t* input, uint8_t* pixels) {
+		BitReader reader = { input };
+		if (reader.read(7) != (1 << 6)) {
+			memset(pixels, 0, 64);
+			return;
+		}
+
+		BC7Endpoint e0 = {}, e1 = {};
+		for (uint32_t c = 0; c < 4; c++) {
+			e0.values[c] = reader.read(7);
+			e1.values[c] = reader.read(7);
+		}
+		e0.pBit = reader.read(1);
+		e1.pBit = reader.read(1);
+
+		for (uint32_t i = 0; i < 16; i++) {
+			uint32_t weight = BC7_WEIGHTS[reader.read(i == 0 ? 3 : 4)];
+			for (uint32_t c = 0; c < 4; c++) {
+				pixels[i * 4 + c] = static_cast<uint8_t>(((64 - weight) * e0.expanded(c) + weight * e1.expanded(c) + 32) >> 6);
+			}
+		}
+	}
+
+
+
+	/// * * * * * FORMATS * * * * * ///
+
+	uint32_t blockBytes(Format format) {
+		return format == Format::BC1 ? 8 : 16;
+	}
+
+	const char* formatName(Format format) {
+		switch (format) {
+		case Format::BC1:	return "bc1";
+		case Format::BC3:	return "bc3";
+		case Format::BC5:	return "bc5";
+		case Format::BC7:	return "bc7";
+		}
+		return "unknown";
+	}
+
+	void encodeBlock(Format format, const Kernels& kernels, const uint8_t* pixels, uint8_t* output) {
+		Block block;
+		loadBlock(pixels, block);
+		memset(output, 0, blockBytes(format));
+
+		switch (format) {
+		case Format::BC1:
+			encodeColor(kernels, block, output);
+			break;
+		case Format::BC3:
+			encodeSingleChannel(kernels, block, 3, output);
+			encodeColor(kernels, block, output + 8);
+			break;
+		case Format::BC5:
+			encodeSingleChannel(kernels, block, 0, output);
+			encodeSingleChannel(kernels, block, 1, output + 8);
+			break;
+		case Format::BC7:
+			encodeBC7(kernels, block, output);
+			break;
+		}
+	}
+
+	void decodeBlock(Format format, const uint8_t* input, uint8_t* pixels) {
+		switch (format) {
+		case Format::BC1:
+			decodeColor(input, false, pixels);
+			break;
+		case Format::BC3:
+			decodeColor(input + 8, true, pixels);
+			decodeSingleChannel(input, 3, pixels);
+			break;
+		case Format::BC5:
+			memset(pixels, 0, 64);
+			for (uint32_t i = 0; i < 16; i++) {
+				pixels[i * 4 + 3] = 255;
+			}
+			decodeSingleChannel(input, 0, pixels);
+			decodeSingleChannel(input + 8, 1, pixels);
+			break;
+		case Format::BC7:
+			decodeBC7(input, pixels);
+			break;
+		}
+	}
+
+}
+
+/// * * * * * COMPRESSOR * * * * * ///
+
+BlockCompressor::BlockCompressor(ThreadPool& pool) :
+	threadPool(pool) {
+
+	setImplementation(bestImplementation());
+}
+
+BlockCompressor::Implementation BlockCompressor::bestImplementation() {
+	if (bc::avx2Kernels() && bc::cpuSupportsAVX2()) {
+		return Implementation::AVX2;
+	}
+	if (bc::sseKernels()) {
+		return Implementation::SSE;
+	}
+	return Implementation::Scalar;
+}
+
+const char* BlockCompressor::implementationName(Implementation implementation) {
+	switch (implementation) {
+	case Implementation::Scalar:	return "scalar";
+	case Implementation::SSE:		return "sse2";
+	case Implementation::AVX2:		return "avx2";
+	}
+	return "unknown";
+}
+
+void BlockCompressor::setImplementation(Implementation newImplementation) {
+	const bc::Kernels* newKernels = nullptr;
+
+	switch (newImplementation) {
+	case Implementation::Scalar:
+		newKernels = &bc::scalarKernels();
+		break;
+	case Implementation::SSE:
+		newKernels = bc::sseKernels();
+		break;
+	case Implementation::AVX2:
+		newKernels = bc::cpuSupportsAVX2() ? bc::avx2Kernels() : nullptr;
+		break;
+	}
+
+	if (!newKernels) {
+		throw std::runtime_error(std::string("Block compressor implementation not supported: ") + implementationName(newImplementation));
+	}
+
+	implementation = newImplementation;
+	kernels = newKernels;
+}
+
+std::vector<std::vector<uint8_t>> BlockCompressor::compress(bc::Format format, const std::vector<Image>& levels) const {
+	uint32_t blockBytes = bc::blockBytes(format);
+
+	// Blocks of every level numbered one after another, so small levels do not leave threads idle
+	std::vector<std::vector<uint8_t>> result(levels.size());
+	std::vector<uint32_t> firstBlock(levels.size() + 1, 0);
+	for (size_t level = 0; level < levels.size(); level++) {
+		uint32_t blocksX = (levels[level].width + 3) / 4;
+		uint32_t blocksY = (levels[level].height + 3) / 4;
+		result[level].resize(static_cast<size_t>(blocksX) * blocksY * blockBytes);
+		firstBlock[level + 1] = firstBlock[level] + blocksX * blocksY;
+	}
+
+	const bc::Kernels& blockKernels = *kernels;
+	threadPool.parallelFor(firstBlock.back(), 64, [&](uint32_t begin, uint32_t end) {
+		size_t level = std::upper_bound(firstBlock.begin(), firstBlock.end(), begin) - firstBlock.begin() - 1;
+		uint8_t pixels[64];
+
+		for (uint32_t block = begin; block < end; block++) {
+			while (block >= firstBlock[level + 1]) {
+				level++;
+			}
+			const Image& image = levels[level];
+			uint32_t blocksX = (image.width + 3) / 4;
+			uint32_t index = block - firstBlock[level];
+			uint32_t blockX = index % blocksX;
+			uint32_t blockY = index / blocksX;
+
+			for (uint32_t y = 0; y < 4; y++) {
+				uint32_t sourceY = std::min(blockY * 4 + y, image.height - 1);
+				for (uint32_t x = 0; x < 4; x++) {
+					uint32_t sourceX = std::min(blockX * 4 + x, image.width - 1);
+					memcpy(pixels + (y * 4 + x) * 4, &image.pixels[(static_cast<size_t>(sourceY) * image.width + sourceX) * 4], 4);
+				}
+			}
+
+			bc::encodeBlock(format, blockKernels, pixels, &result[level][static_cast<size_t>(index) * blockBytes]);
+		}
+	});
+
+	return result;
+}
+
+BlockCompressor::Image BlockCompressor::decompress(bc::Format format, const std::vector<uint8_t>& blocks, uint32_t width, uint32_t height) {
+	uint32_t blockBytes = bc::blockBytes(format);
+	uint32_t blocksX = (width + 3) / 4;
+	uint32_t blocksY = (height + 3) / 4;
+	if (blocks.size() < static_cast<size_t>(blocksX) * blocksY * blockBytes) {
+		throw std::runtime_error("Compressed level is smaller than its size requires.");
+	}
+
+	Image image;
+	image.width = width;
+	image.height = height;
+	image.pixels.resize(static_cast<size_t>(width) * height * 4);
+
+	uint8_t pixels[64];
+	for (uint32_t blockY = 0; blockY < blocksY; blockY++) {
+		for (uint32_t blockX = 0; blockX < blocksX; blockX++) {
+			bc::decodeBlock(format, &blocks[(static_cast<size_t>(blockY) * blocksX + blockX) * blockBytes], pixels);
+
+			for (uint32_t y = 0; y < 4 && blockY * 4 + y < height; y++) {
+				for (uint32_t x = 0; x < 4 && blockX * 4 + x < width; x++) {
+					memcpy(&image.pixels[((static_cast<size_t>(blockY) * 4 + y) * width + blockX * 4 + x) * 4], pixels + (y * 4 + x) * 4, 4);
+				}
+			}
+		}
+	}
+
+	return image;
+}
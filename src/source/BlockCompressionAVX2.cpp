@@ -0,0 +1,71 @@
+#include "BlockCompression.h"
+
+#include <cfloat>
+
+// This file is the only one built with AVX2 enabled. Nothing in here may run unless the
+// compressor checked the cpu first, see BlockCompressor::setImplementation
+#if defined(__AVX2__)
+
+#include <immintrin.h>
+
+namespace bc {
+
+	static void selectIndicesAVX2(const Block& block, const Palette& palette, uint8_t* indices, float* errors) {
+		const __m256 w0 = _mm256_set1_ps(palette.weights[0]);
+		const __m256 w1 = _mm256_set1_ps(palette.weights[1]);
+		const __m256 w2 = _mm256_set1_ps(palette.weights[2]);
+		const __m256 w3 = _mm256_set1_ps(palette.weights[3]);
+
+		// Eight pixels at a time, two rows of the block
+		for (uint32_t i = 0; i < 16; i += 8) {
+			__m256 x0 = _mm256_load_ps(block.channels[0] + i);
+			__m256 x1 = _mm256_load_ps(block.channels[1] + i);
+			__m256 x2 = _mm256_load_ps(block.channels[2] + i);
+			__m256 x3 = _mm256_load_ps(block.channels[3] + i);
+
+			__m256 best = _mm256_set1_ps(FLT_MAX);
+			__m256i bestIndex = _mm256_setzero_si256();
+
+			for (uint32_t entry = 0; entry < palette.size; entry++) {
+				__m256 d0 = _mm256_sub_ps(x0, _mm256_set1_ps(palette.entries[entry][0]));
+				__m256 d1 = _mm256_sub_ps(x1, _mm256_set1_ps(palette.entries[entry][1]));
+				__m256 d2 = _mm256_sub_ps(x2, _mm256_set1_ps(palette.entries[entry][2]));
+				__m256 d3 = _mm256_sub_ps(x3, _mm256_set1_ps(palette.entries[entry][3]));
+
+				// Separate multiply and add rather than fma so results match the scalar reference exactly
+				__m256 error = _mm256_mul_ps(w0, _mm256_mul_ps(d0, d0));
+				error = _mm256_add_ps(error, _mm256_mul_ps(w1, _mm256_mul_ps(d1, d1)));
+				error = _mm256_add_ps(error, _mm256_mul_ps(w2, _mm256_mul_ps(d2, d2)));
+				error = _mm256_add_ps(error, _mm256_mul_ps(w3, _mm256_mul_ps(d3, d3)));
+
+				__m256 closer = _mm256_cmp_ps(error, best, _CMP_LT_OQ);
+				best = _mm256_blendv_ps(best, error, closer);
+				bestIndex = _mm256_blendv_epi8(bestIndex, _mm256_set1_epi32(static_cast<int>(entry)), _mm256_castps_si256(closer));
+			}
+
+			// Narrow the eight 32 bit indices down to bytes
+			__m128i packed = _mm_packs_epi32(_mm256_castsi256_si128(bestIndex), _mm256_extracti128_si256(bestIndex, 1));
+			packed = _mm_packus_epi16(packed, packed);
+			_mm_storel_epi64(reinterpret_cast<__m128i*>(indices + i), packed);
+			_mm256_storeu_ps(errors + i, best);
+		}
+	}
+
+	const Kernels* avx2Kernels() {
+		static const Kernels kernels = { selectIndicesAVX2 };
+		return &kernels;
+	}
+
+}
+
+#else
+
+namespace bc {
+
+	const Kernels* avx2Kernels() {
+		return nullptr;
+	}
+
+}
+
+#endif
@@ -0,0 +1,277 @@
+#include "Downsampler.h"
+
+#include "Configuration.h"
+#include "ShaderTypes.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+Downsampler::Downsampler(VkDevice logicalDevice, VkPhysicalDevice physical, const AssetLoader& assets, VkFormat levelFormat,
+	Reduction reduction, bool srgb, bool useSubgroups, uint32_t maxTargets) :
+	device(logicalDevice),
+	physicalDevice(physical),
+	format(levelFormat),
+	subgroups(useSubgroups) {
+
+	if (format != VK_FORMAT_R32_SFLOAT && format != VK_FORMAT_R8G8B8A8_UNORM) {
+		throw std::runtime_error("Downsampler only writes R32_SFLOAT and R8G8B8A8_UNORM levels.");
+	}
+
+	VkDescriptorSetLayoutBinding bindings[3] = {};
+	bindings[0].binding			= 0;
+	bindings[0].descriptorType	= VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	bindings[0].descriptorCount = 1;
+	bindings[0].stageFlags		= VK_SHADER_STAGE_COMPUTE_BIT;
+	bindings[1].binding			= 1;
+	bindings[1].descriptorType	= VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+	bindings[1].descriptorCount = MAX_LEVELS;
+	bindings[1].stageFlags		= VK_SHADER_STAGE_COMPUTE_BIT;
+	bindings[2].binding			= 2;
+	bindings[2].descriptorType	= VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	bindings[2].descriptorCount = 1;
+	bindings[2].stageFlags		= VK_SHADER_STAGE_COMPUTE_BIT;
+
+	VkDescriptorSetLayoutCreateInfo layoutInfo = {};
+	layoutInfo.sType		= VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	layoutInfo.bindingCount = 3;
+	layoutInfo.pBindings	= bindings;
+
+	if (vkCreateDescriptorSetLayout(device, &layoutInfo, nullptr, &setLayout) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create downsampler descriptor set layout.");
+	}
+
+	// Targets come and go with the images they belong to, so their sets are freed one by one
+	VkDescriptorPoolSize poolSizes[3] = {};
+	poolSizes[0].type			 = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	poolSizes[0].descriptorCount = maxTargets;
+	poolSizes[1].type			 = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+	poolSizes[1].descriptorCount = maxTargets * MAX_LEVELS;
+	poolSizes[2].type			 = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	poolSizes[2].descriptorCount = maxTargets;
+
+	VkDescriptorPoolCreateInfo poolInfo = {};
+	poolInfo.sType		   = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+	poolInfo.flags		   = VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT;
+	poolInfo.maxSets	   = maxTargets;
+	poolInfo.poolSizeCount = 3;
+	poolInfo.pPoolSizes	   = poolSizes;
+
+	if (vkCreateDescriptorPool(device, &poolInfo, nullptr, &descriptorPool) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create downsampler descriptor pool.");
+	}
+
+	VkPushConstantRange range = {};
+	range.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+	range.offset	 = 0;
+	range.size		 = sizeof(DownsamplePushConstants);
+
+	VkPipelineLayoutCreateInfo pipelineLayoutInfo = {};
+	pipelineLayoutInfo.sType				  = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+	pipelineLayoutInfo.setLayoutCount		  = 1;
+	pipelineLayoutInfo.pSetLayouts			  = &setLayout;
+	pipelineLayoutInfo.pushConstantRangeCount = 1;
+	pipelineLayoutInfo.pPushConstantRanges	  = &range;
+
+	if (vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &pipelineLayout) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create downsampler pipeline layout.");
+	}
+
+	// The reduction and sRGB handling are constants, so each pipeline only carries the one it does
+	struct {
+		uint32_t reduction;
+		VkBool32 srgb;
+	} constants = { static_cast<uint32_t>(reduction), static_cast<VkBool32>(srgb ? VK_TRUE : VK_FALSE) };
+
+	VkSpecializationMapEntry entries[2] = {
+		{ 0, 0, sizeof(uint32_t) },
+		{ 1, sizeof(uint32_t), sizeof(VkBool32) },
+	};
+	VkSpecializationInfo specialization = {};
+	specialization.mapEntryCount = 2;
+	specialization.pMapEntries	 = entries;
+	specialization.dataSize		 = sizeof(constants);
+	specialization.pData		 = &constants;
+
+	const char* shader = nullptr;
+	if (format == VK_FORMAT_R32_SFLOAT) {
+		shader = subgroups ? "src/shaders/downsample_subgroup_comp.spv" : "src/shaders/downsample_comp.spv";
+	} else {
+		shader = subgroups ? "src/shaders/downsample_rgba8_subgroup_comp.spv" : "src/shaders/downsample_rgba8_comp.spv";
+	}
+	pipeline = vkutil::createComputePipeline(device, assets.load(shader), pipelineLayout, &specialization);
+
+	VkSamplerCreateInfo samplerInfo = {};
+	samplerInfo.sType		 = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+	samplerInfo.magFilter	 = VK_FILTER_NEAREST;
+	samplerInfo.minFilter	 = VK_FILTER_NEAREST;
+	samplerInfo.mipmapMode	 = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+	samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+	samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+	samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+	samplerInfo.minLod		 = 0.0f;
+	samplerInfo.maxLod		 = 0.0f;
+
+	if (vkCreateSampler(device, &samplerInfo, nullptr, &sampler) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create downsampler sampler.");
+	}
+}
+
+bool Downsampler::isSupported(VkPhysicalDevice physicalDevice, VkFormat format) {
+	VkPhysicalDeviceFeatures features;
+	vkGetPhysicalDeviceFeatures(physicalDevice, &features);
+
+	VkPhysicalDeviceProperties properties;
+	vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+
+	VkFormatProperties formatProperties;
+	vkGetPhysicalDeviceFormatProperties(physicalDevice, format, &formatProperties);
+
+	return features.shaderStorageImageArrayDynamicIndexing &&
+		properties.limits.maxComputeWorkGroupInvocations >= 256 &&
+		properties.limits.maxComputeWorkGroupSize[0] >= 256 &&
+		properties.limits.maxPerStageDescriptorStorageImages >= MAX_LEVELS &&
+		(formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_STORAGE_IMAGE_BIT);
+}
+
+bool Downsampler::subgroupQuadSupported(VkPhysicalDevice physicalDevice, PFN_vkGetPhysicalDeviceProperties2KHR getProperties2) {
+	if (getProperties2 == nullptr) {
+		return false;
+	}
+
+	VkPhysicalDeviceProperties properties;
+	vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+	if (properties.apiVersion < VK_API_VERSION_1_1) {
+		return false;
+	}
+
+	VkPhysicalDeviceSubgroupProperties subgroupProperties = {};
+	subgroupProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SUBGROUP_PROPERTIES;
+
+	VkPhysicalDeviceProperties2KHR properties2 = {};
+	properties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2_KHR;
+	properties2.pNext = &subgroupProperties;
+	getProperties2(physicalDevice, &properties2);
+
+	// Quads must fit in a subgroup for invocations 4n to 4n + 3 to be one
+	return (subgroupProperties.supportedStages & VK_SHADER_STAGE_COMPUTE_BIT) &&
+		(subgroupProperties.supportedOperations & VK_SUBGROUP_FEATURE_QUAD_BIT) &&
+		subgroupProperties.subgroupSize >= 4;
+}
+
+Downsampler::Target Downsampler::createTarget(VkImage image, VkExtent2D extent, uint32_t sourceLevel, uint32_t levelCount,
+	VkCommandPool commandPool, VkQueue queue) {
+
+	// The last workgroup reduces one texel per tile, which it can only do for up to a tile of them
+	if (extent.width > TILE_SIZE * TILE_SIZE || extent.height > TILE_SIZE * TILE_SIZE) {
+		throw std::runtime_error("Downsampler sources are at most 4096 texels along each axis.");
+	}
+
+	Target target;
+	target.image = image;
+	target.extent = extent;
+	target.levelCount = std::min(levelCount, MAX_LEVELS);
+
+	for (uint32_t level = 0; level <= target.levelCount; level++) {
+		target.views.push_back(vkutil::createImageView(device, image, format, VK_IMAGE_ASPECT_COLOR_BIT, sourceLevel + level, 1));
+	}
+
+	target.counter = vkutil::createBuffer(device, physicalDevice, sizeof(uint32_t),
+		VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+	uint32_t zero = 0;
+	vkutil::uploadBuffer(device, physicalDevice, commandPool, queue, target.counter, &zero, sizeof(zero));
+
+	VkDescriptorSetAllocateInfo allocInfo = {};
+	allocInfo.sType				 = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+	allocInfo.descriptorPool	 = descriptorPool;
+	allocInfo.descriptorSetCount = 1;
+	allocInfo.pSetLayouts		 = &setLayout;
+
+	if (vkAllocateDescriptorSets(device, &allocInfo, &target.descriptorSet) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to allocate downsampler descriptor set.");
+	}
+
+	VkDescriptorImageInfo srcInfo = {};
+	srcInfo.sampler		= sampler;
+	srcInfo.imageView	= target.views[0];
+	srcInfo.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+
+	// Every element of the array must be valid, the ones past the last level repeat it and are never written
+	VkDescriptorImageInfo levelInfos[MAX_LEVELS] = {};
+	for (uint32_t level = 0; level < MAX_LEVELS; level++) {
+		levelInfos[level].imageView	  = target.views[std::min(level + 1, target.levelCount)];
+		levelInfos[level].imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+	}
+
+	VkDescriptorBufferInfo counterInfo = {};
+	counterInfo.buffer = target.counter.buffer;
+	counterInfo.offset = 0;
+	counterInfo.range  = VK_WHOLE_SIZE;
+
+	VkWriteDescriptorSet writes[3] = {};
+	writes[0].sType				= VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	writes[0].dstSet			= target.descriptorSet;
+	writes[0].dstBinding		= 0;
+	writes[0].descriptorCount	= 1;
+	writes[0].descriptorType	= VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	writes[0].pImageInfo		= &srcInfo;
+	writes[1].sType				= VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	writes[1].dstSet			= target.descriptorSet;
+	writes[1].dstBinding		= 1;
+	writes[1].descriptorCount	= MAX_LEVELS;
+	writes[1].descriptorType	= VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+	writes[1].pImageInfo		= levelInfos;
+	writes[2].sType				= VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	writes[2].dstSet			= target.descriptorSet;
+	writes[2].dstBinding		= 2;
+	writes[2].descriptorCount	= 1;
+	writes[2].descriptorType	= VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	writes[2].pBufferInfo		= &counterInfo;
+
+	vkUpdateDescriptorSets(device, 3, writes, 0, nullptr);
+
+	return target;
+}
+
+void Downsampler::destroyTarget(Target& target) {
+	if (target.descriptorSet != VK_NULL_HANDLE) {
+		vkFreeDescriptorSets(device, descriptorPool, 1, &target.descriptorSet);
+	}
+	for (auto& view : target.views) {
+		vkDestroyImageView(device, view, nullptr);
+	}
+	vkutil::destroyBuffer(device, target.counter);
+	target = Target();
+}
+
+void Downsampler::record(VkCommandBuffer commandBuffer, const Target& target) const {
+	DownsamplePushConstants constants = {};
+	constants.srcSize = glm::ivec2(target.extent.width, target.extent.height);
+	constants.levelCount = target.levelCount;
+
+	uint32_t groupsX = (target.extent.width + TILE_SIZE - 1) / TILE_SIZE;
+	uint32_t groupsY = (target.extent.height + TILE_SIZE - 1) / TILE_SIZE;
+	constants.groupCount = groupsX * groupsY;
+
+	// The previous dispatch on this target reset the counter
+	vkutil::bufferBarrier(commandBuffer, target.counter.buffer,
+		VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT,
+		VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+
+	vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline);
+	vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout, 0, 1, &target.descriptorSet, 0, nullptr);
+	vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(constants), &constants);
+	vkCmdDispatch(commandBuffer, groupsX, groupsY, 1);
+}
+
+void Downsampler::destroy() {
+	vkDestroySampler(device, sampler, nullptr);
+	vkDestroyPipeline(device, pipeline, nullptr);
+	vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
+	vkDestroyDescriptorPool(device, descriptorPool, nullptr);
+	vkDestroyDescriptorSetLayout(device, setLayout, nullptr);
+	sampler = VK_NULL_HANDLE;
+	pipeline = VK_NULL_HANDLE;
+	pipelineLayout = VK_NULL_HANDLE;
+	descriptorPool = VK_NULL_HANDLE;
+	setLayout = VK_NULL_HANDLE;
+}
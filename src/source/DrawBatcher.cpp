@@ -0,0 +1,201 @@
+#include "DrawBatcher.h"
+
+#include <algorithm>
+
+namespace {
+	const uint32_t MESH_SHIFT = DrawBatcher::DEPTH_BITS;
+	const uint32_t MATERIAL_SHIFT = MESH_SHIFT + DrawBatcher::MESH_BITS;
+	const uint32_t PIPELINE_SHIFT = MATERIAL_SHIFT + DrawBatcher::MATERIAL_BITS;
+	const uint32_t PASS_SHIFT = PIPELINE_SHIFT + DrawBatcher::PIPELINE_BITS;
+	static_assert(PASS_SHIFT + DrawBatcher::PASS_BITS == 64, "Sort key fields must fill 64 bits");
+
+	uint64_t field(uint32_t value, uint32_t bits, uint32_t shift) {
+		return (static_cast<uint64_t>(value) & ((uint64_t(1) << bits) - 1)) << shift;
+	}
+
+	uint32_t extract(uint64_t key, uint32_t bits, uint32_t shift) {
+		return static_cast<uint32_t>((key >> shift) & ((uint64_t(1) << bits) - 1));
+	}
+}
+
+uint64_t DrawBatcher::makeKey(uint32_t pass, uint32_t pipeline, uint32_t material, uint32_t mesh, float depth) {
+	const float depthRange = static_cast<float>((1u << DEPTH_BITS) - 1);
+	uint32_t quantized = static_cast<uint32_t>(std::min(std::max(depth, 0.0f), 1.0f) * depthRange);
+	return field(pass, PASS_BITS, PASS_SHIFT) | field(pipeline, PIPELINE_BITS, PIPELINE_SHIFT) |
+		field(material, MATERIAL_BITS, MATERIAL_SHIFT) | field(mesh, MESH_BITS, MESH_SHIFT) | field(quantized, DEPTH_BITS, 0);
+}
+
+uint32_t DrawBatcher::passOf(uint64_t key) {
+	return extract(key, PASS_BITS, PASS_SHIFT);
+}
+
+uint32_t DrawBatcher::pipelineOf(uint64_t key) {
+	return extract(key, PIPELINE_BITS, PIPELINE_SHIFT);
+}
+
+uint32_t DrawBatcher::materialOf(uint64_t key) {
+	return extract(key, MATERIAL_BITS, MATERIAL_SHIFT);
+}
+
+uint32_t DrawBatcher::meshOf(uint64_t key) {
+	return extract(key, MESH_BITS, MESH_SHIFT);
+}
+
+void DrawBatcher::clear() {
+	keys.clear();
+	packetInstances.clear();
+	batches.clear();
+	instances.clear();
+}
+
+void DrawBatcher::add(uint64_t key, uint32_t instance) {
+	keys.push_back(key);
+	packetInstances.push_back(instance);
+}
+
+void DrawBatcher::build() {
+	sortPackets();
+
+	// Packets differing only in depth draw the same thing, and sorting put them next to each other
+	batches.clear();
+	instances = sortedInstances;
+	for (uint32_t i = 0; i < sortedKeys.size(); i++) {
+		if (batches.empty() || (batches.back().key >> DEPTH_BITS) != (sortedKeys[i] >> DEPTH_BITS)) {
+			batches.push_back({ sortedKeys[i], i, 0 });
+		}
+		batches.back().instanceCount++;
+	}
+}
+
+void DrawBatcher::sortPackets() {
+	size_t count = keys.size();
+	sortedKeys = keys;
+	sortedInstances = packetInstances;
+	scratchKeys.resize(count);
+	scratchInstances.resize(count);
+
+	// Every digit's histogram in one pass over the keys
+	uint32_t counts[8][256] = {};
+	for (uint64_t key : keys) {
+		for (uint32_t digit = 0; digit < 8; digit++) {
+			counts[digit][(key >> (digit * 8)) & 0xff]++;
+		}
+	}
+
+	for (uint32_t digit = 0; digit < 8; digit++) {
+		// A digit every key shares would leave the order as it is
+		uint32_t shift = digit * 8;
+		if (count == 0 || counts[digit][(sortedKeys[0] >> shift) & 0xff] == count) {
+			continue;
+		}
+
+		uint32_t offsets[256];
+		uint32_t offset = 0;
+		for (uint32_t bucket = 0; bucket < 256; bucket++) {
+			offsets[bucket] = offset;
+			offset += counts[digit][bucket];
+		}
+
+		// Stable, so the order of the digits below holds within each bucket
+		for (size_t i = 0; i < count; i++) {
+			uint32_t destination = offsets[(sortedKeys[i] >> shift) & 0xff]++;
+			scratchKeys[destination] = sortedKeys[i];
+			scratchInstances[destination] = sortedInstances[i];
+		}
+		sortedKeys.swap(scratchKeys);
+		sortedInstances.swap(scratchInstances);
+	}
+}
+
+DrawBatcher::Stats DrawBatcher::record(VkCommandBuffer commandBuffer, const Tables& tables, uint32_t pass) const {
+	Stats stats;
+	VkPipeline boundPipeline = VK_NULL_HANDLE;
+	VkDescriptorSet boundSet = VK_NULL_HANDLE;
+	VkBuffer boundVertexBuffer = VK_NULL_HANDLE;
+	VkBuffer boundIndexBuffer = VK_NULL_HANDLE;
+
+	// Batches are sorted by pass first, so the pass's are one range
+	auto first = std::lower_bound(batches.begin(), batches.end(), pass, [](const Batch& batch, uint32_t value) {
+		return passOf(batch.key) < value;
+	});
+	for (auto batch = first; batch != batches.end() && passOf(batch->key) == pass; ++batch) {
+		VkPipeline pipeline = tables.pipelines[pipelineOf(batch->key)];
+		if (pipeline != boundPipeline) {
+			vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+			boundPipeline = pipeline;
+			stats.pipelineBinds++;
+		}
+
+		VkDescriptorSet set = tables.materials[materialOf(batch->key)].set;
+		if (set != boundSet) {
+			vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, tables.layout, tables.materialSet, 1, &set, 0, nullptr);
+			boundSet = set;
+			stats.descriptorBinds++;
+		}
+
+		const Mesh& mesh = tables.meshes[meshOf(batch->key)];
+		if (mesh.vertexBuffer != boundVertexBuffer) {
+			VkDeviceSize offset = 0;
+			vkCmdBindVertexBuffers(commandBuffer, 0, 1, &mesh.vertexBuffer, &offset);
+			boundVertexBuffer = mesh.vertexBuffer;
+			stats.vertexBufferBinds++;
+		}
+		if (mesh.indexBuffer != boundIndexBuffer) {
+			vkCmdBindIndexBuffer(commandBuffer, mesh.indexBuffer, 0, VK_INDEX_TYPE_UINT32);
+			boundIndexBuffer = mesh.indexBuffer;
+			stats.indexBufferBinds++;
+		}
+
+		vkCmdDrawIndexed(commandBuffer, mesh.indexCount, batch->instanceCount, mesh.firstIndex, mesh.vertexOffset, batch->firstInstance);
+		stats.draws++;
+	}
+
+	return stats;
+}
+
+DrawBatcher::Stats DrawBatcher::recordUnsorted(VkCommandBuffer commandBuffer, const Tables& tables, uint32_t pass) const {
+	Stats stats;
+	VkPipeline boundPipeline = VK_NULL_HANDLE;
+	VkDescriptorSet boundSet = VK_NULL_HANDLE;
+	VkBuffer boundVertexBuffer = VK_NULL_HANDLE;
+	VkBuffer boundIndexBuffer = VK_NULL_HANDLE;
+
+	for (uint32_t i = 0; i < keys.size(); i++) {
+		uint64_t key = keys[i];
+		if (passOf(key) != pass) {
+			continue;
+		}
+
+		VkPipeline pipeline = tables.pipelines[pipelineOf(key)];
+		if (pipeline != boundPipeline) {
+			vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+			boundPipeline = pipeline;
+			stats.pipelineBinds++;
+		}
+
+		VkDescriptorSet set = tables.materials[materialOf(key)].set;
+		if (set != boundSet) {
+			vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, tables.layout, tables.materialSet, 1, &set, 0, nullptr);
+			boundSet = set;
+			stats.descriptorBinds++;
+		}
+
+		const Mesh& mesh = tables.meshes[meshOf(key)];
+		if (mesh.vertexBuffer != boundVertexBuffer) {
+			VkDeviceSize offset = 0;
+			vkCmdBindVertexBuffers(commandBuffer, 0, 1, &mesh.vertexBuffer, &offset);
+			boundVertexBuffer = mesh.vertexBuffer;
+			stats.vertexBufferBinds++;
+		}
+		if (mesh.indexBuffer != boundIndexBuffer) {
+			vkCmdBindIndexBuffer(commandBuffer, mesh.indexBuffer, 0, VK_INDEX_TYPE_UINT32);
+			boundIndexBuffer = mesh.indexBuffer;
+			stats.indexBufferBinds++;
+		}
+
+		vkCmdDrawIndexed(commandBuffer, mesh.indexCount, 1, mesh.firstIndex, mesh.vertexOffset, i);
+		stats.draws++;
+	}
+
+	return stats;
+}
@@ -0,0 +1,156 @@
+#include "FrameCapture.h"
+
+#include "Png.h"
+
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+
+FrameCapture::FrameCapture(VkDevice logicalDevice, VkPhysicalDevice physical, const Config& captureConfig) :
+	device(logicalDevice),
+	physicalDevice(physical),
+	config(captureConfig),
+	workers(captureConfig.threads) {
+
+	std::filesystem::create_directories(config.directory);
+	slots.resize(config.ringSize);
+
+	// The workers read every byte of a frame, which is much quicker from cached memory where there is some
+	memoryProperties = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+	if (vkutil::hasMemoryType(physicalDevice, ~0u, memoryProperties | VK_MEMORY_PROPERTY_HOST_CACHED_BIT)) {
+		memoryProperties |= VK_MEMORY_PROPERTY_HOST_CACHED_BIT;
+	}
+}
+
+bool FrameCapture::isSupported(VkFormat format) {
+	switch (format) {
+	case VK_FORMAT_R8G8B8A8_UNORM:
+	case VK_FORMAT_R8G8B8A8_SRGB:
+	case VK_FORMAT_B8G8R8A8_UNORM:
+	case VK_FORMAT_B8G8R8A8_SRGB:
+		return true;
+	default:
+		return false;
+	}
+}
+
+void FrameCapture::recordCopy(VkCommandBuffer commandBuffer, VkImage image, VkExtent2D extent, VkFormat format, VkFence fence, uint64_t frameNumber) {
+	Slot* slot = nullptr;
+	for (auto& candidate : slots) {
+		if (candidate.state == SlotState::Free) {
+			slot = &candidate;
+			break;
+		}
+	}
+	if (slot == nullptr) {
+		stats.dropped++;
+		return;
+	}
+
+	// Free buffers are out of the gpu's and the workers' hands, so one too small for the frame can go
+	VkDeviceSize size = static_cast<VkDeviceSize>(extent.width) * extent.height * 4;
+	if (slot->buffer.size < size) {
+		vkutil::destroyBuffer(device, slot->buffer);
+		slot->buffer = vkutil::createBuffer(device, physicalDevice, size, VK_BUFFER_USAGE_TRANSFER_DST_BIT, memoryProperties);
+	}
+
+	VkBufferImageCopy region = {};
+	region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	region.imageSubresource.layerCount = 1;
+	region.imageExtent				   = { extent.width, extent.height, 1 };
+	vkCmdCopyImageToBuffer(commandBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, slot->buffer.buffer, 1, &region);
+
+	slot->state		  = SlotState::Copying;
+	slot->fence		  = fence;
+	slot->frameNumber = frameNumber;
+	slot->extent	  = extent;
+	slot->bgra		  = format == VK_FORMAT_B8G8R8A8_UNORM || format == VK_FORMAT_B8G8R8A8_SRGB;
+	stats.captured++;
+}
+
+void FrameCapture::poll() {
+	for (auto& slot : slots) {
+		if (slot.state == SlotState::Encoding && slot.written.wait_for(std::chrono::seconds(0)) == std::future_status::ready) {
+			collect(slot);
+		}
+		if (slot.state == SlotState::Copying && vkGetFenceStatus(device, slot.fence) == VK_SUCCESS) {
+			const Slot* source = &slot;
+			slot.written = workers.submit([this, source]() { return write(*source); });
+			slot.state = SlotState::Encoding;
+		}
+	}
+}
+
+void FrameCapture::flush() {
+	poll();
+	for (auto& slot : slots) {
+		if (slot.state == SlotState::Encoding) {
+			slot.written.wait();
+			collect(slot);
+		}
+	}
+}
+
+void FrameCapture::collect(Slot& slot) {
+	Written written = slot.written.get();
+	stats.written++;
+	stats.writtenBytes += written.bytes;
+	stats.encodeMs += written.encodeMs;
+	slot.state = SlotState::Free;
+}
+
+FrameCapture::Written FrameCapture::write(const Slot& slot) const {
+	auto start = std::chrono::steady_clock::now();
+
+	const uint8_t* pixels = static_cast<const uint8_t*>(slot.buffer.mapped);
+	size_t pixelCount = static_cast<size_t>(slot.extent.width) * slot.extent.height;
+	uint32_t red = slot.bgra ? 2 : 0;
+	uint32_t blue = slot.bgra ? 0 : 2;
+
+	char name[64];
+	std::vector<uint8_t> encoded;
+	if (config.format == CaptureFormat::Png) {
+		// Alpha is whatever the tonemap left there, so only color is kept
+		std::vector<uint8_t> rgb(pixelCount * 3);
+		for (size_t i = 0; i < pixelCount; i++) {
+			rgb[i * 3 + 0] = pixels[i * 4 + red];
+			rgb[i * 3 + 1] = pixels[i * 4 + 1];
+			rgb[i * 3 + 2] = pixels[i * 4 + blue];
+		}
+		encoded = png::encode(rgb.data(), slot.extent.width, slot.extent.height, static_cast<size_t>(slot.extent.width) * 3);
+		snprintf(name, sizeof(name), "frame_%06llu.png", static_cast<unsigned long long>(slot.frameNumber));
+	} else {
+		encoded.resize(pixelCount * 4);
+		for (size_t i = 0; i < pixelCount; i++) {
+			encoded[i * 4 + 0] = pixels[i * 4 + red];
+			encoded[i * 4 + 1] = pixels[i * 4 + 1];
+			encoded[i * 4 + 2] = pixels[i * 4 + blue];
+			encoded[i * 4 + 3] = pixels[i * 4 + 3];
+		}
+		snprintf(name, sizeof(name), "frame_%06llu_%ux%u.rgba", static_cast<unsigned long long>(slot.frameNumber),
+			slot.extent.width, slot.extent.height);
+	}
+
+	std::string path = config.directory + "/" + name;
+	std::ofstream file(path, std::ios::binary | std::ios::trunc);
+	if (!file.write(reinterpret_cast<const char*>(encoded.data()), static_cast<std::streamsize>(encoded.size()))) {
+		throw std::runtime_error("Failed to write captured frame " + path);
+	}
+
+	Written written;
+	written.bytes = encoded.size();
+	written.encodeMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	return written;
+}
+
+void FrameCapture::destroy() {
+	for (auto& slot : slots) {
+		if (slot.state == SlotState::Encoding) {
+			slot.written.wait();
+		}
+		vkutil::destroyBuffer(device, slot.buffer);
+		slot.state = SlotState::Free;
+	}
+}
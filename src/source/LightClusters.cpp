@@ -0,0 +1,178 @@
+#include "LightClusters.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+
+LightClusters::LightClusters(VkDevice logicalDevice, VkPhysicalDevice physicalDevice, const AssetLoader& assets, const Config& clusterConfig) :
+	device(logicalDevice),
+	config(clusterConfig) {
+
+	indexCapacity = CLUSTER_COUNT * config.averageClusterLights;
+
+	VkDescriptorSetLayoutBinding bindings[4] = {};
+	for (uint32_t i = 0; i < 4; i++) {
+		bindings[i].binding			= i;
+		bindings[i].descriptorType	= i == 0 ? VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER : VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		bindings[i].descriptorCount = 1;
+		bindings[i].stageFlags		= VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_COMPUTE_BIT;
+	}
+
+	VkDescriptorSetLayoutCreateInfo layoutInfo = {};
+	layoutInfo.sType		= VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	layoutInfo.bindingCount = 4;
+	layoutInfo.pBindings	= bindings;
+
+	if (vkCreateDescriptorSetLayout(device, &layoutInfo, nullptr, &setLayout) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create light cluster descriptor set layout.");
+	}
+
+	VkDescriptorPoolSize poolSizes[2] = {};
+	poolSizes[0].type			 = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+	poolSizes[0].descriptorCount = config.framesInFlight;
+	poolSizes[1].type			 = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	poolSizes[1].descriptorCount = 3 * config.framesInFlight;
+
+	VkDescriptorPoolCreateInfo poolInfo = {};
+	poolInfo.sType		   = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+	poolInfo.poolSizeCount = 2;
+	poolInfo.pPoolSizes	   = poolSizes;
+	poolInfo.maxSets	   = config.framesInFlight;
+
+	if (vkCreateDescriptorPool(device, &poolInfo, nullptr, &descriptorPool) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create light cluster descriptor pool.");
+	}
+
+	std::vector<VkDescriptorSetLayout> layouts(config.framesInFlight, setLayout);
+	descriptorSets.resize(config.framesInFlight);
+
+	VkDescriptorSetAllocateInfo allocInfo = {};
+	allocInfo.sType				 = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+	allocInfo.descriptorPool	 = descriptorPool;
+	allocInfo.descriptorSetCount = config.framesInFlight;
+	allocInfo.pSetLayouts		 = layouts.data();
+
+	if (vkAllocateDescriptorSets(device, &allocInfo, descriptorSets.data()) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to allocate light cluster descriptor sets.");
+	}
+
+	const VkMemoryPropertyFlags hostVisible = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+	for (uint32_t frame = 0; frame < config.framesInFlight; frame++) {
+		gridBuffers.push_back(vkutil::createBuffer(device, physicalDevice, sizeof(LightGridData),
+			VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, hostVisible, config.queueFamilies));
+		lightBuffers.push_back(vkutil::createBuffer(device, physicalDevice, sizeof(LightData) * std::max(config.maxLights, 1u),
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, hostVisible, config.queueFamilies));
+		clusterBuffers.push_back(vkutil::createBuffer(device, physicalDevice, sizeof(LightClusterHeader) + sizeof(uint32_t) * 2 * CLUSTER_COUNT,
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, config.queueFamilies));
+		indexBuffers.push_back(vkutil::createBuffer(device, physicalDevice, sizeof(uint32_t) * indexCapacity,
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, config.queueFamilies));
+		readbackBuffers.push_back(vkutil::createBuffer(device, physicalDevice, sizeof(LightClusterHeader),
+			VK_BUFFER_USAGE_TRANSFER_DST_BIT, hostVisible));
+		memset(readbackBuffers[frame].mapped, 0, sizeof(LightClusterHeader));
+
+		VkDescriptorBufferInfo bufferInfos[4] = {};
+		const VkBuffer buffers[4] = { gridBuffers[frame].buffer, lightBuffers[frame].buffer, clusterBuffers[frame].buffer, indexBuffers[frame].buffer };
+		VkWriteDescriptorSet writes[4] = {};
+		for (uint32_t i = 0; i < 4; i++) {
+			bufferInfos[i].buffer = buffers[i];
+			bufferInfos[i].offset = 0;
+			bufferInfos[i].range  = VK_WHOLE_SIZE;
+
+			writes[i].sType			  = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+			writes[i].dstSet		  = descriptorSets[frame];
+			writes[i].dstBinding	  = i;
+			writes[i].descriptorCount = 1;
+			writes[i].descriptorType  = bindings[i].descriptorType;
+			writes[i].pBufferInfo	  = &bufferInfos[i];
+		}
+		vkUpdateDescriptorSets(device, 4, writes, 0, nullptr);
+	}
+
+	VkPipelineLayoutCreateInfo pipelineLayoutInfo = {};
+	pipelineLayoutInfo.sType		  = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+	pipelineLayoutInfo.setLayoutCount = 1;
+	pipelineLayoutInfo.pSetLayouts	  = &setLayout;
+
+	if (vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &pipelineLayout) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create light binning pipeline layout.");
+	}
+	pipeline = vkutil::createComputePipeline(device, assets.load("src/shaders/light_bin_comp.spv"), pipelineLayout);
+}
+
+void LightClusters::update(uint32_t frame, const CameraData& camera, VkExtent2D screen, const std::vector<LightData>& lights, bool bruteForce) {
+	const LightClusterHeader* header = static_cast<const LightClusterHeader*>(readbackBuffers[frame].mapped);
+	stats.indexCount	   = header->indexCount;
+	stats.maxClusterLights = header->maxClusterLights;
+	stats.overflowClusters = header->overflowClusters;
+
+	lightCount = std::min(static_cast<uint32_t>(lights.size()), config.maxLights);
+	memcpy(lightBuffers[frame].mapped, lights.data(), sizeof(LightData) * lightCount);
+
+	// Slices run from the near to the far plane, slice = log2(depth / near) * GRID_Z / log2(far / near)
+	float nearPlane = camera.projParams.x;
+	float farPlane = camera.projParams.y;
+	float sliceScale = GRID_Z / std::log2(farPlane / nearPlane);
+
+	LightGridData grid = {};
+	grid.view		   = camera.view;
+	grid.gridSize	   = glm::uvec4(GRID_X, GRID_Y, GRID_Z, lightCount);
+	grid.sliceParams   = glm::vec4(screen.width / static_cast<float>(GRID_X), screen.height / static_cast<float>(GRID_Y),
+		sliceScale, -std::log2(nearPlane) * sliceScale);
+	// The projection's y is flipped, the tangent is not
+	grid.frustumParams = glm::vec4(1.0f / camera.proj[0][0], 1.0f / std::abs(camera.proj[1][1]), nearPlane, farPlane);
+	grid.indexCapacity = indexCapacity;
+	grid.bruteForce	   = bruteForce ? 1 : 0;
+	memcpy(gridBuffers[frame].mapped, &grid, sizeof(grid));
+}
+
+void LightClusters::recordReset(VkCommandBuffer commandBuffer, uint32_t frame) {
+	vkCmdFillBuffer(commandBuffer, clusterBuffers[frame].buffer, 0, sizeof(LightClusterHeader), 0);
+}
+
+void LightClusters::recordAsync(VkCommandBuffer commandBuffer, uint32_t frame) {
+	recordReset(commandBuffer, frame);
+	vkutil::bufferBarrier(commandBuffer, clusterBuffers[frame].buffer,
+		VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT,
+		VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+	recordBinning(commandBuffer, frame);
+
+	// Read back here rather than on the shading queue, which then has nothing but its fragments waiting on the binning
+	vkutil::bufferBarrier(commandBuffer, clusterBuffers[frame].buffer,
+		VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT,
+		VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_READ_BIT);
+	recordReadback(commandBuffer, frame);
+	vkutil::bufferBarrier(commandBuffer, readbackBuffers[frame].buffer,
+		VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT,
+		VK_PIPELINE_STAGE_HOST_BIT, VK_ACCESS_HOST_READ_BIT);
+}
+
+void LightClusters::recordBinning(VkCommandBuffer commandBuffer, uint32_t frame) {
+	vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline);
+	vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout, 0, 1, &descriptorSets[frame], 0, nullptr);
+	vkCmdDispatch(commandBuffer, CLUSTER_COUNT, 1, 1);
+}
+
+void LightClusters::recordReadback(VkCommandBuffer commandBuffer, uint32_t frame) {
+	VkBufferCopy region = {};
+	region.size = sizeof(LightClusterHeader);
+	vkCmdCopyBuffer(commandBuffer, clusterBuffers[frame].buffer, readbackBuffers[frame].buffer, 1, &region);
+}
+
+void LightClusters::destroy() {
+	for (auto* buffers : { &gridBuffers, &lightBuffers, &clusterBuffers, &indexBuffers, &readbackBuffers }) {
+		for (auto& buffer : *buffers) {
+			vkutil::destroyBuffer(device, buffer);
+		}
+		buffers->clear();
+	}
+	vkDestroyPipeline(device, pipeline, nullptr);
+	vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
+	vkDestroyDescriptorPool(device, descriptorPool, nullptr);
+	vkDestroyDescriptorSetLayout(device, setLayout, nullptr);
+	pipeline = VK_NULL_HANDLE;
+	pipelineLayout = VK_NULL_HANDLE;
+	descriptorPool = VK_NULL_HANDLE;
+	setLayout = VK_NULL_HANDLE;
+}
@@ -0,0 +1,193 @@
+#include "Lz4.h"
+
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+
+namespace {
+
+	const size_t MIN_MATCH = 4;
+	// The format requires the last five bytes to be literals and the last match to start twelve bytes before the end
+	const size_t LAST_LITERALS = 5;
+	const size_t MATCH_FIND_LIMIT = 12;
+	const size_t MAX_DISTANCE = 65535;
+	const uint32_t HASH_BITS = 16;
+
+	uint32_t read32(const uint8_t* p) {
+		uint32_t value;
+		memcpy(&value, p, sizeof(value));
+		return value;
+	}
+
+	uint32_t hash(uint32_t sequence) {
+		return (sequence * 2654435761u) >> (32 - HASH_BITS);
+	}
+
+	// Lengths of 15 and over continue in bytes of 255 until one is smaller
+	uint8_t* writeLength(uint8_t* out, size_t length) {
+		for (; length >= 255; length -= 255) {
+			*out++ = 255;
+		}
+		*out++ = static_cast<uint8_t>(length);
+		return out;
+	}
+
+	uint8_t* writeSequence(uint8_t* out, const uint8_t* literals, size_t literalLength, size_t offset, size_t matchLength) {
+		uint8_t* token = out++;
+		*token = static_cast<uint8_t>((literalLength < 15 ? literalLength : 15) << 4);
+		if (literalLength >= 15) {
+			out = writeLength(out, literalLength - 15);
+		}
+		memcpy(out, literals, literalLength);
+		out += literalLength;
+
+		// The last sequence is literals only
+		if (matchLength == 0) {
+			return out;
+		}
+
+		*out++ = static_cast<uint8_t>(offset);
+		*out++ = static_cast<uint8_t>(offset >> 8);
+		size_t lengthCode = matchLength - MIN_MATCH;
+		*token |= static_cast<uint8_t>(lengthCode < 15 ? lengthCode : 15);
+		if (lengthCode >= 15) {
+			out = writeLength(out, lengthCode - 15);
+		}
+		return out;
+	}
+
+	size_t readLength(const uint8_t*& in, const uint8_t* end) {
+		size_t length = 0;
+		uint8_t byte;
+		do {
+			if (in >= end) {
+				throw std::runtime_error("Truncated lz4 block.");
+			}
+			byte = *in++;
+			length += byte;
+		} while (byte == 255);
+		return length;
+	}
+
+}
+
+namespace lz4 {
+
+	size_t compressBound(size_t size) {
+		return size + size / 255 + 16;
+	}
+
+	size_t compress(const uint8_t* src, size_t size, uint8_t* dst) {
+		const uint8_t* end = src + size;
+		const uint8_t* anchor = src;
+		uint8_t* out = dst;
+
+		if (size > MATCH_FIND_LIMIT) {
+			const uint8_t* matchLimit = end - LAST_LITERALS;
+			const uint8_t* findLimit = end - MATCH_FIND_LIMIT;
+
+			// Last position each hashed sequence was seen at
+			std::vector<uint32_t> table(size_t(1) << HASH_BITS, 0);
+
+			const uint8_t* ip = src;
+			while (ip < findLimit) {
+				uint32_t sequence = read32(ip);
+				uint32_t& slot = table[hash(sequence)];
+				const uint8_t* candidate = src + slot;
+				slot = static_cast<uint32_t>(ip - src);
+
+				if (candidate >= ip || static_cast<size_t>(ip - candidate) > MAX_DISTANCE || read32(candidate) != sequence) {
+					// Step further the longer nothing matched, incompressible data then goes by quickly
+					ip += 1 + ((ip - anchor) >> 6);
+					continue;
+				}
+
+				// Grow the match backwards into the pending literals, then forwards as far as the format allows
+				while (ip > anchor && candidate > src && ip[-1] == candidate[-1]) {
+					ip--;
+					candidate--;
+				}
+				size_t length = MIN_MATCH;
+				while (ip + length < matchLimit && ip[length] == candidate[length]) {
+					length++;
+				}
+
+				out = writeSequence(out, anchor, ip - anchor, ip - candidate, length);
+				ip += length;
+				anchor = ip;
+
+				// The bytes the match skipped would otherwise never be found again
+				if (ip < findLimit) {
+					table[hash(read32(ip - 2))] = static_cast<uint32_t>(ip - 2 - src);
+				}
+			}
+		}
+
+		out = writeSequence(out, anchor, end - anchor, 0, 0);
+		return static_cast<size_t>(out - dst);
+	}
+
+	void decompress(const uint8_t* src, size_t srcSize, uint8_t* dst, size_t dstSize) {
+		const uint8_t* in = src;
+		const uint8_t* inEnd = src + srcSize;
+		uint8_t* out = dst;
+		uint8_t* outEnd = dst + dstSize;
+
+		while (true) {
+			if (in >= inEnd) {
+				throw std::runtime_error("Truncated lz4 block.");
+			}
+			uint8_t token = *in++;
+
+			size_t literalLength = token >> 4;
+			if (literalLength == 15) {
+				literalLength += readLength(in, inEnd);
+			}
+			if (literalLength > static_cast<size_t>(inEnd - in) || literalLength > static_cast<size_t>(outEnd - out)) {
+				throw std::runtime_error("Lz4 literals run past the end of the block.");
+			}
+			memcpy(out, in, literalLength);
+			in += literalLength;
+			out += literalLength;
+
+			// Only the last sequence ends without a match
+			if (in == inEnd) {
+				break;
+			}
+
+			if (inEnd - in < 2) {
+				throw std::runtime_error("Truncated lz4 block.");
+			}
+			size_t offset = in[0] | (static_cast<size_t>(in[1]) << 8);
+			in += 2;
+			if (offset == 0 || offset > static_cast<size_t>(out - dst)) {
+				throw std::runtime_error("Lz4 match reaches before the start of the block.");
+			}
+
+			size_t matchLength = token & 15;
+			if (matchLength == 15) {
+				matchLength += readLength(in, inEnd);
+			}
+			matchLength += MIN_MATCH;
+			if (matchLength > static_cast<size_t>(outEnd - out)) {
+				throw std::runtime_error("Lz4 match runs past the end of the block.");
+			}
+
+			// Matches closer than their length repeat the bytes they are still writing
+			const uint8_t* match = out - offset;
+			if (offset >= matchLength) {
+				memcpy(out, match, matchLength);
+				out += matchLength;
+			} else {
+				for (size_t i = 0; i < matchLength; i++) {
+					*out++ = *match++;
+				}
+			}
+		}
+
+		if (out != outEnd) {
+			throw std::runtime_error("Lz4 block is shorter than expected.");
+		}
+	}
+
+}
@@ -0,0 +1,100 @@
+
+#include "Mesh.h"
+
+#include <glm/gtc/constants.hpp>
+
+#include <algorithm>
+
+void Mesh::computeBounds() {
+	if (vertices.empty()) {
+		boundsCenter = glm::vec3(0.0f);
+		boundsRadius = 0.0f;
+		return;
+	}
+
+	// Center of the bounding box is a good enough sphere center for our meshes
+	glm::vec3 minPos = vertices[0].pos;
+	glm::vec3 maxPos = vertices[0].pos;
+	for (const auto& vertex : vertices) {
+		minPos = glm::min(minPos, vertex.pos);
+		maxPos = glm::max(maxPos, vertex.pos);
+	}
+
+	boundsCenter = (minPos + maxPos) * 0.5f;
+	boundsRadius = 0.0f;
+	for (const auto& vertex : vertices) {
+		boundsRadius = std::max(boundsRadius, glm::length(vertex.pos - boundsCenter));
+	}
+}
+
+namespace mesh {
+
+	Mesh createCube() {
+		Mesh result;
+
+		// One face per axis direction, 4 vertices each so every face gets flat normals
+		const glm::vec3 normals[6] = {
+			{  1.0f,  0.0f,  0.0f }, { -1.0f,  0.0f,  0.0f },
+			{  0.0f,  1.0f,  0.0f }, {  0.0f, -1.0f,  0.0f },
+			{  0.0f,  0.0f,  1.0f }, {  0.0f,  0.0f, -1.0f },
+		};
+
+		for (const auto& normal : normals) {
+			// Two axes spanning the face, ordered so that (u x v) == normal
+			glm::vec3 u = glm::vec3(normal.y, normal.z, normal.x);
+			glm::vec3 v = glm::cross(normal, u);
+
+			uint32_t base = static_cast<uint32_t>(result.vertices.size());
+			const glm::vec2 corners[4] = { { -1.0f, -1.0f }, { 1.0f, -1.0f }, { 1.0f, 1.0f }, { -1.0f, 1.0f } };
+			for (const auto& corner : corners) {
+				Vertex vertex;
+				vertex.pos	  = 0.5f * (normal + corner.x * u + corner.y * v);
+				vertex.normal = normal;
+				vertex.uv	  = corner * 0.5f + 0.5f;
+				result.vertices.push_back(vertex);
+			}
+
+			result.indices.insert(result.indices.end(), { base, base + 1, base + 2, base, base + 2, base + 3 });
+		}
+
+		result.computeBounds();
+		return result;
+	}
+
+	Mesh createSphere(uint32_t segments, uint32_t rings) {
+		Mesh result;
+
+		for (uint32_t ring = 0; ring <= rings; ring++) {
+			float v = static_cast<float>(ring) / rings;
+			float phi = v * glm::pi<float>();
+
+			for (uint32_t segment = 0; segment <= segments; segment++) {
+				float u = static_cast<float>(segment) / segments;
+				float theta = u * glm::two_pi<float>();
+
+				glm::vec3 normal = glm::vec3(std::sin(phi) * std::cos(theta), std::cos(phi), -std::sin(phi) * std::sin(theta));
+
+				Vertex vertex;
+				vertex.pos	  = normal * 0.5f;
+				vertex.normal = normal;
+				vertex.uv	  = glm::vec2(u, v);
+				result.vertices.push_back(vertex);
+			}
+		}
+
+		// Rings run from the top pole down, segments wind counter clockwise seen from above
+		uint32_t stride = segments + 1;
+		for (uint32_t ring = 0; ring < rings; ring++) {
+			for (uint32_t segment = 0; segment < segments; segment++) {
+				uint32_t a = ring * stride + segment;
+				uint32_t b = a + stride;
+
+				result.indices.insert(result.indices.end(), { a, b, a + 1, a + 1, b, b + 1 });
+			}
+		}
+
+		result.computeBounds();
+		return result;
+	}
+
+}
@@ -0,0 +1,216 @@
+#include "Meshlet.h"
+#include "Mesh.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace meshlet {
+
+	// Sphere around the meshlet's vertices and a cone around its triangle normals
+	static void computeBounds(const Mesh& mesh, const uint32_t* indices, uint32_t indexCount, Meshlet& result) {
+		glm::vec3 minPos = glm::vec3(std::numeric_limits<float>::max());
+		glm::vec3 maxPos = glm::vec3(-std::numeric_limits<float>::max());
+		for (uint32_t i = 0; i < indexCount; i++) {
+			minPos = glm::min(minPos, mesh.vertices[indices[i]].pos);
+			maxPos = glm::max(maxPos, mesh.vertices[indices[i]].pos);
+		}
+
+		result.center = (minPos + maxPos) * 0.5f;
+		result.radius = 0.0f;
+		for (uint32_t i = 0; i < indexCount; i++) {
+			result.radius = std::max(result.radius, glm::length(mesh.vertices[indices[i]].pos - result.center));
+		}
+
+		std::vector<glm::vec3> normals;
+		std::vector<glm::vec3> corners;
+		glm::vec3 normalSum = glm::vec3(0.0f);
+		for (uint32_t i = 0; i < indexCount; i += 3) {
+			const glm::vec3& p0 = mesh.vertices[indices[i + 0]].pos;
+			const glm::vec3& p1 = mesh.vertices[indices[i + 1]].pos;
+			const glm::vec3& p2 = mesh.vertices[indices[i + 2]].pos;
+
+			glm::vec3 normal = glm::cross(p1 - p0, p2 - p0);
+			float area = glm::length(normal);
+			if (area <= 1e-12f) {
+				continue;
+			}
+
+			normals.push_back(normal / area);
+			corners.push_back(p0);
+			normalSum += normal / area;
+		}
+
+		result.coneApex = result.center;
+		result.coneAxis = glm::vec3(0.0f, 0.0f, 1.0f);
+		result.coneCutoff = 1.0f;
+
+		float axisLength = glm::length(normalSum);
+		if (normals.empty() || axisLength <= 1e-6f) {
+			return;
+		}
+
+		glm::vec3 axis = normalSum / axisLength;
+		float minDot = 1.0f;
+		for (const auto& normal : normals) {
+			minDot = std::min(minDot, glm::dot(axis, normal));
+		}
+
+		// Cones close to a half space almost never cull, leave them disabled
+		if (minDot <= 0.1f) {
+			return;
+		}
+
+		// Move the apex back along the axis until every triangle plane is in front of it
+		float maxT = 0.0f;
+		for (size_t i = 0; i < normals.size(); i++) {
+			float t = glm::dot(result.center - corners[i], normals[i]) / glm::dot(axis, normals[i]);
+			maxT = std::max(maxT, t);
+		}
+
+		result.coneApex = result.center - axis * maxT;
+		result.coneAxis = axis;
+		result.coneCutoff = std::sqrt(1.0f - minDot * minDot);
+	}
+
+	// Cluster one level of detail, writing its reordered indices back in place
+	static void buildRange(Mesh& mesh, MeshLod& lod, uint32_t maxVertices, uint32_t maxTriangles) {
+		const uint32_t none = std::numeric_limits<uint32_t>::max();
+		const std::vector<uint32_t> indices(mesh.indices.begin() + lod.firstIndex, mesh.indices.begin() + lod.firstIndex + lod.indexCount);
+		uint32_t triangleCount = static_cast<uint32_t>(indices.size() / 3);
+		uint32_t vertexCount = static_cast<uint32_t>(mesh.vertices.size());
+
+		// Triangles using each vertex, so clusters can grow across shared edges
+		std::vector<uint32_t> adjacencyOffsets(vertexCount + 1, 0);
+		for (uint32_t index : indices) {
+			adjacencyOffsets[index + 1]++;
+		}
+		for (uint32_t i = 0; i < vertexCount; i++) {
+			adjacencyOffsets[i + 1] += adjacencyOffsets[i];
+		}
+		std::vector<uint32_t> adjacency(indices.size());
+		std::vector<uint32_t> cursor(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+		for (uint32_t i = 0; i < indices.size(); i++) {
+			adjacency[cursor[indices[i]]++] = i / 3;
+		}
+
+		std::vector<glm::vec3> centroids(triangleCount);
+		for (uint32_t i = 0; i < triangleCount; i++) {
+			centroids[i] = (mesh.vertices[indices[i * 3 + 0]].pos + mesh.vertices[indices[i * 3 + 1]].pos + mesh.vertices[indices[i * 3 + 2]].pos) / 3.0f;
+		}
+
+		std::vector<bool> emitted(triangleCount, false);
+		std::vector<bool> inMeshlet(vertexCount, false);
+		std::vector<uint32_t> meshletVertices;
+		std::vector<uint32_t> reordered;
+		reordered.reserve(indices.size());
+		lod.firstMeshlet = static_cast<uint32_t>(mesh.meshlets.size());
+
+		uint32_t nextSeed = 0;
+		uint32_t seed = none;
+
+		while (true) {
+			// Continue next to the previous meshlet when possible, else take the first unused triangle
+			if (seed == none) {
+				while (nextSeed < triangleCount && emitted[nextSeed]) {
+					nextSeed++;
+				}
+				if (nextSeed == triangleCount) {
+					break;
+				}
+				seed = nextSeed;
+			}
+
+			Meshlet current;
+			current.firstIndex = static_cast<uint32_t>(reordered.size());
+			glm::vec3 centroidSum = glm::vec3(0.0f);
+			uint32_t triangles = 0;
+
+			// Greedily add the neighbour that brings in the fewest new vertices, closest to the center
+			uint32_t candidate = seed;
+			while (candidate != none) {
+				emitted[candidate] = true;
+				for (uint32_t corner = 0; corner < 3; corner++) {
+					uint32_t index = indices[candidate * 3 + corner];
+					reordered.push_back(index);
+					if (!inMeshlet[index]) {
+						inMeshlet[index] = true;
+						meshletVertices.push_back(index);
+					}
+				}
+				centroidSum += centroids[candidate];
+				triangles++;
+
+				if (triangles == maxTriangles) {
+					break;
+				}
+
+				glm::vec3 center = centroidSum / static_cast<float>(triangles);
+				candidate = none;
+				uint32_t bestNewVertices = 4;
+				float bestDistance = std::numeric_limits<float>::max();
+
+				for (uint32_t vertex : meshletVertices) {
+					for (uint32_t a = adjacencyOffsets[vertex]; a < adjacencyOffsets[vertex + 1]; a++) {
+						uint32_t triangle = adjacency[a];
+						if (emitted[triangle]) {
+							continue;
+						}
+
+						uint32_t newVertices = 0;
+						for (uint32_t corner = 0; corner < 3; corner++) {
+							newVertices += inMeshlet[indices[triangle * 3 + corner]] ? 0 : 1;
+						}
+						if (meshletVertices.size() + newVertices > maxVertices) {
+							continue;
+						}
+
+						glm::vec3 offset = centroids[triangle] - center;
+						float distance = glm::dot(offset, offset);
+						if (newVertices < bestNewVertices || (newVertices == bestNewVertices && distance < bestDistance)) {
+							candidate = triangle;
+							bestNewVertices = newVertices;
+							bestDistance = distance;
+						}
+					}
+				}
+			}
+
+			// Any unused neighbour seeds the next meshlet
+			seed = none;
+			for (uint32_t vertex : meshletVertices) {
+				for (uint32_t a = adjacencyOffsets[vertex]; a < adjacencyOffsets[vertex + 1] && seed == none; a++) {
+					if (!emitted[adjacency[a]]) {
+						seed = adjacency[a];
+					}
+				}
+				inMeshlet[vertex] = false;
+			}
+
+			current.indexCount = triangles * 3;
+			current.vertexCount = static_cast<uint32_t>(meshletVertices.size());
+			computeBounds(mesh, reordered.data() + current.firstIndex, current.indexCount, current);
+			current.firstIndex += lod.firstIndex;
+			mesh.meshlets.push_back(current);
+
+			meshletVertices.clear();
+		}
+
+		std::copy(reordered.begin(), reordered.end(), mesh.indices.begin() + lod.firstIndex);
+		lod.meshletCount = static_cast<uint32_t>(mesh.meshlets.size()) - lod.firstMeshlet;
+	}
+
+	void build(Mesh& mesh, uint32_t maxVertices, uint32_t maxTriangles) {
+		if (mesh.lods.empty()) {
+			MeshLod full;
+			full.indexCount = static_cast<uint32_t>(mesh.indices.size());
+			mesh.lods.push_back(full);
+		}
+
+		mesh.meshlets.clear();
+		for (auto& lod : mesh.lods) {
+			buildRange(mesh, lod, maxVertices, maxTriangles);
+		}
+	}
+
+}
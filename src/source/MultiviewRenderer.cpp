@@ -0,0 +1,486 @@
+#include "MultiviewRenderer.h"
+
+#include "Vertex.h"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+MultiviewRenderer::MultiviewRenderer(VkDevice logicalDevice, VkPhysicalDevice physical, const AssetLoader& assets, const Config& multiviewConfig) :
+	device(logicalDevice),
+	physicalDevice(physical),
+	config(multiviewConfig) {
+
+	// Groups as even as the largest one allows, the last drawing what the others leave. Views past the cameras
+	// set draw the last camera again
+	viewCount = std::min(std::max(config.views, 1u), MAX_MULTIVIEW_VIEWS);
+	if (config.maxGroupViews > 0) {
+		uint32_t maxGroup = std::min(config.maxGroupViews, 32u);
+		uint32_t groups = (viewCount + maxGroup - 1) / maxGroup;
+		groupViews = (viewCount + groups - 1) / groups;
+		lastGroupViews = viewCount - (groups - 1) * groupViews;
+	}
+
+	color = vkutil::createImageArray(device, physicalDevice, config.extent, viewCount, COLOR_FORMAT,
+		VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT, VK_IMAGE_ASPECT_COLOR_BIT);
+	depth = vkutil::createImageArray(device, physicalDevice, config.extent, viewCount, config.depthFormat,
+		VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT, VK_IMAGE_ASPECT_DEPTH_BIT);
+
+	viewPass = createRenderPass(0);
+	for (uint32_t layer = 0; layer < viewCount; layer++) {
+		layerViews.push_back(vkutil::createLayerView(device, color.image, COLOR_FORMAT, VK_IMAGE_ASPECT_COLOR_BIT, layer, 1));
+		layerViews.push_back(vkutil::createLayerView(device, depth.image, config.depthFormat, VK_IMAGE_ASPECT_DEPTH_BIT, layer, 1));
+	}
+
+	// A multiview framebuffer has a single layer, the view mask picks the attachment layers drawn
+	if (groupViews > 0) {
+		multiviewPass = createRenderPass((1u << groupViews) - 1);
+		if (lastGroupViews != groupViews) {
+			lastGroupPass = createRenderPass((1u << lastGroupViews) - 1);
+		}
+		for (uint32_t first = 0; first < viewCount; first += groupViews) {
+			uint32_t layers = std::min(groupViews, viewCount - first);
+			groupLayerViews.push_back(vkutil::createLayerView(device, color.image, COLOR_FORMAT, VK_IMAGE_ASPECT_COLOR_BIT, first, layers));
+			groupLayerViews.push_back(vkutil::createLayerView(device, depth.image, config.depthFormat, VK_IMAGE_ASPECT_DEPTH_BIT, first, layers));
+		}
+	}
+
+	for (auto* target : { &viewFramebuffers, &groupFramebuffers }) {
+		bool multiview = target == &groupFramebuffers;
+		const std::vector<VkImageView>& views = multiview ? groupLayerViews : layerViews;
+		for (size_t i = 0; i < views.size(); i += 2) {
+			VkFramebufferCreateInfo framebufferInfo = {};
+			framebufferInfo.sType			= VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+			framebufferInfo.renderPass		= multiview ? groupPass(static_cast<uint32_t>(i / 2)) : viewPass;
+			framebufferInfo.attachmentCount = 2;
+			framebufferInfo.pAttachments	= &views[i];
+			framebufferInfo.width			= config.extent.width;
+			framebufferInfo.height			= config.extent.height;
+			framebufferInfo.layers			= 1;
+
+			VkFramebuffer framebuffer;
+			if (vkCreateFramebuffer(device, &framebufferInfo, nullptr, &framebuffer) != VK_SUCCESS) {
+				throw std::runtime_error("Failed to create multiview framebuffer.");
+			}
+			target->push_back(framebuffer);
+		}
+	}
+
+	// Cameras, objects and the object of every instance
+	VkDescriptorSetLayoutBinding bindings[3] = {};
+	for (uint32_t i = 0; i < 3; i++) {
+		bindings[i].binding			= i;
+		bindings[i].descriptorType	= i == 0 ? VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER : VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		bindings[i].descriptorCount = 1;
+		bindings[i].stageFlags		= VK_SHADER_STAGE_VERTEX_BIT | (i == 0 ? VK_SHADER_STAGE_FRAGMENT_BIT : 0);
+	}
+
+	VkDescriptorSetLayoutCreateInfo layoutInfo = {};
+	layoutInfo.sType		= VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	layoutInfo.bindingCount = 3;
+	layoutInfo.pBindings	= bindings;
+
+	if (vkCreateDescriptorSetLayout(device, &layoutInfo, nullptr, &setLayout) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create multiview descriptor set layout.");
+	}
+
+	VkDescriptorPoolSize poolSizes[2] = {};
+	poolSizes[0].type			 = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+	poolSizes[0].descriptorCount = 1;
+	poolSizes[1].type			 = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	poolSizes[1].descriptorCount = 2;
+
+	VkDescriptorPoolCreateInfo poolInfo = {};
+	poolInfo.sType		   = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+	poolInfo.poolSizeCount = 2;
+	poolInfo.pPoolSizes	   = poolSizes;
+	poolInfo.maxSets	   = 1;
+
+	if (vkCreateDescriptorPool(device, &poolInfo, nullptr, &descriptorPool) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create multiview descriptor pool.");
+	}
+
+	VkDescriptorSetAllocateInfo allocInfo = {};
+	allocInfo.sType				 = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+	allocInfo.descriptorPool	 = descriptorPool;
+	allocInfo.descriptorSetCount = 1;
+	allocInfo.pSetLayouts		 = &setLayout;
+
+	if (vkAllocateDescriptorSets(device, &allocInfo, &descriptorSet) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to allocate multiview descriptor set.");
+	}
+
+	viewBuffer = vkutil::createBuffer(device, physicalDevice, sizeof(MultiviewData), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+	memset(viewBuffer.mapped, 0, sizeof(MultiviewData));
+
+	VkDescriptorBufferInfo bufferInfo = {};
+	bufferInfo.buffer = viewBuffer.buffer;
+	bufferInfo.offset = 0;
+	bufferInfo.range  = VK_WHOLE_SIZE;
+
+	VkWriteDescriptorSet write = {};
+	write.sType			  = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	write.dstSet		  = descriptorSet;
+	write.dstBinding	  = 0;
+	write.descriptorCount = 1;
+	write.descriptorType  = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+	write.pBufferInfo	  = &bufferInfo;
+	vkUpdateDescriptorSets(device, 1, &write, 0, nullptr);
+
+	VkPushConstantRange pushConstantRange = {};
+	pushConstantRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+	pushConstantRange.offset	 = 0;
+	pushConstantRange.size		 = sizeof(MultiviewPushConstants);
+
+	VkPipelineLayoutCreateInfo pipelineLayoutInfo = {};
+	pipelineLayoutInfo.sType				  = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+	pipelineLayoutInfo.setLayoutCount		  = 1;
+	pipelineLayoutInfo.pSetLayouts			  = &setLayout;
+	pipelineLayoutInfo.pushConstantRangeCount = 1;
+	pipelineLayoutInfo.pPushConstantRanges	  = &pushConstantRange;
+
+	if (vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &pipelineLayout) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create multiview pipeline layout.");
+	}
+
+	// The single view shader never reads gl_ViewIndex, so it runs on devices without multiview
+	viewPipeline = createPipeline(assets, "src/shaders/multiview_single_vert.spv", viewPass);
+	if (groupViews > 0) {
+		multiviewPipeline = createPipeline(assets, "src/shaders/multiview_vert.spv", multiviewPass);
+	}
+	if (lastGroupPass != VK_NULL_HANDLE) {
+		lastGroupPipeline = createPipeline(assets, "src/shaders/multiview_vert.spv", lastGroupPass);
+	}
+}
+
+bool MultiviewRenderer::isSupported(VkPhysicalDevice physicalDevice, PFN_vkGetPhysicalDeviceFeatures2KHR getFeatures2) {
+	if (getFeatures2 == nullptr || !vkutil::hasDeviceExtension(physicalDevice, VK_KHR_MULTIVIEW_EXTENSION_NAME)) {
+		return false;
+	}
+
+	VkPhysicalDeviceMultiviewFeaturesKHR multiviewFeatures = {};
+	multiviewFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MULTIVIEW_FEATURES_KHR;
+
+	VkPhysicalDeviceFeatures2KHR features2 = {};
+	features2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2_KHR;
+	features2.pNext = &multiviewFeatures;
+	getFeatures2(physicalDevice, &features2);
+
+	return multiviewFeatures.multiview == VK_TRUE;
+}
+
+uint32_t MultiviewRenderer::maxViewCount(VkPhysicalDevice physicalDevice, PFN_vkGetPhysicalDeviceProperties2KHR getProperties2) {
+	if (getProperties2 == nullptr) {
+		return 0;
+	}
+
+	VkPhysicalDeviceMultiviewPropertiesKHR multiviewProperties = {};
+	multiviewProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MULTIVIEW_PROPERTIES_KHR;
+
+	VkPhysicalDeviceProperties2KHR properties2 = {};
+	properties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2_KHR;
+	properties2.pNext = &multiviewProperties;
+	getProperties2(physicalDevice, &properties2);
+
+	return multiviewProperties.maxMultiviewViewCount;
+}
+
+VkRenderPass MultiviewRenderer::createRenderPass(uint32_t viewMask) const {
+	// Cleared every time, only the color is kept
+	VkAttachmentDescription attachments[2] = {};
+	attachments[0].format		  = COLOR_FORMAT;
+	attachments[0].samples		  = VK_SAMPLE_COUNT_1_BIT;
+	attachments[0].loadOp		  = VK_ATTACHMENT_LOAD_OP_CLEAR;
+	attachments[0].storeOp		  = VK_ATTACHMENT_STORE_OP_STORE;
+	attachments[0].stencilLoadOp  = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+	attachments[0].stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+	attachments[0].initialLayout  = VK_IMAGE_LAYOUT_UNDEFINED;
+	attachments[0].finalLayout	  = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+	attachments[1]				  = attachments[0];
+	attachments[1].format		  = config.depthFormat;
+	attachments[1].storeOp		  = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+	attachments[1].finalLayout	  = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+	VkAttachmentReference colorReference = { 0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL };
+	VkAttachmentReference depthReference = { 1, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL };
+
+	VkSubpassDescription subpass = {};
+	subpass.pipelineBindPoint		= VK_PIPELINE_BIND_POINT_GRAPHICS;
+	subpass.colorAttachmentCount	= 1;
+	subpass.pColorAttachments		= &colorReference;
+	subpass.pDepthStencilAttachment = &depthReference;
+
+	// Orders the clears after whatever drew or copied the same layers before
+	VkSubpassDependency dependency = {};
+	dependency.srcSubpass	 = VK_SUBPASS_EXTERNAL;
+	dependency.dstSubpass	 = 0;
+	dependency.srcStageMask	 = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT |
+		VK_PIPELINE_STAGE_TRANSFER_BIT;
+	dependency.dstStageMask	 = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
+	dependency.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+	dependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+
+	// Every draw is broadcast to the layers of the view mask. Views are not correlated, they look every which way
+	VkRenderPassMultiviewCreateInfoKHR multiviewInfo = {};
+	multiviewInfo.sType		   = VK_STRUCTURE_TYPE_RENDER_PASS_MULTIVIEW_CREATE_INFO_KHR;
+	multiviewInfo.subpassCount = 1;
+	multiviewInfo.pViewMasks   = &viewMask;
+
+	VkRenderPassCreateInfo renderPassInfo = {};
+	renderPassInfo.sType		   = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+	renderPassInfo.pNext		   = viewMask != 0 ? &multiviewInfo : nullptr;
+	renderPassInfo.attachmentCount = 2;
+	renderPassInfo.pAttachments	   = attachments;
+	renderPassInfo.subpassCount	   = 1;
+	renderPassInfo.pSubpasses	   = &subpass;
+	renderPassInfo.dependencyCount = 1;
+	renderPassInfo.pDependencies   = &dependency;
+
+	VkRenderPass renderPass;
+	if (vkCreateRenderPass(device, &renderPassInfo, nullptr, &renderPass) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create multiview render pass.");
+	}
+	return renderPass;
+}
+
+VkPipeline MultiviewRenderer::createPipeline(const AssetLoader& assets, const char* vertexShader, VkRenderPass compatiblePass) const {
+	VkShaderModule vertShaderModule = vkutil::createShaderModule(device, assets.load(vertexShader));
+	VkShaderModule fragShaderModule = vkutil::createShaderModule(device, assets.load("src/shaders/multiview_frag.spv"));
+
+	VkPipelineShaderStageCreateInfo shaderStages[2] = {};
+	shaderStages[0].sType  = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	shaderStages[0].stage  = VK_SHADER_STAGE_VERTEX_BIT;
+	shaderStages[0].module = vertShaderModule;
+	shaderStages[0].pName  = "main";
+	shaderStages[1].sType  = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	shaderStages[1].stage  = VK_SHADER_STAGE_FRAGMENT_BIT;
+	shaderStages[1].module = fragShaderModule;
+	shaderStages[1].pName  = "main";
+
+	// The scene's vertices, of which only the positions and normals are read
+	auto bindingDescription = Vertex::getBindingDescription();
+	auto attributeDescriptions = Vertex::getAttributeDescriptions();
+
+	VkPipelineVertexInputStateCreateInfo vertexInputInfo = {};
+	vertexInputInfo.sType							= VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+	vertexInputInfo.vertexBindingDescriptionCount	= 1;
+	vertexInputInfo.pVertexBindingDescriptions		= &bindingDescription;
+	vertexInputInfo.vertexAttributeDescriptionCount = 2;
+	vertexInputInfo.pVertexAttributeDescriptions	= attributeDescriptions.data();
+
+	VkPipelineInputAssemblyStateCreateInfo inputAssembly = {};
+	inputAssembly.sType	   = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+	inputAssembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+
+	VkViewport viewport = {};
+	viewport.width	  = static_cast<float>(config.extent.width);
+	viewport.height	  = static_cast<float>(config.extent.height);
+	viewport.maxDepth = 1.0f;
+
+	VkRect2D scissor = {};
+	scissor.extent = config.extent;
+
+	VkPipelineViewportStateCreateInfo viewportState = {};
+	viewportState.sType			= VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+	viewportState.viewportCount = 1;
+	viewportState.pViewports	= &viewport;
+	viewportState.scissorCount	= 1;
+	viewportState.pScissors		= &scissor;
+
+	VkPipelineRasterizationStateCreateInfo rasterizer = {};
+	rasterizer.sType	   = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+	rasterizer.polygonMode = VK_POLYGON_MODE_FILL;
+	rasterizer.lineWidth   = 1.0f;
+	rasterizer.cullMode	   = VK_CULL_MODE_BACK_BIT;
+	rasterizer.frontFace   = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+
+	VkPipelineMultisampleStateCreateInfo multisampling = {};
+	multisampling.sType				   = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+	multisampling.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+
+	VkPipelineDepthStencilStateCreateInfo depthStencil = {};
+	depthStencil.sType			  = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+	depthStencil.depthTestEnable  = VK_TRUE;
+	depthStencil.depthWriteEnable = VK_TRUE;
+	depthStencil.depthCompareOp	  = VK_COMPARE_OP_LESS;
+
+	VkPipelineColorBlendAttachmentState colorBlendAttachment = {};
+	colorBlendAttachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT |
+		VK_COLOR_COMPONENT_A_BIT;
+
+	VkPipelineColorBlendStateCreateInfo colorBlending = {};
+	colorBlending.sType			  = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+	colorBlending.attachmentCount = 1;
+	colorBlending.pAttachments	  = &colorBlendAttachment;
+
+	VkGraphicsPipelineCreateInfo pipelineInfo = {};
+	pipelineInfo.sType				 = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+	pipelineInfo.stageCount			 = 2;
+	pipelineInfo.pStages			 = shaderStages;
+	pipelineInfo.pVertexInputState	 = &vertexInputInfo;
+	pipelineInfo.pInputAssemblyState = &inputAssembly;
+	pipelineInfo.pViewportState		 = &viewportState;
+	pipelineInfo.pRasterizationState = &rasterizer;
+	pipelineInfo.pMultisampleState	 = &multisampling;
+	pipelineInfo.pDepthStencilState	 = &depthStencil;
+	pipelineInfo.pColorBlendState	 = &colorBlending;
+	pipelineInfo.layout				 = pipelineLayout;
+	pipelineInfo.renderPass			 = compatiblePass;
+	pipelineInfo.subpass			 = 0;
+
+	VkPipeline pipeline;
+	if (vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &pipeline) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create multiview pipeline.");
+	}
+	vkDestroyShaderModule(device, fragShaderModule, nullptr);
+	vkDestroyShaderModule(device, vertShaderModule, nullptr);
+	return pipeline;
+}
+
+void MultiviewRenderer::setScene(const std::vector<ObjectData>& objects, const std::vector<MeshData>& meshes,
+	const std::vector<LodData>& lods, VkBuffer objectBuffer, VkBuffer vertexBuffer, VkBuffer indexBuffer) {
+
+	// Only the meshes differ between draws, every object shares the set and the pipeline
+	batcher.clear();
+	for (uint32_t i = 0; i < objects.size(); i++) {
+		batcher.add(DrawBatcher::makeKey(0, 0, 0, objects[i].meshIndex, 0.0f), i);
+	}
+	batcher.build();
+
+	viewTables = DrawBatcher::Tables();
+	viewTables.layout	   = pipelineLayout;
+	viewTables.materialSet = 0;
+	viewTables.materials   = { { descriptorSet } };
+	for (const auto& mesh : meshes) {
+		const LodData& lod = lods[mesh.firstLod];
+		viewTables.meshes.push_back({ vertexBuffer, indexBuffer, lod.indexCount, lod.firstIndex, mesh.vertexOffset });
+	}
+	multiviewTables = viewTables;
+	lastGroupTables = viewTables;
+	viewTables.pipelines	  = { viewPipeline };
+	multiviewTables.pipelines = { multiviewPipeline };
+	lastGroupTables.pipelines = { lastGroupPipeline };
+
+	// Host visible, it is written once and read by every view
+	const std::vector<uint32_t>& instances = batcher.getInstances();
+	VkDeviceSize instanceSize = sizeof(uint32_t) * std::max<size_t>(instances.size(), 1);
+	vkutil::destroyBuffer(device, instanceBuffer);
+	instanceBuffer = vkutil::createBuffer(device, physicalDevice, instanceSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+	memcpy(instanceBuffer.mapped, instances.data(), sizeof(uint32_t) * instances.size());
+
+	VkDescriptorBufferInfo bufferInfos[2] = {};
+	const VkBuffer buffers[2] = { objectBuffer, instanceBuffer.buffer };
+	VkWriteDescriptorSet writes[2] = {};
+	for (uint32_t i = 0; i < 2; i++) {
+		bufferInfos[i].buffer = buffers[i];
+		bufferInfos[i].offset = 0;
+		bufferInfos[i].range  = VK_WHOLE_SIZE;
+
+		writes[i].sType			  = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		writes[i].dstSet		  = descriptorSet;
+		writes[i].dstBinding	  = i + 1;
+		writes[i].descriptorCount = 1;
+		writes[i].descriptorType  = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		writes[i].pBufferInfo	  = &bufferInfos[i];
+	}
+	vkUpdateDescriptorSets(device, 2, writes, 0, nullptr);
+}
+
+void MultiviewRenderer::setViews(const std::vector<glm::mat4>& viewProj, glm::vec3 lightDirection) {
+	MultiviewData* data = static_cast<MultiviewData*>(viewBuffer.mapped);
+	for (uint32_t view = 0; view < viewCount && !viewProj.empty(); view++) {
+		data->viewProj[view] = viewProj[std::min<size_t>(view, viewProj.size() - 1)];
+	}
+	data->lightDirection = glm::vec4(glm::normalize(lightDirection), 0.0f);
+}
+
+VkRenderPass MultiviewRenderer::groupPass(uint32_t group) const {
+	bool last = group + 1 == (viewCount + groupViews - 1) / groupViews;
+	return last && lastGroupPass != VK_NULL_HANDLE ? lastGroupPass : multiviewPass;
+}
+
+void MultiviewRenderer::beginRenderPass(VkCommandBuffer commandBuffer, VkRenderPass pass, VkFramebuffer framebuffer, uint32_t viewOffset) const {
+	VkClearValue clearValues[2] = {};
+	clearValues[0].color		= { { 0.45f, 0.6f, 0.8f, 1.0f } };
+	clearValues[1].depthStencil = { 1.0f, 0 };
+
+	VkRenderPassBeginInfo beginInfo = {};
+	beginInfo.sType				= VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+	beginInfo.renderPass		= pass;
+	beginInfo.framebuffer		= framebuffer;
+	beginInfo.renderArea.extent = config.extent;
+	beginInfo.clearValueCount	= 2;
+	beginInfo.pClearValues		= clearValues;
+	vkCmdBeginRenderPass(commandBuffer, &beginInfo, VK_SUBPASS_CONTENTS_INLINE);
+
+	MultiviewPushConstants constants = {};
+	constants.viewOffset = viewOffset;
+	vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(constants), &constants);
+}
+
+MultiviewRenderer::Stats MultiviewRenderer::recordMultiview(VkCommandBuffer commandBuffer) const {
+	if (groupViews == 0) {
+		throw std::runtime_error("Multiview is not enabled on this device.");
+	}
+
+	Stats stats;
+	for (uint32_t group = 0; group < groupFramebuffers.size(); group++) {
+		VkRenderPass pass = groupPass(group);
+		beginRenderPass(commandBuffer, pass, groupFramebuffers[group], group * groupViews);
+		DrawBatcher::Stats draws = batcher.record(commandBuffer, pass == lastGroupPass ? lastGroupTables : multiviewTables, 0);
+		vkCmdEndRenderPass(commandBuffer);
+
+		stats.renderPasses++;
+		stats.draws.draws += draws.draws;
+		stats.draws.pipelineBinds += draws.pipelineBinds;
+		stats.draws.descriptorBinds += draws.descriptorBinds;
+		stats.draws.vertexBufferBinds += draws.vertexBufferBinds;
+		stats.draws.indexBufferBinds += draws.indexBufferBinds;
+	}
+	return stats;
+}
+
+MultiviewRenderer::Stats MultiviewRenderer::recordView(VkCommandBuffer commandBuffer, uint32_t view) const {
+	Stats stats;
+	beginRenderPass(commandBuffer, viewPass, viewFramebuffers[view], view);
+	stats.draws = batcher.record(commandBuffer, viewTables, 0);
+	vkCmdEndRenderPass(commandBuffer);
+	stats.renderPasses = 1;
+	return stats;
+}
+
+void MultiviewRenderer::destroy() {
+	for (auto* pipeline : { &viewPipeline, &multiviewPipeline, &lastGroupPipeline }) {
+		vkDestroyPipeline(device, *pipeline, nullptr);
+		*pipeline = VK_NULL_HANDLE;
+	}
+	vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
+	vkDestroyDescriptorPool(device, descriptorPool, nullptr);
+	vkDestroyDescriptorSetLayout(device, setLayout, nullptr);
+	pipelineLayout = VK_NULL_HANDLE;
+	descriptorPool = VK_NULL_HANDLE;
+	setLayout = VK_NULL_HANDLE;
+	vkutil::destroyBuffer(device, viewBuffer);
+	vkutil::destroyBuffer(device, instanceBuffer);
+
+	for (auto* framebuffers : { &viewFramebuffers, &groupFramebuffers }) {
+		for (VkFramebuffer framebuffer : *framebuffers) {
+			vkDestroyFramebuffer(device, framebuffer, nullptr);
+		}
+		framebuffers->clear();
+	}
+	for (auto* views : { &layerViews, &groupLayerViews }) {
+		for (VkImageView view : *views) {
+			vkDestroyImageView(device, view, nullptr);
+		}
+		views->clear();
+	}
+	for (auto* pass : { &viewPass, &multiviewPass, &lastGroupPass }) {
+		vkDestroyRenderPass(device, *pass, nullptr);
+		*pass = VK_NULL_HANDLE;
+	}
+	vkutil::destroyImage(device, color);
+	vkutil::destroyImage(device, depth);
+}
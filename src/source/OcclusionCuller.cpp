@@ -0,0 +1,162 @@
+#include "OcclusionCuller.h"
+#include "Camera.h"
+
+#include <glm/gtc/constants.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+
+OcclusionCuller::OcclusionCuller(const Scene& scene, ThreadPool& pool) :
+	threadPool(pool),
+	rasterizer(RASTER_WIDTH, RASTER_HEIGHT, pool) {
+
+	boundingSpheres.reserve(scene.objects.size());
+	for (const auto& object : scene.objects) {
+		boundingSpheres.push_back(scene.getBoundingSphere(object));
+
+		if (!object.occluder) {
+			continue;
+		}
+
+		// Only the full detail level, the rest of the index list holds the coarser ones
+		const Mesh& mesh = scene.meshes[object.meshIndex];
+		uint32_t firstIndex = mesh.lods.empty() ? 0 : mesh.lods[0].firstIndex;
+		uint32_t indexCount = mesh.lods.empty() ? static_cast<uint32_t>(mesh.indices.size()) : mesh.lods[0].indexCount;
+		for (uint32_t i = firstIndex; i < firstIndex + indexCount; i++) {
+			occluderTriangles.push_back(glm::vec3(object.model * glm::vec4(mesh.vertices[mesh.indices[i]].pos, 1.0f)));
+		}
+	}
+}
+
+OcclusionCuller::Stats OcclusionCuller::cull(const CameraData& camera, std::vector<uint8_t>& visible) {
+	using Clock = std::chrono::high_resolution_clock;
+	auto toMs = [](Clock::duration duration) {
+		return std::chrono::duration<double, std::milli>(duration).count();
+	};
+
+	Stats stats;
+	uint32_t objectCount = static_cast<uint32_t>(boundingSpheres.size());
+	visible.assign(objectCount, 0);
+
+	auto rasterStart = Clock::now();
+	rasterizer.renderOccluders(occluderTriangles, camera.viewProj);
+	auto testStart = Clock::now();
+
+	std::atomic<uint32_t> frustumVisible(0);
+	std::atomic<uint32_t> occlusionVisible(0);
+
+	threadPool.parallelFor(objectCount, 256, [&](uint32_t begin, uint32_t end) {
+		uint32_t frustumCount = 0;
+		uint32_t visibleCount = 0;
+
+		for (uint32_t i = begin; i < end; i++) {
+			const glm::vec4& sphere = boundingSpheres[i];
+
+			bool insideFrustum = true;
+			for (const auto& plane : camera.frustumPlanes) {
+				if (glm::dot(glm::vec3(plane), glm::vec3(sphere)) + plane.w < -sphere.w) {
+					insideFrustum = false;
+					break;
+				}
+			}
+			if (!insideFrustum) {
+				continue;
+			}
+			frustumCount++;
+
+			if (!rasterizer.isOccluded(sphere, camera.view, camera.proj, camera.projParams.x)) {
+				visible[i] = 1;
+				visibleCount++;
+			}
+		}
+
+		frustumVisible += frustumCount;
+		occlusionVisible += visibleCount;
+	});
+
+	auto testEnd = Clock::now();
+
+	stats.frustumVisible = frustumVisible;
+	stats.visible = occlusionVisible;
+	stats.rasterMs = toMs(testStart - rasterStart);
+	stats.testMs = toMs(testEnd - testStart);
+
+	return stats;
+}
+
+bool OcclusionCuller::runValidation(const AppSettings& settings) {
+	const uint32_t viewCount = 64;
+	const float aspect = 16.0f / 9.0f;
+
+	Scene scene = Scene::createCity(settings.gridSize);
+	ThreadPool threadPool;
+
+	OcclusionCuller reference(scene, threadPool);
+	reference.getRasterizer().setImplementation(OcclusionRasterizer::Implementation::Scalar);
+
+	std::cout << "Occlusion check: " << scene.objects.size() << " objects, " << reference.occluderTriangles.size() / 3
+		<< " occluder triangles, " << reference.rasterizer.getWidth() << "x" << reference.rasterizer.getHeight()
+		<< " depth buffer, " << threadPool.getThreadCount() + 1 << " threads" << std::endl;
+
+	OcclusionRasterizer::Implementation implementations[] = {
+		OcclusionRasterizer::Implementation::Scalar,
+		OcclusionRasterizer::Implementation::SSE,
+		OcclusionRasterizer::Implementation::AVX2,
+	};
+
+	bool passed = true;
+	for (auto implementation : implementations) {
+		OcclusionCuller culler(scene, threadPool);
+		try {
+			culler.getRasterizer().setImplementation(implementation);
+		} catch (const std::exception& e) {
+			std::cout << "  " << e.what() << ", skipped" << std::endl;
+			continue;
+		}
+
+		Stats total;
+		float maxDepthDifference = 0.0f;
+		uint32_t mismatches = 0;
+		std::vector<uint8_t> expected;
+		std::vector<uint8_t> visible;
+
+		// Same orbit the application flies, the reference runs first so both see the same view
+		for (uint32_t view = 0; view < viewCount; view++) {
+			Camera camera;
+			camera.orbit(view * glm::two_pi<float>() / viewCount, scene.extent * 0.6f);
+			camera.farPlane = scene.extent * 4.0f;
+			CameraData data = camera.getCameraData(aspect);
+
+			reference.cull(data, expected);
+			Stats stats = culler.cull(data, visible);
+
+			const auto& expectedDepth = reference.rasterizer.getDepth();
+			const auto& depth = culler.rasterizer.getDepth();
+			for (size_t i = 0; i < depth.size(); i++) {
+				maxDepthDifference = std::max(maxDepthDifference, std::abs(depth[i] - expectedDepth[i]));
+			}
+			for (size_t i = 0; i < visible.size(); i++) {
+				mismatches += visible[i] != expected[i] ? 1 : 0;
+			}
+
+			total.frustumVisible += stats.frustumVisible;
+			total.visible += stats.visible;
+			total.rasterMs += stats.rasterMs;
+			total.testMs += stats.testMs;
+		}
+
+		double culledBeyondFrustum = 100.0 * (1.0 - total.visible / static_cast<double>(std::max(total.frustumVisible, 1u)));
+		std::cout << "  " << OcclusionRasterizer::implementationName(implementation)
+			<< ": raster " << total.rasterMs / viewCount << " ms, test " << total.testMs / viewCount << " ms"
+			<< ", visible " << total.visible / viewCount << " / frustum " << total.frustumVisible / viewCount
+			<< " (" << culledBeyondFrustum << "% occluded)"
+			<< ", max depth difference " << maxDepthDifference << ", visibility mismatches " << mismatches << std::endl;
+
+		passed = passed && maxDepthDifference <= 1e-6f && mismatches == 0;
+	}
+
+	std::cout << (passed ? "Occlusion check passed" : "Occlusion check FAILED") << std::endl;
+	return passed;
+}
@@ -0,0 +1,424 @@
+#include "OcclusionRasterizer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <string>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define OCCLUSION_HAS_SSE 1
+#include <emmintrin.h>
+#endif
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#endif
+
+namespace occlusion {
+
+	/// * * * * * SCALAR REFERENCE * * * * * ///
+
+	// Straightforward per pixel loops. Every other implementation must produce the same depth buffer
+
+	static void rasterizeRowsScalar(const TriangleSetup& triangle, float* depth, uint32_t width, int rowBegin, int rowEnd) {
+		int yBegin = std::max(triangle.minY, rowBegin);
+		int yEnd = std::min(triangle.maxY + 1, rowEnd);
+
+		for (int y = yBegin; y < yEnd; y++) {
+			float py = y + 0.5f;
+			float* row = depth + y * width;
+
+			for (int x = triangle.minX; x <= triangle.maxX; x++) {
+				float px = x + 0.5f;
+
+				float e0 = triangle.edgeA[0] * px + triangle.edgeB[0] * py + triangle.edgeC[0];
+				float e1 = triangle.edgeA[1] * px + triangle.edgeB[1] * py + triangle.edgeC[1];
+				float e2 = triangle.edgeA[2] * px + triangle.edgeB[2] * py + triangle.edgeC[2];
+
+				if (e0 >= 0.0f && e1 >= 0.0f && e2 >= 0.0f) {
+					float z = triangle.depthA * px + triangle.depthB * py + triangle.depthC;
+					row[x] = std::min(row[x], z);
+				}
+			}
+		}
+	}
+
+	static float tileMaxScalar(const float* depth, uint32_t width) {
+		float result = 0.0f;
+		for (uint32_t y = 0; y < OcclusionRasterizer::TILE_SIZE; y++) {
+			for (uint32_t x = 0; x < OcclusionRasterizer::TILE_SIZE; x++) {
+				result = std::max(result, depth[y * width + x]);
+			}
+		}
+		return result;
+	}
+
+	static bool anyFartherScalar(const float* depth, uint32_t width, int x0, int y0, int x1, int y1, float nearestDepth) {
+		for (int y = y0; y <= y1; y++) {
+			for (int x = x0; x <= x1; x++) {
+				if (depth[y * width + x] >= nearestDepth) {
+					return true;
+				}
+			}
+		}
+		return false;
+	}
+
+	const Kernels& scalarKernels() {
+		static const Kernels kernels = { rasterizeRowsScalar, tileMaxScalar, anyFartherScalar };
+		return kernels;
+	}
+
+
+
+	/// * * * * * SSE2 * * * * * ///
+
+#ifdef OCCLUSION_HAS_SSE
+
+	// Lanes of x that fall inside [minX, maxX]
+	static inline __m128 spanMaskSSE(__m128i x, int minX, int maxX) {
+		__m128i afterMin = _mm_cmpgt_epi32(x, _mm_set1_epi32(minX - 1));
+		__m128i beforeMax = _mm_cmpgt_epi32(_mm_set1_epi32(maxX + 1), x);
+		return _mm_castsi128_ps(_mm_and_si128(afterMin, beforeMax));
+	}
+
+	static void rasterizeRowsSSE(const TriangleSetup& triangle, float* depth, uint32_t width, int rowBegin, int rowEnd) {
+		int yBegin = std::max(triangle.minY, rowBegin);
+		int yEnd = std::min(triangle.maxY + 1, rowEnd);
+
+		// Rows are a multiple of the tile size wide, so aligned spans of 4 never leave the row
+		int xBegin = triangle.minX & ~3;
+
+		const __m128i laneOffsets = _mm_setr_epi32(0, 1, 2, 3);
+		const __m128 half = _mm_set1_ps(0.5f);
+		const __m128 zero = _mm_setzero_ps();
+
+		__m128 a0 = _mm_set1_ps(triangle.edgeA[0]), a1 = _mm_set1_ps(triangle.edgeA[1]), a2 = _mm_set1_ps(triangle.edgeA[2]);
+		__m128 c0 = _mm_set1_ps(triangle.edgeC[0]), c1 = _mm_set1_ps(triangle.edgeC[1]), c2 = _mm_set1_ps(triangle.edgeC[2]);
+		__m128 depthA = _mm_set1_ps(triangle.depthA);
+		__m128 depthC = _mm_set1_ps(triangle.depthC);
+
+		for (int y = yBegin; y < yEnd; y++) {
+			float py = y + 0.5f;
+			float* row = depth + y * width;
+
+			// Terms constant along the row
+			__m128 b0 = _mm_set1_ps(triangle.edgeB[0] * py);
+			__m128 b1 = _mm_set1_ps(triangle.edgeB[1] * py);
+			__m128 b2 = _mm_set1_ps(triangle.edgeB[2] * py);
+			__m128 depthB = _mm_set1_ps(triangle.depthB * py);
+
+			for (int x = xBegin; x <= triangle.maxX; x += 4) {
+				__m128i xi = _mm_add_epi32(_mm_set1_epi32(x), laneOffsets);
+				__m128 px = _mm_add_ps(_mm_cvtepi32_ps(xi), half);
+
+				__m128 e0 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(a0, px), b0), c0);
+				__m128 e1 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(a1, px), b1), c1);
+				__m128 e2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(a2, px), b2), c2);
+
+				__m128 inside = _mm_and_ps(_mm_and_ps(_mm_cmpge_ps(e0, zero), _mm_cmpge_ps(e1, zero)), _mm_cmpge_ps(e2, zero));
+				inside = _mm_and_ps(inside, spanMaskSSE(xi, triangle.minX, triangle.maxX));
+
+				if (_mm_movemask_ps(inside) == 0) {
+					continue;
+				}
+
+				__m128 z = _mm_add_ps(_mm_add_ps(_mm_mul_ps(depthA, px), depthB), depthC);
+				__m128 old = _mm_loadu_ps(row + x);
+				__m128 nearest = _mm_min_ps(old, z);
+				_mm_storeu_ps(row + x, _mm_or_ps(_mm_and_ps(inside, nearest), _mm_andnot_ps(inside, old)));
+			}
+		}
+	}
+
+	static inline float horizontalMaxSSE(__m128 value) {
+		value = _mm_max_ps(value, _mm_shuffle_ps(value, value, _MM_SHUFFLE(1, 0, 3, 2)));
+		value = _mm_max_ps(value, _mm_shuffle_ps(value, value, _MM_SHUFFLE(2, 3, 0, 1)));
+		return _mm_cvtss_f32(value);
+	}
+
+	static float tileMaxSSE(const float* depth, uint32_t width) {
+		__m128 result = _mm_setzero_ps();
+		for (uint32_t y = 0; y < OcclusionRasterizer::TILE_SIZE; y++) {
+			const float* row = depth + y * width;
+			result = _mm_max_ps(result, _mm_max_ps(_mm_loadu_ps(row), _mm_loadu_ps(row + 4)));
+		}
+		return horizontalMaxSSE(result);
+	}
+
+	static bool anyFartherSSE(const float* depth, uint32_t width, int x0, int y0, int x1, int y1, float nearestDepth) {
+		const __m128i laneOffsets = _mm_setr_epi32(0, 1, 2, 3);
+		const __m128 nearest = _mm_set1_ps(nearestDepth);
+
+		for (int y = y0; y <= y1; y++) {
+			const float* row = depth + y * width;
+
+			for (int x = x0 & ~3; x <= x1; x += 4) {
+				__m128i xi = _mm_add_epi32(_mm_set1_epi32(x), laneOffsets);
+				__m128 farther = _mm_and_ps(_mm_cmpge_ps(_mm_loadu_ps(row + x), nearest), spanMaskSSE(xi, x0, x1));
+
+				if (_mm_movemask_ps(farther) != 0) {
+					return true;
+				}
+			}
+		}
+		return false;
+	}
+
+	const Kernels* sseKernels() {
+		static const Kernels kernels = { rasterizeRowsSSE, tileMaxSSE, anyFartherSSE };
+		return &kernels;
+	}
+
+#else
+
+	const Kernels* sseKernels() {
+		return nullptr;
+	}
+
+#endif
+
+	static bool cpuSupportsAVX2() {
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+		int info[4];
+		__cpuid(info, 1);
+		bool osSavesYmm = (info[2] & (1 << 27)) && (_xgetbv(0) & 0x6) == 0x6;
+		__cpuidex(info, 7, 0);
+		return osSavesYmm && (info[1] & (1 << 5));
+#elif (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+		return __builtin_cpu_supports("avx2");
+#else
+		return false;
+#endif
+	}
+
+}
+
+/// * * * * * RASTERIZER * * * * * ///
+
+OcclusionRasterizer::OcclusionRasterizer(uint32_t targetWidth, uint32_t targetHeight, ThreadPool& pool) :
+	threadPool(pool) {
+
+	tilesX = (targetWidth + TILE_SIZE - 1) / TILE_SIZE;
+	tilesY = (targetHeight + TILE_SIZE - 1) / TILE_SIZE;
+	width = tilesX * TILE_SIZE;
+	height = tilesY * TILE_SIZE;
+
+	depth.assign(width * height, 1.0f);
+	tileMaxDepth.assign(tilesX * tilesY, 1.0f);
+
+	setImplementation(bestImplementation());
+}
+
+OcclusionRasterizer::Implementation OcclusionRasterizer::bestImplementation() {
+	if (occlusion::avx2Kernels() && occlusion::cpuSupportsAVX2()) {
+		return Implementation::AVX2;
+	}
+	if (occlusion::sseKernels()) {
+		return Implementation::SSE;
+	}
+	return Implementation::Scalar;
+}
+
+const char* OcclusionRasterizer::implementationName(Implementation implementation) {
+	switch (implementation) {
+	case Implementation::Scalar:	return "scalar";
+	case Implementation::SSE:		return "sse2";
+	case Implementation::AVX2:		return "avx2";
+	}
+	return "unknown";
+}
+
+void OcclusionRasterizer::setImplementation(Implementation newImplementation) {
+	const occlusion::Kernels* newKernels = nullptr;
+
+	switch (newImplementation) {
+	case Implementation::Scalar:
+		newKernels = &occlusion::scalarKernels();
+		break;
+	case Implementation::SSE:
+		newKernels = occlusion::sseKernels();
+		break;
+	case Implementation::AVX2:
+		newKernels = occlusion::cpuSupportsAVX2() ? occlusion::avx2Kernels() : nullptr;
+		break;
+	}
+
+	if (!newKernels) {
+		throw std::runtime_error(std::string("Occlusion rasterizer implementation not supported: ") + implementationName(newImplementation));
+	}
+
+	implementation = newImplementation;
+	kernels = newKernels;
+}
+
+void OcclusionRasterizer::renderOccluders(const std::vector<glm::vec3>& triangles, const glm::mat4& viewProj) {
+	const uint32_t setupGrain = 256;
+	uint32_t triangleCount = static_cast<uint32_t>(triangles.size() / 3);
+	setupChunks.resize((triangleCount + setupGrain - 1) / setupGrain);
+
+	// Transform and set up triangles in parallel, each chunk writes its own list
+	threadPool.parallelFor(triangleCount, setupGrain, [&](uint32_t begin, uint32_t end) {
+		auto& setups = setupChunks[begin / setupGrain];
+		setups.clear();
+
+		for (uint32_t i = begin; i < end; i++) {
+			glm::vec4 clip[3] = {
+				viewProj * glm::vec4(triangles[i * 3 + 0], 1.0f),
+				viewProj * glm::vec4(triangles[i * 3 + 1], 1.0f),
+				viewProj * glm::vec4(triangles[i * 3 + 2], 1.0f),
+			};
+			setupTriangle(clip, setups);
+		}
+	});
+
+	// Every worker owns a band of whole tile rows, so no two threads ever touch the same pixel
+	threadPool.parallelFor(tilesY, 2, [&](uint32_t tileRowBegin, uint32_t tileRowEnd) {
+		int rowBegin = static_cast<int>(tileRowBegin * TILE_SIZE);
+		int rowEnd = static_cast<int>(tileRowEnd * TILE_SIZE);
+
+		std::fill(depth.begin() + rowBegin * width, depth.begin() + rowEnd * width, 1.0f);
+
+		for (const auto& setups : setupChunks) {
+			for (const auto& triangle : setups) {
+				if (triangle.maxY >= rowBegin && triangle.minY < rowEnd) {
+					kernels->rasterizeRows(triangle, depth.data(), width, rowBegin, rowEnd);
+				}
+			}
+		}
+
+		for (uint32_t tileY = tileRowBegin; tileY < tileRowEnd; tileY++) {
+			for (uint32_t tileX = 0; tileX < tilesX; tileX++) {
+				const float* tile = depth.data() + tileY * TILE_SIZE * width + tileX * TILE_SIZE;
+				tileMaxDepth[tileY * tilesX + tileX] = kernels->tileMax(tile, width);
+			}
+		}
+	});
+}
+
+void OcclusionRasterizer::setupTriangle(const glm::vec4 clip[3], std::vector<occlusion::TriangleSetup>& setups) const {
+	// Clip against the near plane (z >= 0 in Vulkan clip space), the rest is handled by clamping to the screen
+	glm::vec4 polygon[4];
+	int vertexCount = 0;
+
+	for (int i = 0; i < 3; i++) {
+		const glm::vec4& a = clip[i];
+		const glm::vec4& b = clip[(i + 1) % 3];
+		bool aInside = a.z >= 0.0f;
+		bool bInside = b.z >= 0.0f;
+
+		if (aInside) {
+			polygon[vertexCount++] = a;
+		}
+		if (aInside != bInside) {
+			float t = a.z / (a.z - b.z);
+			polygon[vertexCount++] = a + (b - a) * t;
+		}
+	}
+
+	if (vertexCount < 3) {
+		return;
+	}
+
+	glm::vec3 screen[4];
+	for (int i = 0; i < vertexCount; i++) {
+		float invW = 1.0f / polygon[i].w;
+		screen[i] = glm::vec3(
+			(polygon[i].x * invW * 0.5f + 0.5f) * width,
+			(polygon[i].y * invW * 0.5f + 0.5f) * height,
+			polygon[i].z * invW);
+	}
+
+	// Fan out the clipped polygon
+	for (int i = 1; i + 1 < vertexCount; i++) {
+		const glm::vec3& v0 = screen[0];
+		const glm::vec3& v1 = screen[i];
+		const glm::vec3& v2 = screen[i + 1];
+
+		// With a flipped y the front faces end up with a negative area in pixel space. Back faces
+		// of closed occluders are always behind their front faces so they can be skipped
+		float area = (v1.x - v0.x) * (v2.y - v0.y) - (v2.x - v0.x) * (v1.y - v0.y);
+		if (area >= 0.0f) {
+			continue;
+		}
+
+		occlusion::TriangleSetup triangle;
+
+		// Pixels whose centers fall inside the triangle's bounds
+		triangle.minX = std::max(static_cast<int>(std::ceil(std::min({ v0.x, v1.x, v2.x }) - 0.5f)), 0);
+		triangle.minY = std::max(static_cast<int>(std::ceil(std::min({ v0.y, v1.y, v2.y }) - 0.5f)), 0);
+		triangle.maxX = std::min(static_cast<int>(std::floor(std::max({ v0.x, v1.x, v2.x }) - 0.5f)), static_cast<int>(width) - 1);
+		triangle.maxY = std::min(static_cast<int>(std::floor(std::max({ v0.y, v1.y, v2.y }) - 0.5f)), static_cast<int>(height) - 1);
+
+		if (triangle.minX > triangle.maxX || triangle.minY > triangle.maxY) {
+			continue;
+		}
+
+		const glm::vec3* vertices[3] = { &v0, &v1, &v2 };
+		for (int edge = 0; edge < 3; edge++) {
+			const glm::vec3& from = *vertices[edge];
+			const glm::vec3& to = *vertices[(edge + 1) % 3];
+
+			triangle.edgeA[edge] = to.y - from.y;
+			triangle.edgeB[edge] = from.x - to.x;
+			triangle.edgeC[edge] = -(triangle.edgeA[edge] * from.x + triangle.edgeB[edge] * from.y);
+		}
+
+		// Depth is linear in screen space after the perspective divide
+		triangle.depthA = ((v1.z - v0.z) * (v2.y - v0.y) - (v2.z - v0.z) * (v1.y - v0.y)) / area;
+		triangle.depthB = ((v1.x - v0.x) * (v2.z - v0.z) - (v2.x - v0.x) * (v1.z - v0.z)) / area;
+		triangle.depthC = v0.z - triangle.depthA * v0.x - triangle.depthB * v0.y;
+
+		setups.push_back(triangle);
+	}
+}
+
+bool OcclusionRasterizer::isOccluded(const glm::vec4& sphere, const glm::mat4& view, const glm::mat4& proj, float nearPlane) const {
+	glm::vec3 center = glm::vec3(view * glm::vec4(glm::vec3(sphere), 1.0f));
+	float radius = sphere.w;
+
+	// Same projection as the gpu culling pass. Spheres touching the near plane are always visible
+	if (-center.z - radius < nearPlane) {
+		return false;
+	}
+
+	glm::vec2 minUV = glm::vec2(1.0f);
+	glm::vec2 maxUV = glm::vec2(0.0f);
+	for (int i = 0; i < 8; i++) {
+		glm::vec3 corner = center + radius * glm::vec3((i & 1) ? 1.0f : -1.0f, (i & 2) ? 1.0f : -1.0f, (i & 4) ? 1.0f : -1.0f);
+		glm::vec4 clip = proj * glm::vec4(corner, 1.0f);
+		glm::vec2 uv = glm::vec2(clip) / clip.w * 0.5f + 0.5f;
+		minUV = glm::min(minUV, uv);
+		maxUV = glm::max(maxUV, uv);
+	}
+	minUV = glm::clamp(minUV, glm::vec2(0.0f), glm::vec2(1.0f));
+	maxUV = glm::clamp(maxUV, glm::vec2(0.0f), glm::vec2(1.0f));
+
+	glm::vec4 nearClip = proj * glm::vec4(0.0f, 0.0f, center.z + radius, 1.0f);
+	float nearestDepth = nearClip.z / nearClip.w;
+
+	int x0 = std::min(static_cast<int>(minUV.x * width), static_cast<int>(width) - 1);
+	int y0 = std::min(static_cast<int>(minUV.y * height), static_cast<int>(height) - 1);
+	int x1 = std::min(static_cast<int>(maxUV.x * width), static_cast<int>(width) - 1);
+	int y1 = std::min(static_cast<int>(maxUV.y * height), static_cast<int>(height) - 1);
+
+	// Tiles reject most objects on their own, only look at pixels where a tile is inconclusive
+	for (int tileY = y0 / static_cast<int>(TILE_SIZE); tileY <= y1 / static_cast<int>(TILE_SIZE); tileY++) {
+		for (int tileX = x0 / static_cast<int>(TILE_SIZE); tileX <= x1 / static_cast<int>(TILE_SIZE); tileX++) {
+			if (nearestDepth > tileMaxDepth[tileY * tilesX + tileX]) {
+				continue;
+			}
+
+			int tileX0 = std::max(x0, tileX * static_cast<int>(TILE_SIZE));
+			int tileY0 = std::max(y0, tileY * static_cast<int>(TILE_SIZE));
+			int tileX1 = std::min(x1, (tileX + 1) * static_cast<int>(TILE_SIZE) - 1);
+			int tileY1 = std::min(y1, (tileY + 1) * static_cast<int>(TILE_SIZE) - 1);
+
+			if (kernels->anyFarther(depth.data(), width, tileX0, tileY0, tileX1, tileY1, nearestDepth)) {
+				return false;
+			}
+		}
+	}
+
+	return true;
+}
@@ -0,0 +1,118 @@
+#include "OcclusionRasterizer.h"
+
+#include <algorithm>
+
+// This file is the only one built with AVX2 enabled. Nothing in here may run unless the
+// rasterizer checked the cpu first, see OcclusionRasterizer::setImplementation
+#if defined(__AVX2__)
+
+#include <immintrin.h>
+
+namespace occlusion {
+
+	// Lanes of x that fall inside [minX, maxX]
+	static inline __m256 spanMaskAVX2(__m256i x, int minX, int maxX) {
+		__m256i afterMin = _mm256_cmpgt_epi32(x, _mm256_set1_epi32(minX - 1));
+		__m256i beforeMax = _mm256_cmpgt_epi32(_mm256_set1_epi32(maxX + 1), x);
+		return _mm256_castsi256_ps(_mm256_and_si256(afterMin, beforeMax));
+	}
+
+	static void rasterizeRowsAVX2(const TriangleSetup& triangle, float* depth, uint32_t width, int rowBegin, int rowEnd) {
+		int yBegin = std::max(triangle.minY, rowBegin);
+		int yEnd = std::min(triangle.maxY + 1, rowEnd);
+
+		// Rows are a multiple of the tile size wide, so aligned spans of 8 never leave the row
+		int xBegin = triangle.minX & ~7;
+
+		const __m256i laneOffsets = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+		const __m256 half = _mm256_set1_ps(0.5f);
+		const __m256 zero = _mm256_setzero_ps();
+
+		__m256 a0 = _mm256_set1_ps(triangle.edgeA[0]), a1 = _mm256_set1_ps(triangle.edgeA[1]), a2 = _mm256_set1_ps(triangle.edgeA[2]);
+		__m256 c0 = _mm256_set1_ps(triangle.edgeC[0]), c1 = _mm256_set1_ps(triangle.edgeC[1]), c2 = _mm256_set1_ps(triangle.edgeC[2]);
+		__m256 depthA = _mm256_set1_ps(triangle.depthA);
+		__m256 depthC = _mm256_set1_ps(triangle.depthC);
+
+		for (int y = yBegin; y < yEnd; y++) {
+			float py = y + 0.5f;
+			float* row = depth + y * width;
+
+			// Terms constant along the row
+			__m256 b0 = _mm256_set1_ps(triangle.edgeB[0] * py);
+			__m256 b1 = _mm256_set1_ps(triangle.edgeB[1] * py);
+			__m256 b2 = _mm256_set1_ps(triangle.edgeB[2] * py);
+			__m256 depthB = _mm256_set1_ps(triangle.depthB * py);
+
+			for (int x = xBegin; x <= triangle.maxX; x += 8) {
+				__m256i xi = _mm256_add_epi32(_mm256_set1_epi32(x), laneOffsets);
+				__m256 px = _mm256_add_ps(_mm256_cvtepi32_ps(xi), half);
+
+				// Separate multiply and add rather than fma so results match the scalar reference exactly
+				__m256 e0 = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(a0, px), b0), c0);
+				__m256 e1 = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(a1, px), b1), c1);
+				__m256 e2 = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(a2, px), b2), c2);
+
+				__m256 inside = _mm256_and_ps(_mm256_cmp_ps(e0, zero, _CMP_GE_OQ), _mm256_cmp_ps(e1, zero, _CMP_GE_OQ));
+				inside = _mm256_and_ps(inside, _mm256_cmp_ps(e2, zero, _CMP_GE_OQ));
+				inside = _mm256_and_ps(inside, spanMaskAVX2(xi, triangle.minX, triangle.maxX));
+
+				if (_mm256_movemask_ps(inside) == 0) {
+					continue;
+				}
+
+				__m256 z = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(depthA, px), depthB), depthC);
+				__m256 old = _mm256_loadu_ps(row + x);
+				_mm256_storeu_ps(row + x, _mm256_blendv_ps(old, _mm256_min_ps(old, z), inside));
+			}
+		}
+	}
+
+	static float tileMaxAVX2(const float* depth, uint32_t width) {
+		__m256 result = _mm256_setzero_ps();
+		for (uint32_t y = 0; y < OcclusionRasterizer::TILE_SIZE; y++) {
+			result = _mm256_max_ps(result, _mm256_loadu_ps(depth + y * width));
+		}
+
+		__m128 value = _mm_max_ps(_mm256_castps256_ps128(result), _mm256_extractf128_ps(result, 1));
+		value = _mm_max_ps(value, _mm_shuffle_ps(value, value, _MM_SHUFFLE(1, 0, 3, 2)));
+		value = _mm_max_ps(value, _mm_shuffle_ps(value, value, _MM_SHUFFLE(2, 3, 0, 1)));
+		return _mm_cvtss_f32(value);
+	}
+
+	static bool anyFartherAVX2(const float* depth, uint32_t width, int x0, int y0, int x1, int y1, float nearestDepth) {
+		const __m256i laneOffsets = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+		const __m256 nearest = _mm256_set1_ps(nearestDepth);
+
+		for (int y = y0; y <= y1; y++) {
+			const float* row = depth + y * width;
+
+			for (int x = x0 & ~7; x <= x1; x += 8) {
+				__m256i xi = _mm256_add_epi32(_mm256_set1_epi32(x), laneOffsets);
+				__m256 farther = _mm256_cmp_ps(_mm256_loadu_ps(row + x), nearest, _CMP_GE_OQ);
+
+				if (_mm256_movemask_ps(_mm256_and_ps(farther, spanMaskAVX2(xi, x0, x1))) != 0) {
+					return true;
+				}
+			}
+		}
+		return false;
+	}
+
+	const Kernels* avx2Kernels() {
+		static const Kernels kernels = { rasterizeRowsAVX2, tileMaxAVX2, anyFartherAVX2 };
+		return &kernels;
+	}
+
+}
+
+#else
+
+namespace occlusion {
+
+	const Kernels* avx2Kernels() {
+		return nullptr;
+	}
+
+}
+
+#endif
@@ -0,0 +1,390 @@
+#include "ParticleSystem.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+#include <stdexcept>
+
+namespace {
+
+	const uint32_t GROUP_SIZE = 256;
+	const uint32_t BINDING_COUNT = 6;
+
+	// Makes a dispatch's buffer writes visible to the next one, and to indirect arguments read from them
+	void computeBarrier(VkCommandBuffer commandBuffer) {
+		VkMemoryBarrier barrier = {};
+		barrier.sType		  = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+		barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+		barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+	}
+
+}
+
+ParticleSystem::ParticleSystem(VkDevice logicalDevice, VkPhysicalDevice physicalDevice, const AssetLoader& assets, const Config& particleConfig) :
+	device(logicalDevice),
+	config(particleConfig) {
+
+	config.capacity = std::max(config.capacity, 1u);
+	emitRate = config.emitRate > 0.0f ? config.emitRate : config.capacity / config.lifetime;
+	emitCounts.assign(config.framesInFlight, 0);
+
+	particleBuffer = vkutil::createBuffer(device, physicalDevice, sizeof(glm::vec4) * 2 * config.capacity,
+		VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+	deadListBuffer = vkutil::createBuffer(device, physicalDevice, sizeof(uint32_t) * config.capacity,
+		VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+	aliveListBuffer = vkutil::createBuffer(device, physicalDevice, sizeof(uint32_t) * 2 * config.capacity,
+		VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+	counterBuffer = vkutil::createBuffer(device, physicalDevice, sizeof(ParticleCounters),
+		VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+	// Depth is compared texel by texel, never filtered
+	VkSamplerCreateInfo samplerInfo = {};
+	samplerInfo.sType		 = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+	samplerInfo.magFilter	 = VK_FILTER_NEAREST;
+	samplerInfo.minFilter	 = VK_FILTER_NEAREST;
+	samplerInfo.mipmapMode	 = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+	samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+	samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+	samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+	samplerInfo.maxLod		 = 0.0f;
+
+	if (vkCreateSampler(device, &samplerInfo, nullptr, &depthSampler) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create particle depth sampler.");
+	}
+
+	// Frame parameters, particles, dead list, alive lists, counters and the depth buffer
+	VkDescriptorSetLayoutBinding bindings[BINDING_COUNT] = {};
+	for (uint32_t i = 0; i < BINDING_COUNT; i++) {
+		bindings[i].binding			= i;
+		bindings[i].descriptorType	= i == 0 ? VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER :
+			i == 5 ? VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER : VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		bindings[i].descriptorCount = 1;
+		bindings[i].stageFlags		= VK_SHADER_STAGE_COMPUTE_BIT | (i == 5 ? 0 : VK_SHADER_STAGE_VERTEX_BIT);
+	}
+
+	VkDescriptorSetLayoutCreateInfo layoutInfo = {};
+	layoutInfo.sType		= VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	layoutInfo.bindingCount = BINDING_COUNT;
+	layoutInfo.pBindings	= bindings;
+
+	if (vkCreateDescriptorSetLayout(device, &layoutInfo, nullptr, &setLayout) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create particle descriptor set layout.");
+	}
+
+	VkDescriptorPoolSize poolSizes[3] = {};
+	poolSizes[0].type			 = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+	poolSizes[0].descriptorCount = config.framesInFlight;
+	poolSizes[1].type			 = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	poolSizes[1].descriptorCount = 4 * config.framesInFlight;
+	poolSizes[2].type			 = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	poolSizes[2].descriptorCount = config.framesInFlight;
+
+	VkDescriptorPoolCreateInfo poolInfo = {};
+	poolInfo.sType		   = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+	poolInfo.poolSizeCount = 3;
+	poolInfo.pPoolSizes	   = poolSizes;
+	poolInfo.maxSets	   = config.framesInFlight;
+
+	if (vkCreateDescriptorPool(device, &poolInfo, nullptr, &descriptorPool) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create particle descriptor pool.");
+	}
+
+	std::vector<VkDescriptorSetLayout> layouts(config.framesInFlight, setLayout);
+	descriptorSets.resize(config.framesInFlight);
+
+	VkDescriptorSetAllocateInfo allocInfo = {};
+	allocInfo.sType				 = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+	allocInfo.descriptorPool	 = descriptorPool;
+	allocInfo.descriptorSetCount = config.framesInFlight;
+	allocInfo.pSetLayouts		 = layouts.data();
+
+	if (vkAllocateDescriptorSets(device, &allocInfo, descriptorSets.data()) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to allocate particle descriptor sets.");
+	}
+
+	// The depth buffer is written by setDepth once the render graph has made it
+	const VkMemoryPropertyFlags hostVisible = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+	for (uint32_t frame = 0; frame < config.framesInFlight; frame++) {
+		frameBuffers.push_back(vkutil::createBuffer(device, physicalDevice, sizeof(ParticleFrameData),
+			VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, hostVisible));
+		readbackBuffers.push_back(vkutil::createBuffer(device, physicalDevice, sizeof(ParticleCounters),
+			VK_BUFFER_USAGE_TRANSFER_DST_BIT, hostVisible));
+		// Nothing alive until the first readback
+		memset(readbackBuffers[frame].mapped, 0, sizeof(ParticleCounters));
+		static_cast<ParticleCounters*>(readbackBuffers[frame].mapped)->deadCount = static_cast<int32_t>(config.capacity);
+
+		VkDescriptorBufferInfo bufferInfos[5] = {};
+		const VkBuffer buffers[5] = { frameBuffers[frame].buffer, particleBuffer.buffer, deadListBuffer.buffer,
+			aliveListBuffer.buffer, counterBuffer.buffer };
+		VkWriteDescriptorSet writes[5] = {};
+		for (uint32_t i = 0; i < 5; i++) {
+			bufferInfos[i].buffer = buffers[i];
+			bufferInfos[i].offset = 0;
+			bufferInfos[i].range  = VK_WHOLE_SIZE;
+
+			writes[i].sType			  = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+			writes[i].dstSet		  = descriptorSets[frame];
+			writes[i].dstBinding	  = i;
+			writes[i].descriptorCount = 1;
+			writes[i].descriptorType  = bindings[i].descriptorType;
+			writes[i].pBufferInfo	  = &bufferInfos[i];
+		}
+		vkUpdateDescriptorSets(device, 5, writes, 0, nullptr);
+	}
+
+	VkPushConstantRange pushConstantRange = {};
+	pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+	pushConstantRange.offset	 = 0;
+	pushConstantRange.size		 = sizeof(ParticlePushConstants);
+
+	VkPipelineLayoutCreateInfo pipelineLayoutInfo = {};
+	pipelineLayoutInfo.sType				  = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+	pipelineLayoutInfo.setLayoutCount		  = 1;
+	pipelineLayoutInfo.pSetLayouts			  = &setLayout;
+	pipelineLayoutInfo.pushConstantRangeCount = 1;
+	pipelineLayoutInfo.pPushConstantRanges	  = &pushConstantRange;
+
+	if (vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &pipelineLayout) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create particle pipeline layout.");
+	}
+	argsPipeline = vkutil::createComputePipeline(device, assets.load("src/shaders/particle_args_comp.spv"), pipelineLayout);
+	simulatePipeline = vkutil::createComputePipeline(device, assets.load("src/shaders/particle_simulate_comp.spv"), pipelineLayout);
+	simulateMultisampledPipeline = vkutil::createComputePipeline(device, assets.load("src/shaders/particle_simulate_ms_comp.spv"), pipelineLayout);
+	emitPipeline = vkutil::createComputePipeline(device, assets.load("src/shaders/particle_emit_comp.spv"), pipelineLayout);
+}
+
+void ParticleSystem::createRenderPipeline(const AssetLoader& assets, VkRenderPass renderPass, VkSampleCountFlagBits samples) {
+	destroyRenderPipeline();
+
+	VkShaderModule vertShaderModule = vkutil::createShaderModule(device, assets.load("src/shaders/particle_vert.spv"));
+	VkShaderModule fragShaderModule = vkutil::createShaderModule(device, assets.load("src/shaders/particle_frag.spv"));
+
+	VkPipelineShaderStageCreateInfo shaderStages[2] = {};
+	shaderStages[0].sType  = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	shaderStages[0].stage  = VK_SHADER_STAGE_VERTEX_BIT;
+	shaderStages[0].module = vertShaderModule;
+	shaderStages[0].pName  = "main";
+	shaderStages[1].sType  = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	shaderStages[1].stage  = VK_SHADER_STAGE_FRAGMENT_BIT;
+	shaderStages[1].module = fragShaderModule;
+	shaderStages[1].pName  = "main";
+
+	// Quads are built from the vertex and instance index alone
+	VkPipelineVertexInputStateCreateInfo vertexInputInfo = {};
+	vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+
+	VkPipelineInputAssemblyStateCreateInfo inputAssembly = {};
+	inputAssembly.sType	   = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+	inputAssembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+
+	VkPipelineViewportStateCreateInfo viewportState = {};
+	viewportState.sType			= VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+	viewportState.viewportCount = 1;
+	viewportState.scissorCount	= 1;
+
+	VkDynamicState dynamicStates[] = { VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR };
+	VkPipelineDynamicStateCreateInfo dynamicState = {};
+	dynamicState.sType			   = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+	dynamicState.dynamicStateCount = 2;
+	dynamicState.pDynamicStates	   = dynamicStates;
+
+	VkPipelineRasterizationStateCreateInfo rasterizer = {};
+	rasterizer.sType	   = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+	rasterizer.polygonMode = VK_POLYGON_MODE_FILL;
+	rasterizer.lineWidth   = 1.0f;
+	rasterizer.cullMode	   = VK_CULL_MODE_NONE;
+	rasterizer.frontFace   = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+
+	VkPipelineMultisampleStateCreateInfo multisampling = {};
+	multisampling.sType				   = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+	multisampling.rasterizationSamples = samples;
+
+	// Tested against the scene but never written, so particles do not hide each other and order does not matter
+	VkPipelineDepthStencilStateCreateInfo depthStencil = {};
+	depthStencil.sType			  = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+	depthStencil.depthTestEnable  = VK_TRUE;
+	depthStencil.depthWriteEnable = VK_FALSE;
+	depthStencil.depthCompareOp	  = VK_COMPARE_OP_LESS;
+
+	// Added onto the HDR color, its alpha left alone
+	VkPipelineColorBlendAttachmentState colorBlendAttachment = {};
+	colorBlendAttachment.colorWriteMask		 = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT;
+	colorBlendAttachment.blendEnable		 = VK_TRUE;
+	colorBlendAttachment.srcColorBlendFactor = VK_BLEND_FACTOR_ONE;
+	colorBlendAttachment.dstColorBlendFactor = VK_BLEND_FACTOR_ONE;
+	colorBlendAttachment.colorBlendOp		 = VK_BLEND_OP_ADD;
+	colorBlendAttachment.srcAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
+	colorBlendAttachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+	colorBlendAttachment.alphaBlendOp		 = VK_BLEND_OP_ADD;
+
+	VkPipelineColorBlendStateCreateInfo colorBlending = {};
+	colorBlending.sType			  = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+	colorBlending.attachmentCount = 1;
+	colorBlending.pAttachments	  = &colorBlendAttachment;
+
+	VkGraphicsPipelineCreateInfo pipelineInfo = {};
+	pipelineInfo.sType				 = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+	pipelineInfo.stageCount			 = 2;
+	pipelineInfo.pStages			 = shaderStages;
+	pipelineInfo.pVertexInputState	 = &vertexInputInfo;
+	pipelineInfo.pInputAssemblyState = &inputAssembly;
+	pipelineInfo.pViewportState		 = &viewportState;
+	pipelineInfo.pRasterizationState = &rasterizer;
+	pipelineInfo.pMultisampleState	 = &multisampling;
+	pipelineInfo.pDepthStencilState	 = &depthStencil;
+	pipelineInfo.pColorBlendState	 = &colorBlending;
+	pipelineInfo.pDynamicState		 = &dynamicState;
+	pipelineInfo.layout				 = pipelineLayout;
+	pipelineInfo.renderPass			 = renderPass;
+	pipelineInfo.subpass			 = 0;
+
+	if (vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &renderPipeline) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create particle pipeline.");
+	}
+	vkDestroyShaderModule(device, fragShaderModule, nullptr);
+	vkDestroyShaderModule(device, vertShaderModule, nullptr);
+}
+
+void ParticleSystem::destroyRenderPipeline() {
+	vkDestroyPipeline(device, renderPipeline, nullptr);
+	renderPipeline = VK_NULL_HANDLE;
+}
+
+void ParticleSystem::setDepth(VkImageView depthView, bool multisampled) {
+	multisampledDepth = multisampled;
+
+	VkDescriptorImageInfo imageInfo = {};
+	imageInfo.sampler	  = depthSampler;
+	imageInfo.imageView	  = depthView;
+	imageInfo.imageLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+
+	for (uint32_t frame = 0; frame < config.framesInFlight; frame++) {
+		VkWriteDescriptorSet write = {};
+		write.sType			  = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		write.dstSet		  = descriptorSets[frame];
+		write.dstBinding	  = 5;
+		write.descriptorCount = 1;
+		write.descriptorType  = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+		write.pImageInfo	  = &imageInfo;
+		vkUpdateDescriptorSets(device, 1, &write, 0, nullptr);
+	}
+}
+
+void ParticleSystem::update(uint32_t frame, const CameraData& camera, VkExtent2D screen, float deltaTime) {
+	const ParticleCounters* counters = static_cast<const ParticleCounters*>(readbackBuffers[frame].mapped);
+	stats.alive	  = config.capacity - static_cast<uint32_t>(std::max(counters->deadCount, 0));
+	stats.emitted = counters->emitted;
+
+	// A long stall should not empty the dead list in one go. The remainder carries over so low rates still emit
+	float dt = std::min(deltaTime, 0.1f);
+	float toEmit = emitRate * dt + emitRemainder;
+	uint32_t emitCount = static_cast<uint32_t>(std::min(std::floor(toEmit), static_cast<float>(config.capacity)));
+	emitRemainder = std::min(toEmit - emitCount, 1.0f);
+	emitCounts[frame] = emitCount;
+
+	// Axes of the view in world space, the rows of its rotation
+	const glm::mat4& view = camera.view;
+	ParticleFrameData data = {};
+	data.viewProj	 = camera.viewProj;
+	data.invViewProj = glm::inverse(camera.viewProj);
+	data.cameraRight = glm::vec4(view[0][0], view[1][0], view[2][0], config.size);
+	data.cameraUp	 = glm::vec4(view[0][1], view[1][1], view[2][1], 0.0f);
+	data.emitter	 = glm::vec4(config.emitterCenter, config.emitterRadius);
+	data.emitParams	 = glm::vec4(config.lifetime, config.launchSpeed, config.launchSpeedVariation, config.sidewaysSpeed);
+	data.simParams	 = glm::vec4(dt, config.gravity, config.restitution, config.collisionThickness);
+	data.depthParams = glm::vec4(static_cast<float>(screen.width), static_cast<float>(screen.height), camera.projParams.x, camera.projParams.y);
+	data.counts		 = glm::uvec4(emitCount, config.capacity, step & 1, step * 0x9e3779b9u);
+	memcpy(frameBuffers[frame].mapped, &data, sizeof(data));
+	step++;
+}
+
+void ParticleSystem::recordArgs(VkCommandBuffer commandBuffer, VkDescriptorSet set, ArgsMode mode, uint32_t groups) {
+	ParticlePushConstants constants = {};
+	constants.mode = mode;
+	vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, argsPipeline);
+	vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout, 0, 1, &set, 0, nullptr);
+	vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(constants), &constants);
+	vkCmdDispatch(commandBuffer, groups, 1, 1);
+}
+
+void ParticleSystem::recordSimulation(VkCommandBuffer commandBuffer, uint32_t frame) {
+	VkDescriptorSet set = descriptorSets[frame];
+
+	// Every particle starts out dead
+	if (!reset) {
+		recordArgs(commandBuffer, set, ARGS_RESET, (config.capacity + GROUP_SIZE - 1) / GROUP_SIZE);
+		computeBarrier(commandBuffer);
+		reset = true;
+	}
+
+	recordArgs(commandBuffer, set, ARGS_SIMULATE, 1);
+	computeBarrier(commandBuffer);
+
+	vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, multisampledDepth ? simulateMultisampledPipeline : simulatePipeline);
+	vkCmdDispatchIndirect(commandBuffer, counterBuffer.buffer, offsetof(ParticleCounters, simulateArgs));
+	computeBarrier(commandBuffer);
+
+	// Emitted after the simulation so the particles it frees this frame can be reused right away
+	if (emitCounts[frame] > 0) {
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, emitPipeline);
+		vkCmdDispatch(commandBuffer, (emitCounts[frame] + GROUP_SIZE - 1) / GROUP_SIZE, 1, 1);
+		computeBarrier(commandBuffer);
+	}
+
+	recordArgs(commandBuffer, set, ARGS_DRAW, 1);
+}
+
+void ParticleSystem::recordDraw(VkCommandBuffer commandBuffer, uint32_t frame, VkExtent2D screen) {
+	VkViewport viewport = {};
+	viewport.width	  = static_cast<float>(screen.width);
+	viewport.height	  = static_cast<float>(screen.height);
+	viewport.maxDepth = 1.0f;
+
+	VkRect2D scissor = {};
+	scissor.extent = screen;
+
+	vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, renderPipeline);
+	vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSets[frame], 0, nullptr);
+	vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+	vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+	vkCmdDrawIndirect(commandBuffer, counterBuffer.buffer, offsetof(ParticleCounters, drawArgs), 1, sizeof(VkDrawIndirectCommand));
+}
+
+void ParticleSystem::recordReadback(VkCommandBuffer commandBuffer, uint32_t frame) {
+	VkBufferCopy region = {};
+	region.size = sizeof(ParticleCounters);
+	vkCmdCopyBuffer(commandBuffer, counterBuffer.buffer, readbackBuffers[frame].buffer, 1, &region);
+}
+
+VkDeviceSize ParticleSystem::getBytes() const {
+	return particleBuffer.size + deadListBuffer.size + aliveListBuffer.size + counterBuffer.size;
+}
+
+void ParticleSystem::destroy() {
+	destroyRenderPipeline();
+	for (auto* buffers : { &frameBuffers, &readbackBuffers }) {
+		for (auto& buffer : *buffers) {
+			vkutil::destroyBuffer(device, buffer);
+		}
+		buffers->clear();
+	}
+	for (auto* buffer : { &particleBuffer, &deadListBuffer, &aliveListBuffer, &counterBuffer }) {
+		vkutil::destroyBuffer(device, *buffer);
+	}
+	for (auto* pipeline : { &argsPipeline, &simulatePipeline, &simulateMultisampledPipeline, &emitPipeline }) {
+		vkDestroyPipeline(device, *pipeline, nullptr);
+		*pipeline = VK_NULL_HANDLE;
+	}
+	vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
+	vkDestroyDescriptorPool(device, descriptorPool, nullptr);
+	vkDestroyDescriptorSetLayout(device, setLayout, nullptr);
+	vkDestroySampler(device, depthSampler, nullptr);
+	pipelineLayout = VK_NULL_HANDLE;
+	descriptorPool = VK_NULL_HANDLE;
+	setLayout = VK_NULL_HANDLE;
+	depthSampler = VK_NULL_HANDLE;
+}
@@ -0,0 +1,245 @@
+#include "Png.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+namespace {
+
+	const size_t MIN_MATCH = 3;
+	const size_t MAX_MATCH = 258;
+	const size_t MAX_DISTANCE = 32768;
+	const uint32_t HASH_BITS = 15;
+
+	const uint16_t LENGTH_BASE[29] = { 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115,
+		131, 163, 195, 227, 258 };
+	const uint8_t LENGTH_EXTRA[29] = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+	const uint16_t DISTANCE_BASE[30] = { 1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537,
+		2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577 };
+	const uint8_t DISTANCE_EXTRA[30] = { 0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+
+	uint32_t hash(const uint8_t* p) {
+		uint32_t sequence = p[0] | (p[1] << 8) | (p[2] << 16);
+		return (sequence * 2654435761u) >> (32 - HASH_BITS);
+	}
+
+	// Deflate packs its bits starting from the least significant one, Huffman codes most significant bit first
+	class BitWriter {
+	public:
+		explicit BitWriter(std::vector<uint8_t>& output) : out(output) {}
+
+		void write(uint32_t value, uint32_t count) {
+			bits |= static_cast<uint64_t>(value) << bitCount;
+			bitCount += count;
+			while (bitCount >= 8) {
+				out.push_back(static_cast<uint8_t>(bits));
+				bits >>= 8;
+				bitCount -= 8;
+			}
+		}
+
+		void writeCode(uint32_t code, uint32_t length) {
+			uint32_t reversed = 0;
+			for (uint32_t i = 0; i < length; i++) {
+				reversed |= ((code >> i) & 1) << (length - 1 - i);
+			}
+			write(reversed, length);
+		}
+
+		void flush() {
+			if (bitCount > 0) {
+				out.push_back(static_cast<uint8_t>(bits));
+			}
+			bits = 0;
+			bitCount = 0;
+		}
+
+	private:
+		std::vector<uint8_t>& out;
+		uint64_t bits = 0;
+		uint32_t bitCount = 0;
+	};
+
+	// The fixed literal and length codes of deflate
+	void writeSymbol(BitWriter& writer, uint32_t symbol) {
+		if (symbol < 144) {
+			writer.writeCode(0x30 + symbol, 8);
+		} else if (symbol < 256) {
+			writer.writeCode(0x190 + symbol - 144, 9);
+		} else if (symbol < 280) {
+			writer.writeCode(symbol - 256, 7);
+		} else {
+			writer.writeCode(0xc0 + symbol - 280, 8);
+		}
+	}
+
+	void writeMatch(BitWriter& writer, size_t length, size_t distance) {
+		uint32_t lengthCode = 28;
+		while (LENGTH_BASE[lengthCode] > length) {
+			lengthCode--;
+		}
+		writeSymbol(writer, 257 + lengthCode);
+		writer.write(static_cast<uint32_t>(length - LENGTH_BASE[lengthCode]), LENGTH_EXTRA[lengthCode]);
+
+		uint32_t distanceCode = 29;
+		while (DISTANCE_BASE[distanceCode] > distance) {
+			distanceCode--;
+		}
+		writer.writeCode(distanceCode, 5);
+		writer.write(static_cast<uint32_t>(distance - DISTANCE_BASE[distanceCode]), DISTANCE_EXTRA[distanceCode]);
+	}
+
+	// A zlib stream of one final fixed Huffman block
+	void deflate(const uint8_t* data, size_t size, std::vector<uint8_t>& out) {
+		out.push_back(0x78);
+		out.push_back(0x01);
+
+		BitWriter writer(out);
+		writer.write(1, 1);
+		writer.write(1, 2);
+
+		// Positions are stored plus one, so zero is an empty slot
+		std::vector<uint32_t> table(size_t(1) << HASH_BITS, 0);
+		size_t i = 0;
+		while (i < size) {
+			size_t matchLength = 0;
+			size_t distance = 0;
+			if (i + MIN_MATCH <= size) {
+				uint32_t h = hash(data + i);
+				size_t candidate = table[h];
+				table[h] = static_cast<uint32_t>(i + 1);
+				if (candidate > 0 && i - (candidate - 1) <= MAX_DISTANCE) {
+					const uint8_t* match = data + candidate - 1;
+					size_t limit = std::min(MAX_MATCH, size - i);
+					while (matchLength < limit && match[matchLength] == data[i + matchLength]) {
+						matchLength++;
+					}
+					distance = i - (candidate - 1);
+				}
+			}
+
+			if (matchLength >= MIN_MATCH) {
+				writeMatch(writer, matchLength, distance);
+				// Only the match's last positions go into the table, enough to continue runs of it
+				for (size_t j = i + matchLength - std::min<size_t>(matchLength, 3); j < i + matchLength && j + MIN_MATCH <= size; j++) {
+					table[hash(data + j)] = static_cast<uint32_t>(j + 1);
+				}
+				i += matchLength;
+			} else {
+				writeSymbol(writer, data[i]);
+				i++;
+			}
+		}
+		writeSymbol(writer, 256);
+		writer.flush();
+
+		uint32_t a = 1;
+		uint32_t b = 0;
+		for (size_t j = 0; j < size; j++) {
+			a = (a + data[j]) % 65521;
+			b = (b + a) % 65521;
+		}
+		uint32_t adler = (b << 16) | a;
+		for (int shift = 24; shift >= 0; shift -= 8) {
+			out.push_back(static_cast<uint8_t>(adler >> shift));
+		}
+	}
+
+	uint8_t paeth(uint8_t a, uint8_t b, uint8_t c) {
+		int p = a + b - c;
+		int pa = std::abs(p - a);
+		int pb = std::abs(p - b);
+		int pc = std::abs(p - c);
+		return pa <= pb && pa <= pc ? a : pb <= pc ? b : c;
+	}
+
+	void writeChunk(std::vector<uint8_t>& out, const char* type, const uint8_t* data, size_t size) {
+		for (int shift = 24; shift >= 0; shift -= 8) {
+			out.push_back(static_cast<uint8_t>(size >> shift));
+		}
+		size_t start = out.size();
+		out.insert(out.end(), type, type + 4);
+		out.insert(out.end(), data, data + size);
+		uint32_t crc = png::crc32(out.data() + start, out.size() - start);
+		for (int shift = 24; shift >= 0; shift -= 8) {
+			out.push_back(static_cast<uint8_t>(crc >> shift));
+		}
+	}
+
+}
+
+namespace png {
+
+	uint32_t crc32(const uint8_t* data, size_t size, uint32_t crc) {
+		static const struct Table {
+			uint32_t entries[256];
+			Table() {
+				for (uint32_t i = 0; i < 256; i++) {
+					uint32_t c = i;
+					for (int k = 0; k < 8; k++) {
+						c = (c & 1) ? 0xedb88320u ^ (c >> 1) : c >> 1;
+					}
+					entries[i] = c;
+				}
+			}
+		} table;
+
+		crc = ~crc;
+		for (size_t i = 0; i < size; i++) {
+			crc = table.entries[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+		}
+		return ~crc;
+	}
+
+	std::vector<uint8_t> encode(const uint8_t* rgb, uint32_t width, uint32_t height, size_t rowPitch) {
+		const size_t rowBytes = size_t(width) * 3;
+
+		// Every row behind its filter type. Of none, sub, up, average and paeth the one whose differences add
+		// up to the least is the one that usually compresses best
+		std::vector<uint8_t> filtered((rowBytes + 1) * height);
+		std::vector<uint8_t> candidate(rowBytes);
+		std::vector<uint8_t> zeroRow(rowBytes, 0);
+		for (uint32_t y = 0; y < height; y++) {
+			const uint8_t* row = rgb + y * rowPitch;
+			const uint8_t* above = y > 0 ? rgb + (y - 1) * rowPitch : zeroRow.data();
+			uint8_t* out = &filtered[y * (rowBytes + 1)];
+
+			uint64_t bestSum = UINT64_MAX;
+			for (uint8_t type = 0; type < 5; type++) {
+				uint64_t sum = 0;
+				for (size_t x = 0; x < rowBytes; x++) {
+					uint8_t left = x >= 3 ? row[x - 3] : 0;
+					uint8_t upLeft = x >= 3 ? above[x - 3] : 0;
+					uint8_t predicted = type == 0 ? 0 : type == 1 ? left : type == 2 ? above[x] :
+						type == 3 ? static_cast<uint8_t>((left + above[x]) / 2) : paeth(left, above[x], upLeft);
+					candidate[x] = static_cast<uint8_t>(row[x] - predicted);
+					sum += static_cast<uint64_t>(std::abs(static_cast<int8_t>(candidate[x])));
+				}
+				if (sum < bestSum) {
+					bestSum = sum;
+					out[0] = type;
+					memcpy(out + 1, candidate.data(), rowBytes);
+				}
+			}
+		}
+
+		std::vector<uint8_t> result = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+
+		// 8 bits per channel, RGB, deflate, adaptive filtering, no interlacing
+		uint8_t header[13] = {
+			static_cast<uint8_t>(width >> 24), static_cast<uint8_t>(width >> 16), static_cast<uint8_t>(width >> 8), static_cast<uint8_t>(width),
+			static_cast<uint8_t>(height >> 24), static_cast<uint8_t>(height >> 16), static_cast<uint8_t>(height >> 8), static_cast<uint8_t>(height),
+			8, 2, 0, 0, 0
+		};
+		writeChunk(result, "IHDR", header, sizeof(header));
+
+		std::vector<uint8_t> compressed;
+		compressed.reserve(filtered.size() / 2);
+		deflate(filtered.data(), filtered.size(), compressed);
+		writeChunk(result, "IDAT", compressed.data(), compressed.size());
+		writeChunk(result, "IEND", nullptr, 0);
+
+		return result;
+	}
+
+}
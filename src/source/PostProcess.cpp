@@ -0,0 +1,395 @@
+#include "PostProcess.h"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+namespace {
+
+	// Bytes per texel of the formats the passes read and write
+	VkDeviceSize texelSize(VkFormat format) {
+		return format == VK_FORMAT_R16G16B16A16_SFLOAT ? 8 : 4;
+	}
+
+	VkDeviceSize texels(VkExtent2D extent) {
+		return static_cast<VkDeviceSize>(extent.width) * extent.height;
+	}
+
+}
+
+PostProcess::PostProcess(VkDevice logicalDevice, VkPhysicalDevice physical, const AssetLoader& assets, const Config& postConfig) :
+	device(logicalDevice),
+	physicalDevice(physical),
+	config(postConfig) {
+
+	// Two sampled sources, the destination image and the exposure state
+	VkDescriptorSetLayoutBinding bindings[4] = {};
+	for (uint32_t i = 0; i < 4; i++) {
+		bindings[i].binding			= i;
+		bindings[i].descriptorCount = 1;
+		bindings[i].stageFlags		= VK_SHADER_STAGE_COMPUTE_BIT;
+	}
+	bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	bindings[1].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	bindings[2].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+	bindings[3].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+
+	VkDescriptorSetLayoutCreateInfo layoutInfo = {};
+	layoutInfo.sType		= VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	layoutInfo.bindingCount = 4;
+	layoutInfo.pBindings	= bindings;
+
+	if (vkCreateDescriptorSetLayout(device, &layoutInfo, nullptr, &setLayout) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create post processing descriptor set layout.");
+	}
+
+	VkPushConstantRange range = {};
+	range.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+	range.offset	 = 0;
+	range.size		 = sizeof(PostPushConstants);
+
+	VkPipelineLayoutCreateInfo pipelineLayoutInfo = {};
+	pipelineLayoutInfo.sType				  = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+	pipelineLayoutInfo.setLayoutCount		  = 1;
+	pipelineLayoutInfo.pSetLayouts			  = &setLayout;
+	pipelineLayoutInfo.pushConstantRangeCount = 1;
+	pipelineLayoutInfo.pPushConstantRanges	  = &range;
+
+	if (vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &pipelineLayout) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create post processing pipeline layout.");
+	}
+
+	histogramPipeline = vkutil::createComputePipeline(device, assets.load(config.subgroups ?
+		"src/shaders/histogram_subgroup_comp.spv" : "src/shaders/histogram_comp.spv"), pipelineLayout);
+	exposurePipeline = vkutil::createComputePipeline(device, assets.load(config.subgroups ?
+		"src/shaders/exposure_subgroup_comp.spv" : "src/shaders/exposure_comp.spv"), pipelineLayout);
+	bloomPipeline = vkutil::createComputePipeline(device, assets.load("src/shaders/bloom_comp.spv"), pipelineLayout);
+	tonemapPipeline = vkutil::createComputePipeline(device, assets.load(config.outputWithoutFormat ?
+		"src/shaders/tonemap_any_comp.spv" : "src/shaders/tonemap_comp.spv"), pipelineLayout);
+
+	// Bloom levels are filtered by their taps landing between texels, the HDR target is only fetched
+	VkSamplerCreateInfo samplerInfo = {};
+	samplerInfo.sType		 = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+	samplerInfo.magFilter	 = VK_FILTER_LINEAR;
+	samplerInfo.minFilter	 = VK_FILTER_LINEAR;
+	samplerInfo.mipmapMode	 = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+	samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+	samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+	samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+	samplerInfo.minLod		 = 0.0f;
+	samplerInfo.maxLod		 = 0.0f;
+
+	if (vkCreateSampler(device, &samplerInfo, nullptr, &sampler) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create post processing sampler.");
+	}
+
+	exposureBuffer = vkutil::createBuffer(device, physicalDevice, sizeof(ExposureState),
+		VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+}
+
+bool PostProcess::subgroupsSupported(VkPhysicalDevice physicalDevice, PFN_vkGetPhysicalDeviceProperties2KHR getProperties2) {
+	if (getProperties2 == nullptr) {
+		return false;
+	}
+
+	VkPhysicalDeviceProperties properties;
+	vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+	if (properties.apiVersion < VK_API_VERSION_1_1) {
+		return false;
+	}
+
+	VkPhysicalDeviceSubgroupProperties subgroupProperties = {};
+	subgroupProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SUBGROUP_PROPERTIES;
+
+	VkPhysicalDeviceProperties2KHR properties2 = {};
+	properties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2_KHR;
+	properties2.pNext = &subgroupProperties;
+	getProperties2(physicalDevice, &properties2);
+
+	// The exposure pass keeps a sum per subgroup for up to 64 of them
+	const VkSubgroupFeatureFlags needed = VK_SUBGROUP_FEATURE_BASIC_BIT | VK_SUBGROUP_FEATURE_VOTE_BIT |
+		VK_SUBGROUP_FEATURE_BALLOT_BIT | VK_SUBGROUP_FEATURE_ARITHMETIC_BIT;
+	return (subgroupProperties.supportedStages & VK_SHADER_STAGE_COMPUTE_BIT) &&
+		(subgroupProperties.supportedOperations & needed) == needed &&
+		subgroupProperties.subgroupSize >= 4;
+}
+
+void PostProcess::resize(VkExtent2D extent) {
+	if (extent.width == screen.width && extent.height == screen.height) {
+		return;
+	}
+	destroyBloom();
+	screen = extent;
+	renderExtent = extent;
+
+	// Down to where the smallest level is still a few texels across
+	uint32_t smallest = std::max(std::min(screen.width, screen.height), 1u);
+	uint32_t fits = static_cast<uint32_t>(std::max(std::floor(std::log2(static_cast<float>(smallest))) - 2.0f, 1.0f));
+	uint32_t levels = std::max(1u, std::min({ config.bloomLevels, fits, MAX_BLOOM_LEVELS }));
+
+	VkExtent2D first = { std::max(screen.width / 2, 1u), std::max(screen.height / 2, 1u) };
+	bloom = vkutil::createImage(device, physicalDevice, first, levels, BLOOM_FORMAT,
+		VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_IMAGE_ASPECT_COLOR_BIT);
+	for (uint32_t level = 0; level < levels; level++) {
+		bloomLevelViews.push_back(vkutil::createImageView(device, bloom.image, BLOOM_FORMAT, VK_IMAGE_ASPECT_COLOR_BIT, level, 1));
+	}
+}
+
+void PostProcess::setRenderExtent(VkExtent2D extent) {
+	renderExtent = { std::max(std::min(extent.width, screen.width), 1u), std::max(std::min(extent.height, screen.height), 1u) };
+}
+
+void PostProcess::setTargets(VkImageView hdrView, const std::vector<VkImageView>& outputViews, bool srgb) {
+	encodeSrgb = srgb;
+	if (descriptorPool != VK_NULL_HANDLE) {
+		vkDestroyDescriptorPool(device, descriptorPool, nullptr);
+	}
+
+	uint32_t levels = bloom.mipLevels;
+	uint32_t setCount = static_cast<uint32_t>(outputViews.size()) + 2 * levels - 1;
+
+	VkDescriptorPoolSize poolSizes[3] = {};
+	poolSizes[0].type			 = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	poolSizes[0].descriptorCount = 2 * setCount;
+	poolSizes[1].type			 = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+	poolSizes[1].descriptorCount = setCount;
+	poolSizes[2].type			 = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	poolSizes[2].descriptorCount = setCount;
+
+	VkDescriptorPoolCreateInfo poolInfo = {};
+	poolInfo.sType		   = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+	poolInfo.maxSets	   = setCount;
+	poolInfo.poolSizeCount = 3;
+	poolInfo.pPoolSizes	   = poolSizes;
+
+	if (vkCreateDescriptorPool(device, &poolInfo, nullptr, &descriptorPool) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create post processing descriptor pool.");
+	}
+
+	std::vector<VkDescriptorSetLayout> layouts(setCount, setLayout);
+	std::vector<VkDescriptorSet> sets(setCount);
+
+	VkDescriptorSetAllocateInfo allocInfo = {};
+	allocInfo.sType				 = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+	allocInfo.descriptorPool	 = descriptorPool;
+	allocInfo.descriptorSetCount = setCount;
+	allocInfo.pSetLayouts		 = layouts.data();
+
+	if (vkAllocateDescriptorSets(device, &allocInfo, sets.data()) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to allocate post processing descriptor sets.");
+	}
+
+	auto first = sets.begin();
+	outputSets.assign(first, first + outputViews.size());
+	downsampleSets.assign(first + outputViews.size(), first + outputViews.size() + levels);
+	upsampleSets.assign(first + outputViews.size() + levels, sets.end());
+
+	VkDescriptorBufferInfo exposureInfo = {};
+	exposureInfo.buffer = exposureBuffer.buffer;
+	exposureInfo.offset = 0;
+	exposureInfo.range	= VK_WHOLE_SIZE;
+
+	// Only the bindings a pass reads are written. The bloom passes see the chain in the general layout,
+	// the final pass once the graph has made it a sampled image
+	auto writeSet = [&](VkDescriptorSet set, VkImageView src, VkImageLayout srcLayout, VkImageView bloomView,
+		VkImageView dst, bool exposure) {
+
+		VkDescriptorImageInfo imageInfos[3] = {};
+		imageInfos[0].sampler	  = sampler;
+		imageInfos[0].imageView	  = src;
+		imageInfos[0].imageLayout = srcLayout;
+		imageInfos[1].sampler	  = sampler;
+		imageInfos[1].imageView	  = bloomView;
+		imageInfos[1].imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		imageInfos[2].imageView	  = dst;
+		imageInfos[2].imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+
+		VkWriteDescriptorSet writes[4] = {};
+		uint32_t writeCount = 0;
+		for (uint32_t binding = 0; binding < 4; binding++) {
+			bool used = binding == 0 ? src != VK_NULL_HANDLE : binding == 1 ? bloomView != VK_NULL_HANDLE :
+				binding == 2 ? dst != VK_NULL_HANDLE : exposure;
+			if (!used) {
+				continue;
+			}
+
+			VkWriteDescriptorSet& write = writes[writeCount++];
+			write.sType			  = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+			write.dstSet		  = set;
+			write.dstBinding	  = binding;
+			write.descriptorCount = 1;
+			write.descriptorType  = binding == 2 ? VK_DESCRIPTOR_TYPE_STORAGE_IMAGE :
+				binding == 3 ? VK_DESCRIPTOR_TYPE_STORAGE_BUFFER : VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+			if (binding == 3) {
+				write.pBufferInfo = &exposureInfo;
+			} else {
+				write.pImageInfo = &imageInfos[binding];
+			}
+		}
+		vkUpdateDescriptorSets(device, writeCount, writes, 0, nullptr);
+	};
+
+	for (size_t i = 0; i < outputViews.size(); i++) {
+		writeSet(outputSets[i], hdrView, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, bloomLevelViews[0], outputViews[i], true);
+	}
+	for (uint32_t level = 0; level < levels; level++) {
+		if (level == 0) {
+			writeSet(downsampleSets[level], hdrView, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_NULL_HANDLE, bloomLevelViews[0], false);
+		} else {
+			writeSet(downsampleSets[level], bloomLevelViews[level - 1], VK_IMAGE_LAYOUT_GENERAL, VK_NULL_HANDLE, bloomLevelViews[level], false);
+		}
+		if (level + 1 < levels) {
+			writeSet(upsampleSets[level], bloomLevelViews[level + 1], VK_IMAGE_LAYOUT_GENERAL, VK_NULL_HANDLE, bloomLevelViews[level], false);
+		}
+	}
+}
+
+void PostProcess::recordHistogram(VkCommandBuffer commandBuffer) {
+	clearExposure(commandBuffer);
+
+	PostPushConstants constants = getPushConstants();
+	constants.sizes = glm::uvec4(renderExtent.width, renderExtent.height, renderExtent.width, renderExtent.height);
+	dispatch(commandBuffer, histogramPipeline, outputSets[0], constants, renderExtent, 16);
+}
+
+void PostProcess::recordExposure(VkCommandBuffer commandBuffer, float deltaTime) {
+	PostPushConstants constants = getPushConstants();
+	constants.exposureParams.z = 1.0f - std::exp(-std::max(deltaTime, 0.0f) * config.adaptationRate);
+
+	vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, exposurePipeline);
+	vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout, 0, 1, &outputSets[0], 0, nullptr);
+	vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(constants), &constants);
+	vkCmdDispatch(commandBuffer, 1, 1, 1);
+}
+
+void PostProcess::recordBloom(VkCommandBuffer commandBuffer) {
+	PostPushConstants constants = getPushConstants();
+	uint32_t levels = bloom.mipLevels;
+
+	// Each level waits for the one it reads to be written
+	auto levelBarrier = [&](uint32_t level) {
+		vkutil::imageBarrier(commandBuffer, bloom.image, VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_GENERAL,
+			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT,
+			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT,
+			VK_IMAGE_ASPECT_COLOR_BIT, level, 1);
+	};
+
+	for (uint32_t level = 0; level < levels; level++) {
+		VkExtent2D src = level == 0 ? screen : levelExtent(level - 1);
+		VkExtent2D dst = levelExtent(level);
+		constants.mode = level == 0 ? BLOOM_PREFILTER : BLOOM_DOWNSAMPLE;
+		constants.sizes = glm::uvec4(src.width, src.height, dst.width, dst.height);
+		dispatch(commandBuffer, bloomPipeline, downsampleSets[level], constants, dst, 8);
+		levelBarrier(level);
+	}
+
+	for (uint32_t level = levels - 1; level-- > 0;) {
+		VkExtent2D src = levelExtent(level + 1);
+		VkExtent2D dst = levelExtent(level);
+		constants.mode = BLOOM_UPSAMPLE;
+		constants.sizes = glm::uvec4(src.width, src.height, dst.width, dst.height);
+		dispatch(commandBuffer, bloomPipeline, upsampleSets[level], constants, dst, 8);
+		if (level > 0) {
+			levelBarrier(level);
+		}
+	}
+}
+
+void PostProcess::recordTonemap(VkCommandBuffer commandBuffer, uint32_t outputIndex) {
+	clearExposure(commandBuffer);
+
+	PostPushConstants constants = getPushConstants();
+	VkExtent2D first = levelExtent(0);
+	constants.sizes = glm::uvec4(first.width, first.height, screen.width, screen.height);
+	dispatch(commandBuffer, tonemapPipeline, outputSets[outputIndex], constants, screen, 8);
+}
+
+PostProcess::Bandwidth PostProcess::getBandwidth(VkFormat outputFormat) const {
+	const VkDeviceSize hdr = texels(screen) * texelSize(HDR_FORMAT);
+	const VkDeviceSize ldr = texels(screen) * texelSize(VK_FORMAT_R8G8B8A8_UNORM);
+	const VkDeviceSize output = texels(screen) * texelSize(outputFormat);
+	const VkDeviceSize bloomTexel = texelSize(BLOOM_FORMAT);
+
+	Bandwidth result;
+	result.histogram = config.autoExposure ? hdr : 0;
+
+	// Every level is written going down, then read by the next one. Going up, each level but the last reads the
+	// one below and reads and writes itself
+	if (config.bloom) {
+		result.bloom = hdr;
+		for (uint32_t level = 0; level < bloom.mipLevels; level++) {
+			VkDeviceSize levelBytes = texels(levelExtent(level)) * bloomTexel;
+			result.bloom += levelBytes * (level + 1 < bloom.mipLevels ? 4 : 2);
+		}
+	}
+
+	VkDeviceSize firstLevel = config.bloom ? texels(levelExtent(0)) * bloomTexel : 0;
+	result.tonemap = hdr + firstLevel + output;
+	result.unfusedTonemap = (hdr + firstLevel + hdr) + (hdr + ldr) + (ldr + output);
+	return result;
+}
+
+void PostProcess::destroy() {
+	destroyBloom();
+	vkutil::destroyBuffer(device, exposureBuffer);
+	vkDestroyDescriptorPool(device, descriptorPool, nullptr);
+	vkDestroySampler(device, sampler, nullptr);
+	vkDestroyPipeline(device, histogramPipeline, nullptr);
+	vkDestroyPipeline(device, exposurePipeline, nullptr);
+	vkDestroyPipeline(device, bloomPipeline, nullptr);
+	vkDestroyPipeline(device, tonemapPipeline, nullptr);
+	vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
+	vkDestroyDescriptorSetLayout(device, setLayout, nullptr);
+	descriptorPool = VK_NULL_HANDLE;
+	sampler = VK_NULL_HANDLE;
+	histogramPipeline = VK_NULL_HANDLE;
+	exposurePipeline = VK_NULL_HANDLE;
+	bloomPipeline = VK_NULL_HANDLE;
+	tonemapPipeline = VK_NULL_HANDLE;
+	pipelineLayout = VK_NULL_HANDLE;
+	setLayout = VK_NULL_HANDLE;
+}
+
+void PostProcess::clearExposure(VkCommandBuffer commandBuffer) {
+	if (exposureCleared) {
+		return;
+	}
+	exposureCleared = true;
+	vkCmdFillBuffer(commandBuffer, exposureBuffer.buffer, 0, VK_WHOLE_SIZE, 0);
+	vkutil::bufferBarrier(commandBuffer, exposureBuffer.buffer,
+		VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT,
+		VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+}
+
+void PostProcess::destroyBloom() {
+	for (VkImageView view : bloomLevelViews) {
+		vkDestroyImageView(device, view, nullptr);
+	}
+	bloomLevelViews.clear();
+	vkutil::destroyImage(device, bloom);
+	screen = { 0, 0 };
+}
+
+VkExtent2D PostProcess::levelExtent(uint32_t level) const {
+	return { std::max(screen.width >> (level + 1), 1u), std::max(screen.height >> (level + 1), 1u) };
+}
+
+PostPushConstants PostProcess::getPushConstants() const {
+	PostPushConstants constants = {};
+	constants.exposureParams = glm::vec4(config.minLogLuminance, config.logLuminanceRange, 0.0f, config.exposureCompensation);
+	constants.bloomParams	 = glm::vec4(config.bloomThreshold, config.bloomKnee, config.bloom ? config.bloomIntensity : 0.0f, config.bloomRadius);
+	constants.gradeParams	 = glm::vec4(config.saturation, config.contrast, encodeSrgb ? 1.0f : 0.0f, 0.0f);
+	constants.tint			 = glm::vec4(config.tint, 1.0f);
+	constants.renderScale	 = glm::vec2(renderExtent.width / static_cast<float>(std::max(screen.width, 1u)),
+		renderExtent.height / static_cast<float>(std::max(screen.height, 1u)));
+	return constants;
+}
+
+void PostProcess::dispatch(VkCommandBuffer commandBuffer, VkPipeline pipeline, VkDescriptorSet set, const PostPushConstants& constants,
+	VkExtent2D size, uint32_t groupSize) {
+
+	vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline);
+	vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout, 0, 1, &set, 0, nullptr);
+	vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(constants), &constants);
+	vkCmdDispatch(commandBuffer, (size.width + groupSize - 1) / groupSize, (size.height + groupSize - 1) / groupSize, 1);
+}
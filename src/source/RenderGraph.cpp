@@ -0,0 +1,927 @@
+#include "RenderGraph.h"
+#include "VulkanUtil.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace {
+
+	struct UsageInfo {
+		VkPipelineStageFlags stage;
+		VkAccessFlags access;
+		VkImageLayout layout;
+		VkImageUsageFlags imageUsage;
+		bool read;
+		bool write;
+	};
+
+	UsageInfo getUsageInfo(RenderGraph::Usage usage) {
+		typedef RenderGraph::Usage Usage;
+		switch (usage) {
+		case Usage::ColorAttachment:
+			return { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+				VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+				VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT, false, true };
+		case Usage::DepthAttachment:
+			return { VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+				VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+				VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT, false, true };
+		case Usage::ComputeSampledDepth:
+			return { VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT,
+				VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL, VK_IMAGE_USAGE_SAMPLED_BIT, true, false };
+		case Usage::ComputeSampled:
+			return { VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT,
+				VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_USAGE_SAMPLED_BIT, true, false };
+		case Usage::ComputeStorageImage:
+			return { VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT,
+				VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_USAGE_STORAGE_BIT, true, true };
+		case Usage::ComputeStorageRead:
+			return { VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT,
+				VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_USAGE_STORAGE_BIT, true, false };
+		case Usage::ComputeStorageWrite:
+			return { VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT,
+				VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_USAGE_STORAGE_BIT, true, true };
+		case Usage::VertexStorageRead:
+			return { VK_PIPELINE_STAGE_VERTEX_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT,
+				VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_USAGE_STORAGE_BIT, true, false };
+		case Usage::FragmentSampledDepth:
+			return { VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT,
+				VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL, VK_IMAGE_USAGE_SAMPLED_BIT, true, false };
+		case Usage::FragmentStorageRead:
+			return { VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT,
+				VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_USAGE_STORAGE_BIT, true, false };
+		case Usage::FragmentStorageWrite:
+			return { VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT,
+				VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_USAGE_STORAGE_BIT, true, true };
+		case Usage::IndirectRead:
+			return { VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, VK_ACCESS_INDIRECT_COMMAND_READ_BIT,
+				VK_IMAGE_LAYOUT_GENERAL, 0, true, false };
+		case Usage::TransferRead:
+			return { VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_READ_BIT,
+				VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_IMAGE_USAGE_TRANSFER_SRC_BIT, true, false };
+		case Usage::TransferWrite:
+			return { VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT,
+				VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_USAGE_TRANSFER_DST_BIT, false, true };
+		}
+		throw std::runtime_error("Unknown render graph usage.");
+	}
+
+	// Bytes per texel of the attachment formats we render to, close enough for bandwidth estimates
+	VkDeviceSize formatSize(VkFormat format) {
+		switch (format) {
+		case VK_FORMAT_D16_UNORM:
+			return 2;
+		case VK_FORMAT_R16G16B16A16_SFLOAT:
+		case VK_FORMAT_D32_SFLOAT_S8_UINT:
+			return 8;
+		case VK_FORMAT_R32G32B32A32_SFLOAT:
+			return 16;
+		default:
+			return 4;
+		}
+	}
+
+	VkDeviceSize attachmentSize(const RenderGraph::ImageDesc& desc) {
+		return static_cast<VkDeviceSize>(desc.extent.width) * desc.extent.height * desc.samples * formatSize(desc.format);
+	}
+
+	// Usage an image can have and still live in lazily allocated memory
+	const VkImageUsageFlags LAZY_USAGE = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT |
+		VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT;
+
+	bool overlaps(uint32_t firstA, uint32_t lastA, uint32_t firstB, uint32_t lastB) {
+		return firstA <= lastB && firstB <= lastA;
+	}
+
+}
+
+
+
+/// * * * * * PASS DECLARATION * * * * * ///
+
+RenderGraph::Pass::Pass(RenderGraph& renderGraph, const std::string& passName) : graph(renderGraph), name(passName) {
+}
+
+RenderGraph::Pass::ResourceUse& RenderGraph::Pass::addUse(Resource resource, Usage usage) {
+	if (resource >= graph.resources.size()) {
+		throw std::runtime_error("Render graph pass " + name + " uses an unknown resource.");
+	}
+
+	UsageInfo info = getUsageInfo(usage);
+	bool isImage = graph.resources[resource].isImage;
+
+	for (auto& existing : uses) {
+		if (existing.resource != resource) {
+			continue;
+		}
+		if (isImage && existing.layout != info.layout) {
+			throw std::runtime_error("Render graph pass " + name + " uses " + graph.resources[resource].name + " in two layouts.");
+		}
+		existing.stage |= info.stage;
+		existing.access |= info.access;
+		existing.imageUsage |= info.imageUsage;
+		existing.read = existing.read || info.read;
+		existing.write = existing.write || info.write;
+		return existing;
+	}
+
+	ResourceUse result;
+	result.resource = resource;
+	result.stage	= info.stage;
+	result.access	= info.access;
+	result.layout	= isImage ? info.layout : VK_IMAGE_LAYOUT_UNDEFINED;
+	result.imageUsage = isImage ? info.imageUsage : 0;
+	result.read		= info.read;
+	result.write	= info.write;
+	result.discard	= false;
+	uses.push_back(result);
+	return uses.back();
+}
+
+RenderGraph::Pass& RenderGraph::Pass::use(Resource resource, Usage usage) {
+	addUse(resource, usage);
+	return *this;
+}
+
+RenderGraph::Pass& RenderGraph::Pass::colorAttachment(Resource resource, VkAttachmentLoadOp loadOp, VkClearColorValue clear) {
+	ResourceUse& result = addUse(resource, Usage::ColorAttachment);
+	result.read = result.read || loadOp == VK_ATTACHMENT_LOAD_OP_LOAD;
+	result.discard = loadOp != VK_ATTACHMENT_LOAD_OP_LOAD;
+
+	Attachment attachment;
+	attachment.resource		= resource;
+	attachment.loadOp		= loadOp;
+	attachment.clear.color	= clear;
+	colorAttachments.push_back(attachment);
+	resolveAttachments.push_back(NO_RESOURCE);
+	return *this;
+}
+
+RenderGraph::Pass& RenderGraph::Pass::depthAttachment(Resource resource, VkAttachmentLoadOp loadOp, float clearDepth) {
+	if (!depthAttachments.empty()) {
+		throw std::runtime_error("Render graph pass " + name + " has more than one depth attachment.");
+	}
+
+	ResourceUse& result = addUse(resource, Usage::DepthAttachment);
+	result.read = result.read || loadOp == VK_ATTACHMENT_LOAD_OP_LOAD;
+	result.discard = loadOp != VK_ATTACHMENT_LOAD_OP_LOAD;
+
+	Attachment attachment;
+	attachment.resource				= resource;
+	attachment.loadOp				= loadOp;
+	attachment.clear.depthStencil	= { clearDepth, 0 };
+	depthAttachments.push_back(attachment);
+	return *this;
+}
+
+RenderGraph::Pass& RenderGraph::Pass::resolveAttachment(Resource resource) {
+	if (colorAttachments.empty() || resolveAttachments.back() != NO_RESOURCE) {
+		throw std::runtime_error("Render graph pass " + name + " resolves without a color attachment to resolve.");
+	}
+
+	// The resolve overwrites every pixel
+	ResourceUse& result = addUse(resource, Usage::ColorAttachment);
+	result.discard = true;
+	resolveAttachments.back() = resource;
+	return *this;
+}
+
+RenderGraph::Pass& RenderGraph::Pass::sideEffect() {
+	keep = true;
+	return *this;
+}
+
+RenderGraph::Pass& RenderGraph::Pass::renderArea(const VkExtent2D* renderArea) {
+	area = renderArea;
+	return *this;
+}
+
+RenderGraph::Pass& RenderGraph::Pass::execute(std::function<void(VkCommandBuffer)> passCallback) {
+	callback = std::move(passCallback);
+	return *this;
+}
+
+
+
+/// * * * * * GRAPH DECLARATION * * * * * ///
+
+void RenderGraph::reset() {
+	resources.clear();
+	passes.clear();
+	compiledPasses.clear();
+	barrierBatches.clear();
+}
+
+RenderGraph::Resource RenderGraph::createImage(const std::string& name, const ImageDesc& desc) {
+	ResourceData resource;
+	resource.name	 = name;
+	resource.isImage = true;
+	resource.desc	 = desc;
+	resources.push_back(resource);
+	return static_cast<Resource>(resources.size() - 1);
+}
+
+RenderGraph::Resource RenderGraph::importImage(const std::string& name, const ImageDesc& desc, const std::vector<VkImage>& images,
+	const std::vector<VkImageView>& views, VkImageLayout initialLayout, VkImageLayout finalLayout, VkPipelineStageFlags initialStage) {
+
+	if (images.empty() || images.size() != views.size()) {
+		throw std::runtime_error("Imported image " + name + " needs one view per image.");
+	}
+
+	ResourceData resource;
+	resource.name			= name;
+	resource.isImage		= true;
+	resource.imported		= true;
+	resource.desc			= desc;
+	resource.images			= images;
+	resource.views			= views;
+	resource.initialLayout	= initialLayout;
+	resource.finalLayout	= finalLayout;
+	resource.initialStage	= initialStage;
+	resource.finalStage		= VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
+	resources.push_back(resource);
+	return static_cast<Resource>(resources.size() - 1);
+}
+
+RenderGraph::Resource RenderGraph::importBuffer(const std::string& name, VkPipelineStageFlags finalStage, VkAccessFlags finalAccess) {
+	ResourceData resource;
+	resource.name		 = name;
+	resource.imported	 = true;
+	resource.finalStage	 = finalStage;
+	resource.finalAccess = finalAccess;
+	resources.push_back(resource);
+	return static_cast<Resource>(resources.size() - 1);
+}
+
+RenderGraph::Pass& RenderGraph::addPass(const std::string& name) {
+	passes.push_back(Pass(*this, name));
+	return passes.back();
+}
+
+
+
+/// * * * * * COMPILATION * * * * * ///
+
+void RenderGraph::compile(VkDevice device, VkPhysicalDevice physicalDevice) {
+	destroy(device);
+	stats = Stats();
+
+	cullPasses();
+	createTransientImages(device, physicalDevice);
+	createRenderPasses(device);
+
+	// Frames repeat the same passes, so the state one frame ends in is the state the next starts from.
+	// Run the frame once to find it, then plan the barriers from there
+	std::vector<ResourceState> states(resources.size());
+	for (size_t i = 0; i < resources.size(); i++) {
+		states[i].layout = resources[i].initialLayout;
+	}
+	simulate(states, nullptr);
+
+	std::vector<ResourceState> endStates = states;
+	for (size_t i = 0; i < resources.size(); i++) {
+		const ResourceData& resource = resources[i];
+		ResourceState& state = states[i];
+
+		if (!resource.imported) {
+			// Transient contents never survive, but the memory may still be in use by whichever
+			// image last occupied it
+			const ResourceState& previous = endStates[resource.aliasPredecessor];
+			state = ResourceState();
+			state.writeStages = previous.writeStages | previous.readStages;
+			state.writeAccess = previous.writeAccess;
+		} else if (resource.initialStage != 0) {
+			// Someone outside the graph, like the swap chain, hands the resource over at this stage
+			state = ResourceState();
+			state.layout	  = resource.initialLayout;
+			state.writeStages = resource.initialStage;
+		} else {
+			state.layout = resource.isImage ? resource.initialLayout : VK_IMAGE_LAYOUT_UNDEFINED;
+		}
+	}
+
+	barrierBatches.assign(compiledPasses.size() + 1, BarrierBatch());
+	simulate(states, &barrierBatches);
+
+	for (const auto& batch : barrierBatches) {
+		if (batch.srcStages != 0 || !batch.transitions.empty()) {
+			stats.barriers++;
+		}
+		stats.layoutTransitions += static_cast<uint32_t>(batch.transitions.size());
+	}
+}
+
+void RenderGraph::cullPasses() {
+	// Imported resources outlive the frame, so anything writing them is needed
+	std::vector<bool> needed(resources.size(), false);
+	for (size_t i = 0; i < resources.size(); i++) {
+		needed[i] = resources[i].imported;
+	}
+
+	for (auto it = passes.rbegin(); it != passes.rend(); ++it) {
+		Pass& pass = *it;
+		bool keep = pass.keep;
+		for (const auto& use : pass.uses) {
+			keep = keep || (use.write && needed[use.resource]);
+		}
+
+		pass.culled = !keep;
+		if (!keep) {
+			continue;
+		}
+		for (const auto& use : pass.uses) {
+			if (use.read) {
+				needed[use.resource] = true;
+			}
+		}
+	}
+
+	compiledPasses.clear();
+	for (auto& pass : passes) {
+		stats.passes++;
+		if (pass.culled) {
+			stats.culledPasses++;
+		} else {
+			compiledPasses.push_back(&pass);
+		}
+	}
+
+	for (auto& resource : resources) {
+		resource.used = false;
+		resource.usage = resource.desc.usage;
+	}
+	for (uint32_t i = 0; i < compiledPasses.size(); i++) {
+		for (const auto& use : compiledPasses[i]->uses) {
+			ResourceData& resource = resources[use.resource];
+			if (!resource.used) {
+				resource.used = true;
+				resource.firstPass = i;
+			}
+			resource.lastPass = i;
+			resource.usage |= use.imageUsage;
+		}
+	}
+}
+
+void RenderGraph::createTransientImages(VkDevice device, VkPhysicalDevice physicalDevice) {
+	struct Transient {
+		Resource resource;
+		VkMemoryRequirements requirements;
+	};
+	std::vector<Transient> transients;
+
+	for (Resource i = 0; i < resources.size(); i++) {
+		ResourceData& resource = resources[i];
+		resource.aliasPredecessor = i;
+		resource.lazy = false;
+		if (resource.imported || !resource.isImage || !resource.used) {
+			continue;
+		}
+
+		// Images that are only attachments of a single render pass never leave tile memory on tilers
+		bool transientAttachment = (resource.usage & ~LAZY_USAGE) == 0 && resource.firstPass == resource.lastPass;
+		if (transientAttachment) {
+			resource.usage |= VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT;
+		}
+
+		VkImageCreateInfo imageInfo = {};
+		imageInfo.sType			= VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+		imageInfo.imageType		= VK_IMAGE_TYPE_2D;
+		imageInfo.extent		= { resource.desc.extent.width, resource.desc.extent.height, 1 };
+		imageInfo.mipLevels		= resource.desc.mipLevels;
+		imageInfo.arrayLayers	= 1;
+		imageInfo.format		= resource.desc.format;
+		imageInfo.tiling		= VK_IMAGE_TILING_OPTIMAL;
+		imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		imageInfo.usage			= resource.usage;
+		imageInfo.samples		= resource.desc.samples;
+		imageInfo.sharingMode	= VK_SHARING_MODE_EXCLUSIVE;
+
+		VkImage image;
+		if (vkCreateImage(device, &imageInfo, nullptr, &image) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to create transient image " + resource.name + ".");
+		}
+		transientImages.push_back(image);
+		resource.images = { image };
+
+		Transient transient;
+		transient.resource = i;
+		vkGetImageMemoryRequirements(device, image, &transient.requirements);
+
+		stats.transientImages++;
+		stats.transientMemory += transient.requirements.size;
+
+		// Lazily allocated memory gets committed, if at all, as the device needs it. Aliasing it gains nothing
+		if (transientAttachment && vkutil::hasMemoryType(physicalDevice, transient.requirements.memoryTypeBits, VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT)) {
+			VkMemoryAllocateInfo allocInfo = {};
+			allocInfo.sType				= VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+			allocInfo.allocationSize	= transient.requirements.size;
+			allocInfo.memoryTypeIndex	= vkutil::findMemoryType(physicalDevice, transient.requirements.memoryTypeBits, VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT);
+
+			VkDeviceMemory memory;
+			if (vkAllocateMemory(device, &allocInfo, nullptr, &memory) != VK_SUCCESS) {
+				throw std::runtime_error("Failed to allocate lazy memory for " + resource.name + ".");
+			}
+			lazyMemory.push_back(memory);
+			vkBindImageMemory(device, image, memory, 0);
+
+			VkImageView view = vkutil::createImageView(device, image, resource.desc.format, resource.desc.aspect, 0, resource.desc.mipLevels);
+			transientViews.push_back(view);
+			resource.views = { view };
+			resource.lazy = true;
+
+			stats.lazyImages++;
+			stats.lazyMemory += transient.requirements.size;
+			continue;
+		}
+		transients.push_back(transient);
+	}
+
+	// Largest first, each image joins the first block it fits in whose images are all dead while it lives
+	std::sort(transients.begin(), transients.end(), [](const Transient& a, const Transient& b) {
+		return a.requirements.size > b.requirements.size;
+	});
+
+	struct Block {
+		VkDeviceSize size;
+		uint32_t memoryTypeBits;
+		std::vector<Resource> images;
+	};
+	std::vector<Block> blocks;
+
+	for (const auto& transient : transients) {
+		const ResourceData& resource = resources[transient.resource];
+
+		Block* target = nullptr;
+		for (auto& block : blocks) {
+			if ((block.memoryTypeBits & transient.requirements.memoryTypeBits) == 0) {
+				continue;
+			}
+			bool free = true;
+			for (Resource other : block.images) {
+				free = free && !overlaps(resource.firstPass, resource.lastPass, resources[other].firstPass, resources[other].lastPass);
+			}
+			if (free) {
+				target = &block;
+				break;
+			}
+		}
+
+		if (!target) {
+			blocks.push_back({ 0, transient.requirements.memoryTypeBits, {} });
+			target = &blocks.back();
+		}
+		target->size = std::max(target->size, transient.requirements.size);
+		target->memoryTypeBits &= transient.requirements.memoryTypeBits;
+		target->images.push_back(transient.resource);
+	}
+
+	for (auto& block : blocks) {
+		VkMemoryAllocateInfo allocInfo = {};
+		allocInfo.sType				= VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+		allocInfo.allocationSize	= block.size;
+		allocInfo.memoryTypeIndex	= vkutil::findMemoryType(physicalDevice, block.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+		VkDeviceMemory memory;
+		if (vkAllocateMemory(device, &allocInfo, nullptr, &memory) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to allocate transient image memory.");
+		}
+		transientMemory.push_back(memory);
+		stats.aliasedMemory += block.size;
+
+		// Images take turns in the block, each waiting for the one used before it. The first one of
+		// the frame waits for the last one of the previous frame
+		std::sort(block.images.begin(), block.images.end(), [&](Resource a, Resource b) {
+			return resources[a].firstPass < resources[b].firstPass;
+		});
+
+		for (size_t i = 0; i < block.images.size(); i++) {
+			ResourceData& resource = resources[block.images[i]];
+			resource.aliasPredecessor = block.images[(i + block.images.size() - 1) % block.images.size()];
+
+			vkBindImageMemory(device, resource.images[0], memory, 0);
+			VkImageView view = vkutil::createImageView(device, resource.images[0], resource.desc.format, resource.desc.aspect,
+				0, resource.desc.mipLevels);
+			transientViews.push_back(view);
+			resource.views = { view };
+		}
+	}
+}
+
+void RenderGraph::createRenderPasses(VkDevice device) {
+	for (uint32_t passIndex = 0; passIndex < compiledPasses.size(); passIndex++) {
+		Pass& pass = *compiledPasses[passIndex];
+		if (pass.colorAttachments.empty() && pass.depthAttachments.empty()) {
+			continue;
+		}
+
+		// Colors, then depth, then the resolve targets
+		std::vector<Pass::Attachment> attachments = pass.colorAttachments;
+		attachments.insert(attachments.end(), pass.depthAttachments.begin(), pass.depthAttachments.end());
+		uint32_t resolveBase = static_cast<uint32_t>(attachments.size());
+		for (Resource resolve : pass.resolveAttachments) {
+			if (resolve != NO_RESOURCE) {
+				Pass::Attachment attachment = {};
+				attachment.resource = resolve;
+				attachment.loadOp	= VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+				attachments.push_back(attachment);
+			}
+		}
+
+		std::vector<VkAttachmentDescription> descriptions;
+		std::vector<VkAttachmentReference> colorReferences;
+		std::vector<VkAttachmentReference> resolveReferences(pass.colorAttachments.size(), { VK_ATTACHMENT_UNUSED, VK_IMAGE_LAYOUT_UNDEFINED });
+		VkAttachmentReference depthReference = {};
+
+		for (uint32_t i = 0; i < attachments.size(); i++) {
+			const ResourceData& resource = resources[attachments[i].resource];
+			bool isDepth = i >= pass.colorAttachments.size() && i < resolveBase;
+			VkImageLayout layout = isDepth ? VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL : VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+			// Only keep what a later pass or the application will look at
+			bool store = resource.imported || resource.lastPass > passIndex;
+			if (store) {
+				stats.attachmentStoreBytes += attachmentSize(resource.desc);
+			} else {
+				stats.attachmentDiscardBytes += attachmentSize(resource.desc);
+			}
+
+			// Layouts are transitioned by the graph's barriers around the render pass
+			VkAttachmentDescription description = {};
+			description.format			= resource.desc.format;
+			description.samples			= resource.desc.samples;
+			description.loadOp			= attachments[i].loadOp;
+			description.storeOp			= store ? VK_ATTACHMENT_STORE_OP_STORE : VK_ATTACHMENT_STORE_OP_DONT_CARE;
+			description.stencilLoadOp	= VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+			description.stencilStoreOp	= VK_ATTACHMENT_STORE_OP_DONT_CARE;
+			description.initialLayout	= layout;
+			description.finalLayout		= layout;
+			descriptions.push_back(description);
+
+			VkAttachmentReference reference = {};
+			reference.attachment = i;
+			reference.layout	 = layout;
+			if (isDepth) {
+				depthReference = reference;
+			} else if (i < pass.colorAttachments.size()) {
+				colorReferences.push_back(reference);
+			}
+		}
+
+		bool resolves = false;
+		for (uint32_t color = 0, next = resolveBase; color < pass.resolveAttachments.size(); color++) {
+			if (pass.resolveAttachments[color] == NO_RESOURCE) {
+				continue;
+			}
+			if (resources[pass.colorAttachments[color].resource].desc.samples == VK_SAMPLE_COUNT_1_BIT ||
+				resources[pass.resolveAttachments[color]].desc.samples != VK_SAMPLE_COUNT_1_BIT) {
+				throw std::runtime_error("Render graph pass " + pass.name + " resolves between images of the wrong sample counts.");
+			}
+			resolveReferences[color] = { next++, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL };
+			resolves = true;
+		}
+
+		VkSubpassDescription subpass = {};
+		subpass.pipelineBindPoint		= VK_PIPELINE_BIND_POINT_GRAPHICS;
+		subpass.colorAttachmentCount	= static_cast<uint32_t>(colorReferences.size());
+		subpass.pColorAttachments		= colorReferences.data();
+		subpass.pResolveAttachments		= resolves ? resolveReferences.data() : nullptr;
+		subpass.pDepthStencilAttachment = pass.depthAttachments.empty() ? nullptr : &depthReference;
+
+		VkRenderPassCreateInfo renderPassInfo = {};
+		renderPassInfo.sType			= VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+		renderPassInfo.attachmentCount	= static_cast<uint32_t>(descriptions.size());
+		renderPassInfo.pAttachments		= descriptions.data();
+		renderPassInfo.subpassCount		= 1;
+		renderPassInfo.pSubpasses		= &subpass;
+
+		if (vkCreateRenderPass(device, &renderPassInfo, nullptr, &pass.renderPass) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to create render pass for " + pass.name + ".");
+		}
+		renderPasses.push_back(pass.renderPass);
+
+		// One framebuffer per imported image, swap chain images for example
+		size_t framebufferCount = 1;
+		for (const auto& attachment : attachments) {
+			framebufferCount = std::max(framebufferCount, resources[attachment.resource].views.size());
+		}
+
+		pass.extent = resources[attachments[0].resource].desc.extent;
+		pass.framebuffers.resize(framebufferCount);
+		for (size_t i = 0; i < framebufferCount; i++) {
+			std::vector<VkImageView> views;
+			for (const auto& attachment : attachments) {
+				views.push_back(getImageView(attachment.resource, static_cast<uint32_t>(i)));
+			}
+
+			VkFramebufferCreateInfo framebufferInfo = {};
+			framebufferInfo.sType			= VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+			framebufferInfo.renderPass		= pass.renderPass;
+			framebufferInfo.attachmentCount = static_cast<uint32_t>(views.size());
+			framebufferInfo.pAttachments	= views.data();
+			framebufferInfo.width			= pass.extent.width;
+			framebufferInfo.height			= pass.extent.height;
+			framebufferInfo.layers			= 1;
+
+			if (vkCreateFramebuffer(device, &framebufferInfo, nullptr, &pass.framebuffers[i]) != VK_SUCCESS) {
+				throw std::runtime_error("Failed to create framebuffer for " + pass.name + ".");
+			}
+			framebuffers.push_back(pass.framebuffers[i]);
+		}
+	}
+}
+
+void RenderGraph::simulate(std::vector<ResourceState>& states, std::vector<BarrierBatch>* batches) const {
+	for (uint32_t i = 0; i < compiledPasses.size(); i++) {
+		BarrierBatch* batch = batches ? &(*batches)[i] : nullptr;
+		for (const auto& use : compiledPasses[i]->uses) {
+			const ResourceData& resource = resources[use.resource];
+			applyUse(states[use.resource], resource, use, resource.firstPass == i, batch);
+		}
+		compiledPasses[i]->barrierBatch = i;
+	}
+
+	// Hand imported resources back the way the application expects them
+	BarrierBatch* batch = batches ? &batches->back() : nullptr;
+	for (Resource i = 0; i < resources.size(); i++) {
+		const ResourceData& resource = resources[i];
+		ResourceState& state = states[i];
+		if (!resource.imported || !resource.used) {
+			continue;
+		}
+
+		bool transition = resource.isImage && state.layout != resource.finalLayout;
+		bool visibility = resource.finalAccess != 0 && state.writeStages != 0 && (state.writeAccess != 0);
+		if (!transition && !visibility) {
+			continue;
+		}
+
+		VkPipelineStageFlags dstStage = resource.finalStage != 0 ? resource.finalStage : static_cast<VkPipelineStageFlags>(VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT);
+		if (batch) {
+			batch->srcStages |= state.writeStages | state.readStages;
+			batch->dstStages |= dstStage;
+			if (transition) {
+				batch->transitions.push_back({ i, state.layout, resource.finalLayout, state.writeAccess, resource.finalAccess });
+			} else {
+				batch->srcAccess |= state.writeAccess;
+				batch->dstAccess |= resource.finalAccess;
+			}
+		}
+
+		state.layout		= transition ? resource.finalLayout : state.layout;
+		state.writeStages	= dstStage;
+		state.writeAccess	= 0;
+		state.readStages	= 0;
+		state.visibleStages = 0;
+		state.visibleAccess = 0;
+	}
+}
+
+void RenderGraph::applyUse(ResourceState& state, const ResourceData& resource, const Pass::ResourceUse& use, bool firstUse, BarrierBatch* batch) const {
+	bool transition = resource.isImage && (state.layout != use.layout || (firstUse && !resource.imported));
+
+	if (transition || use.write) {
+		// Wait for every earlier access. Writes must also be made visible before being overwritten
+		VkPipelineStageFlags srcStages = state.writeStages | state.readStages;
+		if (batch && (srcStages != 0 || transition)) {
+			batch->srcStages |= srcStages;
+			batch->dstStages |= use.stage;
+			if (transition) {
+				VkImageLayout oldLayout = use.discard || (firstUse && !resource.imported) ? VK_IMAGE_LAYOUT_UNDEFINED : state.layout;
+				batch->transitions.push_back({ use.resource, oldLayout, use.layout, state.writeAccess, use.access });
+			} else {
+				batch->srcAccess |= state.writeAccess;
+				batch->dstAccess |= use.access;
+			}
+		}
+
+		// A layout transition counts as a write that the using stage has already seen
+		state.layout		= resource.isImage ? use.layout : state.layout;
+		state.writeStages	= use.stage;
+		state.writeAccess	= use.write ? use.access & (VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT |
+			VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT) : 0;
+		state.readStages	= 0;
+		state.visibleStages = use.write ? 0 : use.stage;
+		state.visibleAccess = use.write ? 0 : use.access;
+		return;
+	}
+
+	// Reads only wait for the last write, and only once per stage and access
+	bool visible = (state.visibleStages & use.stage) == use.stage && (state.visibleAccess & use.access) == use.access;
+	if (state.writeStages != 0 && !visible) {
+		if (batch) {
+			batch->srcStages |= state.writeStages;
+			batch->srcAccess |= state.writeAccess;
+			batch->dstStages |= use.stage;
+			batch->dstAccess |= use.access;
+		}
+		state.visibleStages |= use.stage;
+		state.visibleAccess |= use.access;
+	}
+	state.readStages |= use.stage;
+}
+
+
+
+/// * * * * * EXECUTION * * * * * ///
+
+void RenderGraph::execute(VkCommandBuffer commandBuffer, uint32_t importIndex) const {
+	for (const Pass* pass : compiledPasses) {
+		recordBarriers(commandBuffer, barrierBatches[pass->barrierBatch], importIndex);
+
+		if (pass->renderPass == VK_NULL_HANDLE) {
+			if (pass->callback) {
+				pass->callback(commandBuffer);
+			}
+			continue;
+		}
+
+		std::vector<VkClearValue> clearValues;
+		for (const auto& attachment : pass->colorAttachments) {
+			clearValues.push_back(attachment.clear);
+		}
+		for (const auto& attachment : pass->depthAttachments) {
+			clearValues.push_back(attachment.clear);
+		}
+
+		VkRenderPassBeginInfo renderPassInfo = {};
+		renderPassInfo.sType				= VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+		renderPassInfo.renderPass			= pass->renderPass;
+		renderPassInfo.framebuffer			= pass->framebuffers[importIndex % pass->framebuffers.size()];
+		renderPassInfo.renderArea.offset	= { 0, 0 };
+		renderPassInfo.renderArea.extent	= pass->extent;
+		if (pass->area) {
+			renderPassInfo.renderArea.extent = { std::min(pass->area->width, pass->extent.width), std::min(pass->area->height, pass->extent.height) };
+		}
+		renderPassInfo.clearValueCount		= static_cast<uint32_t>(clearValues.size());
+		renderPassInfo.pClearValues			= clearValues.data();
+
+		vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+		if (pass->callback) {
+			pass->callback(commandBuffer);
+		}
+		vkCmdEndRenderPass(commandBuffer);
+	}
+
+	recordBarriers(commandBuffer, barrierBatches.back(), importIndex);
+}
+
+void RenderGraph::recordBarriers(VkCommandBuffer commandBuffer, const BarrierBatch& batch, uint32_t importIndex) const {
+	if (batch.srcStages == 0 && batch.transitions.empty()) {
+		return;
+	}
+
+	VkMemoryBarrier memoryBarrier = {};
+	memoryBarrier.sType			= VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	memoryBarrier.srcAccessMask = batch.srcAccess;
+	memoryBarrier.dstAccessMask = batch.dstAccess;
+	bool hasMemoryBarrier = batch.srcAccess != 0 || batch.dstAccess != 0;
+
+	std::vector<VkImageMemoryBarrier> imageBarriers;
+	for (const auto& transition : batch.transitions) {
+		const ResourceData& resource = resources[transition.resource];
+
+		VkImageMemoryBarrier barrier = {};
+		barrier.sType							= VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+		barrier.oldLayout						= transition.oldLayout;
+		barrier.newLayout						= transition.newLayout;
+		barrier.srcQueueFamilyIndex				= VK_QUEUE_FAMILY_IGNORED;
+		barrier.dstQueueFamilyIndex				= VK_QUEUE_FAMILY_IGNORED;
+		barrier.image							= getImage(transition.resource, importIndex);
+		barrier.subresourceRange.aspectMask		= resource.desc.aspect;
+		barrier.subresourceRange.baseMipLevel	= 0;
+		barrier.subresourceRange.levelCount		= VK_REMAINING_MIP_LEVELS;
+		barrier.subresourceRange.baseArrayLayer = 0;
+		barrier.subresourceRange.layerCount		= 1;
+		barrier.srcAccessMask					= transition.srcAccess;
+		barrier.dstAccessMask					= transition.dstAccess;
+		imageBarriers.push_back(barrier);
+	}
+
+	vkCmdPipelineBarrier(commandBuffer,
+		batch.srcStages != 0 ? batch.srcStages : static_cast<VkPipelineStageFlags>(VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT),
+		batch.dstStages != 0 ? batch.dstStages : static_cast<VkPipelineStageFlags>(VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT),
+		0, hasMemoryBarrier ? 1 : 0, &memoryBarrier, 0, nullptr,
+		static_cast<uint32_t>(imageBarriers.size()), imageBarriers.data());
+}
+
+void RenderGraph::destroy(VkDevice device) {
+	for (auto framebuffer : framebuffers) {
+		vkDestroyFramebuffer(device, framebuffer, nullptr);
+	}
+	for (auto renderPass : renderPasses) {
+		vkDestroyRenderPass(device, renderPass, nullptr);
+	}
+	for (auto view : transientViews) {
+		vkDestroyImageView(device, view, nullptr);
+	}
+	for (auto image : transientImages) {
+		vkDestroyImage(device, image, nullptr);
+	}
+	for (auto memory : transientMemory) {
+		vkFreeMemory(device, memory, nullptr);
+	}
+	for (auto memory : lazyMemory) {
+		vkFreeMemory(device, memory, nullptr);
+	}
+
+	framebuffers.clear();
+	renderPasses.clear();
+	transientViews.clear();
+	transientImages.clear();
+	transientMemory.clear();
+	lazyMemory.clear();
+
+	for (auto& pass : passes) {
+		pass.renderPass = VK_NULL_HANDLE;
+		pass.framebuffers.clear();
+	}
+	for (auto& resource : resources) {
+		if (!resource.imported) {
+			resource.images.clear();
+			resource.views.clear();
+		}
+	}
+}
+
+VkImage RenderGraph::getImage(Resource resource, uint32_t importIndex) const {
+	const auto& images = resources.at(resource).images;
+	if (images.empty()) {
+		throw std::runtime_error("Render graph image " + resources[resource].name + " was culled or not compiled.");
+	}
+	return images[importIndex % images.size()];
+}
+
+VkImageView RenderGraph::getImageView(Resource resource, uint32_t importIndex) const {
+	const auto& views = resources.at(resource).views;
+	if (views.empty()) {
+		throw std::runtime_error("Render graph image " + resources[resource].name + " was culled or not compiled.");
+	}
+	return views[importIndex % views.size()];
+}
+
+VkDeviceSize RenderGraph::getCommittedLazyMemory(VkDevice device) const {
+	VkDeviceSize result = 0;
+	for (auto memory : lazyMemory) {
+		VkDeviceSize committed = 0;
+		vkGetDeviceMemoryCommitment(device, memory, &committed);
+		result += committed;
+	}
+	return result;
+}
+
+VkRenderPass RenderGraph::createCompatibleRenderPass(VkDevice device, const std::vector<VkFormat>& colorFormats, VkFormat depthFormat,
+	VkSampleCountFlagBits samples) {
+	std::vector<VkAttachmentDescription> descriptions;
+	std::vector<VkAttachmentReference> colorReferences;
+
+	for (VkFormat format : colorFormats) {
+		VkAttachmentDescription description = {};
+		description.format			= format;
+		description.samples			= samples;
+		description.loadOp			= VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+		description.storeOp			= VK_ATTACHMENT_STORE_OP_DONT_CARE;
+		description.stencilLoadOp	= VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+		description.stencilStoreOp	= VK_ATTACHMENT_STORE_OP_DONT_CARE;
+		description.initialLayout	= VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+		description.finalLayout		= VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+		colorReferences.push_back({ static_cast<uint32_t>(descriptions.size()), VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL });
+		descriptions.push_back(description);
+	}
+
+	VkAttachmentReference depthReference = {};
+	if (depthFormat != VK_FORMAT_UNDEFINED) {
+		VkAttachmentDescription description = {};
+		description.format			= depthFormat;
+		description.samples			= samples;
+		description.loadOp			= VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+		description.storeOp			= VK_ATTACHMENT_STORE_OP_DONT_CARE;
+		description.stencilLoadOp	= VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+		description.stencilStoreOp	= VK_ATTACHMENT_STORE_OP_DONT_CARE;
+		description.initialLayout	= VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+		description.finalLayout		= VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+		depthReference = { static_cast<uint32_t>(descriptions.size()), VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL };
+		descriptions.push_back(description);
+	}
+
+	VkSubpassDescription subpass = {};
+	subpass.pipelineBindPoint		= VK_PIPELINE_BIND_POINT_GRAPHICS;
+	subpass.colorAttachmentCount	= static_cast<uint32_t>(colorReferences.size());
+	subpass.pColorAttachments		= colorReferences.data();
+	subpass.pDepthStencilAttachment = depthFormat != VK_FORMAT_UNDEFINED ? &depthReference : nullptr;
+
+	VkRenderPassCreateInfo renderPassInfo = {};
+	renderPassInfo.sType			= VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+	renderPassInfo.attachmentCount	= static_cast<uint32_t>(descriptions.size());
+	renderPassInfo.pAttachments		= descriptions.data();
+	renderPassInfo.subpassCount		= 1;
+	renderPassInfo.pSubpasses		= &subpass;
+
+	VkRenderPass result;
+	if (vkCreateRenderPass(device, &renderPassInfo, nullptr, &result) != VK_SUCCESS) {
+		throw std::runtime_error("Render pass creation failed.");
+	}
+	return result;
+}
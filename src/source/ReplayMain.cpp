@@ -0,0 +1,84 @@
+
+// Entry point of vulkanReplay. Runs a trace written with the application's --trace headlessly, prints its frame
+// timings next to the traced ones as CSV on stdout and a summary on stderr
+
+#include "TraceReplay.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+#include <numeric>
+#include <stdexcept>
+#include <string>
+
+namespace {
+
+	// Arguments are of the form --name=value, as the application's, with the trace as the one without a name
+	TraceReplay::Config parse(int argc, char** argv) {
+		TraceReplay::Config result;
+
+		for (int i = 1; i < argc; i++) {
+			std::string arg = argv[i];
+			size_t split = arg.find('=');
+			std::string name = arg.substr(0, split);
+			std::string value = split == std::string::npos ? "" : arg.substr(split + 1);
+
+			if (name == "--trace") {
+				result.path = value;
+			} else if (name == "--paced") {
+				result.paced = true;
+			} else if (name == "--device") {
+				result.deviceName = value;
+			} else if (arg.compare(0, 2, "--") != 0 && result.path.empty()) {
+				result.path = arg;
+			} else {
+				throw std::runtime_error("Unknown argument: " + arg);
+			}
+		}
+
+		if (result.path.empty()) {
+			throw std::runtime_error("Expected a trace, vulkanReplay <file> [--paced] [--device=<name>]");
+		}
+		return result;
+	}
+
+	// Nearest rank, of timings sorted already
+	double percentile(const std::vector<double>& sorted, double fraction) {
+		size_t rank = static_cast<size_t>(fraction * static_cast<double>(sorted.size() - 1) + 0.5);
+		return sorted[rank];
+	}
+
+}
+
+int main(int argc, char** argv) {
+	try {
+		TraceReplay::Config config = parse(argc, argv);
+
+		TraceReplay replay(config);
+		TraceReplay::Result result = replay.run();
+		std::cerr << "Device: " << replay.getDeviceName() << ", traced on " << replay.getTracedDeviceName() << std::endl;
+
+		std::cout << "frame,ms,traced_ms" << std::endl;
+		for (size_t i = 0; i < result.frameMs.size(); i++) {
+			std::cout << i + 1 << "," << result.frameMs[i] << "," << result.tracedFrameMs[i] << std::endl;
+		}
+
+		std::cerr << result.calls << " calls, setup " << result.setupMs << " ms" << std::endl;
+		if (!result.frameMs.empty()) {
+			std::vector<double> sorted = result.frameMs;
+			std::sort(sorted.begin(), sorted.end());
+			double mean = std::accumulate(sorted.begin(), sorted.end(), 0.0) / static_cast<double>(sorted.size());
+			double tracedMean = std::accumulate(result.tracedFrameMs.begin(), result.tracedFrameMs.end(), 0.0) / static_cast<double>(sorted.size());
+			std::cerr << sorted.size() << " frames: mean " << mean << " ms, p50 " << percentile(sorted, 0.5) << " ms, p95 "
+				<< percentile(sorted, 0.95) << " ms, max " << sorted.back() << " ms (traced mean " << tracedMean << " ms)" << std::endl;
+		}
+		if (!result.complete) {
+			std::cerr << "The trace stops early, the application did not finish writing it" << std::endl;
+		}
+	} catch (const std::exception& e) {
+		std::cerr << e.what() << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,169 @@
+
+#include "Scene.h"
+#include "Simplifier.h"
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+
+glm::vec4 Scene::getBoundingSphere(const SceneObject& object) const {
+	const Mesh& mesh = meshes[object.meshIndex];
+
+	glm::vec3 center = glm::vec3(object.model * glm::vec4(mesh.boundsCenter, 1.0f));
+
+	// A non uniform scale stretches the sphere by its largest axis
+	float scale = std::max({
+		glm::length(glm::vec3(object.model[0])),
+		glm::length(glm::vec3(object.model[1])),
+		glm::length(glm::vec3(object.model[2])) });
+
+	return glm::vec4(center, mesh.boundsRadius * scale);
+}
+
+void Scene::addLights(uint32_t count, uint32_t seed) {
+	std::mt19937 rng(seed);
+	std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+
+	for (uint32_t i = 0; i < count; i++) {
+		PointLight light;
+		light.position = glm::vec3((unit(rng) * 2.0f - 1.0f) * extent, 0.5f + 2.5f * unit(rng), (unit(rng) * 2.0f - 1.0f) * extent);
+		light.radius = 3.0f + 5.0f * unit(rng);
+
+		// Saturated colors, so overlapping lights are easy to tell apart
+		glm::vec3 color = glm::vec3(unit(rng), unit(rng), unit(rng));
+		color /= std::max({ color.r, color.g, color.b, 0.001f });
+		light.color = color * (1.0f + 2.0f * unit(rng));
+
+		light.driftRadius = 0.5f + 2.0f * unit(rng);
+		light.driftSpeed = (unit(rng) - 0.5f) * 2.0f;
+		light.driftPhase = unit(rng) * 6.2831853f;
+		lights.push_back(light);
+	}
+}
+
+void Scene::getLights(float time, std::vector<LightData>& result) const {
+	result.resize(lights.size());
+	for (size_t i = 0; i < lights.size(); i++) {
+		const PointLight& light = lights[i];
+		float angle = light.driftPhase + light.driftSpeed * time;
+		glm::vec3 position = light.position + light.driftRadius * glm::vec3(std::cos(angle), 0.0f, std::sin(angle));
+
+		result[i].positionRadius = glm::vec4(position, light.radius);
+		result[i].color			 = glm::vec4(light.color, 0.0f);
+	}
+}
+
+// Build the level of detail chain and clusters of every mesh in a scene
+static void prepareMeshes(Scene& scene) {
+	for (auto& mesh : scene.meshes) {
+		simplifier::generateLods(mesh);
+		meshlet::build(mesh);
+	}
+}
+
+Scene Scene::createCity(uint32_t gridSize, uint32_t seed) {
+	Scene scene;
+
+	const uint32_t cubeMesh = 0;
+	const uint32_t sphereMesh = 1;
+	scene.meshes.push_back(mesh::createCube());
+	scene.meshes.push_back(mesh::createSphere(32, 24));
+	prepareMeshes(scene);
+
+	const float blockSpacing = 4.0f;
+	scene.extent = gridSize * blockSpacing * 0.5f;
+
+	std::mt19937 rng(seed);
+	std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+
+	// Ground plane under the whole city
+	SceneObject ground;
+	ground.model = glm::scale(glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, -0.05f, 0.0f)),
+		glm::vec3(scene.extent * 2.0f + blockSpacing, 0.1f, scene.extent * 2.0f + blockSpacing));
+	ground.color = glm::vec4(0.25f, 0.27f, 0.25f, 1.0f);
+	ground.meshIndex = cubeMesh;
+	ground.ground = true;
+	scene.objects.push_back(ground);
+
+	for (uint32_t x = 0; x < gridSize; x++) {
+		for (uint32_t z = 0; z < gridSize; z++) {
+			glm::vec3 blockCenter = glm::vec3(
+				(x + 0.5f) * blockSpacing - scene.extent, 0.0f,
+				(z + 0.5f) * blockSpacing - scene.extent);
+
+			// One building per block, tall enough to hide most of what is behind it
+			float height = 2.0f + 10.0f * unit(rng) * unit(rng);
+			float width = 2.6f + 0.8f * unit(rng);
+			float depth = 2.6f + 0.8f * unit(rng);
+			float shade = 0.45f + 0.35f * unit(rng);
+
+			SceneObject building;
+			building.model = glm::scale(glm::translate(glm::mat4(1.0f), blockCenter + glm::vec3(0.0f, height * 0.5f, 0.0f)),
+				glm::vec3(width, height, depth));
+			building.color = glm::vec4(shade, shade, shade * 1.05f, 1.0f);
+			building.meshIndex = cubeMesh;
+			building.occluder = true;
+			scene.objects.push_back(building);
+
+			// Small props on the street corners around the building
+			for (uint32_t prop = 0; prop < 2; prop++) {
+				float radius = 0.3f + 0.3f * unit(rng);
+				glm::vec3 offset = prop == 0 ?
+					glm::vec3(blockSpacing * 0.5f, radius, blockSpacing * (unit(rng) - 0.5f)) :
+					glm::vec3(blockSpacing * (unit(rng) - 0.5f), radius, blockSpacing * 0.5f);
+
+				SceneObject object;
+				object.model = glm::scale(glm::translate(glm::mat4(1.0f), blockCenter + offset), glm::vec3(radius * 2.0f));
+				object.color = glm::vec4(unit(rng), unit(rng), unit(rng), 1.0f);
+				object.meshIndex = sphereMesh;
+				object.dynamic = true;
+				scene.objects.push_back(object);
+			}
+		}
+	}
+
+	return scene;
+}
+
+Scene Scene::createDense(uint32_t gridSize, uint32_t seed) {
+	Scene scene;
+
+	const uint32_t cubeMesh = 0;
+	const uint32_t sphereMesh = 1;
+	scene.meshes.push_back(mesh::createCube());
+	scene.meshes.push_back(mesh::createSphere(128, 96));
+	prepareMeshes(scene);
+
+	const float spacing = 3.0f;
+	scene.extent = gridSize * spacing * 0.5f;
+
+	std::mt19937 rng(seed);
+	std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+
+	SceneObject ground;
+	ground.model = glm::scale(glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, -0.05f, 0.0f)),
+		glm::vec3(scene.extent * 2.0f + spacing, 0.1f, scene.extent * 2.0f + spacing));
+	ground.color = glm::vec4(0.25f, 0.27f, 0.25f, 1.0f);
+	ground.meshIndex = cubeMesh;
+	ground.ground = true;
+	scene.objects.push_back(ground);
+
+	for (uint32_t x = 0; x < gridSize; x++) {
+		for (uint32_t z = 0; z < gridSize; z++) {
+			float radius = 0.6f + 0.6f * unit(rng);
+			glm::vec3 center = glm::vec3(
+				(x + 0.5f) * spacing - scene.extent, radius,
+				(z + 0.5f) * spacing - scene.extent);
+
+			SceneObject object;
+			object.model = glm::scale(glm::translate(glm::mat4(1.0f), center), glm::vec3(radius * 2.0f));
+			object.color = glm::vec4(unit(rng), unit(rng), unit(rng), 1.0f);
+			object.meshIndex = sphereMesh;
+			scene.objects.push_back(object);
+		}
+	}
+
+	return scene;
+}
@@ -0,0 +1,652 @@
+#include "ShadowMaps.h"
+
+#include "Vertex.h"
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+
+namespace {
+
+	// Texels of a cascade's tile in the atlas, two cascades a side
+	VkOffset2D atlasTile(uint32_t cascade, uint32_t size) {
+		return { static_cast<int32_t>((cascade % 2) * size), static_cast<int32_t>((cascade / 2) * size) };
+	}
+
+	// Texels of a cached cascade's tile in the cache, the cached cascades side by side
+	VkOffset2D cacheTile(uint32_t cascade, uint32_t size) {
+		return { static_cast<int32_t>((cascade - ShadowMaps::FIRST_CACHED_CASCADE) * size), 0 };
+	}
+
+}
+
+ShadowMaps::ShadowMaps(VkDevice logicalDevice, VkPhysicalDevice physical, const AssetLoader& assets, VkDescriptorSetLayout frameSetLayout, const Config& shadowConfig) :
+	device(logicalDevice),
+	physicalDevice(physical),
+	config(shadowConfig) {
+
+	config.lightDirection = glm::normalize(config.lightDirection);
+
+	const uint32_t size = config.cascadeSize;
+	atlas = vkutil::createImage(device, physicalDevice, { size * 2, size * 2 }, 1, FORMAT,
+		VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT, VK_IMAGE_ASPECT_DEPTH_BIT);
+	cache = vkutil::createImage(device, physicalDevice, { size * CACHED_CASCADES, size }, 1, FORMAT,
+		VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT, VK_IMAGE_ASPECT_DEPTH_BIT);
+
+	// Four comparisons filtered into one where the format allows it
+	VkFormatProperties formatProperties;
+	vkGetPhysicalDeviceFormatProperties(physicalDevice, FORMAT, &formatProperties);
+	VkFilter filter = (formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT) ? VK_FILTER_LINEAR : VK_FILTER_NEAREST;
+
+	VkSamplerCreateInfo samplerInfo = {};
+	samplerInfo.sType		 = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+	samplerInfo.magFilter	 = filter;
+	samplerInfo.minFilter	 = filter;
+	samplerInfo.mipmapMode	 = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+	samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+	samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+	samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+	samplerInfo.compareEnable = VK_TRUE;
+	samplerInfo.compareOp	 = VK_COMPARE_OP_LESS_OR_EQUAL;
+	samplerInfo.maxLod		 = 0.0f;
+	samplerInfo.borderColor	 = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE;
+
+	if (vkCreateSampler(device, &samplerInfo, nullptr, &sampler) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create shadow sampler.");
+	}
+
+	// Loads what the cache holds, the layout is transitioned around it by recordCache
+	VkAttachmentDescription attachment = {};
+	attachment.format		  = FORMAT;
+	attachment.samples		  = VK_SAMPLE_COUNT_1_BIT;
+	attachment.loadOp		  = VK_ATTACHMENT_LOAD_OP_LOAD;
+	attachment.storeOp		  = VK_ATTACHMENT_STORE_OP_STORE;
+	attachment.stencilLoadOp  = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+	attachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+	attachment.initialLayout  = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+	attachment.finalLayout	  = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+	VkAttachmentReference depthReference = { 0, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL };
+
+	VkSubpassDescription subpass = {};
+	subpass.pipelineBindPoint		= VK_PIPELINE_BIND_POINT_GRAPHICS;
+	subpass.pDepthStencilAttachment = &depthReference;
+
+	VkRenderPassCreateInfo renderPassInfo = {};
+	renderPassInfo.sType		   = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+	renderPassInfo.attachmentCount = 1;
+	renderPassInfo.pAttachments	   = &attachment;
+	renderPassInfo.subpassCount	   = 1;
+	renderPassInfo.pSubpasses	   = &subpass;
+
+	if (vkCreateRenderPass(device, &renderPassInfo, nullptr, &cacheRenderPass) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create shadow cache render pass.");
+	}
+
+	VkFramebufferCreateInfo framebufferInfo = {};
+	framebufferInfo.sType			= VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+	framebufferInfo.renderPass		= cacheRenderPass;
+	framebufferInfo.attachmentCount = 1;
+	framebufferInfo.pAttachments	= &cache.view;
+	framebufferInfo.width			= cache.extent.width;
+	framebufferInfo.height			= cache.extent.height;
+	framebufferInfo.layers			= 1;
+
+	if (vkCreateFramebuffer(device, &framebufferInfo, nullptr, &cacheFramebuffer) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create shadow cache framebuffer.");
+	}
+
+	VkDescriptorSetLayoutBinding bindings[3] = {};
+	bindings[0].binding			= 0;
+	bindings[0].descriptorType	= VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+	bindings[0].descriptorCount = 1;
+	bindings[0].stageFlags		= VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
+	bindings[1].binding			= 1;
+	bindings[1].descriptorType	= VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	bindings[1].descriptorCount = 1;
+	bindings[1].stageFlags		= VK_SHADER_STAGE_FRAGMENT_BIT;
+	bindings[2].binding			= 2;
+	bindings[2].descriptorType	= VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	bindings[2].descriptorCount = 1;
+	bindings[2].stageFlags		= VK_SHADER_STAGE_VERTEX_BIT;
+
+	VkDescriptorSetLayoutCreateInfo layoutInfo = {};
+	layoutInfo.sType		= VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	layoutInfo.bindingCount = 3;
+	layoutInfo.pBindings	= bindings;
+
+	if (vkCreateDescriptorSetLayout(device, &layoutInfo, nullptr, &setLayout) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create shadow descriptor set layout.");
+	}
+
+	VkDescriptorPoolSize poolSizes[3] = {};
+	for (uint32_t i = 0; i < 3; i++) {
+		poolSizes[i].type			 = bindings[i].descriptorType;
+		poolSizes[i].descriptorCount = config.framesInFlight;
+	}
+
+	VkDescriptorPoolCreateInfo poolInfo = {};
+	poolInfo.sType		   = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+	poolInfo.poolSizeCount = 3;
+	poolInfo.pPoolSizes	   = poolSizes;
+	poolInfo.maxSets	   = config.framesInFlight;
+
+	if (vkCreateDescriptorPool(device, &poolInfo, nullptr, &descriptorPool) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create shadow descriptor pool.");
+	}
+
+	std::vector<VkDescriptorSetLayout> layouts(config.framesInFlight, setLayout);
+	descriptorSets.resize(config.framesInFlight);
+
+	VkDescriptorSetAllocateInfo allocInfo = {};
+	allocInfo.sType				 = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+	allocInfo.descriptorPool	 = descriptorPool;
+	allocInfo.descriptorSetCount = config.framesInFlight;
+	allocInfo.pSetLayouts		 = layouts.data();
+
+	if (vkAllocateDescriptorSets(device, &allocInfo, descriptorSets.data()) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to allocate shadow descriptor sets.");
+	}
+
+	// The id buffers are sized and written to the sets once the casters are known
+	idBuffers.resize(config.framesInFlight);
+	for (uint32_t frame = 0; frame < config.framesInFlight; frame++) {
+		shadowBuffers.push_back(vkutil::createBuffer(device, physicalDevice, sizeof(ShadowData),
+			VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT));
+
+		VkDescriptorBufferInfo bufferInfo = {};
+		bufferInfo.buffer = shadowBuffers[frame].buffer;
+		bufferInfo.offset = 0;
+		bufferInfo.range  = sizeof(ShadowData);
+
+		VkDescriptorImageInfo imageInfo = {};
+		imageInfo.sampler	  = sampler;
+		imageInfo.imageView	  = atlas.view;
+		imageInfo.imageLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+
+		VkWriteDescriptorSet writes[2] = {};
+		writes[0].sType			  = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		writes[0].dstSet		  = descriptorSets[frame];
+		writes[0].dstBinding	  = 0;
+		writes[0].descriptorCount = 1;
+		writes[0].descriptorType  = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+		writes[0].pBufferInfo	  = &bufferInfo;
+		writes[1].sType			  = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		writes[1].dstSet		  = descriptorSets[frame];
+		writes[1].dstBinding	  = 1;
+		writes[1].descriptorCount = 1;
+		writes[1].descriptorType  = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+		writes[1].pImageInfo	  = &imageInfo;
+		vkUpdateDescriptorSets(device, 2, writes, 0, nullptr);
+	}
+
+	// The frame's set gives the shadow pass the objects, its own set follows
+	VkPushConstantRange pushConstantRange = {};
+	pushConstantRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+	pushConstantRange.offset	 = 0;
+	pushConstantRange.size		 = sizeof(ShadowPushConstants);
+
+	VkDescriptorSetLayout setLayouts[] = { frameSetLayout, setLayout };
+	VkPipelineLayoutCreateInfo pipelineLayoutInfo = {};
+	pipelineLayoutInfo.sType				  = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+	pipelineLayoutInfo.setLayoutCount		  = 2;
+	pipelineLayoutInfo.pSetLayouts			  = setLayouts;
+	pipelineLayoutInfo.pushConstantRangeCount = 1;
+	pipelineLayoutInfo.pPushConstantRanges	  = &pushConstantRange;
+
+	if (vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &pipelineLayout) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create shadow pipeline layout.");
+	}
+
+	VkShaderModule vertShaderModule = vkutil::createShaderModule(device, assets.load("src/shaders/shadow_vert.spv"));
+
+	VkPipelineShaderStageCreateInfo vertShaderStageInfo = {};
+	vertShaderStageInfo.sType  = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	vertShaderStageInfo.stage  = VK_SHADER_STAGE_VERTEX_BIT;
+	vertShaderStageInfo.module = vertShaderModule;
+	vertShaderStageInfo.pName  = "main";
+
+	// Positions only, out of the scene's vertices
+	auto bindingDescription = Vertex::getBindingDescription();
+	auto attributeDescriptions = Vertex::getAttributeDescriptions();
+
+	VkPipelineVertexInputStateCreateInfo vertexInputInfo = {};
+	vertexInputInfo.sType							= VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+	vertexInputInfo.vertexBindingDescriptionCount	= 1;
+	vertexInputInfo.pVertexBindingDescriptions		= &bindingDescription;
+	vertexInputInfo.vertexAttributeDescriptionCount = 1;
+	vertexInputInfo.pVertexAttributeDescriptions	= &attributeDescriptions[0];
+
+	VkPipelineInputAssemblyStateCreateInfo inputAssembly = {};
+	inputAssembly.sType	   = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+	inputAssembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+
+	// Every cascade sets its own tile
+	VkPipelineViewportStateCreateInfo viewportState = {};
+	viewportState.sType			= VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+	viewportState.viewportCount = 1;
+	viewportState.scissorCount	= 1;
+
+	VkDynamicState dynamicStates[] = { VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR };
+	VkPipelineDynamicStateCreateInfo dynamicState = {};
+	dynamicState.sType			   = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+	dynamicState.dynamicStateCount = 2;
+	dynamicState.pDynamicStates	   = dynamicStates;
+
+	// Both faces cast, so thin or open geometry does too. The bias grows with the slope against acne
+	VkPipelineRasterizationStateCreateInfo rasterizer = {};
+	rasterizer.sType				   = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+	rasterizer.polygonMode			   = VK_POLYGON_MODE_FILL;
+	rasterizer.lineWidth			   = 1.0f;
+	rasterizer.cullMode				   = VK_CULL_MODE_NONE;
+	rasterizer.frontFace			   = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+	rasterizer.depthBiasEnable		   = VK_TRUE;
+	rasterizer.depthBiasConstantFactor = 1.25f;
+	rasterizer.depthBiasSlopeFactor	   = 1.75f;
+
+	VkPipelineMultisampleStateCreateInfo multisampling = {};
+	multisampling.sType				   = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+	multisampling.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+
+	VkPipelineDepthStencilStateCreateInfo depthStencil = {};
+	depthStencil.sType			  = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+	depthStencil.depthTestEnable  = VK_TRUE;
+	depthStencil.depthWriteEnable = VK_TRUE;
+	depthStencil.depthCompareOp	  = VK_COMPARE_OP_LESS;
+
+	VkPipelineColorBlendStateCreateInfo colorBlending = {};
+	colorBlending.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+
+	VkGraphicsPipelineCreateInfo pipelineInfo = {};
+	pipelineInfo.sType				 = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+	pipelineInfo.stageCount			 = 1;
+	pipelineInfo.pStages			 = &vertShaderStageInfo;
+	pipelineInfo.pVertexInputState	 = &vertexInputInfo;
+	pipelineInfo.pInputAssemblyState = &inputAssembly;
+	pipelineInfo.pViewportState		 = &viewportState;
+	pipelineInfo.pRasterizationState = &rasterizer;
+	pipelineInfo.pMultisampleState	 = &multisampling;
+	pipelineInfo.pDepthStencilState	 = &depthStencil;
+	pipelineInfo.pColorBlendState	 = &colorBlending;
+	pipelineInfo.pDynamicState		 = &dynamicState;
+	pipelineInfo.layout				 = pipelineLayout;
+	// Compatible with the graph's pass on the atlas, a single depth attachment of the same format
+	pipelineInfo.renderPass			 = cacheRenderPass;
+	pipelineInfo.subpass			 = 0;
+
+	if (vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &pipeline) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create shadow pipeline.");
+	}
+	vkDestroyShaderModule(device, vertShaderModule, nullptr);
+}
+
+void ShadowMaps::setCasters(const std::vector<ObjectData>& objects, const std::vector<Caster>& objectCasters, const std::vector<MeshData>& meshes,
+	const std::vector<LodData>& lods, VkBuffer vertices, VkBuffer indices) {
+
+	casters = objectCasters;
+	lodData = lods;
+	vertexBuffer = vertices;
+	indexBuffer = indices;
+
+	lodVertexOffsets.assign(lods.size(), 0);
+	for (const auto& mesh : meshes) {
+		for (uint32_t lod = 0; lod < mesh.lodCount; lod++) {
+			lodVertexOffsets[mesh.firstLod + lod] = mesh.vertexOffset;
+		}
+	}
+
+	spheres.resize(objects.size());
+	firstLods.resize(objects.size());
+	lodCounts.resize(objects.size());
+	glm::vec3 boundsMin = glm::vec3(0.0f);
+	glm::vec3 boundsMax = glm::vec3(0.0f);
+	bool empty = true;
+	for (size_t i = 0; i < objects.size(); i++) {
+		const glm::vec4& sphere = objects[i].boundingSphere;
+		spheres[i]	 = sphere;
+		firstLods[i] = meshes[objects[i].meshIndex].firstLod;
+		lodCounts[i] = meshes[objects[i].meshIndex].lodCount;
+
+		glm::vec3 center = glm::vec3(sphere);
+		boundsMin = empty ? center - sphere.w : glm::min(boundsMin, center - sphere.w);
+		boundsMax = empty ? center + sphere.w : glm::max(boundsMax, center + sphere.w);
+		empty = false;
+	}
+	sceneSphere = glm::vec4((boundsMin + boundsMax) * 0.5f, glm::length(boundsMax - boundsMin) * 0.5f + 1.0f);
+
+	// An object lands in at most one list of every cascade, and in one more of a cached cascade being redrawn
+	uint32_t capacity = std::max(static_cast<uint32_t>(objects.size()) * (CASCADE_COUNT + CACHED_CASCADES), 1u);
+	if (capacity > idCapacity) {
+		idCapacity = capacity;
+		for (uint32_t frame = 0; frame < config.framesInFlight; frame++) {
+			vkutil::destroyBuffer(device, idBuffers[frame]);
+			idBuffers[frame] = vkutil::createBuffer(device, physicalDevice, sizeof(uint32_t) * idCapacity,
+				VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+
+			VkDescriptorBufferInfo bufferInfo = {};
+			bufferInfo.buffer = idBuffers[frame].buffer;
+			bufferInfo.offset = 0;
+			bufferInfo.range  = VK_WHOLE_SIZE;
+
+			VkWriteDescriptorSet write = {};
+			write.sType			  = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+			write.dstSet		  = descriptorSets[frame];
+			write.dstBinding	  = 2;
+			write.descriptorCount = 1;
+			write.descriptorType  = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+			write.pBufferInfo	  = &bufferInfo;
+			vkUpdateDescriptorSets(device, 1, &write, 0, nullptr);
+		}
+	}
+
+	buckets.assign(lods.size(), std::vector<uint32_t>());
+	cacheBuckets.assign(lods.size(), std::vector<uint32_t>());
+	invalidateCache();
+}
+
+void ShadowMaps::setLightDirection(const glm::vec3& direction) {
+	config.lightDirection = glm::normalize(direction);
+	invalidateCache();
+}
+
+void ShadowMaps::setCaching(bool enabled) {
+	config.caching = enabled;
+	invalidateCache();
+}
+
+void ShadowMaps::invalidateCache() {
+	staticVersion++;
+}
+
+void ShadowMaps::update(uint32_t frame, const CameraData& camera) {
+	draws.clear();
+	cacheDraws.clear();
+	stats.drawnInstances = 0;
+	stats.cachedInstances = 0;
+
+	// Cascades end at the shadow distance wherever the camera is, anything depending on its position would
+	// resize them, and their texels, as it moves
+	float nearPlane = camera.projParams.x;
+	float farPlane = config.distance > 0.0f ? std::min(config.distance, camera.projParams.y) : camera.projParams.y;
+	farPlane = std::max(farPlane, nearPlane * 2.0f);
+
+	float splits[CASCADE_COUNT + 1];
+	splits[0] = nearPlane;
+	for (uint32_t i = 1; i <= CASCADE_COUNT; i++) {
+		float p = i / static_cast<float>(CASCADE_COUNT);
+		float logarithmic = nearPlane * std::pow(farPlane / nearPlane, p);
+		float even = nearPlane + (farPlane - nearPlane) * p;
+		splits[i] = config.splitLambda * logarithmic + (1.0f - config.splitLambda) * even;
+	}
+
+	// Light space only rotates, so moving a cascade's window in whole texels moves it in whole texels on the ground
+	glm::vec3 up = std::abs(config.lightDirection.y) > 0.99f ? glm::vec3(0.0f, 0.0f, 1.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+	glm::mat4 lightView = glm::lookAt(glm::vec3(0.0f), -config.lightDirection, up);
+	glm::mat4 invView = glm::inverse(camera.view);
+	// The projection's y is flipped, the tangent is not
+	float tanX = 1.0f / camera.proj[0][0];
+	float tanY = 1.0f / std::abs(camera.proj[1][1]);
+
+	// Every cascade covers the scene's whole depth so casters outside the view still cast into it
+	float sceneDepth = (lightView * glm::vec4(glm::vec3(sceneSphere), 1.0f)).z;
+	float depthNear = -(sceneDepth + sceneSphere.w);
+	float depthFar = -(sceneDepth - sceneSphere.w);
+
+	ShadowData data = {};
+	uint32_t* ids = static_cast<uint32_t*>(idBuffers[frame].mapped);
+	uint32_t idCount = 0;
+
+	for (uint32_t cascade = 0; cascade < CASCADE_COUNT; cascade++) {
+		// Bounding sphere of the slice, in view space so the radius does not depend on where the camera looks.
+		// Its center lies on the view axis, where it is closest to the farthest of the near and far corners
+		float sliceNear = splits[cascade];
+		float sliceFar = splits[cascade + 1];
+		float diagonal = tanX * tanX + tanY * tanY;
+		float centerDepth = std::min(0.5f * (sliceNear + sliceFar) * (1.0f + diagonal), sliceFar);
+		float nearDistance = std::sqrt(sliceNear * sliceNear * diagonal + (centerDepth - sliceNear) * (centerDepth - sliceNear));
+		float farDistance = std::sqrt(sliceFar * sliceFar * diagonal + (sliceFar - centerDepth) * (sliceFar - centerDepth));
+		float radius = std::ceil(std::max(nearDistance, farDistance) * 16.0f) / 16.0f;
+		glm::vec3 center = glm::vec3(invView * glm::vec4(0.0f, 0.0f, -centerDepth, 1.0f));
+
+		// Cached cascades only move in steps of a quarter of their radius, with room to spare around the slice
+		bool cached = config.caching && cascade >= FIRST_CACHED_CASCADE;
+		float halfSize = cached ? radius * 1.25f : radius;
+		float texel = 2.0f * halfSize / config.cascadeSize;
+		float step = cached ? std::max(std::floor(radius * 0.25f / texel), 1.0f) * texel : texel;
+
+		glm::vec3 window = glm::vec3(lightView * glm::vec4(center, 1.0f));
+		window.x = std::floor(window.x / step) * step;
+		window.y = std::floor(window.y / step) * step;
+		window.z = halfSize;
+
+		glm::mat4 proj = glm::ortho(window.x - halfSize, window.x + halfSize, window.y - halfSize, window.y + halfSize, depthNear, depthFar);
+		data.viewProj[cascade] = proj * lightView;
+		data.texelSizes[cascade] = texel;
+
+		bool redraw = false;
+		if (cached) {
+			CacheKey& key = cacheKeys[cascade - FIRST_CACHED_CASCADE];
+			redraw = key.version != staticVersion || key.window != window;
+			key.window = window;
+			key.version = staticVersion;
+			if (redraw) {
+				stats.cacheRedraws++;
+			}
+		}
+		if (cascade >= FIRST_CACHED_CASCADE) {
+			staleCascades[cascade - FIRST_CACHED_CASCADE] = redraw;
+		}
+
+		// Casters whose sphere reaches into the window, the coarser the cascade the coarser their level of detail
+		for (size_t i = 0; i < casters.size(); i++) {
+			if (casters[i] == Caster::None) {
+				continue;
+			}
+			glm::vec3 position = glm::vec3(lightView * glm::vec4(glm::vec3(spheres[i]), 1.0f));
+			float reach = halfSize + spheres[i].w;
+			if (std::abs(position.x - window.x) > reach || std::abs(position.y - window.y) > reach) {
+				continue;
+			}
+
+			uint32_t lod = firstLods[i] + std::min(cascade, lodCounts[i] - 1);
+			if (cached && casters[i] == Caster::Static) {
+				if (redraw) {
+					cacheBuckets[lod].push_back(static_cast<uint32_t>(i));
+				}
+				stats.cachedInstances++;
+			} else {
+				buckets[lod].push_back(static_cast<uint32_t>(i));
+				stats.drawnInstances++;
+			}
+		}
+		flushBuckets(cascade, buckets, draws, ids, idCount);
+		flushBuckets(cascade, cacheBuckets, cacheDraws, ids, idCount);
+	}
+
+	data.lightDirection = glm::vec4(config.lightDirection, 0.0f);
+	float atlasSize = 2.0f * config.cascadeSize;
+	data.atlasParams = glm::vec4(1.0f / atlasSize, 1.5f / config.cascadeSize, 0.0f, 0.0f);
+	memcpy(shadowBuffers[frame].mapped, &data, sizeof(data));
+}
+
+void ShadowMaps::flushBuckets(uint32_t cascade, std::vector<std::vector<uint32_t>>& lists, std::vector<Draw>& result, uint32_t* ids, uint32_t& idCount) {
+	for (uint32_t lod = 0; lod < lists.size(); lod++) {
+		std::vector<uint32_t>& list = lists[lod];
+		if (list.empty()) {
+			continue;
+		}
+
+		Draw draw = {};
+		draw.cascade = cascade;
+		draw.lod	 = lod;
+		draw.idBase	 = idCount;
+		draw.count	 = static_cast<uint32_t>(list.size());
+		memcpy(ids + idCount, list.data(), sizeof(uint32_t) * list.size());
+		idCount += draw.count;
+		result.push_back(draw);
+		list.clear();
+	}
+}
+
+void ShadowMaps::bindPipeline(VkCommandBuffer commandBuffer, uint32_t frame, VkDescriptorSet frameSet) {
+	VkDescriptorSet sets[] = { frameSet, descriptorSets[frame] };
+	vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+	vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 2, sets, 0, nullptr);
+
+	VkDeviceSize offset = 0;
+	vkCmdBindVertexBuffers(commandBuffer, 0, 1, &vertexBuffer, &offset);
+	vkCmdBindIndexBuffer(commandBuffer, indexBuffer, 0, VK_INDEX_TYPE_UINT32);
+}
+
+void ShadowMaps::recordDraws(VkCommandBuffer commandBuffer, const std::vector<Draw>& list, uint32_t cascade) {
+	for (const Draw& draw : list) {
+		if (draw.cascade != cascade) {
+			continue;
+		}
+		ShadowPushConstants constants = { draw.cascade, draw.idBase };
+		vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(constants), &constants);
+		const LodData& lod = lodData[draw.lod];
+		vkCmdDrawIndexed(commandBuffer, lod.indexCount, draw.count, lod.firstIndex, lodVertexOffsets[draw.lod], 0);
+	}
+}
+
+void ShadowMaps::setTile(VkCommandBuffer commandBuffer, VkOffset2D offset) {
+	VkViewport viewport = {};
+	viewport.x		  = static_cast<float>(offset.x);
+	viewport.y		  = static_cast<float>(offset.y);
+	viewport.width	  = static_cast<float>(config.cascadeSize);
+	viewport.height	  = static_cast<float>(config.cascadeSize);
+	viewport.minDepth = 0.0f;
+	viewport.maxDepth = 1.0f;
+
+	VkRect2D scissor = {};
+	scissor.offset = offset;
+	scissor.extent = { config.cascadeSize, config.cascadeSize };
+
+	vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+	vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+}
+
+void ShadowMaps::recordCache(VkCommandBuffer commandBuffer, uint32_t frame, VkDescriptorSet frameSet) {
+	if (!config.caching) {
+		return;
+	}
+
+	bool stale = false;
+	for (uint32_t i = 0; i < CACHED_CASCADES; i++) {
+		stale = stale || staleCascades[i];
+	}
+
+	// The cache waits in the transfer source layout between redraws
+	if (stale) {
+		vkutil::imageBarrier(commandBuffer, cache.image,
+			cacheInitialized ? VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL : VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
+			VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+			VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+			VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT, VK_IMAGE_ASPECT_DEPTH_BIT);
+
+		VkRenderPassBeginInfo beginInfo = {};
+		beginInfo.sType				= VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+		beginInfo.renderPass		= cacheRenderPass;
+		beginInfo.framebuffer		= cacheFramebuffer;
+		beginInfo.renderArea.offset = { 0, 0 };
+		beginInfo.renderArea.extent = cache.extent;
+		vkCmdBeginRenderPass(commandBuffer, &beginInfo, VK_SUBPASS_CONTENTS_INLINE);
+
+		bindPipeline(commandBuffer, frame, frameSet);
+		for (uint32_t cascade = FIRST_CACHED_CASCADE; cascade < CASCADE_COUNT; cascade++) {
+			if (!staleCascades[cascade - FIRST_CACHED_CASCADE]) {
+				continue;
+			}
+
+			VkOffset2D offset = cacheTile(cascade, config.cascadeSize);
+			VkClearAttachment clear = {};
+			clear.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
+			clear.clearValue.depthStencil = { 1.0f, 0 };
+			VkClearRect rect = {};
+			rect.rect		= { offset, { config.cascadeSize, config.cascadeSize } };
+			rect.layerCount = 1;
+			vkCmdClearAttachments(commandBuffer, 1, &clear, 1, &rect);
+
+			setTile(commandBuffer, offset);
+			recordDraws(commandBuffer, cacheDraws, cascade);
+		}
+		vkCmdEndRenderPass(commandBuffer);
+
+		vkutil::imageBarrier(commandBuffer, cache.image,
+			VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+			VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT, VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+			VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_READ_BIT, VK_IMAGE_ASPECT_DEPTH_BIT);
+		cacheInitialized = true;
+	}
+
+	VkImageCopy regions[CACHED_CASCADES] = {};
+	for (uint32_t i = 0; i < CACHED_CASCADES; i++) {
+		uint32_t cascade = FIRST_CACHED_CASCADE + i;
+		VkOffset2D src = cacheTile(cascade, config.cascadeSize);
+		VkOffset2D dst = atlasTile(cascade, config.cascadeSize);
+		regions[i].srcSubresource = { VK_IMAGE_ASPECT_DEPTH_BIT, 0, 0, 1 };
+		regions[i].srcOffset	  = { src.x, src.y, 0 };
+		regions[i].dstSubresource = { VK_IMAGE_ASPECT_DEPTH_BIT, 0, 0, 1 };
+		regions[i].dstOffset	  = { dst.x, dst.y, 0 };
+		regions[i].extent		  = { config.cascadeSize, config.cascadeSize, 1 };
+	}
+	vkCmdCopyImage(commandBuffer, cache.image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+		atlas.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, CACHED_CASCADES, regions);
+}
+
+void ShadowMaps::recordCascades(VkCommandBuffer commandBuffer, uint32_t frame, VkDescriptorSet frameSet) {
+	bindPipeline(commandBuffer, frame, frameSet);
+
+	for (uint32_t cascade = 0; cascade < CASCADE_COUNT; cascade++) {
+		VkOffset2D offset = atlasTile(cascade, config.cascadeSize);
+		if (config.caching && cascade < FIRST_CACHED_CASCADE) {
+			VkClearAttachment clear = {};
+			clear.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
+			clear.clearValue.depthStencil = { 1.0f, 0 };
+			VkClearRect rect = {};
+			rect.rect		= { offset, { config.cascadeSize, config.cascadeSize } };
+			rect.layerCount = 1;
+			vkCmdClearAttachments(commandBuffer, 1, &clear, 1, &rect);
+		}
+
+		setTile(commandBuffer, offset);
+		recordDraws(commandBuffer, draws, cascade);
+	}
+}
+
+VkDeviceSize ShadowMaps::getAtlasBytes() const {
+	return static_cast<VkDeviceSize>(atlas.extent.width) * atlas.extent.height * 2;
+}
+
+VkDeviceSize ShadowMaps::getCacheBytes() const {
+	return static_cast<VkDeviceSize>(cache.extent.width) * cache.extent.height * 2;
+}
+
+void ShadowMaps::destroy() {
+	for (auto* buffers : { &shadowBuffers, &idBuffers }) {
+		for (auto& buffer : *buffers) {
+			vkutil::destroyBuffer(device, buffer);
+		}
+		buffers->clear();
+	}
+	vkutil::destroyImage(device, atlas);
+	vkutil::destroyImage(device, cache);
+	vkDestroySampler(device, sampler, nullptr);
+	vkDestroyFramebuffer(device, cacheFramebuffer, nullptr);
+	vkDestroyRenderPass(device, cacheRenderPass, nullptr);
+	vkDestroyPipeline(device, pipeline, nullptr);
+	vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
+	vkDestroyDescriptorPool(device, descriptorPool, nullptr);
+	vkDestroyDescriptorSetLayout(device, setLayout, nullptr);
+	sampler = VK_NULL_HANDLE;
+	cacheFramebuffer = VK_NULL_HANDLE;
+	cacheRenderPass = VK_NULL_HANDLE;
+	pipeline = VK_NULL_HANDLE;
+	pipelineLayout = VK_NULL_HANDLE;
+	descriptorPool = VK_NULL_HANDLE;
+	setLayout = VK_NULL_HANDLE;
+}
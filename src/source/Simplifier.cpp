@@ -0,0 +1,285 @@
+#include "Simplifier.h"
+#include "Mesh.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <unordered_map>
+
+namespace simplifier {
+
+	namespace {
+
+		// Symmetric 4x4 matrix of the sum of squared distances to a set of planes, weighted by area
+		struct Quadric {
+			double a00 = 0.0, a01 = 0.0, a02 = 0.0, a11 = 0.0, a12 = 0.0, a22 = 0.0;
+			double b0 = 0.0, b1 = 0.0, b2 = 0.0;
+			double c = 0.0;
+			double weight = 0.0;
+
+			void addPlane(const glm::dvec3& normal, double distance, double planeWeight) {
+				a00 += planeWeight * normal.x * normal.x;
+				a01 += planeWeight * normal.x * normal.y;
+				a02 += planeWeight * normal.x * normal.z;
+				a11 += planeWeight * normal.y * normal.y;
+				a12 += planeWeight * normal.y * normal.z;
+				a22 += planeWeight * normal.z * normal.z;
+				b0 += planeWeight * normal.x * distance;
+				b1 += planeWeight * normal.y * distance;
+				b2 += planeWeight * normal.z * distance;
+				c += planeWeight * distance * distance;
+				weight += planeWeight;
+			}
+
+			void add(const Quadric& other) {
+				a00 += other.a00; a01 += other.a01; a02 += other.a02;
+				a11 += other.a11; a12 += other.a12; a22 += other.a22;
+				b0 += other.b0; b1 += other.b1; b2 += other.b2;
+				c += other.c;
+				weight += other.weight;
+			}
+
+			// Weighted mean squared distance of a point to the planes
+			double error(const glm::vec3& p) const {
+				double x = p.x, y = p.y, z = p.z;
+				double result =
+					a00 * x * x + a11 * y * y + a22 * z * z +
+					2.0 * (a01 * x * y + a02 * x * z + a12 * y * z) +
+					2.0 * (b0 * x + b1 * y + b2 * z) + c;
+				return weight > 0.0 ? std::max(result, 0.0) / weight : 0.0;
+			}
+		};
+
+		struct Collapse {
+			uint32_t from;
+			uint32_t to;
+			double error;
+		};
+
+		uint64_t edgeKey(uint32_t a, uint32_t b) {
+			return (static_cast<uint64_t>(a) << 32) | b;
+		}
+
+		struct PositionHash {
+			size_t operator()(const glm::vec3& p) const {
+				uint32_t bits[3];
+				std::memcpy(bits, &p, sizeof(bits));
+				return (bits[0] * 73856093u) ^ (bits[1] * 19349663u) ^ (bits[2] * 83492791u);
+			}
+		};
+
+	}
+
+	std::vector<uint32_t> simplify(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices,
+		size_t targetIndexCount, float targetError, float* resultError) {
+
+		uint32_t vertexCount = static_cast<uint32_t>(vertices.size());
+		std::vector<uint32_t> current = indices;
+		double maxError = 0.0;
+
+		// Vertices sharing a position with another vertex sit on an attribute seam, and vertices on
+		// an edge with only one triangle sit on a border. Neither may be collapsed away
+		std::vector<bool> locked(vertexCount, false);
+		std::unordered_map<glm::vec3, uint32_t, PositionHash> firstAtPosition;
+		for (uint32_t i = 0; i < vertexCount; i++) {
+			auto inserted = firstAtPosition.insert({ vertices[i].pos, i });
+			if (!inserted.second) {
+				locked[i] = true;
+				locked[inserted.first->second] = true;
+			}
+		}
+
+		std::unordered_map<uint64_t, uint32_t> edges;
+		for (size_t i = 0; i < current.size(); i += 3) {
+			for (uint32_t e = 0; e < 3; e++) {
+				edges[edgeKey(current[i + e], current[i + (e + 1) % 3])]++;
+			}
+		}
+		for (const auto& edge : edges) {
+			uint32_t a = static_cast<uint32_t>(edge.first >> 32);
+			uint32_t b = static_cast<uint32_t>(edge.first & 0xFFFFFFFFu);
+			if (edges.find(edgeKey(b, a)) == edges.end()) {
+				locked[a] = true;
+				locked[b] = true;
+			}
+		}
+
+		std::vector<Quadric> quadrics(vertexCount);
+		for (size_t i = 0; i < current.size(); i += 3) {
+			glm::dvec3 p0 = vertices[current[i + 0]].pos;
+			glm::dvec3 p1 = vertices[current[i + 1]].pos;
+			glm::dvec3 p2 = vertices[current[i + 2]].pos;
+
+			glm::dvec3 normal = glm::cross(p1 - p0, p2 - p0);
+			double area = glm::length(normal);
+			if (area <= 0.0) {
+				continue;
+			}
+			normal /= area;
+
+			for (uint32_t corner = 0; corner < 3; corner++) {
+				quadrics[current[i + corner]].addPlane(normal, -glm::dot(normal, p0), area);
+			}
+		}
+
+		double errorLimit = static_cast<double>(targetError) * targetError;
+
+		std::vector<uint32_t> remap(vertexCount);
+		std::vector<bool> touched(vertexCount);
+		std::vector<uint32_t> triangleOffsets(vertexCount + 1);
+		std::vector<uint32_t> vertexTriangles;
+		std::vector<Collapse> collapses;
+
+		// Each pass collapses the cheapest independent edges, then rebuilds the index list
+		while (current.size() > targetIndexCount) {
+			uint32_t triangleCount = static_cast<uint32_t>(current.size() / 3);
+
+			std::fill(triangleOffsets.begin(), triangleOffsets.end(), 0);
+			for (uint32_t index : current) {
+				triangleOffsets[index + 1]++;
+			}
+			for (uint32_t i = 0; i < vertexCount; i++) {
+				triangleOffsets[i + 1] += triangleOffsets[i];
+			}
+			vertexTriangles.resize(current.size());
+			std::vector<uint32_t> cursor(triangleOffsets.begin(), triangleOffsets.end() - 1);
+			for (uint32_t i = 0; i < current.size(); i++) {
+				vertexTriangles[cursor[current[i]]++] = i / 3;
+			}
+
+			collapses.clear();
+			for (uint32_t i = 0; i < current.size(); i += 3) {
+				for (uint32_t e = 0; e < 3; e++) {
+					uint32_t from = current[i + e];
+					uint32_t to = current[i + (e + 1) % 3];
+
+					for (int direction = 0; direction < 2; direction++) {
+						if (!locked[from]) {
+							Quadric merged = quadrics[from];
+							merged.add(quadrics[to]);
+							collapses.push_back({ from, to, merged.error(vertices[to].pos) });
+						}
+						std::swap(from, to);
+					}
+				}
+			}
+
+			std::sort(collapses.begin(), collapses.end(), [](const Collapse& a, const Collapse& b) {
+				return a.error < b.error;
+			});
+
+			for (uint32_t i = 0; i < vertexCount; i++) {
+				remap[i] = i;
+			}
+			std::fill(touched.begin(), touched.end(), false);
+
+			size_t trianglesLeft = triangleCount;
+			size_t targetTriangles = targetIndexCount / 3;
+			bool collapsed = false;
+
+			for (const auto& collapse : collapses) {
+				if (trianglesLeft <= targetTriangles || collapse.error > errorLimit) {
+					break;
+				}
+				if (touched[collapse.from] || touched[collapse.to]) {
+					continue;
+				}
+
+				// Moving the vertex onto its neighbour must not flip any of the triangles around it
+				bool flips = false;
+				uint32_t removed = 0;
+				for (uint32_t t = triangleOffsets[collapse.from]; t < triangleOffsets[collapse.from + 1] && !flips; t++) {
+					const uint32_t* triangle = &current[vertexTriangles[t] * 3];
+					if (triangle[0] == collapse.to || triangle[1] == collapse.to || triangle[2] == collapse.to) {
+						removed++;
+						continue;
+					}
+
+					glm::vec3 before[3];
+					glm::vec3 after[3];
+					for (uint32_t corner = 0; corner < 3; corner++) {
+						before[corner] = vertices[triangle[corner]].pos;
+						after[corner] = triangle[corner] == collapse.from ? vertices[collapse.to].pos : before[corner];
+					}
+
+					glm::vec3 normalBefore = glm::cross(before[1] - before[0], before[2] - before[0]);
+					glm::vec3 normalAfter = glm::cross(after[1] - after[0], after[2] - after[0]);
+					flips = glm::dot(normalBefore, normalAfter) <= 0.0f;
+				}
+				if (flips) {
+					continue;
+				}
+
+				// Lock the whole neighbourhood for the rest of this pass so flip checks stay valid
+				for (uint32_t t = triangleOffsets[collapse.from]; t < triangleOffsets[collapse.from + 1]; t++) {
+					const uint32_t* triangle = &current[vertexTriangles[t] * 3];
+					touched[triangle[0]] = true;
+					touched[triangle[1]] = true;
+					touched[triangle[2]] = true;
+				}
+
+				remap[collapse.from] = collapse.to;
+				quadrics[collapse.to].add(quadrics[collapse.from]);
+				maxError = std::max(maxError, collapse.error);
+				trianglesLeft -= removed;
+				collapsed = true;
+			}
+
+			if (!collapsed) {
+				break;
+			}
+
+			// Drop the triangles that collapsed to a line
+			size_t write = 0;
+			for (size_t i = 0; i < current.size(); i += 3) {
+				uint32_t a = remap[current[i + 0]];
+				uint32_t b = remap[current[i + 1]];
+				uint32_t c = remap[current[i + 2]];
+				if (a != b && b != c && a != c) {
+					current[write++] = a;
+					current[write++] = b;
+					current[write++] = c;
+				}
+			}
+			current.resize(write);
+		}
+
+		if (resultError) {
+			*resultError = static_cast<float>(std::sqrt(maxError));
+		}
+		return current;
+	}
+
+	void generateLods(Mesh& mesh, uint32_t maxLods) {
+		mesh.lods.clear();
+
+		MeshLod full;
+		full.firstIndex = 0;
+		full.indexCount = static_cast<uint32_t>(mesh.indices.size());
+		full.error = 0.0f;
+		mesh.lods.push_back(full);
+
+		// Every level is simplified from the previous one, so their errors add up
+		std::vector<uint32_t> previous = mesh.indices;
+		while (mesh.lods.size() < maxLods) {
+			size_t target = (previous.size() / 6) * 3;
+			float error = 0.0f;
+			std::vector<uint32_t> next = simplify(mesh.vertices, previous, target, std::numeric_limits<float>::max(), &error);
+
+			if (next.empty() || next.size() * 10 > previous.size() * 9) {
+				break;
+			}
+
+			MeshLod lod;
+			lod.firstIndex = static_cast<uint32_t>(mesh.indices.size());
+			lod.indexCount = static_cast<uint32_t>(next.size());
+			lod.error = mesh.lods.back().error + error;
+			mesh.lods.push_back(lod);
+
+			mesh.indices.insert(mesh.indices.end(), next.begin(), next.end());
+			previous.swap(next);
+		}
+	}
+
+}
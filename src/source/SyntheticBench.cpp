@@ -0,0 +1,719 @@
+#include "SyntheticBench.h"
+
+#include "Configuration.h"
+#include "Noise.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+
+namespace {
+
+	const VkFormat TARGET_FORMAT = VK_FORMAT_R8G8B8A8_UNORM;
+	const char* CSV_HEADER = "scene,parameter,width,height,frames,warmup,setup_ms,mean_ms,p50_ms,p95_ms,max_ms,gpu_ms";
+
+	struct DrawParams {
+		float offsetScale[4];
+		float color[4];
+	};
+
+	double percentile(const std::vector<double>& sorted, double fraction) {
+		size_t index = static_cast<size_t>(fraction * (sorted.size() - 1) + 0.5);
+		return sorted[std::min(index, sorted.size() - 1)];
+	}
+
+}
+
+SyntheticBench::SyntheticBench(const Config& benchConfig) :
+	config(benchConfig),
+	threadPool(1),
+	assets(VK_ROOT_DIR, threadPool) {
+
+	createDevice();
+
+	vertShaderModule = vkutil::createShaderModule(device, assets.load("src/shaders/bench_vert.spv"));
+	fragShaderModule = vkutil::createShaderModule(device, assets.load("src/shaders/bench_frag.spv"));
+
+	VkPushConstantRange pushRange = {};
+	pushRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
+	pushRange.size		 = sizeof(DrawParams);
+
+	VkPipelineLayoutCreateInfo layoutInfo = {};
+	layoutInfo.sType				  = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+	layoutInfo.pushConstantRangeCount = 1;
+	layoutInfo.pPushConstantRanges	  = &pushRange;
+
+	if (vkCreatePipelineLayout(device, &layoutInfo, nullptr, &pipelineLayout) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create benchmark pipeline layout.");
+	}
+
+	const float triangle[6] = { 0.0f, -1.0f, 1.0f, 1.0f, -1.0f, 1.0f };
+	triangleBuffer = vkutil::createBuffer(device, physicalDevice, sizeof(triangle), VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+	vkutil::uploadBuffer(device, physicalDevice, commandPool, queue, triangleBuffer, triangle, sizeof(triangle));
+
+	createTarget(config.extent);
+}
+
+SyntheticBench::~SyntheticBench() {
+	if (device != VK_NULL_HANDLE) {
+		vkDeviceWaitIdle(device);
+		destroyTarget();
+		vkutil::destroyBuffer(device, triangleBuffer);
+		vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
+		vkDestroyShaderModule(device, vertShaderModule, nullptr);
+		vkDestroyShaderModule(device, fragShaderModule, nullptr);
+		vkDestroyQueryPool(device, queryPool, nullptr);
+		vkDestroyFence(device, fence, nullptr);
+		vkDestroyCommandPool(device, commandPool, nullptr);
+		vkDestroyDevice(device, nullptr);
+	}
+	if (instance != VK_NULL_HANDLE) {
+		vkDestroyInstance(instance, nullptr);
+	}
+}
+
+void SyntheticBench::createDevice() {
+	// No layers and no extensions, validation would be measured along with the driver
+	VkApplicationInfo appInfo = {};
+	appInfo.sType			   = VK_STRUCTURE_TYPE_APPLICATION_INFO;
+	appInfo.pApplicationName   = "vulkanBench";
+	appInfo.applicationVersion = VK_MAKE_VERSION(1, 0, 0);
+	appInfo.pEngineName		   = "No Engine";
+	appInfo.engineVersion	   = VK_MAKE_VERSION(1, 0, 0);
+	appInfo.apiVersion		   = VK_API_VERSION_1_0;
+
+	VkInstanceCreateInfo instanceInfo = {};
+	instanceInfo.sType			  = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
+	instanceInfo.pApplicationInfo = &appInfo;
+
+	if (vkCreateInstance(&instanceInfo, nullptr, &instance) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create vulkan instance.");
+	}
+
+	uint32_t deviceCount = 0;
+	vkEnumeratePhysicalDevices(instance, &deviceCount, nullptr);
+	std::vector<VkPhysicalDevice> devices(deviceCount);
+	vkEnumeratePhysicalDevices(instance, &deviceCount, devices.data());
+
+	for (VkPhysicalDevice candidate : devices) {
+		VkPhysicalDeviceProperties properties;
+		vkGetPhysicalDeviceProperties(candidate, &properties);
+		if (!config.deviceName.empty() && std::string(properties.deviceName).find(config.deviceName) == std::string::npos) {
+			continue;
+		}
+
+		uint32_t familyCount = 0;
+		vkGetPhysicalDeviceQueueFamilyProperties(candidate, &familyCount, nullptr);
+		std::vector<VkQueueFamilyProperties> families(familyCount);
+		vkGetPhysicalDeviceQueueFamilyProperties(candidate, &familyCount, families.data());
+		for (uint32_t i = 0; i < familyCount; i++) {
+			if (families[i].queueFlags & VK_QUEUE_GRAPHICS_BIT) {
+				physicalDevice = candidate;
+				queueFamily = i;
+				deviceName = properties.deviceName;
+				// Timestamps need valid bits on the queue and a period to convert them by
+				if (families[i].timestampValidBits > 0 && properties.limits.timestampComputeAndGraphics) {
+					timestampPeriod = properties.limits.timestampPeriod;
+				} else {
+					timestampPeriod = 0.0f;
+				}
+				break;
+			}
+		}
+		if (physicalDevice != VK_NULL_HANDLE) {
+			break;
+		}
+	}
+	if (physicalDevice == VK_NULL_HANDLE) {
+		throw std::runtime_error(config.deviceName.empty() ? "Failed to find a device with a graphics queue." :
+			"Failed to find a device with a graphics queue named like " + config.deviceName);
+	}
+
+	float priority = 1.0f;
+	VkDeviceQueueCreateInfo queueInfo = {};
+	queueInfo.sType			   = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
+	queueInfo.queueFamilyIndex = queueFamily;
+	queueInfo.queueCount	   = 1;
+	queueInfo.pQueuePriorities = &priority;
+
+	VkDeviceCreateInfo deviceInfo = {};
+	deviceInfo.sType				= VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+	deviceInfo.queueCreateInfoCount = 1;
+	deviceInfo.pQueueCreateInfos	= &queueInfo;
+
+	if (vkCreateDevice(physicalDevice, &deviceInfo, nullptr, &device) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create logical device.");
+	}
+	vkGetDeviceQueue(device, queueFamily, 0, &queue);
+
+	VkCommandPoolCreateInfo poolInfo = {};
+	poolInfo.sType			  = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+	poolInfo.flags			  = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+	poolInfo.queueFamilyIndex = queueFamily;
+
+	if (vkCreateCommandPool(device, &poolInfo, nullptr, &commandPool) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create command pool.");
+	}
+
+	VkCommandBufferAllocateInfo allocInfo = {};
+	allocInfo.sType				 = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+	allocInfo.commandPool		 = commandPool;
+	allocInfo.level				 = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+	allocInfo.commandBufferCount = 1;
+
+	if (vkAllocateCommandBuffers(device, &allocInfo, &commandBuffer) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to allocate command buffers.");
+	}
+
+	VkFenceCreateInfo fenceInfo = {};
+	fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+
+	if (vkCreateFence(device, &fenceInfo, nullptr, &fence) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create fence.");
+	}
+
+	if (timestampPeriod > 0.0f) {
+		VkQueryPoolCreateInfo queryInfo = {};
+		queryInfo.sType		 = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+		queryInfo.queryType	 = VK_QUERY_TYPE_TIMESTAMP;
+		queryInfo.queryCount = 2;
+
+		if (vkCreateQueryPool(device, &queryInfo, nullptr, &queryPool) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to create query pool.");
+		}
+	}
+}
+
+void SyntheticBench::createTarget(VkExtent2D extent) {
+	targetExtent = extent;
+	target = vkutil::createImage(device, physicalDevice, extent, 1, TARGET_FORMAT,
+		VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT, VK_IMAGE_ASPECT_COLOR_BIT);
+
+	// Cleared and kept every frame, as a swap chain image would be
+	VkAttachmentDescription colorAttachment = {};
+	colorAttachment.format		   = TARGET_FORMAT;
+	colorAttachment.samples		   = VK_SAMPLE_COUNT_1_BIT;
+	colorAttachment.loadOp		   = VK_ATTACHMENT_LOAD_OP_CLEAR;
+	colorAttachment.storeOp		   = VK_ATTACHMENT_STORE_OP_STORE;
+	colorAttachment.stencilLoadOp  = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+	colorAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+	colorAttachment.initialLayout  = VK_IMAGE_LAYOUT_UNDEFINED;
+	colorAttachment.finalLayout	   = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+
+	VkAttachmentReference colorReference = { 0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL };
+
+	VkSubpassDescription subpass = {};
+	subpass.pipelineBindPoint	 = VK_PIPELINE_BIND_POINT_GRAPHICS;
+	subpass.colorAttachmentCount = 1;
+	subpass.pColorAttachments	 = &colorReference;
+
+	VkRenderPassCreateInfo renderPassInfo = {};
+	renderPassInfo.sType		   = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+	renderPassInfo.attachmentCount = 1;
+	renderPassInfo.pAttachments	   = &colorAttachment;
+	renderPassInfo.subpassCount	   = 1;
+	renderPassInfo.pSubpasses	   = &subpass;
+
+	if (vkCreateRenderPass(device, &renderPassInfo, nullptr, &renderPass) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create benchmark render pass.");
+	}
+
+	VkFramebufferCreateInfo framebufferInfo = {};
+	framebufferInfo.sType			= VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+	framebufferInfo.renderPass		= renderPass;
+	framebufferInfo.attachmentCount = 1;
+	framebufferInfo.pAttachments	= &target.view;
+	framebufferInfo.width			= extent.width;
+	framebufferInfo.height			= extent.height;
+	framebufferInfo.layers			= 1;
+
+	if (vkCreateFramebuffer(device, &framebufferInfo, nullptr, &framebuffer) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create benchmark framebuffer.");
+	}
+
+	pipeline = createPipeline(extent, 0.0f);
+}
+
+void SyntheticBench::destroyTarget() {
+	vkDestroyPipeline(device, pipeline, nullptr);
+	vkDestroyFramebuffer(device, framebuffer, nullptr);
+	vkDestroyRenderPass(device, renderPass, nullptr);
+	vkutil::destroyImage(device, target);
+	pipeline = VK_NULL_HANDLE;
+	framebuffer = VK_NULL_HANDLE;
+	renderPass = VK_NULL_HANDLE;
+}
+
+VkPipeline SyntheticBench::createPipeline(VkExtent2D extent, float tint) const {
+	VkSpecializationMapEntry tintEntry = { 0, 0, sizeof(float) };
+	VkSpecializationInfo specialization = {};
+	specialization.mapEntryCount = 1;
+	specialization.pMapEntries	 = &tintEntry;
+	specialization.dataSize		 = sizeof(float);
+	specialization.pData		 = &tint;
+
+	VkPipelineShaderStageCreateInfo shaderStages[2] = {};
+	shaderStages[0].sType				= VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	shaderStages[0].stage				= VK_SHADER_STAGE_VERTEX_BIT;
+	shaderStages[0].module				= vertShaderModule;
+	shaderStages[0].pName				= "main";
+	shaderStages[1].sType				= VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	shaderStages[1].stage				= VK_SHADER_STAGE_FRAGMENT_BIT;
+	shaderStages[1].module				= fragShaderModule;
+	shaderStages[1].pName				= "main";
+	shaderStages[1].pSpecializationInfo = &specialization;
+
+	VkVertexInputBindingDescription binding = { 0, sizeof(float) * 2, VK_VERTEX_INPUT_RATE_VERTEX };
+	VkVertexInputAttributeDescription attribute = { 0, 0, VK_FORMAT_R32G32_SFLOAT, 0 };
+
+	VkPipelineVertexInputStateCreateInfo vertexInputInfo = {};
+	vertexInputInfo.sType							= VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+	vertexInputInfo.vertexBindingDescriptionCount	= 1;
+	vertexInputInfo.pVertexBindingDescriptions		= &binding;
+	vertexInputInfo.vertexAttributeDescriptionCount = 1;
+	vertexInputInfo.pVertexAttributeDescriptions	= &attribute;
+
+	VkPipelineInputAssemblyStateCreateInfo inputAssembly = {};
+	inputAssembly.sType	   = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+	inputAssembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+
+	// Baked in like the application's, so a resize recreates the pipeline as it does there
+	VkViewport viewport = {};
+	viewport.width	  = static_cast<float>(extent.width);
+	viewport.height	  = static_cast<float>(extent.height);
+	viewport.maxDepth = 1.0f;
+
+	VkRect2D scissor = {};
+	scissor.extent = extent;
+
+	VkPipelineViewportStateCreateInfo viewportState = {};
+	viewportState.sType			= VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+	viewportState.viewportCount = 1;
+	viewportState.pViewports	= &viewport;
+	viewportState.scissorCount	= 1;
+	viewportState.pScissors		= &scissor;
+
+	VkPipelineRasterizationStateCreateInfo rasterizer = {};
+	rasterizer.sType	   = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+	rasterizer.polygonMode = VK_POLYGON_MODE_FILL;
+	rasterizer.lineWidth   = 1.0f;
+	rasterizer.cullMode	   = VK_CULL_MODE_NONE;
+	rasterizer.frontFace   = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+
+	VkPipelineMultisampleStateCreateInfo multisampling = {};
+	multisampling.sType				   = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+	multisampling.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+
+	VkPipelineColorBlendAttachmentState colorBlendAttachment = {};
+	colorBlendAttachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT |
+		VK_COLOR_COMPONENT_A_BIT;
+
+	VkPipelineColorBlendStateCreateInfo colorBlending = {};
+	colorBlending.sType			  = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+	colorBlending.attachmentCount = 1;
+	colorBlending.pAttachments	  = &colorBlendAttachment;
+
+	VkGraphicsPipelineCreateInfo pipelineInfo = {};
+	pipelineInfo.sType				 = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+	pipelineInfo.stageCount			 = 2;
+	pipelineInfo.pStages			 = shaderStages;
+	pipelineInfo.pVertexInputState	 = &vertexInputInfo;
+	pipelineInfo.pInputAssemblyState = &inputAssembly;
+	pipelineInfo.pViewportState		 = &viewportState;
+	pipelineInfo.pRasterizationState = &rasterizer;
+	pipelineInfo.pMultisampleState	 = &multisampling;
+	pipelineInfo.pColorBlendState	 = &colorBlending;
+	pipelineInfo.layout				 = pipelineLayout;
+	pipelineInfo.renderPass			 = renderPass;
+	pipelineInfo.subpass			 = 0;
+
+	VkPipeline result;
+	if (vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &result) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create benchmark pipeline.");
+	}
+	return result;
+}
+
+void SyntheticBench::beginRenderPass(VkCommandBuffer commands) const {
+	VkClearValue clear = {};
+	clear.color = { { 0.0f, 0.0f, 0.0f, 1.0f } };
+
+	VkRenderPassBeginInfo beginInfo = {};
+	beginInfo.sType				= VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+	beginInfo.renderPass		= renderPass;
+	beginInfo.framebuffer		= framebuffer;
+	beginInfo.renderArea.extent = targetExtent;
+	beginInfo.clearValueCount	= 1;
+	beginInfo.pClearValues		= &clear;
+	vkCmdBeginRenderPass(commands, &beginInfo, VK_SUBPASS_CONTENTS_INLINE);
+}
+
+void SyntheticBench::pushDraw(VkCommandBuffer commands, float x, float y, float scale, uint32_t colorSeed) const {
+	DrawParams params = { { x, y, scale, scale }, { noise::hashUnit(colorSeed), noise::hashUnit(colorSeed + 1), noise::hashUnit(colorSeed + 2), 1.0f } };
+	vkCmdPushConstants(commands, pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(params), &params);
+}
+
+std::vector<SyntheticBench::Scene> SyntheticBench::scenes() {
+	std::vector<Scene> result;
+
+	// Small triangles scattered over the screen in one vertex buffer and one draw, bound by vertex and raster work
+	auto triangleVertices = std::make_shared<vkutil::Buffer>();
+	Scene triangles;
+	triangles.name = "triangles";
+	triangles.parameter = config.triangles;
+	triangles.setup = [this, triangleVertices]() {
+		std::vector<float> vertices(static_cast<size_t>(config.triangles) * 6);
+		for (uint32_t i = 0; i < config.triangles; i++) {
+			float x = noise::hashUnit(i * 4) * 2.0f - 1.0f;
+			float y = noise::hashUnit(i * 4 + 1) * 2.0f - 1.0f;
+			float size = 0.002f + 0.02f * noise::hashUnit(i * 4 + 2);
+			const float corners[6] = { x, y - size, x + size, y + size, x - size, y + size };
+			memcpy(&vertices[static_cast<size_t>(i) * 6], corners, sizeof(corners));
+		}
+		VkDeviceSize size = std::max<VkDeviceSize>(vertices.size() * sizeof(float), sizeof(float));
+		*triangleVertices = vkutil::createBuffer(device, physicalDevice, size, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+		vkutil::uploadBuffer(device, physicalDevice, commandPool, queue, *triangleVertices, vertices.data(), size);
+	};
+	triangles.record = [this, triangleVertices](VkCommandBuffer commands, uint32_t) {
+		beginRenderPass(commands);
+		VkDeviceSize offset = 0;
+		vkCmdBindPipeline(commands, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+		vkCmdBindVertexBuffers(commands, 0, 1, &triangleVertices->buffer, &offset);
+		pushDraw(commands, 0.0f, 0.0f, 1.0f, 0);
+		vkCmdDraw(commands, config.triangles * 3, 1, 0, 0);
+		vkCmdEndRenderPass(commands);
+	};
+	triangles.teardown = [this, triangleVertices]() {
+		vkutil::destroyBuffer(device, *triangleVertices);
+	};
+	result.push_back(triangles);
+
+	// One triangle per draw with its own push constants, bound by the cost of recording and submitting draws
+	Scene draws;
+	draws.name = "draws";
+	draws.parameter = config.draws;
+	draws.record = [this](VkCommandBuffer commands, uint32_t frame) {
+		beginRenderPass(commands);
+		VkDeviceSize offset = 0;
+		vkCmdBindPipeline(commands, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+		vkCmdBindVertexBuffers(commands, 0, 1, &triangleBuffer.buffer, &offset);
+		for (uint32_t i = 0; i < config.draws; i++) {
+			pushDraw(commands, noise::hashUnit(i * 2) * 2.0f - 1.0f, noise::hashUnit(i * 2 + 1) * 2.0f - 1.0f, 0.01f, i + frame);
+			vkCmdDraw(commands, 3, 1, 0, 0);
+		}
+		vkCmdEndRenderPass(commands);
+	};
+	result.push_back(draws);
+
+	// Distinct pipelines created up front, which setup times, then each bound for a draw every frame
+	auto pipelines = std::make_shared<std::vector<VkPipeline>>();
+	Scene pipelineScene;
+	pipelineScene.name = "pipelines";
+	pipelineScene.parameter = config.pipelines;
+	pipelineScene.setup = [this, pipelines]() {
+		for (uint32_t i = 0; i < config.pipelines; i++) {
+			pipelines->push_back(createPipeline(targetExtent, static_cast<float>(i) / std::max(config.pipelines, 1u)));
+		}
+	};
+	pipelineScene.record = [this, pipelines](VkCommandBuffer commands, uint32_t) {
+		beginRenderPass(commands);
+		VkDeviceSize offset = 0;
+		vkCmdBindVertexBuffers(commands, 0, 1, &triangleBuffer.buffer, &offset);
+		for (uint32_t i = 0; i < pipelines->size(); i++) {
+			vkCmdBindPipeline(commands, VK_PIPELINE_BIND_POINT_GRAPHICS, (*pipelines)[i]);
+			pushDraw(commands, noise::hashUnit(i * 2) * 2.0f - 1.0f, noise::hashUnit(i * 2 + 1) * 2.0f - 1.0f, 0.02f, i);
+			vkCmdDraw(commands, 3, 1, 0, 0);
+		}
+		vkCmdEndRenderPass(commands);
+	};
+	pipelineScene.teardown = [this, pipelines]() {
+		for (VkPipeline created : *pipelines) {
+			vkDestroyPipeline(device, created, nullptr);
+		}
+		pipelines->clear();
+	};
+	result.push_back(pipelineScene);
+
+	// The target, its render pass, framebuffer and pipeline recreated at another size every frame, as when a
+	// window is dragged and the swap chain with everything sized by it follows
+	Scene resize;
+	resize.name = "resize";
+	resize.parameter = config.resizeSteps;
+	resize.prepare = [this](uint32_t frame) {
+		uint32_t steps = std::max(config.resizeSteps, 1u);
+		float fraction = 0.25f + 0.75f * static_cast<float>(frame % steps) / std::max(steps - 1, 1u);
+		VkExtent2D extent = { std::max(static_cast<uint32_t>(config.extent.width * fraction), 1u),
+			std::max(static_cast<uint32_t>(config.extent.height * fraction), 1u) };
+		destroyTarget();
+		createTarget(extent);
+	};
+	resize.record = [this](VkCommandBuffer commands, uint32_t) {
+		beginRenderPass(commands);
+		VkDeviceSize offset = 0;
+		vkCmdBindPipeline(commands, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+		vkCmdBindVertexBuffers(commands, 0, 1, &triangleBuffer.buffer, &offset);
+		pushDraw(commands, 0.0f, 0.0f, 0.5f, 0);
+		vkCmdDraw(commands, 3, 1, 0, 0);
+		vkCmdEndRenderPass(commands);
+	};
+	resize.teardown = [this]() {
+		destroyTarget();
+		createTarget(config.extent);
+	};
+	result.push_back(resize);
+
+	// uploadMB written into a staging buffer on the host and copied into a device local one every frame, the
+	// way streamed textures and per frame data come in
+	auto uploadBuffers = std::make_shared<std::vector<vkutil::Buffer>>();
+	VkDeviceSize uploadBytes = static_cast<VkDeviceSize>(config.uploadMB) * 1024 * 1024;
+	Scene upload;
+	upload.name = "upload";
+	upload.parameter = config.uploadMB;
+	upload.setup = [this, uploadBuffers, uploadBytes]() {
+		VkDeviceSize size = std::max<VkDeviceSize>(uploadBytes, 4);
+		uploadBuffers->push_back(vkutil::createBuffer(device, physicalDevice, size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT));
+		uploadBuffers->push_back(vkutil::createBuffer(device, physicalDevice, size, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT));
+	};
+	upload.prepare = [uploadBuffers, uploadBytes](uint32_t frame) {
+		memset((*uploadBuffers)[0].mapped, static_cast<int>(frame & 0xff), static_cast<size_t>(uploadBytes));
+	};
+	upload.record = [this, uploadBuffers, uploadBytes](VkCommandBuffer commands, uint32_t) {
+		if (uploadBytes > 0) {
+			VkBufferCopy region = {};
+			region.size = uploadBytes;
+			vkCmdCopyBuffer(commands, (*uploadBuffers)[0].buffer, (*uploadBuffers)[1].buffer, 1, &region);
+			vkutil::bufferBarrier(commands, (*uploadBuffers)[1].buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT,
+				VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT);
+		}
+		beginRenderPass(commands);
+		VkDeviceSize offset = 0;
+		vkCmdBindPipeline(commands, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+		vkCmdBindVertexBuffers(commands, 0, 1, &triangleBuffer.buffer, &offset);
+		pushDraw(commands, 0.0f, 0.0f, 0.5f, 0);
+		vkCmdDraw(commands, 3, 1, 0, 0);
+		vkCmdEndRenderPass(commands);
+	};
+	upload.teardown = [this, uploadBuffers]() {
+		for (auto& buffer : *uploadBuffers) {
+			vkutil::destroyBuffer(device, buffer);
+		}
+		uploadBuffers->clear();
+	};
+	result.push_back(upload);
+
+	if (config.scenes.empty()) {
+		return result;
+	}
+	std::vector<Scene> selected;
+	for (const auto& name : config.scenes) {
+		auto scene = std::find_if(result.begin(), result.end(), [&](const Scene& candidate) { return candidate.name == name; });
+		if (scene == result.end()) {
+			throw std::runtime_error("Unknown benchmark scene: " + name);
+		}
+		selected.push_back(*scene);
+	}
+	return selected;
+}
+
+std::vector<SyntheticBench::Result> SyntheticBench::run() {
+	std::vector<Result> results;
+	for (const auto& scene : scenes()) {
+		results.push_back(runScene(scene));
+	}
+	return results;
+}
+
+SyntheticBench::Result SyntheticBench::runScene(const Scene& scene) {
+	typedef std::chrono::steady_clock Clock;
+
+	Result result;
+	result.scene = scene.name;
+	result.parameter = scene.parameter;
+	result.extent = config.extent;
+	result.frames = config.frames;
+	result.warmupFrames = config.warmupFrames;
+
+	auto setupStart = Clock::now();
+	if (scene.setup) {
+		scene.setup();
+	}
+	result.setupMs = std::chrono::duration<double, std::milli>(Clock::now() - setupStart).count();
+
+	std::vector<double> frameMs;
+	double gpuMsTotal = 0.0;
+	for (uint32_t frame = 0; frame < config.warmupFrames + config.frames; frame++) {
+		auto frameStart = Clock::now();
+		if (scene.prepare) {
+			scene.prepare(frame);
+		}
+
+		VkCommandBufferBeginInfo beginInfo = {};
+		beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+		beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+		vkResetCommandBuffer(commandBuffer, 0);
+		if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to begin recording command buffer.");
+		}
+		if (queryPool != VK_NULL_HANDLE) {
+			vkCmdResetQueryPool(commandBuffer, queryPool, 0, 2);
+			vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, queryPool, 0);
+		}
+		scene.record(commandBuffer, frame);
+		if (queryPool != VK_NULL_HANDLE) {
+			vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, queryPool, 1);
+		}
+		if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to record command buffer.");
+		}
+
+		VkSubmitInfo submitInfo = {};
+		submitInfo.sType			  = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+		submitInfo.commandBufferCount = 1;
+		submitInfo.pCommandBuffers	  = &commandBuffer;
+
+		if (vkQueueSubmit(queue, 1, &submitInfo, fence) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to submit benchmark frame.");
+		}
+		vkWaitForFences(device, 1, &fence, VK_TRUE, UINT64_MAX);
+		vkResetFences(device, 1, &fence);
+
+		if (frame < config.warmupFrames) {
+			continue;
+		}
+		frameMs.push_back(std::chrono::duration<double, std::milli>(Clock::now() - frameStart).count());
+		if (queryPool != VK_NULL_HANDLE) {
+			uint64_t timestamps[2] = {};
+			if (vkGetQueryPoolResults(device, queryPool, 0, 2, sizeof(timestamps), timestamps, sizeof(uint64_t),
+				VK_QUERY_RESULT_64_BIT) == VK_SUCCESS) {
+				gpuMsTotal += (timestamps[1] - timestamps[0]) * timestampPeriod / 1e6;
+			}
+		}
+	}
+
+	if (scene.teardown) {
+		scene.teardown();
+	}
+
+	if (!frameMs.empty()) {
+		double total = 0.0;
+		for (double ms : frameMs) {
+			total += ms;
+		}
+		std::sort(frameMs.begin(), frameMs.end());
+		result.meanMs = total / frameMs.size();
+		result.p50Ms = percentile(frameMs, 0.5);
+		result.p95Ms = percentile(frameMs, 0.95);
+		result.maxMs = frameMs.back();
+		if (queryPool != VK_NULL_HANDLE) {
+			result.gpuMs = gpuMsTotal / frameMs.size();
+		}
+	}
+	return result;
+}
+
+void SyntheticBench::writeCsv(std::ostream& out, const std::vector<Result>& results) {
+	out << CSV_HEADER << std::endl;
+	for (const auto& result : results) {
+		out << result.scene << "," << result.parameter << "," << result.extent.width << "," << result.extent.height << "," << result.frames
+			<< "," << result.warmupFrames << "," << result.setupMs << "," << result.meanMs << "," << result.p50Ms << "," << result.p95Ms << ","
+			<< result.maxMs << "," << result.gpuMs << std::endl;
+	}
+}
+
+std::vector<SyntheticBench::Result> SyntheticBench::readCsv(const std::string& path) {
+	std::vector<Result> results;
+	std::ifstream file(path);
+	std::string line;
+	// The header first, baselines written before the run conditions were recorded cannot be checked against
+	if (!std::getline(file, line)) {
+		return results;
+	}
+	if (!line.empty() && line.back() == '\r') {
+		line.pop_back();
+	}
+	if (line != CSV_HEADER) {
+		throw std::runtime_error("Benchmark results in another format in " + path + ", run with --update-baseline to write them again");
+	}
+	while (std::getline(file, line)) {
+		if (line.empty()) {
+			continue;
+		}
+		std::istringstream fields(line);
+		std::string field;
+		std::vector<std::string> values;
+		while (std::getline(fields, field, ',')) {
+			values.push_back(field);
+		}
+		if (values.size() < 12) {
+			throw std::runtime_error("Malformed benchmark results line in " + path + ": " + line);
+		}
+
+		auto count = [&](size_t i) { return static_cast<uint32_t>(std::strtoul(values[i].c_str(), nullptr, 10)); };
+		Result result;
+		result.scene = values[0];
+		result.parameter = count(1);
+		result.extent = { count(2), count(3) };
+		result.frames = count(4);
+		result.warmupFrames = count(5);
+		result.setupMs = std::strtod(values[6].c_str(), nullptr);
+		result.meanMs = std::strtod(values[7].c_str(), nullptr);
+		result.p50Ms = std::strtod(values[8].c_str(), nullptr);
+		result.p95Ms = std::strtod(values[9].c_str(), nullptr);
+		result.maxMs = std::strtod(values[10].c_str(), nullptr);
+		result.gpuMs = std::strtod(values[11].c_str(), nullptr);
+		results.push_back(result);
+	}
+	return results;
+}
+
+bool SyntheticBench::checkRegressions(const std::vector<Result>& results, const std::vector<Result>& baseline, double tolerance,
+	std::ostream& log) {
+
+	// Setups this quick are mostly noise, only longer ones are held to the tolerance
+	const double MIN_SETUP_MS = 1.0;
+
+	bool passed = true;
+	for (const auto& result : results) {
+		auto base = std::find_if(baseline.begin(), baseline.end(), [&](const Result& candidate) {
+			return candidate.scene == result.scene && candidate.parameter == result.parameter;
+		});
+		if (base == baseline.end()) {
+			log << result.scene << " (" << result.parameter << "): no baseline" << std::endl;
+			continue;
+		}
+		if (base->extent.width != result.extent.width || base->extent.height != result.extent.height || base->frames != result.frames ||
+			base->warmupFrames != result.warmupFrames) {
+			std::ostringstream message;
+			message << result.scene << " (" << result.parameter << ") ran " << result.frames << " frames after " << result.warmupFrames
+				<< " of " << result.extent.width << "x" << result.extent.height << ", its baseline " << base->frames << " after "
+				<< base->warmupFrames << " of " << base->extent.width << "x" << base->extent.height
+				<< ". Run with the baseline's --size, --frames and --warmup, or another --baseline";
+			throw std::runtime_error(message.str());
+		}
+
+		double frameChange = base->p50Ms > 0.0 ? result.p50Ms / base->p50Ms - 1.0 : 0.0;
+		double setupChange = base->setupMs >= MIN_SETUP_MS ? result.setupMs / base->setupMs - 1.0 : 0.0;
+		bool regressed = frameChange > tolerance || setupChange > tolerance;
+		passed = passed && !regressed;
+
+		log << result.scene << " (" << result.parameter << "): median frame " << result.p50Ms << " ms against " << base->p50Ms << " ms ("
+			<< (frameChange >= 0.0 ? "+" : "") << frameChange * 100.0 << "%)";
+		if (base->setupMs >= MIN_SETUP_MS) {
+			log << ", setup " << result.setupMs << " ms against " << base->setupMs << " ms (" << (setupChange >= 0.0 ? "+" : "")
+				<< setupChange * 100.0 << "%)";
+		}
+		log << (regressed ? ", REGRESSED" : "") << std::endl;
+	}
+	return passed;
+}
@@ -0,0 +1,287 @@
+#include "TextureBaker.h"
+
+#include "BakedTexture.h"
+#include "BlockCompression.h"
+#include "TextureStreamer.h"
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <filesystem>
+#include <iomanip>
+#include <iostream>
+
+namespace {
+
+	typedef BlockCompressor::Image Image;
+
+	float srgbToLinear(uint8_t value) {
+		static const std::vector<float> table = []() {
+			std::vector<float> result(256);
+			for (uint32_t i = 0; i < 256; i++) {
+				float c = i / 255.0f;
+				result[i] = c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+			}
+			return result;
+		}();
+		return table[value];
+	}
+
+	uint8_t linearToSrgb(float linear) {
+		float c = linear <= 0.0031308f ? linear * 12.92f : 1.055f * std::pow(linear, 1.0f / 2.4f) - 0.055f;
+		return static_cast<uint8_t>(std::min(std::max(c, 0.0f), 1.0f) * 255.0f + 0.5f);
+	}
+
+	// Every level down to 1x1, each a box filter of the one above. Color is averaged in linear space, alpha as is
+	std::vector<Image> buildColorChain(Image top) {
+		std::vector<Image> chain;
+		chain.push_back(std::move(top));
+
+		while (chain.back().width > 1 || chain.back().height > 1) {
+			const Image& source = chain.back();
+			Image level;
+			level.width = std::max(source.width / 2, 1u);
+			level.height = std::max(source.height / 2, 1u);
+			level.pixels.resize(static_cast<size_t>(level.width) * level.height * 4);
+
+			for (uint32_t y = 0; y < level.height; y++) {
+				for (uint32_t x = 0; x < level.width; x++) {
+					float sum[4] = {};
+					for (uint32_t sy = 0; sy < 2; sy++) {
+						for (uint32_t sx = 0; sx < 2; sx++) {
+							uint32_t px = std::min(x * 2 + sx, source.width - 1);
+							uint32_t py = std::min(y * 2 + sy, source.height - 1);
+							const uint8_t* texel = &source.pixels[(static_cast<size_t>(py) * source.width + px) * 4];
+							for (uint32_t c = 0; c < 3; c++) {
+								sum[c] += srgbToLinear(texel[c]);
+							}
+							sum[3] += texel[3];
+						}
+					}
+
+					uint8_t* texel = &level.pixels[(static_cast<size_t>(y) * level.width + x) * 4];
+					for (uint32_t c = 0; c < 3; c++) {
+						texel[c] = linearToSrgb(sum[c] * 0.25f);
+					}
+					texel[3] = static_cast<uint8_t>(sum[3] * 0.25f + 0.5f);
+				}
+			}
+
+			chain.push_back(std::move(level));
+		}
+
+		return chain;
+	}
+
+	// Tangent space normals of the relief the color's brightness suggests, x and y in red and green as BC5 stores
+	// them. Each level averages the normals of the one above and renormalizes rather than filtering the encoded values
+	std::vector<Image> buildNormalChain(const Image& color) {
+		const float strength = 4.0f;
+		uint32_t size = color.width;
+
+		auto height = [&](uint32_t x, uint32_t y) {
+			const uint8_t* texel = &color.pixels[(static_cast<size_t>(y % size) * size + x % size) * 4];
+			return (0.2126f * texel[0] + 0.7152f * texel[1] + 0.0722f * texel[2]) / 255.0f;
+		};
+
+		std::vector<glm::vec3> normals(static_cast<size_t>(size) * size);
+		for (uint32_t y = 0; y < size; y++) {
+			for (uint32_t x = 0; x < size; x++) {
+				// The texture tiles, so differences wrap around its edges
+				float dx = height(x + 1, y) - height(x + size - 1, y);
+				float dy = height(x, y + 1) - height(x, y + size - 1);
+				normals[static_cast<size_t>(y) * size + x] = glm::normalize(glm::vec3(-dx * strength, -dy * strength, 1.0f));
+			}
+		}
+
+		std::vector<Image> chain;
+		while (true) {
+			Image level;
+			level.width = size;
+			level.height = size;
+			level.pixels.resize(static_cast<size_t>(size) * size * 4);
+			for (size_t i = 0; i < normals.size(); i++) {
+				level.pixels[i * 4 + 0] = static_cast<uint8_t>((normals[i].x * 0.5f + 0.5f) * 255.0f + 0.5f);
+				level.pixels[i * 4 + 1] = static_cast<uint8_t>((normals[i].y * 0.5f + 0.5f) * 255.0f + 0.5f);
+				level.pixels[i * 4 + 2] = 0;
+				level.pixels[i * 4 + 3] = 255;
+			}
+			chain.push_back(std::move(level));
+
+			if (size == 1) {
+				break;
+			}
+
+			uint32_t half = size / 2;
+			std::vector<glm::vec3> next(static_cast<size_t>(half) * half);
+			for (uint32_t y = 0; y < half; y++) {
+				for (uint32_t x = 0; x < half; x++) {
+					glm::vec3 sum = normals[(y * 2) * size + x * 2] + normals[(y * 2) * size + x * 2 + 1] +
+						normals[(y * 2 + 1) * size + x * 2] + normals[(y * 2 + 1) * size + x * 2 + 1];
+					next[static_cast<size_t>(y) * half + x] = glm::length(sum) > 1e-6f ? glm::normalize(sum) : glm::vec3(0.0f, 0.0f, 1.0f);
+				}
+			}
+			normals = std::move(next);
+			size = half;
+		}
+
+		return chain;
+	}
+
+	// What baking every texture in one format added up to
+	struct Report {
+		uint32_t textures = 0;
+		uint64_t pixels = 0;
+		double encodeMs = 0.0;
+		// Over the channels the format is measured on, every level counted by its pixels
+		double squaredError = 0.0;
+		uint64_t samples = 0;
+		uint64_t compressedBytes = 0;
+		uint64_t uncompressedBytes = 0;
+	};
+
+	// Compress a chain, measuring the error of the first channelCount channels against the source
+	std::vector<std::vector<uint8_t>> compressChain(const BlockCompressor& compressor, bc::Format format, const std::vector<Image>& chain,
+		uint32_t channelCount, Report& report) {
+
+		auto start = std::chrono::high_resolution_clock::now();
+		std::vector<std::vector<uint8_t>> levels = compressor.compress(format, chain);
+		report.encodeMs += std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+		for (size_t level = 0; level < chain.size(); level++) {
+			Image decoded = BlockCompressor::decompress(format, levels[level], chain[level].width, chain[level].height);
+			for (size_t i = 0; i < decoded.pixels.size(); i += 4) {
+				for (uint32_t c = 0; c < channelCount; c++) {
+					double difference = static_cast<double>(decoded.pixels[i + c]) - chain[level].pixels[i + c];
+					report.squaredError += difference * difference;
+				}
+			}
+
+			uint64_t pixels = static_cast<uint64_t>(chain[level].width) * chain[level].height;
+			report.pixels += pixels;
+			report.samples += pixels * channelCount;
+			report.compressedBytes += levels[level].size();
+			report.uncompressedBytes += pixels * 4;
+		}
+		report.textures++;
+
+		return levels;
+	}
+
+	void printReport(const char* name, bc::Format format, const Report& report) {
+		const double mb = 1024.0 * 1024.0;
+		double seconds = std::max(report.encodeMs / 1000.0, 1e-9);
+		double meanSquaredError = report.squaredError / std::max<uint64_t>(report.samples, 1);
+		double psnr = meanSquaredError > 0.0 ? 10.0 * std::log10(255.0 * 255.0 / meanSquaredError) : 99.0;
+
+		std::cout << "  " << name << " " << bc::formatName(format) << ": " << report.textures << " textures, "
+			<< report.pixels / 1e6 << " Mpixels in " << report.encodeMs << " ms (" << report.pixels / 1e6 / seconds << " Mpixels/s, "
+			<< report.uncompressedBytes / mb / seconds << " MB/s of RGBA8), PSNR " << psnr << " dB, "
+			<< report.compressedBytes / mb << " MB against " << report.uncompressedBytes / mb << " MB as RGBA8 ("
+			<< 100.0 * (1.0 - static_cast<double>(report.compressedBytes) / std::max<uint64_t>(report.uncompressedBytes, 1)) << "% saved)" << std::endl;
+	}
+
+}
+
+bool TextureBaker::run(const AppSettings& settings) {
+	ThreadPool threadPool;
+	BlockCompressor compressor(threadPool);
+
+	uint32_t textureCount = TextureStreamer::Config().textureCount;
+	uint32_t size = settings.textureSize;
+
+	bc::Format colorFormat = bc::Format::BC7;
+	VkFormat colorVkFormat = VK_FORMAT_BC7_SRGB_BLOCK;
+	switch (settings.textureCompression) {
+	case TextureCompression::BC1:
+		colorFormat = bc::Format::BC1;
+		colorVkFormat = VK_FORMAT_BC1_RGB_SRGB_BLOCK;
+		break;
+	case TextureCompression::BC3:
+		colorFormat = bc::Format::BC3;
+		colorVkFormat = VK_FORMAT_BC3_SRGB_BLOCK;
+		break;
+	case TextureCompression::BC7:
+		break;
+	}
+
+	std::cout << std::fixed << std::setprecision(2);
+	std::cout << "Texture bake: " << textureCount << " textures, " << size << "^2, color as " << bc::formatName(colorFormat)
+		<< ", normals as bc5, " << threadPool.getThreadCount() + 1 << " threads" << std::endl;
+
+	// Every implementation must write exactly the blocks the scalar one does. One level is enough to
+	// check that and compare their speed, a smaller one than the full size keeps the scalar run short
+	uint32_t checkSize = std::min(size, 512u);
+	Image checkImage;
+	checkImage.width = checkSize;
+	checkImage.height = checkSize;
+	checkImage.pixels = TextureStreamer::generateLevel(0, checkSize);
+
+	BlockCompressor::Implementation implementations[] = {
+		BlockCompressor::Implementation::Scalar,
+		BlockCompressor::Implementation::SSE,
+		BlockCompressor::Implementation::AVX2,
+	};
+	bc::Format formats[] = { bc::Format::BC1, bc::Format::BC3, bc::Format::BC5, bc::Format::BC7 };
+
+	bool passed = true;
+	for (bc::Format format : formats) {
+		std::vector<uint8_t> reference;
+		std::cout << "  " << bc::formatName(format) << " " << checkSize << "^2:";
+
+		for (auto implementation : implementations) {
+			try {
+				compressor.setImplementation(implementation);
+			} catch (const std::exception&) {
+				continue;
+			}
+
+			auto start = std::chrono::high_resolution_clock::now();
+			std::vector<uint8_t> blocks = compressor.compress(format, { checkImage })[0];
+			double ms = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+			if (reference.empty()) {
+				reference = blocks;
+			}
+			bool matches = blocks == reference;
+			passed = passed && matches;
+			std::cout << " " << BlockCompressor::implementationName(implementation) << " " << ms << " ms" << (matches ? "" : " MISMATCH");
+		}
+		std::cout << std::endl;
+	}
+
+	if (!passed) {
+		std::cout << "Texture bake FAILED, encoder implementations disagree" << std::endl;
+		return false;
+	}
+
+	compressor.setImplementation(BlockCompressor::bestImplementation());
+	std::filesystem::create_directories(OUTPUT_DIRECTORY);
+
+	Report colorReport;
+	Report normalReport;
+	for (uint32_t texture = 0; texture < textureCount; texture++) {
+		Image top;
+		top.width = size;
+		top.height = size;
+		top.pixels = TextureStreamer::generateLevel(texture, size);
+
+		std::vector<Image> colorChain = buildColorChain(top);
+		BakedTexture::save(TextureStreamer::bakedPath(OUTPUT_DIRECTORY, texture), colorVkFormat, size, size,
+			compressChain(compressor, colorFormat, colorChain, 3, colorReport));
+
+		std::vector<Image> normalChain = buildNormalChain(top);
+		char name[32];
+		snprintf(name, sizeof(name), "texture_%02u_normal.btex", texture);
+		BakedTexture::save(std::string(OUTPUT_DIRECTORY) + name, VK_FORMAT_BC5_UNORM_BLOCK, size, size,
+			compressChain(compressor, bc::Format::BC5, normalChain, 2, normalReport));
+	}
+
+	std::cout << "Baked with " << BlockCompressor::implementationName(compressor.getImplementation()) << " to " << OUTPUT_DIRECTORY << std::endl;
+	printReport("color", colorFormat, colorReport);
+	printReport("normals", bc::Format::BC5, normalReport);
+	return true;
+}
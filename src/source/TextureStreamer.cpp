@@ -0,0 +1,526 @@
+#include "TextureStreamer.h"
+
+#include "Noise.h"
+
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+
+namespace {
+
+	// Copies out of the ring must start on a texel or block, keep them comfortably aligned
+	VkDeviceSize alignStaging(VkDeviceSize size) {
+		return (size + 255) & ~static_cast<VkDeviceSize>(255);
+	}
+
+}
+
+TextureStreamer::TextureStreamer(VkDevice logicalDevice, VkPhysicalDevice physical, const Config& streamerConfig) :
+	device(logicalDevice),
+	physicalDevice(physical),
+	config(streamerConfig),
+	decodeWorkers(streamerConfig.decodeThreads) {
+
+	textureSize = config.textureSize;
+	mipCount = static_cast<uint32_t>(std::floor(std::log2(textureSize))) + 1;
+	tailMip = 0;
+	while (tailMip + 1 < mipCount && levelSize(tailMip) > TAIL_SIZE) {
+		tailMip++;
+	}
+
+	// Nothing is resident until loadTails
+	textures.resize(config.textureCount);
+	for (auto& texture : textures) {
+		texture.residentMip = mipCount;
+		texture.wantedMip = tailMip;
+	}
+
+	if (config.assets != nullptr && !config.bakedDirectory.empty()) {
+		openBakedTextures();
+	}
+
+	// Room for a full size upload in every frame in flight and one more, so a frame can always start one. The
+	// tails of every texture are uploaded at once, which takes more than that for small textures
+	VkDeviceSize stagingSize = std::max(uploadBytes(0) * (config.framesInFlight + 1), alignStaging(uploadBytes(tailMip)) * config.textureCount);
+	staging = vkutil::createBuffer(device, physicalDevice, stagingSize,
+		VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+	stagingFrameBytes.assign(config.framesInFlight, 0);
+
+	VkSamplerCreateInfo samplerInfo = {};
+	samplerInfo.sType		 = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+	samplerInfo.magFilter	 = VK_FILTER_LINEAR;
+	samplerInfo.minFilter	 = VK_FILTER_LINEAR;
+	samplerInfo.mipmapMode	 = VK_SAMPLER_MIPMAP_MODE_LINEAR;
+	samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+	samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+	samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+	samplerInfo.minLod		 = 0.0f;
+	samplerInfo.maxLod		 = static_cast<float>(mipCount);
+
+	if (vkCreateSampler(device, &samplerInfo, nullptr, &sampler) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create texture sampler.");
+	}
+
+	stats.budget = config.budget;
+}
+
+bool TextureStreamer::isSupported(VkPhysicalDevice physicalDevice) {
+	VkFormatProperties properties;
+	vkGetPhysicalDeviceFormatProperties(physicalDevice, GENERATED_FORMAT, &properties);
+
+	VkFormatFeatureFlags needed = VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT |
+		VK_FORMAT_FEATURE_BLIT_SRC_BIT | VK_FORMAT_FEATURE_BLIT_DST_BIT;
+	return (properties.optimalTilingFeatures & needed) == needed;
+}
+
+void TextureStreamer::loadTails(VkCommandPool commandPool, VkQueue queue) {
+	// Staging for every tail first, so baked ones are read straight into it rather than through a copy. Nothing
+	// else is in the ring yet and the ring was sized for them, so they are laid out back to back past the
+	// per frame limit of allocateStaging
+	std::vector<VkDeviceSize> offsets(textures.size());
+	for (uint32_t i = 0; i < textures.size(); i++) {
+		offsets[i] = alignStaging(uploadBytes(tailMip)) * i;
+	}
+
+	uint32_t size = levelSize(tailMip);
+	decodeWorkers.parallelFor(static_cast<uint32_t>(textures.size()), 1, [&](uint32_t begin, uint32_t end) {
+		for (uint32_t i = begin; i < end; i++) {
+			char* dst = static_cast<char*>(staging.mapped) + offsets[i];
+			if (isBaked()) {
+				bakedTextures[i].loadLevels(tailMip, dst);
+			} else {
+				std::vector<uint8_t> tail = generateLevel(i, size);
+				memcpy(dst, tail.data(), tail.size());
+			}
+		}
+	});
+
+	for (uint32_t i = 0; i < textures.size(); i++) {
+		swapImage(i, tailMip, true, offsets[i]);
+	}
+
+	VkCommandBuffer commandBuffer = vkutil::beginSingleTimeCommands(device, commandPool);
+	recordUploads(commandBuffer);
+	vkutil::endSingleTimeCommands(device, commandPool, queue, commandBuffer);
+
+	// The queue is idle, the whole ring is free again
+	stagingHead = 0;
+	stagingUsed = 0;
+	stagingFrameBytes.assign(config.framesInFlight, 0);
+
+	stats.residentBytes = 0;
+	for (const auto& texture : textures) {
+		stats.residentBytes += texture.memorySize;
+	}
+}
+
+void TextureStreamer::update(uint32_t frame, const std::vector<uint32_t>& requestedMips) {
+	currentFrame = frame;
+	frameNumber++;
+
+	// This frame slot's uploads are done, and images retired a full round of frames ago are no longer in use
+	stagingUsed -= stagingFrameBytes[frame];
+	stagingFrameBytes[frame] = 0;
+
+	for (size_t i = 0; i < retiredImages.size();) {
+		if (retiredImages[i].frame + config.framesInFlight <= frameNumber) {
+			vkutil::destroyImage(device, retiredImages[i].image);
+			retiredImages[i] = retiredImages.back();
+			retiredImages.pop_back();
+		} else {
+			i++;
+		}
+	}
+
+	updateBudget();
+
+	// Make every request coarser by the same number of levels until they fit the budget together
+	auto demandBytes = [&](uint32_t bias) {
+		VkDeviceSize bytes = 0;
+		for (size_t i = 0; i < textures.size(); i++) {
+			bytes += chainBytes(std::min(requestedMips[i] + bias, tailMip));
+		}
+		return bytes;
+	};
+
+	stats.requestedBytes = demandBytes(0);
+	stats.mipBias = 0;
+	while (stats.mipBias < tailMip && demandBytes(stats.mipBias) > stats.budget) {
+		stats.mipBias++;
+	}
+
+	VkDeviceSize residentTexels = 0;
+	for (size_t i = 0; i < textures.size(); i++) {
+		Texture& texture = textures[i];
+		texture.wantedMip = std::min(requestedMips[i] + stats.mipBias, tailMip);
+		if (texture.wantedMip <= texture.residentMip) {
+			texture.lastNeeded = frameNumber;
+		}
+		residentTexels += chainBytes(texture.residentMip);
+	}
+
+	// Upload finished decodes that are still wanted, as far as the staging ring allows this frame
+	for (uint32_t i = 0; i < textures.size(); i++) {
+		Texture& texture = textures[i];
+		if (!texture.decoding || texture.decoded.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+			continue;
+		}
+
+		if (texture.decodingMip < texture.wantedMip || texture.decodingMip >= texture.residentMip) {
+			texture.decoded.get();
+			texture.decoding = false;
+			continue;
+		}
+
+		VkDeviceSize bytes = uploadBytes(texture.decodingMip);
+		VkDeviceSize offset;
+		if (!allocateStaging(bytes, offset)) {
+			continue;
+		}
+
+		std::vector<uint8_t> data = texture.decoded.get();
+		texture.decoding = false;
+		memcpy(static_cast<char*>(staging.mapped) + offset, data.data(), data.size());
+
+		residentTexels += chainBytes(texture.decodingMip) - chainBytes(texture.residentMip);
+		swapImage(i, texture.decodingMip, true, offset);
+
+		double latency = std::chrono::duration<double, std::milli>(Clock::now() - texture.requested).count();
+		stats.streamedIn++;
+		stats.uploadedBytes += bytes;
+		stats.latencyMsTotal += latency;
+		stats.latencyMsMax = std::max(stats.latencyMsMax, latency);
+	}
+
+	// Request finer levels and drop those that have gone unused for a while, or right away when over budget
+	for (uint32_t i = 0; i < textures.size(); i++) {
+		Texture& texture = textures[i];
+
+		if (texture.wantedMip < texture.residentMip && !texture.decoding) {
+			uint32_t mip = texture.wantedMip;
+			uint32_t size = levelSize(mip);
+			texture.decoding = true;
+			texture.decodingMip = mip;
+			texture.requested = Clock::now();
+			if (isBaked()) {
+				texture.decoded = decodeWorkers.submit([baked = bakedTextures[i], mip]() {
+					return baked.loadLevels(mip);
+				});
+			} else {
+				texture.decoded = decodeWorkers.submit([i, size]() {
+					return generateLevel(i, size);
+				});
+			}
+		} else if (texture.wantedMip > texture.residentMip &&
+			(residentTexels > stats.budget || frameNumber - texture.lastNeeded > EVICT_DELAY)) {
+			residentTexels -= chainBytes(texture.residentMip) - chainBytes(texture.wantedMip);
+			swapImage(i, texture.wantedMip, false, 0);
+			stats.streamedOut++;
+		}
+	}
+
+	stats.pendingDecodes = 0;
+	stats.residentBytes = 0;
+	for (const auto& texture : textures) {
+		stats.pendingDecodes += texture.decoding ? 1 : 0;
+		stats.residentBytes += texture.memorySize;
+	}
+}
+
+void TextureStreamer::recordUploads(VkCommandBuffer commandBuffer) {
+	for (const auto& upload : pendingUploads) {
+		vkutil::imageBarrier(commandBuffer, upload.image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+			VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, 0, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT);
+
+		if (upload.fromStaging) {
+			// Staged levels follow each other in the ring, as they do in a baked file
+			std::vector<VkBufferImageCopy> regions(upload.stagedLevels);
+			VkDeviceSize bufferOffset = upload.stagingOffset;
+			for (uint32_t level = 0; level < upload.stagedLevels; level++) {
+				uint32_t size = std::max(upload.size >> level, 1u);
+				regions[level] = {};
+				regions[level].bufferOffset						= bufferOffset;
+				regions[level].imageSubresource.aspectMask		= VK_IMAGE_ASPECT_COLOR_BIT;
+				regions[level].imageSubresource.mipLevel		= level;
+				regions[level].imageSubresource.baseArrayLayer	= 0;
+				regions[level].imageSubresource.layerCount		= 1;
+				regions[level].imageExtent						= { size, size, 1 };
+				bufferOffset += BakedTexture::levelBytes(format, size, size);
+			}
+			vkCmdCopyBufferToImage(commandBuffer, staging.buffer, upload.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+				static_cast<uint32_t>(regions.size()), regions.data());
+
+			// Each remaining level is filtered down from the one above it once that one is written
+			for (uint32_t level = upload.stagedLevels; level < upload.mipLevels; level++) {
+				vkutil::imageBarrier(commandBuffer, upload.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+					VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_READ_BIT,
+					VK_IMAGE_ASPECT_COLOR_BIT, level - 1, 1);
+
+				int32_t srcSize = static_cast<int32_t>(std::max(upload.size >> (level - 1), 1u));
+				int32_t dstSize = static_cast<int32_t>(std::max(upload.size >> level, 1u));
+
+				VkImageBlit blit = {};
+				blit.srcSubresource.aspectMask	= VK_IMAGE_ASPECT_COLOR_BIT;
+				blit.srcSubresource.mipLevel	= level - 1;
+				blit.srcSubresource.layerCount	= 1;
+				blit.srcOffsets[1]				= { srcSize, srcSize, 1 };
+				blit.dstSubresource.aspectMask	= VK_IMAGE_ASPECT_COLOR_BIT;
+				blit.dstSubresource.mipLevel	= level;
+				blit.dstSubresource.layerCount	= 1;
+				blit.dstOffsets[1]				= { dstSize, dstSize, 1 };
+				vkCmdBlitImage(commandBuffer, upload.image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+					upload.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &blit, VK_FILTER_LINEAR);
+			}
+
+			// Levels blitted from were left as transfer sources, from the last staged one to the one before the last.
+			// The others, staged levels above them included, are still transfer destinations
+			uint32_t blitSource = upload.stagedLevels - 1;
+			uint32_t blitSources = upload.mipLevels - upload.stagedLevels;
+			if (blitSources > 0) {
+				vkutil::imageBarrier(commandBuffer, upload.image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+					VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_READ_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT,
+					VK_IMAGE_ASPECT_COLOR_BIT, blitSource, blitSources);
+				vkutil::imageBarrier(commandBuffer, upload.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+					VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT,
+					VK_IMAGE_ASPECT_COLOR_BIT, upload.mipLevels - 1, 1);
+			}
+			if (blitSource > 0 || blitSources == 0) {
+				vkutil::imageBarrier(commandBuffer, upload.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+					VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT,
+					VK_IMAGE_ASPECT_COLOR_BIT, 0, blitSources > 0 ? blitSource : upload.mipLevels);
+			}
+		} else {
+			// The previous frame may still be sampling the old image, the barrier waits for it
+			vkutil::imageBarrier(commandBuffer, upload.source, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+				VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_READ_BIT);
+
+			std::vector<VkImageCopy> regions(upload.mipLevels);
+			for (uint32_t level = 0; level < upload.mipLevels; level++) {
+				uint32_t size = std::max(upload.size >> level, 1u);
+				regions[level] = {};
+				regions[level].srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+				regions[level].srcSubresource.mipLevel	 = upload.sourceMipOffset + level;
+				regions[level].srcSubresource.layerCount = 1;
+				regions[level].dstSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+				regions[level].dstSubresource.mipLevel	 = level;
+				regions[level].dstSubresource.layerCount = 1;
+				regions[level].extent					 = { size, size, 1 };
+			}
+			vkCmdCopyImage(commandBuffer, upload.source, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, upload.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+				static_cast<uint32_t>(regions.size()), regions.data());
+
+			vkutil::imageBarrier(commandBuffer, upload.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+				VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT);
+		}
+	}
+
+	pendingUploads.clear();
+}
+
+void TextureStreamer::destroy() {
+	// Decodes only hold copies of what they need, whatever is still running can be left to finish
+	for (auto& texture : textures) {
+		vkutil::destroyImage(device, texture.image);
+	}
+	for (auto& retired : retiredImages) {
+		vkutil::destroyImage(device, retired.image);
+	}
+	textures.clear();
+	retiredImages.clear();
+	pendingUploads.clear();
+
+	vkutil::destroyBuffer(device, staging);
+	vkDestroySampler(device, sampler, nullptr);
+	sampler = VK_NULL_HANDLE;
+}
+
+void TextureStreamer::resetLatency() {
+	stats.streamedIn = 0;
+	stats.streamedOut = 0;
+	stats.uploadedBytes = 0;
+	stats.latencyMsTotal = 0.0;
+	stats.latencyMsMax = 0.0;
+}
+
+std::string TextureStreamer::bakedPath(const std::string& directory, uint32_t texture) {
+	char name[32];
+	snprintf(name, sizeof(name), "texture_%02u.btex", texture);
+	return directory + name;
+}
+
+void TextureStreamer::openBakedTextures() {
+	std::vector<BakedTexture> baked;
+	try {
+		for (uint32_t i = 0; i < textures.size(); i++) {
+			baked.push_back(BakedTexture::open(*config.assets, bakedPath(config.bakedDirectory, i)));
+		}
+	} catch (const std::exception& e) {
+		bakedFallbackReason = e.what();
+		return;
+	}
+
+	VkFormat bakedFormat = baked[0].getFormat();
+	for (const auto& texture : baked) {
+		if (texture.getWidth() != textureSize || texture.getHeight() != textureSize || texture.getMipCount() != mipCount) {
+			bakedFallbackReason = "baked at a different size than " + std::to_string(textureSize) + ": " + texture.getName();
+			return;
+		}
+		if (texture.getFormat() != bakedFormat) {
+			bakedFallbackReason = "baked textures do not share one format";
+			return;
+		}
+	}
+
+	// Levels are copied rather than blitted, so sampling them is all the format has to support
+	VkFormatProperties properties;
+	vkGetPhysicalDeviceFormatProperties(physicalDevice, bakedFormat, &properties);
+	VkFormatFeatureFlags needed = VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+	bool blockCompressed = bakedFormat >= VK_FORMAT_BC1_RGB_UNORM_BLOCK && bakedFormat <= VK_FORMAT_BC7_SRGB_BLOCK;
+	if ((blockCompressed && !config.blockCompression) || (properties.optimalTilingFeatures & needed) != needed) {
+		bakedFallbackReason = std::string("device cannot sample ") + BakedTexture::formatName(bakedFormat);
+		return;
+	}
+
+	bakedTextures = std::move(baked);
+	format = bakedFormat;
+}
+
+std::vector<uint8_t> TextureStreamer::generateLevel(uint32_t texture, uint32_t size) {
+	std::vector<uint8_t> texels(static_cast<size_t>(size) * size * 4);
+
+	// Bricks of a per texture color, their size and the grain on top of them vary between textures
+	uint32_t seed = noise::hash(texture + 1);
+	float hue[3] = { 0.35f + 0.6f * noise::hashUnit(seed), 0.35f + 0.6f * noise::hashUnit(seed + 1), 0.35f + 0.6f * noise::hashUnit(seed + 2) };
+	uint32_t rows = 4u << (texture % 3);
+	uint32_t columns = rows / 2;
+	const float mortar = 0.06f;
+
+	for (uint32_t y = 0; y < size; y++) {
+		float v = (y + 0.5f) / size;
+		float row = v * rows;
+		uint32_t rowIndex = static_cast<uint32_t>(row);
+		// Every other row is shifted by half a brick
+		float shift = (rowIndex & 1) ? 0.5f : 0.0f;
+
+		for (uint32_t x = 0; x < size; x++) {
+			float u = (x + 0.5f) / size;
+			float column = u * columns + shift;
+			uint32_t columnIndex = static_cast<uint32_t>(column) % columns;
+
+			float fx = column - std::floor(column);
+			float fy = row - std::floor(row);
+			bool isMortar = fx < mortar * 0.5f || fy < mortar;
+
+			float grain = 0.6f * noise::valueNoise(u, v, 64, seed) + 0.4f * noise::valueNoise(u, v, 256, seed + 7);
+			float brick = 0.75f + 0.25f * noise::hashUnit(seed ^ (rowIndex * 131 + columnIndex));
+			float shade = isMortar ? 0.55f + 0.2f * grain : brick * (0.8f + 0.3f * grain);
+
+			uint8_t* texel = &texels[(static_cast<size_t>(y) * size + x) * 4];
+			for (int c = 0; c < 3; c++) {
+				float value = isMortar ? shade : shade * hue[c];
+				texel[c] = static_cast<uint8_t>(std::min(value, 1.0f) * 255.0f + 0.5f);
+			}
+			texel[3] = 255;
+		}
+	}
+
+	return texels;
+}
+
+VkDeviceSize TextureStreamer::chainBytes(uint32_t mip) const {
+	VkDeviceSize bytes = 0;
+	for (uint32_t level = mip; level < mipCount; level++) {
+		bytes += levelBytes(level);
+	}
+	return bytes;
+}
+
+void TextureStreamer::swapImage(uint32_t textureIndex, uint32_t mip, bool fromStaging, VkDeviceSize stagingOffset) {
+	Texture& texture = textures[textureIndex];
+	uint32_t size = levelSize(mip);
+
+	vkutil::Image image = vkutil::createImage(device, physicalDevice, { size, size }, mipCount - mip, format,
+		VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT, VK_IMAGE_ASPECT_COLOR_BIT);
+
+	VkMemoryRequirements requirements;
+	vkGetImageMemoryRequirements(device, image.image, &requirements);
+
+	// Heap the budget is tracked against
+	VkPhysicalDeviceMemoryProperties memoryProperties;
+	vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memoryProperties);
+	uint32_t memoryType = vkutil::findMemoryType(physicalDevice, requirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+	memoryHeap = memoryProperties.memoryTypes[memoryType].heapIndex;
+
+	PendingUpload upload = {};
+	upload.image		   = image.image;
+	upload.mipLevels	   = mipCount - mip;
+	upload.size			   = size;
+	upload.fromStaging	   = fromStaging;
+	upload.stagedLevels	   = fromStaging ? (isBaked() ? mipCount - mip : 1) : 0;
+	upload.stagingOffset   = stagingOffset;
+	upload.source		   = texture.image.image;
+	upload.sourceMipOffset = fromStaging ? 0 : mip - texture.residentMip;
+	pendingUploads.push_back(upload);
+
+	if (texture.image.image != VK_NULL_HANDLE) {
+		retiredImages.push_back({ texture.image, frameNumber });
+	}
+
+	texture.image = image;
+	texture.memorySize = requirements.size;
+	texture.residentMip = mip;
+	version++;
+}
+
+bool TextureStreamer::allocateStaging(VkDeviceSize size, VkDeviceSize& offset) {
+	VkDeviceSize aligned = alignStaging(size);
+
+	// One full size upload per frame at most, so uploads are spread over frames rather than stalling one
+	VkDeviceSize frameLimit = uploadBytes(0);
+	if (stagingFrameBytes[currentFrame] > 0 && stagingFrameBytes[currentFrame] + aligned > frameLimit) {
+		return false;
+	}
+
+	// Allocations never wrap around the end, what is left there is skipped
+	VkDeviceSize start = stagingHead;
+	VkDeviceSize padding = 0;
+	if (start + aligned > staging.size) {
+		padding = staging.size - start;
+		start = 0;
+	}
+	if (stagingUsed + padding + aligned > staging.size) {
+		return false;
+	}
+
+	offset = start;
+	stagingHead = start + aligned;
+	stagingUsed += padding + aligned;
+	stagingFrameBytes[currentFrame] += padding + aligned;
+	return true;
+}
+
+void TextureStreamer::updateBudget() {
+	stats.budget = config.budget;
+	if (config.getMemoryProperties2 == nullptr) {
+		return;
+	}
+
+	VkPhysicalDeviceMemoryBudgetPropertiesEXT heapBudgets = {};
+	heapBudgets.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT;
+
+	VkPhysicalDeviceMemoryProperties2KHR properties = {};
+	properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2_KHR;
+	properties.pNext = &heapBudgets;
+	config.getMemoryProperties2(physicalDevice, &properties);
+
+	// Our own textures are part of the heap's usage. What is left on top of them is ours to take,
+	// minus some headroom for everything else allocated in the meantime
+	VkDeviceSize resident = 0;
+	for (const auto& texture : textures) {
+		resident += texture.memorySize;
+	}
+	VkDeviceSize usage = heapBudgets.heapUsage[memoryHeap];
+	VkDeviceSize available = heapBudgets.heapBudget[memoryHeap] > usage ? heapBudgets.heapBudget[memoryHeap] - usage : 0;
+	stats.budget = std::min(config.budget, resident + available / 4 * 3);
+}
@@ -0,0 +1,77 @@
+
+#include "ThreadPool.h"
+
+#include <algorithm>
+
+ThreadPool::ThreadPool(uint32_t threadCount) {
+	if (threadCount == 0) {
+		uint32_t hardwareThreads = std::thread::hardware_concurrency();
+		threadCount = std::max(hardwareThreads, 2u) - 1;
+	}
+
+	for (uint32_t i = 0; i < threadCount; i++) {
+		workers.emplace_back(&ThreadPool::workerLoop, this);
+	}
+}
+
+ThreadPool::~ThreadPool() {
+	{
+		std::lock_guard<std::mutex> lock(queueMutex);
+		stopping = true;
+	}
+	condition.notify_all();
+
+	for (auto& worker : workers) {
+		worker.join();
+	}
+}
+
+void ThreadPool::parallelFor(uint32_t count, uint32_t grain, const std::function<void(uint32_t begin, uint32_t end)>& body) {
+	if (count == 0) {
+		return;
+	}
+
+	grain = std::max(grain, 1u);
+	uint32_t chunkCount = (count + grain - 1) / grain;
+
+	// Chunks are pulled from a shared counter so uneven chunks balance themselves out
+	std::atomic<uint32_t> nextChunk(0);
+	auto runChunks = [&]() {
+		for (uint32_t chunk = nextChunk++; chunk < chunkCount; chunk = nextChunk++) {
+			uint32_t begin = chunk * grain;
+			body(begin, std::min(begin + grain, count));
+		}
+	};
+
+	uint32_t helperCount = std::min(getThreadCount(), chunkCount - 1);
+	std::vector<std::future<void>> helpers;
+	helpers.reserve(helperCount);
+	for (uint32_t i = 0; i < helperCount; i++) {
+		helpers.push_back(submit(runChunks));
+	}
+
+	runChunks();
+
+	for (auto& helper : helpers) {
+		helper.get();
+	}
+}
+
+void ThreadPool::workerLoop() {
+	while (true) {
+		std::function<void()> task;
+		{
+			std::unique_lock<std::mutex> lock(queueMutex);
+			condition.wait(lock, [this]() { return stopping || !tasks.empty(); });
+
+			if (stopping && tasks.empty()) {
+				return;
+			}
+
+			task = std::move(tasks.front());
+			tasks.pop();
+		}
+
+		task();
+	}
+}
@@ -0,0 +1,162 @@
+#include "Trace.h"
+
+#include "Lz4.h"
+
+namespace trace {
+
+	namespace {
+		// Blocks are cut at the first call boundary past this, so a call never spans two
+		constexpr size_t BLOCK_SIZE = 1 << 20;
+	}
+
+	Writer::Writer(const std::string& path) :
+		file(path, std::ios::binary | std::ios::trunc) {
+
+		if (!file.is_open()) {
+			throw std::runtime_error("Failed to create trace " + path);
+		}
+		file.write(MAGIC, sizeof(MAGIC));
+		compressedBytes = sizeof(MAGIC);
+		block.reserve(BLOCK_SIZE * 2);
+	}
+
+	Writer::~Writer() {
+		if (file.is_open()) {
+			// Whatever made the trace stop early has been reported already
+			try {
+				close();
+			} catch (const std::exception&) {
+			}
+		}
+	}
+
+	void Writer::call(Call id) {
+		if (block.size() >= BLOCK_SIZE) {
+			flushBlock();
+		}
+		value(id);
+	}
+
+	void Writer::bytes(const void* data, size_t size) {
+		const uint8_t* source = static_cast<const uint8_t*>(data);
+		block.insert(block.end(), source, source + size);
+		bytesWritten += size;
+	}
+
+	void Writer::string(const char* text) {
+		uint32_t length = static_cast<uint32_t>(strlen(text));
+		value(length);
+		bytes(text, length);
+	}
+
+	void Writer::strings(const char* const* texts, uint32_t count) {
+		for (uint32_t i = 0; i < count; i++) {
+			string(texts[i]);
+		}
+	}
+
+	void Writer::flushBlock() {
+		if (block.empty()) {
+			return;
+		}
+
+		compressed.resize(lz4::compressBound(block.size()));
+		uint32_t sizes[2] = {
+			static_cast<uint32_t>(block.size()),
+			static_cast<uint32_t>(lz4::compress(block.data(), block.size(), compressed.data())),
+		};
+		file.write(reinterpret_cast<const char*>(sizes), sizeof(sizes));
+		file.write(reinterpret_cast<const char*>(compressed.data()), sizes[1]);
+		if (!file) {
+			throw std::runtime_error("Failed to write trace");
+		}
+		compressedBytes += sizeof(sizes) + sizes[1];
+		block.clear();
+	}
+
+	void Writer::close() {
+		value(Call::End);
+		flushBlock();
+		file.close();
+	}
+
+	Reader::Reader(const std::string& path) :
+		file(path, std::ios::binary) {
+
+		if (!file.is_open()) {
+			throw std::runtime_error("Failed to open trace " + path);
+		}
+		char magic[sizeof(MAGIC)] = {};
+		file.read(magic, sizeof(magic));
+		if (!file || memcmp(magic, MAGIC, sizeof(MAGIC)) != 0) {
+			throw std::runtime_error("Not a trace, or one of another version: " + path);
+		}
+	}
+
+	bool Reader::readBlock() {
+		uint32_t sizes[2] = {};
+		if (!file.read(reinterpret_cast<char*>(sizes), sizeof(sizes))) {
+			return false;
+		}
+		compressed.resize(sizes[1]);
+		if (!file.read(reinterpret_cast<char*>(compressed.data()), sizes[1])) {
+			// The application stopped in the middle of writing it
+			return false;
+		}
+		block.resize(sizes[0]);
+		lz4::decompress(compressed.data(), compressed.size(), block.data(), block.size());
+		position = 0;
+		return true;
+	}
+
+	bool Reader::next(Call& id) {
+		arena.clear();
+		if (position == block.size() && !readBlock()) {
+			return false;
+		}
+		value(id);
+		complete = id == Call::End;
+		return !complete;
+	}
+
+	const uint8_t* Reader::take(size_t size) {
+		if (size > block.size() - position) {
+			throw std::runtime_error("Trace ends in the middle of a call");
+		}
+		const uint8_t* data = block.data() + position;
+		position += size;
+		return data;
+	}
+
+	void Reader::bytes(void* data, size_t size) {
+		memcpy(data, take(size), size);
+	}
+
+	void Reader::string(const char*& text) {
+		uint32_t length = 0;
+		value(length);
+		char* characters = allocate<char>(length + 1);
+		bytes(characters, length);
+		text = characters;
+	}
+
+	void Reader::strings(const char* const*& texts, uint32_t count) {
+		const char** items = count != 0 ? allocate<const char*>(count) : nullptr;
+		for (uint32_t i = 0; i < count; i++) {
+			string(items[i]);
+		}
+		texts = items;
+	}
+
+	uint64_t Reader::lookup(uint64_t id) const {
+		if (id == 0) {
+			return 0;
+		}
+		auto object = objects.find(id);
+		if (object == objects.end()) {
+			throw std::runtime_error("Trace uses an object it never created");
+		}
+		return object->second;
+	}
+
+}
@@ -0,0 +1,1276 @@
+
+// A Vulkan layer writing the calls an application makes into a trace, see Trace.h. It traces the one instance
+// and device an application such as vulkanGraphics creates, from the instance being created until
+// VK_TRACE_FRAMES frames (100 by default) have been presented, into the file VK_TRACE_FILE names. Without
+// VK_TRACE_FILE, and once the frames are traced, every call is passed on after reading a flag, without taking
+// the lock tracing needs. Host writes to mapped memory are found by comparing the
+// memory against a copy of it at every submission, and only written out for memory the device may read
+
+#include "Trace.h"
+
+#include <vulkan/vk_layer.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Every device function the layer traces. Calls the application makes to any other go straight past it
+#define TRACE_DEVICE_FUNCTIONS(X) \
+	X(DestroyDevice) \
+	X(GetDeviceQueue) \
+	X(DeviceWaitIdle) \
+	X(QueueWaitIdle) \
+	X(AllocateMemory) \
+	X(FreeMemory) \
+	X(MapMemory) \
+	X(UnmapMemory) \
+	X(BindBufferMemory) \
+	X(BindImageMemory) \
+	X(CreateBuffer) \
+	X(DestroyBuffer) \
+	X(CreateImage) \
+	X(DestroyImage) \
+	X(CreateImageView) \
+	X(DestroyImageView) \
+	X(CreateSampler) \
+	X(DestroySampler) \
+	X(CreateShaderModule) \
+	X(DestroyShaderModule) \
+	X(CreatePipelineLayout) \
+	X(DestroyPipelineLayout) \
+	X(CreateDescriptorSetLayout) \
+	X(DestroyDescriptorSetLayout) \
+	X(CreateDescriptorPool) \
+	X(DestroyDescriptorPool) \
+	X(CreateRenderPass) \
+	X(DestroyRenderPass) \
+	X(CreateFramebuffer) \
+	X(DestroyFramebuffer) \
+	X(CreateQueryPool) \
+	X(DestroyQueryPool) \
+	X(CreateFence) \
+	X(DestroyFence) \
+	X(CreateSemaphore) \
+	X(DestroySemaphore) \
+	X(CreateCommandPool) \
+	X(DestroyCommandPool) \
+	X(CreateGraphicsPipelines) \
+	X(CreateComputePipelines) \
+	X(DestroyPipeline) \
+	X(CreateSwapchainKHR) \
+	X(DestroySwapchainKHR) \
+	X(GetSwapchainImagesKHR) \
+	X(AcquireNextImageKHR) \
+	X(QueuePresentKHR) \
+	X(AllocateDescriptorSets) \
+	X(FreeDescriptorSets) \
+	X(UpdateDescriptorSets) \
+	X(AllocateCommandBuffers) \
+	X(FreeCommandBuffers) \
+	X(ResetCommandBuffer) \
+	X(BeginCommandBuffer) \
+	X(EndCommandBuffer) \
+	X(CmdBindPipeline) \
+	X(CmdBindDescriptorSets) \
+	X(CmdBindVertexBuffers) \
+	X(CmdBindIndexBuffer) \
+	X(CmdPushConstants) \
+	X(CmdSetViewport) \
+	X(CmdSetScissor) \
+	X(CmdBeginRenderPass) \
+	X(CmdEndRenderPass) \
+	X(CmdDraw) \
+	X(CmdDrawIndexed) \
+	X(CmdDrawIndirect) \
+	X(CmdDrawIndexedIndirect) \
+	X(CmdDrawIndexedIndirectCountKHR) \
+	X(CmdDispatch) \
+	X(CmdDispatchIndirect) \
+	X(CmdPipelineBarrier) \
+	X(CmdCopyBuffer) \
+	X(CmdCopyImage) \
+	X(CmdBlitImage) \
+	X(CmdCopyBufferToImage) \
+	X(CmdCopyImageToBuffer) \
+	X(CmdFillBuffer) \
+	X(CmdUpdateBuffer) \
+	X(CmdClearColorImage) \
+	X(CmdClearAttachments) \
+	X(CmdResetQueryPool) \
+	X(CmdWriteTimestamp) \
+	X(QueueSubmit) \
+	X(WaitForFences) \
+	X(ResetFences) \
+	X(GetFenceStatus)
+
+namespace {
+
+	using trace::Call;
+	using trace::Object;
+	using trace::Writer;
+
+	// The functions of the layer or driver below this one
+	struct InstanceTable {
+		VkInstance instance = VK_NULL_HANDLE;
+		PFN_vkGetInstanceProcAddr GetInstanceProcAddr = nullptr;
+		PFN_vkDestroyInstance DestroyInstance = nullptr;
+		PFN_vkGetPhysicalDeviceProperties GetPhysicalDeviceProperties = nullptr;
+		PFN_vkGetPhysicalDeviceMemoryProperties GetPhysicalDeviceMemoryProperties = nullptr;
+	};
+
+	struct DeviceTable {
+		PFN_vkGetDeviceProcAddr GetDeviceProcAddr = nullptr;
+#define TRACE_DECLARE(name) PFN_vk##name name = nullptr;
+		TRACE_DEVICE_FUNCTIONS(TRACE_DECLARE)
+#undef TRACE_DECLARE
+	};
+
+	InstanceTable instanceNext;
+	DeviceTable next;
+
+	// What the layer keeps of an allocation while tracing
+	struct Memory {
+		VkDeviceSize size = 0;
+		// Whether a buffer the device may read from, or an image, is bound to it. Memory the device only ever
+		// writes, such as a readback buffer, is of no use to a replay
+		bool readByDevice = false;
+		uint8_t* mapped = nullptr;
+		VkDeviceSize mappedOffset = 0;
+		// The mapped range as the trace last saw it
+		std::vector<uint8_t> shadow;
+	};
+
+	struct Capture {
+		std::mutex mutex;
+		// Null when not tracing, or once the frames have been traced
+		std::unique_ptr<Writer> writer;
+		// Whether there is a writer, read without the lock
+		std::atomic<bool> tracing { false };
+		std::string path;
+		uint64_t frameLimit = 100;
+		uint64_t frames = 0;
+		std::chrono::steady_clock::time_point start;
+		// Without one a frame ends at a submission with a fence
+		bool swapchainCreated = false;
+		std::vector<VkMemoryPropertyFlags> memoryTypes;
+		std::unordered_map<VkDeviceMemory, Memory> memory;
+		// Whether the device may read each buffer, by its usage
+		std::unordered_map<VkBuffer, bool> bufferReads;
+		// The pool of every secondary command buffer, the only ones whose inheritance info is valid to read
+		std::unordered_map<VkCommandBuffer, VkCommandPool> secondaryCommandBuffers;
+	};
+
+	Capture capture;
+
+	std::string environment(const char* name) {
+#ifdef _WIN32
+		char* value = nullptr;
+		size_t length = 0;
+		std::string result;
+		if (_dupenv_s(&value, &length, name) == 0 && value != nullptr) {
+			result = value;
+			free(value);
+		}
+		return result;
+#else
+		const char* value = std::getenv(name);
+		return value != nullptr ? value : "";
+#endif
+	}
+
+	// Must hold the capture's lock
+	void finish(const char* reason) {
+		capture.writer->close();
+		std::cerr << "Trace: " << capture.frames << " frames, " << capture.writer->getBytes() / (1024 * 1024) << " MB ("
+			<< capture.writer->getCompressedBytes() / (1024 * 1024) << " MB compressed) written to " << capture.path
+			<< " as " << reason << std::endl;
+		if (capture.writer->getSkippedStructures() > 0) {
+			std::cerr << "Trace: left out " << capture.writer->getSkippedStructures()
+				<< " structures of unknown types chained to the calls, the replay may differ" << std::endl;
+		}
+		capture.writer.reset();
+		capture.tracing = false;
+		capture.memory.clear();
+		capture.bufferReads.clear();
+		capture.secondaryCommandBuffers.clear();
+	}
+
+	// Runs write with the writer while tracing, under the lock that keeps calls made on different threads apart.
+	// A trace that fails to write stops rather than take the application down with it
+	template <typename Write>
+	void withWriter(Write&& write) {
+		if (!capture.tracing.load(std::memory_order_relaxed)) {
+			return;
+		}
+		std::lock_guard<std::mutex> lock(capture.mutex);
+		if (!capture.writer) {
+			return;
+		}
+		try {
+			write(*capture.writer);
+		} catch (const std::exception& e) {
+			std::cerr << "Trace stopped: " << e.what() << std::endl;
+			capture.writer.reset();
+			capture.tracing = false;
+		}
+	}
+
+	template <typename Write>
+	void record(Call call, Write&& write) {
+		withWriter([&](Writer& writer) {
+			writer.call(call);
+			write(writer);
+		});
+	}
+
+	template <typename Info, typename T>
+	void recordCreate(Call call, const Info* pCreateInfo, T object) {
+		record(call, [&](Writer& writer) {
+			Info info = *pCreateInfo;
+			writer.fields(info);
+			writer.handle(object);
+		});
+	}
+
+	// Before the object is gone, so the handle cannot be reused by another thread ahead of the trace saying so
+	template <typename T>
+	void recordDestroy(Object type, T object) {
+		if (object == VK_NULL_HANDLE) {
+			return;
+		}
+		record(Call::Destroy, [&](Writer& writer) {
+			writer.value(type);
+			writer.handle(object);
+		});
+	}
+
+	// Writes out the runs of the mapped range that changed since it was last looked at. Changes are copied into
+	// the shadow first and written from there, so a thread writing the memory meanwhile is caught next time
+	void writeChanges(Writer& writer, VkDeviceMemory memory, Memory& allocation) {
+		const VkDeviceSize CHUNK = 256;
+		VkDeviceSize size = allocation.shadow.size();
+		VkDeviceSize offset = 0;
+		while (offset < size) {
+			VkDeviceSize length = std::min(CHUNK, size - offset);
+			if (memcmp(allocation.mapped + offset, allocation.shadow.data() + offset, length) == 0) {
+				offset += length;
+				continue;
+			}
+
+			VkDeviceSize first = offset;
+			do {
+				offset += length;
+				length = std::min(CHUNK, size - offset);
+			} while (offset < size && memcmp(allocation.mapped + offset, allocation.shadow.data() + offset, length) != 0);
+
+			VkDeviceSize runLength = offset - first;
+			memcpy(allocation.shadow.data() + first, allocation.mapped + first, runLength);
+			VkDeviceSize runOffset = allocation.mappedOffset + first;
+			writer.call(Call::WriteMemory);
+			writer.handle(memory);
+			writer.fields(runOffset, runLength);
+			writer.bytes(allocation.shadow.data() + first, runLength);
+		}
+	}
+
+	// Must hold the capture's lock
+	void endFrame(Writer& writer) {
+		uint64_t time = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+			std::chrono::steady_clock::now() - capture.start).count());
+		writer.call(Call::FrameEnd);
+		writer.value(time);
+		if (++capture.frames == capture.frameLimit) {
+			finish("the frames were traced");
+		}
+	}
+
+	VKAPI_ATTR void VKAPI_CALL DestroyDevice(VkDevice device, const VkAllocationCallbacks* pAllocator) {
+		{
+			std::lock_guard<std::mutex> lock(capture.mutex);
+			if (capture.writer) {
+				finish("the device was destroyed");
+			}
+		}
+		next.DestroyDevice(device, pAllocator);
+	}
+
+	VKAPI_ATTR void VKAPI_CALL GetDeviceQueue(VkDevice device, uint32_t queueFamilyIndex, uint32_t queueIndex, VkQueue* pQueue) {
+		next.GetDeviceQueue(device, queueFamilyIndex, queueIndex, pQueue);
+		record(Call::GetDeviceQueue, [&](Writer& writer) {
+			writer.fields(queueFamilyIndex, queueIndex);
+			writer.handle(*pQueue);
+		});
+	}
+
+	VKAPI_ATTR VkResult VKAPI_CALL DeviceWaitIdle(VkDevice device) {
+		record(Call::DeviceWaitIdle, [&](Writer&) {});
+		return next.DeviceWaitIdle(device);
+	}
+
+	VKAPI_ATTR VkResult VKAPI_CALL QueueWaitIdle(VkQueue queue) {
+		record(Call::QueueWaitIdle, [&](Writer& writer) { writer.fields(queue); });
+		return next.QueueWaitIdle(queue);
+	}
+
+	// The memory type's properties go along, for a replay on a device whose types are numbered differently
+	VKAPI_ATTR VkResult VKAPI_CALL AllocateMemory(VkDevice device, const VkMemoryAllocateInfo* pAllocateInfo,
+		const VkAllocationCallbacks* pAllocator, VkDeviceMemory* pMemory) {
+
+		VkResult result = next.AllocateMemory(device, pAllocateInfo, pAllocator, pMemory);
+		if (result == VK_SUCCESS) {
+			record(Call::AllocateMemory, [&](Writer& writer) {
+				VkMemoryAllocateInfo info = *pAllocateInfo;
+				VkMemoryPropertyFlags properties = info.memoryTypeIndex < capture.memoryTypes.size() ? capture.memoryTypes[info.memoryTypeIndex] : 0;
+				writer.fields(info, properties);
+				writer.handle(*pMemory);
+				capture.memory[*pMemory].size = info.allocationSize;
+			});
+		}
+		return result;
+	}
+
+	VKAPI_ATTR void VKAPI_CALL FreeMemory(VkDevice device, VkDeviceMemory memory, const VkAllocationCallbacks* pAllocator) {
+		recordDestroy(Object::Memory, memory);
+		withWriter([&](Writer&) { capture.memory.erase(memory); });
+		next.FreeMemory(device, memory, pAllocator);
+	}
+
+	// Nothing is written until the mapped memory is submitted or unmapped, what it holds now is the starting point
+	VKAPI_ATTR VkResult VKAPI_CALL MapMemory(VkDevice device, VkDeviceMemory memory, VkDeviceSize offset, VkDeviceSize size,
+		VkMemoryMapFlags flags, void** ppData) {
+
+		VkResult result = next.MapMemory(device, memory, offset, size, flags, ppData);
+		if (result == VK_SUCCESS) {
+			withWriter([&](Writer&) {
+				auto allocation = capture.memory.find(memory);
+				if (allocation == capture.memory.end()) {
+					return;
+				}
+				VkDeviceSize mappedSize = size == VK_WHOLE_SIZE ? allocation->second.size - offset : size;
+				allocation->second.mapped = static_cast<uint8_t*>(*ppData);
+				allocation->second.mappedOffset = offset;
+				allocation->second.shadow.assign(allocation->second.mapped, allocation->second.mapped + mappedSize);
+			});
+		}
+		return result;
+	}
+
+	VKAPI_ATTR void VKAPI_CALL UnmapMemory(VkDevice device, VkDeviceMemory memory) {
+		withWriter([&](Writer& writer) {
+			auto allocation = capture.memory.find(memory);
+			if (allocation == capture.memory.end() || allocation->second.mapped == nullptr) {
+				return;
+			}
+			if (allocation->second.readByDevice) {
+				writeChanges(writer, memory, allocation->second);
+			}
+			allocation->second.mapped = nullptr;
+			allocation->second.shadow = {};
+		});
+		next.UnmapMemory(device, memory);
+	}
+
+	VKAPI_ATTR VkResult VKAPI_CALL BindBufferMemory(VkDevice device, VkBuffer buffer, VkDeviceMemory memory, VkDeviceSize memoryOffset) {
+		VkResult result = next.BindBufferMemory(device, buffer, memory, memoryOffset);
+		if (result == VK_SUCCESS) {
+			record(Call::BindBufferMemory, [&](Writer& writer) {
+				writer.fields(buffer, memory, memoryOffset);
+				capture.memory[memory].readByDevice |= capture.bufferReads[buffer];
+			});
+		}
+		return result;
+	}
+
+	VKAPI_ATTR VkResult VKAPI_CALL BindImageMemory(VkDevice device, VkImage image, VkDeviceMemory memory, VkDeviceSize memoryOffset) {
+		VkResult result = next.BindImageMemory(device, image, memory, memoryOffset);
+		if (result == VK_SUCCESS) {
+			record(Call::BindImageMemory, [&](Writer& writer) {
+				writer.fields(image, memory, memoryOffset);
+				capture.memory[memory].readByDevice = true;
+			});
+		}
+		return result;
+	}
+
+	VKAPI_ATTR VkResult VKAPI_CALL CreateBuffer(VkDevice device, const VkBufferCreateInfo* pCreateInfo,
+		const VkAllocationCallbacks* pAllocator, VkBuffer* pBuffer) {
+
+		VkResult result = next.CreateBuffer(device, pCreateInfo, pAllocator, pBuffer);
+		if (result == VK_SUCCESS) {
+			recordCreate(Call::CreateBuffer, pCreateInfo, *pBuffer);
+			withWriter([&](Writer&) { capture.bufferReads[*pBuffer] = (pCreateInfo->usage & ~VK_BUFFER_USAGE_TRANSFER_DST_BIT) != 0; });
+		}
+		return result;
+	}
+
+	VKAPI_ATTR void VKAPI_CALL DestroyBuffer(VkDevice device, VkBuffer buffer, const VkAllocationCallbacks* pAllocator) {
+		recordDestroy(Object::Buffer, buffer);
+		withWriter([&](Writer&) { capture.bufferReads.erase(buffer); });
+		next.DestroyBuffer(device, buffer, pAllocator);
+	}
+
+	VKAPI_ATTR VkResult VKAPI_CALL CreateImage(VkDevice device, const VkImageCreateInfo* pCreateInfo,
+		const VkAllocationCallbacks* pAllocator, VkImage* pImage) {
+
+		VkResult result = next.CreateImage(device, pCreateInfo, pAllocator, pImage);
+		if (result == VK_SUCCESS) {
+			recordCreate(Call::CreateImage, pCreateInfo, *pImage);
+		}
+		return result;
+	}
+
+	VKAPI_ATTR void VKAPI_CALL DestroyImage(VkDevice device, VkImage image, const VkAllocationCallbacks* pAllocator) {
+		recordDestroy(Object::Image, image);
+		next.DestroyImage(device, image, pAllocator);
+	}
+
+	VKAPI_ATTR VkResult VKAPI_CALL CreateImageView(VkDevice device, const VkImageViewCreateInfo* pCreateInfo,
+		const VkAllocationCallbacks* pAllocator, VkImageView* pView) {
+
+		VkResult result = next.CreateImageView(device, pCreateInfo, pAllocator, pView);
+		if (result == VK_SUCCESS) {
+			recordCreate(Call::CreateImageView, pCreateInfo, *pView);
+		}
+		return result;
+	}
+
+	VKAPI_ATTR void VKAPI_CALL DestroyImageView(VkDevice device, VkImageView imageView, const VkAllocationCallbacks* pAllocator) {
+		recordDestroy(Object::ImageView, imageView);
+		next.DestroyImageView(device, imageView, pAllocator);
+	}
+
+	VKAPI_ATTR VkResult VKAPI_CALL CreateSampler(VkDevice device, const VkSamplerCreateInfo* pCreateInfo,
+		const VkAllocationCallbacks* pAllocator, VkSampler* pSampler) {
+
+		VkResult result = next.CreateSampler(device, pCreateInfo, pAllocator, pSampler);
+		if (result == VK_SUCCESS) {
+			recordCreate(Call::CreateSampler, pCreateInfo, *pSampler);
+		}
+		return result;
+	}
+
+	VKAPI_ATTR void VKAPI_CALL DestroySampler(VkDevice device, VkSampler sampler, const VkAllocationCallbacks* pAllocator) {
+		recordDestroy(Object::Sampler, sampler);
+		next.DestroySampler(device, sampler, pAllocator);
+	}
+
+	VKAPI_ATTR VkResult VKAPI_CALL CreateShaderModule(VkDevice device, const VkShaderModuleCreateInfo* pCreateInfo,
+		const VkAllocationCallbacks* pAllocator, VkShaderModule* pShaderModule) {
+
+		VkResult result = next.CreateShaderModule(device, pCreateInfo, pAllocator, pShaderModule);
+		if (result == VK_SUCCESS) {
+			recordCreate(Call::CreateShaderModule, pCreateInfo, *pShaderModule);
+		}
+		return result;
+	}
+
+	VKAPI_ATTR void VKAPI_CALL DestroyShaderModule(VkDevice device, VkShaderModule shaderModule, const VkAllocationCallbacks* pAllocator) {
+		recordDestroy(Object::ShaderModule, shaderModule);
+		next.DestroyShaderModule(device, shaderModule, pAllocator);
+	}
+
+	VKAPI_ATTR VkResult VKAPI_CALL CreatePipelineLayout(VkDevice device, const VkPipelineLayoutCreateInfo* pCreateInfo,
+		const VkAllocationCallbacks* pAllocator, VkPipelineLayout* pPipelineLayout) {
+
+		VkResult result = next.CreatePipelineLayout(device, pCreateInfo, pAllocator, pPipelineLayout);
+		if (result == VK_SUCCESS) {
+			recordCreate(Call::CreatePipelineLayout, pCreateInfo, *pPipelineLayout);
+		}
+		return result;
+	}
+
+	VKAPI_ATTR void VKAPI_CALL DestroyPipelineLayout(VkDevice device, VkPipelineLayout pipelineLayout, const VkAllocationCallbacks* pAllocator) {
+		recordDestroy(Object::PipelineLayout, pipelineLayout);
+		next.DestroyPipelineLayout(device, pipelineLayout, pAllocator);
+	}
+
+	VKAPI_ATTR VkResult VKAPI_CALL CreateDescriptorSetLayout(VkDevice device, const VkDescriptorSetLayoutCreateInfo* pCreateInfo,
+		const VkAllocationCallbacks* pAllocator, VkDescriptorSetLayout* pSetLayout) {
+
+		VkResult result = next.CreateDescriptorSetLayout(device, pCreateInfo, pAllocator, pSetLayout);
+		if (result == VK_SUCCESS) {
+			recordCreate(Call::CreateDescriptorSetLayout, pCreateInfo, *pSetLayout);
+		}
+		return result;
+	}
+
+	VKAPI_ATTR void VKAPI_CALL DestroyDescriptorSetLayout(VkDevice device, VkDescriptorSetLayout descriptorSetLayout,
+		const VkAllocationCallbacks* pAllocator) {
+
+		recordDestroy(Object::DescriptorSetLayout, descriptorSetLayout);
+		next.DestroyDescriptorSetLayout(device, descriptorSetLayout, pAllocator);
+	}
+
+	VKAPI_ATTR VkResult VKAPI_CALL CreateDescriptorPool(VkDevice device, const VkDescriptorPoolCreateInfo* pCreateInfo,
+		const VkAllocationCallbacks* pAllocator, VkDescriptorPool* pDescriptorPool) {
+
+		VkResult result = next.CreateDescriptorPool(device, pCreateInfo, pAllocator, pDescriptorPool);
+		if (result == VK_SUCCESS) {
+			recordCreate(Call::CreateDescriptorPool, pCreateInfo, *pDescriptorPool);
+		}
+		return result;
+	}
+
+	VKAPI_ATTR void VKAPI_CALL DestroyDescriptorPool(VkDevice device, VkDescriptorPool descriptorPool, const VkAllocationCallbacks* pAllocator) {
+		recordDestroy(Object::DescriptorPool, descriptorPool);
+		next.DestroyDescriptorPool(device, descriptorPool, pAllocator);
+	}
+
+	VKAPI_ATTR VkResult VKAPI_CALL CreateRenderPass(VkDevice device, const VkRenderPassCreateInfo* pCreateInfo,
+		const VkAllocationCallbacks* pAllocator, VkRenderPass* pRenderPass) {
+
+		VkResult result = next.CreateRenderPass(device, pCreateInfo, pAllocator, pRenderPass);
+		if (result == VK_SUCCESS) {
+			recordCreate(Call::CreateRenderPass, pCreateInfo, *pRenderPass);
+		}
+		return result;
+	}
+
+	VKAPI_ATTR void VKAPI_CALL DestroyRenderPass(VkDevice device, VkRenderPass renderPass, const VkAllocationCallbacks* pAllocator) {
+		recordDestroy(Object::RenderPass, renderPass);
+		next.DestroyRenderPass(device, renderPass, pAllocator);
+	}
+
+	VKAPI_ATTR VkResult VKAPI_CALL CreateFramebuffer(VkDevice device, const VkFramebufferCreateInfo* pCreateInfo,
+		const VkAllocationCallbacks* pAllocator, VkFramebuffer* pFramebuffer) {
+
+		VkResult result = next.CreateFramebuffer(device, pCreateInfo, pAllocator, pFramebuffer);
+		if (result == VK_SUCCESS) {
+			recordCreate(Call::CreateFramebuffer, pCreateInfo, *pFramebuffer);
+		}
+		return result;
+	}
+
+	VKAPI_ATTR void VKAPI_CALL DestroyFramebuffer(VkDevice device, VkFramebuffer framebuffer, const VkAllocationCallbacks* pAllocator) {
+		recordDestroy(Object::Framebuffer, framebuffer);
+		next.DestroyFramebuffer(device, framebuffer, pAllocator);
+	}
+
+	VKAPI_ATTR VkResult VKAPI_CALL CreateQueryPool(VkDevice device, const VkQueryPoolCreateInfo* pCreateInfo,
+		const VkAllocationCallbacks* pAllocator, VkQueryPool* pQueryPool) {
+
+		VkResult result = next.CreateQueryPool(device, pCreateInfo, pAllocator, pQueryPool);
+		if (result == VK_SUCCESS) {
+			recordCreate(Call::CreateQueryPool, pCreateInfo, *pQueryPool);
+		}
+		return result;
+	}
+
+	VKAPI_ATTR void VKAPI_CALL DestroyQueryPool(VkDevice device, VkQueryPool queryPool, const VkAllocationCallbacks* pAllocator) {
+		recordDestroy(Object::QueryPool, queryPool);
+		next.DestroyQueryPool(device, queryPool, pAllocator);
+	}
+
+	VKAPI_ATTR VkResult VKAPI_CALL CreateFence(VkDevice device, const VkFenceCreateInfo* pCreateInfo,
+		const VkAllocationCallbacks* pAllocator, VkFence* pFence) {
+
+		VkResult result = next.CreateFence(device, pCreateInfo, pAllocator, pFence);
+		if (result == VK_SUCCESS) {
+			recordCreate(Call::CreateFence, pCreateInfo, *pFence);
+		}
+		return result;
+	}
+
+	VKAPI_ATTR void VKAPI_CALL DestroyFence(VkDevice device, VkFence fence, const VkAllocationCallbacks* pAllocator) {
+		recordDestroy(Object::Fence, fence);
+		next.DestroyFence(device, fence, pAllocator);
+	}
+
+	VKAPI_ATTR VkResult VKAPI_CALL CreateSemaphore(VkDevice device, const VkSemaphoreCreateInfo* pCreateInfo,
+		const VkAllocationCallbacks* pAllocator, VkSemaphore* pSemaphore) {
+
+		VkResult result = next.CreateSemaphore(device, pCreateInfo, pAllocator, pSemaphore);
+		if (result == VK_SUCCESS) {
+			recordCreate(Call::CreateSemaphore, pCreateInfo, *pSemaphore);
+		}
+		return result;
+	}
+
+	VKAPI_ATTR void VKAPI_CALL DestroySemaphore(VkDevice device, VkSemaphore semaphore, const VkAllocationCallbacks* pAllocator) {
+		recordDestroy(Object::Semaphore, semaphore);
+		next.DestroySemaphore(device, semaphore, pAllocator);
+	}
+
+	VKAPI_ATTR VkResult VKAPI_CALL CreateCommandPool(VkDevice device, const VkCommandPoolCreateInfo* pCreateInfo,
+		const VkAllocationCallbacks* pAllocator, VkCommandPool* pCommandPool) {
+
+		VkResult result = next.CreateCommandPool(device, pCreateInfo, pAllocator, pCommandPool);
+		if (result == VK_SUCCESS) {
+			recordCreate(Call::CreateCommandPool, pCreateInfo, *pCommandPool);
+		}
+		return result;
+	}
+
+	VKAPI_ATTR void VKAPI_CALL DestroyCommandPool(VkDevice device, VkCommandPool commandPool, const VkAllocationCallbacks* pAllocator) {
+		recordDestroy(Object::CommandPool, commandPool);
+		withWriter([&](Writer&) {
+			auto& secondary = capture.secondaryCommandBuffers;
+			for (auto i = secondary.begin(); i != secondary.end();) {
+				i = i->second == commandPool ? secondary.erase(i) : std::next(i);
+			}
+		});
+		next.DestroyCommandPool(device, commandPool, pAllocator);
+	}
+
+	// Pipeline caches are left to the replay's driver, which is why they are not passed on
+	VKAPI_ATTR VkResult VKAPI_CALL CreateGraphicsPipelines(VkDevice device, VkPipelineCache pipelineCache, uint32_t createInfoCount,
+		const VkGraphicsPipelineCreateInfo* pCreateInfos, const VkAllocationCallbacks* pAllocator, VkPipeline* pPipelines) {
+
+		VkResult result = next.CreateGraphicsPipelines(device, pipelineCache, createInfoCount, pCreateInfos, pAllocator, pPipelines);
+		if (result == VK_SUCCESS) {
+			record(Call::CreateGraphicsPipelines, [&](Writer& writer) {
+				writer.fields(createInfoCount);
+				writer.array(pCreateInfos, createInfoCount);
+				writer.array(pPipelines, createInfoCount);
+			});
+		}
+		return result;
+	}
+
+	VKAPI_ATTR VkResult VKAPI_CALL CreateComputePipelines(VkDevice device, VkPipelineCache pipelineCache, uint32_t createInfoCount,
+		const VkComputePipelineCreateInfo* pCreateInfos, const VkAllocationCallbacks* pAllocator, VkPipeline* pPipelines) {
+
+		VkResult result = next.CreateComputePipelines(device, pipelineCache, createInfoCount, pCreateInfos, pAllocator, pPipelines);
+		if (result == VK_SUCCESS) {
+			record(Call::CreateComputePipelines, [&](Writer& writer) {
+				writer.fields(createInfoCount);
+				writer.array(pCreateInfos, createInfoCount);
+				writer.array(pPipelines, createInfoCount);
+			});
+		}
+		return result;
+	}
+
+	VKAPI_ATTR void VKAPI_CALL DestroyPipeline(VkDevice device, VkPipeline pipeline, const VkAllocationCallbacks* pAllocator) {
+		recordDestroy(Object::Pipeline, pipeline);
+		next.DestroyPipeline(device, pipeline, pAllocator);
+	}
+
+	VKAPI_ATTR VkResult VKAPI_CALL CreateSwapchainKHR(VkDevice device, const VkSwapchainCreateInfoKHR* pCreateInfo,
+		const VkAllocationCallbacks* pAllocator, VkSwapchainKHR* pSwapchain) {
+
+		VkResult result = next.CreateSwapchainKHR(device, pCreateInfo, pAllocator, pSwapchain);
+		if (result == VK_SUCCESS) {
+			recordCreate(Call::CreateSwapchain, pCreateInfo, *pSwapchain);
+			withWriter([&](Writer&) { capture.swapchainCreated = true; });
+		}
+		return result;
+	}
+
+	VKAPI_ATTR void VKAPI_CALL DestroySwapchainKHR(VkDevice device, VkSwapchainKHR swapchain, const VkAllocationCallbacks* pAllocator) {
+		recordDestroy(Object::Swapchain, swapchain);
+		next.DestroySwapchainKHR(device, swapchain, pAllocator);
+	}
+
+	// Only the call that fills in the images is traced, the replay creates images of its own in their place
+	VKAPI_ATTR VkResult VKAPI_CALL GetSwapchainImagesKHR(VkDevice device, VkSwapchainKHR swapchain, uint32_t* pSwapchainImageCount,
+		VkImage* pSwapchainImages) {
+
+		VkResult result = next.GetSwapchainImagesKHR(device, swapchain, pSwapchainImageCount, pSwapchainImages);
+		if (pSwapchainImages != nullptr && (result == VK_SUCCESS || result == VK_INCOMPLETE)) {
+			record(Call::GetSwapchainImages, [&](Writer& writer) {
+				writer.fields(swapchain, *pSwapchainImageCount);
+				writer.array(pSwapchainImages, *pSwapchainImageCount);
+			});
+		}
+		return result;
+	}
+
+	// Traced with the image the swap chain handed out, which the replay hands out in its turn
+	VKAPI_ATTR VkResult VKAPI_CALL AcquireNextImageKHR(VkDevice device, VkSwapchainKHR swapchain, uint64_t timeout, VkSemaphore semaphore,
+		VkFence fence, uint32_t* pImageIndex) {
+
+		VkResult result = next.AcquireNextImageKHR(device, swapchain, timeout, semaphore, fence, pImageIndex);
+		if (result == VK_SUCCESS || result == VK_SUBOPTIMAL_KHR) {
+			record(Call::AcquireNextImage, [&](Writer& writer) { writer.fields(swapchain, semaphore, fence, *pImageIndex); });
+		}
+		return result;
+	}
+
+	VKAPI_ATTR VkResult VKAPI_CALL QueuePresentKHR(VkQueue queue, const VkPresentInfoKHR* pPresentInfo) {
+		record(Call::QueuePresent, [&](Writer& writer) {
+			VkPresentInfoKHR info = *pPresentInfo;
+			writer.fields(queue, info.waitSemaphoreCount);
+			writer.array(info.pWaitSemaphores, info.waitSemaphoreCount);
+			writer.fields(info.swapchainCount);
+			writer.array(info.pSwapchains, info.swapchainCount);
+			writer.array(info.pImageIndices, info.swapchainCount);
+			endFrame(writer);
+		});
+		return next.QueuePresentKHR(queue, pPresentInfo);
+	}
+
+	VKAPI_ATTR VkResult VKAPI_CALL AllocateDescriptorSets(VkDevice device, const VkDescriptorSetAllocateInfo* pAllocateInfo,
+		VkDescriptorSet* pDescriptorSets) {
+
+		VkResult result = next.AllocateDescriptorSets(device, pAllocateInfo, pDescriptorSets);
+		if (result == VK_SUCCESS) {
+			record(Call::AllocateDescriptorSets, [&](Writer& writer) {
+				VkDescriptorSetAllocateInfo info = *pAllocateInfo;
+				writer.fields(info);
+				writer.array(pDescriptorSets, info.descriptorSetCount);
+			});
+		}
+		return result;
+	}
+
+	VKAPI_ATTR VkResult VKAPI_CALL FreeDescriptorSets(VkDevice device, VkDescriptorPool descriptorPool, uint32_t descriptorSetCount,
+		const VkDescriptorSet* pDescriptorSets) {
+
+		record(Call::FreeDescriptorSets, [&](Writer& writer) {
+			writer.fields(descriptorPool, descriptorSetCount);
+			writer.array(pDescriptorSets, descriptorSetCount);
+		});
+		return next.FreeDescriptorSets(device, descriptorPool, descriptorSetCount, pDescriptorSets);
+	}
+
+	VKAPI_ATTR void VKAPI_CALL UpdateDescriptorSets(VkDevice device, uint32_t descriptorWriteCount, const VkWriteDescriptorSet* pDescriptorWrites,
+		uint32_t descriptorCopyCount, const VkCopyDescriptorSet* pDescriptorCopies) {
+
+		record(Call::UpdateDescriptorSets, [&](Writer& writer) {
+			writer.fields(descriptorWriteCount);
+			writer.array(pDescriptorWrites, descriptorWriteCount);
+			writer.fields(descriptorCopyCount);
+			writer.array(pDescriptorCopies, descriptorCopyCount);
+		});
+		next.UpdateDescriptorSets(device, descriptorWriteCount, pDescriptorWrites, descriptorCopyCount, pDescriptorCopies);
+	}
+
+	VKAPI_ATTR VkResult VKAPI_CALL AllocateCommandBuffers(VkDevice device, const VkCommandBufferAllocateInfo* pAllocateInfo,
+		VkCommandBuffer* pCommandBuffers) {
+
+		VkResult result = next.AllocateCommandBuffers(device, pAllocateInfo, pCommandBuffers);
+		if (result == VK_SUCCESS) {
+			record(Call::AllocateCommandBuffers, [&](Writer& writer) {
+				VkCommandBufferAllocateInfo info = *pAllocateInfo;
+				writer.fields(info);
+				writer.array(pCommandBuffers, info.commandBufferCount);
+				for (uint32_t i = 0; i < info.commandBufferCount && info.level == VK_COMMAND_BUFFER_LEVEL_SECONDARY; i++) {
+					capture.secondaryCommandBuffers[pCommandBuffers[i]] = info.commandPool;
+				}
+			});
+		}
+		return result;
+	}
+
+	VKAPI_ATTR void VKAPI_CALL FreeCommandBuffers(VkDevice device, VkCommandPool commandPool, uint32_t commandBufferCount,
+		const VkCommandBuffer* pCommandBuffers) {
+
+		record(Call::FreeCommandBuffers, [&](Writer& writer) {
+			writer.fields(commandPool, commandBufferCount);
+			writer.array(pCommandBuffers, commandBufferCount);
+			for (uint32_t i = 0; i < commandBufferCount; i++) {
+				capture.secondaryCommandBuffers.erase(pCommandBuffers[i]);
+			}
+		});
+		next.FreeCommandBuffers(device, commandPool, commandBufferCount, pCommandBuffers);
+	}
+
+	VKAPI_ATTR VkResult VKAPI_CALL ResetCommandBuffer(VkCommandBuffer commandBuffer, VkCommandBufferResetFlags flags) {
+		record(Call::ResetCommandBuffer, [&](Writer& writer) { writer.fields(commandBuffer, flags); });
+		return next.ResetCommandBuffer(commandBuffer, flags);
+	}
+
+	VKAPI_ATTR VkResult VKAPI_CALL BeginCommandBuffer(VkCommandBuffer commandBuffer, const VkCommandBufferBeginInfo* pBeginInfo) {
+		record(Call::BeginCommandBuffer, [&](Writer& writer) {
+			VkCommandBufferBeginInfo info = *pBeginInfo;
+			if (capture.secondaryCommandBuffers.count(commandBuffer) == 0) {
+				info.pInheritanceInfo = nullptr;
+			}
+			writer.fields(commandBuffer, info);
+		});
+		return next.BeginCommandBuffer(commandBuffer, pBeginInfo);
+	}
+
+	VKAPI_ATTR VkResult VKAPI_CALL EndCommandBuffer(VkCommandBuffer commandBuffer) {
+		record(Call::EndCommandBuffer, [&](Writer& writer) { writer.fields(commandBuffer); });
+		return next.EndCommandBuffer(commandBuffer);
+	}
+
+	VKAPI_ATTR void VKAPI_CALL CmdBindPipeline(VkCommandBuffer commandBuffer, VkPipelineBindPoint pipelineBindPoint, VkPipeline pipeline) {
+		record(Call::CmdBindPipeline, [&](Writer& writer) { writer.fields(commandBuffer, pipelineBindPoint, pipeline); });
+		next.CmdBindPipeline(commandBuffer, pipelineBindPoint, pipeline);
+	}
+
+	VKAPI_ATTR void VKAPI_CALL CmdBindDescriptorSets(VkCommandBuffer commandBuffer, VkPipelineBindPoint pipelineBindPoint, VkPipelineLayout layout,
+		uint32_t firstSet, uint32_t descriptorSetCount, const VkDescriptorSet* pDescriptorSets, uint32_t dynamicOffsetCount,
+		const uint32_t* pDynamicOffsets) {
+
+		record(Call::CmdBindDescriptorSets, [&](Writer& writer) {
+			writer.fields(commandBuffer, pipelineBindPoint, layout, firstSet, descriptorSetCount);
+			writer.array(pDescriptorSets, descriptorSetCount);
+			writer.fields(dynamicOffsetCount);
+			writer.array(pDynamicOffsets, dynamicOffsetCount);
+		});
+		next.CmdBindDescriptorSets(commandBuffer, pipelineBindPoint, layout, firstSet, descriptorSetCount, pDescriptorSets,
+			dynamicOffsetCount, pDynamicOffsets);
+	}
+
+	VKAPI_ATTR void VKAPI_CALL CmdBindVertexBuffers(VkCommandBuffer commandBuffer, uint32_t firstBinding, uint32_t bindingCount,
+		const VkBuffer* pBuffers, const VkDeviceSize* pOffsets) {
+
+		record(Call::CmdBindVertexBuffers, [&](Writer& writer) {
+			writer.fields(commandBuffer, firstBinding, bindingCount);
+			writer.array(pBuffers, bindingCount);
+			writer.array(pOffsets, bindingCount);
+		});
+		next.CmdBindVertexBuffers(commandBuffer, firstBinding, bindingCount, pBuffers, pOffsets);
+	}
+
+	VKAPI_ATTR void VKAPI_CALL CmdBindIndexBuffer(VkCommandBuffer commandBuffer, VkBuffer buffer, VkDeviceSize offset, VkIndexType indexType) {
+		record(Call::CmdBindIndexBuffer, [&](Writer& writer) { writer.fields(commandBuffer, buffer, offset, indexType); });
+		next.CmdBindIndexBuffer(commandBuffer, buffer, offset, indexType);
+	}
+
+	VKAPI_ATTR void VKAPI_CALL CmdPushConstants(VkCommandBuffer commandBuffer, VkPipelineLayout layout, VkShaderStageFlags stageFlags,
+		uint32_t offset, uint32_t size, const void* pValues) {
+
+		record(Call::CmdPushConstants, [&](Writer& writer) {
+			writer.fields(commandBuffer, layout, stageFlags, offset, size);
+			writer.data(pValues, size);
+		});
+		next.CmdPushConstants(commandBuffer, layout, stageFlags, offset, size, pValues);
+	}
+
+	VKAPI_ATTR void VKAPI_CALL CmdSetViewport(VkCommandBuffer commandBuffer, uint32_t firstViewport, uint32_t viewportCount,
+		const VkViewport* pViewports) {
+
+		record(Call::CmdSetViewport, [&](Writer& writer) {
+			writer.fields(commandBuffer, firstViewport, viewportCount);
+			writer.array(pViewports, viewportCount);
+		});
+		next.CmdSetViewport(commandBuffer, firstViewport, viewportCount, pViewports);
+	}
+
+	VKAPI_ATTR void VKAPI_CALL CmdSetScissor(VkCommandBuffer commandBuffer, uint32_t firstScissor, uint32_t scissorCount,
+		const VkRect2D* pScissors) {
+
+		record(Call::CmdSetScissor, [&](Writer& writer) {
+			writer.fields(commandBuffer, firstScissor, scissorCount);
+			writer.array(pScissors, scissorCount);
+		});
+		next.CmdSetScissor(commandBuffer, firstScissor, scissorCount, pScissors);
+	}
+
+	VKAPI_ATTR void VKAPI_CALL CmdBeginRenderPass(VkCommandBuffer commandBuffer, const VkRenderPassBeginInfo* pRenderPassBegin,
+		VkSubpassContents contents) {
+
+		record(Call::CmdBeginRenderPass, [&](Writer& writer) {
+			VkRenderPassBeginInfo info = *pRenderPassBegin;
+			writer.fields(commandBuffer, info, contents);
+		});
+		next.CmdBeginRenderPass(commandBuffer, pRenderPassBegin, contents);
+	}
+
+	VKAPI_ATTR void VKAPI_CALL CmdEndRenderPass(VkCommandBuffer commandBuffer) {
+		record(Call::CmdEndRenderPass, [&](Writer& writer) { writer.fields(commandBuffer); });
+		next.CmdEndRenderPass(commandBuffer);
+	}
+
+	VKAPI_ATTR void VKAPI_CALL CmdDraw(VkCommandBuffer commandBuffer, uint32_t vertexCount, uint32_t instanceCount, uint32_t firstVertex,
+		uint32_t firstInstance) {
+
+		record(Call::CmdDraw, [&](Writer& writer) { writer.fields(commandBuffer, vertexCount, instanceCount, firstVertex, firstInstance); });
+		next.CmdDraw(commandBuffer, vertexCount, instanceCount, firstVertex, firstInstance);
+	}
+
+	VKAPI_ATTR void VKAPI_CALL CmdDrawIndexed(VkCommandBuffer commandBuffer, uint32_t indexCount, uint32_t instanceCount, uint32_t firstIndex,
+		int32_t vertexOffset, uint32_t firstInstance) {
+
+		record(Call::CmdDrawIndexed, [&](Writer& writer) {
+			writer.fields(commandBuffer, indexCount, instanceCount, firstIndex, vertexOffset, firstInstance);
+		});
+		next.CmdDrawIndexed(commandBuffer, indexCount, instanceCount, firstIndex, vertexOffset, firstInstance);
+	}
+
+	VKAPI_ATTR void VKAPI_CALL CmdDrawIndirect(VkCommandBuffer commandBuffer, VkBuffer buffer, VkDeviceSize offset, uint32_t drawCount,
+		uint32_t stride) {
+
+		record(Call::CmdDrawIndirect, [&](Writer& writer) { writer.fields(commandBuffer, buffer, offset, drawCount, stride); });
+		next.CmdDrawIndirect(commandBuffer, buffer, offset, drawCount, stride);
+	}
+
+	VKAPI_ATTR void VKAPI_CALL CmdDrawIndexedIndirect(VkCommandBuffer commandBuffer, VkBuffer buffer, VkDeviceSize offset, uint32_t drawCount,
+		uint32_t stride) {
+
+		record(Call::CmdDrawIndexedIndirect, [&](Writer& writer) { writer.fields(commandBuffer, buffer, offset, drawCount, stride); });
+		next.CmdDrawIndexedIndirect(commandBuffer, buffer, offset, drawCount, stride);
+	}
+
+	VKAPI_ATTR void VKAPI_CALL CmdDrawIndexedIndirectCountKHR(VkCommandBuffer commandBuffer, VkBuffer buffer, VkDeviceSize offset,
+		VkBuffer countBuffer, VkDeviceSize countBufferOffset, uint32_t maxDrawCount, uint32_t stride) {
+
+		record(Call::CmdDrawIndexedIndirectCount, [&](Writer& writer) {
+			writer.fields(commandBuffer, buffer, offset, countBuffer, countBufferOffset, maxDrawCount, stride);
+		});
+		next.CmdDrawIndexedIndirectCountKHR(commandBuffer, buffer, offset, countBuffer, countBufferOffset, maxDrawCount, stride);
+	}
+
+	VKAPI_ATTR void VKAPI_CALL CmdDispatch(VkCommandBuffer commandBuffer, uint32_t groupCountX, uint32_t groupCountY, uint32_t groupCountZ) {
+		record(Call::CmdDispatch, [&](Writer& writer) { writer.fields(commandBuffer, groupCountX, groupCountY, groupCountZ); });
+		next.CmdDispatch(commandBuffer, groupCountX, groupCountY, groupCountZ);
+	}
+
+	VKAPI_ATTR void VKAPI_CALL CmdDispatchIndirect(VkCommandBuffer commandBuffer, VkBuffer buffer, VkDeviceSize offset) {
+		record(Call::CmdDispatchIndirect, [&](Writer& writer) { writer.fields(commandBuffer, buffer, offset); });
+		next.CmdDispatchIndirect(commandBuffer, buffer, offset);
+	}
+
+	VKAPI_ATTR void VKAPI_CALL CmdPipelineBarrier(VkCommandBuffer commandBuffer, VkPipelineStageFlags srcStageMask, VkPipelineStageFlags dstStageMask,
+		VkDependencyFlags dependencyFlags, uint32_t memoryBarrierCount, const VkMemoryBarrier* pMemoryBarriers,
+		uint32_t bufferMemoryBarrierCount, const VkBufferMemoryBarrier* pBufferMemoryBarriers,
+		uint32_t imageMemoryBarrierCount, const VkImageMemoryBarrier* pImageMemoryBarriers) {
+
+		record(Call::CmdPipelineBarrier, [&](Writer& writer) {
+			writer.fields(commandBuffer, srcStageMask, dstStageMask, dependencyFlags, memoryBarrierCount);
+			writer.array(pMemoryBarriers, memoryBarrierCount);
+			writer.fields(bufferMemoryBarrierCount);
+			writer.array(pBufferMemoryBarriers, bufferMemoryBarrierCount);
+			writer.fields(imageMemoryBarrierCount);
+			writer.array(pImageMemoryBarriers, imageMemoryBarrierCount);
+		});
+		next.CmdPipelineBarrier(commandBuffer, srcStageMask, dstStageMask, dependencyFlags, memoryBarrierCount, pMemoryBarriers,
+			bufferMemoryBarrierCount, pBufferMemoryBarriers, imageMemoryBarrierCount, pImageMemoryBarriers);
+	}
+
+	VKAPI_ATTR void VKAPI_CALL CmdCopyBuffer(VkCommandBuffer commandBuffer, VkBuffer srcBuffer, VkBuffer dstBuffer, uint32_t regionCount,
+		const VkBufferCopy* pRegions) {
+
+		record(Call::CmdCopyBuffer, [&](Writer& writer) {
+			writer.fields(commandBuffer, srcBuffer, dstBuffer, regionCount);
+			writer.array(pRegions, regionCount);
+		});
+		next.CmdCopyBuffer(commandBuffer, srcBuffer, dstBuffer, regionCount, pRegions);
+	}
+
+	VKAPI_ATTR void VKAPI_CALL CmdCopyImage(VkCommandBuffer commandBuffer, VkImage srcImage, VkImageLayout srcImageLayout, VkImage dstImage,
+		VkImageLayout dstImageLayout, uint32_t regionCount, const VkImageCopy* pRegions) {
+
+		record(Call::CmdCopyImage, [&](Writer& writer) {
+			writer.fields(commandBuffer, srcImage, srcImageLayout, dstImage, dstImageLayout, regionCount);
+			writer.array(pRegions, regionCount);
+		});
+		next.CmdCopyImage(commandBuffer, srcImage, srcImageLayout, dstImage, dstImageLayout, regionCount, pRegions);
+	}
+
+	VKAPI_ATTR void VKAPI_CALL CmdBlitImage(VkCommandBuffer commandBuffer, VkImage srcImage, VkImageLayout srcImageLayout, VkImage dstImage,
+		VkImageLayout dstImageLayout, uint32_t regionCount, const VkImageBlit* pRegions, VkFilter filter) {
+
+		record(Call::CmdBlitImage, [&](Writer& writer) {
+			writer.fields(commandBuffer, srcImage, srcImageLayout, dstImage, dstImageLayout, regionCount);
+			writer.array(pRegions, regionCount);
+			writer.fields(filter);
+		});
+		next.CmdBlitImage(commandBuffer, srcImage, srcImageLayout, dstImage, dstImageLayout, regionCount, pRegions, filter);
+	}
+
+	VKAPI_ATTR void VKAPI_CALL CmdCopyBufferToImage(VkCommandBuffer commandBuffer, VkBuffer srcBuffer, VkImage dstImage,
+		VkImageLayout dstImageLayout, uint32_t regionCount, const VkBufferImageCopy* pRegions) {
+
+		record(Call::CmdCopyBufferToImage, [&](Writer& writer) {
+			writer.fields(commandBuffer, srcBuffer, dstImage, dstImageLayout, regionCount);
+			writer.array(pRegions, regionCount);
+		});
+		next.CmdCopyBufferToImage(commandBuffer, srcBuffer, dstImage, dstImageLayout, regionCount, pRegions);
+	}
+
+	VKAPI_ATTR void VKAPI_CALL CmdCopyImageToBuffer(VkCommandBuffer commandBuffer, VkImage srcImage, VkImageLayout srcImageLayout,
+		VkBuffer dstBuffer, uint32_t regionCount, const VkBufferImageCopy* pRegions) {
+
+		record(Call::CmdCopyImageToBuffer, [&](Writer& writer) {
+			writer.fields(commandBuffer, srcImage, srcImageLayout, dstBuffer, regionCount);
+			writer.array(pRegions, regionCount);
+		});
+		next.CmdCopyImageToBuffer(commandBuffer, srcImage, srcImageLayout, dstBuffer, regionCount, pRegions);
+	}
+
+	VKAPI_ATTR void VKAPI_CALL CmdFillBuffer(VkCommandBuffer commandBuffer, VkBuffer dstBuffer, VkDeviceSize dstOffset, VkDeviceSize size,
+		uint32_t data) {
+
+		record(Call::CmdFillBuffer, [&](Writer& writer) { writer.fields(commandBuffer, dstBuffer, dstOffset, size, data); });
+		next.CmdFillBuffer(commandBuffer, dstBuffer, dstOffset, size, data);
+	}
+
+	VKAPI_ATTR void VKAPI_CALL CmdUpdateBuffer(VkCommandBuffer commandBuffer, VkBuffer dstBuffer, VkDeviceSize dstOffset, VkDeviceSize dataSize,
+		const void* pData) {
+
+		record(Call::CmdUpdateBuffer, [&](Writer& writer) {
+			writer.fields(commandBuffer, dstBuffer, dstOffset, dataSize);
+			writer.data(pData, static_cast<size_t>(dataSize));
+		});
+		next.CmdUpdateBuffer(commandBuffer, dstBuffer, dstOffset, dataSize, pData);
+	}
+
+	VKAPI_ATTR void VKAPI_CALL CmdClearColorImage(VkCommandBuffer commandBuffer, VkImage image, VkImageLayout imageLayout,
+		const VkClearColorValue* pColor, uint32_t rangeCount, const VkImageSubresourceRange* pRanges) {
+
+		record(Call::CmdClearColorImage, [&](Writer& writer) {
+			writer.fields(commandBuffer, image, imageLayout);
+			writer.array(pColor, 1);
+			writer.fields(rangeCount);
+			writer.array(pRanges, rangeCount);
+		});
+		next.CmdClearColorImage(commandBuffer, image, imageLayout, pColor, rangeCount, pRanges);
+	}
+
+	VKAPI_ATTR void VKAPI_CALL CmdClearAttachments(VkCommandBuffer commandBuffer, uint32_t attachmentCount, const VkClearAttachment* pAttachments,
+		uint32_t rectCount, const VkClearRect* pRects) {
+
+		record(Call::CmdClearAttachments, [&](Writer& writer) {
+			writer.fields(commandBuffer, attachmentCount);
+			writer.array(pAttachments, attachmentCount);
+			writer.fields(rectCount);
+			writer.array(pRects, rectCount);
+		});
+		next.CmdClearAttachments(commandBuffer, attachmentCount, pAttachments, rectCount, pRects);
+	}
+
+	VKAPI_ATTR void VKAPI_CALL CmdResetQueryPool(VkCommandBuffer commandBuffer, VkQueryPool queryPool, uint32_t firstQuery, uint32_t queryCount) {
+		record(Call::CmdResetQueryPool, [&](Writer& writer) { writer.fields(commandBuffer, queryPool, firstQuery, queryCount); });
+		next.CmdResetQueryPool(commandBuffer, queryPool, firstQuery, queryCount);
+	}
+
+	VKAPI_ATTR void VKAPI_CALL CmdWriteTimestamp(VkCommandBuffer commandBuffer, VkPipelineStageFlagBits pipelineStage, VkQueryPool queryPool,
+		uint32_t query) {
+
+		record(Call::CmdWriteTimestamp, [&](Writer& writer) { writer.fields(commandBuffer, pipelineStage, queryPool, query); });
+		next.CmdWriteTimestamp(commandBuffer, pipelineStage, queryPool, query);
+	}
+
+	// Whatever the host wrote for the submission to read is written out ahead of it
+	VKAPI_ATTR VkResult VKAPI_CALL QueueSubmit(VkQueue queue, uint32_t submitCount, const VkSubmitInfo* pSubmits, VkFence fence) {
+		withWriter([&](Writer& writer) {
+			for (auto& allocation : capture.memory) {
+				if (allocation.second.mapped != nullptr && allocation.second.readByDevice) {
+					writeChanges(writer, allocation.first, allocation.second);
+				}
+			}
+
+			writer.call(Call::QueueSubmit);
+			writer.fields(queue, submitCount);
+			writer.array(pSubmits, submitCount);
+			writer.fields(fence);
+			if (!capture.swapchainCreated && fence != VK_NULL_HANDLE) {
+				endFrame(writer);
+			}
+		});
+		return next.QueueSubmit(queue, submitCount, pSubmits, fence);
+	}
+
+	VKAPI_ATTR VkResult VKAPI_CALL WaitForFences(VkDevice device, uint32_t fenceCount, const VkFence* pFences, VkBool32 waitAll, uint64_t timeout) {
+		VkResult result = next.WaitForFences(device, fenceCount, pFences, waitAll, timeout);
+		if (result == VK_SUCCESS) {
+			record(Call::WaitForFences, [&](Writer& writer) {
+				writer.fields(fenceCount);
+				writer.array(pFences, fenceCount);
+				writer.fields(waitAll);
+			});
+		}
+		return result;
+	}
+
+	VKAPI_ATTR VkResult VKAPI_CALL ResetFences(VkDevice device, uint32_t fenceCount, const VkFence* pFences) {
+		record(Call::ResetFences, [&](Writer& writer) {
+			writer.fields(fenceCount);
+			writer.array(pFences, fenceCount);
+		});
+		return next.ResetFences(device, fenceCount, pFences);
+	}
+
+	VKAPI_ATTR VkResult VKAPI_CALL GetFenceStatus(VkDevice device, VkFence fence) {
+		VkResult result = next.GetFenceStatus(device, fence);
+		if (result == VK_SUCCESS) {
+			record(Call::WaitForFences, [&](Writer& writer) {
+				uint32_t fenceCount = 1;
+				VkBool32 waitAll = VK_TRUE;
+				writer.fields(fenceCount, fence, waitAll);
+			});
+		}
+		return result;
+	}
+
+	PFN_vkVoidFunction findDeviceFunction(const char* name) {
+#define TRACE_FIND(function) \
+		if (strcmp(name, "vk" #function) == 0) { \
+			return reinterpret_cast<PFN_vkVoidFunction>(function); \
+		}
+		TRACE_DEVICE_FUNCTIONS(TRACE_FIND)
+#undef TRACE_FIND
+		return nullptr;
+	}
+
+	VKAPI_ATTR PFN_vkVoidFunction VKAPI_CALL GetDeviceProcAddr(VkDevice device, const char* pName);
+	VKAPI_ATTR PFN_vkVoidFunction VKAPI_CALL GetInstanceProcAddr(VkInstance instance, const char* pName);
+
+	// Starts tracing if VK_TRACE_FILE asks for it, with the instance's version and extensions
+	void startCapture(const VkInstanceCreateInfo* pCreateInfo) {
+		std::lock_guard<std::mutex> lock(capture.mutex);
+		capture.path = environment("VK_TRACE_FILE");
+		if (capture.path.empty()) {
+			return;
+		}
+		std::string frames = environment("VK_TRACE_FRAMES");
+		if (!frames.empty()) {
+			capture.frameLimit = std::max<uint64_t>(1, std::strtoull(frames.c_str(), nullptr, 10));
+		}
+
+		try {
+			capture.writer = std::make_unique<Writer>(capture.path);
+			capture.start = std::chrono::steady_clock::now();
+			uint32_t apiVersion = pCreateInfo->pApplicationInfo != nullptr ? pCreateInfo->pApplicationInfo->apiVersion : VK_API_VERSION_1_0;
+			capture.writer->call(Call::CreateInstance);
+			capture.writer->fields(apiVersion, pCreateInfo->enabledExtensionCount);
+			capture.writer->strings(pCreateInfo->ppEnabledExtensionNames, pCreateInfo->enabledExtensionCount);
+		} catch (const std::exception& e) {
+			std::cerr << "Trace not started: " << e.what() << std::endl;
+			capture.writer.reset();
+			return;
+		}
+		capture.tracing = true;
+		std::cerr << "Trace: writing " << capture.frameLimit << " frames to " << capture.path << std::endl;
+	}
+
+	VKAPI_ATTR VkResult VKAPI_CALL CreateInstance(const VkInstanceCreateInfo* pCreateInfo, const VkAllocationCallbacks* pAllocator,
+		VkInstance* pInstance) {
+
+		// The loader chains what the next layer down is, and moves the chain on for it
+		auto link = static_cast<const VkLayerInstanceCreateInfo*>(pCreateInfo->pNext);
+		while (link != nullptr && !(link->sType == VK_STRUCTURE_TYPE_LOADER_INSTANCE_CREATE_INFO && link->function == VK_LAYER_LINK_INFO)) {
+			link = static_cast<const VkLayerInstanceCreateInfo*>(link->pNext);
+		}
+		if (link == nullptr) {
+			return VK_ERROR_INITIALIZATION_FAILED;
+		}
+		PFN_vkGetInstanceProcAddr nextGetInstanceProcAddr = link->u.pLayerInfo->pfnNextGetInstanceProcAddr;
+		const_cast<VkLayerInstanceCreateInfo*>(link)->u.pLayerInfo = link->u.pLayerInfo->pNext;
+
+		auto createInstance = reinterpret_cast<PFN_vkCreateInstance>(nextGetInstanceProcAddr(VK_NULL_HANDLE, "vkCreateInstance"));
+		VkResult result = createInstance(pCreateInfo, pAllocator, pInstance);
+		if (result != VK_SUCCESS) {
+			return result;
+		}
+
+		instanceNext.instance = *pInstance;
+		instanceNext.GetInstanceProcAddr = nextGetInstanceProcAddr;
+		instanceNext.DestroyInstance = reinterpret_cast<PFN_vkDestroyInstance>(nextGetInstanceProcAddr(*pInstance, "vkDestroyInstance"));
+		instanceNext.GetPhysicalDeviceProperties = reinterpret_cast<PFN_vkGetPhysicalDeviceProperties>(
+			nextGetInstanceProcAddr(*pInstance, "vkGetPhysicalDeviceProperties"));
+		instanceNext.GetPhysicalDeviceMemoryProperties = reinterpret_cast<PFN_vkGetPhysicalDeviceMemoryProperties>(
+			nextGetInstanceProcAddr(*pInstance, "vkGetPhysicalDeviceMemoryProperties"));
+
+		startCapture(pCreateInfo);
+		return result;
+	}
+
+	VKAPI_ATTR void VKAPI_CALL DestroyInstance(VkInstance instance, const VkAllocationCallbacks* pAllocator) {
+		{
+			std::lock_guard<std::mutex> lock(capture.mutex);
+			if (capture.writer) {
+				finish("the instance was destroyed");
+			}
+		}
+		instanceNext.DestroyInstance(instance, pAllocator);
+	}
+
+	// Traced with the device it was created on, which the replay looks for first, and the memory types it has
+	VKAPI_ATTR VkResult VKAPI_CALL CreateDevice(VkPhysicalDevice physicalDevice, const VkDeviceCreateInfo* pCreateInfo,
+		const VkAllocationCallbacks* pAllocator, VkDevice* pDevice) {
+
+		auto link = static_cast<const VkLayerDeviceCreateInfo*>(pCreateInfo->pNext);
+		while (link != nullptr && !(link->sType == VK_STRUCTURE_TYPE_LOADER_DEVICE_CREATE_INFO && link->function == VK_LAYER_LINK_INFO)) {
+			link = static_cast<const VkLayerDeviceCreateInfo*>(link->pNext);
+		}
+		if (link == nullptr) {
+			return VK_ERROR_INITIALIZATION_FAILED;
+		}
+		PFN_vkGetInstanceProcAddr nextGetInstanceProcAddr = link->u.pLayerInfo->pfnNextGetInstanceProcAddr;
+		PFN_vkGetDeviceProcAddr nextGetDeviceProcAddr = link->u.pLayerInfo->pfnNextGetDeviceProcAddr;
+		const_cast<VkLayerDeviceCreateInfo*>(link)->u.pLayerInfo = link->u.pLayerInfo->pNext;
+
+		auto createDevice = reinterpret_cast<PFN_vkCreateDevice>(nextGetInstanceProcAddr(instanceNext.instance, "vkCreateDevice"));
+		VkResult result = createDevice(physicalDevice, pCreateInfo, pAllocator, pDevice);
+		if (result != VK_SUCCESS) {
+			return result;
+		}
+
+		next.GetDeviceProcAddr = nextGetDeviceProcAddr;
+#define TRACE_LOAD(name) next.name = reinterpret_cast<PFN_vk##name>(nextGetDeviceProcAddr(*pDevice, "vk" #name));
+		TRACE_DEVICE_FUNCTIONS(TRACE_LOAD)
+#undef TRACE_LOAD
+
+		VkPhysicalDeviceProperties properties = {};
+		instanceNext.GetPhysicalDeviceProperties(physicalDevice, &properties);
+		VkPhysicalDeviceMemoryProperties memoryProperties = {};
+		instanceNext.GetPhysicalDeviceMemoryProperties(physicalDevice, &memoryProperties);
+
+		record(Call::CreateDevice, [&](Writer& writer) {
+			capture.memoryTypes.clear();
+			for (uint32_t i = 0; i < memoryProperties.memoryTypeCount; i++) {
+				capture.memoryTypes.push_back(memoryProperties.memoryTypes[i].propertyFlags);
+			}
+
+			VkDeviceCreateInfo info = *pCreateInfo;
+			writer.fields(properties.vendorID, properties.deviceID);
+			writer.string(properties.deviceName);
+			writer.fields(info);
+			writer.handle(*pDevice);
+		});
+		return result;
+	}
+
+	VKAPI_ATTR PFN_vkVoidFunction VKAPI_CALL GetDeviceProcAddr(VkDevice device, const char* pName) {
+		if (strcmp(pName, "vkGetDeviceProcAddr") == 0) {
+			return reinterpret_cast<PFN_vkVoidFunction>(GetDeviceProcAddr);
+		}
+		// Only functions the device has, extensions it was not created with included, are handed out
+		PFN_vkVoidFunction theirs = next.GetDeviceProcAddr(device, pName);
+		PFN_vkVoidFunction ours = findDeviceFunction(pName);
+		return ours != nullptr && theirs != nullptr ? ours : theirs;
+	}
+
+	VKAPI_ATTR PFN_vkVoidFunction VKAPI_CALL GetInstanceProcAddr(VkInstance instance, const char* pName) {
+		if (strcmp(pName, "vkGetInstanceProcAddr") == 0) {
+			return reinterpret_cast<PFN_vkVoidFunction>(GetInstanceProcAddr);
+		}
+		if (strcmp(pName, "vkCreateInstance") == 0) {
+			return reinterpret_cast<PFN_vkVoidFunction>(CreateInstance);
+		}
+		if (strcmp(pName, "vkDestroyInstance") == 0) {
+			return reinterpret_cast<PFN_vkVoidFunction>(DestroyInstance);
+		}
+		if (strcmp(pName, "vkCreateDevice") == 0) {
+			return reinterpret_cast<PFN_vkVoidFunction>(CreateDevice);
+		}
+		if (strcmp(pName, "vkGetDeviceProcAddr") == 0) {
+			return reinterpret_cast<PFN_vkVoidFunction>(GetDeviceProcAddr);
+		}
+		if (instanceNext.GetInstanceProcAddr == nullptr) {
+			return nullptr;
+		}
+		PFN_vkVoidFunction theirs = instanceNext.GetInstanceProcAddr(instance, pName);
+		PFN_vkVoidFunction ours = findDeviceFunction(pName);
+		return ours != nullptr && theirs != nullptr ? ours : theirs;
+	}
+
+}
+
+// The loader finds the layer's functions through this, as layer interface version 2 has it
+extern "C" VK_LAYER_EXPORT VKAPI_ATTR VkResult VKAPI_CALL vkNegotiateLoaderLayerInterfaceVersion(VkNegotiateLayerInterface* pVersionStruct) {
+	if (pVersionStruct == nullptr || pVersionStruct->sType != LAYER_NEGOTIATE_INTERFACE_STRUCT || pVersionStruct->loaderLayerInterfaceVersion < 2) {
+		return VK_ERROR_INITIALIZATION_FAILED;
+	}
+	pVersionStruct->loaderLayerInterfaceVersion = 2;
+	pVersionStruct->pfnGetInstanceProcAddr = GetInstanceProcAddr;
+	pVersionStruct->pfnGetDeviceProcAddr = GetDeviceProcAddr;
+	pVersionStruct->pfnGetPhysicalDeviceProcAddr = nullptr;
+	return VK_SUCCESS;
+}
@@ -0,0 +1,946 @@
+#include "TraceReplay.h"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <thread>
+
+using trace::Call;
+using trace::Object;
+
+namespace {
+
+	double milliseconds(std::chrono::steady_clock::duration duration) {
+		return std::chrono::duration<double, std::milli>(duration).count();
+	}
+
+	// Instance extensions for surfaces are of no use to a replay that has none
+	bool isSurfaceExtension(const std::string& name) {
+		return name.find("surface") != std::string::npos;
+	}
+
+}
+
+TraceReplay::TraceReplay(const Config& replayConfig) :
+	config(replayConfig),
+	reader(replayConfig.path) {
+}
+
+TraceReplay::~TraceReplay() {
+	if (device != VK_NULL_HANDLE) {
+		vkDeviceWaitIdle(device);
+		for (auto& swapchain : swapchains) {
+			destroySwapchain(swapchain.second);
+		}
+		for (const auto& object : live) {
+			destroy(object.second);
+		}
+		vkDestroyDevice(device, nullptr);
+	}
+	if (instance != VK_NULL_HANDLE) {
+		vkDestroyInstance(instance, nullptr);
+	}
+}
+
+TraceReplay::Result TraceReplay::run() {
+	Result result;
+	replayStart = std::chrono::steady_clock::now();
+
+	Call call = Call::End;
+	while (reader.next(call)) {
+		execute(call, result);
+		result.calls++;
+	}
+	result.complete = reader.isComplete();
+
+	if (device != VK_NULL_HANDLE) {
+		vkDeviceWaitIdle(device);
+	}
+	return result;
+}
+
+void TraceReplay::createInstance() {
+	uint32_t apiVersion = VK_API_VERSION_1_0;
+	uint32_t tracedExtensionCount = 0;
+	reader.fields(apiVersion, tracedExtensionCount);
+	const char* const* tracedExtensions = nullptr;
+	reader.strings(tracedExtensions, tracedExtensionCount);
+
+	// Asking for more than the loader has fails, as the application itself checks for
+	auto enumerateInstanceVersion = reinterpret_cast<PFN_vkEnumerateInstanceVersion>(
+		vkGetInstanceProcAddr(nullptr, "vkEnumerateInstanceVersion"));
+	uint32_t loaderVersion = VK_API_VERSION_1_0;
+	if (enumerateInstanceVersion != nullptr) {
+		enumerateInstanceVersion(&loaderVersion);
+	}
+
+	uint32_t availableCount = 0;
+	vkEnumerateInstanceExtensionProperties(nullptr, &availableCount, nullptr);
+	std::vector<VkExtensionProperties> available(availableCount);
+	vkEnumerateInstanceExtensionProperties(nullptr, &availableCount, available.data());
+
+	std::vector<const char*> extensions;
+	for (uint32_t i = 0; i < tracedExtensionCount; i++) {
+		bool supported = std::any_of(available.begin(), available.end(), [&](const VkExtensionProperties& extension) {
+			return strcmp(extension.extensionName, tracedExtensions[i]) == 0;
+		});
+		if (supported && !isSurfaceExtension(tracedExtensions[i])) {
+			extensions.push_back(tracedExtensions[i]);
+		}
+	}
+
+	VkApplicationInfo appInfo = {};
+	appInfo.sType			   = VK_STRUCTURE_TYPE_APPLICATION_INFO;
+	appInfo.pApplicationName   = "vulkanReplay";
+	appInfo.applicationVersion = VK_MAKE_VERSION(1, 0, 0);
+	appInfo.apiVersion		   = std::min(apiVersion, loaderVersion);
+
+	VkInstanceCreateInfo createInfo = {};
+	createInfo.sType				   = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
+	createInfo.pApplicationInfo		   = &appInfo;
+	createInfo.enabledExtensionCount   = static_cast<uint32_t>(extensions.size());
+	createInfo.ppEnabledExtensionNames = extensions.data();
+	if (vkCreateInstance(&createInfo, nullptr, &instance) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create an instance for the replay");
+	}
+}
+
+void TraceReplay::createDevice() {
+	uint32_t vendorID = 0;
+	uint32_t deviceID = 0;
+	reader.fields(vendorID, deviceID);
+	const char* tracedName = nullptr;
+	reader.string(tracedName);
+	tracedDeviceName = tracedName;
+	VkDeviceCreateInfo createInfo = {};
+	reader.fields(createInfo);
+	uint64_t traced = reader.id();
+
+	uint32_t deviceCount = 0;
+	vkEnumeratePhysicalDevices(instance, &deviceCount, nullptr);
+	std::vector<VkPhysicalDevice> devices(deviceCount);
+	vkEnumeratePhysicalDevices(instance, &deviceCount, devices.data());
+
+	for (VkPhysicalDevice candidate : devices) {
+		VkPhysicalDeviceProperties properties;
+		vkGetPhysicalDeviceProperties(candidate, &properties);
+		bool matches = config.deviceName.empty() ?
+			properties.vendorID == vendorID && properties.deviceID == deviceID :
+			std::string(properties.deviceName).find(config.deviceName) != std::string::npos;
+		if (matches) {
+			physicalDevice = candidate;
+			break;
+		}
+	}
+	if (physicalDevice == VK_NULL_HANDLE) {
+		if (!config.deviceName.empty() || devices.empty()) {
+			throw std::runtime_error("Failed to find a device to replay on");
+		}
+		physicalDevice = devices[0];
+	}
+
+	VkPhysicalDeviceProperties properties;
+	vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+	deviceName = properties.deviceName;
+	vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memoryProperties);
+
+	// Swapchains are replayed as plain images, but the barriers traced still move them to and from
+	// VK_IMAGE_LAYOUT_PRESENT_SRC_KHR, which is only valid with VK_KHR_swapchain. A device without it can only
+	// be asked for the rest
+	bool swapchainSupported = vkutil::hasDeviceExtension(physicalDevice, VK_KHR_SWAPCHAIN_EXTENSION_NAME);
+	std::vector<const char*> extensions;
+	for (uint32_t i = 0; i < createInfo.enabledExtensionCount; i++) {
+		if (swapchainSupported || strcmp(createInfo.ppEnabledExtensionNames[i], VK_KHR_SWAPCHAIN_EXTENSION_NAME) != 0) {
+			extensions.push_back(createInfo.ppEnabledExtensionNames[i]);
+		}
+	}
+	createInfo.enabledExtensionCount = static_cast<uint32_t>(extensions.size());
+	createInfo.ppEnabledExtensionNames = extensions.data();
+
+	// Features and queue families are asked for as traced, which a different device may not have
+	if (vkCreateDevice(physicalDevice, &createInfo, nullptr, &device) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create the traced device on " + deviceName);
+	}
+	reader.bind(traced, device);
+
+	cmdDrawIndexedIndirectCount = reinterpret_cast<PFN_vkCmdDrawIndexedIndirectCountKHR>(
+		vkGetDeviceProcAddr(device, "vkCmdDrawIndexedIndirectCountKHR"));
+}
+
+template <typename Info, typename T, typename Create>
+void TraceReplay::create(Object type, Create vkCreate, const char* what) {
+	Info info = {};
+	reader.fields(info);
+	uint64_t traced = reader.id();
+
+	T object = VK_NULL_HANDLE;
+	if (vkCreate(device, &info, nullptr, &object) != VK_SUCCESS) {
+		throw std::runtime_error(std::string("Failed to replay creating ") + what);
+	}
+	created(type, traced, object);
+}
+
+uint32_t TraceReplay::findMemoryType(uint32_t tracedIndex, VkMemoryPropertyFlags properties) const {
+	if (tracedIndex < memoryProperties.memoryTypeCount &&
+		(memoryProperties.memoryTypes[tracedIndex].propertyFlags & properties) == properties) {
+		return tracedIndex;
+	}
+	for (uint32_t i = 0; i < memoryProperties.memoryTypeCount; i++) {
+		if ((memoryProperties.memoryTypes[i].propertyFlags & properties) == properties) {
+			return i;
+		}
+	}
+	throw std::runtime_error("Failed to find a memory type like the traced one");
+}
+
+void TraceReplay::destroy(uint64_t traced) {
+	auto object = live.find(traced);
+	if (object == live.end()) {
+		return;
+	}
+	destroy(object->second);
+	live.erase(object);
+	reader.unbind(traced);
+}
+
+void TraceReplay::destroy(const Live& object) {
+	switch (object.type) {
+	case Object::Memory: {
+		VkDeviceMemory memory = reinterpret_cast<VkDeviceMemory>(object.object);
+		allocations.erase(memory);
+		vkFreeMemory(device, memory, nullptr);
+		break;
+	}
+	case Object::Buffer:
+		vkDestroyBuffer(device, reinterpret_cast<VkBuffer>(object.object), nullptr);
+		break;
+	case Object::Image:
+		vkDestroyImage(device, reinterpret_cast<VkImage>(object.object), nullptr);
+		break;
+	case Object::ImageView:
+		vkDestroyImageView(device, reinterpret_cast<VkImageView>(object.object), nullptr);
+		break;
+	case Object::Sampler:
+		vkDestroySampler(device, reinterpret_cast<VkSampler>(object.object), nullptr);
+		break;
+	case Object::ShaderModule:
+		vkDestroyShaderModule(device, reinterpret_cast<VkShaderModule>(object.object), nullptr);
+		break;
+	case Object::PipelineLayout:
+		vkDestroyPipelineLayout(device, reinterpret_cast<VkPipelineLayout>(object.object), nullptr);
+		break;
+	case Object::DescriptorSetLayout:
+		vkDestroyDescriptorSetLayout(device, reinterpret_cast<VkDescriptorSetLayout>(object.object), nullptr);
+		break;
+	case Object::DescriptorPool:
+		vkDestroyDescriptorPool(device, reinterpret_cast<VkDescriptorPool>(object.object), nullptr);
+		break;
+	case Object::RenderPass:
+		vkDestroyRenderPass(device, reinterpret_cast<VkRenderPass>(object.object), nullptr);
+		break;
+	case Object::Framebuffer:
+		vkDestroyFramebuffer(device, reinterpret_cast<VkFramebuffer>(object.object), nullptr);
+		break;
+	case Object::QueryPool:
+		vkDestroyQueryPool(device, reinterpret_cast<VkQueryPool>(object.object), nullptr);
+		break;
+	case Object::Fence:
+		vkDestroyFence(device, reinterpret_cast<VkFence>(object.object), nullptr);
+		break;
+	case Object::Semaphore:
+		vkDestroySemaphore(device, reinterpret_cast<VkSemaphore>(object.object), nullptr);
+		break;
+	case Object::CommandPool:
+		vkDestroyCommandPool(device, reinterpret_cast<VkCommandPool>(object.object), nullptr);
+		break;
+	case Object::Pipeline:
+		vkDestroyPipeline(device, reinterpret_cast<VkPipeline>(object.object), nullptr);
+		break;
+	case Object::Swapchain: {
+		auto swapchain = swapchains.find(object.object);
+		if (swapchain != swapchains.end()) {
+			destroySwapchain(swapchain->second);
+			swapchains.erase(swapchain);
+		}
+		break;
+	}
+	}
+}
+
+void TraceReplay::destroySwapchain(Swapchain& swapchain) {
+	for (auto& image : swapchain.images) {
+		vkutil::destroyImage(device, image);
+	}
+	swapchain.images.clear();
+}
+
+void TraceReplay::signal(VkQueue queue, const std::vector<VkSemaphore>& waits, VkSemaphore semaphore, VkFence fence) {
+	std::vector<VkPipelineStageFlags> waitStages(waits.size(), VK_PIPELINE_STAGE_ALL_COMMANDS_BIT);
+
+	VkSubmitInfo submitInfo = {};
+	submitInfo.sType				= VK_STRUCTURE_TYPE_SUBMIT_INFO;
+	submitInfo.waitSemaphoreCount	= static_cast<uint32_t>(waits.size());
+	submitInfo.pWaitSemaphores		= waits.data();
+	submitInfo.pWaitDstStageMask	= waitStages.data();
+	submitInfo.signalSemaphoreCount = semaphore != VK_NULL_HANDLE ? 1 : 0;
+	submitInfo.pSignalSemaphores	= &semaphore;
+	if (vkQueueSubmit(queue, 1, &submitInfo, fence) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to submit in place of the swap chain");
+	}
+}
+
+void TraceReplay::execute(Call call, Result& result) {
+	switch (call) {
+	case Call::CreateInstance:
+		createInstance();
+		break;
+	case Call::CreateDevice:
+		createDevice();
+		break;
+	case Call::GetDeviceQueue: {
+		uint32_t family = 0;
+		uint32_t index = 0;
+		reader.fields(family, index);
+		uint64_t traced = reader.id();
+		VkQueue queue = VK_NULL_HANDLE;
+		vkGetDeviceQueue(device, family, index, &queue);
+		reader.bind(traced, queue);
+		if (acquireQueue == VK_NULL_HANDLE) {
+			acquireQueue = queue;
+		}
+		break;
+	}
+	case Call::DeviceWaitIdle:
+		vkDeviceWaitIdle(device);
+		break;
+	case Call::QueueWaitIdle: {
+		VkQueue queue = VK_NULL_HANDLE;
+		reader.fields(queue);
+		vkQueueWaitIdle(queue);
+		break;
+	}
+
+	case Call::AllocateMemory: {
+		VkMemoryAllocateInfo info = {};
+		VkMemoryPropertyFlags properties = 0;
+		reader.fields(info, properties);
+		uint64_t traced = reader.id();
+		info.memoryTypeIndex = findMemoryType(info.memoryTypeIndex, properties);
+
+		VkDeviceMemory memory = VK_NULL_HANDLE;
+		if (vkAllocateMemory(device, &info, nullptr, &memory) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to replay allocating memory");
+		}
+		Allocation& allocation = allocations[memory];
+		allocation.size = info.allocationSize;
+		allocation.coherent = (memoryProperties.memoryTypes[info.memoryTypeIndex].propertyFlags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT) != 0;
+		created(Object::Memory, traced, memory);
+		break;
+	}
+	case Call::WriteMemory: {
+		VkDeviceMemory memory = VK_NULL_HANDLE;
+		VkDeviceSize offset = 0;
+		VkDeviceSize size = 0;
+		reader.fields(memory, offset, size);
+		const uint8_t* data = reader.take(static_cast<size_t>(size));
+
+		Allocation& allocation = allocations.at(memory);
+		if (allocation.mapped == nullptr && vkMapMemory(device, memory, 0, VK_WHOLE_SIZE, 0, &allocation.mapped) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to map memory the trace writes to");
+		}
+		memcpy(static_cast<uint8_t*>(allocation.mapped) + offset, data, static_cast<size_t>(size));
+		if (!allocation.coherent) {
+			VkMappedMemoryRange range = {};
+			range.sType	 = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
+			range.memory = memory;
+			range.size	 = VK_WHOLE_SIZE;
+			vkFlushMappedMemoryRanges(device, 1, &range);
+		}
+		break;
+	}
+	case Call::BindBufferMemory: {
+		VkBuffer buffer = VK_NULL_HANDLE;
+		VkDeviceMemory memory = VK_NULL_HANDLE;
+		VkDeviceSize offset = 0;
+		reader.fields(buffer, memory, offset);
+		if (vkBindBufferMemory(device, buffer, memory, offset) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to replay binding buffer memory");
+		}
+		break;
+	}
+	case Call::BindImageMemory: {
+		VkImage image = VK_NULL_HANDLE;
+		VkDeviceMemory memory = VK_NULL_HANDLE;
+		VkDeviceSize offset = 0;
+		reader.fields(image, memory, offset);
+		if (vkBindImageMemory(device, image, memory, offset) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to replay binding image memory");
+		}
+		break;
+	}
+
+	case Call::CreateBuffer:
+		create<VkBufferCreateInfo, VkBuffer>(Object::Buffer, vkCreateBuffer, "a buffer");
+		break;
+	case Call::CreateImage:
+		create<VkImageCreateInfo, VkImage>(Object::Image, vkCreateImage, "an image");
+		break;
+	case Call::CreateImageView:
+		create<VkImageViewCreateInfo, VkImageView>(Object::ImageView, vkCreateImageView, "an image view");
+		break;
+	case Call::CreateSampler:
+		create<VkSamplerCreateInfo, VkSampler>(Object::Sampler, vkCreateSampler, "a sampler");
+		break;
+	case Call::CreateShaderModule:
+		create<VkShaderModuleCreateInfo, VkShaderModule>(Object::ShaderModule, vkCreateShaderModule, "a shader module");
+		break;
+	case Call::CreatePipelineLayout:
+		create<VkPipelineLayoutCreateInfo, VkPipelineLayout>(Object::PipelineLayout, vkCreatePipelineLayout, "a pipeline layout");
+		break;
+	case Call::CreateDescriptorSetLayout:
+		create<VkDescriptorSetLayoutCreateInfo, VkDescriptorSetLayout>(Object::DescriptorSetLayout, vkCreateDescriptorSetLayout,
+			"a descriptor set layout");
+		break;
+	case Call::CreateDescriptorPool:
+		create<VkDescriptorPoolCreateInfo, VkDescriptorPool>(Object::DescriptorPool, vkCreateDescriptorPool, "a descriptor pool");
+		break;
+	case Call::CreateRenderPass:
+		create<VkRenderPassCreateInfo, VkRenderPass>(Object::RenderPass, vkCreateRenderPass, "a render pass");
+		break;
+	case Call::CreateFramebuffer:
+		create<VkFramebufferCreateInfo, VkFramebuffer>(Object::Framebuffer, vkCreateFramebuffer, "a framebuffer");
+		break;
+	case Call::CreateQueryPool:
+		create<VkQueryPoolCreateInfo, VkQueryPool>(Object::QueryPool, vkCreateQueryPool, "a query pool");
+		break;
+	case Call::CreateFence:
+		create<VkFenceCreateInfo, VkFence>(Object::Fence, vkCreateFence, "a fence");
+		break;
+	case Call::CreateSemaphore:
+		create<VkSemaphoreCreateInfo, VkSemaphore>(Object::Semaphore, vkCreateSemaphore, "a semaphore");
+		break;
+	case Call::CreateCommandPool:
+		create<VkCommandPoolCreateInfo, VkCommandPool>(Object::CommandPool, vkCreateCommandPool, "a command pool");
+		break;
+	case Call::CreateGraphicsPipelines:
+	case Call::CreateComputePipelines: {
+		uint32_t count = 0;
+		reader.fields(count);
+		std::vector<VkPipeline> pipelines(count);
+		VkResult created = VK_SUCCESS;
+		if (call == Call::CreateGraphicsPipelines) {
+			const VkGraphicsPipelineCreateInfo* infos = nullptr;
+			reader.array(infos, count);
+			created = vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, count, infos, nullptr, pipelines.data());
+		} else {
+			const VkComputePipelineCreateInfo* infos = nullptr;
+			reader.array(infos, count);
+			created = vkCreateComputePipelines(device, VK_NULL_HANDLE, count, infos, nullptr, pipelines.data());
+		}
+		if (created != VK_SUCCESS) {
+			throw std::runtime_error("Failed to replay creating pipelines");
+		}
+		for (VkPipeline pipeline : pipelines) {
+			this->created(Object::Pipeline, reader.id(), pipeline);
+		}
+		break;
+	}
+	case Call::CreateSwapchain: {
+		VkSwapchainCreateInfoKHR info = {};
+		reader.fields(info);
+		info.pQueueFamilyIndices = nullptr;
+		uint64_t traced = reader.id();
+		swapchains[traced].info = info;
+		created(Object::Swapchain, traced, traced);
+		break;
+	}
+	case Call::GetSwapchainImages: {
+		uint64_t traced = reader.id();
+		uint32_t count = 0;
+		reader.fields(count);
+		Swapchain& swapchain = swapchains.at(traced);
+		for (uint32_t i = 0; i < count; i++) {
+			if (i == swapchain.images.size()) {
+				swapchain.images.push_back(vkutil::createImage(device, physicalDevice, swapchain.info.imageExtent, 1,
+					swapchain.info.imageFormat, swapchain.info.imageUsage, VK_IMAGE_ASPECT_COLOR_BIT));
+			}
+			reader.bind(reader.id(), swapchain.images[i].image);
+		}
+		break;
+	}
+	case Call::Destroy: {
+		Object type = Object::Memory;
+		reader.value(type);
+		destroy(reader.id());
+		break;
+	}
+
+	case Call::AllocateDescriptorSets: {
+		VkDescriptorSetAllocateInfo info = {};
+		reader.fields(info);
+		std::vector<VkDescriptorSet> sets(info.descriptorSetCount);
+		if (vkAllocateDescriptorSets(device, &info, sets.data()) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to replay allocating descriptor sets");
+		}
+		for (VkDescriptorSet set : sets) {
+			reader.bind(reader.id(), set);
+		}
+		break;
+	}
+	case Call::FreeDescriptorSets: {
+		VkDescriptorPool pool = VK_NULL_HANDLE;
+		uint32_t count = 0;
+		reader.fields(pool, count);
+		const VkDescriptorSet* sets = nullptr;
+		reader.array(sets, count);
+		vkFreeDescriptorSets(device, pool, count, sets);
+		break;
+	}
+	case Call::UpdateDescriptorSets: {
+		uint32_t writeCount = 0;
+		reader.fields(writeCount);
+		const VkWriteDescriptorSet* writes = nullptr;
+		reader.array(writes, writeCount);
+		uint32_t copyCount = 0;
+		reader.fields(copyCount);
+		const VkCopyDescriptorSet* copies = nullptr;
+		reader.array(copies, copyCount);
+		vkUpdateDescriptorSets(device, writeCount, writes, copyCount, copies);
+		break;
+	}
+
+	case Call::AllocateCommandBuffers: {
+		VkCommandBufferAllocateInfo info = {};
+		reader.fields(info);
+		std::vector<VkCommandBuffer> commandBuffers(info.commandBufferCount);
+		if (vkAllocateCommandBuffers(device, &info, commandBuffers.data()) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to replay allocating command buffers");
+		}
+		for (VkCommandBuffer commandBuffer : commandBuffers) {
+			reader.bind(reader.id(), commandBuffer);
+		}
+		break;
+	}
+	case Call::FreeCommandBuffers: {
+		VkCommandPool pool = VK_NULL_HANDLE;
+		uint32_t count = 0;
+		reader.fields(pool, count);
+		const VkCommandBuffer* commandBuffers = nullptr;
+		reader.array(commandBuffers, count);
+		vkFreeCommandBuffers(device, pool, count, commandBuffers);
+		break;
+	}
+	case Call::ResetCommandBuffer: {
+		VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+		VkCommandBufferResetFlags flags = 0;
+		reader.fields(commandBuffer, flags);
+		vkResetCommandBuffer(commandBuffer, flags);
+		break;
+	}
+	case Call::BeginCommandBuffer: {
+		VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+		VkCommandBufferBeginInfo info = {};
+		reader.fields(commandBuffer, info);
+		vkBeginCommandBuffer(commandBuffer, &info);
+		break;
+	}
+	case Call::EndCommandBuffer: {
+		VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+		reader.fields(commandBuffer);
+		vkEndCommandBuffer(commandBuffer);
+		break;
+	}
+
+	case Call::CmdBindPipeline: {
+		VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+		VkPipelineBindPoint bindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+		VkPipeline pipeline = VK_NULL_HANDLE;
+		reader.fields(commandBuffer, bindPoint, pipeline);
+		vkCmdBindPipeline(commandBuffer, bindPoint, pipeline);
+		break;
+	}
+	case Call::CmdBindDescriptorSets: {
+		VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+		VkPipelineBindPoint bindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+		VkPipelineLayout layout = VK_NULL_HANDLE;
+		uint32_t firstSet = 0;
+		uint32_t setCount = 0;
+		reader.fields(commandBuffer, bindPoint, layout, firstSet, setCount);
+		const VkDescriptorSet* sets = nullptr;
+		reader.array(sets, setCount);
+		uint32_t dynamicOffsetCount = 0;
+		reader.fields(dynamicOffsetCount);
+		const uint32_t* dynamicOffsets = nullptr;
+		reader.array(dynamicOffsets, dynamicOffsetCount);
+		vkCmdBindDescriptorSets(commandBuffer, bindPoint, layout, firstSet, setCount, sets, dynamicOffsetCount, dynamicOffsets);
+		break;
+	}
+	case Call::CmdBindVertexBuffers: {
+		VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+		uint32_t firstBinding = 0;
+		uint32_t bindingCount = 0;
+		reader.fields(commandBuffer, firstBinding, bindingCount);
+		const VkBuffer* buffers = nullptr;
+		reader.array(buffers, bindingCount);
+		const VkDeviceSize* offsets = nullptr;
+		reader.array(offsets, bindingCount);
+		vkCmdBindVertexBuffers(commandBuffer, firstBinding, bindingCount, buffers, offsets);
+		break;
+	}
+	case Call::CmdBindIndexBuffer: {
+		VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+		VkBuffer buffer = VK_NULL_HANDLE;
+		VkDeviceSize offset = 0;
+		VkIndexType indexType = VK_INDEX_TYPE_UINT32;
+		reader.fields(commandBuffer, buffer, offset, indexType);
+		vkCmdBindIndexBuffer(commandBuffer, buffer, offset, indexType);
+		break;
+	}
+	case Call::CmdPushConstants: {
+		VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+		VkPipelineLayout layout = VK_NULL_HANDLE;
+		VkShaderStageFlags stages = 0;
+		uint32_t offset = 0;
+		uint32_t size = 0;
+		reader.fields(commandBuffer, layout, stages, offset, size);
+		const void* values = nullptr;
+		reader.data(values, size);
+		vkCmdPushConstants(commandBuffer, layout, stages, offset, size, values);
+		break;
+	}
+	case Call::CmdSetViewport: {
+		VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+		uint32_t first = 0;
+		uint32_t count = 0;
+		reader.fields(commandBuffer, first, count);
+		const VkViewport* viewports = nullptr;
+		reader.array(viewports, count);
+		vkCmdSetViewport(commandBuffer, first, count, viewports);
+		break;
+	}
+	case Call::CmdSetScissor: {
+		VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+		uint32_t first = 0;
+		uint32_t count = 0;
+		reader.fields(commandBuffer, first, count);
+		const VkRect2D* scissors = nullptr;
+		reader.array(scissors, count);
+		vkCmdSetScissor(commandBuffer, first, count, scissors);
+		break;
+	}
+	case Call::CmdBeginRenderPass: {
+		VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+		VkRenderPassBeginInfo info = {};
+		VkSubpassContents contents = VK_SUBPASS_CONTENTS_INLINE;
+		reader.fields(commandBuffer, info, contents);
+		vkCmdBeginRenderPass(commandBuffer, &info, contents);
+		break;
+	}
+	case Call::CmdEndRenderPass: {
+		VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+		reader.fields(commandBuffer);
+		vkCmdEndRenderPass(commandBuffer);
+		break;
+	}
+	case Call::CmdDraw: {
+		VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+		uint32_t vertexCount = 0;
+		uint32_t instanceCount = 0;
+		uint32_t firstVertex = 0;
+		uint32_t firstInstance = 0;
+		reader.fields(commandBuffer, vertexCount, instanceCount, firstVertex, firstInstance);
+		vkCmdDraw(commandBuffer, vertexCount, instanceCount, firstVertex, firstInstance);
+		break;
+	}
+	case Call::CmdDrawIndexed: {
+		VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+		uint32_t indexCount = 0;
+		uint32_t instanceCount = 0;
+		uint32_t firstIndex = 0;
+		int32_t vertexOffset = 0;
+		uint32_t firstInstance = 0;
+		reader.fields(commandBuffer, indexCount, instanceCount, firstIndex, vertexOffset, firstInstance);
+		vkCmdDrawIndexed(commandBuffer, indexCount, instanceCount, firstIndex, vertexOffset, firstInstance);
+		break;
+	}
+	case Call::CmdDrawIndirect:
+	case Call::CmdDrawIndexedIndirect: {
+		VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+		VkBuffer buffer = VK_NULL_HANDLE;
+		VkDeviceSize offset = 0;
+		uint32_t drawCount = 0;
+		uint32_t stride = 0;
+		reader.fields(commandBuffer, buffer, offset, drawCount, stride);
+		if (call == Call::CmdDrawIndirect) {
+			vkCmdDrawIndirect(commandBuffer, buffer, offset, drawCount, stride);
+		} else {
+			vkCmdDrawIndexedIndirect(commandBuffer, buffer, offset, drawCount, stride);
+		}
+		break;
+	}
+	case Call::CmdDrawIndexedIndirectCount: {
+		VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+		VkBuffer buffer = VK_NULL_HANDLE;
+		VkDeviceSize offset = 0;
+		VkBuffer countBuffer = VK_NULL_HANDLE;
+		VkDeviceSize countOffset = 0;
+		uint32_t maxDrawCount = 0;
+		uint32_t stride = 0;
+		reader.fields(commandBuffer, buffer, offset, countBuffer, countOffset, maxDrawCount, stride);
+		cmdDrawIndexedIndirectCount(commandBuffer, buffer, offset, countBuffer, countOffset, maxDrawCount, stride);
+		break;
+	}
+	case Call::CmdDispatch: {
+		VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+		uint32_t x = 0;
+		uint32_t y = 0;
+		uint32_t z = 0;
+		reader.fields(commandBuffer, x, y, z);
+		vkCmdDispatch(commandBuffer, x, y, z);
+		break;
+	}
+	case Call::CmdDispatchIndirect: {
+		VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+		VkBuffer buffer = VK_NULL_HANDLE;
+		VkDeviceSize offset = 0;
+		reader.fields(commandBuffer, buffer, offset);
+		vkCmdDispatchIndirect(commandBuffer, buffer, offset);
+		break;
+	}
+	case Call::CmdPipelineBarrier: {
+		VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+		VkPipelineStageFlags srcStages = 0;
+		VkPipelineStageFlags dstStages = 0;
+		VkDependencyFlags dependencies = 0;
+		uint32_t memoryCount = 0;
+		reader.fields(commandBuffer, srcStages, dstStages, dependencies, memoryCount);
+		const VkMemoryBarrier* memoryBarriers = nullptr;
+		reader.array(memoryBarriers, memoryCount);
+		uint32_t bufferCount = 0;
+		reader.fields(bufferCount);
+		const VkBufferMemoryBarrier* bufferBarriers = nullptr;
+		reader.array(bufferBarriers, bufferCount);
+		uint32_t imageCount = 0;
+		reader.fields(imageCount);
+		const VkImageMemoryBarrier* imageBarriers = nullptr;
+		reader.array(imageBarriers, imageCount);
+		vkCmdPipelineBarrier(commandBuffer, srcStages, dstStages, dependencies, memoryCount, memoryBarriers,
+			bufferCount, bufferBarriers, imageCount, imageBarriers);
+		break;
+	}
+	case Call::CmdCopyBuffer: {
+		VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+		VkBuffer src = VK_NULL_HANDLE;
+		VkBuffer dst = VK_NULL_HANDLE;
+		uint32_t regionCount = 0;
+		reader.fields(commandBuffer, src, dst, regionCount);
+		const VkBufferCopy* regions = nullptr;
+		reader.array(regions, regionCount);
+		vkCmdCopyBuffer(commandBuffer, src, dst, regionCount, regions);
+		break;
+	}
+	case Call::CmdCopyImage: {
+		VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+		VkImage src = VK_NULL_HANDLE;
+		VkImageLayout srcLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		VkImage dst = VK_NULL_HANDLE;
+		VkImageLayout dstLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		uint32_t regionCount = 0;
+		reader.fields(commandBuffer, src, srcLayout, dst, dstLayout, regionCount);
+		const VkImageCopy* regions = nullptr;
+		reader.array(regions, regionCount);
+		vkCmdCopyImage(commandBuffer, src, srcLayout, dst, dstLayout, regionCount, regions);
+		break;
+	}
+	case Call::CmdBlitImage: {
+		VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+		VkImage src = VK_NULL_HANDLE;
+		VkImageLayout srcLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		VkImage dst = VK_NULL_HANDLE;
+		VkImageLayout dstLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		uint32_t regionCount = 0;
+		reader.fields(commandBuffer, src, srcLayout, dst, dstLayout, regionCount);
+		const VkImageBlit* regions = nullptr;
+		reader.array(regions, regionCount);
+		VkFilter filter = VK_FILTER_NEAREST;
+		reader.fields(filter);
+		vkCmdBlitImage(commandBuffer, src, srcLayout, dst, dstLayout, regionCount, regions, filter);
+		break;
+	}
+	case Call::CmdCopyBufferToImage: {
+		VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+		VkBuffer src = VK_NULL_HANDLE;
+		VkImage dst = VK_NULL_HANDLE;
+		VkImageLayout dstLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		uint32_t regionCount = 0;
+		reader.fields(commandBuffer, src, dst, dstLayout, regionCount);
+		const VkBufferImageCopy* regions = nullptr;
+		reader.array(regions, regionCount);
+		vkCmdCopyBufferToImage(commandBuffer, src, dst, dstLayout, regionCount, regions);
+		break;
+	}
+	case Call::CmdCopyImageToBuffer: {
+		VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+		VkImage src = VK_NULL_HANDLE;
+		VkImageLayout srcLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		VkBuffer dst = VK_NULL_HANDLE;
+		uint32_t regionCount = 0;
+		reader.fields(commandBuffer, src, srcLayout, dst, regionCount);
+		const VkBufferImageCopy* regions = nullptr;
+		reader.array(regions, regionCount);
+		vkCmdCopyImageToBuffer(commandBuffer, src, srcLayout, dst, regionCount, regions);
+		break;
+	}
+	case Call::CmdFillBuffer: {
+		VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+		VkBuffer buffer = VK_NULL_HANDLE;
+		VkDeviceSize offset = 0;
+		VkDeviceSize size = 0;
+		uint32_t data = 0;
+		reader.fields(commandBuffer, buffer, offset, size, data);
+		vkCmdFillBuffer(commandBuffer, buffer, offset, size, data);
+		break;
+	}
+	case Call::CmdUpdateBuffer: {
+		VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+		VkBuffer buffer = VK_NULL_HANDLE;
+		VkDeviceSize offset = 0;
+		VkDeviceSize size = 0;
+		reader.fields(commandBuffer, buffer, offset, size);
+		const void* data = nullptr;
+		reader.data(data, static_cast<size_t>(size));
+		vkCmdUpdateBuffer(commandBuffer, buffer, offset, size, data);
+		break;
+	}
+	case Call::CmdClearColorImage: {
+		VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+		VkImage image = VK_NULL_HANDLE;
+		VkImageLayout layout = VK_IMAGE_LAYOUT_UNDEFINED;
+		reader.fields(commandBuffer, image, layout);
+		const VkClearColorValue* color = nullptr;
+		reader.array(color, 1);
+		uint32_t rangeCount = 0;
+		reader.fields(rangeCount);
+		const VkImageSubresourceRange* ranges = nullptr;
+		reader.array(ranges, rangeCount);
+		vkCmdClearColorImage(commandBuffer, image, layout, color, rangeCount, ranges);
+		break;
+	}
+	case Call::CmdClearAttachments: {
+		VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+		uint32_t attachmentCount = 0;
+		reader.fields(commandBuffer, attachmentCount);
+		const VkClearAttachment* attachments = nullptr;
+		reader.array(attachments, attachmentCount);
+		uint32_t rectCount = 0;
+		reader.fields(rectCount);
+		const VkClearRect* rects = nullptr;
+		reader.array(rects, rectCount);
+		vkCmdClearAttachments(commandBuffer, attachmentCount, attachments, rectCount, rects);
+		break;
+	}
+	case Call::CmdResetQueryPool: {
+		VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+		VkQueryPool pool = VK_NULL_HANDLE;
+		uint32_t first = 0;
+		uint32_t count = 0;
+		reader.fields(commandBuffer, pool, first, count);
+		vkCmdResetQueryPool(commandBuffer, pool, first, count);
+		break;
+	}
+	case Call::CmdWriteTimestamp: {
+		VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+		VkPipelineStageFlagBits stage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+		VkQueryPool pool = VK_NULL_HANDLE;
+		uint32_t query = 0;
+		reader.fields(commandBuffer, stage, pool, query);
+		vkCmdWriteTimestamp(commandBuffer, stage, pool, query);
+		break;
+	}
+
+	case Call::QueueSubmit: {
+		VkQueue queue = VK_NULL_HANDLE;
+		uint32_t submitCount = 0;
+		reader.fields(queue, submitCount);
+		const VkSubmitInfo* submits = nullptr;
+		reader.array(submits, submitCount);
+		VkFence fence = VK_NULL_HANDLE;
+		reader.fields(fence);
+		if (vkQueueSubmit(queue, submitCount, submits, fence) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to replay a submission");
+		}
+		break;
+	}
+	case Call::WaitForFences: {
+		uint32_t count = 0;
+		reader.fields(count);
+		const VkFence* fences = nullptr;
+		reader.array(fences, count);
+		VkBool32 waitAll = VK_TRUE;
+		reader.fields(waitAll);
+		vkWaitForFences(device, count, fences, waitAll, UINT64_MAX);
+		break;
+	}
+	case Call::ResetFences: {
+		uint32_t count = 0;
+		reader.fields(count);
+		const VkFence* fences = nullptr;
+		reader.array(fences, count);
+		vkResetFences(device, count, fences);
+		break;
+	}
+	case Call::AcquireNextImage: {
+		// Every swap chain's images are always free, whichever was acquired
+		reader.id();
+		VkSemaphore semaphore = VK_NULL_HANDLE;
+		VkFence fence = VK_NULL_HANDLE;
+		uint32_t imageIndex = 0;
+		reader.fields(semaphore, fence, imageIndex);
+		if (semaphore != VK_NULL_HANDLE || fence != VK_NULL_HANDLE) {
+			signal(acquireQueue, {}, semaphore, fence);
+		}
+		break;
+	}
+	case Call::QueuePresent: {
+		VkQueue queue = VK_NULL_HANDLE;
+		uint32_t waitCount = 0;
+		reader.fields(queue, waitCount);
+		const VkSemaphore* waits = nullptr;
+		reader.array(waits, waitCount);
+		uint32_t swapchainCount = 0;
+		reader.fields(swapchainCount);
+		const VkSwapchainKHR* presented = nullptr;
+		reader.array(presented, swapchainCount);
+		const uint32_t* imageIndices = nullptr;
+		reader.array(imageIndices, swapchainCount);
+		if (waitCount > 0) {
+			signal(queue, std::vector<VkSemaphore>(waits, waits + waitCount), VK_NULL_HANDLE, VK_NULL_HANDLE);
+		}
+		break;
+	}
+	case Call::FrameEnd: {
+		uint64_t tracedTime = 0;
+		reader.value(tracedTime);
+		if (frames == 0) {
+			firstTracedFrameEnd = tracedTime;
+		} else if (config.paced && tracedTime > firstTracedFrameEnd) {
+			std::this_thread::sleep_until(firstFrameEnd + std::chrono::nanoseconds(tracedTime - firstTracedFrameEnd));
+		}
+
+		auto now = std::chrono::steady_clock::now();
+		if (frames == 0) {
+			result.setupMs = milliseconds(now - replayStart);
+			firstFrameEnd = now;
+		} else {
+			result.frameMs.push_back(milliseconds(now - lastFrameEnd));
+			result.tracedFrameMs.push_back(static_cast<double>(tracedTime - lastTracedFrameEnd) / 1e6);
+		}
+		lastFrameEnd = now;
+		lastTracedFrameEnd = tracedTime;
+		frames++;
+		break;
+	}
+	case Call::End:
+		break;
+	}
+}
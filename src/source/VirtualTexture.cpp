@@ -0,0 +1,567 @@
+#include "VirtualTexture.h"
+
+#include "Noise.h"
+#include "ShaderTypes.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+
+namespace {
+
+	const VkFormat TABLE_FORMAT = VK_FORMAT_R8G8B8A8_UINT;
+	const VkDeviceSize PAGE_BYTES = VirtualTexture::PAGE_SIZE * VirtualTexture::PAGE_SIZE * 4;
+
+	// Octaves of noise from cells up to the texel size. Finer ones would only alias, they contribute the
+	// mean they would average out to instead, so every level looks like the one below it filtered down
+	float fractalNoise(float u, float v, uint32_t cells, float texelSize, uint32_t seed) {
+		float sum = 0.0f;
+		float amplitude = 0.5f;
+		for (uint32_t octave = 0; octave < 16; octave++) {
+			if (cells * texelSize > 0.5f) {
+				return sum + amplitude;
+			}
+			sum += amplitude * noise::valueNoise(u, v, cells, seed + octave);
+			amplitude *= 0.5f;
+			cells *= 2;
+		}
+		return sum + amplitude;
+	}
+
+	float smoothstep(float edge0, float edge1, float x) {
+		float t = std::min(std::max((x - edge0) / (edge1 - edge0), 0.0f), 1.0f);
+		return t * t * (3.0f - 2.0f * t);
+	}
+
+	// Patches of grass, dirt and rock over the whole texture, with detail down to its finest texels
+	void terrainColor(float u, float v, float texelSize, uint8_t* out) {
+		const float grass[3] = { 0.30f, 0.45f, 0.16f };
+		const float dirt[3] = { 0.52f, 0.42f, 0.30f };
+		const float rock[3] = { 0.62f, 0.61f, 0.58f };
+
+		float height = fractalNoise(u, v, 6, texelSize, 11);
+		float detail = fractalNoise(u, v, 512, texelSize, 29);
+		float toDirt = smoothstep(0.45f, 0.55f, height);
+		float toRock = smoothstep(0.62f, 0.70f, height);
+
+		for (uint32_t c = 0; c < 3; c++) {
+			float color = grass[c] + (dirt[c] - grass[c]) * toDirt;
+			color += (rock[c] - color) * toRock;
+			color *= 0.6f + 0.8f * detail;
+			out[c] = static_cast<uint8_t>(std::min(std::max(color, 0.0f), 1.0f) * 255.0f + 0.5f);
+		}
+		out[3] = 255;
+	}
+
+	// Entries hold the cache page in red and green and the level of the page held there in blue
+	uint32_t packEntry(uint32_t slot, uint32_t cachePages, uint32_t mip) {
+		return (slot % cachePages) | ((slot / cachePages) << 8) | (mip << 16);
+	}
+
+	uint32_t pageMip(uint32_t page) { return page >> 24; }
+	uint32_t pageY(uint32_t page) { return (page >> 12) & 0xFFF; }
+	uint32_t pageX(uint32_t page) { return page & 0xFFF; }
+
+}
+
+VirtualTexture::VirtualTexture(VkDevice logicalDevice, VkPhysicalDevice physical, const Config& textureConfig) :
+	device(logicalDevice),
+	physicalDevice(physical),
+	config(textureConfig),
+	generateWorkers(textureConfig.generateThreads) {
+
+	if (config.pagesPerSide == 0 || config.pagesPerSide > MAX_PAGES || (config.pagesPerSide & (config.pagesPerSide - 1)) != 0) {
+		throw std::runtime_error("Virtual texture pages per side must be a power of two up to " + std::to_string(MAX_PAGES) + ".");
+	}
+	mipCount = static_cast<uint32_t>(std::log2(config.pagesPerSide)) + 1;
+
+	VkPhysicalDeviceProperties properties;
+	vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+	cachePages = static_cast<uint32_t>(std::sqrt(static_cast<double>(config.cacheBytes / PAGE_BYTES)));
+	cachePages = std::min({ cachePages, MAX_CACHE_PAGES, properties.limits.maxImageDimension2D / PAGE_SIZE });
+	// The root and at least one page of every level it falls back through
+	cachePages = std::max(cachePages, 4u);
+
+	uint32_t cacheSize = cachePages * PAGE_SIZE;
+	cache = vkutil::createImage(device, physicalDevice, { cacheSize, cacheSize }, 1, FORMAT,
+		VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT, VK_IMAGE_ASPECT_COLOR_BIT);
+	pageTable = vkutil::createImage(device, physicalDevice, { config.pagesPerSide, config.pagesPerSide }, mipCount, TABLE_FORMAT,
+		VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT, VK_IMAGE_ASPECT_COLOR_BIT);
+
+	staging = vkutil::createBuffer(device, physicalDevice, frameStagingBytes() * config.framesInFlight,
+		VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+
+	// Pages are sampled at a single level, the border keeps bilinear filtering inside them
+	VkSamplerCreateInfo samplerInfo = {};
+	samplerInfo.sType		 = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+	samplerInfo.magFilter	 = VK_FILTER_LINEAR;
+	samplerInfo.minFilter	 = VK_FILTER_LINEAR;
+	samplerInfo.mipmapMode	 = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+	samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+	samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+	samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+	samplerInfo.maxLod		 = 0.0f;
+
+	if (vkCreateSampler(device, &samplerInfo, nullptr, &cacheSampler) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create virtual texture cache sampler.");
+	}
+
+	// Integer formats cannot be filtered, the table is only ever fetched from
+	samplerInfo.magFilter = VK_FILTER_NEAREST;
+	samplerInfo.minFilter = VK_FILTER_NEAREST;
+	samplerInfo.maxLod	  = static_cast<float>(mipCount);
+
+	if (vkCreateSampler(device, &samplerInfo, nullptr, &tableSampler) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create virtual texture page table sampler.");
+	}
+
+	VkDescriptorSetLayoutBinding bindings[3] = {};
+	for (uint32_t i = 0; i < 3; i++) {
+		bindings[i].binding			= i;
+		bindings[i].descriptorType	= i < 2 ? VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER : VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		bindings[i].descriptorCount = 1;
+		bindings[i].stageFlags		= VK_SHADER_STAGE_FRAGMENT_BIT;
+	}
+
+	VkDescriptorSetLayoutCreateInfo layoutInfo = {};
+	layoutInfo.sType		= VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	layoutInfo.bindingCount = 3;
+	layoutInfo.pBindings	= bindings;
+
+	if (vkCreateDescriptorSetLayout(device, &layoutInfo, nullptr, &setLayout) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create virtual texture descriptor set layout.");
+	}
+
+	VkDescriptorPoolSize poolSizes[2] = {};
+	poolSizes[0].type			 = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	poolSizes[0].descriptorCount = 2 * config.framesInFlight;
+	poolSizes[1].type			 = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	poolSizes[1].descriptorCount = config.framesInFlight;
+
+	VkDescriptorPoolCreateInfo poolInfo = {};
+	poolInfo.sType		   = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+	poolInfo.poolSizeCount = 2;
+	poolInfo.pPoolSizes	   = poolSizes;
+	poolInfo.maxSets	   = config.framesInFlight;
+
+	if (vkCreateDescriptorPool(device, &poolInfo, nullptr, &descriptorPool) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create virtual texture descriptor pool.");
+	}
+
+	std::vector<VkDescriptorSetLayout> layouts(config.framesInFlight, setLayout);
+	descriptorSets.resize(config.framesInFlight);
+
+	VkDescriptorSetAllocateInfo allocInfo = {};
+	allocInfo.sType				 = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+	allocInfo.descriptorPool	 = descriptorPool;
+	allocInfo.descriptorSetCount = config.framesInFlight;
+	allocInfo.pSetLayouts		 = layouts.data();
+
+	if (vkAllocateDescriptorSets(device, &allocInfo, descriptorSets.data()) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to allocate virtual texture descriptor sets.");
+	}
+
+	slots.resize(cachePages * cachePages);
+	for (uint32_t i = static_cast<uint32_t>(slots.size()); i-- > 0;) {
+		freeSlots.push_back(i);
+	}
+
+	residency.resize(mipCount);
+	table.resize(mipCount);
+	dirty.resize(mipCount);
+	for (uint32_t mip = 0; mip < mipCount; mip++) {
+		residency[mip].assign(levelPages(mip) * levelPages(mip), NO_SLOT);
+		table[mip].assign(levelPages(mip) * levelPages(mip), 0);
+	}
+}
+
+bool VirtualTexture::isSupported(VkPhysicalDevice physicalDevice) {
+	VkPhysicalDeviceFeatures features;
+	vkGetPhysicalDeviceFeatures(physicalDevice, &features);
+
+	VkFormatProperties cacheProperties;
+	vkGetPhysicalDeviceFormatProperties(physicalDevice, FORMAT, &cacheProperties);
+	VkFormatProperties tableProperties;
+	vkGetPhysicalDeviceFormatProperties(physicalDevice, TABLE_FORMAT, &tableProperties);
+
+	VkFormatFeatureFlags cacheNeeded = VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+	return features.fragmentStoresAndAtomics &&
+		(cacheProperties.optimalTilingFeatures & cacheNeeded) == cacheNeeded &&
+		(tableProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT) != 0;
+}
+
+std::vector<uint8_t> VirtualTexture::generatePage(uint32_t page, uint32_t pagesPerSide) {
+	uint32_t mip = pageMip(page);
+	int32_t levelTexels = static_cast<int32_t>((pagesPerSide >> mip) * PAGE_CONTENT);
+	float texelSize = 1.0f / levelTexels;
+
+	std::vector<uint8_t> texels(static_cast<size_t>(PAGE_BYTES));
+	for (uint32_t y = 0; y < PAGE_SIZE; y++) {
+		for (uint32_t x = 0; x < PAGE_SIZE; x++) {
+			// The border continues into the neighbouring pages, and repeats the edge texels of the texture
+			int32_t levelX = static_cast<int32_t>(pageX(page) * PAGE_CONTENT + x) - static_cast<int32_t>(PAGE_BORDER);
+			int32_t levelY = static_cast<int32_t>(pageY(page) * PAGE_CONTENT + y) - static_cast<int32_t>(PAGE_BORDER);
+			levelX = std::min(std::max(levelX, 0), levelTexels - 1);
+			levelY = std::min(std::max(levelY, 0), levelTexels - 1);
+
+			terrainColor((levelX + 0.5f) * texelSize, (levelY + 0.5f) * texelSize, texelSize, &texels[(y * PAGE_SIZE + x) * 4]);
+		}
+	}
+	return texels;
+}
+
+void VirtualTexture::loadRoot(VkCommandPool commandPool, VkQueue queue) {
+	uint32_t root = pageId(mipCount - 1, 0, 0);
+	std::vector<uint8_t> texels = generatePage(root, config.pagesPerSide);
+	memcpy(staging.mapped, texels.data(), texels.size());
+
+	uint32_t slot = acquireSlot();
+	slots[slot].page = root;
+	slots[slot].lastUsed = UINT64_MAX;
+	setResidency(root, slot);
+
+	VkBufferImageCopy region = {};
+	region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	region.imageSubresource.layerCount = 1;
+	region.imageOffset				   = { static_cast<int32_t>(slot % cachePages * PAGE_SIZE), static_cast<int32_t>(slot / cachePages * PAGE_SIZE), 0 };
+	region.imageExtent				   = { PAGE_SIZE, PAGE_SIZE, 1 };
+	pageCopies.assign(1, region);
+
+	// The root covers everything, so this stages the whole table
+	stagePageTable(PAGE_BYTES);
+
+	VkCommandBuffer commandBuffer = vkutil::beginSingleTimeCommands(device, commandPool);
+	recordCopies(commandBuffer, true);
+	vkutil::endSingleTimeCommands(device, commandPool, queue, commandBuffer);
+	stats.residentPages = 1;
+}
+
+void VirtualTexture::resize(VkExtent2D screen) {
+	VkExtent2D tiles = { (screen.width + FEEDBACK_TILE - 1) / FEEDBACK_TILE, (screen.height + FEEDBACK_TILE - 1) / FEEDBACK_TILE };
+	if (tiles.width == feedbackExtent.width && tiles.height == feedbackExtent.height && !feedbackBuffers.empty()) {
+		return;
+	}
+
+	for (auto& buffer : feedbackBuffers) {
+		vkutil::destroyBuffer(device, buffer);
+	}
+	for (auto& buffer : readbackBuffers) {
+		vkutil::destroyBuffer(device, buffer);
+	}
+
+	feedbackExtent = tiles;
+	VkDeviceSize pagesSize = sizeof(uint32_t) * tiles.width * tiles.height;
+	feedbackBuffers.resize(config.framesInFlight);
+	readbackBuffers.resize(config.framesInFlight);
+
+	for (uint32_t frame = 0; frame < config.framesInFlight; frame++) {
+		feedbackBuffers[frame] = vkutil::createBuffer(device, physicalDevice, sizeof(VirtualTextureFeedback) + pagesSize,
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+		readbackBuffers[frame] = vkutil::createBuffer(device, physicalDevice, pagesSize,
+			VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+		// Nothing was asked for until a frame has written it
+		memset(readbackBuffers[frame].mapped, 0xFF, static_cast<size_t>(pagesSize));
+
+		VkDescriptorImageInfo imageInfos[2] = {};
+		imageInfos[0].sampler	  = cacheSampler;
+		imageInfos[0].imageView	  = cache.view;
+		imageInfos[0].imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		imageInfos[1].sampler	  = tableSampler;
+		imageInfos[1].imageView	  = pageTable.view;
+		imageInfos[1].imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+		VkDescriptorBufferInfo bufferInfo = {};
+		bufferInfo.buffer = feedbackBuffers[frame].buffer;
+		bufferInfo.offset = 0;
+		bufferInfo.range  = VK_WHOLE_SIZE;
+
+		VkWriteDescriptorSet writes[3] = {};
+		for (uint32_t i = 0; i < 3; i++) {
+			writes[i].sType			  = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+			writes[i].dstSet		  = descriptorSets[frame];
+			writes[i].dstBinding	  = i;
+			writes[i].descriptorCount = 1;
+		}
+		writes[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+		writes[0].pImageInfo	 = &imageInfos[0];
+		writes[1].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+		writes[1].pImageInfo	 = &imageInfos[1];
+		writes[2].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		writes[2].pBufferInfo	 = &bufferInfo;
+
+		vkUpdateDescriptorSets(device, 3, writes, 0, nullptr);
+	}
+}
+
+void VirtualTexture::update(uint32_t frame) {
+	currentFrame = frame;
+	frameNumber++;
+	pageCopies.clear();
+	tableCopies.clear();
+
+	// Pages the frame that last used this slot asked for. Ids from another page count are skipped
+	const uint32_t* feedback = static_cast<const uint32_t*>(readbackBuffers[frame].mapped);
+	size_t tileCount = static_cast<size_t>(feedbackExtent.width) * feedbackExtent.height;
+	requests.clear();
+	for (size_t i = 0; i < tileCount; i++) {
+		uint32_t page = feedback[i];
+		if (page != NO_PAGE && pageMip(page) < mipCount && pageX(page) < levelPages(pageMip(page)) && pageY(page) < levelPages(pageMip(page))) {
+			requests.push_back(page);
+		}
+	}
+	std::sort(requests.begin(), requests.end());
+	requests.erase(std::unique(requests.begin(), requests.end()), requests.end());
+
+	// Every page on the way up to the closest resident ancestor is wanted, so detail arrives a level at a time
+	// and the fallback is never far off
+	missing.clear();
+	stats.requestedPages = static_cast<uint32_t>(requests.size());
+	stats.missingPages = 0;
+	for (uint32_t page : requests) {
+		for (uint32_t mip = pageMip(page), x = pageX(page), y = pageY(page); ; mip++, x /= 2, y /= 2) {
+			uint32_t slot = residency[mip][y * levelPages(mip) + x];
+			if (slot != NO_SLOT) {
+				slots[slot].lastUsed = std::max(slots[slot].lastUsed, frameNumber);
+				break;
+			}
+			if (mip == pageMip(page)) {
+				stats.missingPages++;
+			}
+			missing.push_back(pageId(mip, x, y));
+		}
+	}
+	std::sort(missing.begin(), missing.end());
+	missing.erase(std::unique(missing.begin(), missing.end()), missing.end());
+	// Coarser pages first. They cover more of the screen and finer ones are only asked for once they are in
+	std::stable_sort(missing.begin(), missing.end(), [](uint32_t a, uint32_t b) { return pageMip(a) > pageMip(b); });
+
+	// Upload what finished generating, as far as this frame's staging goes
+	VkDeviceSize stagingBase = frameStagingBytes() * frame;
+	for (size_t i = 0; i < pending.size() && pageCopies.size() < config.uploadsPerFrame;) {
+		if (pending[i].texels.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+			i++;
+			continue;
+		}
+
+		uint32_t page = pending[i].page;
+		std::vector<uint8_t> texels = pending[i].texels.get();
+		pending[i] = std::move(pending.back());
+		pending.pop_back();
+
+		uint32_t slot = acquireSlot();
+		if (slot == NO_SLOT) {
+			stats.droppedPages++;
+			continue;
+		}
+
+		VkDeviceSize offset = stagingBase + pageCopies.size() * PAGE_BYTES;
+		memcpy(static_cast<char*>(staging.mapped) + offset, texels.data(), texels.size());
+
+		VkBufferImageCopy region = {};
+		region.bufferOffset				   = offset;
+		region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		region.imageSubresource.layerCount = 1;
+		region.imageOffset				   = { static_cast<int32_t>(slot % cachePages * PAGE_SIZE), static_cast<int32_t>(slot / cachePages * PAGE_SIZE), 0 };
+		region.imageExtent				   = { PAGE_SIZE, PAGE_SIZE, 1 };
+		pageCopies.push_back(region);
+
+		slots[slot].page = page;
+		slots[slot].lastUsed = frameNumber;
+		setResidency(page, slot);
+		stats.loadedPages++;
+	}
+
+	// Start generating the most wanted of what is still missing
+	for (uint32_t page : missing) {
+		if (pending.size() >= 2 * config.uploadsPerFrame) {
+			break;
+		}
+		bool alreadyPending = std::any_of(pending.begin(), pending.end(), [page](const PendingPage& p) { return p.page == page; });
+		if (!alreadyPending) {
+			uint32_t pagesPerSide = config.pagesPerSide;
+			pending.push_back({ page, generateWorkers.submit([page, pagesPerSide]() { return generatePage(page, pagesPerSide); }) });
+		}
+	}
+
+	stagePageTable(stagingBase + config.uploadsPerFrame * PAGE_BYTES);
+	stats.residentPages = static_cast<uint32_t>(slots.size() - freeSlots.size());
+	stats.pendingPages = static_cast<uint32_t>(pending.size());
+}
+
+void VirtualTexture::recordUploads(VkCommandBuffer commandBuffer) {
+	recordCopies(commandBuffer, false);
+}
+
+void VirtualTexture::recordFeedbackReset(VkCommandBuffer commandBuffer, uint32_t frame) {
+	// Stepping through the pixels of a tile by a number coprime to their count visits every one of them in turn
+	uint32_t sample = static_cast<uint32_t>((frameNumber * 23) % (FEEDBACK_TILE * FEEDBACK_TILE));
+
+	VirtualTextureFeedback header = {};
+	header.size		   = glm::uvec2(feedbackExtent.width, feedbackExtent.height);
+	header.samplePixel = glm::uvec2(sample % FEEDBACK_TILE, sample / FEEDBACK_TILE);
+
+	vkCmdUpdateBuffer(commandBuffer, feedbackBuffers[frame].buffer, 0, sizeof(header), &header);
+	vkCmdFillBuffer(commandBuffer, feedbackBuffers[frame].buffer, sizeof(header), VK_WHOLE_SIZE, NO_PAGE);
+}
+
+void VirtualTexture::recordFeedbackReadback(VkCommandBuffer commandBuffer, uint32_t frame) {
+	VkBufferCopy region = {};
+	region.srcOffset = sizeof(VirtualTextureFeedback);
+	region.size		 = readbackBuffers[frame].size;
+	vkCmdCopyBuffer(commandBuffer, feedbackBuffers[frame].buffer, readbackBuffers[frame].buffer, 1, &region);
+}
+
+void VirtualTexture::destroy() {
+	// Generation still running holds nothing of ours, but must finish before the pool goes
+	for (auto& page : pending) {
+		page.texels.wait();
+	}
+	pending.clear();
+
+	for (auto& buffer : feedbackBuffers) {
+		vkutil::destroyBuffer(device, buffer);
+	}
+	for (auto& buffer : readbackBuffers) {
+		vkutil::destroyBuffer(device, buffer);
+	}
+	feedbackBuffers.clear();
+	readbackBuffers.clear();
+	vkutil::destroyBuffer(device, staging);
+	vkutil::destroyImage(device, cache);
+	vkutil::destroyImage(device, pageTable);
+	vkDestroySampler(device, cacheSampler, nullptr);
+	vkDestroySampler(device, tableSampler, nullptr);
+	vkDestroyDescriptorPool(device, descriptorPool, nullptr);
+	vkDestroyDescriptorSetLayout(device, setLayout, nullptr);
+	cacheSampler = VK_NULL_HANDLE;
+	tableSampler = VK_NULL_HANDLE;
+	descriptorPool = VK_NULL_HANDLE;
+	setLayout = VK_NULL_HANDLE;
+}
+
+VkDeviceSize VirtualTexture::getCacheBytes() const {
+	return static_cast<VkDeviceSize>(cachePages) * cachePages * PAGE_BYTES;
+}
+
+VkDeviceSize VirtualTexture::getPageTableBytes() const {
+	VkDeviceSize entries = 0;
+	for (uint32_t mip = 0; mip < mipCount; mip++) {
+		entries += static_cast<VkDeviceSize>(levelPages(mip)) * levelPages(mip);
+	}
+	return entries * sizeof(uint32_t);
+}
+
+void VirtualTexture::resetCounters() {
+	stats.loadedPages = 0;
+	stats.evictedPages = 0;
+	stats.droppedPages = 0;
+}
+
+VkDeviceSize VirtualTexture::frameStagingBytes() const {
+	return config.uploadsPerFrame * PAGE_BYTES + getPageTableBytes();
+}
+
+uint32_t VirtualTexture::acquireSlot() {
+	if (!freeSlots.empty()) {
+		uint32_t slot = freeSlots.back();
+		freeSlots.pop_back();
+		return slot;
+	}
+
+	uint32_t oldest = NO_SLOT;
+	for (uint32_t i = 0; i < slots.size(); i++) {
+		if (slots[i].lastUsed < frameNumber && (oldest == NO_SLOT || slots[i].lastUsed < slots[oldest].lastUsed)) {
+			oldest = i;
+		}
+	}
+	if (oldest != NO_SLOT) {
+		setResidency(slots[oldest].page, NO_SLOT);
+		slots[oldest] = Slot();
+		stats.evictedPages++;
+	}
+	return oldest;
+}
+
+void VirtualTexture::setResidency(uint32_t page, uint32_t slot) {
+	uint32_t mip = pageMip(page);
+	uint32_t x = pageX(page);
+	uint32_t y = pageY(page);
+	residency[mip][y * levelPages(mip) + x] = slot;
+
+	// The page's own entry and every entry under it on finer levels
+	for (uint32_t level = 0; level <= mip; level++) {
+		uint32_t shift = mip - level;
+		Rect& rect = dirty[level];
+		Rect area = { x << shift, y << shift, (x + 1) << shift, (y + 1) << shift };
+		if (rect.x0 == rect.x1) {
+			rect = area;
+		} else {
+			rect.x0 = std::min(rect.x0, area.x0);
+			rect.y0 = std::min(rect.y0, area.y0);
+			rect.x1 = std::max(rect.x1, area.x1);
+			rect.y1 = std::max(rect.y1, area.y1);
+		}
+	}
+}
+
+void VirtualTexture::stagePageTable(VkDeviceSize stagingOffset) {
+	char* staged = static_cast<char*>(staging.mapped) + stagingOffset;
+	VkDeviceSize offset = stagingOffset;
+
+	for (uint32_t mip = mipCount; mip-- > 0;) {
+		Rect& rect = dirty[mip];
+		if (rect.x0 == rect.x1) {
+			continue;
+		}
+
+		uint32_t pages = levelPages(mip);
+		for (uint32_t y = rect.y0; y < rect.y1; y++) {
+			for (uint32_t x = rect.x0; x < rect.x1; x++) {
+				uint32_t slot = residency[mip][y * pages + x];
+				// The root is always resident, only finer levels fall back
+				uint32_t entry = slot != NO_SLOT ? packEntry(slot, cachePages, mip) : table[mip + 1][(y / 2) * (pages / 2) + x / 2];
+				table[mip][y * pages + x] = entry;
+			}
+			memcpy(staged, &table[mip][y * pages + rect.x0], sizeof(uint32_t) * (rect.x1 - rect.x0));
+			staged += sizeof(uint32_t) * (rect.x1 - rect.x0);
+		}
+
+		VkBufferImageCopy region = {};
+		region.bufferOffset				   = offset;
+		region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		region.imageSubresource.mipLevel   = mip;
+		region.imageSubresource.layerCount = 1;
+		region.imageOffset				   = { static_cast<int32_t>(rect.x0), static_cast<int32_t>(rect.y0), 0 };
+		region.imageExtent				   = { rect.x1 - rect.x0, rect.y1 - rect.y0, 1 };
+		tableCopies.push_back(region);
+
+		offset += sizeof(uint32_t) * (rect.x1 - rect.x0) * (rect.y1 - rect.y0);
+		rect = Rect();
+	}
+}
+
+void VirtualTexture::recordCopies(VkCommandBuffer commandBuffer, bool initial) {
+	// Frames still in flight may be sampling what gets overwritten, the barriers wait for them. The first
+	// upload has no earlier contents to keep
+	VkImageLayout oldLayout = initial ? VK_IMAGE_LAYOUT_UNDEFINED : VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+	VkPipelineStageFlags srcStage = initial ? VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT : VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+
+	auto copy = [&](const vkutil::Image& image, const std::vector<VkBufferImageCopy>& regions) {
+		if (regions.empty()) {
+			return;
+		}
+		vkutil::imageBarrier(commandBuffer, image.image, oldLayout, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+			srcStage, 0, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT);
+		vkCmdCopyBufferToImage(commandBuffer, staging.buffer, image.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+			static_cast<uint32_t>(regions.size()), regions.data());
+		vkutil::imageBarrier(commandBuffer, image.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+			VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT);
+	};
+
+	copy(cache, pageCopies);
+	copy(pageTable, tableCopies);
+	pageCopies.clear();
+	tableCopies.clear();
+}
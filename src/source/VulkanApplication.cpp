@@ -1,21 +1,83 @@
 
 #include "VulkanApplication.h"
 #include "configuration.h"
-#include "Util.h"
+#include "TextureBaker.h"
+
+#include <glm/gtc/constants.hpp>
 
 #include <stdexcept>
 #include <vector>
 #include <iostream>
 #include <set>
 #include <algorithm>
+#include <cstring>
+#include <cstdlib>
+#include <cmath>
+#include <chrono>
+#include <functional>
+#include <thread>
 
 // Ctrl+M, Ctrl+O Collapses all functions
 // Ctrl+M, Ctrl+L Expands all functions
 
+namespace {
+
+	// Timestamps written during a frame
+	enum Timestamp : uint32_t {
+		TIMESTAMP_FRAME_BEGIN = 0,
+		TIMESTAMP_SHADOWS,
+		TIMESTAMP_LIGHT_BINNING,
+		TIMESTAMP_EARLY_CULL,
+		TIMESTAMP_EARLY_DRAW,
+		TIMESTAMP_HIZ,
+		TIMESTAMP_LATE_CULL,
+		TIMESTAMP_LATE_DRAW,
+		TIMESTAMP_PARTICLE_SIM,
+		TIMESTAMP_PARTICLE_DRAW,
+		TIMESTAMP_EXPOSURE,
+		TIMESTAMP_BLOOM,
+		TIMESTAMP_TONEMAP,
+		// Around the light binning, on whichever queue it runs
+		TIMESTAMP_BINNING_BEGIN,
+		TIMESTAMP_BINNING_END,
+		TIMESTAMP_COUNT
+	};
+
+	// Bindings of the frame descriptor set, see scene.glsl and culling.glsl. The last one is the texture array
+	const uint32_t FRAME_BINDING_COUNT = 14;
+	const uint32_t TEXTURE_BINDING = 13;
+
+	// World units one repeat of a texture covers on the objects using it
+	const float TEXTURE_REPEAT = 2.0f;
+
+	// Swap chain formats that encode what is written to them, so the tonemap must not
+	bool isSrgbFormat(VkFormat format) {
+		return format == VK_FORMAT_B8G8R8A8_SRGB || format == VK_FORMAT_R8G8B8A8_SRGB || format == VK_FORMAT_A8B8G8R8_SRGB_PACK32;
+	}
+
+	// Built next to the application, see VkLayer_vulkangraphics_trace in CMakeLists.txt
+	const char* TRACE_LAYER_NAME = "VK_LAYER_VULKANGRAPHICS_trace";
+
+	// The trace layer is configured through the environment, which the loader and layer read at instance creation
+	void setEnvironment(const char* name, const std::string& value) {
+#ifdef _WIN32
+		_putenv_s(name, value.c_str());
+#else
+		setenv(name, value.c_str(), 1);
+#endif
+	}
+
+}
+
 /// * * * * * INITIALIZATION AND MAIN LOGIC * * * * * ///
 
+VulkanApplication::VulkanApplication(const AppSettings& appSettings) : settings(appSettings) {
+}
+
 void VulkanApplication::run() {
-	initWindow();
+	if (!settings.headless) {
+		initWindow();
+	}
 	initVulkan();
 
 	mainLoop();
@@ -33,79 +95,386 @@ void VulkanApplication::initWindow() {
 	window = glfwCreateWindow(windowWidth, windowHeight, "Vulkan", nullptr, nullptr);
 	glfwSetWindowUserPointer(window, this);
 	glfwSetFramebufferSizeCallback(window, framebufferResizeCallback);
+	glfwSetKeyCallback(window, keyCallback);
+	glfwSetMouseButtonCallback(window, mouseButtonCallback);
+	glfwSetCursorPosCallback(window, cursorPosCallback);
+
+	// The swap chain is sized from the input the renderer sampled, which starts out as the window is now
+	glfwGetFramebufferSize(window, &pendingInput.framebufferWidth, &pendingInput.framebufferHeight);
+	publishInput();
+	sampleInput();
 }
 
 void VulkanApplication::initVulkan() {
+	openAssets();
 	createInstance();
 	createSurface();
 	pickPhysicalDevice();
 	createLogicalDevice();
+	createTextureStreamer();
+	createVirtualTexture();
+	createLightClusters();
 	createSwapChain();
 	createImageViews();
+	createFrameCapture();
 	createRenderPass();
+	createDescriptorSetLayouts();
+	createShadowMaps();
+	createPostProcess();
+	createParticleSystem();
 	createGraphicsPipeline();
-	createFramebuffers();
+	createComputePipelines();
 	createCommandPool();
+	createHiZResources();
+	createSceneBuffers();
+	createCullingBuffers();
+	buildRenderGraph();
+	createDescriptorPool();
+	createDescriptorSets();
+	createQueryPools();
+	createDynamicResolution();
 	createCommandBuffers();
 	createSyncObjects();
+
+	if (settings.downsampleBenchmark) {
+		runDownsampleBenchmark();
+	}
+	if (settings.batchBenchmark) {
+		runBatchBenchmark();
+	}
+	if (settings.multiviewViews > 0) {
+		runMultiviewBenchmark();
+	}
+
+	std::cout << "Culling mode: " << settings::cullingModeName(settings.cullingMode) << " (press C to cycle)" << std::endl;
+	uint32_t samples = static_cast<uint32_t>(msaaSamples);
+	std::cout << "Multisampling: " << samples << "x" << (samples < settings.msaaSamples ? " (highest the device supports)" : "") << std::endl;
+	std::cout << "Levels of detail: " << (settings.lod ? "on" : "off") << ", " << settings.lodPixelError
+		<< " pixel error (press L to toggle)" << std::endl;
+	if (meshletsSupported) {
+		std::cout << "Meshlets: " << (settings.meshlets ? "on" : "off") << " (press M to toggle)"
+			<< (drawIndirectCountSupported ? "" : ", no draw count support") << std::endl;
+	} else {
+		std::cout << "Meshlets: not supported by this device" << std::endl;
+	}
+	if (hiZDownsampleTarget.levelCount > 0) {
+		std::cout << "Depth pyramid: " << hiZDownsampleTarget.levelCount << " levels in a single dispatch ("
+			<< (hiZDownsampler->usesSubgroups() ? "subgroup quads" : "shared memory") << ")" << std::endl;
+	} else {
+		std::cout << "Depth pyramid: a dispatch per level" << (!settings.singlePassHiZ ? "" : hiZDownsampler ?
+			", too many levels for a single one" : ", a single one is not supported by this device") << std::endl;
+	}
+	if (textureStreamer) {
+		std::cout << "Textures: " << textureStreamer->getTextureCount() << " x " << settings.textureSize << "^2 streamed against "
+			<< settings.textureBudgetMB << " MB" << (memoryBudgetSupported ? ", clamped to the heap budget" : "") << std::endl;
+		if (textureStreamer->isBaked()) {
+			std::cout << "Textures: baked as " << BakedTexture::formatName(textureStreamer->getFormat()) << std::endl;
+		} else {
+			std::cout << "Textures: generated (" << textureStreamer->getBakedFallbackReason() << ", run with --bake-textures)" << std::endl;
+		}
+	} else {
+		std::cout << "Textures: " << (settings.textures ? "not supported by this device" : "off") << std::endl;
+	}
+	std::cout << "Lighting: " << settings.lightCount << " point lights, " << (settings.lightBinning ? "clustered" : "brute force")
+		<< " (press B to toggle), " << LightClusters::GRID_X << "x" << LightClusters::GRID_Y << "x" << LightClusters::GRID_Z
+		<< " clusters holding " << lightClusters->getIndexCapacity() << " light indices" << std::endl;
+	if (computeQueue != VK_NULL_HANDLE) {
+		std::cout << "Async compute: " << (settings.asyncCompute ? "on" : "off") << ", light binning on queue family "
+			<< indices.computeFamily.value() << " (press A to toggle)" << std::endl;
+	} else {
+		std::cout << "Async compute: no dedicated compute queue on this device" << std::endl;
+	}
+	std::cout << "Shadows: " << ShadowMaps::CASCADE_COUNT << " cascades of " << shadowMaps->getCascadeSize() << "^2 in a "
+		<< shadowMaps->getAtlasBytes() / (1024 * 1024) << " MB atlas, static geometry of the last " << ShadowMaps::CACHED_CASCADES
+		<< " " << (settings.shadowCache ? "cached" : "not cached") << " in " << shadowMaps->getCacheBytes() / (1024 * 1024)
+		<< " MB (press S to toggle)" << std::endl;
+	std::cout << "Post processing: " << (settings.autoExposure ? "auto exposure" : "fixed exposure");
+	if (settings.autoExposure) {
+		std::cout << " (" << (postProcess->usesSubgroups() ? "subgroup" : "shared memory") << " reductions)";
+	}
+	if (settings.bloom) {
+		std::cout << ", bloom of " << postProcess->getBloomLevels() << " levels";
+	}
+	std::cout << ", tonemap writing " << (settings.headless ? "headless images" : directPostOutput ? "the swap chain" :
+		"an image blitted to the swap chain") << std::endl;
+	if (particleSystem) {
+		std::cout << "Particles: " << particleSystem->getCapacity() << " capacity in " << particleSystem->getBytes() / (1024 * 1024)
+			<< " MB, emitting " << particleSystem->getEmitRate() << " per second" << std::endl;
+	} else {
+		std::cout << "Particles: off" << std::endl;
+	}
+	if (dynamicResolution) {
+		std::cout << "Dynamic resolution: " << (settings.dynamicResolution ? "on" : "off") << ", " << settings.minRenderScale << " to "
+			<< settings.maxRenderScale << " of the screen for " << settings.targetFrameMs << " ms frames (press R to toggle)" << std::endl;
+	} else {
+		std::cout << "Dynamic resolution: " << (settings.dynamicResolution ? "no timestamp support" : "off") << std::endl;
+	}
+	if (!settings.headless) {
+		std::cout << "Render thread: " << (settings.renderThread ? "on" : "off, events polled between frames")
+			<< " (drag with the left mouse button to turn the camera)" << std::endl;
+	}
+	if (settings.headless) {
+		std::cout << "Headless: " << settings.frames << " frames of " << swapChainExtent.width << "x" << swapChainExtent.height << std::endl;
+	}
+	if (virtualTexture) {
+		std::cout << "Virtual texture: " << virtualTexture->getSize() << "^2 in " << virtualTexture->getMipCount() << " levels, "
+			<< virtualTexture->getCacheBytes() / (1024 * 1024) << " MB cache of " << virtualTexture->getCachePagesPerSide() << "^2 pages, "
+			<< virtualTexture->getPageTableBytes() / 1024 << " KB page table" << std::endl;
+	} else {
+		std::cout << "Virtual texture: " << (settings.virtualTexture ? "not supported by this device" : "off") << std::endl;
+	}
+	if (frameCapture) {
+		std::cout << "Capture: every frame into " << settings.captureDirectory << " as "
+			<< (settings.captureFormat == CaptureFormat::Png ? "png" : "raw rgba") << ", " << frameCapture->getConfig().ringSize
+			<< " readback buffers, encoded on " << frameCapture->getConfig().threads << " threads" << std::endl;
+	} else if (!settings.captureDirectory.empty()) {
+		std::cout << "Capture: the swap chain images cannot be copied from on this device" << std::endl;
+	}
 }
 
 void VulkanApplication::mainLoop() {
-	// Keep running until window closes or error
-	while (!glfwWindowShouldClose(window)) {
-		glfwPollEvents();
-		drawFrame();
+	auto start = std::chrono::steady_clock::now();
+
+	if (!settings.headless && settings.renderThread) {
+		// Events are passed on as soon as they come in, the render thread picks up the newest right before it
+		// records a frame. It wakes us with an empty event when it stops on its own
+		std::thread renderThread(&VulkanApplication::renderLoop, this);
+		while (running && !glfwWindowShouldClose(window)) {
+			glfwWaitEvents();
+			publishInput();
+		}
+		running = false;
+		renderThread.join();
+		if (renderError) {
+			std::rethrow_exception(renderError);
+		}
+	} else {
+		// Keep running until window closes, the frame count is reached or error
+		while (settings.headless || !glfwWindowShouldClose(window)) {
+			if (!settings.headless) {
+				glfwPollEvents();
+				publishInput();
+			}
+			drawFrame();
+			if (settings.frames > 0 && frameNumber >= settings.frames) {
+				break;
+			}
+		}
 	}
 
 	// Due to asynchronous work in logical device, we should wait until it is finished to start
 	// cleaning up
 	vkDeviceWaitIdle(logicalDevice);
+
+	if (frameCapture) {
+		frameCapture->flush();
+		const FrameCapture::Stats& captureStats = frameCapture->getStats();
+		std::cout << "Captured " << captureStats.written << " frames, " << captureStats.writtenBytes / (1024.0 * 1024.0) << " MB, "
+			<< captureStats.dropped << " dropped while every readback buffer was busy";
+		if (captureStats.written > 0) {
+			std::cout << ", " << captureStats.encodeMs / captureStats.written << " ms to encode and write each";
+		}
+		std::cout << std::endl;
+	}
+
+	if (settings.frames > 0) {
+		double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		std::cout << "Rendered " << frameNumber << " frames in " << seconds << " s, " << frameNumber / seconds << " frames per second" << std::endl;
+	}
+	if (inputLatency.samples > 0) {
+		// Compare against --render-thread=off, where events wait out the frame's fence before they are sampled
+		std::cout << "Input to submit latency: " << inputLatency.totalMs / inputLatency.samples << " ms average, " << inputLatency.maxMs
+			<< " ms worst over " << inputLatency.samples << " frames (render thread " << (settings.renderThread ? "on" : "off") << ")" << std::endl;
+	}
+}
+
+void VulkanApplication::renderLoop() {
+	try {
+		while (running) {
+			drawFrame();
+			if (settings.frames > 0 && frameNumber >= settings.frames) {
+				break;
+			}
+		}
+	} catch (...) {
+		renderError = std::current_exception();
+	}
+	running = false;
+	glfwPostEmptyEvent();
 }
 
 void VulkanApplication::cleanup() {
 	cleanupSwapChain();
+	if (!settings.headless) {
+		vkDestroySwapchainKHR(logicalDevice, swapChain, nullptr);
+	}
+
+	vkDestroyQueryPool(logicalDevice, queryPool, nullptr);
+	vkDestroyPipeline(logicalDevice, cullPipeline, nullptr);
+	vkDestroyPipeline(logicalDevice, clusterPipeline, nullptr);
+	vkDestroyPipelineLayout(logicalDevice, cullPipelineLayout, nullptr);
+	vkDestroyPipeline(logicalDevice, hiZPipeline, nullptr);
+	vkDestroyPipeline(logicalDevice, hiZMultisamplePipeline, nullptr);
+	vkDestroyPipelineLayout(logicalDevice, hiZPipelineLayout, nullptr);
+	vkDestroySampler(logicalDevice, hiZSampler, nullptr);
+	if (hiZDownsampler) {
+		hiZDownsampler->destroy();
+	}
+	if (textureStreamer) {
+		textureStreamer->destroy();
+	}
+	if (virtualTexture) {
+		virtualTexture->destroy();
+	}
+	lightClusters->destroy();
+	shadowMaps->destroy();
+	postProcess->destroy();
+	if (particleSystem) {
+		particleSystem->destroy();
+	}
+	if (frameCapture) {
+		frameCapture->destroy();
+	}
+	vkDestroyDescriptorSetLayout(logicalDevice, frameSetLayout, nullptr);
+	vkDestroyDescriptorSetLayout(logicalDevice, hiZSetLayout, nullptr);
+
+	vkutil::destroyBuffer(logicalDevice, vertexBuffer);
+	vkutil::destroyBuffer(logicalDevice, indexBuffer);
+	vkutil::destroyBuffer(logicalDevice, meshBuffer);
+	vkutil::destroyBuffer(logicalDevice, objectBuffer);
+	vkutil::destroyBuffer(logicalDevice, drawTemplateBuffer);
+	vkutil::destroyBuffer(logicalDevice, drawCommandBuffer);
+	vkutil::destroyBuffer(logicalDevice, visibleIdBuffer);
+	vkutil::destroyBuffer(logicalDevice, visibilityBuffer);
+	vkutil::destroyBuffer(logicalDevice, meshletBuffer);
+	vkutil::destroyBuffer(logicalDevice, clusterObjectBuffer);
+	vkutil::destroyBuffer(logicalDevice, clusterDrawBuffer);
+	vkutil::destroyBuffer(logicalDevice, clusterCountBuffer);
+	vkutil::destroyBuffer(logicalDevice, lodBuffer);
+	vkutil::destroyBuffer(logicalDevice, lodStateBuffer);
+	for (auto& buffer : cameraBuffers) {
+		vkutil::destroyBuffer(logicalDevice, buffer);
+	}
+	for (auto& buffer : statsBuffers) {
+		vkutil::destroyBuffer(logicalDevice, buffer);
+	}
+	for (auto& buffer : cpuCullBuffers) {
+		vkutil::destroyBuffer(logicalDevice, buffer);
+	}
 
 	for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
 		vkDestroySemaphore(logicalDevice, renderFinishedSemaphores[i], nullptr);
 		vkDestroySemaphore(logicalDevice, imageAvailableSemaphores[i], nullptr);
 		vkDestroyFence(logicalDevice, inFlightFences[i], nullptr);
 	}
+	for (VkSemaphore semaphore : computeFinishedSemaphores) {
+		vkDestroySemaphore(logicalDevice, semaphore, nullptr);
+	}
 	vkDestroyCommandPool(logicalDevice, commandPool, nullptr);
+	if (computeCommandPool != VK_NULL_HANDLE) {
+		vkDestroyCommandPool(logicalDevice, computeCommandPool, nullptr);
+	}
 	vkDestroyDevice(logicalDevice, nullptr);
-	vkDestroySurfaceKHR(instance, windowSurface, nullptr);
+	if (!settings.headless) {
+		vkDestroySurfaceKHR(instance, windowSurface, nullptr);
+	}
 	vkDestroyInstance(instance, nullptr);
-	glfwDestroyWindow(window);
-	glfwTerminate();
+	if (!settings.headless) {
+		glfwDestroyWindow(window);
+		glfwTerminate();
+	}
 }
 
 void VulkanApplication::drawFrame() {
 
 	vkWaitForFences(logicalDevice, 1, &inFlightFences[currentFrame], VK_TRUE, UINT64_MAX);
 
-	uint32_t imageIndex;
-	VkResult result = vkAcquireNextImageKHR(logicalDevice, swapChain, UINT64_MAX, imageAvailableSemaphores[currentFrame], VK_NULL_HANDLE, &imageIndex);
+	// This frame's previous submission is done, its queries and stats copies can be read
+	collectFrameStats(currentFrame);
+	updateRenderExtent(currentFrame);
+	// Its capture copy too, before the fence is reset for the next submission
+	if (frameCapture) {
+		frameCapture->poll();
+	}
 
-	if (result == VK_ERROR_OUT_OF_DATE_KHR) {
-		recreateSwapChain();
-		return;
-	} else if (result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR) {
-		throw std::runtime_error("Failed to acquire swap chain image.");
+	// Without a window every frame in flight has an image of its own, free once its fence is
+	uint32_t imageIndex = static_cast<uint32_t>(currentFrame);
+	if (!settings.headless) {
+		VkResult result = vkAcquireNextImageKHR(logicalDevice, swapChain, UINT64_MAX, imageAvailableSemaphores[currentFrame], VK_NULL_HANDLE, &imageIndex);
+
+		if (result == VK_ERROR_OUT_OF_DATE_KHR) {
+			recreateSwapChain();
+			return;
+		} else if (result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR) {
+			throw std::runtime_error("Failed to acquire swap chain image.");
+		}
+	}
+
+	// Input is sampled once nothing is left to wait on before recording, so the frame shows the newest there is
+	sampleInput();
+
+	// Other passes run in another culling mode. The descriptor sets point at the depth buffer the graph owns
+	if (renderGraphDirty) {
+		renderGraphDirty = false;
+		vkDeviceWaitIdle(logicalDevice);
+		buildRenderGraph();
+		vkDestroyDescriptorPool(logicalDevice, descriptorPool, nullptr);
+		createDescriptorPool();
+		createDescriptorSets();
+	}
+
+	double now = frameTime();
+	frameDelta = static_cast<float>(now - lastFrameTime);
+	lastFrameTime = now;
+
+	// Command buffers are recorded every frame as culling and camera state change
+	updateCamera(currentFrame);
+	vkResetCommandBuffer(commandBuffers[currentFrame], 0);
+	recordCommandBuffer(commandBuffers[currentFrame], imageIndex);
+
+	// The compute queue starts on the frame's light binning, and reads its counters back, while the graphics
+	// queue draws the shadows. Only the shading waits for it
+	bool asyncCompute = useAsyncCompute();
+	if (asyncCompute) {
+		vkResetCommandBuffer(computeCommandBuffers[currentFrame], 0);
+		recordAsyncCompute(computeCommandBuffers[currentFrame]);
+
+		VkSubmitInfo computeSubmitInfo = {};
+		computeSubmitInfo.sType				   = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+		computeSubmitInfo.commandBufferCount   = 1;
+		computeSubmitInfo.pCommandBuffers	   = &computeCommandBuffers[currentFrame];
+		computeSubmitInfo.signalSemaphoreCount = 1;
+		computeSubmitInfo.pSignalSemaphores	   = &computeFinishedSemaphores[currentFrame];
+
+		if (vkQueueSubmit(computeQueue, 1, &computeSubmitInfo, VK_NULL_HANDLE) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to submit compute command buffer.");
+		}
 	}
 
 	VkSubmitInfo submitInfo = {};
 	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
 
-	VkSemaphore waitSemaphores[]		= { imageAvailableSemaphores[currentFrame] };
-	VkPipelineStageFlags waitStages[]	= { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT };
-	submitInfo.waitSemaphoreCount		= 1;
-	submitInfo.pWaitSemaphores			= waitSemaphores;
-	submitInfo.pWaitDstStageMask		= waitStages;
+	// The swap chain image is first written by the post processing, only from there on does the frame wait
+	// for it. Without a window there is nothing to acquire or present
+	std::vector<VkSemaphore> waitSemaphores;
+	std::vector<VkPipelineStageFlags> waitStages;
+	if (!settings.headless) {
+		waitSemaphores.push_back(imageAvailableSemaphores[currentFrame]);
+		waitStages.push_back(backbufferStage);
+	}
+	if (asyncCompute) {
+		waitSemaphores.push_back(computeFinishedSemaphores[currentFrame]);
+		waitStages.push_back(VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+	}
+	submitInfo.waitSemaphoreCount		= static_cast<uint32_t>(waitSemaphores.size());
+	submitInfo.pWaitSemaphores			= waitSemaphores.data();
+	submitInfo.pWaitDstStageMask		= waitStages.data();
 
 	submitInfo.commandBufferCount = 1;
-	submitInfo.pCommandBuffers = &commandBuffers[imageIndex];
+	submitInfo.pCommandBuffers = &commandBuffers[currentFrame];
 
 	VkSemaphore signalSemaphores[] = { renderFinishedSemaphores[currentFrame] };
-	submitInfo.signalSemaphoreCount = 1;
+	submitInfo.signalSemaphoreCount = settings.headless ? 0 : 1;
 	submitInfo.pSignalSemaphores = signalSemaphores;
 
 	vkResetFences(logicalDevice, 1, &inFlightFences[currentFrame]);
@@ -113,6 +482,24 @@ void VulkanApplication::drawFrame() {
 	if (vkQueueSubmit(graphicsQueue, 1, &submitInfo, inFlightFences[currentFrame]) != VK_SUCCESS) {
 		throw std::runtime_error("Failed to submit draw command buffer.");
 	}
+	frameSubmitted[currentFrame] = true;
+	frameNumber++;
+
+	if (sampledEventTime >= 0.0) {
+		double latencyMs = (glfwGetTime() - sampledEventTime) * 1000.0;
+		sampledEventTime = -1.0;
+		frameStats.inputEvents++;
+		frameStats.inputLatencyMs += latencyMs;
+		frameStats.maxInputLatencyMs = std::max(frameStats.maxInputLatencyMs, latencyMs);
+		inputLatency.samples++;
+		inputLatency.totalMs += latencyMs;
+		inputLatency.maxMs = std::max(inputLatency.maxMs, latencyMs);
+	}
+
+	if (settings.headless) {
+		currentFrame = (currentFrame + 1) % MAX_FRAMES_IN_FLIGHT;
+		return;
+	}
 
 	VkPresentInfoKHR presentInfo = {};
 	presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
@@ -125,7 +512,7 @@ void VulkanApplication::drawFrame() {
 	presentInfo.pImageIndices = &imageIndex;
 	presentInfo.pResults = nullptr;
 
-	result = vkQueuePresentKHR(presentationQueue, &presentInfo);
+	VkResult result = vkQueuePresentKHR(presentationQueue, &presentInfo);
 
 	if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR || frameBufferResized) {
 		frameBufferResized = false;
@@ -137,13 +524,164 @@ void VulkanApplication::drawFrame() {
 	currentFrame = (currentFrame + 1) % MAX_FRAMES_IN_FLIGHT;
 }
 
+double VulkanApplication::frameTime() const {
+	return settings.headless ? frameNumber / 60.0 : glfwGetTime();
+}
+
 void VulkanApplication::framebufferResizeCallback(GLFWwindow* window, int width, int height) {
 	auto app = reinterpret_cast<VulkanApplication*>(glfwGetWindowUserPointer(window));
-	app->frameBufferResized = true;
+	app->pendingInput.framebufferWidth = width;
+	app->pendingInput.framebufferHeight = height;
+	app->pendingInput.resizes++;
+}
+
+void VulkanApplication::keyCallback(GLFWwindow* window, int key, int, int action, int) {
+	auto app = reinterpret_cast<VulkanApplication*>(glfwGetWindowUserPointer(window));
+	if (action != GLFW_PRESS) {
+		return;
+	}
+
+	// Keys only count presses here, the renderer acts on them once it samples them
+	static const int actionKeys[INPUT_ACTION_COUNT] = {
+		GLFW_KEY_C, GLFW_KEY_L, GLFW_KEY_M, GLFW_KEY_B, GLFW_KEY_A, GLFW_KEY_S, GLFW_KEY_R
+	};
+	for (uint32_t i = 0; i < INPUT_ACTION_COUNT; i++) {
+		if (key == actionKeys[i]) {
+			app->pendingInput.actions[i]++;
+			app->pendingInput.events++;
+			app->pendingInput.eventTime = glfwGetTime();
+		}
+	}
+}
+
+void VulkanApplication::mouseButtonCallback(GLFWwindow* window, int button, int action, int) {
+	auto app = reinterpret_cast<VulkanApplication*>(glfwGetWindowUserPointer(window));
+	if (button == GLFW_MOUSE_BUTTON_LEFT) {
+		app->dragging = action == GLFW_PRESS;
+		double y;
+		glfwGetCursorPos(window, &app->lastCursorX, &y);
+	}
+}
+
+void VulkanApplication::cursorPosCallback(GLFWwindow* window, double x, double) {
+	auto app = reinterpret_cast<VulkanApplication*>(glfwGetWindowUserPointer(window));
+	if (!app->dragging) {
+		return;
+	}
+
+	// A window's width of dragging turns the orbit half way round
+	int width;
+	int height;
+	glfwGetWindowSize(window, &width, &height);
+	app->pendingInput.orbitOffset += (x - app->lastCursorX) / std::max(width, 1) * glm::pi<double>();
+	app->pendingInput.events++;
+	app->pendingInput.eventTime = glfwGetTime();
+	app->lastCursorX = x;
+}
+
+void VulkanApplication::publishInput() {
+	inputBuffer.write() = pendingInput;
+	inputBuffer.publish();
+}
+
+void VulkanApplication::sampleInput() {
+	if (settings.headless || !inputBuffer.update()) {
+		return;
+	}
+
+	const InputState& latest = inputBuffer.read();
+	for (uint32_t i = 0; i < INPUT_ACTION_COUNT; i++) {
+		for (uint32_t presses = latest.actions[i] - input.actions[i]; presses > 0; presses--) {
+			applyAction(i);
+		}
+	}
+	if (latest.resizes != input.resizes) {
+		frameBufferResized = true;
+	}
+	if (latest.events != input.events) {
+		sampledEventTime = latest.eventTime;
+	}
+	input = latest;
+}
+
+void VulkanApplication::applyAction(uint32_t action) {
+	switch (action) {
+	case INPUT_CULLING_MODE: {
+		uint32_t next = (static_cast<uint32_t>(settings.cullingMode) + 1) % CULLING_MODE_COUNT;
+		settings.cullingMode = static_cast<CullingMode>(next);
+		renderGraphDirty = true;
+		std::cout << "Culling mode: " << settings::cullingModeName(settings.cullingMode) << std::endl;
+		break;
+	}
+	case INPUT_LOD:
+		settings.lod = !settings.lod;
+		std::cout << "Levels of detail: " << (settings.lod ? "on" : "off") << std::endl;
+		break;
+	case INPUT_MESHLETS:
+		settings.meshlets = !settings.meshlets;
+		renderGraphDirty = true;
+		std::cout << "Meshlets: " << (settings.meshlets ? "on" : "off") << std::endl;
+		break;
+	case INPUT_LIGHTING:
+		settings.lightBinning = !settings.lightBinning;
+		renderGraphDirty = true;
+		std::cout << "Lighting: " << (settings.lightBinning ? "clustered" : "brute force") << std::endl;
+		break;
+	case INPUT_ASYNC_COMPUTE:
+		if (computeQueue == VK_NULL_HANDLE) {
+			return;
+		}
+		settings.asyncCompute = !settings.asyncCompute;
+		renderGraphDirty = true;
+		std::cout << "Async compute: " << (settings.asyncCompute ? "on" : "off") << std::endl;
+		break;
+	case INPUT_SHADOW_CACHE:
+		settings.shadowCache = !settings.shadowCache;
+		shadowMaps->setCaching(settings.shadowCache);
+		renderGraphDirty = true;
+		std::cout << "Shadow cache: " << (settings.shadowCache ? "on" : "off") << std::endl;
+		break;
+	case INPUT_DYNAMIC_RESOLUTION:
+		if (!dynamicResolution) {
+			return;
+		}
+		settings.dynamicResolution = !settings.dynamicResolution;
+		std::cout << "Dynamic resolution: " << (settings.dynamicResolution ? "on" : "off") << std::endl;
+		break;
+	}
+	frameStats = FrameStats();
+}
+
+void VulkanApplication::waitForInput() {
+	if (settings.renderThread) {
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	} else {
+		glfwWaitEvents();
+		publishInput();
+		running = !glfwWindowShouldClose(window);
+	}
+	sampleInput();
 }
 
 /// * * * * * VULKAN HANDLE CREATION AND MANAGEMENT * * * * * ///
 
+void VulkanApplication::openAssets() {
+	assets = std::make_unique<AssetLoader>(VK_ROOT_DIR, threadPool);
+
+	std::string packPath = std::string(VK_ROOT_DIR) + AssetLoader::PACK_NAME;
+	if (!settings.assetPack) {
+		std::cout << "Assets: loose files" << std::endl;
+	} else if (!assets->openPack(packPath)) {
+		std::cout << "Assets: loose files (" << assets->getPackError() << ")" << std::endl;
+	} else {
+		std::cout << "Assets: " << packPath << " (" << assets->getPack()->getAssetCount() << " assets";
+		if (assets->getStaleCount() > 0) {
+			std::cout << ", " << assets->getStaleCount() << " older than their loose files and read from those";
+		}
+		std::cout << ")" << std::endl;
+	}
+}
+
 void VulkanApplication::createInstance() {
 
 	// Check if we are requesting any unsupported validation layers
@@ -158,26 +696,75 @@ void VulkanApplication::createInstance() {
 	appInfo.applicationVersion = VK_MAKE_VERSION(1, 0, 0);
 	appInfo.pEngineName = "No Engine";
 	appInfo.engineVersion = VK_MAKE_VERSION(1, 0, 0);
-	appInfo.apiVersion = VK_API_VERSION_1_0;
+	// Subgroup operations need Vulkan 1.1, asked for only where the loader has it. A 1.0 loader has no way to tell
+	auto enumerateInstanceVersion = reinterpret_cast<PFN_vkEnumerateInstanceVersion>(
+		vkGetInstanceProcAddr(nullptr, "vkEnumerateInstanceVersion"));
+	if (enumerateInstanceVersion != nullptr) {
+		uint32_t loaderVersion = VK_API_VERSION_1_0;
+		enumerateInstanceVersion(&loaderVersion);
+		instanceApiVersion = loaderVersion >= VK_API_VERSION_1_1 ? VK_API_VERSION_1_1 : VK_API_VERSION_1_0;
+	}
+	appInfo.apiVersion = instanceApiVersion;
 
 	// Following applies to entire program, not a specific device --> global
 	VkInstanceCreateInfo createInfo = {};
 	createInfo.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
 	createInfo.pApplicationInfo = &appInfo;
 
-	// Create extension interface to allow us to work glfw windows
+	// Create extension interface to allow us to work glfw windows. Headless runs have no window to present to
 	uint32_t glfwExtensionCount = 0;
-	const char** glfwExtensions;
-	glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
-	createInfo.enabledExtensionCount = glfwExtensionCount;
-	createInfo.ppEnabledExtensionNames = glfwExtensions;
+	const char** glfwExtensions = nullptr;
+	if (!settings.headless) {
+		glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
+	}
+	std::vector<const char*> enabledExtensions(glfwExtensions, glfwExtensions + glfwExtensionCount);
+
+	// The trace layer goes first so it sees the calls as the application makes them, before validation
+	std::vector<const char*> layers;
+	if (!settings.tracePath.empty()) {
+		setEnvironment("VK_TRACE_FILE", settings.tracePath);
+		setEnvironment("VK_TRACE_FRAMES", std::to_string(settings.traceFrames));
+
+		auto hasTraceLayer = []() {
+			uint32_t layerCount = 0;
+			vkEnumerateInstanceLayerProperties(&layerCount, nullptr);
+			std::vector<VkLayerProperties> availableLayers(layerCount);
+			vkEnumerateInstanceLayerProperties(&layerCount, availableLayers.data());
+			return std::any_of(availableLayers.begin(), availableLayers.end(), [](const VkLayerProperties& layer) {
+				return strcmp(layer.layerName, TRACE_LAYER_NAME) == 0;
+			});
+		};
+		auto prependPath = [](const char* name) {
+			const char* path = std::getenv(name);
+#ifdef _WIN32
+			const char separator = ';';
+#else
+			const char separator = ':';
+#endif
+			setEnvironment(name, path != nullptr && *path != '\0' ? std::string(VK_TRACE_LAYER_DIR) + separator + path : VK_TRACE_LAYER_DIR);
+		};
 
+		// VK_ADD_LAYER_PATH keeps the loader's own search paths, and with them the validation layers. Loaders
+		// older than it only take VK_LAYER_PATH, which replaces them
+		prependPath("VK_ADD_LAYER_PATH");
+		if (!hasTraceLayer()) {
+			prependPath("VK_LAYER_PATH");
+			if (!hasTraceLayer()) {
+				throw std::runtime_error(std::string("Failed to find the trace layer in ") + VK_TRACE_LAYER_DIR);
+			}
+			if (enableValidationLayers && !checkValidationSupport()) {
+				throw std::runtime_error("Failed to find the validation layers once VK_LAYER_PATH points at the trace layer. This "
+					"loader has no VK_ADD_LAYER_PATH, add the validation layers' directory to VK_LAYER_PATH or trace a release build");
+			}
+		}
+		layers.push_back(TRACE_LAYER_NAME);
+		std::cout << "Tracing " << settings.traceFrames << " frames into " << settings.tracePath << std::endl;
+	}
 	if (enableValidationLayers) {
-		createInfo.enabledLayerCount = static_cast<uint32_t>(validationLayers.size());
-		createInfo.ppEnabledLayerNames = validationLayers.data();
-	} else {
-		createInfo.enabledLayerCount = 0;
+		layers.insert(layers.end(), validationLayers.begin(), validationLayers.end());
 	}
+	createInfo.enabledLayerCount = static_cast<uint32_t>(layers.size());
+	createInfo.ppEnabledLayerNames = layers.data();
 
 	// Check for extension support
 	uint32_t extensionCount = 0;
@@ -222,10 +809,30 @@ void VulkanApplication::createInstance() {
 	}
 
 
+	// Extended feature and memory queries, for descriptor indexing and the memory budget
+	bool properties2Supported = false;
+	for (const auto& extension : extensions) {
+		if (strcmp(extension.extensionName, VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME) == 0) {
+			properties2Supported = true;
+			enabledExtensions.push_back(VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME);
+		}
+	}
+	createInfo.enabledExtensionCount = static_cast<uint32_t>(enabledExtensions.size());
+	createInfo.ppEnabledExtensionNames = enabledExtensions.data();
+
 	// Finally, create instance 
 	if (vkCreateInstance(&createInfo, nullptr, &instance) != VK_SUCCESS) {
 		throw std::runtime_error("failed to create vulkan instance!");
 	}
+
+	if (properties2Supported) {
+		getPhysicalDeviceFeatures2 = reinterpret_cast<PFN_vkGetPhysicalDeviceFeatures2KHR>(
+			vkGetInstanceProcAddr(instance, "vkGetPhysicalDeviceFeatures2KHR"));
+		getPhysicalDeviceMemoryProperties2 = reinterpret_cast<PFN_vkGetPhysicalDeviceMemoryProperties2KHR>(
+			vkGetInstanceProcAddr(instance, "vkGetPhysicalDeviceMemoryProperties2KHR"));
+		getPhysicalDeviceProperties2 = reinterpret_cast<PFN_vkGetPhysicalDeviceProperties2KHR>(
+			vkGetInstanceProcAddr(instance, "vkGetPhysicalDeviceProperties2KHR"));
+	}
 }
 
 void VulkanApplication::createLogicalDevice() {
@@ -233,6 +840,9 @@ void VulkanApplication::createLogicalDevice() {
 	// Create our queue families for our logical device
 	std::vector<VkDeviceQueueCreateInfo> queueCreateInfos;
 	std::set<uint32_t> uniqueQueueFamilies = { indices.graphicsFamily.value(), indices.presentFamily.value() };
+	if (indices.computeFamily.has_value()) {
+		uniqueQueueFamilies.insert(indices.computeFamily.value());
+	}
 	float queuePriority = 1.0f;
 
 	// Must create a different queue info per family
@@ -246,7 +856,94 @@ void VulkanApplication::createLogicalDevice() {
 	}
 
 	// What does this device support, which features?
+	VkPhysicalDeviceFeatures supportedFeatures;
+	vkGetPhysicalDeviceFeatures(physicalDevice, &supportedFeatures);
+
+	// Cluster culling issues one indirect draw per cluster with the object id in firstInstance
 	VkPhysicalDeviceFeatures deviceFeatures = {};
+	meshletsSupported = supportedFeatures.multiDrawIndirect && supportedFeatures.drawIndirectFirstInstance;
+	deviceFeatures.multiDrawIndirect		 = meshletsSupported;
+	deviceFeatures.drawIndirectFirstInstance = meshletsSupported;
+
+	// Lets the gpu stop at the number of clusters that were actually written
+	std::vector<const char*> enabledExtensions = requiredDeviceExtensions();
+	drawIndirectCountSupported = meshletsSupported && vkutil::hasDeviceExtension(physicalDevice, VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME);
+	if (drawIndirectCountSupported) {
+		enabledExtensions.push_back(VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME);
+	}
+
+	// Each instance of a draw samples its own texture out of one array, which takes non uniform indexing
+	VkPhysicalDeviceDescriptorIndexingFeaturesEXT indexingFeatures = {};
+	indexingFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT;
+	texturesSupported = false;
+	if (getPhysicalDeviceFeatures2 != nullptr &&
+		vkutil::hasDeviceExtension(physicalDevice, VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME) &&
+		vkutil::hasDeviceExtension(physicalDevice, VK_KHR_MAINTENANCE3_EXTENSION_NAME)) {
+
+		VkPhysicalDeviceFeatures2KHR features2 = {};
+		features2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2_KHR;
+		features2.pNext = &indexingFeatures;
+		getPhysicalDeviceFeatures2(physicalDevice, &features2);
+
+		texturesSupported = features2.features.shaderSampledImageArrayDynamicIndexing &&
+			indexingFeatures.shaderSampledImageArrayNonUniformIndexing && TextureStreamer::isSupported(physicalDevice);
+	}
+
+	VkPhysicalDeviceDescriptorIndexingFeaturesEXT enabledIndexing = {};
+	enabledIndexing.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT;
+	if (texturesSupported && settings.textures) {
+		deviceFeatures.shaderSampledImageArrayDynamicIndexing = VK_TRUE;
+		enabledIndexing.shaderSampledImageArrayNonUniformIndexing = VK_TRUE;
+		enabledExtensions.push_back(VK_KHR_MAINTENANCE3_EXTENSION_NAME);
+		enabledExtensions.push_back(VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME);
+
+		// Baked textures are block compressed, without this the streamer generates uncompressed ones
+		blockCompressionSupported = supportedFeatures.textureCompressionBC;
+		deviceFeatures.textureCompressionBC = supportedFeatures.textureCompressionBC;
+	}
+
+	// Levels of the depth pyramid are indexed out of one array of storage images when it is built in a single dispatch
+	downsamplerSupported = Downsampler::isSupported(physicalDevice, VK_FORMAT_R32_SFLOAT);
+	deviceFeatures.shaderStorageImageArrayDynamicIndexing = downsamplerSupported;
+	subgroupQuadSupported = instanceApiVersion >= VK_API_VERSION_1_1 &&
+		Downsampler::subgroupQuadSupported(physicalDevice, getPhysicalDeviceProperties2);
+
+	// The post processing reduces its histogram within subgroups, and stores to swap chain images of any format
+	postSubgroupsSupported = instanceApiVersion >= VK_API_VERSION_1_1 &&
+		PostProcess::subgroupsSupported(physicalDevice, getPhysicalDeviceProperties2);
+	storageWithoutFormatSupported = supportedFeatures.shaderStorageImageWriteWithoutFormat;
+	deviceFeatures.shaderStorageImageWriteWithoutFormat = storageWithoutFormatSupported;
+
+	// The virtual texture's feedback is written from the scene's fragment shader
+	virtualTextureSupported = VirtualTexture::isSupported(physicalDevice);
+	deviceFeatures.fragmentStoresAndAtomics = virtualTextureSupported && settings.virtualTexture;
+
+	// Lets the texture streamer see how much memory the rest of the system leaves us
+	memoryBudgetSupported = getPhysicalDeviceMemoryProperties2 != nullptr &&
+		vkutil::hasDeviceExtension(physicalDevice, VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+	if (memoryBudgetSupported) {
+		enabledExtensions.push_back(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+	}
+
+	// Broadcasting draws to many layers for the multiview benchmark, only enabled when it runs
+	multiviewSupported = settings.multiviewViews > 0 && MultiviewRenderer::isSupported(physicalDevice, getPhysicalDeviceFeatures2);
+	VkPhysicalDeviceMultiviewFeaturesKHR enabledMultiview = {};
+	enabledMultiview.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MULTIVIEW_FEATURES_KHR;
+	if (multiviewSupported) {
+		enabledMultiview.multiview = VK_TRUE;
+		enabledExtensions.push_back(VK_KHR_MULTIVIEW_EXTENSION_NAME);
+	}
+
+	// Extended features are chained in front of each other
+	void* featureChain = nullptr;
+	if (texturesSupported && settings.textures) {
+		enabledIndexing.pNext = featureChain;
+		featureChain = &enabledIndexing;
+	}
+	if (multiviewSupported) {
+		enabledMultiview.pNext = featureChain;
+		featureChain = &enabledMultiview;
+	}
 
 	// Set up logic device info using our queues and features struct
 	VkDeviceCreateInfo createInfo = {};
@@ -255,11 +952,12 @@ void VulkanApplication::createLogicalDevice() {
 	createInfo.queueCreateInfoCount = static_cast<uint32_t>(queueCreateInfos.size());
 	createInfo.pQueueCreateInfos = queueCreateInfos.data();
 	createInfo.pEnabledFeatures = &deviceFeatures;
+	createInfo.pNext = featureChain;
 
 	// Device specific setup. Device specific setup matters because diffferent devices support
 	// different features. EX. Compute gpu vs graphcis gpu. Compute doesn't have the feature for rendering
-	createInfo.enabledExtensionCount = static_cast<uint32_t>(deviceExtensions.size());
-	createInfo.ppEnabledExtensionNames = deviceExtensions.data();
+	createInfo.enabledExtensionCount = static_cast<uint32_t>(enabledExtensions.size());
+	createInfo.ppEnabledExtensionNames = enabledExtensions.data();
 
 	// New vulkan does not differentiate between global and device validation layers
 	// This is for older versions
@@ -280,9 +978,21 @@ void VulkanApplication::createLogicalDevice() {
 	// Create graphics and presentation queue handlers so we can interact with them
 	vkGetDeviceQueue(logicalDevice, indices.graphicsFamily.value(), 0, &graphicsQueue);
 	vkGetDeviceQueue(logicalDevice, indices.presentFamily.value(), 0, &presentationQueue);
+	if (indices.computeFamily.has_value()) {
+		vkGetDeviceQueue(logicalDevice, indices.computeFamily.value(), 0, &computeQueue);
+	}
+
+	if (drawIndirectCountSupported) {
+		cmdDrawIndexedIndirectCount = reinterpret_cast<PFN_vkCmdDrawIndexedIndirectCountKHR>(
+			vkGetDeviceProcAddr(logicalDevice, "vkCmdDrawIndexedIndirectCountKHR"));
+	}
 }
 
 void VulkanApplication::createSurface() {
+	if (settings.headless) {
+		return;
+	}
+
 	// Vulkan is platform agnostic so GLFW handles platform specific window creation for us
 	if (glfwCreateWindowSurface(instance, window, nullptr, &windowSurface) != VK_SUCCESS) {
 		throw std::runtime_error("Failed to create window surface with glfw/vulkan");
@@ -290,6 +1000,21 @@ void VulkanApplication::createSurface() {
 }
 
 void VulkanApplication::createSwapChain() {
+	// Headless frames are written to images of our own, which the post processing can always store to
+	if (settings.headless) {
+		swapChainExtent = { settings.headlessWidth, settings.headlessHeight };
+		swapChainImageFormat = PostProcess::OUTPUT_FORMAT;
+		directPostOutput = true;
+		captureSupported = !settings.captureDirectory.empty();
+		swapChainImages.clear();
+		for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+			headlessImages.push_back(vkutil::createImage(logicalDevice, physicalDevice, swapChainExtent, 1, swapChainImageFormat,
+				VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT, VK_IMAGE_ASPECT_COLOR_BIT));
+			swapChainImages.push_back(headlessImages.back().image);
+		}
+		return;
+	}
+
 	// With the gpu we have picked, query its swapchain support
 	SwapChainSupportDetails swapChainSupport = querySwapChainSupport(physicalDevice);
 
@@ -314,8 +1039,20 @@ void VulkanApplication::createSwapChain() {
 	createInfo.imageExtent      = swapChainExtent;
 	// number of layers per image (1 unless stereo)
 	createInfo.imageArrayLayers = 1; 
-	// We plan on rendering to this swap chain, would use different setting for post-processing
-	createInfo.imageUsage       = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT; 
+	// The scene is drawn elsewhere, only the post processing's tonemap writes this swap chain. It stores to the
+	// image directly where the surface, format and shader allow, or has its result blitted into it
+	VkFormatProperties formatProperties;
+	vkGetPhysicalDeviceFormatProperties(physicalDevice, swapChainImageFormat, &formatProperties);
+	directPostOutput = (swapChainSupport.capabilities.supportedUsageFlags & VK_IMAGE_USAGE_STORAGE_BIT) &&
+		(formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_STORAGE_IMAGE_BIT) &&
+		(storageWithoutFormatSupported || swapChainImageFormat == PostProcess::OUTPUT_FORMAT);
+	createInfo.imageUsage       = directPostOutput ? VK_IMAGE_USAGE_STORAGE_BIT : VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+	// Captured frames are copied out of the image once it is finished
+	captureSupported = !settings.captureDirectory.empty() && FrameCapture::isSupported(swapChainImageFormat) &&
+		(swapChainSupport.capabilities.supportedUsageFlags & VK_IMAGE_USAGE_TRANSFER_SRC_BIT);
+	if (captureSupported) {
+		createInfo.imageUsage  |= VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+	}
 	createInfo.oldSwapchain		= oldSwapChain;
 
 	// Handle swap chains across multiple queue families
@@ -346,44 +1083,86 @@ void VulkanApplication::createSwapChain() {
 }
 
 void VulkanApplication::recreateSwapChain() {
-	oldSwapChain = swapChain;
-
-	int width = 0;
-	int height = 0;
-	while (width == 0 || height == 0) {
-		glfwGetFramebufferSize(window, &width, &height);
-		glfwWaitEvents();
+	// Nothing can be presented while the window is minimized. The renderer may not be on the thread that
+	// handles the window's events, so it goes by the input it samples rather than asking the window
+	sampleInput();
+	while (input.framebufferWidth == 0 || input.framebufferHeight == 0) {
+		if (!running) {
+			return;
+		}
+		waitForInput();
 	}
 
+	oldSwapChain = swapChain;
+
 	vkDeviceWaitIdle(logicalDevice);
 
 	cleanupSwapChain();
 
+	// The old swap chain is handed to the new one so it can reuse its resources, only then can it go
 	createSwapChain();
+	vkDestroySwapchainKHR(logicalDevice, oldSwapChain, nullptr);
+	oldSwapChain = VK_NULL_HANDLE;
 	createImageViews();
 	createRenderPass();
 	createGraphicsPipeline();
-	createFramebuffers();
-	createCommandBuffers();
+	createHiZResources();
+	buildRenderGraph();
+	createDescriptorPool();
+	createDescriptorSets();
 }
 
 void VulkanApplication::cleanupSwapChain() {
-	for (auto& framebuffer : swapChainFramebuffers) {
-		vkDestroyFramebuffer(logicalDevice, framebuffer, nullptr);
+	renderGraph.destroy(logicalDevice);
+	vkDestroyDescriptorPool(logicalDevice, descriptorPool, nullptr);
+	if (hiZDownsampler) {
+		hiZDownsampler->destroyTarget(hiZDownsampleTarget);
 	}
-	vkFreeCommandBuffers(logicalDevice, commandPool, static_cast<uint32_t>(commandBuffers.size()), commandBuffers.data());
+	for (auto& view : hiZMipViews) {
+		vkDestroyImageView(logicalDevice, view, nullptr);
+	}
+	vkutil::destroyImage(logicalDevice, hiZImage);
 	vkDestroyPipeline(logicalDevice, graphicsPipeline, nullptr);
+	for (VkPipeline pipeline : batchPipelines) {
+		vkDestroyPipeline(logicalDevice, pipeline, nullptr);
+	}
+	batchPipelines.clear();
 	vkDestroyPipelineLayout(logicalDevice, pipelineLayout, nullptr);
+	if (particleSystem) {
+		particleSystem->destroyRenderPipeline();
+	}
 	vkDestroyRenderPass(logicalDevice, renderPass, nullptr);
-	for (auto& imageView : swapChainImageViews) {
-		vkDestroyImageView(logicalDevice, imageView, nullptr);
+	if (settings.headless) {
+		for (auto& image : headlessImages) {
+			vkutil::destroyImage(logicalDevice, image);
+		}
+		headlessImages.clear();
+	} else {
+		for (auto& imageView : swapChainImageViews) {
+			vkDestroyImageView(logicalDevice, imageView, nullptr);
+		}
+	}
+	swapChainImageViews.clear();
+}
+
+std::vector<const char*> VulkanApplication::requiredDeviceExtensions() const {
+	if (settings.headless) {
+		return {};
 	}
-	vkDestroySwapchainKHR(logicalDevice, swapChain, nullptr);
+	return deviceExtensions;
 }
 
 void VulkanApplication::createImageViews() {
 	swapChainImageViews.resize(swapChainImages.size());
 
+	// Headless images come with their views
+	if (settings.headless) {
+		for (size_t i = 0; i < headlessImages.size(); i++) {
+			swapChainImageViews[i] = headlessImages[i].view;
+		}
+		return;
+	}
+
 	for (int i = 0; i < swapChainImages.size(); i++) {
 		VkImageViewCreateInfo createInfo = {};
 
@@ -411,8 +1190,12 @@ void VulkanApplication::createImageViews() {
 
 void VulkanApplication::createGraphicsPipeline() {
 	// Set up our shaders
-	auto vertShaderCode = util::readFile(VK_ROOT_DIR "src/shaders/vulkan_vert.spv");
-	auto fragShaderCode = util::readFile(VK_ROOT_DIR "src/shaders/vulkan_frag.spv");
+	auto vertShaderCode = assets->load("src/shaders/vulkan_vert.spv");
+	std::string fragShaderName = textureStreamer ? "vulkan_textured" : "vulkan";
+	if (virtualTexture) {
+		fragShaderName += "_virtual";
+	}
+	auto fragShaderCode = assets->load("src/shaders/" + fragShaderName + "_frag.spv");
 
 	VkShaderModule vertShaderModule = createShaderModule(vertShaderCode);
 	VkShaderModule fragShaderModule = createShaderModule(fragShaderCode);
@@ -429,15 +1212,44 @@ void VulkanApplication::createGraphicsPipeline() {
 	fragShaderStageInfo.module = fragShaderModule;
 	fragShaderStageInfo.pName  = "main";
 
+	// Size of the texture array and the virtual texture's layout, constants a variant does not declare are ignored
+	struct {
+		uint32_t textureCount;
+		uint32_t virtualPages;
+		uint32_t virtualMips;
+		uint32_t cachePages;
+	} fragConstants = {};
+	fragConstants.textureCount = textureStreamer ? textureStreamer->getTextureCount() : 0;
+	if (virtualTexture) {
+		fragConstants.virtualPages = virtualTexture->getPagesPerSide();
+		fragConstants.virtualMips  = virtualTexture->getMipCount();
+		fragConstants.cachePages   = virtualTexture->getCachePagesPerSide();
+	}
+	VkSpecializationMapEntry fragEntries[4];
+	for (uint32_t i = 0; i < 4; i++) {
+		fragEntries[i] = { i, i * static_cast<uint32_t>(sizeof(uint32_t)), sizeof(uint32_t) };
+	}
+	VkSpecializationInfo fragSpecialization = {};
+	fragSpecialization.mapEntryCount = 4;
+	fragSpecialization.pMapEntries	 = fragEntries;
+	fragSpecialization.dataSize		 = sizeof(fragConstants);
+	fragSpecialization.pData		 = &fragConstants;
+	if (textureStreamer || virtualTexture) {
+		fragShaderStageInfo.pSpecializationInfo = &fragSpecialization;
+	}
+
 	VkPipelineShaderStageCreateInfo shaderStages[] = { vertShaderStageInfo, fragShaderStageInfo };
 
 	// Format of vertex data being sent in
+	auto bindingDescription = Vertex::getBindingDescription();
+	auto attributeDescriptions = Vertex::getAttributeDescriptions();
+
 	VkPipelineVertexInputStateCreateInfo vertexInputinfo = {};
 	vertexInputinfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-	vertexInputinfo.vertexBindingDescriptionCount = 0;
-	vertexInputinfo.pVertexBindingDescriptions = nullptr;
-	vertexInputinfo.vertexAttributeDescriptionCount = 0;
-	vertexInputinfo.pVertexAttributeDescriptions = nullptr;
+	vertexInputinfo.vertexBindingDescriptionCount = 1;
+	vertexInputinfo.pVertexBindingDescriptions = &bindingDescription;
+	vertexInputinfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(attributeDescriptions.size());
+	vertexInputinfo.pVertexAttributeDescriptions = attributeDescriptions.data();
 
 	// What kind of geometry should be drawn from the vertices and primitive restart
 	VkPipelineInputAssemblyStateCreateInfo inputAssembly = {};
@@ -464,6 +1276,13 @@ void VulkanApplication::createGraphicsPipeline() {
 	viewportState.scissorCount	= 1;
 	viewportState.pScissors		= &scissor;
 
+	// Set per frame to the part of the screen the scene is rendered into
+	VkDynamicState dynamicStates[] = { VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR };
+	VkPipelineDynamicStateCreateInfo dynamicState = {};
+	dynamicState.sType			   = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+	dynamicState.dynamicStateCount = 2;
+	dynamicState.pDynamicStates	   = dynamicStates;
+
 	VkPipelineRasterizationStateCreateInfo rasterizer = {};
 	rasterizer.sType					= VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
 	rasterizer.depthClampEnable			= VK_FALSE; // Discard fragments beyond near/far planes instead of clamping
@@ -480,12 +1299,20 @@ void VulkanApplication::createGraphicsPipeline() {
 	VkPipelineMultisampleStateCreateInfo multisampling = {};
 	multisampling.sType					= VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
 	multisampling.sampleShadingEnable	= VK_FALSE;
-	multisampling.rasterizationSamples	= VK_SAMPLE_COUNT_1_BIT;
+	multisampling.rasterizationSamples	= msaaSamples;
 	multisampling.minSampleShading		= 1.0f;
 	multisampling.pSampleMask			= nullptr;
 	multisampling.alphaToCoverageEnable = VK_FALSE;
 	multisampling.alphaToOneEnable		= VK_FALSE;
 
+	VkPipelineDepthStencilStateCreateInfo depthStencil = {};
+	depthStencil.sType					= VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+	depthStencil.depthTestEnable		= VK_TRUE;
+	depthStencil.depthWriteEnable		= VK_TRUE;
+	depthStencil.depthCompareOp			= VK_COMPARE_OP_LESS;
+	depthStencil.depthBoundsTestEnable	= VK_FALSE;
+	depthStencil.stencilTestEnable		= VK_FALSE;
+
 	VkPipelineColorBlendAttachmentState colorBlendAttachment = {};
 	colorBlendAttachment.colorWriteMask = 
 		VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | 
@@ -510,12 +1337,21 @@ void VulkanApplication::createGraphicsPipeline() {
 	colorBlending.blendConstants[3] = 0.0f;
 
 
+	// Where in the visible id buffer each indirect draw finds its objects
+	VkPushConstantRange pushConstantRange = {};
+	pushConstantRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+	pushConstantRange.offset = 0;
+	pushConstantRange.size = sizeof(uint32_t);
+
 	VkPipelineLayoutCreateInfo pipelineCreateInfo = {};
 	pipelineCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-	pipelineCreateInfo.setLayoutCount = 0; // (layout = 0) stuff in shader, rest is optional due to no uniforms
-	pipelineCreateInfo.pSetLayouts = nullptr;
-	pipelineCreateInfo.pushConstantRangeCount = 0;
-	pipelineCreateInfo.pPushConstantRanges = nullptr;
+	// The lights' set follows the frame's, then the shadows' and the virtual texture's
+	VkDescriptorSetLayout setLayouts[] = { frameSetLayout, lightClusters->getSetLayout(), shadowMaps->getSetLayout(),
+		virtualTexture ? virtualTexture->getSetLayout() : VK_NULL_HANDLE };
+	pipelineCreateInfo.setLayoutCount = virtualTexture ? 4 : 3;
+	pipelineCreateInfo.pSetLayouts = setLayouts;
+	pipelineCreateInfo.pushConstantRangeCount = 1;
+	pipelineCreateInfo.pPushConstantRanges = &pushConstantRange;
 
 	if (vkCreatePipelineLayout(logicalDevice, &pipelineCreateInfo, nullptr, &pipelineLayout) != VK_SUCCESS) {
 		throw std::runtime_error("Failed to create pipeline layout.");
@@ -531,9 +1367,9 @@ void VulkanApplication::createGraphicsPipeline() {
 	pipelineInfo.pViewportState = &viewportState;
 	pipelineInfo.pRasterizationState = &rasterizer;
 	pipelineInfo.pMultisampleState = &multisampling;
-	pipelineInfo.pDepthStencilState = nullptr;
+	pipelineInfo.pDepthStencilState = &depthStencil;
 	pipelineInfo.pColorBlendState = &colorBlending;
-	pipelineInfo.pDynamicState = nullptr;
+	pipelineInfo.pDynamicState = &dynamicState;
 
 	pipelineInfo.layout = pipelineLayout;
 	pipelineInfo.renderPass = renderPass;
@@ -546,92 +1382,76 @@ void VulkanApplication::createGraphicsPipeline() {
 		throw std::runtime_error("Failed to create graphics pipeline.");
 	}
 
+	// Each as expensive to bind as any other, so switching between them costs what switching materials would
+	if (settings.batchBenchmark) {
+		const VkCullModeFlags cullModes[] = { VK_CULL_MODE_BACK_BIT, VK_CULL_MODE_NONE };
+		for (VkCullModeFlags cullMode : cullModes) {
+			for (VkBool32 blend : { VK_TRUE, VK_FALSE }) {
+				rasterizer.cullMode = cullMode;
+				colorBlendAttachment.blendEnable = blend;
+
+				VkPipeline pipeline;
+				if (vkCreateGraphicsPipelines(logicalDevice, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &pipeline) != VK_SUCCESS) {
+					throw std::runtime_error("Failed to create batch benchmark pipeline.");
+				}
+				batchPipelines.push_back(pipeline);
+			}
+		}
+	}
+
 	vkDestroyShaderModule(logicalDevice, fragShaderModule, nullptr);
 	vkDestroyShaderModule(logicalDevice, vertShaderModule, nullptr);
 
+	// Particles are drawn into the same attachments as the scene
+	if (particleSystem) {
+		particleSystem->createRenderPipeline(*assets, renderPass, msaaSamples);
+	}
 }
 
 VkShaderModule VulkanApplication::createShaderModule(const std::vector<char>& code) {
-	VkShaderModuleCreateInfo createInfo = {};
-	createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-	createInfo.codeSize = code.size();
-	createInfo.pCode = reinterpret_cast<const uint32_t*>(code.data());
-
-	VkShaderModule shaderModule;
-	if (vkCreateShaderModule(logicalDevice, &createInfo, nullptr, &shaderModule) != VK_SUCCESS) {
-		throw std::runtime_error("Failed to create shader module");
-	}
-
-	return shaderModule;
+	return vkutil::createShaderModule(logicalDevice, code);
 }
 
 void VulkanApplication::createRenderPass() {
+	depthFormat = findDepthFormat();
+	msaaSamples = chooseSampleCount();
+	renderPass = RenderGraph::createCompatibleRenderPass(logicalDevice, { PostProcess::HDR_FORMAT }, depthFormat, msaaSamples);
+}
 
-	VkAttachmentDescription colorAttachment = {};
-	colorAttachment.format  = swapChainImageFormat;
-	colorAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
-	colorAttachment.loadOp  = VK_ATTACHMENT_LOAD_OP_CLEAR; // Clear to black before next render
-	colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE; // Keep pixels and see what we rendered on screen
-	colorAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
-	colorAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-	colorAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED; // don't care about initial layout of image as we clear it anyways
-	colorAttachment.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
-
-
-	VkAttachmentReference colorAttachmentRef = {};
-	colorAttachmentRef.attachment = 0; // Index of wanted description
-	colorAttachmentRef.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
-
-	VkSubpassDescription subpass = {};
-	subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
-	subpass.colorAttachmentCount = 1;
-	subpass.pColorAttachments = &colorAttachmentRef;
-
-	VkSubpassDependency dependency = {};
-	dependency.srcSubpass = VK_SUBPASS_EXTERNAL;
-	dependency.dstSubpass = 0;
-	dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-	dependency.srcAccessMask = 0;
-	dependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-	dependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
-
-	VkRenderPassCreateInfo renderPassInfo = {};
-	renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
-	renderPassInfo.attachmentCount = 1;
-	renderPassInfo.pAttachments = &colorAttachment;
-	renderPassInfo.subpassCount = 1;
-	renderPassInfo.pSubpasses = &subpass;
-	renderPassInfo.dependencyCount = 1;
-	renderPassInfo.pDependencies = &dependency;
+VkFormat VulkanApplication::findSupportedFormat(const std::vector<VkFormat>& candidates, VkImageTiling tiling, VkFormatFeatureFlags features) {
+	for (VkFormat format : candidates) {
+		VkFormatProperties properties;
+		vkGetPhysicalDeviceFormatProperties(physicalDevice, format, &properties);
 
-	if (vkCreateRenderPass(logicalDevice, &renderPassInfo, nullptr, &renderPass) != VK_SUCCESS) {
-		throw std::runtime_error("Render pass creation failed.");
+		VkFormatFeatureFlags supported = tiling == VK_IMAGE_TILING_LINEAR ? properties.linearTilingFeatures : properties.optimalTilingFeatures;
+		if ((supported & features) == features) {
+			return format;
+		}
 	}
 
+	throw std::runtime_error("Failed to find a supported format.");
 }
 
-void VulkanApplication::createFramebuffers() {
-	swapChainFramebuffers.resize(swapChainImageViews.size());
+VkFormat VulkanApplication::findDepthFormat() {
+	// Depth only formats, the depth pyramid samples them directly
+	return findSupportedFormat(
+		{ VK_FORMAT_D32_SFLOAT, VK_FORMAT_D16_UNORM },
+		VK_IMAGE_TILING_OPTIMAL,
+		VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT);
+}
 
-	for (size_t i = 0; i < swapChainImageViews.size(); i++) {
-		VkImageView attachments[] = {
-			swapChainImageViews[i]
-		};
+VkSampleCountFlagBits VulkanApplication::chooseSampleCount() {
+	VkPhysicalDeviceProperties properties;
+	vkGetPhysicalDeviceProperties(physicalDevice, &properties);
 
-		VkFramebufferCreateInfo framebufferInfo = {};
-		framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
-		framebufferInfo.renderPass = renderPass;
-		framebufferInfo.attachmentCount = 1;
-		framebufferInfo.pAttachments = attachments;
-		framebufferInfo.width = swapChainExtent.width;
-		framebufferInfo.height = swapChainExtent.height;
-		framebufferInfo.layers = 1;
+	VkSampleCountFlags supported = properties.limits.framebufferColorSampleCounts & properties.limits.framebufferDepthSampleCounts &
+		properties.limits.sampledImageDepthSampleCounts;
 
-		if (vkCreateFramebuffer(logicalDevice, &framebufferInfo, nullptr, &swapChainFramebuffers[i]) != VK_SUCCESS) {
-			throw std::runtime_error("Failed to create frame buffer.");
-		}
+	uint32_t samples = settings.msaaSamples;
+	while (samples > 1 && (supported & samples) == 0) {
+		samples /= 2;
 	}
-
+	return static_cast<VkSampleCountFlagBits>(samples);
 }
 
 void VulkanApplication::createCommandPool() {
@@ -639,15 +1459,22 @@ void VulkanApplication::createCommandPool() {
 	VkCommandPoolCreateInfo poolInfo = {};
 	poolInfo.sType				= VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
 	poolInfo.queueFamilyIndex	= indices.graphicsFamily.value();
-	poolInfo.flags				= 0;
+	poolInfo.flags				= VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT; // We re-record every frame
 
 	if (vkCreateCommandPool(logicalDevice, &poolInfo, nullptr, &commandPool) != VK_SUCCESS) {
 		throw std::runtime_error("Command pool creation failed.");
 	}
+
+	if (computeQueue != VK_NULL_HANDLE) {
+		poolInfo.queueFamilyIndex = indices.computeFamily.value();
+		if (vkCreateCommandPool(logicalDevice, &poolInfo, nullptr, &computeCommandPool) != VK_SUCCESS) {
+			throw std::runtime_error("Compute command pool creation failed.");
+		}
+	}
 }
 
 void VulkanApplication::createCommandBuffers() {
-	commandBuffers.resize(swapChainFramebuffers.size());
+	commandBuffers.resize(MAX_FRAMES_IN_FLIGHT);
 
 	VkCommandBufferAllocateInfo allocInfo = {};
 	allocInfo.sType					= VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
@@ -659,56 +1486,560 @@ void VulkanApplication::createCommandBuffers() {
 		throw std::runtime_error("Command buffers allocation failed.");
 	}
 
-	for (size_t i = 0; i < commandBuffers.size(); i++) {
-		VkCommandBufferBeginInfo beginInfo = {};
-		beginInfo.sType				= VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-		beginInfo.flags				= 0;
-		beginInfo.pInheritanceInfo	= nullptr;
-
-		// Cannot append commands to a buffer at a later time
-		if (vkBeginCommandBuffer(commandBuffers[i], &beginInfo) != VK_SUCCESS) {
-			throw std::runtime_error("Failed to begin recording command buffer.");
+	if (computeCommandPool != VK_NULL_HANDLE) {
+		computeCommandBuffers.resize(MAX_FRAMES_IN_FLIGHT);
+		allocInfo.commandPool = computeCommandPool;
+		if (vkAllocateCommandBuffers(logicalDevice, &allocInfo, computeCommandBuffers.data()) != VK_SUCCESS) {
+			throw std::runtime_error("Compute command buffers allocation failed.");
 		}
+	}
+}
 
-		VkRenderPassBeginInfo renderPassInfo = {};
-		renderPassInfo.sType				= VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-		renderPassInfo.renderPass			= renderPass;
-		renderPassInfo.framebuffer			= swapChainFramebuffers[i];
-		renderPassInfo.renderArea.offset	= { 0, 0 };
-		renderPassInfo.renderArea.extent	= swapChainExtent;
+void VulkanApplication::buildRenderGraph() {
+	typedef RenderGraph::Usage Usage;
+
+	renderGraph.destroy(logicalDevice);
+	renderGraph.reset();
+
+	// The swap chain hands its image over once the post processing may write it, see drawFrame. Headless
+	// images are left for whatever reads them next
+	backbufferStage = directPostOutput ? VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT : VK_PIPELINE_STAGE_TRANSFER_BIT;
+	RenderGraph::ImageDesc backbufferDesc;
+	backbufferDesc.format = swapChainImageFormat;
+	backbufferDesc.extent = swapChainExtent;
+	RenderGraph::Resource backbuffer = renderGraph.importImage("backbuffer", backbufferDesc, swapChainImages, swapChainImageViews,
+		VK_IMAGE_LAYOUT_UNDEFINED, settings.headless ? VK_IMAGE_LAYOUT_GENERAL : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR, backbufferStage);
+
+	// The scene is drawn in HDR and post processed into the backbuffer
+	RenderGraph::ImageDesc hdrDesc;
+	hdrDesc.format = PostProcess::HDR_FORMAT;
+	hdrDesc.extent = swapChainExtent;
+	RenderGraph::Resource hdr = renderGraph.createImage("hdr", hdrDesc);
+
+	// Multisampled color is resolved into the HDR target by the last scene pass. Unless the depth pyramid
+	// needs the depth, both only live inside that pass and may never be backed by memory at all
+	RenderGraph::ImageDesc depthDesc;
+	depthDesc.format  = depthFormat;
+	depthDesc.extent  = swapChainExtent;
+	depthDesc.samples = msaaSamples;
+	depthDesc.aspect  = VK_IMAGE_ASPECT_DEPTH_BIT;
+	depthResource = renderGraph.createImage("depth", depthDesc);
+
+	bool multisampled = msaaSamples != VK_SAMPLE_COUNT_1_BIT;
+	RenderGraph::Resource color = hdr;
+	if (multisampled) {
+		RenderGraph::ImageDesc colorDesc = hdrDesc;
+		colorDesc.samples = msaaSamples;
+		color = renderGraph.createImage("color", colorDesc);
+	}
 
-		VkClearValue clearColor = { 0.0f, 0.0f, 0.0f, 1.0f };
-		renderPassInfo.clearValueCount = 1;
-		renderPassInfo.pClearValues = &clearColor;
+	// The pyramid is kept between frames for the early culling phase and sampled by the late one
+	RenderGraph::ImageDesc hiZDesc;
+	hiZDesc.format	  = VK_FORMAT_R32_SFLOAT;
+	hiZDesc.extent	  = hiZImage.extent;
+	hiZDesc.mipLevels = hiZImage.mipLevels;
+	RenderGraph::Resource hiZ = renderGraph.importImage("hiZ", hiZDesc, { hiZImage.image }, { hiZImage.view },
+		VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+
+	RenderGraph::Resource drawCommands = renderGraph.importBuffer("drawCommands");
+	RenderGraph::Resource visibleIds = renderGraph.importBuffer("visibleIds");
+	// Cluster dispatches and the objects they cull, then the cluster draws and their counts
+	RenderGraph::Resource clusterWork = renderGraph.importBuffer("clusterWork");
+	RenderGraph::Resource clusterDraws = renderGraph.importBuffer("clusterDraws");
+	// Visibility and level of detail each object was left with, read by the next frame
+	RenderGraph::Resource cullState = renderGraph.importBuffer("cullState");
+	RenderGraph::Resource stats = renderGraph.importBuffer("stats", VK_PIPELINE_STAGE_HOST_BIT, VK_ACCESS_HOST_READ_BIT);
+
+	// Every cascade is drawn or copied into the atlas each frame, what it held before is never looked at
+	const vkutil::Image& atlasImage = shadowMaps->getAtlas();
+	RenderGraph::ImageDesc atlasDesc;
+	atlasDesc.format = atlasImage.format;
+	atlasDesc.extent = atlasImage.extent;
+	atlasDesc.aspect = VK_IMAGE_ASPECT_DEPTH_BIT;
+	RenderGraph::Resource shadowAtlas = renderGraph.importImage("shadowAtlas", atlasDesc, { atlasImage.image }, { atlasImage.view },
+		VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL);
+	bool shadowCache = settings.shadowCache;
+
+	if (shadowCache) {
+		renderGraph.addPass("shadow cache")
+			.use(shadowAtlas, Usage::TransferWrite)
+			.execute([this](VkCommandBuffer commandBuffer) {
+				shadowMaps->recordCache(commandBuffer, currentFrame, frameDescriptorSets[currentFrame]);
+			});
+	}
 
-		vkCmdBeginRenderPass(commandBuffers[i], &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
-		vkCmdBindPipeline(commandBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, graphicsPipeline);
-		vkCmdDraw(commandBuffers[i], 3, 1, 0, 0);
-		vkCmdEndRenderPass(commandBuffers[i]);
+	renderGraph.addPass("shadows")
+		.depthAttachment(shadowAtlas, shadowCache ? VK_ATTACHMENT_LOAD_OP_LOAD : VK_ATTACHMENT_LOAD_OP_CLEAR)
+		.execute([this](VkCommandBuffer commandBuffer) {
+			shadowMaps->recordCascades(commandBuffer, currentFrame, frameDescriptorSets[currentFrame]);
+			writeTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, TIMESTAMP_SHADOWS);
+			if (!settings.lightBinning || useAsyncCompute()) {
+				// Nothing binned on this queue, the binning takes no time out of it
+				writeTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, TIMESTAMP_LIGHT_BINNING);
+			}
+			if (!settings.lightBinning) {
+				writeTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, TIMESTAMP_BINNING_BEGIN);
+				writeTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, TIMESTAMP_BINNING_END);
+			}
+		});
+
+	// Pages the scene draws asked the virtual texture for, and their copy the next use of the frame reads
+	RenderGraph::Resource feedback = {};
+	RenderGraph::Resource feedbackReadback = {};
+	if (virtualTexture) {
+		virtualTexture->resize(swapChainExtent);
+		feedback = renderGraph.importBuffer("virtualTextureFeedback");
+		feedbackReadback = renderGraph.importBuffer("virtualTextureReadback", VK_PIPELINE_STAGE_HOST_BIT, VK_ACCESS_HOST_READ_BIT);
+
+		renderGraph.addPass("feedback reset")
+			.use(feedback, Usage::TransferWrite)
+			.execute([this](VkCommandBuffer commandBuffer) {
+				virtualTexture->recordFeedbackReset(commandBuffer, currentFrame);
+			});
+	}
 
-		if (vkEndCommandBuffer(commandBuffers[i]) != VK_SUCCESS) {
-			throw std::runtime_error("Failed to record command buffer.");
-		}
+	// Per cluster light ranges with their counters, and the index lists they point into
+	RenderGraph::Resource lightRanges = renderGraph.importBuffer("lightRanges");
+	RenderGraph::Resource lightIndices = renderGraph.importBuffer("lightIndices");
+	RenderGraph::Resource lightReadback = renderGraph.importBuffer("lightReadback", VK_PIPELINE_STAGE_HOST_BIT, VK_ACCESS_HOST_READ_BIT);
+	bool lightBinning = settings.lightBinning;
+
+	// Binned on the compute queue instead, the frame's submission waits for it ahead of the shading
+	if (lightBinning && !useAsyncCompute()) {
+		renderGraph.addPass("light reset")
+			.use(lightRanges, Usage::TransferWrite)
+			.execute([this](VkCommandBuffer commandBuffer) {
+				writeTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, TIMESTAMP_BINNING_BEGIN);
+				lightClusters->recordReset(commandBuffer, currentFrame);
+			});
+
+		renderGraph.addPass("light binning")
+			.use(lightRanges, Usage::ComputeStorageWrite)
+			.use(lightIndices, Usage::ComputeStorageWrite)
+			.execute([this](VkCommandBuffer commandBuffer) {
+				lightClusters->recordBinning(commandBuffer, currentFrame);
+				writeTimestamp(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, TIMESTAMP_LIGHT_BINNING);
+				writeTimestamp(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, TIMESTAMP_BINNING_END);
+			});
 	}
-}
 
-void VulkanApplication::createSyncObjects() {
-	imageAvailableSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
-	renderFinishedSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
-	inFlightFences.resize(MAX_FRAMES_IN_FLIGHT);
+	bool twoPhase = settings.cullingMode == CullingMode::HiZ;
+	bool clusters = useClusterCulling();
+
+	if (settings.cullingMode == CullingMode::CpuOcclusion) {
+		// The cpu already culled this frame, upload its commands and ids in place of the culling pass
+		renderGraph.addPass("cpu upload")
+			.use(drawCommands, Usage::TransferWrite)
+			.use(visibleIds, Usage::TransferWrite)
+			.use(clusterDraws, Usage::TransferWrite)
+			.execute([this](VkCommandBuffer commandBuffer) {
+				// Cluster counts are read back for stats whichever path fills them
+				vkCmdFillBuffer(commandBuffer, clusterCountBuffer.buffer, 0, VK_WHOLE_SIZE, 0);
+
+				VkBufferCopy commandRegion = {};
+				commandRegion.size = drawCommandBuffer.size;
+				vkCmdCopyBuffer(commandBuffer, cpuCullBuffers[currentFrame].buffer, drawCommandBuffer.buffer, 1, &commandRegion);
+
+				VkBufferCopy idRegion = {};
+				idRegion.srcOffset = drawCommandBuffer.size;
+				idRegion.size = sizeof(uint32_t) * visibleStride;
+				vkCmdCopyBuffer(commandBuffer, cpuCullBuffers[currentFrame].buffer, visibleIdBuffer.buffer, 1, &idRegion);
+				writeTimestamp(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, TIMESTAMP_EARLY_CULL);
+			});
+	} else {
+		renderGraph.addPass("reset")
+			.use(drawCommands, Usage::TransferWrite)
+			.use(clusterWork, Usage::TransferWrite)
+			.use(clusterDraws, Usage::TransferWrite)
+			.execute([this, clusters](VkCommandBuffer commandBuffer) {
+				vkCmdFillBuffer(commandBuffer, clusterCountBuffer.buffer, 0, VK_WHOLE_SIZE, 0);
+
+				// Reset the instance counts of both phases
+				VkBufferCopy resetRegions[2] = {};
+				resetRegions[0].size = drawTemplateBuffer.size;
+				resetRegions[1].dstOffset = drawTemplateBuffer.size;
+				resetRegions[1].size = drawTemplateBuffer.size;
+				vkCmdCopyBuffer(commandBuffer, drawTemplateBuffer.buffer, drawCommandBuffer.buffer, 2, resetRegions);
+
+				// Empty cluster work lists. Without a draw count the unused commands must draw nothing
+				const ClusterDispatch dispatchReset[2] = { { 0, 1, 1, 0 }, { 0, 1, 1, 0 } };
+				vkCmdUpdateBuffer(commandBuffer, clusterObjectBuffer.buffer, 0, sizeof(dispatchReset), dispatchReset);
+				if (clusters && !drawIndirectCountSupported) {
+					vkCmdFillBuffer(commandBuffer, clusterDrawBuffer.buffer, 0, VK_WHOLE_SIZE, 0);
+				}
+			});
+	}
 
-	VkSemaphoreCreateInfo semaphoreInfo = {};
-	semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+	// Culling passes of a phase, with the draws they leave ready for indirect drawing
+	auto addCulling = [&](uint32_t phase, uint32_t timestamp) {
+		if (settings.cullingMode == CullingMode::CpuOcclusion) {
+			return;
+		}
 
-	VkFenceCreateInfo fenceInfo = {};
-	fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
-	fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
+		RenderGraph::Pass& cull = renderGraph.addPass(phase == 0 ? "early cull" : "late cull")
+			.use(drawCommands, Usage::ComputeStorageWrite)
+			.use(visibleIds, Usage::ComputeStorageWrite)
+			.use(clusterWork, Usage::ComputeStorageWrite)
+			.use(cullState, Usage::ComputeStorageWrite)
+			.execute([this, phase, clusters, timestamp](VkCommandBuffer commandBuffer) {
+				recordCulling(commandBuffer, phase);
+				if (!clusters) {
+					writeTimestamp(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, timestamp);
+				}
+			});
+		if (phase == 1) {
+			cull.use(hiZ, Usage::ComputeSampled);
+		}
 
-	for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
-		if (vkCreateSemaphore(logicalDevice, &semaphoreInfo, nullptr, &imageAvailableSemaphores[i]) ||
-			vkCreateSemaphore(logicalDevice, &semaphoreInfo, nullptr, &renderFinishedSemaphores[i]) ||
-			vkCreateFence(logicalDevice, &fenceInfo, nullptr, &inFlightFences[i]) != VK_SUCCESS) {
-			throw std::runtime_error("Failed to create semaphores.");
+		if (clusters) {
+			renderGraph.addPass(phase == 0 ? "early cluster cull" : "late cluster cull")
+				.use(clusterWork, Usage::IndirectRead)
+				.use(clusterWork, Usage::ComputeStorageRead)
+				.use(cullState, Usage::ComputeStorageRead)
+				.use(clusterDraws, Usage::ComputeStorageWrite)
+				.execute([this, phase, timestamp](VkCommandBuffer commandBuffer) {
+					recordClusterCulling(commandBuffer, phase);
+					writeTimestamp(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, timestamp);
+				});
+		}
+	};
+
+	// Scene draws of a phase. The first one clears, the second draws on top of it
+	auto addDraws = [&](uint32_t phase, VkAttachmentLoadOp loadOp) {
+		RenderGraph::Pass& draws = renderGraph.addPass(phase == 0 ? "early draw" : "late draw");
+		draws.colorAttachment(color, loadOp, { { 0.0f, 0.0f, 0.0f, 1.0f } });
+		// Particles are drawn into the multisampled color after this and resolve it themselves
+		if (multisampled && (phase == 1 || !twoPhase) && !particleSystem) {
+			draws.resolveAttachment(hdr);
+		}
+		draws.depthAttachment(depthResource, loadOp)
+			.renderArea(&renderExtent)
+			.use(clusters ? clusterDraws : drawCommands, Usage::IndirectRead)
+			.use(visibleIds, Usage::VertexStorageRead)
+			.use(shadowAtlas, Usage::FragmentSampledDepth);
+		if (virtualTexture) {
+			draws.use(feedback, Usage::FragmentStorageWrite);
+		}
+		if (lightBinning) {
+			draws.use(lightRanges, Usage::FragmentStorageRead)
+				.use(lightIndices, Usage::FragmentStorageRead);
+		}
+		draws.execute([this, phase, twoPhase](VkCommandBuffer commandBuffer) {
+			recordSceneDraws(commandBuffer, phase);
+			writeTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, phase == 0 ? TIMESTAMP_EARLY_DRAW : TIMESTAMP_LATE_DRAW);
+			if (!twoPhase) {
+				// Single phase frames skip straight to the end
+				writeTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, TIMESTAMP_HIZ);
+				writeTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, TIMESTAMP_LATE_CULL);
+				writeTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, TIMESTAMP_LATE_DRAW);
+			}
+			if (!particleSystem && (phase == 1 || !twoPhase)) {
+				writeTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, TIMESTAMP_PARTICLE_SIM);
+				writeTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, TIMESTAMP_PARTICLE_DRAW);
+			}
+		});
+	};
+
+	addCulling(0, TIMESTAMP_EARLY_CULL);
+	addDraws(0, VK_ATTACHMENT_LOAD_OP_CLEAR);
+
+	if (twoPhase) {
+		renderGraph.addPass("depth pyramid")
+			.use(depthResource, Usage::ComputeSampledDepth)
+			.use(hiZ, Usage::ComputeStorageImage)
+			.execute([this](VkCommandBuffer commandBuffer) {
+				recordHiZBuild(commandBuffer);
+				writeTimestamp(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, TIMESTAMP_HIZ);
+			});
+
+		addCulling(1, TIMESTAMP_LATE_CULL);
+		addDraws(1, VK_ATTACHMENT_LOAD_OP_LOAD);
+	}
+
+	// Particles collide with the finished depth buffer, then are added onto the scene before its post processing.
+	// The particle buffers and their counters are tracked as one
+	RenderGraph::Resource particles = {};
+	if (particleSystem) {
+		particles = renderGraph.importBuffer("particles");
+		RenderGraph::Resource particleReadback = renderGraph.importBuffer("particleReadback", VK_PIPELINE_STAGE_HOST_BIT, VK_ACCESS_HOST_READ_BIT);
+
+		renderGraph.addPass("particle simulation")
+			.use(depthResource, Usage::ComputeSampledDepth)
+			.use(particles, Usage::ComputeStorageWrite)
+			.execute([this](VkCommandBuffer commandBuffer) {
+				particleSystem->recordSimulation(commandBuffer, currentFrame);
+				writeTimestamp(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, TIMESTAMP_PARTICLE_SIM);
+			});
+
+		RenderGraph::Pass& particleDraw = renderGraph.addPass("particle draw");
+		particleDraw.colorAttachment(color, VK_ATTACHMENT_LOAD_OP_LOAD);
+		if (multisampled) {
+			particleDraw.resolveAttachment(hdr);
+		}
+		particleDraw.depthAttachment(depthResource, VK_ATTACHMENT_LOAD_OP_LOAD)
+			.renderArea(&renderExtent)
+			.use(particles, Usage::IndirectRead)
+			.use(particles, Usage::VertexStorageRead)
+			.execute([this](VkCommandBuffer commandBuffer) {
+				particleSystem->recordDraw(commandBuffer, currentFrame, renderExtent);
+				writeTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, TIMESTAMP_PARTICLE_DRAW);
+			});
+
+		renderGraph.addPass("particle readback")
+			.use(particles, Usage::TransferRead)
+			.use(particleReadback, Usage::TransferWrite)
+			.execute([this](VkCommandBuffer commandBuffer) {
+				particleSystem->recordReadback(commandBuffer, currentFrame);
+			});
+	}
+
+	// Exposure adapted from the histogram, kept between frames, and the bloom chain, rebuilt every frame
+	postProcess->resize(swapChainExtent);
+	RenderGraph::Resource exposure = renderGraph.importBuffer("exposure");
+	const vkutil::Image& bloomImage = postProcess->getBloomChain();
+	RenderGraph::ImageDesc bloomDesc;
+	bloomDesc.format	= bloomImage.format;
+	bloomDesc.extent	= bloomImage.extent;
+	bloomDesc.mipLevels = bloomImage.mipLevels;
+	RenderGraph::Resource bloom = renderGraph.importImage("bloom", bloomDesc, { bloomImage.image }, { bloomImage.view },
+		VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+	bool autoExposure = settings.autoExposure;
+	bool bloomEnabled = settings.bloom;
+
+	if (autoExposure) {
+		renderGraph.addPass("luminance histogram")
+			.use(hdr, Usage::ComputeSampled)
+			.use(exposure, Usage::ComputeStorageWrite)
+			.execute([this](VkCommandBuffer commandBuffer) {
+				postProcess->recordHistogram(commandBuffer);
+			});
+
+		renderGraph.addPass("auto exposure")
+			.use(exposure, Usage::ComputeStorageWrite)
+			.execute([this](VkCommandBuffer commandBuffer) {
+				postProcess->recordExposure(commandBuffer, frameDelta);
+				writeTimestamp(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, TIMESTAMP_EXPOSURE);
+			});
+	}
+
+	if (bloomEnabled) {
+		renderGraph.addPass("bloom")
+			.use(hdr, Usage::ComputeSampled)
+			.use(bloom, Usage::ComputeStorageImage)
+			.execute([this, autoExposure](VkCommandBuffer commandBuffer) {
+				if (!autoExposure) {
+					writeTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, TIMESTAMP_EXPOSURE);
+				}
+				postProcess->recordBloom(commandBuffer);
+				writeTimestamp(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, TIMESTAMP_BLOOM);
+			});
+	}
+
+	// Everything else in one pass over the screen, straight into the backbuffer where it can be stored to
+	RenderGraph::Resource output = backbuffer;
+	if (!directPostOutput) {
+		RenderGraph::ImageDesc ldrDesc;
+		ldrDesc.format = PostProcess::OUTPUT_FORMAT;
+		ldrDesc.extent = swapChainExtent;
+		output = renderGraph.createImage("ldr", ldrDesc);
+	}
+
+	renderGraph.addPass("tonemap")
+		.use(hdr, Usage::ComputeSampled)
+		.use(bloom, Usage::ComputeSampled)
+		.use(exposure, Usage::ComputeStorageRead)
+		.use(output, Usage::ComputeStorageImage)
+		.execute([this, autoExposure, bloomEnabled](VkCommandBuffer commandBuffer) {
+			// Passes left out take no time
+			if (!autoExposure && !bloomEnabled) {
+				writeTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, TIMESTAMP_EXPOSURE);
+			}
+			if (!bloomEnabled) {
+				writeTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, TIMESTAMP_BLOOM);
+			}
+			postProcess->recordTonemap(commandBuffer, directPostOutput ? currentImageIndex : 0);
+			if (directPostOutput) {
+				writeTimestamp(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, TIMESTAMP_TONEMAP);
+			}
+		});
+
+	if (!directPostOutput) {
+		renderGraph.addPass("present blit")
+			.use(output, Usage::TransferRead)
+			.use(backbuffer, Usage::TransferWrite)
+			.execute([this, output, backbuffer](VkCommandBuffer commandBuffer) {
+				VkImageBlit region = {};
+				region.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+				region.srcSubresource.layerCount = 1;
+				region.srcOffsets[1]			 = { static_cast<int32_t>(swapChainExtent.width), static_cast<int32_t>(swapChainExtent.height), 1 };
+				region.dstSubresource			 = region.srcSubresource;
+				region.dstOffsets[1]			 = region.srcOffsets[1];
+				vkCmdBlitImage(commandBuffer, renderGraph.getImage(output), VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+					renderGraph.getImage(backbuffer, currentImageIndex), VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region, VK_FILTER_NEAREST);
+				writeTimestamp(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, TIMESTAMP_TONEMAP);
+			});
+	}
+
+	// The finished frame is copied out for the capture, which reads it once the frame's fence has signaled
+	if (frameCapture && captureSupported) {
+		RenderGraph::Resource captureReadback = renderGraph.importBuffer("captureReadback", VK_PIPELINE_STAGE_HOST_BIT, VK_ACCESS_HOST_READ_BIT);
+		renderGraph.addPass("capture")
+			.use(backbuffer, Usage::TransferRead)
+			.use(captureReadback, Usage::TransferWrite)
+			.execute([this, backbuffer](VkCommandBuffer commandBuffer) {
+				frameCapture->recordCopy(commandBuffer, renderGraph.getImage(backbuffer, currentImageIndex), swapChainExtent, swapChainImageFormat,
+					inFlightFences[currentFrame], frameNumber);
+			});
+	}
+
+	// Read back on the compute queue with the binning
+	if (lightBinning && !useAsyncCompute()) {
+		renderGraph.addPass("light readback")
+			.use(lightRanges, Usage::TransferRead)
+			.use(lightReadback, Usage::TransferWrite)
+			.execute([this](VkCommandBuffer commandBuffer) {
+				lightClusters->recordReadback(commandBuffer, currentFrame);
+			});
+	}
+
+	if (virtualTexture) {
+		renderGraph.addPass("feedback readback")
+			.use(feedback, Usage::TransferRead)
+			.use(feedbackReadback, Usage::TransferWrite)
+			.execute([this](VkCommandBuffer commandBuffer) {
+				virtualTexture->recordFeedbackReadback(commandBuffer, currentFrame);
+			});
+	}
+
+	// Copy out how many instances and clusters each phase drew
+	renderGraph.addPass("stats")
+		.use(drawCommands, Usage::TransferRead)
+		.use(clusterDraws, Usage::TransferRead)
+		.use(stats, Usage::TransferWrite)
+		.execute([this](VkCommandBuffer commandBuffer) {
+			VkBufferCopy statsRegion = {};
+			statsRegion.size = drawCommandBuffer.size;
+			vkCmdCopyBuffer(commandBuffer, drawCommandBuffer.buffer, statsBuffers[currentFrame].buffer, 1, &statsRegion);
+			statsRegion.dstOffset = drawCommandBuffer.size;
+			statsRegion.size = clusterCountBuffer.size;
+			vkCmdCopyBuffer(commandBuffer, clusterCountBuffer.buffer, statsBuffers[currentFrame].buffer, 1, &statsRegion);
+		});
+
+	renderGraph.compile(logicalDevice, physicalDevice);
+
+	std::vector<VkImageView> outputViews = directPostOutput ? swapChainImageViews : std::vector<VkImageView>{ renderGraph.getImageView(output) };
+	postProcess->setTargets(renderGraph.getImageView(hdr), outputViews, !isSrgbFormat(swapChainImageFormat));
+	if (particleSystem) {
+		particleSystem->setDepth(renderGraph.getImageView(depthResource), multisampled);
+	}
+
+	const RenderGraph::Stats& graphStats = renderGraph.getStats();
+	const double mb = 1024.0 * 1024.0;
+	std::cout << "Render graph: " << graphStats.passes - graphStats.culledPasses << " passes (" << graphStats.culledPasses << " culled), "
+		<< graphStats.barriers << " barriers, " << graphStats.layoutTransitions << " layout transitions, transient memory "
+		<< graphStats.aliasedMemory / mb << " MB (" << graphStats.transientMemory / mb << " MB without aliasing";
+	if (graphStats.lazyImages > 0) {
+		std::cout << ", " << graphStats.lazyMemory / mb << " MB of it lazily allocated";
+	}
+	std::cout << "), attachments store " << graphStats.attachmentStoreBytes / mb << " MB per frame and skip storing "
+		<< graphStats.attachmentDiscardBytes / mb << " MB" << std::endl;
+}
+
+void VulkanApplication::recordCommandBuffer(VkCommandBuffer commandBuffer, uint32_t imageIndex) {
+	VkCommandBufferBeginInfo beginInfo = {};
+	beginInfo.sType				= VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	beginInfo.flags				= VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+	beginInfo.pInheritanceInfo	= nullptr;
+
+	if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to begin recording command buffer.");
+	}
+
+	// Streamed textures synchronize their own uploads with the draws sampling them. They are recorded ahead
+	// of the first timestamp so the culling timings stay comparable
+	if (textureStreamer) {
+		textureStreamer->recordUploads(commandBuffer);
+	}
+	if (virtualTexture) {
+		virtualTexture->recordUploads(commandBuffer);
+	}
+
+	if (timestampsSupported) {
+		// The compute queue resets the binning's own timestamps when it bins
+		uint32_t timestampCount = useAsyncCompute() ? static_cast<uint32_t>(TIMESTAMP_BINNING_BEGIN) : static_cast<uint32_t>(TIMESTAMP_COUNT);
+		vkCmdResetQueryPool(commandBuffer, queryPool, currentFrame * TIMESTAMP_COUNT, timestampCount);
+	}
+	writeTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, TIMESTAMP_FRAME_BEGIN);
+
+	// Every barrier of the frame, including those against the previous one, comes from the graph
+	currentImageIndex = imageIndex;
+	renderGraph.execute(commandBuffer, imageIndex);
+
+	if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to record command buffer.");
+	}
+}
+
+bool VulkanApplication::useAsyncCompute() const {
+	return settings.asyncCompute && settings.lightBinning && computeQueue != VK_NULL_HANDLE;
+}
+
+void VulkanApplication::recordAsyncCompute(VkCommandBuffer commandBuffer) {
+	VkCommandBufferBeginInfo beginInfo = {};
+	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+	if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to begin recording compute command buffer.");
+	}
+
+	uint32_t firstQuery = currentFrame * TIMESTAMP_COUNT;
+	if (computeTimestampsSupported) {
+		vkCmdResetQueryPool(commandBuffer, queryPool, firstQuery + TIMESTAMP_BINNING_BEGIN, 2);
+		vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, queryPool, firstQuery + TIMESTAMP_BINNING_BEGIN);
+	}
+	lightClusters->recordAsync(commandBuffer, currentFrame);
+	if (computeTimestampsSupported) {
+		vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, queryPool, firstQuery + TIMESTAMP_BINNING_END);
+	}
+
+	if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to record compute command buffer.");
+	}
+}
+
+void VulkanApplication::writeTimestamp(VkCommandBuffer commandBuffer, VkPipelineStageFlagBits stage, uint32_t timestamp) {
+	if (timestampsSupported) {
+		vkCmdWriteTimestamp(commandBuffer, stage, queryPool, currentFrame * TIMESTAMP_COUNT + timestamp);
+	}
+}
+
+void VulkanApplication::createSyncObjects() {
+	imageAvailableSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
+	renderFinishedSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
+	inFlightFences.resize(MAX_FRAMES_IN_FLIGHT);
+
+	VkSemaphoreCreateInfo semaphoreInfo = {};
+	semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+
+	VkFenceCreateInfo fenceInfo = {};
+	fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+	fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
+
+	for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+		if (vkCreateSemaphore(logicalDevice, &semaphoreInfo, nullptr, &imageAvailableSemaphores[i]) ||
+			vkCreateSemaphore(logicalDevice, &semaphoreInfo, nullptr, &renderFinishedSemaphores[i]) ||
+			vkCreateFence(logicalDevice, &fenceInfo, nullptr, &inFlightFences[i]) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to create semaphores.");
+		}
+	}
+
+	if (computeQueue != VK_NULL_HANDLE) {
+		computeFinishedSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
+		for (auto& semaphore : computeFinishedSemaphores) {
+			if (vkCreateSemaphore(logicalDevice, &semaphoreInfo, nullptr, &semaphore) != VK_SUCCESS) {
+				throw std::runtime_error("Failed to create semaphores.");
+			}
 		}
 	}
 }
@@ -742,6 +2073,1578 @@ bool VulkanApplication::checkValidationSupport() {
 
 
 
+/// * * * * * SCENE AND CULLING * * * * * ///
+
+void VulkanApplication::createSceneBuffers() {
+	scene = settings.scene == SceneType::Dense ? Scene::createDense(settings.gridSize) : Scene::createCity(settings.gridSize);
+	scene.addLights(settings.lightCount);
+
+	// Pack every mesh into one vertex and index buffer so a single bind serves every draw
+	std::vector<Vertex> sceneVertices;
+	std::vector<uint32_t> sceneIndices;
+	std::vector<MeshletData> meshlets;
+	meshData.resize(scene.meshes.size());
+	lodData.clear();
+
+	for (size_t i = 0; i < scene.meshes.size(); i++) {
+		const Mesh& mesh = scene.meshes[i];
+		uint32_t firstIndex = static_cast<uint32_t>(sceneIndices.size());
+
+		meshData[i] = {};
+		meshData[i].vertexOffset = static_cast<int32_t>(sceneVertices.size());
+		meshData[i].firstLod	 = static_cast<uint32_t>(lodData.size());
+		meshData[i].lodCount	 = static_cast<uint32_t>(mesh.lods.size());
+
+		for (const auto& lod : mesh.lods) {
+			LodData data = {};
+			data.indexCount	  = lod.indexCount;
+			data.firstIndex	  = firstIndex + lod.firstIndex;
+			data.firstMeshlet = static_cast<uint32_t>(meshlets.size()) + lod.firstMeshlet;
+			data.meshletCount = lod.meshletCount;
+			data.error		  = lod.error;
+			lodData.push_back(data);
+		}
+
+		for (const auto& meshlet : mesh.meshlets) {
+			MeshletData data = {};
+			data.boundingSphere = glm::vec4(meshlet.center, meshlet.radius);
+			data.coneApex		= glm::vec4(meshlet.coneApex, 0.0f);
+			data.coneAxis		= glm::vec4(meshlet.coneAxis, meshlet.coneCutoff);
+			data.firstIndex		= firstIndex + meshlet.firstIndex;
+			data.indexCount		= meshlet.indexCount;
+			meshlets.push_back(data);
+		}
+
+		sceneVertices.insert(sceneVertices.end(), mesh.vertices.begin(), mesh.vertices.end());
+		sceneIndices.insert(sceneIndices.end(), mesh.indices.begin(), mesh.indices.end());
+	}
+
+	// Each level of detail gets room for every object using its mesh in the visible id lists
+	std::vector<uint32_t> objectsPerMesh(scene.meshes.size(), 0);
+	std::vector<ObjectData>& objects = objectData;
+	objects.resize(scene.objects.size());
+	uint32_t textureCount = textureStreamer ? textureStreamer->getTextureCount() : 1;
+
+	for (size_t i = 0; i < scene.objects.size(); i++) {
+		const SceneObject& object = scene.objects[i];
+
+		objects[i] = {};
+		objects[i].model		  = object.model;
+		objects[i].boundingSphere = scene.getBoundingSphere(object);
+		objects[i].color		  = object.color;
+		objects[i].meshIndex	  = object.meshIndex;
+
+		// Textures repeat every TEXTURE_REPEAT units along the object's longest side
+		float scale = std::max({
+			glm::length(glm::vec3(object.model[0])),
+			glm::length(glm::vec3(object.model[1])),
+			glm::length(glm::vec3(object.model[2])) });
+		objects[i].textureIndex	  = static_cast<uint32_t>((i * 7) % textureCount);
+		objects[i].uvScale		  = std::max(scale / TEXTURE_REPEAT, 1.0f);
+
+		// The virtual texture stretches once across the ground, untinted
+		if (virtualTexture && object.ground) {
+			objects[i].color		= glm::vec4(1.0f);
+			objects[i].textureIndex = VIRTUAL_TEXTURE_INDEX;
+			objects[i].uvScale		= 1.0f;
+		}
+
+		objectsPerMesh[object.meshIndex]++;
+	}
+
+	// Room for every cluster of every object in each phase, the full detail level has the most
+	clusterCapacity = 0;
+	for (size_t i = 0; i < meshData.size(); i++) {
+		clusterCapacity += objectsPerMesh[i] * lodData[meshData[i].firstLod].meshletCount;
+	}
+	meshletCount = static_cast<uint32_t>(meshlets.size());
+	visibleStride = 0;
+	for (size_t i = 0; i < meshData.size(); i++) {
+		for (uint32_t lod = 0; lod < meshData[i].lodCount; lod++) {
+			lodData[meshData[i].firstLod + lod].visibleBase = visibleStride;
+			visibleStride += objectsPerMesh[i];
+		}
+	}
+
+	VkDeviceSize vertexSize = sizeof(Vertex) * sceneVertices.size();
+	VkDeviceSize indexSize = sizeof(uint32_t) * sceneIndices.size();
+	VkDeviceSize meshSize = sizeof(MeshData) * meshData.size();
+	VkDeviceSize objectSize = sizeof(ObjectData) * objects.size();
+	VkDeviceSize meshletSize = sizeof(MeshletData) * meshlets.size();
+	VkDeviceSize lodSize = sizeof(LodData) * lodData.size();
+
+	vertexBuffer = vkutil::createBuffer(logicalDevice, physicalDevice, vertexSize,
+		VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+	indexBuffer = vkutil::createBuffer(logicalDevice, physicalDevice, indexSize,
+		VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+	meshBuffer = vkutil::createBuffer(logicalDevice, physicalDevice, meshSize,
+		VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+	objectBuffer = vkutil::createBuffer(logicalDevice, physicalDevice, objectSize,
+		VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+	meshletBuffer = vkutil::createBuffer(logicalDevice, physicalDevice, meshletSize,
+		VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+	lodBuffer = vkutil::createBuffer(logicalDevice, physicalDevice, lodSize,
+		VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+	vkutil::uploadBuffer(logicalDevice, physicalDevice, commandPool, graphicsQueue, vertexBuffer, sceneVertices.data(), vertexSize);
+	vkutil::uploadBuffer(logicalDevice, physicalDevice, commandPool, graphicsQueue, indexBuffer, sceneIndices.data(), indexSize);
+	vkutil::uploadBuffer(logicalDevice, physicalDevice, commandPool, graphicsQueue, meshBuffer, meshData.data(), meshSize);
+	vkutil::uploadBuffer(logicalDevice, physicalDevice, commandPool, graphicsQueue, objectBuffer, objects.data(), objectSize);
+	vkutil::uploadBuffer(logicalDevice, physicalDevice, commandPool, graphicsQueue, meshletBuffer, meshlets.data(), meshletSize);
+	vkutil::uploadBuffer(logicalDevice, physicalDevice, commandPool, graphicsQueue, lodBuffer, lodData.data(), lodSize);
+
+	// Camera changes every frame, so each frame in flight gets its own copy
+	cameraBuffers.resize(MAX_FRAMES_IN_FLIGHT);
+	for (auto& buffer : cameraBuffers) {
+		buffer = vkutil::createBuffer(logicalDevice, physicalDevice, sizeof(CameraData),
+			VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+	}
+
+	// The ground only receives, what stands on it casts. Dynamic objects are drawn every frame even into cached cascades
+	std::vector<ShadowMaps::Caster> casters(scene.objects.size());
+	for (size_t i = 0; i < scene.objects.size(); i++) {
+		const SceneObject& object = scene.objects[i];
+		casters[i] = object.ground ? ShadowMaps::Caster::None : object.dynamic ? ShadowMaps::Caster::Dynamic : ShadowMaps::Caster::Static;
+	}
+	shadowMaps->setCasters(objects, casters, meshData, lodData, vertexBuffer.buffer, indexBuffer.buffer);
+
+	if (textureStreamer) {
+		textureStreamer->loadTails(commandPool, graphicsQueue);
+	}
+	if (virtualTexture) {
+		virtualTexture->loadRoot(commandPool, graphicsQueue);
+	}
+
+	std::cout << "Scene: " << scene.objects.size() << " objects, " << sceneIndices.size() / 3 << " triangles in "
+		<< scene.meshes.size() << " meshes, " << lodData.size() << " levels of detail, " << meshletCount << " meshlets" << std::endl;
+}
+
+void VulkanApplication::createCullingBuffers() {
+	uint32_t objectCount = static_cast<uint32_t>(scene.objects.size());
+
+	// One command per level of detail with no instances, the culling passes fill in the instance counts
+	std::vector<VkDrawIndexedIndirectCommand> drawTemplate(lodData.size());
+	for (size_t mesh = 0; mesh < meshData.size(); mesh++) {
+		for (uint32_t lod = 0; lod < meshData[mesh].lodCount; lod++) {
+			uint32_t i = meshData[mesh].firstLod + lod;
+			drawTemplate[i].indexCount	  = lodData[i].indexCount;
+			drawTemplate[i].instanceCount = 0;
+			drawTemplate[i].firstIndex	  = lodData[i].firstIndex;
+			drawTemplate[i].vertexOffset  = meshData[mesh].vertexOffset;
+			drawTemplate[i].firstInstance = 0;
+		}
+	}
+	VkDeviceSize templateSize = sizeof(VkDrawIndexedIndirectCommand) * drawTemplate.size();
+
+	drawTemplateBuffer = vkutil::createBuffer(logicalDevice, physicalDevice, templateSize,
+		VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+	vkutil::uploadBuffer(logicalDevice, physicalDevice, commandPool, graphicsQueue, drawTemplateBuffer, drawTemplate.data(), templateSize);
+
+	// Both culling phases write their own commands and ids
+	drawCommandBuffer = vkutil::createBuffer(logicalDevice, physicalDevice, templateSize * 2,
+		VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+	visibleIdBuffer = vkutil::createBuffer(logicalDevice, physicalDevice, sizeof(uint32_t) * visibleStride * 2,
+		VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+	// Nothing was visible before the first frame, the second phase will pick everything up
+	std::vector<uint32_t> visibility(objectCount, 0);
+	visibilityBuffer = vkutil::createBuffer(logicalDevice, physicalDevice, sizeof(uint32_t) * objectCount,
+		VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+	vkutil::uploadBuffer(logicalDevice, physicalDevice, commandPool, graphicsQueue, visibilityBuffer, visibility.data(), visibilityBuffer.size);
+
+	// Everything starts out at full detail, the same zeros do
+	lodStateBuffer = vkutil::createBuffer(logicalDevice, physicalDevice, sizeof(uint32_t) * objectCount,
+		VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+	vkutil::uploadBuffer(logicalDevice, physicalDevice, commandPool, graphicsQueue, lodStateBuffer, visibility.data(), lodStateBuffer.size);
+
+	// Dispatch headers for both phases followed by the object lists
+	clusterObjectBuffer = vkutil::createBuffer(logicalDevice, physicalDevice, sizeof(ClusterDispatch) * 2 + sizeof(uint32_t) * objectCount * 2,
+		VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+	clusterDrawBuffer = vkutil::createBuffer(logicalDevice, physicalDevice, sizeof(VkDrawIndexedIndirectCommand) * clusterCapacity * 2,
+		VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+	// Cluster commands written by both phases, then the triangles they draw
+	clusterCountBuffer = vkutil::createBuffer(logicalDevice, physicalDevice, sizeof(uint32_t) * 4,
+		VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+	VkPhysicalDeviceProperties properties;
+	vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+	if (meshletsSupported && clusterCapacity > properties.limits.maxDrawIndirectCount) {
+		std::cout << "Scene has more clusters than one indirect draw allows, meshlets disabled" << std::endl;
+		meshletsSupported = false;
+	}
+	// Every object may survive culling and take a workgroup of the cluster dispatch
+	uint64_t clusterWorkgroups = static_cast<uint64_t>(CLUSTER_DISPATCH_WIDTH) * properties.limits.maxComputeWorkGroupCount[1];
+	if (meshletsSupported && (CLUSTER_DISPATCH_WIDTH > properties.limits.maxComputeWorkGroupCount[0] || objectCount > clusterWorkgroups)) {
+		std::cout << "Scene has more objects than one cluster dispatch allows, meshlets disabled" << std::endl;
+		meshletsSupported = false;
+	}
+
+	// Draw commands followed by the cluster counts of both phases
+	statsBuffers.resize(MAX_FRAMES_IN_FLIGHT);
+	for (auto& buffer : statsBuffers) {
+		buffer = vkutil::createBuffer(logicalDevice, physicalDevice, drawCommandBuffer.size + clusterCountBuffer.size,
+			VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+	}
+
+	occlusionCuller = std::make_unique<OcclusionCuller>(scene, threadPool);
+	std::cout << "Cpu occlusion culling: " << OcclusionRasterizer::implementationName(occlusionCuller->getRasterizer().getImplementation())
+		<< " rasterizer on " << threadPool.getThreadCount() + 1 << " threads" << std::endl;
+
+	cpuCullBuffers.resize(MAX_FRAMES_IN_FLIGHT);
+	for (auto& buffer : cpuCullBuffers) {
+		buffer = vkutil::createBuffer(logicalDevice, physicalDevice, drawCommandBuffer.size + sizeof(uint32_t) * visibleStride,
+			VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+	}
+}
+
+void VulkanApplication::createHiZResources() {
+	// Round down to a power of two so every level above the first is an exact 2x2 reduction
+	auto previousPowerOfTwo = [](uint32_t value) {
+		uint32_t result = 1;
+		while (result * 2 <= value) {
+			result *= 2;
+		}
+		return result;
+	};
+
+	VkExtent2D extent = { previousPowerOfTwo(swapChainExtent.width), previousPowerOfTwo(swapChainExtent.height) };
+	uint32_t mipLevels = static_cast<uint32_t>(std::floor(std::log2(std::max(extent.width, extent.height)))) + 1;
+
+	hiZImage = vkutil::createImage(logicalDevice, physicalDevice, extent, mipLevels, VK_FORMAT_R32_SFLOAT,
+		VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_STORAGE_BIT, VK_IMAGE_ASPECT_COLOR_BIT);
+
+	hiZMipViews.resize(mipLevels);
+	for (uint32_t i = 0; i < mipLevels; i++) {
+		hiZMipViews[i] = vkutil::createImageView(logicalDevice, hiZImage.image, VK_FORMAT_R32_SFLOAT, VK_IMAGE_ASPECT_COLOR_BIT, i, 1);
+	}
+
+	// Levels past what one dispatch writes fall back to a dispatch each, as does a pyramid of a single level
+	uint32_t downsampledLevels = mipLevels - 1;
+	if (hiZDownsampler && downsampledLevels > 0 && downsampledLevels <= Downsampler::MAX_LEVELS) {
+		hiZDownsampleTarget = hiZDownsampler->createTarget(hiZImage.image, extent, 0, downsampledLevels, commandPool, graphicsQueue);
+	}
+
+	// Built in the general layout and sampled in the read only one. The render graph expects it in the latter between frames
+	VkCommandBuffer commandBuffer = vkutil::beginSingleTimeCommands(logicalDevice, commandPool);
+	vkutil::imageBarrier(commandBuffer, hiZImage.image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+		VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, 0, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT);
+	vkutil::endSingleTimeCommands(logicalDevice, commandPool, graphicsQueue, commandBuffer);
+}
+
+void VulkanApplication::createTextureStreamer() {
+	if (!settings.textures || !texturesSupported) {
+		return;
+	}
+
+	TextureStreamer::Config config;
+	config.textureSize			= settings.textureSize;
+	config.budget				= static_cast<VkDeviceSize>(settings.textureBudgetMB) * 1024 * 1024;
+	config.framesInFlight		= static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
+	config.getMemoryProperties2 = memoryBudgetSupported ? getPhysicalDeviceMemoryProperties2 : nullptr;
+	config.assets				= assets.get();
+	config.bakedDirectory		= TextureBaker::ASSET_DIRECTORY;
+	config.blockCompression		= blockCompressionSupported;
+	config.decodeThreads		= 2;
+
+	textureStreamer = std::make_unique<TextureStreamer>(logicalDevice, physicalDevice, config);
+}
+
+void VulkanApplication::createLightClusters() {
+	LightClusters::Config config;
+	config.maxLights	  = settings.lightCount;
+	config.framesInFlight = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
+	if (computeQueue != VK_NULL_HANDLE) {
+		config.queueFamilies = { indices.graphicsFamily.value(), indices.computeFamily.value() };
+	}
+
+	lightClusters = std::make_unique<LightClusters>(logicalDevice, physicalDevice, *assets, config);
+}
+
+void VulkanApplication::createShadowMaps() {
+	ShadowMaps::Config config;
+	config.cascadeSize	  = settings.shadowMapSize;
+	config.distance		  = settings.shadowDistance;
+	config.caching		  = settings.shadowCache;
+	config.framesInFlight = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
+
+	shadowMaps = std::make_unique<ShadowMaps>(logicalDevice, physicalDevice, *assets, frameSetLayout, config);
+}
+
+void VulkanApplication::createPostProcess() {
+	PostProcess::Config config;
+	config.bloom			   = settings.bloom;
+	config.autoExposure		   = settings.autoExposure;
+	config.subgroups		   = postSubgroupsSupported;
+	config.outputWithoutFormat = storageWithoutFormatSupported;
+
+	postProcess = std::make_unique<PostProcess>(logicalDevice, physicalDevice, *assets, config);
+}
+
+void VulkanApplication::createParticleSystem() {
+	if (settings.particleCount == 0) {
+		return;
+	}
+
+	ParticleSystem::Config config;
+	config.capacity		  = settings.particleCount;
+	config.framesInFlight = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
+
+	particleSystem = std::make_unique<ParticleSystem>(logicalDevice, physicalDevice, *assets, config);
+}
+
+void VulkanApplication::createDynamicResolution() {
+	if (!timestampsSupported) {
+		return;
+	}
+
+	DynamicResolution::Config config;
+	config.targetMs = settings.targetFrameMs;
+	config.minScale = settings.minRenderScale;
+	config.maxScale = settings.maxRenderScale;
+
+	dynamicResolution = std::make_unique<DynamicResolution>(config);
+}
+
+void VulkanApplication::createFrameCapture() {
+	if (!captureSupported) {
+		return;
+	}
+
+	// Enough buffers for every frame in flight while a few before them are still being encoded
+	FrameCapture::Config config;
+	config.directory = settings.captureDirectory;
+	config.format	 = settings.captureFormat;
+	config.ringSize	 = MAX_FRAMES_IN_FLIGHT + 4;
+	config.threads	 = 2;
+	frameCapture = std::make_unique<FrameCapture>(logicalDevice, physicalDevice, config);
+}
+
+void VulkanApplication::createVirtualTexture() {
+	if (!settings.virtualTexture || !virtualTextureSupported) {
+		return;
+	}
+
+	VirtualTexture::Config config;
+	config.pagesPerSide	   = settings.virtualTexturePages;
+	config.cacheBytes	   = static_cast<VkDeviceSize>(settings.virtualTextureCacheMB) * 1024 * 1024;
+	config.framesInFlight  = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
+	config.generateThreads = 2;
+
+	virtualTexture = std::make_unique<VirtualTexture>(logicalDevice, physicalDevice, config);
+}
+
+void VulkanApplication::createDescriptorSetLayouts() {
+	// Everything the scene shaders and the culling pass share, one set per frame in flight
+	VkDescriptorSetLayoutBinding frameBindings[FRAME_BINDING_COUNT] = {};
+	const VkDescriptorType frameTypes[FRAME_BINDING_COUNT] = {
+		VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,			// camera
+		VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,			// objects
+		VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,			// meshes
+		VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,			// draw commands
+		VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,			// visible ids
+		VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,			// visibility
+		VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,	// depth pyramid
+		VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,			// meshlets
+		VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,			// cluster objects
+		VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,			// cluster draws
+		VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,			// cluster counts
+		VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,			// levels of detail
+		VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,			// level of detail per object
+		VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,	// streamed textures
+	};
+	const VkShaderStageFlags frameStages[FRAME_BINDING_COUNT] = {
+		VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_COMPUTE_BIT,
+		VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_COMPUTE_BIT,
+		VK_SHADER_STAGE_COMPUTE_BIT,
+		VK_SHADER_STAGE_COMPUTE_BIT,
+		VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_COMPUTE_BIT,
+		VK_SHADER_STAGE_COMPUTE_BIT,
+		VK_SHADER_STAGE_COMPUTE_BIT,
+		VK_SHADER_STAGE_COMPUTE_BIT,
+		VK_SHADER_STAGE_COMPUTE_BIT,
+		VK_SHADER_STAGE_COMPUTE_BIT,
+		VK_SHADER_STAGE_COMPUTE_BIT,
+		VK_SHADER_STAGE_COMPUTE_BIT,
+		VK_SHADER_STAGE_COMPUTE_BIT,
+		VK_SHADER_STAGE_FRAGMENT_BIT,
+	};
+
+	for (uint32_t i = 0; i < FRAME_BINDING_COUNT; i++) {
+		frameBindings[i].binding		 = i;
+		frameBindings[i].descriptorType	 = frameTypes[i];
+		frameBindings[i].descriptorCount = 1;
+		frameBindings[i].stageFlags		 = frameStages[i];
+	}
+
+	// One descriptor per streamed texture, none without textures
+	frameBindings[TEXTURE_BINDING].descriptorCount = textureStreamer ? textureStreamer->getTextureCount() : 0;
+
+	VkDescriptorSetLayoutCreateInfo layoutInfo = {};
+	layoutInfo.sType		= VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	layoutInfo.bindingCount = FRAME_BINDING_COUNT;
+	layoutInfo.pBindings	= frameBindings;
+
+	if (vkCreateDescriptorSetLayout(logicalDevice, &layoutInfo, nullptr, &frameSetLayout) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create frame descriptor set layout.");
+	}
+
+	// Source and destination of one depth pyramid reduction
+	VkDescriptorSetLayoutBinding hiZBindings[2] = {};
+	hiZBindings[0].binding			= 0;
+	hiZBindings[0].descriptorType	= VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	hiZBindings[0].descriptorCount	= 1;
+	hiZBindings[0].stageFlags		= VK_SHADER_STAGE_COMPUTE_BIT;
+	hiZBindings[1].binding			= 1;
+	hiZBindings[1].descriptorType	= VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+	hiZBindings[1].descriptorCount	= 1;
+	hiZBindings[1].stageFlags		= VK_SHADER_STAGE_COMPUTE_BIT;
+
+	layoutInfo.bindingCount = 2;
+	layoutInfo.pBindings	= hiZBindings;
+
+	if (vkCreateDescriptorSetLayout(logicalDevice, &layoutInfo, nullptr, &hiZSetLayout) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create depth pyramid descriptor set layout.");
+	}
+}
+
+void VulkanApplication::createDescriptorPool() {
+	uint32_t frames = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
+	uint32_t mips = static_cast<uint32_t>(hiZMipViews.size());
+	uint32_t textures = textureStreamer ? textureStreamer->getTextureCount() : 0;
+
+	VkDescriptorPoolSize poolSizes[4] = {};
+	poolSizes[0].type			 = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+	poolSizes[0].descriptorCount = frames;
+	poolSizes[1].type			 = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	poolSizes[1].descriptorCount = frames * (FRAME_BINDING_COUNT - 3);
+	poolSizes[2].type			 = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	poolSizes[2].descriptorCount = frames * (1 + textures) + mips;
+	poolSizes[3].type			 = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+	poolSizes[3].descriptorCount = mips;
+
+	VkDescriptorPoolCreateInfo poolInfo = {};
+	poolInfo.sType			= VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+	poolInfo.poolSizeCount	= 4;
+	poolInfo.pPoolSizes		= poolSizes;
+	poolInfo.maxSets		= frames + mips;
+
+	if (vkCreateDescriptorPool(logicalDevice, &poolInfo, nullptr, &descriptorPool) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create descriptor pool.");
+	}
+}
+
+void VulkanApplication::createDescriptorSets() {
+	// Frame sets
+	std::vector<VkDescriptorSetLayout> frameLayouts(MAX_FRAMES_IN_FLIGHT, frameSetLayout);
+	frameDescriptorSets.resize(MAX_FRAMES_IN_FLIGHT);
+
+	VkDescriptorSetAllocateInfo allocInfo = {};
+	allocInfo.sType				 = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+	allocInfo.descriptorPool	 = descriptorPool;
+	allocInfo.descriptorSetCount = static_cast<uint32_t>(frameLayouts.size());
+	allocInfo.pSetLayouts		 = frameLayouts.data();
+
+	if (vkAllocateDescriptorSets(logicalDevice, &allocInfo, frameDescriptorSets.data()) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to allocate frame descriptor sets.");
+	}
+
+	for (size_t i = 0; i < frameDescriptorSets.size(); i++) {
+		// Every binding but the depth pyramid and the textures is a buffer
+		VkDescriptorBufferInfo bufferInfos[FRAME_BINDING_COUNT] = {};
+		const VkBuffer buffers[FRAME_BINDING_COUNT] = {
+			cameraBuffers[i].buffer, objectBuffer.buffer, meshBuffer.buffer,
+			drawCommandBuffer.buffer, visibleIdBuffer.buffer, visibilityBuffer.buffer, VK_NULL_HANDLE,
+			meshletBuffer.buffer, clusterObjectBuffer.buffer, clusterDrawBuffer.buffer, clusterCountBuffer.buffer,
+			lodBuffer.buffer, lodStateBuffer.buffer, VK_NULL_HANDLE
+		};
+
+		VkWriteDescriptorSet writes[FRAME_BINDING_COUNT] = {};
+		for (uint32_t binding = 0; binding < TEXTURE_BINDING; binding++) {
+			if (binding == 6) {
+				continue;
+			}
+
+			bufferInfos[binding].buffer = buffers[binding];
+			bufferInfos[binding].offset = 0;
+			bufferInfos[binding].range	= VK_WHOLE_SIZE;
+
+			writes[binding].sType			= VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+			writes[binding].dstSet			= frameDescriptorSets[i];
+			writes[binding].dstBinding		= binding;
+			writes[binding].descriptorCount = 1;
+			writes[binding].descriptorType	= binding == 0 ? VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER : VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+			writes[binding].pBufferInfo		= &bufferInfos[binding];
+		}
+
+		VkDescriptorImageInfo hiZInfo = {};
+		hiZInfo.sampler		= hiZSampler;
+		hiZInfo.imageView	= hiZImage.view;
+		hiZInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+		writes[6].sType				= VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		writes[6].dstSet			= frameDescriptorSets[i];
+		writes[6].dstBinding		= 6;
+		writes[6].descriptorCount	= 1;
+		writes[6].descriptorType	= VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+		writes[6].pImageInfo		= &hiZInfo;
+
+		// The textures come last and change as they stream, they are written on their own
+		vkUpdateDescriptorSets(logicalDevice, TEXTURE_BINDING, writes, 0, nullptr);
+	}
+
+	textureVersions.assign(MAX_FRAMES_IN_FLIGHT, 0);
+	for (uint32_t i = 0; i < frameDescriptorSets.size(); i++) {
+		updateTextureDescriptors(i);
+	}
+
+	// One set per pyramid level, reading the level below it. The first level reads the depth buffer
+	std::vector<VkDescriptorSetLayout> hiZLayouts(hiZMipViews.size(), hiZSetLayout);
+	hiZDescriptorSets.resize(hiZMipViews.size());
+
+	allocInfo.descriptorSetCount = static_cast<uint32_t>(hiZLayouts.size());
+	allocInfo.pSetLayouts		 = hiZLayouts.data();
+
+	if (vkAllocateDescriptorSets(logicalDevice, &allocInfo, hiZDescriptorSets.data()) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to allocate depth pyramid descriptor sets.");
+	}
+
+	// Without the pyramid the depth buffer is not sampled and may not even be sampleable, the first set
+	// then points at the pyramid itself and is never used
+	bool sampleDepth = settings.cullingMode == CullingMode::HiZ;
+	for (size_t i = 0; i < hiZDescriptorSets.size(); i++) {
+		VkDescriptorImageInfo srcInfo = {};
+		srcInfo.sampler		= hiZSampler;
+		srcInfo.imageView	= i == 0 && sampleDepth ? renderGraph.getImageView(depthResource) : hiZMipViews[i == 0 ? 0 : i - 1];
+		srcInfo.imageLayout = i == 0 && sampleDepth ? VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL : VK_IMAGE_LAYOUT_GENERAL;
+
+		VkDescriptorImageInfo dstInfo = {};
+		dstInfo.imageView	= hiZMipViews[i];
+		dstInfo.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+
+		VkWriteDescriptorSet writes[2] = {};
+		writes[0].sType				= VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		writes[0].dstSet			= hiZDescriptorSets[i];
+		writes[0].dstBinding		= 0;
+		writes[0].descriptorCount	= 1;
+		writes[0].descriptorType	= VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+		writes[0].pImageInfo		= &srcInfo;
+
+		writes[1].sType				= VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		writes[1].dstSet			= hiZDescriptorSets[i];
+		writes[1].dstBinding		= 1;
+		writes[1].descriptorCount	= 1;
+		writes[1].descriptorType	= VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+		writes[1].pImageInfo		= &dstInfo;
+
+		vkUpdateDescriptorSets(logicalDevice, 2, writes, 0, nullptr);
+	}
+}
+
+void VulkanApplication::createComputePipelines() {
+	// Culling
+	VkPushConstantRange cullRange = {};
+	cullRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+	cullRange.offset	 = 0;
+	cullRange.size		 = sizeof(CullPushConstants);
+
+	VkPipelineLayoutCreateInfo layoutInfo = {};
+	layoutInfo.sType					= VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+	layoutInfo.setLayoutCount			= 1;
+	layoutInfo.pSetLayouts				= &frameSetLayout;
+	layoutInfo.pushConstantRangeCount	= 1;
+	layoutInfo.pPushConstantRanges		= &cullRange;
+
+	if (vkCreatePipelineLayout(logicalDevice, &layoutInfo, nullptr, &cullPipelineLayout) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create culling pipeline layout.");
+	}
+	cullPipeline = vkutil::createComputePipeline(logicalDevice, assets->load("src/shaders/cull_comp.spv"), cullPipelineLayout);
+	clusterPipeline = vkutil::createComputePipeline(logicalDevice, assets->load("src/shaders/cluster_comp.spv"), cullPipelineLayout);
+
+	// Depth pyramid
+	VkPushConstantRange hiZRange = {};
+	hiZRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+	hiZRange.offset		= 0;
+	hiZRange.size		= sizeof(HiZPushConstants);
+
+	layoutInfo.pSetLayouts			= &hiZSetLayout;
+	layoutInfo.pPushConstantRanges	= &hiZRange;
+
+	if (vkCreatePipelineLayout(logicalDevice, &layoutInfo, nullptr, &hiZPipelineLayout) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create depth pyramid pipeline layout.");
+	}
+	hiZPipeline = vkutil::createComputePipeline(logicalDevice, assets->load("src/shaders/hiz_comp.spv"), hiZPipelineLayout);
+	if (msaaSamples != VK_SAMPLE_COUNT_1_BIT) {
+		hiZMultisamplePipeline = vkutil::createComputePipeline(logicalDevice, assets->load("src/shaders/hiz_ms_comp.spv"), hiZPipelineLayout);
+	}
+
+	// Everything below the first level in one dispatch, keeping the farthest depth like hiz.comp does
+	if (downsamplerSupported && settings.singlePassHiZ) {
+		hiZDownsampler = std::make_unique<Downsampler>(logicalDevice, physicalDevice, *assets, VK_FORMAT_R32_SFLOAT,
+			Downsampler::Reduction::Max, false, subgroupQuadSupported, 1);
+	}
+
+	// Texel fetches only, but sampled images still need a sampler
+	VkSamplerCreateInfo samplerInfo = {};
+	samplerInfo.sType		 = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+	samplerInfo.magFilter	 = VK_FILTER_NEAREST;
+	samplerInfo.minFilter	 = VK_FILTER_NEAREST;
+	samplerInfo.mipmapMode	 = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+	samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+	samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+	samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+	samplerInfo.minLod		 = 0.0f;
+	samplerInfo.maxLod		 = 16.0f;
+
+	if (vkCreateSampler(logicalDevice, &samplerInfo, nullptr, &hiZSampler) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create depth pyramid sampler.");
+	}
+}
+
+void VulkanApplication::createQueryPools() {
+	frameSubmitted.assign(MAX_FRAMES_IN_FLIGHT, false);
+
+	VkPhysicalDeviceProperties properties;
+	vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+	timestampPeriod = properties.limits.timestampPeriod;
+
+	uint32_t queueFamilyCount = 0;
+	vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount, nullptr);
+	std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
+	vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount, queueFamilies.data());
+	timestampsSupported = queueFamilies[indices.graphicsFamily.value()].timestampValidBits > 0;
+	computeTimestampsSupported = timestampsSupported && computeQueue != VK_NULL_HANDLE &&
+		queueFamilies[indices.computeFamily.value()].timestampValidBits > 0;
+
+	VkQueryPoolCreateInfo queryPoolInfo = {};
+	queryPoolInfo.sType		 = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+	queryPoolInfo.queryType	 = VK_QUERY_TYPE_TIMESTAMP;
+	queryPoolInfo.queryCount = MAX_FRAMES_IN_FLIGHT * TIMESTAMP_COUNT;
+
+	if (vkCreateQueryPool(logicalDevice, &queryPoolInfo, nullptr, &queryPool) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create timestamp query pool.");
+	}
+}
+
+void VulkanApplication::updateCamera(uint32_t frame) {
+	// Slow orbit at street level, looking across the city so buildings hide most of it
+	float time = static_cast<float>(frameTime()) * 0.05f;
+	float radius = scene.extent * 0.6f;
+
+	camera.orbit(time + static_cast<float>(input.orbitOffset), radius);
+	camera.farPlane = scene.extent * 4.0f;
+
+	float aspect = swapChainExtent.width / static_cast<float>(swapChainExtent.height);
+	CameraData data = camera.getCameraData(aspect);
+	memcpy(cameraBuffers[frame].mapped, &data, sizeof(data));
+
+	if (settings.cullingMode == CullingMode::CpuOcclusion) {
+		runCpuCulling(frame, data);
+	}
+	if (textureStreamer) {
+		updateTextureStreaming(frame, data);
+	}
+	if (virtualTexture) {
+		virtualTexture->update(frame);
+	}
+	updateLights(frame, data);
+	shadowMaps->update(frame, data);
+	if (particleSystem) {
+		particleSystem->update(frame, data, renderExtent, frameDelta);
+	}
+}
+
+void VulkanApplication::updateLights(uint32_t frame, const CameraData& cameraData) {
+	scene.getLights(static_cast<float>(frameTime()), frameLights);
+	lightClusters->update(frame, cameraData, renderExtent, frameLights, !settings.lightBinning);
+}
+
+void VulkanApplication::runCpuCulling(uint32_t frame, const CameraData& cameraData) {
+	OcclusionCuller::Stats stats = occlusionCuller->cull(cameraData, cpuVisible);
+
+	// Same layout the culling shader produces, with only the first phase drawing anything
+	auto commands = reinterpret_cast<VkDrawIndexedIndirectCommand*>(cpuCullBuffers[frame].mapped);
+	auto visibleIds = reinterpret_cast<uint32_t*>(static_cast<char*>(cpuCullBuffers[frame].mapped) + drawCommandBuffer.size);
+
+	for (size_t mesh = 0; mesh < meshData.size(); mesh++) {
+		for (uint32_t lod = 0; lod < meshData[mesh].lodCount; lod++) {
+			uint32_t drawIndex = meshData[mesh].firstLod + lod;
+			for (uint32_t phase = 0; phase < 2; phase++) {
+				VkDrawIndexedIndirectCommand& command = commands[phase * lodData.size() + drawIndex];
+				command.indexCount	  = lodData[drawIndex].indexCount;
+				command.instanceCount = 0;
+				command.firstIndex	  = lodData[drawIndex].firstIndex;
+				command.vertexOffset  = meshData[mesh].vertexOffset;
+				command.firstInstance = 0;
+			}
+		}
+	}
+
+	// The cpu path does not select levels of detail, everything is drawn at full detail
+	for (uint32_t i = 0; i < cpuVisible.size(); i++) {
+		if (cpuVisible[i]) {
+			uint32_t drawIndex = meshData[scene.objects[i].meshIndex].firstLod;
+			visibleIds[lodData[drawIndex].visibleBase + commands[drawIndex].instanceCount++] = i;
+		}
+	}
+
+	frameStats.cpuFrames++;
+	frameStats.cpuFrustumVisible += stats.frustumVisible;
+	frameStats.cpuRasterMs += stats.rasterMs;
+	frameStats.cpuTestMs += stats.testMs;
+}
+
+void VulkanApplication::updateTextureStreaming(uint32_t frame, const CameraData& cameraData) {
+	// A texel per pixel is level 0 at textureSize texels per repeat, every halving of that density goes a level
+	// coarser. Objects are measured at the point of their bounding sphere closest to the camera
+	uint32_t mipCount = textureStreamer->getMipCount();
+	float texelsPerUnit = textureStreamer->getTextureSize() / TEXTURE_REPEAT;
+	float pixelsPerUnit = renderExtent.height / (2.0f * std::tan(camera.fovY * 0.5f));
+	textureDemand.assign(textureStreamer->getTextureCount(), mipCount);
+
+	for (const auto& object : objectData) {
+		if (object.textureIndex == VIRTUAL_TEXTURE_INDEX) {
+			continue;
+		}
+		const glm::vec4& sphere = object.boundingSphere;
+
+		bool insideFrustum = true;
+		for (const auto& plane : cameraData.frustumPlanes) {
+			if (glm::dot(glm::vec3(plane), glm::vec3(sphere)) + plane.w < -sphere.w) {
+				insideFrustum = false;
+				break;
+			}
+		}
+		if (!insideFrustum) {
+			continue;
+		}
+
+		float distance = std::max(glm::length(glm::vec3(sphere) - glm::vec3(cameraData.position)) - sphere.w, camera.nearPlane);
+		float texelsPerPixel = texelsPerUnit * distance / pixelsPerUnit;
+		uint32_t mip = texelsPerPixel > 1.0f ? static_cast<uint32_t>(std::log2(texelsPerPixel)) : 0;
+		textureDemand[object.textureIndex] = std::min(textureDemand[object.textureIndex], mip);
+	}
+
+	textureStreamer->update(frame, textureDemand);
+
+	// Images swapped in by this update are only safe to bind from now on, the other frame's set catches up
+	// when its turn comes
+	if (textureVersions[frame] != textureStreamer->getVersion()) {
+		updateTextureDescriptors(frame);
+	}
+}
+
+void VulkanApplication::updateTextureDescriptors(uint32_t frame) {
+	if (!textureStreamer) {
+		return;
+	}
+
+	std::vector<VkDescriptorImageInfo> imageInfos(textureStreamer->getTextureCount());
+	for (uint32_t i = 0; i < imageInfos.size(); i++) {
+		imageInfos[i].sampler	  = textureStreamer->getSampler();
+		imageInfos[i].imageView	  = textureStreamer->getView(i);
+		imageInfos[i].imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+	}
+
+	VkWriteDescriptorSet write = {};
+	write.sType			  = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	write.dstSet		  = frameDescriptorSets[frame];
+	write.dstBinding	  = TEXTURE_BINDING;
+	write.descriptorCount = static_cast<uint32_t>(imageInfos.size());
+	write.descriptorType  = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	write.pImageInfo	  = imageInfos.data();
+
+	vkUpdateDescriptorSets(logicalDevice, 1, &write, 0, nullptr);
+	textureVersions[frame] = textureStreamer->getVersion();
+}
+
+CullPushConstants VulkanApplication::getCullConstants(uint32_t phase) const {
+	CullPushConstants constants = {};
+	constants.objectCount	  = static_cast<uint32_t>(scene.objects.size());
+	constants.drawCount		  = static_cast<uint32_t>(lodData.size());
+	constants.phase			  = phase;
+	constants.mode			  = static_cast<uint32_t>(settings.cullingMode);
+	constants.hiZSize		  = glm::vec2(hiZImage.extent.width, hiZImage.extent.height);
+	constants.hiZMipCount	  = hiZImage.mipLevels;
+	constants.clusterCapacity = clusterCapacity;
+	constants.visibleStride	  = visibleStride;
+	constants.lodHysteresis	  = settings.lodHysteresis;
+	constants.renderScale	  = glm::vec2(renderExtent.width / static_cast<float>(swapChainExtent.width),
+		renderExtent.height / static_cast<float>(swapChainExtent.height));
+
+	// Pixels per world unit at distance 1, over the error we allow on screen
+	if (settings.lod) {
+		float pixelsPerUnit = renderExtent.height / (2.0f * std::tan(camera.fovY * 0.5f));
+		constants.lodScale = pixelsPerUnit / settings.lodPixelError;
+	}
+
+	return constants;
+}
+
+void VulkanApplication::recordCulling(VkCommandBuffer commandBuffer, uint32_t phase) {
+	CullPushConstants constants = getCullConstants(phase);
+
+	vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, cullPipeline);
+	vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, cullPipelineLayout, 0, 1, &frameDescriptorSets[currentFrame], 0, nullptr);
+	vkCmdPushConstants(commandBuffer, cullPipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(constants), &constants);
+	vkCmdDispatch(commandBuffer, (constants.objectCount + 63) / 64, 1, 1);
+}
+
+bool VulkanApplication::useClusterCulling() const {
+	// Without any culling there is nothing to gain from splitting draws, and the cpu path only culls objects
+	return meshletsSupported && settings.meshlets &&
+		(settings.cullingMode == CullingMode::Frustum || settings.cullingMode == CullingMode::HiZ);
+}
+
+void VulkanApplication::recordClusterCulling(VkCommandBuffer commandBuffer, uint32_t phase) {
+	if (!useClusterCulling()) {
+		return;
+	}
+
+	CullPushConstants constants = getCullConstants(phase);
+
+	vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, clusterPipeline);
+	vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, cullPipelineLayout, 0, 1, &frameDescriptorSets[currentFrame], 0, nullptr);
+	vkCmdPushConstants(commandBuffer, cullPipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(constants), &constants);
+	vkCmdDispatchIndirect(commandBuffer, clusterObjectBuffer.buffer, phase * sizeof(ClusterDispatch));
+}
+
+void VulkanApplication::recordSceneDraws(VkCommandBuffer commandBuffer, uint32_t phase) {
+	vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, graphicsPipeline);
+	vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &frameDescriptorSets[currentFrame], 0, nullptr);
+	VkDescriptorSet lightSet = lightClusters->getDescriptorSet(currentFrame);
+	vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 1, 1, &lightSet, 0, nullptr);
+	VkDescriptorSet shadowSet = shadowMaps->getDescriptorSet(currentFrame);
+	vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 2, 1, &shadowSet, 0, nullptr);
+	if (virtualTexture) {
+		VkDescriptorSet virtualTextureSet = virtualTexture->getDescriptorSet(currentFrame);
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 3, 1, &virtualTextureSet, 0, nullptr);
+	}
+
+	VkViewport viewport = {};
+	viewport.width	  = static_cast<float>(renderExtent.width);
+	viewport.height	  = static_cast<float>(renderExtent.height);
+	viewport.maxDepth = 1.0f;
+
+	VkRect2D scissor = {};
+	scissor.extent = renderExtent;
+
+	vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+	vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+
+	VkDeviceSize offset = 0;
+	vkCmdBindVertexBuffers(commandBuffer, 0, 1, &vertexBuffer.buffer, &offset);
+	vkCmdBindIndexBuffer(commandBuffer, indexBuffer.buffer, 0, VK_INDEX_TYPE_UINT32);
+
+	// Every visible cluster is its own draw, all of them in one call
+	if (useClusterCulling()) {
+		VkDeviceSize commandOffset = phase * clusterCapacity * sizeof(VkDrawIndexedIndirectCommand);
+
+		vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(uint32_t), &CLUSTER_DRAW);
+		if (drawIndirectCountSupported) {
+			cmdDrawIndexedIndirectCount(commandBuffer, clusterDrawBuffer.buffer, commandOffset, clusterCountBuffer.buffer,
+				phase * sizeof(uint32_t), clusterCapacity, sizeof(VkDrawIndexedIndirectCommand));
+		} else {
+			vkCmdDrawIndexedIndirect(commandBuffer, clusterDrawBuffer.buffer, commandOffset, clusterCapacity, sizeof(VkDrawIndexedIndirectCommand));
+		}
+		return;
+	}
+
+	// One indirect draw per level of detail, instancing every object the culling pass let through
+	for (size_t lod = 0; lod < lodData.size(); lod++) {
+		uint32_t visibleBase = phase * visibleStride + lodData[lod].visibleBase;
+		VkDeviceSize commandOffset = (phase * lodData.size() + lod) * sizeof(VkDrawIndexedIndirectCommand);
+
+		vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(uint32_t), &visibleBase);
+		vkCmdDrawIndexedIndirect(commandBuffer, drawCommandBuffer.buffer, commandOffset, 1, sizeof(VkDrawIndexedIndirectCommand));
+	}
+}
+
+void VulkanApplication::recordHiZBuild(VkCommandBuffer commandBuffer) {
+	if (hiZDownsampleTarget.levelCount == 0) {
+		recordHiZLevels(commandBuffer, 0, hiZImage.mipLevels);
+		return;
+	}
+
+	// The first level reduces the depth buffer, the barrier after it lets the downsampler read it
+	recordHiZLevels(commandBuffer, 0, 1);
+	hiZDownsampler->record(commandBuffer, hiZDownsampleTarget);
+}
+
+void VulkanApplication::recordHiZLevels(VkCommandBuffer commandBuffer, uint32_t firstLevel, uint32_t endLevel) {
+	HiZPushConstants constants = {};
+	constants.srcSize = firstLevel == 0 ? glm::ivec2(swapChainExtent.width, swapChainExtent.height) : glm::ivec2(
+		std::max(hiZImage.extent.width >> (firstLevel - 1), 1u),
+		std::max(hiZImage.extent.height >> (firstLevel - 1), 1u));
+
+	for (uint32_t level = firstLevel; level < endLevel; level++) {
+		// Only the first level reads the depth buffer, which may be multisampled
+		if (level == firstLevel || level == 1) {
+			bool multisampled = level == 0 && hiZMultisamplePipeline != VK_NULL_HANDLE;
+			vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, multisampled ? hiZMultisamplePipeline : hiZPipeline);
+		}
+
+		constants.dstSize = glm::ivec2(
+			std::max(hiZImage.extent.width >> level, 1u),
+			std::max(hiZImage.extent.height >> level, 1u));
+
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, hiZPipelineLayout, 0, 1, &hiZDescriptorSets[level], 0, nullptr);
+		vkCmdPushConstants(commandBuffer, hiZPipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(constants), &constants);
+		vkCmdDispatch(commandBuffer, (constants.dstSize.x + 7) / 8, (constants.dstSize.y + 7) / 8, 1);
+
+		// Next level reads what we just wrote. The render graph hands the last one to the late culling pass
+		if (level + 1 < hiZImage.mipLevels) {
+			vkutil::imageBarrier(commandBuffer, hiZImage.image, VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_GENERAL,
+				VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT,
+				VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT,
+				VK_IMAGE_ASPECT_COLOR_BIT, level, 1);
+		}
+
+		constants.srcSize = constants.dstSize;
+	}
+}
+
+void VulkanApplication::runDownsampleBenchmark() {
+	if (!timestampsSupported) {
+		std::cout << "Downsample benchmark: the device has no timestamps" << std::endl;
+		return;
+	}
+	if (!downsamplerSupported || !Downsampler::isSupported(physicalDevice, VK_FORMAT_R8G8B8A8_UNORM)) {
+		std::cout << "Downsample benchmark: the single pass downsampler is not supported by this device" << std::endl;
+		return;
+	}
+
+	// Every run is repeated, the times printed are per run
+	const uint32_t iterations = 16;
+	const uint32_t colorSize = 4096;
+	uint32_t colorLevels = static_cast<uint32_t>(std::log2(colorSize)) + 1;
+
+	vkutil::Image color = vkutil::createImage(logicalDevice, physicalDevice, { colorSize, colorSize }, colorLevels, VK_FORMAT_R8G8B8A8_UNORM,
+		VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT,
+		VK_IMAGE_ASPECT_COLOR_BIT);
+	Downsampler colorDownsampler(logicalDevice, physicalDevice, *assets, VK_FORMAT_R8G8B8A8_UNORM, Downsampler::Reduction::Average, false,
+		subgroupQuadSupported, 1);
+	Downsampler::Target colorTarget = colorDownsampler.createTarget(color.image, color.extent, 0, colorLevels - 1, commandPool, graphicsQueue);
+
+	// Measured whatever the settings say, so the depth pyramid gets its own
+	Downsampler depthDownsampler(logicalDevice, physicalDevice, *assets, VK_FORMAT_R32_SFLOAT, Downsampler::Reduction::Max, false,
+		subgroupQuadSupported, 1);
+	Downsampler::Target depthTarget;
+	if (hiZImage.mipLevels > 1 && hiZImage.mipLevels - 1 <= Downsampler::MAX_LEVELS) {
+		depthTarget = depthDownsampler.createTarget(hiZImage.image, hiZImage.extent, 0, hiZImage.mipLevels - 1, commandPool, graphicsQueue);
+	}
+
+	enum {
+		BLIT_BEGIN = 0,
+		BLIT_END,
+		COLOR_BEGIN,
+		COLOR_END,
+		CHAIN_BEGIN,
+		CHAIN_END,
+		DEPTH_BEGIN,
+		DEPTH_END,
+		QUERY_COUNT
+	};
+
+	VkQueryPool benchmarkQueries;
+	VkQueryPoolCreateInfo queryPoolInfo = {};
+	queryPoolInfo.sType		 = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+	queryPoolInfo.queryType	 = VK_QUERY_TYPE_TIMESTAMP;
+	queryPoolInfo.queryCount = QUERY_COUNT;
+
+	if (vkCreateQueryPool(logicalDevice, &queryPoolInfo, nullptr, &benchmarkQueries) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create downsample benchmark query pool.");
+	}
+
+	// Runs must not overlap, every write of one is finished before the next starts
+	auto computeBarrier = [](VkCommandBuffer commandBuffer) {
+		VkMemoryBarrier barrier = {};
+		barrier.sType		  = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+		barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+		barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0,
+			1, &barrier, 0, nullptr, 0, nullptr);
+	};
+
+	VkCommandBuffer commandBuffer = vkutil::beginSingleTimeCommands(logicalDevice, commandPool);
+	vkCmdResetQueryPool(commandBuffer, benchmarkQueries, 0, QUERY_COUNT);
+
+	// Something to reduce
+	vkutil::imageBarrier(commandBuffer, color.image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+		VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, 0, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT);
+	VkClearColorValue clearColor = { { 0.25f, 0.5f, 0.75f, 1.0f } };
+	VkImageSubresourceRange topLevel = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+	vkCmdClearColorImage(commandBuffer, color.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, &clearColor, 1, &topLevel);
+
+	// A blit per level, each waiting on the one before, as mips are usually generated
+	vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, benchmarkQueries, BLIT_BEGIN);
+	for (uint32_t i = 0; i < iterations; i++) {
+		for (uint32_t level = 1; level < colorLevels; level++) {
+			vkutil::imageBarrier(commandBuffer, color.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+				VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_READ_BIT,
+				VK_IMAGE_ASPECT_COLOR_BIT, level - 1, 1);
+
+			int32_t srcSize = static_cast<int32_t>(colorSize >> (level - 1));
+			int32_t dstSize = std::max(srcSize / 2, 1);
+
+			VkImageBlit blit = {};
+			blit.srcSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, level - 1, 0, 1 };
+			blit.srcOffsets[1]	= { srcSize, srcSize, 1 };
+			blit.dstSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, level, 0, 1 };
+			blit.dstOffsets[1]	= { dstSize, dstSize, 1 };
+			vkCmdBlitImage(commandBuffer, color.image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, color.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+				1, &blit, VK_FILTER_LINEAR);
+		}
+
+		// Back to where the next run starts
+		vkutil::imageBarrier(commandBuffer, color.image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+			VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_READ_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT,
+			VK_IMAGE_ASPECT_COLOR_BIT, 0, colorLevels - 1);
+		vkutil::imageBarrier(commandBuffer, color.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+			VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT,
+			VK_IMAGE_ASPECT_COLOR_BIT, colorLevels - 1, 1);
+	}
+	vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, benchmarkQueries, BLIT_END);
+
+	vkutil::imageBarrier(commandBuffer, color.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_GENERAL,
+		VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT,
+		VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+
+	vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, benchmarkQueries, COLOR_BEGIN);
+	for (uint32_t i = 0; i < iterations; i++) {
+		colorDownsampler.record(commandBuffer, colorTarget);
+		computeBarrier(commandBuffer);
+	}
+	vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, benchmarkQueries, COLOR_END);
+
+	// The depth pyramid as it is between frames, its first level left as the last frame built it
+	vkutil::imageBarrier(commandBuffer, hiZImage.image, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_LAYOUT_GENERAL,
+		VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT,
+		VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+
+	vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, benchmarkQueries, CHAIN_BEGIN);
+	for (uint32_t i = 0; i < iterations; i++) {
+		recordHiZLevels(commandBuffer, 1, hiZImage.mipLevels);
+		computeBarrier(commandBuffer);
+	}
+	vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, benchmarkQueries, CHAIN_END);
+
+	vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, benchmarkQueries, DEPTH_BEGIN);
+	if (depthTarget.levelCount > 0) {
+		for (uint32_t i = 0; i < iterations; i++) {
+			depthDownsampler.record(commandBuffer, depthTarget);
+			computeBarrier(commandBuffer);
+		}
+	}
+	vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, benchmarkQueries, DEPTH_END);
+
+	vkutil::imageBarrier(commandBuffer, hiZImage.image, VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+		VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT);
+	vkutil::endSingleTimeCommands(logicalDevice, commandPool, graphicsQueue, commandBuffer);
+
+	uint64_t timestamps[QUERY_COUNT] = {};
+	vkGetQueryPoolResults(logicalDevice, benchmarkQueries, 0, QUERY_COUNT, sizeof(timestamps), timestamps, sizeof(uint64_t),
+		VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT);
+	auto toMs = [&](uint32_t begin, uint32_t end) {
+		return (timestamps[end] - timestamps[begin]) * timestampPeriod / 1e6 / iterations;
+	};
+
+	const char* variant = subgroupQuadSupported ? "subgroup quads" : "shared memory";
+	std::cout << "Downsample benchmark, " << iterations << " runs each:" << std::endl;
+	std::cout << "\t" << colorSize << "^2 rgba8, " << colorLevels - 1 << " levels: blit chain " << toMs(BLIT_BEGIN, BLIT_END)
+		<< " ms, single pass " << toMs(COLOR_BEGIN, COLOR_END) << " ms (" << variant << ")" << std::endl;
+	std::cout << "\tdepth pyramid " << hiZImage.extent.width << "x" << hiZImage.extent.height << ", " << hiZImage.mipLevels - 1
+		<< " levels: dispatch per level " << toMs(CHAIN_BEGIN, CHAIN_END) << " ms, single pass ";
+	if (depthTarget.levelCount > 0) {
+		std::cout << toMs(DEPTH_BEGIN, DEPTH_END) << " ms (" << variant << ")" << std::endl;
+	} else {
+		std::cout << "not possible at this size" << std::endl;
+	}
+
+	vkDestroyQueryPool(logicalDevice, benchmarkQueries, nullptr);
+	depthDownsampler.destroyTarget(depthTarget);
+	depthDownsampler.destroy();
+	colorDownsampler.destroyTarget(colorTarget);
+	colorDownsampler.destroy();
+	vkutil::destroyImage(logicalDevice, color);
+}
+
+void VulkanApplication::runBatchBenchmark() {
+	// Every run is repeated, the times printed are per run
+	const uint32_t iterations = 8;
+	const uint32_t drawCounts[] = { 10000, 25000, 50000, 100000 };
+
+	// The scene's objects at full detail, every texture a material with a set of its own and every material
+	// drawn with one of the pipeline variants. Meshes share the scene's buffers, as they do when rendering
+	DrawBatcher::Tables tables;
+	tables.pipelines   = batchPipelines;
+	tables.layout	   = pipelineLayout;
+	tables.materialSet = 0;
+	for (const auto& mesh : meshData) {
+		const LodData& lod = lodData[mesh.firstLod];
+		tables.meshes.push_back({ vertexBuffer.buffer, indexBuffer.buffer, lod.indexCount, lod.firstIndex, mesh.vertexOffset });
+	}
+
+	std::vector<uint32_t> materials(objectData.size());
+	uint32_t materialCount = 1;
+	for (size_t i = 0; i < objectData.size(); i++) {
+		uint32_t texture = objectData[i].textureIndex;
+		materials[i] = texture == VIRTUAL_TEXTURE_INDEX ? 0 : texture + 1;
+		materialCount = std::max(materialCount, materials[i] + 1);
+	}
+	uint32_t pipelineCount = static_cast<uint32_t>(batchPipelines.size());
+
+	// Copies of the frame's set, so every material binds a set of its own that is as valid as the frame's
+	uint32_t textures = textureStreamer ? textureStreamer->getTextureCount() : 0;
+	VkDescriptorPoolSize poolSizes[3] = {};
+	poolSizes[0].type			 = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+	poolSizes[0].descriptorCount = materialCount;
+	poolSizes[1].type			 = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	poolSizes[1].descriptorCount = materialCount * (FRAME_BINDING_COUNT - 3);
+	poolSizes[2].type			 = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	poolSizes[2].descriptorCount = materialCount * (1 + textures);
+
+	VkDescriptorPoolCreateInfo poolInfo = {};
+	poolInfo.sType		   = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+	poolInfo.poolSizeCount = 3;
+	poolInfo.pPoolSizes	   = poolSizes;
+	poolInfo.maxSets	   = materialCount;
+
+	VkDescriptorPool materialPool;
+	if (vkCreateDescriptorPool(logicalDevice, &poolInfo, nullptr, &materialPool) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create batch benchmark descriptor pool.");
+	}
+
+	std::vector<VkDescriptorSetLayout> materialLayouts(materialCount, frameSetLayout);
+	std::vector<VkDescriptorSet> materialSets(materialCount);
+	VkDescriptorSetAllocateInfo setAllocInfo = {};
+	setAllocInfo.sType				= VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+	setAllocInfo.descriptorPool		= materialPool;
+	setAllocInfo.descriptorSetCount = materialCount;
+	setAllocInfo.pSetLayouts		= materialLayouts.data();
+
+	if (vkAllocateDescriptorSets(logicalDevice, &setAllocInfo, materialSets.data()) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to allocate batch benchmark descriptor sets.");
+	}
+
+	std::vector<VkCopyDescriptorSet> copies;
+	for (VkDescriptorSet set : materialSets) {
+		for (uint32_t binding = 0; binding < FRAME_BINDING_COUNT; binding++) {
+			uint32_t count = binding == TEXTURE_BINDING ? textures : 1;
+			if (count == 0) {
+				continue;
+			}
+			VkCopyDescriptorSet copy = {};
+			copy.sType			 = VK_STRUCTURE_TYPE_COPY_DESCRIPTOR_SET;
+			copy.srcSet			 = frameDescriptorSets[0];
+			copy.srcBinding		 = binding;
+			copy.dstSet			 = set;
+			copy.dstBinding		 = binding;
+			copy.descriptorCount = count;
+			copies.push_back(copy);
+		}
+		tables.materials.push_back({ set });
+	}
+	vkUpdateDescriptorSets(logicalDevice, 0, nullptr, static_cast<uint32_t>(copies.size()), copies.data());
+
+	// Depth from where the camera starts its orbit, over the range it sees
+	camera.orbit(0.0f, scene.extent * 0.6f);
+	float depthRange = scene.extent * 4.0f;
+
+	VkCommandBufferAllocateInfo allocInfo = {};
+	allocInfo.sType				 = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+	allocInfo.commandPool		 = commandPool;
+	allocInfo.level				 = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+	allocInfo.commandBufferCount = 1;
+
+	VkCommandBuffer commandBuffer;
+	if (vkAllocateCommandBuffers(logicalDevice, &allocInfo, &commandBuffer) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to allocate batch benchmark command buffer.");
+	}
+
+	// Recorded as if inside the scene's render pass, never submitted
+	VkCommandBufferInheritanceInfo inheritance = {};
+	inheritance.sType	   = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+	inheritance.renderPass = renderPass;
+	inheritance.subpass	   = 0;
+
+	VkCommandBufferBeginInfo beginInfo = {};
+	beginInfo.sType			   = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	beginInfo.flags			   = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT | VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+	beginInfo.pInheritanceInfo = &inheritance;
+
+	// Time to record what record adds between beginning and ending the command buffer
+	auto timeRecording = [&](const std::function<DrawBatcher::Stats()>& record, DrawBatcher::Stats& stats) {
+		auto start = std::chrono::steady_clock::now();
+		for (uint32_t i = 0; i < iterations; i++) {
+			vkResetCommandBuffer(commandBuffer, 0);
+			vkBeginCommandBuffer(commandBuffer, &beginInfo);
+			uint32_t visibleBase = 0;
+			vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(visibleBase), &visibleBase);
+			stats = record();
+			vkEndCommandBuffer(commandBuffer);
+		}
+		return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / iterations;
+	};
+
+	std::cout << "Batch benchmark, " << objectData.size() << " objects of " << meshData.size() << " meshes, " << materialCount
+		<< " materials and " << pipelineCount << " pipelines repeated, " << iterations << " runs each:" << std::endl;
+
+	DrawBatcher batcher;
+	for (uint32_t drawCount : drawCounts) {
+		// Submitted in scene order, as a traversal would
+		batcher.clear();
+		for (uint32_t i = 0; i < drawCount; i++) {
+			uint32_t object = i % static_cast<uint32_t>(objectData.size());
+			const ObjectData& data = objectData[object];
+			float depth = glm::length(glm::vec3(data.boundingSphere) - camera.position) / depthRange;
+			batcher.add(DrawBatcher::makeKey(0, materials[object] % pipelineCount, materials[object], data.meshIndex, depth), object);
+		}
+
+		DrawBatcher::Stats unsorted;
+		double unsortedMs = timeRecording([&]() { return batcher.recordUnsorted(commandBuffer, tables, 0); }, unsorted);
+
+		auto buildStart = std::chrono::steady_clock::now();
+		for (uint32_t i = 0; i < iterations; i++) {
+			batcher.build();
+		}
+		double buildMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - buildStart).count() / iterations;
+
+		DrawBatcher::Stats batched;
+		double batchedMs = timeRecording([&]() { return batcher.record(commandBuffer, tables, 0); }, batched);
+
+		std::cout << "	" << drawCount << " draws: as submitted " << unsortedMs << " ms recording, " << unsorted.binds() << " binds ("
+			<< unsorted.pipelineBinds << " pipeline, " << unsorted.descriptorBinds << " set, " << unsorted.vertexBufferBinds << " vertex, "
+			<< unsorted.indexBufferBinds << " index) | batched " << buildMs << " ms sorting and merging, " << batchedMs << " ms recording, " << batched.draws << " draws, "
+			<< batched.binds() << " binds (" << batched.pipelineBinds << " pipeline, " << batched.descriptorBinds << " set, "
+			<< batched.vertexBufferBinds << " vertex, " << batched.indexBufferBinds << " index)" << std::endl;
+	}
+
+	vkFreeCommandBuffers(logicalDevice, commandPool, 1, &commandBuffer);
+	vkDestroyDescriptorPool(logicalDevice, materialPool, nullptr);
+}
+
+void VulkanApplication::runMultiviewBenchmark() {
+	// Every run is repeated, the rates printed are over all of them
+	const uint32_t iterations = 16;
+
+	MultiviewRenderer::Config config;
+	config.views		 = settings.multiviewViews;
+	config.extent		 = { settings.multiviewSize, settings.multiviewSize };
+	config.depthFormat	 = depthFormat;
+	config.maxGroupViews = multiviewSupported ? MultiviewRenderer::maxViewCount(physicalDevice, getPhysicalDeviceProperties2) : 0;
+
+	MultiviewRenderer renderer(logicalDevice, physicalDevice, *assets, config);
+	renderer.setScene(objectData, meshData, lodData, objectBuffer.buffer, vertexBuffer.buffer, indexBuffer.buffer);
+
+	// Cameras spread evenly around the orbit, each seeing a different part of the scene
+	std::vector<glm::mat4> viewProj;
+	Camera viewCamera = camera;
+	uint32_t viewCount = renderer.getViewCount();
+	for (uint32_t view = 0; view < viewCount; view++) {
+		viewCamera.orbit(glm::two_pi<float>() * view / viewCount, scene.extent * 0.6f);
+		viewProj.push_back(viewCamera.getCameraData(1.0f).viewProj);
+	}
+	renderer.setViews(viewProj, ShadowMaps::Config().lightDirection);
+
+	VkQueryPool benchmarkQueries = VK_NULL_HANDLE;
+	if (timestampsSupported) {
+		VkQueryPoolCreateInfo queryPoolInfo = {};
+		queryPoolInfo.sType		 = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+		queryPoolInfo.queryType	 = VK_QUERY_TYPE_TIMESTAMP;
+		queryPoolInfo.queryCount = 2;
+
+		if (vkCreateQueryPool(logicalDevice, &queryPoolInfo, nullptr, &benchmarkQueries) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to create multiview benchmark query pool.");
+		}
+	}
+
+	// Record, submit and wait for the views record draws, adding up the gpu time between its first and last command
+	double gpuMs = 0.0;
+	auto submit = [&](const std::function<MultiviewRenderer::Stats(VkCommandBuffer)>& record) {
+		VkCommandBuffer commandBuffer = vkutil::beginSingleTimeCommands(logicalDevice, commandPool);
+		if (timestampsSupported) {
+			vkCmdResetQueryPool(commandBuffer, benchmarkQueries, 0, 2);
+			vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, benchmarkQueries, 0);
+		}
+		MultiviewRenderer::Stats stats = record(commandBuffer);
+		if (timestampsSupported) {
+			vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, benchmarkQueries, 1);
+		}
+		vkutil::endSingleTimeCommands(logicalDevice, commandPool, graphicsQueue, commandBuffer);
+
+		if (timestampsSupported) {
+			uint64_t timestamps[2] = {};
+			vkGetQueryPoolResults(logicalDevice, benchmarkQueries, 0, 2, sizeof(timestamps), timestamps, sizeof(uint64_t),
+				VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT);
+			gpuMs += (timestamps[1] - timestamps[0]) * timestampPeriod / 1e6;
+		}
+		return stats;
+	};
+
+	// Prints what one run of every view took, wall time from recording the first view to the last one finishing
+	auto report = [&](const char* name, double wallMs, const MultiviewRenderer::Stats& stats, uint32_t submissions) {
+		std::cout << "\t" << name << ": " << viewCount * iterations / (wallMs / 1000.0) << " views/s, " << wallMs / iterations
+			<< " ms per run";
+		if (timestampsSupported) {
+			std::cout << " (" << gpuMs / iterations << " ms on the gpu)";
+		}
+		std::cout << ", " << submissions << " submissions, " << stats.renderPasses << " render passes, " << stats.draws.draws
+			<< " draws" << std::endl;
+	};
+
+	std::cout << "Multiview benchmark, " << viewCount << " views of " << config.extent.width << "x" << config.extent.height << ", "
+		<< objectData.size() << " objects, " << iterations << " runs each:" << std::endl;
+
+	// A frame per view, each recorded, submitted and waited for on its own
+	MultiviewRenderer::Stats perView;
+	auto start = std::chrono::steady_clock::now();
+	for (uint32_t i = 0; i < iterations; i++) {
+		perView = MultiviewRenderer::Stats();
+		for (uint32_t view = 0; view < viewCount; view++) {
+			MultiviewRenderer::Stats stats = submit([&](VkCommandBuffer commandBuffer) { return renderer.recordView(commandBuffer, view); });
+			perView.renderPasses += stats.renderPasses;
+			perView.draws.draws += stats.draws.draws;
+		}
+	}
+	double perViewMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	report("per view", perViewMs, perView, viewCount);
+
+	if (renderer.usesMultiview()) {
+		gpuMs = 0.0;
+		MultiviewRenderer::Stats multiview;
+		start = std::chrono::steady_clock::now();
+		for (uint32_t i = 0; i < iterations; i++) {
+			multiview = submit([&](VkCommandBuffer commandBuffer) { return renderer.recordMultiview(commandBuffer); });
+		}
+		double multiviewMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		report("multiview", multiviewMs, multiview, 1);
+		std::cout << "\t" << renderer.getGroupViews() << " views per render pass";
+		if (renderer.getLastGroupViews() != renderer.getGroupViews()) {
+			std::cout << " (" << renderer.getLastGroupViews() << " in the last)";
+		}
+		std::cout << ", " << perViewMs / multiviewMs << "x the views per second" << std::endl;
+	} else {
+		std::cout << "\tmultiview: not supported by this device" << std::endl;
+	}
+
+	vkDestroyQueryPool(logicalDevice, benchmarkQueries, nullptr);
+	renderer.destroy();
+}
+
+void VulkanApplication::updateRenderExtent(uint32_t frame) {
+	if (!dynamicResolution || !settings.dynamicResolution) {
+		renderExtent = swapChainExtent;
+		postProcess->setRenderExtent(renderExtent);
+		return;
+	}
+
+	// The whole frame up to the tonemap, which is what the scale has to keep within the target
+	if (frameSubmitted[frame]) {
+		uint64_t timestamps[TIMESTAMP_TONEMAP + 1];
+		VkResult result = vkGetQueryPoolResults(logicalDevice, queryPool, frame * TIMESTAMP_COUNT, TIMESTAMP_TONEMAP + 1,
+			sizeof(timestamps), timestamps, sizeof(uint64_t), VK_QUERY_RESULT_64_BIT);
+		if (result == VK_SUCCESS) {
+			dynamicResolution->update((timestamps[TIMESTAMP_TONEMAP] - timestamps[TIMESTAMP_FRAME_BEGIN]) * timestampPeriod / 1000000.0);
+		}
+	}
+
+	renderExtent = dynamicResolution->getRenderExtent(swapChainExtent);
+	postProcess->setRenderExtent(renderExtent);
+}
+
+void VulkanApplication::collectFrameStats(uint32_t frame) {
+	if (!frameSubmitted[frame] || settings.statsInterval == 0) {
+		return;
+	}
+
+	// Instances drawn by each phase, and the triangles they cost
+	auto commands = reinterpret_cast<const VkDrawIndexedIndirectCommand*>(statsBuffers[frame].mapped);
+	uint64_t objectTriangles = 0;
+	for (size_t lod = 0; lod < lodData.size(); lod++) {
+		const VkDrawIndexedIndirectCommand& early = commands[lod];
+		const VkDrawIndexedIndirectCommand& late = commands[lodData.size() + lod];
+		frameStats.drawnEarly += early.instanceCount;
+		frameStats.drawnLate += late.instanceCount;
+		objectTriangles += static_cast<uint64_t>(early.instanceCount + late.instanceCount) * (early.indexCount / 3);
+	}
+	auto clusterCounts = reinterpret_cast<const uint32_t*>(commands + lodData.size() * 2);
+	uint32_t clusters = clusterCounts[0] + clusterCounts[1];
+	frameStats.clustersDrawn += clusters;
+	frameStats.trianglesDrawn += clusters > 0 ? clusterCounts[2] + clusterCounts[3] : objectTriangles;
+
+	if (timestampsSupported) {
+		// Those of the graphics queue, then the binning's, which the compute queue may have written
+		uint64_t timestamps[TIMESTAMP_COUNT];
+		VkResult result = vkGetQueryPoolResults(logicalDevice, queryPool, frame * TIMESTAMP_COUNT, TIMESTAMP_BINNING_BEGIN,
+			sizeof(timestamps), timestamps, sizeof(uint64_t), VK_QUERY_RESULT_64_BIT);
+		auto toMs = [&](uint32_t from, uint32_t to) {
+			return (timestamps[to] - timestamps[from]) * timestampPeriod / 1000000.0;
+		};
+
+		if (!useAsyncCompute() || computeTimestampsSupported) {
+			VkResult binningResult = vkGetQueryPoolResults(logicalDevice, queryPool, frame * TIMESTAMP_COUNT + TIMESTAMP_BINNING_BEGIN, 2,
+				2 * sizeof(uint64_t), &timestamps[TIMESTAMP_BINNING_BEGIN], sizeof(uint64_t), VK_QUERY_RESULT_64_BIT);
+			if (binningResult == VK_SUCCESS) {
+				frameStats.lightBinningMs += toMs(TIMESTAMP_BINNING_BEGIN, TIMESTAMP_BINNING_END);
+			}
+		}
+
+		if (result == VK_SUCCESS) {
+			frameStats.shadowMs += toMs(TIMESTAMP_FRAME_BEGIN, TIMESTAMP_SHADOWS);
+			frameStats.cullMs += toMs(TIMESTAMP_LIGHT_BINNING, TIMESTAMP_EARLY_CULL) + toMs(TIMESTAMP_HIZ, TIMESTAMP_LATE_CULL);
+			frameStats.hiZMs += toMs(TIMESTAMP_EARLY_DRAW, TIMESTAMP_HIZ);
+			frameStats.drawMs += toMs(TIMESTAMP_EARLY_CULL, TIMESTAMP_EARLY_DRAW) + toMs(TIMESTAMP_LATE_CULL, TIMESTAMP_LATE_DRAW);
+			frameStats.particleSimMs += toMs(TIMESTAMP_LATE_DRAW, TIMESTAMP_PARTICLE_SIM);
+			frameStats.particleDrawMs += toMs(TIMESTAMP_PARTICLE_SIM, TIMESTAMP_PARTICLE_DRAW);
+			frameStats.exposureMs += toMs(TIMESTAMP_PARTICLE_DRAW, TIMESTAMP_EXPOSURE);
+			frameStats.bloomMs += toMs(TIMESTAMP_EXPOSURE, TIMESTAMP_BLOOM);
+			frameStats.tonemapMs += toMs(TIMESTAMP_BLOOM, TIMESTAMP_TONEMAP);
+			frameStats.frameMs += toMs(TIMESTAMP_FRAME_BEGIN, TIMESTAMP_TONEMAP);
+		}
+	}
+
+	frameStats.frames++;
+	if (frameStats.frames < settings.statsInterval) {
+		return;
+	}
+
+	// Compare the gpu times between culling modes (press C) to see what occlusion culling saves
+	double frames = frameStats.frames;
+	double objects = static_cast<double>(scene.objects.size());
+	double drawn = (frameStats.drawnEarly + frameStats.drawnLate) / frames;
+
+	std::cout << "[" << settings::cullingModeName(settings.cullingMode) << "] "
+		<< "drawn " << drawn << " / " << objects
+		<< " (early " << frameStats.drawnEarly / frames << ", late " << frameStats.drawnLate / frames << ")"
+		<< ", culled " << 100.0 * (1.0 - drawn / objects) << "%";
+	if (frameStats.clustersDrawn > 0) {
+		std::cout << ", clusters " << frameStats.clustersDrawn / frames;
+	}
+	std::cout << ", triangles " << frameStats.trianglesDrawn / frames;
+	if (timestampsSupported) {
+		std::cout << " | gpu ms: cull " << frameStats.cullMs / frames
+			<< ", hi-z " << frameStats.hiZMs / frames
+			<< ", draw " << frameStats.drawMs / frames
+			<< ", frame " << frameStats.frameMs / frames;
+	}
+	if (dynamicResolution && settings.dynamicResolution) {
+		// The scale the last frame was rendered at, steered by the controller's own running average
+		std::cout << " | render " << renderExtent.width << "x" << renderExtent.height << " (scale " << dynamicResolution->getScale()
+			<< ", average " << dynamicResolution->getAverageMs() << " ms, " << dynamicResolution->getChanges() << " changes)";
+	}
+	if (frameStats.cpuFrames > 0) {
+		double cpuFrames = frameStats.cpuFrames;
+		std::cout << " | cpu ms: raster " << frameStats.cpuRasterMs / cpuFrames
+			<< ", test " << frameStats.cpuTestMs / cpuFrames
+			<< ", frustum only " << frameStats.cpuFrustumVisible / cpuFrames;
+	}
+	if (frameStats.inputEvents > 0) {
+		// From the newest event a frame sampled to its submission
+		std::cout << " | input latency " << frameStats.inputLatencyMs / frameStats.inputEvents << " ms, worst "
+			<< frameStats.maxInputLatencyMs << " ms";
+	}
+	if (renderGraph.getStats().lazyImages > 0) {
+		// Tilers keep transient attachments on chip and commit little or none of this
+		std::cout << " | lazy memory committed " << renderGraph.getCommittedLazyMemory(logicalDevice) / (1024.0 * 1024.0) << " MB";
+	}
+	if (textureStreamer) {
+		// Latency runs from requesting a level to the first frame sampling it
+		const TextureStreamer::Stats& textureStats = textureStreamer->getStats();
+		const double mb = 1024.0 * 1024.0;
+		std::cout << " | textures resident " << textureStats.residentBytes / mb << " MB, requested " << textureStats.requestedBytes / mb
+			<< " MB, budget " << textureStats.budget / mb << " MB";
+		if (textureStats.mipBias > 0) {
+			std::cout << ", mip bias " << textureStats.mipBias;
+		}
+		std::cout << ", streamed in " << textureStats.streamedIn << " out " << textureStats.streamedOut
+			<< ", uploaded " << textureStats.uploadedBytes / mb << " MB";
+		if (textureStats.streamedIn > 0) {
+			std::cout << ", latency avg " << textureStats.latencyMsTotal / textureStats.streamedIn << " ms max " << textureStats.latencyMsMax << " ms";
+		}
+		if (textureStats.pendingDecodes > 0) {
+			std::cout << ", " << textureStats.pendingDecodes << " decoding";
+		}
+		textureStreamer->resetLatency();
+	}
+	if (settings.lightBinning) {
+		// Shading cost is in the draw time, compare it against brute force (press B)
+		const LightClusters::Stats& lightStats = lightClusters->getStats();
+		std::cout << " | lights " << lightClusters->getLightCount() << " clustered, binning";
+		if (useAsyncCompute()) {
+			// Overlapped with the shadows, compare the frame time with async compute on and off (press A)
+			std::cout << " async";
+		}
+		if (!useAsyncCompute() || computeTimestampsSupported) {
+			std::cout << " " << frameStats.lightBinningMs / frames << " ms";
+		}
+		std::cout << ", " << lightStats.indexCount / static_cast<double>(LightClusters::CLUSTER_COUNT) << " per cluster, max "
+			<< lightStats.maxClusterLights;
+		if (lightStats.overflowClusters > 0) {
+			std::cout << ", " << lightStats.overflowClusters << " clusters over capacity";
+		}
+	} else {
+		std::cout << " | lights " << lightClusters->getLightCount() << " brute force";
+	}
+	// Compare the shadow pass with the cache on and off (press S)
+	const ShadowMaps::Stats& shadowStats = shadowMaps->getStats();
+	std::cout << " | shadows " << (settings.shadowCache ? "cached" : "uncached");
+	if (timestampsSupported) {
+		std::cout << " " << frameStats.shadowMs / frames << " ms";
+	}
+	std::cout << ", casters drawn " << shadowStats.drawnInstances;
+	if (settings.shadowCache) {
+		std::cout << ", from cache " << shadowStats.cachedInstances << ", cache redraws " << shadowStats.cacheRedraws;
+	}
+	shadowMaps->resetCounters();
+	// What the fused tonemap saves is measured against the same passes split into separate full screen ones
+	const PostProcess::Bandwidth bandwidth = postProcess->getBandwidth(directPostOutput ? swapChainImageFormat : PostProcess::OUTPUT_FORMAT);
+	const double mb = 1024.0 * 1024.0;
+	VkDeviceSize blitBytes = directPostOutput ? 0 : 2 * static_cast<VkDeviceSize>(swapChainExtent.width) * swapChainExtent.height * 4;
+	std::cout << " | post";
+	if (timestampsSupported) {
+		std::cout << " ms: exposure " << frameStats.exposureMs / frames << ", bloom " << frameStats.bloomMs / frames
+			<< ", tonemap " << frameStats.tonemapMs / frames << (directPostOutput ? "" : " with blit") << ",";
+	}
+	std::cout << " MB per frame: histogram " << bandwidth.histogram / mb << ", bloom " << bandwidth.bloom / mb
+		<< ", tonemap " << (bandwidth.tonemap + blitBytes) / mb << " (unfused " << (bandwidth.unfusedTonemap + blitBytes) / mb << ")";
+	if (particleSystem) {
+		// Nothing per particle comes back to the cpu, only the counters
+		const ParticleSystem::Stats& particleStats = particleSystem->getStats();
+		std::cout << " | particles alive " << particleStats.alive << ", emitted " << particleStats.emitted;
+		if (timestampsSupported) {
+			std::cout << ", simulate " << frameStats.particleSimMs / frames << " ms, draw " << frameStats.particleDrawMs / frames << " ms";
+		}
+	}
+	if (virtualTexture) {
+		// Pages asked for by the last feedback read back, and how many of those were not in the cache yet
+		const VirtualTexture::Stats& pageStats = virtualTexture->getStats();
+		std::cout << " | virtual pages resident " << pageStats.residentPages << " / " << virtualTexture->getCachePagesPerSide() * virtualTexture->getCachePagesPerSide()
+			<< ", requested " << pageStats.requestedPages << " (" << pageStats.missingPages << " missing)"
+			<< ", loaded " << pageStats.loadedPages << " evicted " << pageStats.evictedPages;
+		if (pageStats.pendingPages > 0) {
+			std::cout << ", " << pageStats.pendingPages << " generating";
+		}
+		if (pageStats.droppedPages > 0) {
+			std::cout << ", " << pageStats.droppedPages << " dropped";
+		}
+		virtualTexture->resetCounters();
+	}
+	if (frameCapture) {
+		// Since the start, the frames still with the workers are written later
+		const FrameCapture::Stats& captureStats = frameCapture->getStats();
+		std::cout << " | captured " << captureStats.captured << ", written " << captureStats.written << ", dropped " << captureStats.dropped;
+	}
+	std::cout << std::endl;
+
+	frameStats = FrameStats();
+}
+
+
+
 /// * * * * * PHYSICAL DEVICE (GPU) FOCUSED * * * * * ///
 
 void VulkanApplication::pickPhysicalDevice() {
@@ -779,9 +3682,9 @@ bool VulkanApplication::isDeviceSuitable(const VkPhysicalDevice& device) {
 	// Make sure that the device has the extensions we want (drawing to screen, swapchain, etc.)
 	bool extensionsSupported = checkExtensionSupport(device);
 
-	// Make sure that our device swap chain supports at least one format and present mode
-	bool swapChainAdequate;
-	if (extensionsSupported) {
+	// Make sure that our device swap chain supports at least one format and present mode. Headless runs have none
+	bool swapChainAdequate = settings.headless;
+	if (extensionsSupported && !settings.headless) {
 		SwapChainSupportDetails swapChainSupport = querySwapChainSupport(device);
 		swapChainAdequate = !swapChainSupport.formats.empty() && !swapChainSupport.presentModes.empty();
 	}
@@ -809,20 +3712,34 @@ QueueFamilyIndices VulkanApplication::findQueueFamilies(const VkPhysicalDevice&
 
 		// Grab presentation (window) queue index
 		VkBool32 presentSupport = false;
-		vkGetPhysicalDeviceSurfaceSupportKHR(device, i, windowSurface, &presentSupport);
+		if (!settings.headless) {
+			vkGetPhysicalDeviceSurfaceSupportKHR(device, i, windowSurface, &presentSupport);
+		}
 		if (queueFamily.queueCount > 0 && presentSupport) {
 			indices.presentFamily = i;
 		}
 
-		// Grab graphics queue index
+		// Grab graphics queue index. Without a window it stands in for the presentation queue
 		if (queueFamily.queueCount > 0 && queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT) {
 			indices.graphicsFamily = i;
+			if (settings.headless) {
+				indices.presentFamily = i;
+			}
 		}
 		
 		// Increment i
 		i++;
 	}
 
+	// The first family that computes without drawing
+	for (uint32_t family = 0; family < queueFamilyCount; family++) {
+		VkQueueFlags flags = queueFamilies[family].queueFlags;
+		if (queueFamilies[family].queueCount > 0 && (flags & VK_QUEUE_COMPUTE_BIT) && !(flags & VK_QUEUE_GRAPHICS_BIT)) {
+			indices.computeFamily = family;
+			break;
+		}
+	}
+
 	return indices;
 }
 
@@ -836,7 +3753,7 @@ bool VulkanApplication::checkExtensionSupport(const VkPhysicalDevice& device) {
 	vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, availableExtensions.data());
 
 	// Run through our necessary extensions and available extensions and verify that we have all we need
-	for (const auto& deviceExtension : deviceExtensions) {
+	for (const auto& deviceExtension : requiredDeviceExtensions()) {
 		bool extensionFound = false;
 
 		for (const auto& availableExtension : availableExtensions) {
@@ -927,13 +3844,9 @@ VkExtent2D VulkanApplication::chooseSwapExtent(const VkSurfaceCapabilitiesKHR& c
 	if (capabilities.currentExtent.width != UINT_MAX) {
 		return capabilities.currentExtent;
 	} else { // Else, our window software allows us to specify the size
-		int width;
-		int height;
-		glfwGetFramebufferSize(window, &height, &width);
-
 		VkExtent2D actualExtent = { 
-			static_cast<uint32_t>(width), 
-			static_cast<uint32_t>(height) 
+			static_cast<uint32_t>(input.framebufferWidth), 
+			static_cast<uint32_t>(input.framebufferHeight) 
 		};
 
 		actualExtent.width = std::max(
@@ -0,0 +1,345 @@
+
+#include "VulkanUtil.h"
+
+#include <stdexcept>
+#include <cstring>
+
+namespace vkutil {
+
+	bool hasDeviceExtension(VkPhysicalDevice physicalDevice, const char* name) {
+		uint32_t extensionCount = 0;
+		vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &extensionCount, nullptr);
+		std::vector<VkExtensionProperties> extensions(extensionCount);
+		vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &extensionCount, extensions.data());
+
+		for (const auto& extension : extensions) {
+			if (strcmp(extension.extensionName, name) == 0) {
+				return true;
+			}
+		}
+		return false;
+	}
+
+	bool hasMemoryType(VkPhysicalDevice physicalDevice, uint32_t typeFilter, VkMemoryPropertyFlags properties) {
+		VkPhysicalDeviceMemoryProperties memoryProperties;
+		vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memoryProperties);
+
+		for (uint32_t i = 0; i < memoryProperties.memoryTypeCount; i++) {
+			if ((typeFilter & (1 << i)) && (memoryProperties.memoryTypes[i].propertyFlags & properties) == properties) {
+				return true;
+			}
+		}
+		return false;
+	}
+
+	uint32_t findMemoryType(VkPhysicalDevice physicalDevice, uint32_t typeFilter, VkMemoryPropertyFlags properties) {
+		VkPhysicalDeviceMemoryProperties memoryProperties;
+		vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memoryProperties);
+
+		// typeFilter is a bitmask of the memory types the resource can live in
+		for (uint32_t i = 0; i < memoryProperties.memoryTypeCount; i++) {
+			if ((typeFilter & (1 << i)) && (memoryProperties.memoryTypes[i].propertyFlags & properties) == properties) {
+				return i;
+			}
+		}
+
+		throw std::runtime_error("Failed to find a suitable memory type.");
+	}
+
+	Buffer createBuffer(VkDevice device, VkPhysicalDevice physicalDevice, VkDeviceSize size,
+		VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, const std::vector<uint32_t>& sharedQueueFamilies) {
+
+		Buffer result;
+		result.size = size;
+
+		VkBufferCreateInfo bufferInfo = {};
+		bufferInfo.sType		= VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+		bufferInfo.size			= size;
+		bufferInfo.usage		= usage;
+		bufferInfo.sharingMode	= VK_SHARING_MODE_EXCLUSIVE;
+		if (sharedQueueFamilies.size() > 1) {
+			bufferInfo.sharingMode			 = VK_SHARING_MODE_CONCURRENT;
+			bufferInfo.queueFamilyIndexCount = static_cast<uint32_t>(sharedQueueFamilies.size());
+			bufferInfo.pQueueFamilyIndices	 = sharedQueueFamilies.data();
+		}
+
+		if (vkCreateBuffer(device, &bufferInfo, nullptr, &result.buffer) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to create buffer.");
+		}
+
+		VkMemoryRequirements memRequirements;
+		vkGetBufferMemoryRequirements(device, result.buffer, &memRequirements);
+
+		VkMemoryAllocateInfo allocInfo = {};
+		allocInfo.sType				= VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+		allocInfo.allocationSize	= memRequirements.size;
+		allocInfo.memoryTypeIndex	= findMemoryType(physicalDevice, memRequirements.memoryTypeBits, properties);
+
+		if (vkAllocateMemory(device, &allocInfo, nullptr, &result.memory) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to allocate buffer memory.");
+		}
+
+		vkBindBufferMemory(device, result.buffer, result.memory, 0);
+
+		if (properties & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) {
+			vkMapMemory(device, result.memory, 0, size, 0, &result.mapped);
+		}
+
+		return result;
+	}
+
+	void destroyBuffer(VkDevice device, Buffer& buffer) {
+		if (buffer.mapped) {
+			vkUnmapMemory(device, buffer.memory);
+		}
+		vkDestroyBuffer(device, buffer.buffer, nullptr);
+		vkFreeMemory(device, buffer.memory, nullptr);
+		buffer = Buffer();
+	}
+
+	// The image and its memory, without a view
+	static Image allocateImage(VkDevice device, VkPhysicalDevice physicalDevice, VkExtent2D extent, uint32_t mipLevels, uint32_t arrayLayers,
+		VkFormat format, VkImageUsageFlags usage, VkSampleCountFlagBits samples, VkMemoryPropertyFlags properties) {
+
+		Image result;
+		result.format		= format;
+		result.extent		= extent;
+		result.mipLevels	= mipLevels;
+		result.arrayLayers	= arrayLayers;
+
+		VkImageCreateInfo imageInfo = {};
+		imageInfo.sType			= VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+		imageInfo.imageType		= VK_IMAGE_TYPE_2D;
+		imageInfo.extent		= { extent.width, extent.height, 1 };
+		imageInfo.mipLevels		= mipLevels;
+		imageInfo.arrayLayers	= arrayLayers;
+		imageInfo.format		= format;
+		imageInfo.tiling		= VK_IMAGE_TILING_OPTIMAL;
+		imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		imageInfo.usage			= usage;
+		imageInfo.samples		= samples;
+		imageInfo.sharingMode	= VK_SHARING_MODE_EXCLUSIVE;
+
+		if (vkCreateImage(device, &imageInfo, nullptr, &result.image) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to create image.");
+		}
+
+		VkMemoryRequirements memRequirements;
+		vkGetImageMemoryRequirements(device, result.image, &memRequirements);
+
+		VkMemoryAllocateInfo allocInfo = {};
+		allocInfo.sType				= VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+		allocInfo.allocationSize	= memRequirements.size;
+		allocInfo.memoryTypeIndex	= findMemoryType(physicalDevice, memRequirements.memoryTypeBits, properties);
+
+		if (vkAllocateMemory(device, &allocInfo, nullptr, &result.memory) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to allocate image memory.");
+		}
+
+		vkBindImageMemory(device, result.image, result.memory, 0);
+
+		return result;
+	}
+
+	Image createImage(VkDevice device, VkPhysicalDevice physicalDevice, VkExtent2D extent, uint32_t mipLevels,
+		VkFormat format, VkImageUsageFlags usage, VkImageAspectFlags aspect,
+		VkSampleCountFlagBits samples, VkMemoryPropertyFlags properties) {
+
+		Image result = allocateImage(device, physicalDevice, extent, mipLevels, 1, format, usage, samples, properties);
+		result.view = createImageView(device, result.image, format, aspect, 0, mipLevels);
+		return result;
+	}
+
+	Image createImageArray(VkDevice device, VkPhysicalDevice physicalDevice, VkExtent2D extent, uint32_t arrayLayers,
+		VkFormat format, VkImageUsageFlags usage, VkImageAspectFlags aspect) {
+
+		Image result = allocateImage(device, physicalDevice, extent, 1, arrayLayers, format, usage, VK_SAMPLE_COUNT_1_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+		result.view = createLayerView(device, result.image, format, aspect, 0, arrayLayers);
+		return result;
+	}
+
+	void destroyImage(VkDevice device, Image& image) {
+		vkDestroyImageView(device, image.view, nullptr);
+		vkDestroyImage(device, image.image, nullptr);
+		vkFreeMemory(device, image.memory, nullptr);
+		image = Image();
+	}
+
+	VkImageView createImageView(VkDevice device, VkImage image, VkFormat format, VkImageAspectFlags aspect,
+		uint32_t baseMipLevel, uint32_t levelCount) {
+
+		VkImageViewCreateInfo createInfo = {};
+		createInfo.sType	= VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+		createInfo.image	= image;
+		createInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+		createInfo.format	= format;
+
+		createInfo.subresourceRange.aspectMask		= aspect;
+		createInfo.subresourceRange.baseMipLevel	= baseMipLevel;
+		createInfo.subresourceRange.levelCount		= levelCount;
+		createInfo.subresourceRange.baseArrayLayer	= 0;
+		createInfo.subresourceRange.layerCount		= 1;
+
+		VkImageView imageView;
+		if (vkCreateImageView(device, &createInfo, nullptr, &imageView) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to create image view.");
+		}
+
+		return imageView;
+	}
+
+	VkImageView createLayerView(VkDevice device, VkImage image, VkFormat format, VkImageAspectFlags aspect,
+		uint32_t baseArrayLayer, uint32_t layerCount) {
+
+		VkImageViewCreateInfo createInfo = {};
+		createInfo.sType	= VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+		createInfo.image	= image;
+		createInfo.viewType = VK_IMAGE_VIEW_TYPE_2D_ARRAY;
+		createInfo.format	= format;
+
+		createInfo.subresourceRange.aspectMask		= aspect;
+		createInfo.subresourceRange.baseMipLevel	= 0;
+		createInfo.subresourceRange.levelCount		= 1;
+		createInfo.subresourceRange.baseArrayLayer	= baseArrayLayer;
+		createInfo.subresourceRange.layerCount		= layerCount;
+
+		VkImageView imageView;
+		if (vkCreateImageView(device, &createInfo, nullptr, &imageView) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to create image view.");
+		}
+
+		return imageView;
+	}
+
+	VkCommandBuffer beginSingleTimeCommands(VkDevice device, VkCommandPool commandPool) {
+		VkCommandBufferAllocateInfo allocInfo = {};
+		allocInfo.sType					= VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+		allocInfo.level					= VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+		allocInfo.commandPool			= commandPool;
+		allocInfo.commandBufferCount	= 1;
+
+		VkCommandBuffer commandBuffer;
+		vkAllocateCommandBuffers(device, &allocInfo, &commandBuffer);
+
+		VkCommandBufferBeginInfo beginInfo = {};
+		beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+		beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+		vkBeginCommandBuffer(commandBuffer, &beginInfo);
+
+		return commandBuffer;
+	}
+
+	void endSingleTimeCommands(VkDevice device, VkCommandPool commandPool, VkQueue queue, VkCommandBuffer commandBuffer) {
+		vkEndCommandBuffer(commandBuffer);
+
+		VkSubmitInfo submitInfo = {};
+		submitInfo.sType				= VK_STRUCTURE_TYPE_SUBMIT_INFO;
+		submitInfo.commandBufferCount	= 1;
+		submitInfo.pCommandBuffers		= &commandBuffer;
+
+		vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE);
+		vkQueueWaitIdle(queue);
+
+		vkFreeCommandBuffers(device, commandPool, 1, &commandBuffer);
+	}
+
+	void uploadBuffer(VkDevice device, VkPhysicalDevice physicalDevice, VkCommandPool commandPool, VkQueue queue,
+		const Buffer& dst, const void* data, VkDeviceSize size) {
+
+		Buffer staging = createBuffer(device, physicalDevice, size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+		memcpy(staging.mapped, data, static_cast<size_t>(size));
+
+		VkCommandBuffer commandBuffer = beginSingleTimeCommands(device, commandPool);
+
+		VkBufferCopy copyRegion = {};
+		copyRegion.size = size;
+		vkCmdCopyBuffer(commandBuffer, staging.buffer, dst.buffer, 1, &copyRegion);
+
+		endSingleTimeCommands(device, commandPool, queue, commandBuffer);
+
+		destroyBuffer(device, staging);
+	}
+
+	VkShaderModule createShaderModule(VkDevice device, const std::vector<char>& code) {
+		VkShaderModuleCreateInfo createInfo = {};
+		createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+		createInfo.codeSize = code.size();
+		createInfo.pCode = reinterpret_cast<const uint32_t*>(code.data());
+
+		VkShaderModule shaderModule;
+		if (vkCreateShaderModule(device, &createInfo, nullptr, &shaderModule) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to create shader module");
+		}
+
+		return shaderModule;
+	}
+
+	VkPipeline createComputePipeline(VkDevice device, const std::vector<char>& code, VkPipelineLayout layout,
+		const VkSpecializationInfo* specialization) {
+
+		VkShaderModule shaderModule = createShaderModule(device, code);
+
+		VkPipelineShaderStageCreateInfo stageInfo = {};
+		stageInfo.sType					= VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+		stageInfo.stage					= VK_SHADER_STAGE_COMPUTE_BIT;
+		stageInfo.module				= shaderModule;
+		stageInfo.pName					= "main";
+		stageInfo.pSpecializationInfo	= specialization;
+
+		VkComputePipelineCreateInfo pipelineInfo = {};
+		pipelineInfo.sType	= VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+		pipelineInfo.stage	= stageInfo;
+		pipelineInfo.layout = layout;
+
+		VkPipeline pipeline;
+		if (vkCreateComputePipelines(device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &pipeline) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to create compute pipeline.");
+		}
+
+		vkDestroyShaderModule(device, shaderModule, nullptr);
+
+		return pipeline;
+	}
+
+	void bufferBarrier(VkCommandBuffer commandBuffer, VkBuffer buffer,
+		VkPipelineStageFlags srcStage, VkAccessFlags srcAccess, VkPipelineStageFlags dstStage, VkAccessFlags dstAccess) {
+
+		VkBufferMemoryBarrier barrier = {};
+		barrier.sType				= VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+		barrier.srcAccessMask		= srcAccess;
+		barrier.dstAccessMask		= dstAccess;
+		barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.buffer				= buffer;
+		barrier.offset				= 0;
+		barrier.size				= VK_WHOLE_SIZE;
+
+		vkCmdPipelineBarrier(commandBuffer, srcStage, dstStage, 0, 0, nullptr, 1, &barrier, 0, nullptr);
+	}
+
+	void imageBarrier(VkCommandBuffer commandBuffer, VkImage image, VkImageLayout oldLayout, VkImageLayout newLayout,
+		VkPipelineStageFlags srcStage, VkAccessFlags srcAccess, VkPipelineStageFlags dstStage, VkAccessFlags dstAccess,
+		VkImageAspectFlags aspect, uint32_t baseMipLevel, uint32_t levelCount) {
+
+		VkImageMemoryBarrier barrier = {};
+		barrier.sType							= VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+		barrier.oldLayout						= oldLayout;
+		barrier.newLayout						= newLayout;
+		barrier.srcAccessMask					= srcAccess;
+		barrier.dstAccessMask					= dstAccess;
+		barrier.srcQueueFamilyIndex				= VK_QUEUE_FAMILY_IGNORED;
+		barrier.dstQueueFamilyIndex				= VK_QUEUE_FAMILY_IGNORED;
+		barrier.image							= image;
+		barrier.subresourceRange.aspectMask		= aspect;
+		barrier.subresourceRange.baseMipLevel	= baseMipLevel;
+		barrier.subresourceRange.levelCount		= levelCount;
+		barrier.subresourceRange.baseArrayLayer = 0;
+		barrier.subresourceRange.layerCount		= 1;
+
+		vkCmdPipelineBarrier(commandBuffer, srcStage, dstStage, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+	}
+
+}
@@ -1,14 +1,32 @@
 
 // GLFW includes inself and loads vulkan
 
+#include "AssetPacker.h"
+#include "TextureBaker.h"
 #include "VulkanApplication.h"
 
 #include <iostream>
 
-int main() {
-	VulkanApplication app;
-
+int main(int argc, char** argv) {
 	try {
+		AppSettings appSettings = settings::parse(argc, argv);
+
+		// Offline check of the cpu occlusion rasterizer, no window or gpu needed
+		if (appSettings.occlusionCheck) {
+			return OcclusionCuller::runValidation(appSettings) ? EXIT_SUCCESS : EXIT_FAILURE;
+		}
+
+		// Offline texture compression, the renderer loads the results on its next run
+		if (appSettings.bakeTextures) {
+			return TextureBaker::run(appSettings) ? EXIT_SUCCESS : EXIT_FAILURE;
+		}
+
+		// Offline packing of whatever has been compiled and baked, the renderer maps the pack on its next run
+		if (appSettings.packAssets) {
+			return AssetPacker::run() ? EXIT_SUCCESS : EXIT_FAILURE;
+		}
+
+		VulkanApplication app(appSettings);
 		app.run();
 	} catch (const std::exception& e) {
 		std::cerr << e.what() << std::endl;